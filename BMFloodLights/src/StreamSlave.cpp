@@ -0,0 +1,70 @@
+// Slave fixture for a streaming BMFloodLights master (FLOODLIGHT_STREAM_MASTER).
+// No light show, BLE or settings here: the master renders every frame and
+// this fixture decodes its share of the pixels straight into its strips.
+// Built only by the floodlights_slave environment.
+#include <Arduino.h>
+#include <FastLED.h>
+#include <WiFi.h>
+#include <esp_now.h>
+#include <PixelStream.h>
+
+#define FLOODLIGHT_STREAM_GROUP ('F' << 8 | 'L')   // Same as the master
+#define FLOODLIGHT_STREAM_CHANNEL 6                // Same as the master
+#ifndef FLOODLIGHT_STREAM_FIRST
+#define FLOODLIGHT_STREAM_FIRST 0                  // First pixel of the master's frame shown here
+#endif
+
+#define NUM_STRIPS 3
+#define LEDS_PER_STRIP 8
+#define FLOODLIGHT_BRIGHTNESS 255
+
+// One array for all strips, so a frame decodes in one go
+CRGB leds[NUM_STRIPS * LEDS_PER_STRIP];
+PixelStreamReceiver receiver;
+unsigned long lastStatusLog = 0;
+
+void onDataReceived(const esp_now_recv_info_t* info, const uint8_t* data, int len) {
+    receiver.handleMessage(info->src_addr, data, len);
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(100);
+    Serial.println("=== BMFloodLights Stream Slave Starting ===");
+
+    FastLED.addLeds<WS2811, 25, RGB>(leds, LEDS_PER_STRIP);
+    FastLED.addLeds<WS2811, 33, RGB>(leds + LEDS_PER_STRIP, LEDS_PER_STRIP);
+    FastLED.addLeds<WS2811, 32, RGB>(leds + 2 * LEDS_PER_STRIP, LEDS_PER_STRIP);
+    FastLED.setBrightness(FLOODLIGHT_BRIGHTNESS);
+    FastLED.clear(true);
+
+    receiver.begin(leds, NUM_STRIPS * LEDS_PER_STRIP, FLOODLIGHT_STREAM_GROUP, FLOODLIGHT_STREAM_FIRST);
+
+    WiFi.mode(WIFI_STA);
+    WiFi.setChannel(FLOODLIGHT_STREAM_CHANNEL);
+    if (esp_now_init() != ESP_OK) {
+        Serial.println("Error initializing ESP-NOW");
+        while (1);
+    }
+    esp_now_register_recv_cb(onDataReceived);
+
+    Serial.printf("Showing pixels %d-%d of the master's frame\n", FLOODLIGHT_STREAM_FIRST,
+                  FLOODLIGHT_STREAM_FIRST + NUM_STRIPS * LEDS_PER_STRIP - 1);
+}
+
+void loop() {
+    if (receiver.update()) {
+        FastLED.show();
+    }
+
+    unsigned long currentTime = millis();
+    if (currentTime - lastStatusLog >= 30000) {
+        const PixelStreamReceiverStats& stats = receiver.getStats();
+        Serial.printf("Stream: %s, %lu slices (%lu keyframes), %lu waiting for a keyframe, %lu stale, %lu rejected\n",
+                      receiver.isComplete() ? "complete" : "incomplete", (unsigned long)stats.slices,
+                      (unsigned long)stats.keyframes, (unsigned long)stats.missing_key, (unsigned long)stats.stale,
+                      (unsigned long)stats.rejected);
+        lastStatusLog = currentTime;
+    }
+    delay(1);
+}
@@ -1,4 +1,9 @@
 #include <BMDevice.h>
+#ifdef FLOODLIGHT_STREAM_MASTER
+#include <WiFi.h>
+#include <esp_now.h>
+#include <PixelStream.h>
+#endif
 
 // Default UUIDs for floodlights device
 #define SERVICE_UUID "4746abe4-2135-4a84-8f2f-f47f3a73e73b"
@@ -39,6 +44,53 @@
 // BMDevice instance with floodlight-specific naming
 BMDevice device(SERVICE_UUID, FEATURES_UUID, STATUS_UUID);
 
+#ifdef FLOODLIGHT_STREAM_MASTER
+// Streaming master: renders as usual and also sends every frame to slave
+// fixtures (src/StreamSlave.cpp), which just display it
+#define FLOODLIGHT_STREAM_GROUP ('F' << 8 | 'L')   // Same on the slaves
+#define FLOODLIGHT_STREAM_CHANNEL 6                // ESP-NOW channel, same on the slaves
+#define FLOODLIGHT_STREAM_INTERVAL 40              // ms between streamed frames (25 fps)
+
+PixelStreamSender streamSender;
+CRGB streamFrame[NUM_STRIPS * LEDS_PER_STRIP];
+unsigned long lastStreamFrame = 0;
+
+void beginStreaming() {
+    static const uint8_t broadcastAddress[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    WiFi.mode(WIFI_STA);
+    WiFi.setChannel(FLOODLIGHT_STREAM_CHANNEL);
+    if (esp_now_init() != ESP_OK) {
+        Serial.println("Error initializing ESP-NOW, not streaming");
+        return;
+    }
+    esp_now_peer_info_t peerInfo = {};
+    memcpy(peerInfo.peer_addr, broadcastAddress, 6);
+    peerInfo.channel = 0;
+    peerInfo.encrypt = false;
+    esp_now_add_peer(&peerInfo);
+
+    streamSender.setSendFunction([](const uint8_t *mac, const uint8_t *data, size_t len) {
+        return esp_now_send(mac, data, len) == ESP_OK;
+    });
+    streamSender.begin(FLOODLIGHT_STREAM_GROUP);
+    Serial.printf("Streaming %d pixels to slave fixtures\n", NUM_STRIPS * LEDS_PER_STRIP);
+}
+
+// The strips in order, as one frame
+void streamCurrentFrame() {
+    CRGB* strips[] = {
+        leds0,
+#if NUM_STRIPS > 1
+        leds1, leds2,
+#endif
+    };
+    for (int strip = 0; strip < NUM_STRIPS; strip++) {
+        memcpy(streamFrame + strip * LEDS_PER_STRIP, strips[strip], sizeof(CRGB) * LEDS_PER_STRIP);
+    }
+    streamSender.sendFrame(streamFrame, NUM_STRIPS * LEDS_PER_STRIP);
+}
+#endif
+
 // Floodlight-specific timing variables for slow fades
 unsigned long lastEffectUpdate = 0;
 const unsigned long FLOODLIGHT_UPDATE_INTERVAL = 200;  // Much slower updates (200ms vs typical 50ms)
@@ -51,7 +103,7 @@ void applyFloodlightSettings() {
     device.setBrightness(FLOODLIGHT_BRIGHTNESS);
     
     // Set slower speed for ambient effects
-    device.getState().speed = 1000;  // Much slower than typical 50-100 (higher number = slower)
+    device.getState().setSpeed(1000);  // Much slower than typical 50-100 (higher number = slower)
     
     Serial.println("=== Floodlight Settings Applied ===");
     Serial.print("Brightness: ");
@@ -155,6 +207,10 @@ void setup() {
     
     // Set an ambient-friendly effect
     setAmbientEffect();
+
+#ifdef FLOODLIGHT_STREAM_MASTER
+    beginStreaming();
+#endif
     
     // Set a floodlight-optimized palette
     // These palettes work better with RGB floodlights:
@@ -199,6 +255,13 @@ void loop() {
         device.setBrightness(FLOODLIGHT_BRIGHTNESS);
     }
     
+#ifdef FLOODLIGHT_STREAM_MASTER
+    if (currentTime - lastStreamFrame >= FLOODLIGHT_STREAM_INTERVAL) {
+        lastStreamFrame = currentTime;
+        streamCurrentFrame();
+    }
+#endif
+
     // Apply slower update timing for ambient effects
     if (currentTime - lastEffectUpdate >= FLOODLIGHT_UPDATE_INTERVAL) {
         // The BMDevice library handles the actual light show updates
@@ -219,6 +282,12 @@ void loop() {
             Serial.println(device.getLightShow().paletteIdToName(device.getState().currentPalette));
             Serial.print("Speed: ");
             Serial.println(device.getState().speed);
+#ifdef FLOODLIGHT_STREAM_MASTER
+            const PixelStreamSenderStats& stream = streamSender.getStats();
+            Serial.printf("Streamed: %lu frames, %lu bytes/frame, %lu send failures\n", (unsigned long)stream.frames,
+                          (unsigned long)(stream.frames ? stream.bytes / stream.frames : 0),
+                          (unsigned long)stream.send_failures);
+#endif
             lastStatusLog = currentTime;
         }
     }
@@ -213,7 +213,7 @@ void handleEncoderChange() {
                 int speed = device.getState().speed;
                 speed -= direction * 5; // Change by 5 each step
                 speed = constrain(speed, 5, 200); // BMDevice constrains speed to 5-200
-                device.getState().speed = speed;
+                device.getState().setSpeed(speed);
                 // Force light show update to apply new speed
                 device.setEffect(device.getState().currentEffect);
                 Serial.print("Speed: ");
@@ -264,7 +264,7 @@ void handleEncoderChange() {
         else if (pressDuration > SHORT_PRESS_TIME && pressDuration < OFF_TIME) {
             // Long Press - toggle power
             bool power = device.getState().power;
-            device.getState().power = !power;
+            device.getState().setPower(!power);
             Serial.print("Power: ");
             Serial.println(device.getState().power ? "On" : "Off");
             delay(100);
@@ -0,0 +1,143 @@
+#ifndef BM_HOST_ARDUINO_H
+#define BM_HOST_ARDUINO_H
+
+// Minimal Arduino core for host builds of library code under test.
+//
+// millis()/micros() read HostTime's virtual clock, so simulations can run
+// several "devices" in one process, each with its own notion of local time.
+// The signatures match FastLED's stub platform so both can coexist.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <string>
+#include <algorithm>
+
+#include "HostTime.h"
+
+extern "C" {
+    uint32_t millis(void);
+    uint32_t micros(void);
+    void delay(int ms);
+    void yield(void);
+    void pinMode(uint8_t pin, uint8_t mode);
+}
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define radians(deg) ((deg) * DEG_TO_RAD)
+#define degrees(rad) ((rad) * RAD_TO_DEG)
+#define sq(x) ((x) * (x))
+
+// As the ESP32 core does
+using std::min;
+using std::max;
+
+// Deterministic per process; simulations reseed with randomSeed()
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+// Just enough of Arduino's String for library code that builds log lines
+class String : public std::string {
+public:
+    String() {}
+    String(const char* value) : std::string(value ? value : "") {}
+    String(const char* value, size_t length) : std::string(value, length) {}
+    String(const std::string& value) : std::string(value) {}
+
+    int indexOf(const char* value) const {
+        size_t at = find(value);
+        return at == npos ? -1 : (int)at;
+    }
+    String substring(size_t from, size_t to = npos) const {
+        if (from >= size()) {
+            return String();
+        }
+        return String(std::string::substr(from, to == npos ? npos : to - from));
+    }
+
+    // What ArduinoJson's serializeJson() writes through
+    size_t write(uint8_t c) {
+        push_back((char)c);
+        return 1;
+    }
+    size_t write(const uint8_t* data, size_t length) {
+        append((const char*)data, length);
+        return length;
+    }
+};
+
+#ifndef HEX
+#define DEC 10
+#define HEX 16
+#endif
+
+#define SERIAL_8N1 0x800001c
+
+// A UART with nothing attached: no data ever arrives
+class HardwareSerial {
+public:
+    explicit HardwareSerial(int port) { (void)port; }
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1) {
+        (void)baud;
+        (void)config;
+        (void)rxPin;
+        (void)txPin;
+    }
+    int available() { return 0; }
+    int read() { return -1; }
+};
+
+// Serial that prints to stdout; simulations silence it with setEnabled(false)
+class HostSerial {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    void setEnabled(bool enabled) { enabled_ = enabled; }
+
+    void print(const char* value) { out("%s", value); }
+    void print(const std::string& value) { out("%s", value.c_str()); }
+    void print(char value) { out("%c", value); }
+    void print(int value) { out("%d", value); }
+    void print(unsigned int value) { out("%u", value); }
+    void print(long value) { out("%ld", value); }
+    void print(unsigned long value) { out("%lu", value); }
+    void print(double value) { out("%.2f", value); }
+    void print(unsigned long value, int base) { out(base == HEX ? "%lX" : "%lu", value); }
+
+    void println() { out("\n"); }
+    template <typename T>
+    void println(const T& value) {
+        print(value);
+        println();
+    }
+    void println(unsigned long value, int base) {
+        print(value, base);
+        println();
+    }
+
+    int printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+private:
+    void out(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    bool enabled_ = true;
+};
+
+extern HostSerial Serial;
+
+#endif // BM_HOST_ARDUINO_H
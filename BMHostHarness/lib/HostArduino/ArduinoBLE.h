@@ -0,0 +1,153 @@
+#ifndef BM_HOST_ARDUINO_BLE_H
+#define BM_HOST_ARDUINO_BLE_H
+
+#include <Arduino.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// The part of ArduinoBLE that BMBluetoothHandler uses, for host builds of
+// BMDevice.
+//
+// There is one peripheral (BLE) and at most one central. A simulator plays
+// the app through HostBle: connect()/disconnect() fire the connection
+// handlers, write() stores a value in a characteristic and fires its
+// BLEWritten handler, and every setValue() on a notifying characteristic
+// while connected goes to the onNotify() callback, as the notification the
+// app would receive, whole: the simulator models the MTU's cost itself.
+// utility/ATT.h and utility/HCI.h stand in for the stack's internals the
+// handler reaches for. reset() starts over for another device in the same
+// process.
+
+enum BLEDeviceEvent {
+    BLEConnected = 0,
+    BLEDisconnected = 1
+};
+
+enum BLECharacteristicEvent {
+    BLEWritten = 0
+};
+
+#define BLERead (1 << 1)
+#define BLEWriteWithoutResponse (1 << 2)
+#define BLEWrite (1 << 3)
+#define BLENotify (1 << 4)
+
+class BLEDevice {
+public:
+    String address() const { return "00:00:00:00:00:01"; }
+};
+
+class BLECharacteristic;
+typedef void (*BLEDeviceEventHandler)(BLEDevice device);
+typedef void (*BLECharacteristicEventHandler)(BLEDevice device, BLECharacteristic characteristic);
+
+// As in ArduinoBLE, a handle: copies (the event handler gets one) share the
+// same characteristic
+class BLECharacteristic {
+public:
+    BLECharacteristic(const char* uuid, uint8_t properties, int valueSize);
+
+    const char* uuid() const { return state_->uuid.c_str(); }
+    uint8_t properties() const { return state_->properties; }
+
+    int setValue(const uint8_t* value, int length);
+    int setValue(const char* value) { return setValue((const uint8_t*)value, (int)strlen(value)); }
+    const uint8_t* value() const { return state_->value.data(); }
+    int valueLength() const { return (int)state_->value.size(); }
+    int valueSize() const { return state_->valueSize; }
+
+    void setEventHandler(BLECharacteristicEvent event, BLECharacteristicEventHandler handler);
+
+    // Called by HostBle
+    void written(const uint8_t* value, size_t length);
+
+private:
+    struct State {
+        String uuid;
+        uint8_t properties;
+        int valueSize;
+        std::vector<uint8_t> value;
+        BLECharacteristicEventHandler written = nullptr;
+    };
+
+    std::shared_ptr<State> state_;
+};
+
+class BLEService {
+public:
+    explicit BLEService(const char* uuid) : uuid_(uuid) {}
+
+    const char* uuid() const { return uuid_.c_str(); }
+    void addCharacteristic(BLECharacteristic& characteristic) { characteristics_.push_back(&characteristic); }
+    const std::vector<BLECharacteristic*>& characteristics() const { return characteristics_; }
+
+private:
+    String uuid_;
+    std::vector<BLECharacteristic*> characteristics_;
+};
+
+class BLELocalDevice {
+public:
+    int begin() { return 1; }
+    void end() {}
+    void poll() {}
+
+    bool setLocalName(const char* name) {
+        name_ = name;
+        return true;
+    }
+    bool setAdvertisedService(const BLEService& service) {
+        (void)service;
+        return true;
+    }
+    void addService(BLEService& service) { services_.push_back(&service); }
+    void setEventHandler(BLEDeviceEvent event, BLEDeviceEventHandler handler);
+
+    int advertise() {
+        advertising_ = true;
+        return 1;
+    }
+    void stopAdvertise() { advertising_ = false; }
+
+    const String& localName() const { return name_; }
+    bool advertising() const { return advertising_; }
+    BLECharacteristic* characteristic(const char* uuid) const;
+
+private:
+    friend struct HostBleAccess;
+
+    String name_;
+    bool advertising_ = false;
+    std::vector<BLEService*> services_;
+    BLEDeviceEventHandler connected_ = nullptr;
+    BLEDeviceEventHandler disconnected_ = nullptr;
+};
+
+extern BLELocalDevice BLE;
+
+namespace HostBle {
+    typedef std::function<void(const char* uuid, const uint8_t* data, size_t length)> NotifyFunction;
+
+    // An HCI command the prop sent (utility/HCI.h)
+    struct Command {
+        uint16_t opcode;
+        std::vector<uint8_t> parameters;
+    };
+
+    void connect();
+    void disconnect();
+    bool connected();
+    // A write from the app to the characteristic with this UUID; false if
+    // there is none
+    bool write(const char* uuid, const uint8_t* data, size_t length);
+    void onNotify(NotifyFunction callback);
+    // The ATT MTU the app exchanged; 23 on every new connection until set
+    void setMtu(uint16_t mtu);
+    uint16_t mtu();
+    const std::vector<Command>& commands();
+    // Forgets the services and handlers of the last device, for the next one
+    void reset();
+}
+
+#endif // BM_HOST_ARDUINO_BLE_H
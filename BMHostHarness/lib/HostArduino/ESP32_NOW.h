@@ -0,0 +1,7 @@
+#ifndef BM_HOST_ESP32_NOW_H
+#define BM_HOST_ESP32_NOW_H
+
+// The library code only uses the ESP-IDF C API that this header pulls in
+#include "esp_now.h"
+
+#endif // BM_HOST_ESP32_NOW_H
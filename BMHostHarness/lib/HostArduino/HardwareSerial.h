@@ -0,0 +1,7 @@
+#ifndef BM_HOST_HARDWARE_SERIAL_H
+#define BM_HOST_HARDWARE_SERIAL_H
+
+// HardwareSerial lives in Arduino.h here
+#include "Arduino.h"
+
+#endif // BM_HOST_HARDWARE_SERIAL_H
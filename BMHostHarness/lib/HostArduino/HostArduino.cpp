@@ -0,0 +1,63 @@
+#include "Arduino.h"
+
+#include <stdarg.h>
+
+HostSerial Serial;
+
+static uint64_t currentMicros = 0;
+
+namespace HostTime {
+    void setMicros(uint64_t us) { currentMicros = us; }
+    uint64_t micros() { return currentMicros; }
+    void advanceMicros(uint64_t us) { currentMicros += us; }
+}
+
+extern "C" {
+    uint32_t millis(void) { return (uint32_t)(currentMicros / 1000); }
+    uint32_t micros(void) { return (uint32_t)currentMicros; }
+    void delay(int ms) { currentMicros += (uint64_t)ms * 1000; }
+    void yield(void) {}
+    void pinMode(uint8_t pin, uint8_t mode) {
+        (void)pin;
+        (void)mode;
+    }
+}
+
+static uint32_t randomState = 1;
+
+long random(long max) {
+    // xorshift32: cheap, and the same sequence on every platform
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return max > 0 ? (long)(randomState % (uint32_t)max) : 0;
+}
+
+long random(long min, long max) { return max > min ? min + random(max - min) : min; }
+
+void randomSeed(unsigned long seed) { randomState = seed ? (uint32_t)seed : 1; }
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+int HostSerial::printf(const char* format, ...) {
+    if (!enabled_) {
+        return 0;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vprintf(format, args);
+    va_end(args);
+    return written;
+}
+
+void HostSerial::out(const char* format, ...) {
+    if (!enabled_) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
@@ -0,0 +1,144 @@
+#include "ArduinoBLE.h"
+#include "utility/ATT.h"
+#include "utility/HCI.h"
+
+#include <strings.h>
+
+#define HOST_BLE_DEFAULT_MTU 23
+
+BLELocalDevice BLE;
+
+static ATTClass attInstance;
+static HCIClass hciInstance;
+ATTClass& ATT = attInstance;
+HCIClass& HCI = hciInstance;
+
+static bool centralConnected = false;
+static HostBle::NotifyFunction notify;
+static uint16_t centralMtu = HOST_BLE_DEFAULT_MTU;
+static std::vector<HostBle::Command> hciCommands;
+
+struct HostBleAccess {
+    static void connected(bool connected) {
+        BLEDeviceEventHandler handler = connected ? BLE.connected_ : BLE.disconnected_;
+        if (handler) {
+            handler(BLEDevice());
+        }
+    }
+
+    static void reset() {
+        BLE.name_ = String();
+        BLE.advertising_ = false;
+        BLE.services_.clear();
+        BLE.connected_ = nullptr;
+        BLE.disconnected_ = nullptr;
+    }
+};
+
+BLECharacteristic::BLECharacteristic(const char* uuid, uint8_t properties, int valueSize) : state_(new State) {
+    state_->uuid = uuid;
+    state_->properties = properties;
+    state_->valueSize = valueSize;
+}
+
+int BLECharacteristic::setValue(const uint8_t* value, int length) {
+    if (length > state_->valueSize) {
+        return 0;
+    }
+    state_->value.assign(value, value + length);
+    if ((state_->properties & BLENotify) && centralConnected && notify) {
+        notify(uuid(), value, (size_t)length);
+    }
+    return 1;
+}
+
+void BLECharacteristic::setEventHandler(BLECharacteristicEvent event, BLECharacteristicEventHandler handler) {
+    if (event == BLEWritten) {
+        state_->written = handler;
+    }
+}
+
+void BLECharacteristic::written(const uint8_t* value, size_t length) {
+    state_->value.assign(value, value + length);
+    if (state_->written) {
+        state_->written(BLEDevice(), *this);
+    }
+}
+
+void BLELocalDevice::setEventHandler(BLEDeviceEvent event, BLEDeviceEventHandler handler) {
+    if (event == BLEConnected) {
+        connected_ = handler;
+    } else {
+        disconnected_ = handler;
+    }
+}
+
+BLECharacteristic* BLELocalDevice::characteristic(const char* uuid) const {
+    for (BLEService* service : services_) {
+        for (BLECharacteristic* characteristic : service->characteristics()) {
+            if (strcasecmp(characteristic->uuid(), uuid) == 0) {
+                return characteristic;
+            }
+        }
+    }
+    return nullptr;
+}
+
+uint16_t ATTClass::connectionHandle(uint8_t addressType, const uint8_t address[6]) const {
+    (void)addressType;
+    (void)address;
+    return centralConnected ? 0 : 0xffff;
+}
+
+uint16_t ATTClass::mtu(uint16_t handle) const {
+    return centralConnected && handle == 0 ? centralMtu : HOST_BLE_DEFAULT_MTU;
+}
+
+int HCIClass::sendCommand(uint16_t opcode, uint8_t plen, void* parameters) {
+    const uint8_t* bytes = (const uint8_t*)parameters;
+    hciCommands.push_back({opcode, std::vector<uint8_t>(bytes, bytes + (bytes ? plen : 0))});
+    return 0;
+}
+
+namespace HostBle {
+    void connect() {
+        if (!centralConnected) {
+            centralConnected = true;
+            centralMtu = HOST_BLE_DEFAULT_MTU;
+            BLE.stopAdvertise();
+            HostBleAccess::connected(true);
+        }
+    }
+
+    void disconnect() {
+        if (centralConnected) {
+            centralConnected = false;
+            HostBleAccess::connected(false);
+        }
+    }
+
+    bool connected() { return centralConnected; }
+
+    bool write(const char* uuid, const uint8_t* data, size_t length) {
+        BLECharacteristic* characteristic = BLE.characteristic(uuid);
+        if (!characteristic || !(characteristic->properties() & BLEWrite)) {
+            return false;
+        }
+        characteristic->written(data, length);
+        return true;
+    }
+
+    void onNotify(NotifyFunction callback) { notify = callback; }
+
+    void setMtu(uint16_t mtu) { centralMtu = mtu; }
+    uint16_t mtu() { return centralMtu; }
+    const std::vector<Command>& commands() { return hciCommands; }
+
+    void reset() {
+        centralConnected = false;
+        notify = nullptr;
+        centralMtu = HOST_BLE_DEFAULT_MTU;
+        hciCommands.clear();
+        HostBleAccess::reset();
+    }
+}
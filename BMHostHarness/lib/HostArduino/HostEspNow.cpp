@@ -0,0 +1,159 @@
+#include "HostEspNow.h"
+#include "WiFi.h"
+#include "esp_wifi.h"
+
+#include <string.h>
+
+HostWiFi WiFi;
+
+static HostRadio* currentRadio = nullptr;
+
+namespace HostEspNow {
+    void setRadio(HostRadio* radio) { currentRadio = radio; }
+    HostRadio* radio() { return currentRadio; }
+}
+
+HostRadio::HostRadio(const uint8_t mac[6]) { memcpy(mac_, mac, 6); }
+
+void HostRadio::receive(const uint8_t* from, const uint8_t* data, size_t len) {
+    if (!initialized_ || !recv_) {
+        return;
+    }
+    uint8_t src[6];
+    uint8_t dst[6];
+    memcpy(src, from, 6);
+    memcpy(dst, mac_, 6);
+    esp_now_recv_info_t info = {src, dst, nullptr};
+    recv_(&info, data, (int)len);
+}
+
+void HostRadio::poll() {
+    // The callback may send again; report only what was queued before it ran
+    std::vector<SendResult> results;
+    results.swap(results_);
+    for (const SendResult& result : results) {
+        if (sent_) {
+            sent_(result.mac, result.status);
+        }
+    }
+}
+
+esp_err_t HostRadio::init() {
+    initialized_ = true;
+    return ESP_OK;
+}
+
+esp_err_t HostRadio::deinit() {
+    initialized_ = false;
+    recv_ = nullptr;
+    sent_ = nullptr;
+    peers_.clear();
+    results_.clear();
+    return ESP_OK;
+}
+
+esp_err_t HostRadio::registerRecv(esp_now_recv_cb_t cb) {
+    if (!initialized_) {
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    recv_ = cb;
+    return ESP_OK;
+}
+
+esp_err_t HostRadio::registerSend(esp_now_send_cb_t cb) {
+    if (!initialized_) {
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    sent_ = cb;
+    return ESP_OK;
+}
+
+int HostRadio::findPeer(const uint8_t* mac) const {
+    for (size_t i = 0; i < peers_.size(); i++) {
+        if (memcmp(peers_[i].peer_addr, mac, 6) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+esp_err_t HostRadio::addPeer(const esp_now_peer_info_t* peer) {
+    if (!initialized_) {
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    if (!peer) {
+        return ESP_ERR_ESPNOW_ARG;
+    }
+    if (findPeer(peer->peer_addr) >= 0) {
+        return ESP_ERR_ESPNOW_EXIST;
+    }
+    if (peers_.size() >= ESP_NOW_MAX_TOTAL_PEER_NUM) {
+        return ESP_ERR_ESPNOW_FULL;
+    }
+    peers_.push_back(*peer);
+    return ESP_OK;
+}
+
+esp_err_t HostRadio::delPeer(const uint8_t* mac) {
+    int index = findPeer(mac);
+    if (index < 0) {
+        return ESP_ERR_ESPNOW_NOT_FOUND;
+    }
+    peers_.erase(peers_.begin() + index);
+    return ESP_OK;
+}
+
+bool HostRadio::hasPeer(const uint8_t* mac) const { return findPeer(mac) >= 0; }
+
+esp_err_t HostRadio::send(const uint8_t* mac, const uint8_t* data, size_t len) {
+    static const uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    if (!initialized_) {
+        sendErrors_++;
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    if (!mac || !data || len == 0 || len > ESP_NOW_MAX_DATA_LEN) {
+        sendErrors_++;
+        return ESP_ERR_ESPNOW_ARG;
+    }
+    // Like the real driver, even the broadcast address must be a registered peer
+    if (findPeer(mac) < 0) {
+        sendErrors_++;
+        return ESP_ERR_ESPNOW_NOT_FOUND;
+    }
+
+    bool delivered = transmit_ ? transmit_(mac, data, len) : false;
+    SendResult result;
+    memcpy(result.mac, mac, 6);
+    result.status = (delivered || memcmp(mac, broadcast, 6) == 0) ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL;
+    results_.push_back(result);
+    return ESP_OK;
+}
+
+
+esp_err_t esp_now_init(void) { return currentRadio ? currentRadio->init() : ESP_FAIL; }
+esp_err_t esp_now_deinit(void) { return currentRadio ? currentRadio->deinit() : ESP_FAIL; }
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb) {
+    return currentRadio ? currentRadio->registerRecv(cb) : ESP_ERR_ESPNOW_NOT_INIT;
+}
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb) {
+    return currentRadio ? currentRadio->registerSend(cb) : ESP_ERR_ESPNOW_NOT_INIT;
+}
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t* peer) {
+    return currentRadio ? currentRadio->addPeer(peer) : ESP_ERR_ESPNOW_NOT_INIT;
+}
+esp_err_t esp_now_del_peer(const uint8_t* mac) {
+    return currentRadio ? currentRadio->delPeer(mac) : ESP_ERR_ESPNOW_NOT_INIT;
+}
+bool esp_now_is_peer_exist(const uint8_t* mac) { return currentRadio && currentRadio->hasPeer(mac); }
+esp_err_t esp_now_send(const uint8_t* mac, const uint8_t* data, size_t len) {
+    return currentRadio ? currentRadio->send(mac, data, len) : ESP_ERR_ESPNOW_NOT_INIT;
+}
+
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6]) {
+    (void)ifx;
+    if (!currentRadio) {
+        return ESP_FAIL;
+    }
+    memcpy(mac, currentRadio->mac(), 6);
+    return ESP_OK;
+}
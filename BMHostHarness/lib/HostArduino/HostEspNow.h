@@ -0,0 +1,76 @@
+#ifndef BM_HOST_ESP_NOW_RADIO_H
+#define BM_HOST_ESP_NOW_RADIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <vector>
+
+#include "esp_now.h"
+
+// One simulated device's ESP-NOW interface.
+//
+// A simulator owns one HostRadio per device and makes it current (together
+// with that device's HostTime) before running the device's code, the same
+// way it switches clocks. The esp_now_* functions then act on the current
+// radio: the peer table (ESP_NOW_MAX_TOTAL_PEER_NUM entries, unicasts only
+// to registered peers), the registered callbacks, and transmit(), which hands
+// frames to the simulated medium.
+//
+// Frames from the medium are passed to receive(). Send results are queued
+// and reported by poll(), which the simulator calls after the device's own
+// code, like the Wi-Fi task calling the send callback after the fact.
+class HostRadio {
+public:
+    // Returns whether the addressee got the frame (its MAC ACK); broadcasts
+    // return true once sent
+    typedef std::function<bool(const uint8_t* mac, const uint8_t* data, size_t len)> TransmitFunction;
+
+    explicit HostRadio(const uint8_t mac[6]);
+
+    const uint8_t* mac() const { return mac_; }
+    void setTransmitFunction(TransmitFunction transmit) { transmit_ = transmit; }
+
+    // A frame from another device; ignored until esp_now_init()
+    void receive(const uint8_t* from, const uint8_t* data, size_t len);
+    // Reports queued send results to the send callback
+    void poll();
+
+    size_t peerCount() const { return peers_.size(); }
+    unsigned long sendErrors() const { return sendErrors_; }
+
+    // Called by the esp_now_* functions
+    esp_err_t init();
+    esp_err_t deinit();
+    esp_err_t registerRecv(esp_now_recv_cb_t cb);
+    esp_err_t registerSend(esp_now_send_cb_t cb);
+    esp_err_t addPeer(const esp_now_peer_info_t* peer);
+    esp_err_t delPeer(const uint8_t* mac);
+    bool hasPeer(const uint8_t* mac) const;
+    esp_err_t send(const uint8_t* mac, const uint8_t* data, size_t len);
+
+private:
+    struct SendResult {
+        uint8_t mac[6];
+        esp_now_send_status_t status;
+    };
+
+    int findPeer(const uint8_t* mac) const;
+
+    uint8_t mac_[6];
+    bool initialized_ = false;
+    esp_now_recv_cb_t recv_ = nullptr;
+    esp_now_send_cb_t sent_ = nullptr;
+    TransmitFunction transmit_;
+    std::vector<esp_now_peer_info_t> peers_;
+    std::vector<SendResult> results_;
+    unsigned long sendErrors_ = 0;
+};
+
+namespace HostEspNow {
+    // The radio esp_now_* and esp_wifi_get_mac() act on
+    void setRadio(HostRadio* radio);
+    HostRadio* radio();
+}
+
+#endif // BM_HOST_ESP_NOW_RADIO_H
@@ -0,0 +1,151 @@
+#include "Preferences.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Entry {
+    Preferences::Type type;
+    std::vector<uint8_t> value;
+};
+
+typedef std::map<std::string, Entry> Namespace;
+
+std::map<std::string, Namespace> storage;
+unsigned long writeCount = 0;
+unsigned long readCount = 0;
+long powerLeft = -1;        // Bytes the next put() gets before power fails, -1 for no failure
+bool powerCut = false;
+
+// NVS keys and namespaces are at most 15 characters
+const size_t MAX_KEY_LENGTH = 15;
+
+}
+
+bool Preferences::begin(const char* name, bool readOnly) {
+    if (open_ || !name || strlen(name) > MAX_KEY_LENGTH) {
+        return false;
+    }
+    name_ = name;
+    open_ = true;
+    readOnly_ = readOnly;
+    return true;
+}
+
+void Preferences::end() { open_ = false; }
+
+bool Preferences::clear() {
+    if (!open_ || readOnly_) {
+        return false;
+    }
+    storage[name_].clear();
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    if (!open_ || readOnly_) {
+        return false;
+    }
+    return storage[name_].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+    readCount++;
+    return open_ && storage[name_].count(key) > 0;
+}
+
+String Preferences::getString(const char* key, const String& defaultValue) {
+    readCount++;
+    if (!open_) {
+        return defaultValue;
+    }
+    Namespace& space = storage[name_];
+    auto it = space.find(key);
+    if (it == space.end() || it->second.type != TYPE_STR) {
+        return defaultValue;
+    }
+    return String((const char*)it->second.value.data(), it->second.value.size());
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    readCount++;
+    return blobLength(key);
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t length) {
+    readCount++;
+    size_t stored = blobLength(key);
+    if (stored == 0 || stored > length) {
+        return 0;
+    }
+    memcpy(buffer, storage[name_][key].value.data(), stored);
+    return stored;
+}
+
+size_t Preferences::blobLength(const char* key) {
+    if (!open_) {
+        return 0;
+    }
+    Namespace& space = storage[name_];
+    auto it = space.find(key);
+    return it == space.end() || it->second.type != TYPE_BLOB ? 0 : it->second.value.size();
+}
+
+size_t Preferences::put(const char* key, Type type, const void* value, size_t length) {
+    if (!open_ || readOnly_ || !key || strlen(key) > MAX_KEY_LENGTH || powerCut) {
+        return 0;
+    }
+    Entry& entry = storage[name_][key];
+    if (powerLeft >= 0) {
+        // Torn: the new value's first bytes over whatever the key held
+        size_t torn = std::min((size_t)powerLeft, length);
+        entry.type = type;
+        if (entry.value.size() < torn) {
+            entry.value.resize(torn);
+        }
+        memcpy(entry.value.data(), value, torn);
+        powerLeft = -1;
+        powerCut = true;
+        return 0;
+    }
+    entry.type = type;
+    entry.value.assign((const uint8_t*)value, (const uint8_t*)value + length);
+    writeCount++;
+    return length;
+}
+
+bool Preferences::read(const char* key, Type type, void* value, size_t length) {
+    readCount++;
+    if (!open_) {
+        return false;
+    }
+    Namespace& space = storage[name_];
+    auto it = space.find(key);
+    if (it == space.end() || it->second.type != type || it->second.value.size() != length) {
+        return false;
+    }
+    memcpy(value, it->second.value.data(), length);
+    return true;
+}
+
+namespace HostPreferences {
+    unsigned long writes() { return writeCount; }
+    unsigned long reads() { return readCount; }
+
+    void erase() {
+        storage.clear();
+        writeCount = 0;
+        readCount = 0;
+        restorePower();
+    }
+
+    void cutPowerAfter(size_t bytes) { powerLeft = (long)bytes; }
+
+    void restorePower() {
+        powerLeft = -1;
+        powerCut = false;
+    }
+}
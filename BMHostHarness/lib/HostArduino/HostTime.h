@@ -0,0 +1,18 @@
+#ifndef BM_HOST_TIME_H
+#define BM_HOST_TIME_H
+
+#include <stdint.h>
+
+// Virtual time for host simulations.
+//
+// Everything that calls millis()/micros() sees HostTime::micros(). A
+// simulator sets it to the local time of whichever simulated device it is
+// about to run, so each device can have its own boot time and crystal drift.
+// delay() advances it.
+namespace HostTime {
+    void setMicros(uint64_t us);
+    uint64_t micros();
+    void advanceMicros(uint64_t us);
+}
+
+#endif // BM_HOST_TIME_H
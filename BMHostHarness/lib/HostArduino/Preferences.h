@@ -0,0 +1,82 @@
+#ifndef BM_HOST_PREFERENCES_H
+#define BM_HOST_PREFERENCES_H
+
+#include <Arduino.h>
+
+// ESP32 Preferences (NVS) kept in memory, for host builds of BMDevice.
+//
+// Namespaces outlive the Preferences objects that open them, as flash does,
+// until HostPreferences::erase(). Values are stored as bytes with their type;
+// reading a key back as another type returns the default, as NVS does. Every
+// put*() that reaches storage is counted, for simulations of flash wear, and
+// every lookup (get*(), isKey()) for boot cost.
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false);
+    void end();
+
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+
+    size_t putChar(const char* key, int8_t value) { return put(key, TYPE_I8, &value, sizeof(value)); }
+    size_t putUChar(const char* key, uint8_t value) { return put(key, TYPE_U8, &value, sizeof(value)); }
+    size_t putShort(const char* key, int16_t value) { return put(key, TYPE_I16, &value, sizeof(value)); }
+    size_t putUShort(const char* key, uint16_t value) { return put(key, TYPE_U16, &value, sizeof(value)); }
+    size_t putInt(const char* key, int32_t value) { return put(key, TYPE_I32, &value, sizeof(value)); }
+    size_t putUInt(const char* key, uint32_t value) { return put(key, TYPE_U32, &value, sizeof(value)); }
+    size_t putLong(const char* key, int32_t value) { return putInt(key, value); }
+    size_t putULong(const char* key, uint32_t value) { return putUInt(key, value); }
+    size_t putFloat(const char* key, float value) { return put(key, TYPE_BLOB, &value, sizeof(value)); }
+    size_t putBool(const char* key, bool value) { return putUChar(key, value ? 1 : 0); }
+    size_t putString(const char* key, const char* value) { return put(key, TYPE_STR, value, strlen(value)); }
+    size_t putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+    size_t putBytes(const char* key, const void* value, size_t length) { return put(key, TYPE_BLOB, value, length); }
+
+    int8_t getChar(const char* key, int8_t defaultValue = 0) { return get(key, TYPE_I8, defaultValue); }
+    uint8_t getUChar(const char* key, uint8_t defaultValue = 0) { return get(key, TYPE_U8, defaultValue); }
+    int16_t getShort(const char* key, int16_t defaultValue = 0) { return get(key, TYPE_I16, defaultValue); }
+    uint16_t getUShort(const char* key, uint16_t defaultValue = 0) { return get(key, TYPE_U16, defaultValue); }
+    int32_t getInt(const char* key, int32_t defaultValue = 0) { return get(key, TYPE_I32, defaultValue); }
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return get(key, TYPE_U32, defaultValue); }
+    int32_t getLong(const char* key, int32_t defaultValue = 0) { return getInt(key, defaultValue); }
+    uint32_t getULong(const char* key, uint32_t defaultValue = 0) { return getUInt(key, defaultValue); }
+    float getFloat(const char* key, float defaultValue = NAN) { return get(key, TYPE_BLOB, defaultValue); }
+    bool getBool(const char* key, bool defaultValue = false) { return getUChar(key, defaultValue ? 1 : 0) != 0; }
+    String getString(const char* key, const String& defaultValue = String());
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buffer, size_t length);
+
+    enum Type { TYPE_I8, TYPE_U8, TYPE_I16, TYPE_U16, TYPE_I32, TYPE_U32, TYPE_STR, TYPE_BLOB };
+
+private:
+    size_t put(const char* key, Type type, const void* value, size_t length);
+    size_t blobLength(const char* key);
+    bool read(const char* key, Type type, void* value, size_t length);
+
+    template <typename T>
+    T get(const char* key, Type type, T defaultValue) {
+        T value;
+        return read(key, type, &value, sizeof(value)) ? value : defaultValue;
+    }
+
+    String name_;
+    bool open_ = false;
+    bool readOnly_ = false;
+};
+
+namespace HostPreferences {
+    // Values written to storage since the last erase(), across namespaces
+    unsigned long writes();
+    // Lookups since the last erase(), across namespaces
+    unsigned long reads();
+    // Wipes every namespace, as a fresh flash
+    void erase();
+    // Power fails during the next put(), once `bytes` bytes of its value are
+    // written: the key is left holding those bytes over its old value, and
+    // nothing more is stored until restorePower()
+    void cutPowerAfter(size_t bytes);
+    void restorePower();
+}
+
+#endif // BM_HOST_PREFERENCES_H
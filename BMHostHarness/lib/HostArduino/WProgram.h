@@ -0,0 +1,8 @@
+#ifndef BM_HOST_WPROGRAM_H
+#define BM_HOST_WPROGRAM_H
+
+// Pre-1.0 name of the Arduino core header; TinyGPSPlus falls back to it when
+// ARDUINO is not defined, which it never is on the host
+#include "Arduino.h"
+
+#endif // BM_HOST_WPROGRAM_H
@@ -0,0 +1,30 @@
+#ifndef BM_HOST_WIFI_H
+#define BM_HOST_WIFI_H
+
+#include <stdint.h>
+
+#define WIFI_OFF 0
+#define WIFI_STA 1
+
+// Every simulated device shares one channel; mode and channel are recorded only
+class HostWiFi {
+public:
+    bool mode(int mode) {
+        mode_ = mode;
+        return true;
+    }
+    bool setChannel(uint8_t channel) {
+        channel_ = channel;
+        return true;
+    }
+    int getMode() const { return mode_; }
+    uint8_t channel() const { return channel_; }
+
+private:
+    int mode_ = WIFI_OFF;
+    uint8_t channel_ = 1;
+};
+
+extern HostWiFi WiFi;
+
+#endif // BM_HOST_WIFI_H
@@ -0,0 +1,14 @@
+#ifndef BM_HOST_ESP_WIFI_H
+#define BM_HOST_ESP_WIFI_H
+
+#include "esp_now.h"
+
+typedef enum {
+    WIFI_IF_STA = 0,
+    WIFI_IF_AP,
+} wifi_interface_t;
+
+// The current device's MAC (HostRadio::mac())
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6]);
+
+#endif // BM_HOST_ESP_WIFI_H
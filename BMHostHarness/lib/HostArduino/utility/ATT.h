@@ -0,0 +1,17 @@
+#ifndef BM_HOST_ARDUINO_ATT_H
+#define BM_HOST_ARDUINO_ATT_H
+
+#include <stdint.h>
+
+// The part of ArduinoBLE's ATT layer that BMBluetoothHandler uses. The one
+// central is connection handle 0, whatever its address; its MTU is what
+// HostBle::setMtu() last set (23 until the app exchanges MTUs).
+class ATTClass {
+public:
+    uint16_t connectionHandle(uint8_t addressType, const uint8_t address[6]) const;
+    uint16_t mtu(uint16_t handle) const;
+};
+
+extern ATTClass& ATT;
+
+#endif // BM_HOST_ARDUINO_ATT_H
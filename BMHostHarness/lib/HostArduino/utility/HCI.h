@@ -0,0 +1,16 @@
+#ifndef BM_HOST_ARDUINO_HCI_H
+#define BM_HOST_ARDUINO_HCI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The part of ArduinoBLE's HCI layer that BMBluetoothHandler uses. Commands
+// succeed and are kept, in order, for HostBle::commands().
+class HCIClass {
+public:
+    int sendCommand(uint16_t opcode, uint8_t plen = 0, void* parameters = NULL);
+};
+
+extern HCIClass& HCI;
+
+#endif // BM_HOST_ARDUINO_HCI_H
@@ -0,0 +1,5 @@
+// Library sources under test, compiled directly so this environment does not
+// pull in the rest of BurningManLEDs (LightShow needs FastLED, LocationService
+// needs TinyGPSPlus).
+#include "../../../libraries/BurningManLEDs/src/Clock.cpp"
+#include "../../../libraries/BurningManLEDs/src/ClockSync.cpp"
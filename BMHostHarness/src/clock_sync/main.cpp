@@ -0,0 +1,270 @@
+// Host simulation of ClockSync over a lossy, jittery ESP-NOW-like link.
+//
+// One time master and N followers run in a single process on virtual time.
+// Every device has its own boot time and crystal error, the medium adds a base
+// latency plus exponentially distributed jitter (independently per direction,
+// so round trips are asymmetric like real queueing/retries) and drops packets.
+// Every 100ms the harness reads all clocks at the same true instant and
+// records each follower's error against the master.
+//
+// Usage:
+//   clock_sync [options]
+//     --nodes <n>          followers (default 10)
+//     --minutes <m>        simulated duration (default 10)
+//     --latency <us>       base one-way latency (default 1500)
+//     --jitter <us>        mean of the exponential jitter (default 1500)
+//     --loss <pct>         packet loss percentage (default 5)
+//     --drift <ppm>        crystal error range, +/- (default 40)
+//     --seed <n>           random seed
+//     --csv <path>         per-sample max/mean error
+//
+// Exits non-zero if any follower is more than 2ms off after the lock-in period.
+
+#include <Arduino.h>
+#include <Clock.h>
+#include <ClockSync.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#define TARGET_ERROR_US 2000
+#define WARMUP_US 5000000ULL
+#define TICK_US 1000ULL
+#define MEASURE_INTERVAL_US 100000ULL
+
+struct SimNode {
+    uint8_t mac[6];
+    double drift;       // Crystal error (fraction)
+    double bootUs;      // Local time at true time zero
+    Clock clock;
+    ClockSync sync;
+    uint32_t sent;
+
+    SimNode() : drift(0), bootUs(0), sync(clock), sent(0) {}
+
+    uint64_t localAt(uint64_t trueUs) const { return (uint64_t)(bootUs + trueUs * (1.0 + drift)); }
+};
+
+struct Delivery {
+    uint64_t trueUs;
+    uint64_t order;
+    int from;
+    int to;
+    std::vector<uint8_t> data;
+
+    bool operator>(const Delivery& other) const {
+        return trueUs != other.trueUs ? trueUs > other.trueUs : order > other.order;
+    }
+};
+
+struct SimConfig {
+    int followers = 10;
+    double minutes = 10;
+    double latencyUs = 1500;
+    double jitterUs = 1500;
+    double lossPercent = 5;
+    double driftPpm = 40;
+    unsigned seed = 1;
+    std::string csvPath;
+};
+
+class Simulation {
+public:
+    Simulation(const SimConfig& config) : config_(config), rng_(config.seed), nodes_(config.followers + 1) {
+        std::uniform_real_distribution<double> drift(-config.driftPpm * 1e-6, config.driftPpm * 1e-6);
+        std::uniform_real_distribution<double> boot(0, 30e6);
+
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            SimNode& node = nodes_[i];
+            uint8_t mac[6] = {0x24, 0x0A, 0xC4, 0x00, (uint8_t)(i >> 8), (uint8_t)i};
+            memcpy(node.mac, mac, sizeof(mac));
+            node.drift = drift(rng_);
+            node.bootUs = boot(rng_);
+            node.sync.setSendFunction([this, i](const uint8_t* to, const uint8_t* data, size_t len) {
+                return send((int)i, to, data, len);
+            });
+        }
+        nodes_[0].sync.setMaster(true);
+    }
+
+    int run() {
+        const uint64_t endUs = (uint64_t)(config_.minutes * 60e6);
+        FILE* csv = nullptr;
+        if (!config_.csvPath.empty()) {
+            csv = fopen(config_.csvPath.c_str(), "w");
+            if (csv) fprintf(csv, "t_s,max_error_us,mean_error_us\n");
+        }
+
+        std::vector<double> errors;
+        std::vector<double> lockTimeUs(nodes_.size(), -1);
+        double worst = 0;
+
+        for (uint64_t t = 0; t <= endUs; t += TICK_US) {
+            deliverUntil(t);
+            for (size_t i = 0; i < nodes_.size(); i++) {
+                enter(i, t);
+                nodes_[i].sync.update();
+            }
+
+            if (t % MEASURE_INTERVAL_US != 0) {
+                continue;
+            }
+
+            enter(0, t);
+            int64_t master = (int64_t)nodes_[0].clock.nowMicros();
+            double maxError = 0;
+            double sumError = 0;
+            for (size_t i = 1; i < nodes_.size(); i++) {
+                enter(i, t);
+                double error = fabs((double)((int64_t)nodes_[i].clock.nowMicros() - master));
+                if (lockTimeUs[i] < 0 && nodes_[i].sync.isLocked() && error < TARGET_ERROR_US) {
+                    lockTimeUs[i] = t;
+                }
+                if (t >= WARMUP_US) {
+                    errors.push_back(error);
+                    worst = std::max(worst, error);
+                }
+                maxError = std::max(maxError, error);
+                sumError += error;
+            }
+            if (csv) fprintf(csv, "%.1f,%.0f,%.0f\n", t / 1e6, maxError, sumError / config_.followers);
+        }
+        if (csv) fclose(csv);
+
+        report(errors, lockTimeUs, worst, endUs);
+        return worst <= TARGET_ERROR_US ? 0 : 1;
+    }
+
+private:
+    // Make node i's code see its own local time
+    void enter(size_t i, uint64_t trueUs) { HostTime::setMicros(nodes_[i].localAt(trueUs)); }
+
+    bool send(int from, const uint8_t* to, const uint8_t* data, size_t len) {
+        static const uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+        bool isBroadcast = memcmp(to, broadcast, 6) == 0;
+        nodes_[from].sent++;
+        packets_++;
+
+        std::uniform_real_distribution<double> chance(0, 100);
+        std::exponential_distribution<double> jitter(1.0 / std::max(1.0, config_.jitterUs));
+
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            if ((int)i == from || (!isBroadcast && memcmp(nodes_[i].mac, to, 6) != 0)) {
+                continue;
+            }
+            if (chance(rng_) < config_.lossPercent) {
+                lost_++;
+                continue;
+            }
+            Delivery delivery;
+            delivery.trueUs = now_ + (uint64_t)(config_.latencyUs + jitter(rng_));
+            delivery.order = order_++;
+            delivery.from = from;
+            delivery.to = (int)i;
+            delivery.data.assign(data, data + len);
+            queue_.push(delivery);
+        }
+        return true;
+    }
+
+    void deliverUntil(uint64_t t) {
+        now_ = t;
+        while (!queue_.empty() && queue_.top().trueUs <= t) {
+            Delivery delivery = queue_.top();
+            queue_.pop();
+            // Deliveries land between ticks; run the receiver at the exact arrival time
+            now_ = delivery.trueUs;
+            SimNode& node = nodes_[delivery.to];
+            enter(delivery.to, delivery.trueUs);
+            node.sync.handleMessage(nodes_[delivery.from].mac, delivery.data.data(), delivery.data.size(),
+                                    node.clock.localMicros());
+        }
+        now_ = t;
+    }
+
+    void report(std::vector<double>& errors, const std::vector<double>& lockTimeUs, double worst, uint64_t endUs) {
+        std::sort(errors.begin(), errors.end());
+        double sum = 0;
+        for (double e : errors) sum += e;
+
+        double maxRelativeDrift = 0;
+        double worstDriftEstimate = 0;
+        double slowestLock = 0;
+        for (size_t i = 1; i < nodes_.size(); i++) {
+            double relative = (1.0 + nodes_[0].drift) / (1.0 + nodes_[i].drift) - 1.0;
+            maxRelativeDrift = std::max(maxRelativeDrift, fabs(relative));
+            worstDriftEstimate = std::max(worstDriftEstimate,
+                                          fabs(nodes_[i].sync.getStats().drift_ppm - relative * 1e6));
+            slowestLock = std::max(slowestLock, lockTimeUs[i]);
+        }
+
+        printf("\n--- Clock sync simulation ---\n");
+        printf("Devices:                 1 master + %d followers, %.0f min simulated\n", config_.followers,
+               config_.minutes);
+        printf("Link:                    %.0f us + exp(%.0f us) jitter each way, %.1f%% loss\n", config_.latencyUs,
+               config_.jitterUs, config_.lossPercent);
+        printf("Packets:                 %lu sent, %lu deliveries lost (%.2f/s per follower)\n", packets_, lost_,
+               packets_ / (endUs / 1e6) / config_.followers);
+        printf("Lock time:               slowest follower within %.0f us after %.2f s\n", (double)TARGET_ERROR_US,
+               slowestLock / 1e6);
+        if (!errors.empty()) {
+            printf("Error after %.0fs:        mean %.0f us, p99 %.0f us, max %.0f us\n", WARMUP_US / 1e6,
+                   sum / errors.size(), errors[(size_t)(errors.size() * 0.99)], worst);
+        }
+        printf("Drift estimate:          worst error %.2f ppm (crystals up to %.1f ppm apart)\n",
+               worstDriftEstimate, maxRelativeDrift * 1e6);
+        printf("Uncorrected drift:       would reach %.1f ms after %.0f min\n",
+               maxRelativeDrift * endUs / 1000.0, config_.minutes);
+        printf("%s: worst follower %.0f us (target < %d us)\n", worst <= TARGET_ERROR_US ? "PASS" : "FAIL", worst,
+               TARGET_ERROR_US);
+    }
+
+    SimConfig config_;
+    std::mt19937 rng_;
+    std::vector<SimNode> nodes_;
+    std::priority_queue<Delivery, std::vector<Delivery>, std::greater<Delivery>> queue_;
+    uint64_t now_ = 0;
+    uint64_t order_ = 0;
+    unsigned long packets_ = 0;
+    unsigned long lost_ = 0;
+};
+
+static void printUsage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [--nodes n] [--minutes m] [--latency us] [--jitter us] [--loss pct] [--drift ppm] "
+            "[--seed n] [--csv out.csv]\n",
+            argv0);
+}
+
+int main(int argc, char** argv) {
+    SimConfig config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--nodes") config.followers = std::max(1, atoi(value));
+        else if (arg == "--minutes") config.minutes = atof(value);
+        else if (arg == "--latency") config.latencyUs = atof(value);
+        else if (arg == "--jitter") config.jitterUs = atof(value);
+        else if (arg == "--loss") config.lossPercent = atof(value);
+        else if (arg == "--drift") config.driftPpm = atof(value);
+        else if (arg == "--seed") config.seed = (unsigned)atoi(value);
+        else if (arg == "--csv") config.csvPath = value;
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    Serial.setEnabled(false);
+    Simulation simulation(config);
+    return simulation.run();
+}
@@ -0,0 +1,290 @@
+// Batch scenario: an app restoring a preset with one BLE_FEATURE_BATCH write
+// instead of one write per setting.
+//
+// A complete BMDevice runs against HostArduino's BLE shim, with a simulated
+// app on the other end of a BleLink. The preset is an effect, a palette, a
+// speed, a color and --params effect parameters. The app sends it twice, each
+// time to a fresh prop:
+// - separately, one write request per setting, each after the response to
+//   the one before (ATT allows one request in flight);
+// - as one batch write.
+// Each run starts half a connection interval after an event and ends when
+// the prop's state holds the whole preset. Then the batched prop is sent a
+// batch with one invalid record, and a truncated batch.
+//
+// Usage:
+//   device_sim batch [options]
+//     --params <n>         effect parameters in the preset, 0-14 (default 5)
+//     --interval <ms>      connection interval (default 30)
+//
+// Exits non-zero unless the batch leaves the same state as the separate
+// writes, in less time and with one light show rebuild, and the invalid
+// batches change nothing.
+
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+#include <Preferences.h>
+#include <BMDevice.h>
+#include "BleLink.h"
+#include "DeviceFixture.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define BATCH_STEP_US 1000ULL
+#define BATCH_TIMEOUT_US 10000000ULL
+#define BATCH_FLASH_FREQUENCY_INDEX (BLE_FEATURE_FLASH_FREQUENCY - BLE_FEATURE_WAVE_WIDTH)
+
+namespace {
+
+struct BatchConfig {
+    int params = 5;
+    double intervalMs = 30;
+};
+
+struct RunResult {
+    double appliedMs = -1;      // -1: the preset never fully applied
+    uint64_t writes = 0;
+    size_t writeBytes = 0;
+    uint32_t rebuilds = 0;      // Light show updates until applied
+    bool invalidRejected = false;
+    bool truncatedRejected = false;
+};
+
+// A preset as BLE commands, each [feature, payload...]
+struct Preset {
+    LightSceneID effect = LightSceneID::lava_lamp;
+    AvailablePalettes palette = AvailablePalettes::moltenmetal;
+    int speed = 120;
+    CRGB color = CRGB(255, 64, 0);
+    std::vector<int> params;
+
+    explicit Preset(int count) {
+        for (int i = 0; i < count; i++) {
+            params.push_back(i == BATCH_FLASH_FREQUENCY_INDEX ? 300 : 2 + i % 8);
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> commands() const {
+        std::vector<std::vector<uint8_t>> commands = {
+            {BLE_FEATURE_EFFECT, (uint8_t)effect},
+            {BLE_FEATURE_PALETTE, (uint8_t)palette},
+            withInt(BLE_FEATURE_SPEED, speed),
+            {BLE_FEATURE_COLOR, color.r, color.g, color.b},
+        };
+        for (size_t i = 0; i < params.size(); i++) {
+            commands.push_back(withInt(BLE_FEATURE_WAVE_WIDTH + i, params[i]));
+        }
+        return commands;
+    }
+
+    bool appliedTo(BMDeviceState& state) const {
+        if (state.currentEffect != effect || state.currentPalette != palette || state.speed != speed ||
+            state.effectColor != color) {
+            return false;
+        }
+        for (size_t i = 0; i < params.size(); i++) {
+            if (state.getEffectParameter(i) != params[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+};
+
+std::vector<uint8_t> batchOf(const std::vector<std::vector<uint8_t>>& commands) {
+    std::vector<uint8_t> batch = {BLE_FEATURE_BATCH, (uint8_t)commands.size()};
+    for (const std::vector<uint8_t>& command : commands) {
+        batch.push_back(command[0]);
+        batch.push_back((uint8_t)(command.size() - 1));
+        batch.insert(batch.end(), command.begin() + 1, command.end());
+    }
+    return batch;
+}
+
+class BatchSim {
+public:
+    BatchSim(const BatchConfig& config, bool batched)
+        : config_(config), batched_(batched), preset_(config.params), link_(linkModel(config)) {}
+
+    RunResult run() {
+        device_ = newDevice();
+        powerOn(*device_);
+        HostBle::onNotify([this](const char* uuid, const uint8_t* data, size_t length) {
+            (void)uuid;
+            (void)data;
+            link_.notify(HostTime::micros(), length);
+        });
+        HostBle::connect();
+        // The app starts half a connection interval after an event, the
+        // average wait
+        uint64_t intervalUs = (uint64_t)(config_.intervalMs * 1000);
+        uint64_t settledUs = HostTime::micros() + 1000000;
+        runUntil(settledUs - settledUs % intervalUs + intervalUs + intervalUs / 2, nullptr);
+
+        // The app sends the preset
+        if (batched_) {
+            pending_.push_back(batchOf(preset_.commands()));
+        } else {
+            pending_ = preset_.commands();
+        }
+        uint64_t startUs = HostTime::micros();
+        uint32_t rebuilds = device_->getLightShowUpdateCount();
+        BleLinkStats before = link_.stats();
+        appWriteNext();
+        runUntil(startUs + BATCH_TIMEOUT_US, [this]() { return preset_.appliedTo(device_->getState()); });
+        if (preset_.appliedTo(device_->getState())) {
+            result_.appliedMs = (HostTime::micros() - startUs) / 1000.0;
+        }
+        result_.rebuilds = device_->getLightShowUpdateCount() - rebuilds;
+        result_.writes = link_.stats().writes - before.writes;
+
+        if (batched_) {
+            checkInvalid();
+        }
+        HostBle::disconnect();
+        return result_;
+    }
+
+private:
+    static BleLinkModel linkModel(const BatchConfig& config) {
+        BleLinkModel model;
+        model.intervalUs = config.intervalMs * 1000;
+        return model;
+    }
+
+    // Steps the prop and delivers the app's writes until untilUs or done()
+    void runUntil(uint64_t untilUs, std::function<bool()> done) {
+        for (uint64_t nowUs = HostTime::micros(); nowUs < untilUs; nowUs += BATCH_STEP_US) {
+            HostTime::setMicros(nowUs);
+            while (!writes_.empty() && writes_.begin()->first <= nowUs) {
+                std::vector<uint8_t> data = writes_.begin()->second;
+                writes_.erase(writes_.begin());
+                writeFeature(data);
+            }
+            if (nextWriteUs_ && nextWriteUs_ <= nowUs) {
+                nextWriteUs_ = 0;
+                appWriteNext();
+            }
+            device_->loop();
+            if (done && done()) {
+                return;
+            }
+        }
+        HostTime::setMicros(untilUs);
+    }
+
+    void appWriteNext() {
+        if (pending_.empty()) {
+            return;
+        }
+        std::vector<uint8_t> data = pending_.front();
+        pending_.erase(pending_.begin());
+        uint64_t responseUs = 0;
+        uint64_t atUs = link_.write(HostTime::micros(), data.size(), &responseUs);
+        writes_.insert({atUs, data});
+        result_.writeBytes += data.size();
+        nextWriteUs_ = pending_.empty() ? 0 : responseUs;
+    }
+
+    // Rejected batches leave the state and the light show alone
+    bool rejects(const std::vector<uint8_t>& batch) {
+        BMDeviceState& state = device_->getState();
+        uint32_t generation = state.getGeneration();
+        uint32_t rebuilds = device_->getLightShowUpdateCount();
+        writeFeature(batch);
+        runUntil(HostTime::micros() + 100 * BATCH_STEP_US, nullptr);
+        return state.getGeneration() == generation && device_->getLightShowUpdateCount() == rebuilds;
+    }
+
+    void checkInvalid() {
+        // The defaults again, but with an effect ID that doesn't exist last
+        Preset defaults(config_.params);
+        defaults.effect = LightSceneID::palette_stream;
+        defaults.palette = AvailablePalettes::cool;
+        std::vector<std::vector<uint8_t>> commands = defaults.commands();
+        commands.push_back({BLE_FEATURE_EFFECT, 0xEE});
+        result_.invalidRejected = rejects(batchOf(commands));
+
+        std::vector<uint8_t> truncated = batchOf(defaults.commands());
+        truncated.pop_back();
+        result_.truncatedRejected = rejects(truncated);
+    }
+
+    BatchConfig config_;
+    bool batched_;
+    Preset preset_;
+    BleLink link_;
+    std::unique_ptr<BMDevice> device_;
+    std::vector<std::vector<uint8_t>> pending_;
+    std::multimap<uint64_t, std::vector<uint8_t>> writes_;
+    uint64_t nextWriteUs_ = 0;
+    RunResult result_;
+};
+
+void printUsage(const char* argv0) {
+    fprintf(stderr, "usage: %s batch [--params n] [--interval ms]\n", argv0);
+}
+
+void printRun(const char* name, const RunResult& run) {
+    if (run.appliedMs < 0) {
+        printf("%-9s %3llu write%s, %4zu B, never applied, %u light show rebuilds\n", name,
+               (unsigned long long)run.writes, run.writes == 1 ? " " : "s", run.writeBytes, run.rebuilds);
+        return;
+    }
+    printf("%-9s %3llu write%s, %4zu B, applied after %7.1f ms, %u light show rebuild%s\n", name,
+           (unsigned long long)run.writes, run.writes == 1 ? " " : "s", run.writeBytes, run.appliedMs, run.rebuilds,
+           run.rebuilds == 1 ? "" : "s");
+}
+
+}
+
+int runBatch(int argc, char** argv) {
+    BatchConfig config;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--params") config.params = std::min(STATE_EFFECT_PARAMETER_COUNT, std::max(0, atoi(value)));
+        else if (arg == "--interval") config.intervalMs = std::max(7.5, atof(value));
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    int commands = 4 + config.params;
+    printf("\n--- Preset restore: effect, palette, speed, color and %d parameters (%d commands) ---\n",
+           config.params, commands);
+    printf("Link:     185 B MTU, %.1f ms interval\n", config.intervalMs);
+    RunResult separate = BatchSim(config, false).run();
+    RunResult batched = BatchSim(config, true).run();
+    printRun("Separate:", separate);
+    printRun("Batch:", batched);
+    printf("Invalid:  bad effect ID %s, truncated batch %s\n",
+           batched.invalidRejected ? "rejected whole" : "partly applied",
+           batched.truncatedRejected ? "rejected whole" : "partly applied");
+
+    bool applied = separate.appliedMs >= 0 && batched.appliedMs >= 0;
+    bool ok = applied && batched.appliedMs < separate.appliedMs && batched.rebuilds == 1 &&
+              batched.invalidRejected && batched.truncatedRejected;
+    if (applied) {
+        printf("%s: applied in %.1f -> %.1f ms, %u -> %u rebuilds, invalid batches %s (target: faster, 1 rebuild, "
+               "rejected)\n",
+               ok ? "PASS" : "FAIL", separate.appliedMs, batched.appliedMs, separate.rebuilds, batched.rebuilds,
+               batched.invalidRejected && batched.truncatedRejected ? "rejected" : "applied");
+    } else {
+        printf("FAIL: the preset never fully applied\n");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+#include "BleLink.h"
+
+#include <algorithm>
+
+#define ATT_NOTIFY_HEADER 3     // Opcode, handle
+#define ATT_WRITE_HEADER 3
+#define ATT_WRITE_RESPONSE 1
+#define ATT_READ_BLOB_REQUEST 5 // Opcode, handle, offset
+#define ATT_READ_BLOB_HEADER 1
+
+uint64_t BleLink::send(Direction& direction, uint64_t nowUs, size_t attBytes) {
+    uint64_t interval = (uint64_t)model_.intervalUs;
+    size_t remaining = attBytes + model_.l2capBytes;
+    uint64_t endUs = nowUs;
+    while (remaining > 0) {
+        size_t payload = std::min(remaining, (size_t)model_.llPayload);
+        remaining -= payload;
+
+        // Each packet and its (empty) reply take a turn in the event
+        double packetUs = (model_.llOverheadBytes + payload) * 8 / model_.phyMbps;
+        double turnUs = packetUs + model_.ifsUs + model_.llOverheadBytes * 8 / model_.phyMbps + model_.ifsUs;
+
+        // The first event at or after nowUs with room left
+        uint64_t event = (nowUs + interval - 1) / interval;
+        if (event < direction.event) {
+            event = direction.event;
+        }
+        if (event == direction.event &&
+            (direction.used >= model_.packetsPerEvent ||
+             (model_.eventUs > 0 && direction.used > 0 && direction.usedUs + turnUs > model_.eventUs))) {
+            event++;
+        }
+        if (event != direction.event) {
+            direction.event = event;
+            direction.used = 0;
+            direction.usedUs = 0;
+        }
+        endUs = event * interval + (uint64_t)(direction.usedUs + packetUs);
+        direction.used++;
+        direction.usedUs += turnUs;
+
+        stats_.airBytes += model_.llOverheadBytes + payload;
+        stats_.packets++;
+    }
+    return endUs;
+}
+
+uint64_t BleLink::notify(uint64_t nowUs, size_t length) {
+    size_t first = std::min(length, (size_t)model_.mtu - ATT_NOTIFY_HEADER);
+    uint64_t atUs = send(toApp_, nowUs, ATT_NOTIFY_HEADER + first);
+    stats_.notifications++;
+    stats_.valueBytes += length;
+
+    for (size_t offset = first; offset < length;) {
+        size_t part = std::min(length - offset, (size_t)model_.mtu - ATT_READ_BLOB_HEADER);
+        // The request goes in the next event, the response in the one after
+        atUs = send(toProp_, atUs + 1, ATT_READ_BLOB_REQUEST);
+        atUs = send(toApp_, atUs + 1, ATT_READ_BLOB_HEADER + part);
+        offset += part;
+        stats_.readBlobs++;
+    }
+    return atUs;
+}
+
+uint64_t BleLink::write(uint64_t nowUs, size_t length, uint64_t* responseAtUs) {
+    uint64_t atUs = send(toProp_, nowUs, ATT_WRITE_HEADER + length);
+    // The response goes back in a later event
+    uint64_t responseUs = send(toApp_, atUs + 1, ATT_WRITE_RESPONSE);
+    if (responseAtUs) {
+        *responseAtUs = responseUs;
+    }
+    stats_.writes++;
+    return atUs;
+}
+
+uint64_t BleLink::command(uint64_t nowUs, size_t length) {
+    stats_.writes++;
+    return send(toProp_, nowUs, ATT_WRITE_HEADER + length);
+}
+
+void BleLink::reset() {
+    toApp_ = Direction();
+    toProp_ = Direction();
+}
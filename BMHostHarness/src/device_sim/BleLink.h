@@ -0,0 +1,75 @@
+#ifndef DEVICE_SIM_BLE_LINK_H
+#define DEVICE_SIM_BLE_LINK_H
+
+#include <cstddef>
+#include <cstdint>
+
+// A BLE connection between a prop and a phone, at the link layer.
+//
+// Connection events come every intervalUs; in each, up to packetsPerEvent
+// LL data packets go each way. An ATT PDU plus its L2CAP header is split
+// into LL packets of at most llPayload bytes (27, or 251 with Data Length
+// Extension), each with llOverheadBytes of preamble, access address, header
+// and CRC on air. A notification carries at most mtu - 3 bytes of value; the
+// app reads the rest with Read Blob requests, a round trip of two events per
+// mtu - 1 bytes. Where eventUs is set, an event also ends once the next
+// packet and its reply would run past it, so a faster PHY fits more of them.
+// Empty packets that keep the connection alive are the same whatever is
+// sent, and are not counted.
+struct BleLinkModel {
+    int mtu = 185;              // iOS's usual ATT MTU
+    int llPayload = 27;
+    int llOverheadBytes = 10;
+    int l2capBytes = 4;
+    double intervalUs = 30000;
+    int packetsPerEvent = 4;
+    double eventUs = 0;         // 0: only packetsPerEvent limits an event
+    double phyMbps = 1.0;
+    double ifsUs = 150;
+};
+
+struct BleLinkStats {
+    uint64_t airBytes = 0;      // LL packets, both directions
+    uint64_t packets = 0;
+    uint64_t notifications = 0;
+    uint64_t valueBytes = 0;    // Notified values, as the application sees them
+    uint64_t readBlobs = 0;
+    uint64_t writes = 0;
+};
+
+class BleLink {
+public:
+    explicit BleLink(const BleLinkModel& model) : model_(model) {}
+
+    // A notification of length value bytes queued at nowUs; returns when the
+    // app has all of it
+    uint64_t notify(uint64_t nowUs, size_t length);
+    // A write request of length value bytes from the app, queued at nowUs;
+    // returns when it reaches the prop, and sets responseAtUs (if given) to
+    // when the app has the write response and may send its next request
+    uint64_t write(uint64_t nowUs, size_t length, uint64_t* responseAtUs = nullptr);
+    // A write without response (a write command): returns when it reaches
+    // the prop, and the app may send the next one right away
+    uint64_t command(uint64_t nowUs, size_t length);
+
+    // A new connection: nothing queued
+    void reset();
+    const BleLinkStats& stats() const { return stats_; }
+
+private:
+    struct Direction {
+        uint64_t event = 0;     // Last event used...
+        int used = 0;           // ...and the packets it already carries,
+        double usedUs = 0;      // and how long they take
+    };
+
+    // Returns when the last LL packet of the PDU ends
+    uint64_t send(Direction& direction, uint64_t nowUs, size_t attBytes);
+
+    BleLinkModel model_;
+    Direction toApp_;
+    Direction toProp_;
+    BleLinkStats stats_;
+};
+
+#endif // DEVICE_SIM_BLE_LINK_H
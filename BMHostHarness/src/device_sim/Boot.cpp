@@ -0,0 +1,332 @@
+// Boot scenario: BMDevice's staged boot, first photon before anything slow.
+//
+// A complete BMDevice with one strip of --leds LEDs and GPS enabled, as
+// BTBackpackV2 sets it up, on a virtual clock that only delay() and the
+// simulation move. Checks:
+// - cold boot: the first frame is on the LEDs when begin() returns, within
+//   --budget-ms of power on, with the defaults' scene, and Bluetooth is not
+//   advertising yet;
+// - stages: GPS, Bluetooth and ready each follow in a later loop(), in
+//   BootStage order, with no stage time going backwards, and nothing after
+//   the first frame blocks (the GPS stage used to wait 2 s for NMEA);
+// - warm reset: after the app changes the scene, a new BMDevice (what a
+//   brownout or watchdog reset leaves) shows that scene from its first
+//   frame, not the defaults';
+// - power cycle: with the snapshot gone (BMSceneSnapshot::clear()) the
+//   defaults are back;
+// - status: the binary status carries the boot profile and the restored
+//   flag, and the basicStatus chunk a "boot" array.
+//
+// Usage:
+//   device_sim boot [options]
+//     --leds <n>           LEDs on the strip (default 300)
+//     --budget-ms <ms>     first frame after power on (default 200)
+//
+// Exits non-zero if any check fails.
+
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+#include <Preferences.h>
+#include <BMDevice.h>
+#include <BMSceneSnapshot.h>
+#include "DeviceFixture.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define BOOT_MAX_LEDS 1000
+#define BOOT_MAX_LOOPS 100
+#define BOOT_STAGE_BLOCK_MS 50      // What a stage after the first frame may hold up the loop
+
+namespace {
+
+CRGB bootLeds[BOOT_MAX_LEDS];
+
+const char* const stageNames[BOOT_STAGE_COUNT] = {"settings", "scene", "first frame", "GPS", "Bluetooth", "ready"};
+
+struct Check {
+    std::string name;
+    bool ok;
+    std::string detail;
+};
+
+// The scene the app sets before the reset; none of it the defaults'
+struct Scene {
+    int brightness;
+    int speed;
+    uint8_t effect;
+    uint8_t palette;
+    uint8_t direction;
+    int parameter;      // The first effect parameter
+    uint8_t color[3];
+};
+
+const Scene appScene = {60, 140, (uint8_t)LightSceneID::meteor_shower, (uint8_t)AvailablePalettes::lava, 1, 7,
+                        {0x20, 0xC0, 0x40}};
+
+class BootCheck {
+public:
+    BootCheck(int leds, int budgetMs) : leds_(leds), budgetMs_(budgetMs) {}
+
+    std::vector<Check> run() {
+        HostPreferences::erase();
+        BMSceneSnapshot::clear();
+
+        checkColdBoot();
+        checkStages();
+        setScene();
+        checkWarmReset();
+        checkStatus();
+        checkPowerCycle();
+
+        HostBle::disconnect();
+        device_.reset();
+        return checks_;
+    }
+
+private:
+    void add(const std::string& name, bool ok, const std::string& detail) { checks_.push_back({name, ok, detail}); }
+
+    // A new BMDevice on the clock as power on leaves it, up to the end of
+    // begin()
+    void start() {
+        if (device_) {
+            HostBle::disconnect();
+            device_.reset();
+        }
+        memset(bootLeds, 0, sizeof(bootLeds));
+        device_ = newDevice(true);
+        device_->addLEDStrip<WS2812B, 27, GRB>(bootLeds, leds_);
+        device_->enableGPS();
+        auto wallStart = std::chrono::steady_clock::now();
+        begun_ = device_->begin();
+        beginUs_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                         wallStart).count();
+    }
+
+    void loopUntilBooted() {
+        loops_ = 0;
+        while (!device_->isBootComplete() && loops_ < BOOT_MAX_LOOPS) {
+            HostTime::setMicros(HostTime::micros() + 1000);
+            device_->loop();
+            loops_++;
+            // Which loop() each stage finished in
+            for (int s = BOOT_FIRST_FRAME + 1; s < BOOT_STAGE_COUNT; s++) {
+                if (device_->getBootProfile().stageMs[s] != BOOT_STAGE_PENDING && stageLoop_[s] == 0) {
+                    stageLoop_[s] = loops_;
+                }
+            }
+        }
+    }
+
+    void loop(int steps) {
+        for (int i = 0; i < steps; i++) {
+            HostTime::setMicros(HostTime::micros() + 1000);
+            device_->loop();
+        }
+    }
+
+    size_t litLeds() const {
+        return std::count_if(bootLeds, bootLeds + leds_, [](const CRGB& c) { return c != CRGB::Black; });
+    }
+
+    std::string describeProfile() const {
+        const BootProfile& profile = device_->getBootProfile();
+        std::string out;
+        for (int s = 0; s < BOOT_STAGE_COUNT; s++) {
+            char stage[48];
+            if (profile.stageMs[s] == BOOT_STAGE_PENDING) {
+                snprintf(stage, sizeof(stage), "%s%s -", s ? ", " : "", stageNames[s]);
+            } else {
+                snprintf(stage, sizeof(stage), "%s%s %u", s ? ", " : "", stageNames[s], profile.stageMs[s]);
+            }
+            out += stage;
+        }
+        return out + " ms";
+    }
+
+    void checkColdBoot() {
+        start();
+        const BootProfile& profile = device_->getBootProfile();
+        const DeviceDefaults& defaults = device_->getDefaults().getCurrentDefaults();
+        const BMDeviceState& state = device_->getState();
+        uint16_t firstFrame = profile.stageMs[BOOT_FIRST_FRAME];
+        size_t lit = litLeds();
+        bool deferred = !BLE.advertising() && profile.stageMs[BOOT_GPS] == BOOT_STAGE_PENDING &&
+                        profile.stageMs[BOOT_BLUETOOTH] == BOOT_STAGE_PENDING;
+        bool scene = !profile.sceneRestored && state.currentEffect == defaults.effect &&
+                     state.currentPalette == defaults.palette;
+        char detail[200];
+        snprintf(detail, sizeof(detail), "%u ms (budget %d), %zu of %d LEDs lit, begin() %lld us on this host",
+                 firstFrame, budgetMs_, lit, leds_, (long long)beginUs_);
+        add("First photon", begun_ && firstFrame <= budgetMs_ && lit > 0, detail);
+        snprintf(detail, sizeof(detail), "defaults' effect %u and palette %u, %s", (unsigned)state.currentEffect,
+                 (unsigned)state.currentPalette, profile.sceneRestored ? "snapshot restored" : "no snapshot");
+        add("Cold scene", scene, detail);
+        add("Deferred", deferred,
+            std::string("Bluetooth ") + (BLE.advertising() ? "already advertising" : "not advertising") +
+                " when begin() returns");
+    }
+
+    void checkStages() {
+        memset(stageLoop_, 0, sizeof(stageLoop_));
+        loopUntilBooted();
+        const BootProfile& profile = device_->getBootProfile();
+        bool ordered = true;
+        for (int s = 1; s < BOOT_STAGE_COUNT; s++) {
+            ordered &= profile.stageMs[s] != BOOT_STAGE_PENDING && profile.stageMs[s] != BOOT_STAGE_FAILED &&
+                       profile.stageMs[s] >= profile.stageMs[s - 1];
+        }
+        for (int s = BOOT_GPS; s < BOOT_STAGE_COUNT; s++) {
+            ordered &= stageLoop_[s] > stageLoop_[s - 1] || s == BOOT_GPS;
+        }
+        ordered &= stageLoop_[BOOT_GPS] >= 1 && BLE.advertising();
+        char detail[200];
+        snprintf(detail, sizeof(detail), "%s; GPS, Bluetooth, ready in loops %d, %d, %d", describeProfile().c_str(),
+                 stageLoop_[BOOT_GPS], stageLoop_[BOOT_BLUETOOTH], stageLoop_[BOOT_READY]);
+        add("Stage order", ordered && device_->isBootComplete(), detail);
+
+        int gpsMs = profile.stageMs[BOOT_GPS] - profile.stageMs[BOOT_FIRST_FRAME];
+        int restMs = profile.stageMs[BOOT_READY] - profile.stageMs[BOOT_FIRST_FRAME];
+        snprintf(detail, sizeof(detail), "GPS stage %d ms, first frame to ready %d ms over %d loops", gpsMs, restMs,
+                 loops_);
+        add("Non-blocking", restMs <= BOOT_STAGE_BLOCK_MS + loops_, detail);
+    }
+
+    // The app sets a scene of its own, then the prop is left running
+    void setScene() {
+        HostBle::connect();
+        loop(10);
+        writeFeature(withInt(BLE_FEATURE_BRIGHTNESS, appScene.brightness));
+        writeFeature(withInt(BLE_FEATURE_SPEED, appScene.speed));
+        writeFeature({BLE_FEATURE_EFFECT, appScene.effect});
+        writeFeature({BLE_FEATURE_PALETTE, appScene.palette});
+        writeFeature({BLE_FEATURE_DIRECTION, appScene.direction});
+        writeFeature(withInt(BLE_FEATURE_WAVE_WIDTH, appScene.parameter));
+        writeFeature({BLE_FEATURE_COLOR, appScene.color[0], appScene.color[1], appScene.color[2]});
+        loop(100);
+        const BMDeviceState& state = device_->getState();
+        before_ = describeScene(state);
+    }
+
+    static std::string describeScene(const BMDeviceState& state) {
+        char scene[160];
+        snprintf(scene, sizeof(scene), "effect %u, palette %u, brightness %d, speed %u, dir %d, param %d, "
+                 "color %02X%02X%02X", (unsigned)state.currentEffect, (unsigned)state.currentPalette, state.brightness, state.speed,
+                 state.reverseStrip, state.getEffectParameter(0), state.effectColor.r, state.effectColor.g,
+                 state.effectColor.b);
+        return scene;
+    }
+
+    void checkWarmReset() {
+        start();
+        const BMDeviceState& state = device_->getState();
+        std::string after = describeScene(state);
+        bool sceneSet = state.currentEffect == (LightSceneID)appScene.effect &&
+                        state.currentPalette == (AvailablePalettes)appScene.palette;
+        bool restored = device_->getBootProfile().sceneRestored && after == before_ && sceneSet &&
+                        device_->getLightShow().getShowCount() > 0;
+        add("Warm reset", restored, (device_->getBootProfile().sceneRestored ? "restored " : "NOT restored ") + after +
+                                        (after == before_ ? "" : " (was " + before_ + ")"));
+        loopUntilBooted();
+    }
+
+    void checkStatus() {
+        bool binary = false;
+        bool restoredFlag = false;
+        bool json = false;
+        std::vector<uint8_t> expected;
+        for (int s = 0; s < BOOT_STAGE_COUNT; s++) {
+            uint16_t ms = device_->getBootProfile().stageMs[s];
+            expected.push_back((uint8_t)ms);
+            expected.push_back((uint8_t)(ms >> 8));
+        }
+        HostBle::onNotify([&](const char*, const uint8_t* data, size_t length) {
+            if (length > 0 && data[0] == '{') {
+                json |= memmem(data, length, "\"boot\":[", 8) != nullptr;
+                return;
+            }
+            StatusMessageHeader header;
+            parseStatusMessage(data, length, header, [&](uint8_t tag, const uint8_t* value, size_t valueLength) {
+                if (tag == STATUS_BOOT_PROFILE) {
+                    binary = valueLength == expected.size() && memcmp(value, expected.data(), valueLength) == 0;
+                } else if (tag == STATUS_SCENE_RESTORED) {
+                    restoredFlag = valueLength == 1 && value[0] == 1;
+                }
+            });
+        });
+        HostBle::connect();
+        loop(100);
+        device_->setStatusFormat(STATUS_FORMAT_JSON);
+        device_->startChunkedStatusUpdate();
+        loop(5 * STATUS_UPDATE_DELAY + 5);
+        device_->setStatusFormat(STATUS_FORMAT_BINARY);
+        HostBle::onNotify(nullptr);
+        char detail[160];
+        snprintf(detail, sizeof(detail), "binary boot profile %s, restored flag %s, JSON boot array %s",
+                 binary ? "matches" : "missing", restoredFlag ? "set" : "missing", json ? "present" : "missing");
+        add("Status", binary && restoredFlag && json, detail);
+    }
+
+    void checkPowerCycle() {
+        BMSceneSnapshot::clear();
+        start();
+        const DeviceDefaults& defaults = device_->getDefaults().getCurrentDefaults();
+        const BMDeviceState& state = device_->getState();
+        bool fallback = !device_->getBootProfile().sceneRestored && state.currentEffect == defaults.effect &&
+                        state.currentPalette == defaults.palette;
+        add("Power cycle", fallback, describeScene(state));
+        loopUntilBooted();
+    }
+
+    int leds_;
+    int budgetMs_;
+    std::unique_ptr<BMDevice> device_;
+    bool begun_ = false;
+    long long beginUs_ = 0;
+    int loops_ = 0;
+    int stageLoop_[BOOT_STAGE_COUNT] = {};
+    std::string before_;
+    std::vector<Check> checks_;
+};
+
+void printUsage(const char* argv0) { fprintf(stderr, "usage: %s boot [--leds n] [--budget-ms ms]\n", argv0); }
+
+}
+
+int runBoot(int argc, char** argv) {
+    int leds = 300;
+    int budgetMs = 200;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--leds") leds = std::min(BOOT_MAX_LEDS, std::max(1, atoi(value)));
+        else if (arg == "--budget-ms") budgetMs = std::max(0, atoi(value));
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    printf("\n--- Staged boot ---\n");
+    BootCheck check(leds, budgetMs);
+    std::vector<Check> checks = check.run();
+    int failures = 0;
+    for (const Check& c : checks) {
+        printf("%-14s %s: %s\n", (c.name + ":").c_str(), c.ok ? "ok" : "FAILED", c.detail.c_str());
+        failures += !c.ok;
+    }
+    printf("%s: %d of %zu checks failed\n", failures == 0 ? "PASS" : "FAIL", failures, checks.size());
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,347 @@
+// Defaults scenario: BMDeviceDefaults' write-behind commits, counted against
+// HostPreferences as NVS writes.
+//
+// Interactions: a complete BMDevice with the app connected straight to
+// HostBle. Each interaction is sent, then the prop is left alone until its
+// defaults are committed. Sliders (--steps writes, --step-ms apart) must not
+// write while they move and must cost one commit after; saving the current
+// state and switching off must commit at once; an idle prop writes nothing.
+//
+// Power loss: two commits fill both records, then a third is cut short after
+// every possible number of bytes. Each time the defaults are loaded again
+// they must be the second or the third commit, never a mix, and a commit
+// after that must land and load. Flipping any bit of the newest record must
+// bring back the one before it. Defaults left by the per-key layout are read
+// and converted to a record with one write.
+//
+// Usage:
+//   device_sim defaults [options]
+//     --steps <n>          writes per slider drag (default 40)
+//     --step-ms <ms>       time between slider writes (default 30)
+//
+// Exits non-zero if any check fails.
+
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+#include <Preferences.h>
+#include <BMDevice.h>
+#include "DeviceFixture.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define DEFAULTS_STEP_US 1000ULL
+#define DEFAULTS_SETTLE_US ((DEFAULTS_COMMIT_IDLE_MS + 500) * 1000ULL)
+
+namespace {
+
+struct DefaultsConfig {
+    int steps = 40;
+    double stepMs = 30;
+};
+
+struct Check {
+    std::string name;
+    bool ok;
+    std::string detail;
+};
+
+struct Interaction {
+    std::string name;
+    std::vector<std::vector<uint8_t>> writes;
+    bool immediate;             // Must commit in the loop() that handles it
+};
+
+// The settings a record holds, to tell commits apart
+std::string describe(const DeviceDefaults& d) {
+    char text[256];
+    snprintf(text, sizeof(text), "%d/%d/%d/%d/%d/%d/%d/%lu/%02x%02x%02x/%d/%.2f/%.2f/%d/%d/%d", d.brightness,
+             d.maxBrightness, d.speed, (int)d.palette, (int)d.effect, d.reverseDirection, d.autoOn,
+             d.statusUpdateInterval, d.effectColor.r, d.effectColor.g, d.effectColor.b, d.gpsEnabled, d.gpsLowSpeed,
+             d.gpsTopSpeed, d.gpsLightshowSpeedEnabled, d.syncEnabled, d.activeLEDStrips);
+    std::string out = text;
+    for (int i = 0; i < MAX_LED_STRIPS; i++) {
+        snprintf(text, sizeof(text), "|%d,%d,%d,%d", d.ledStrips[i].pin, d.ledStrips[i].numLeds,
+                 d.ledStrips[i].colorOrder, d.ledStrips[i].enabled);
+        out += text;
+    }
+    return out + "|" + d.owner + "|" + d.deviceName + "|" + d.deviceType;
+}
+
+// A distinct set of defaults per commit number
+void applyVersion(BMDeviceDefaults& defaults, int n) {
+    char owner[16];
+    snprintf(owner, sizeof(owner), "Owner %d", n);
+    defaults.setOwner(owner);
+    defaults.setMaxBrightness(60 + n);
+    defaults.setBrightness(20 + n);
+    defaults.setSpeed(50 + n);
+    defaults.setPalette((AvailablePalettes)(n % 4));
+    defaults.setEffectColor(CRGB(n, 2 * n, 3 * n));
+    defaults.setGPSLowSpeed(3.0f + n);
+    defaults.setGPSTopSpeed(30.0f + n);
+    defaults.setLEDStripConfig(1, 10 + n, 100 + n, n % 3, n % 2 == 0);
+}
+
+std::vector<uint8_t> recordAt(Preferences& preferences, const char* key) {
+    std::vector<uint8_t> record(preferences.getBytesLength(key));
+    preferences.getBytes(key, record.data(), record.size());
+    return record;
+}
+
+std::string loadedNow() {
+    BMDeviceDefaults defaults;
+    defaults.begin();
+    return describe(defaults.getCurrentDefaults());
+}
+
+class DefaultsCheck {
+public:
+    explicit DefaultsCheck(const DefaultsConfig& config) : config_(config) {}
+
+    std::vector<Check> run() {
+        checkInteractions();
+        checkPowerLoss();
+        checkBitFlips();
+        checkLegacy();
+        return checks_;
+    }
+
+private:
+    void add(const std::string& name, bool ok, const std::string& detail) { checks_.push_back({name, ok, detail}); }
+
+    void loopFor(uint64_t us) {
+        for (uint64_t end = HostTime::micros() + us; HostTime::micros() < end;) {
+            HostTime::setMicros(HostTime::micros() + DEFAULTS_STEP_US);
+            device_->loop();
+        }
+    }
+
+    void checkInteractions() {
+        device_ = newDevice();
+        powerOn(*device_);
+        HostBle::connect();
+        loopFor(DEFAULTS_SETTLE_US);
+
+        Interaction maxBrightness = {"Max brightness", {}, false};
+        Interaction gpsSpeed = {"GPS speed", {}, false};
+        for (int i = 0; i < config_.steps; i++) {
+            maxBrightness.writes.push_back(withInt(BLE_FEATURE_SET_MAX_BRIGHTNESS, 30 + i * 70 / config_.steps));
+            gpsSpeed.writes.push_back(withFloat(BLE_FEATURE_SET_GPS_LOW_SPEED, 2.0f + i * 0.25f));
+        }
+        std::vector<Interaction> interactions = {
+            maxBrightness,
+            gpsSpeed,
+            {"Owner, auto-on", {withString(BLE_FEATURE_SET_OWNER, "Playa"), {BLE_FEATURE_SET_AUTO_ON, 0}}, false},
+            {"Save current", {withInt(BLE_FEATURE_BRIGHTNESS, 80), {BLE_FEATURE_SAVE_CURRENT_AS_DEFAULTS}}, true},
+            {"Power off", {withString(BLE_FEATURE_SET_OWNER, "Camp"), {BLE_FEATURE_POWER, 0}}, true},
+        };
+        uint64_t stepUs = (uint64_t)(config_.stepMs * 1000);
+        for (const Interaction& interaction : interactions) {
+            unsigned long before = HostPreferences::writes();
+            for (size_t i = 0; i < interaction.writes.size(); i++) {
+                writeFeature(interaction.writes[i]);
+                loopFor(i + 1 < interaction.writes.size() ? stepUs : DEFAULTS_STEP_US);
+            }
+            unsigned long during = HostPreferences::writes() - before;
+            loopFor(DEFAULTS_SETTLE_US);
+            unsigned long total = HostPreferences::writes() - before;
+
+            bool ok = total == 1 && during == (interaction.immediate ? 1UL : 0UL);
+            char detail[160];
+            snprintf(detail, sizeof(detail), "%zu command%s, %lu write%s while sent, %lu once settled",
+                     interaction.writes.size(), interaction.writes.size() == 1 ? "" : "s", during,
+                     during == 1 ? "" : "s", total);
+            add(interaction.name, ok, detail);
+        }
+
+        unsigned long before = HostPreferences::writes();
+        loopFor(60 * 1000000ULL);
+        unsigned long quiet = HostPreferences::writes() - before;
+        add("Quiet", quiet == 0, std::to_string(quiet) + " writes in 60 s");
+
+        HostBle::disconnect();
+        device_.reset();
+    }
+
+    // Commits 1 and 2 fill both records; commit 3 is cut short
+    void checkPowerLoss() {
+        HostPreferences::erase();
+        std::string second;
+        size_t recordLength = 0;
+        {
+            BMDeviceDefaults defaults;
+            defaults.begin();
+            applyVersion(defaults, 1);
+            defaults.flush();
+            applyVersion(defaults, 2);
+            defaults.flush();
+            second = describe(defaults.getCurrentDefaults());
+            Preferences preferences;
+            preferences.begin(DEFAULTS_NAMESPACE, true);
+            recordLength = preferences.getBytesLength(DEFAULTS_RECORD_KEY_A);
+            preferences.end();
+        }
+
+        int cuts = 0;
+        int old = 0;
+        int fresh = 0;
+        int broken = 0;
+        int recovered = 0;
+        for (size_t bytes = 0; bytes <= recordLength; bytes++) {
+            HostPreferences::erase();
+            std::string third;
+            {
+                BMDeviceDefaults defaults;
+                defaults.begin();
+                applyVersion(defaults, 1);
+                defaults.flush();
+                applyVersion(defaults, 2);
+                defaults.flush();
+                applyVersion(defaults, 3);
+                third = describe(defaults.getCurrentDefaults());
+                HostPreferences::cutPowerAfter(bytes);
+                defaults.flush();
+            }
+            HostPreferences::restorePower();
+            cuts++;
+
+            std::string loaded = loadedNow();
+            old += loaded == second;
+            fresh += loaded == third;
+            broken += loaded != second && loaded != third;
+
+            // The next commit has to survive the damaged record
+            std::string fourth;
+            {
+                BMDeviceDefaults defaults;
+                defaults.begin();
+                applyVersion(defaults, 4);
+                defaults.flush();
+                fourth = describe(defaults.getCurrentDefaults());
+            }
+            recovered += loadedNow() == fourth;
+        }
+        char detail[160];
+        snprintf(detail, sizeof(detail), "%d cuts in a %zu B record: %d old, %d new, %d neither; %d next commits loaded",
+                 cuts, recordLength, old, fresh, broken, recovered);
+        add("Power loss", broken == 0 && fresh >= 1 && recovered == cuts, detail);
+    }
+
+    void checkBitFlips() {
+        HostPreferences::erase();
+        std::string first;
+        Preferences preferences;
+        preferences.begin(DEFAULTS_NAMESPACE, false);
+        const char* newest = DEFAULTS_RECORD_KEY_A;
+        {
+            BMDeviceDefaults defaults;
+            defaults.begin();
+            applyVersion(defaults, 1);
+            defaults.flush();
+            first = describe(defaults.getCurrentDefaults());
+            // The newest record is in whichever key the next commit changes
+            std::vector<uint8_t> before = recordAt(preferences, DEFAULTS_RECORD_KEY_A);
+            applyVersion(defaults, 2);
+            defaults.flush();
+            if (recordAt(preferences, DEFAULTS_RECORD_KEY_A) == before) {
+                newest = DEFAULTS_RECORD_KEY_B;
+            }
+        }
+        std::vector<uint8_t> record = recordAt(preferences, newest);
+
+        int flips = 0;
+        int fellBack = 0;
+        for (size_t bit = 0; bit < record.size() * 8; bit++) {
+            std::vector<uint8_t> damaged = record;
+            damaged[bit / 8] ^= 1 << (bit % 8);
+            preferences.putBytes(newest, damaged.data(), damaged.size());
+            flips++;
+            fellBack += loadedNow() == first;
+        }
+        preferences.end();
+        char detail[160];
+        snprintf(detail, sizeof(detail), "%d of %d flipped bits loaded the commit before", fellBack, flips);
+        add("Bit flips", flips > 0 && fellBack == flips, detail);
+    }
+
+    // What the per-key layout left in flash
+    void checkLegacy() {
+        HostPreferences::erase();
+        Preferences preferences;
+        preferences.begin(DEFAULTS_NAMESPACE, false);
+        preferences.putInt(PREF_VERSION, 1);
+        preferences.putInt(PREF_BRIGHTNESS, 64);
+        preferences.putInt(PREF_MAX_BRIGHTNESS, 90);
+        preferences.putString(PREF_OWNER, "Legacy");
+        preferences.putFloat(PREF_GPS_LOW_SPEED, 6.5f);
+        preferences.putInt(PREF_LED_COUNT, 2);
+        preferences.putString(PREF_LED_PINS,
+                              "[{\"pin\":4,\"leds\":60,\"enabled\":true},{\"pin\":5,\"leds\":120,\"enabled\":true}]");
+        preferences.putString(PREF_COLOR_ORDERS, "[0,1]");
+        preferences.end();
+
+        unsigned long before = HostPreferences::writes();
+        DeviceDefaults converted;
+        {
+            BMDeviceDefaults defaults;
+            defaults.begin();
+            converted = defaults.getCurrentDefaults();
+        }
+        unsigned long conversionWrites = HostPreferences::writes() - before;
+        before = HostPreferences::writes();
+        std::string reloaded = loadedNow();
+        unsigned long rebootWrites = HostPreferences::writes() - before;
+
+        bool kept = converted.brightness == 64 && converted.maxBrightness == 90 && strcmp(converted.owner, "Legacy") == 0 &&
+                    converted.gpsLowSpeed == 6.5f && converted.ledStrips[1].numLeds == 120 &&
+                    converted.ledStrips[1].colorOrder == 1;
+        bool ok = kept && conversionWrites == 1 && rebootWrites == 0 && reloaded == describe(converted);
+        char detail[160];
+        snprintf(detail, sizeof(detail), "settings %s, %lu write%s to convert, %lu on the next boot",
+                 kept ? "kept" : "lost", conversionWrites, conversionWrites == 1 ? "" : "s", rebootWrites);
+        add("Per-key layout", ok, detail);
+    }
+
+    DefaultsConfig config_;
+    std::unique_ptr<BMDevice> device_;
+    std::vector<Check> checks_;
+};
+
+void printUsage(const char* argv0) { fprintf(stderr, "usage: %s defaults [--steps n] [--step-ms ms]\n", argv0); }
+
+}
+
+int runDefaults(int argc, char** argv) {
+    DefaultsConfig config;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--steps") config.steps = std::max(1, atoi(value));
+        else if (arg == "--step-ms") config.stepMs = std::max(1.0, atof(value));
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    printf("\n--- Defaults: write-behind commits (commit after %d ms idle) ---\n", DEFAULTS_COMMIT_IDLE_MS);
+    std::vector<Check> checks = DefaultsCheck(config).run();
+    int failures = 0;
+    for (const Check& c : checks) {
+        printf("%-16s %s: %s\n", (c.name + ":").c_str(), c.ok ? "ok" : "FAILED", c.detail.c_str());
+        failures += !c.ok;
+    }
+    printf("%s: %d of %zu checks failed\n", failures == 0 ? "PASS" : "FAIL", failures, checks.size());
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+#include "DeviceFixture.h"
+
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+#include <Preferences.h>
+#include <BMDevice.h>
+#include <BMSceneSnapshot.h>
+
+#include <cstring>
+
+#define FIXTURE_MAX_BOOT_LOOPS 100
+
+std::unique_ptr<BMDevice> newDevice(bool keepPreferences) {
+    HostBle::reset();
+    if (!keepPreferences) {
+        HostPreferences::erase();
+    }
+    HostTime::setMicros(0);
+    return std::unique_ptr<BMDevice>(new BMDevice("BMProp", SIM_SERVICE_UUID, SIM_FEATURES_UUID, SIM_STATUS_UUID));
+}
+
+void powerOn(BMDevice& device) {
+    BMSceneSnapshot::clear();
+    device.begin();
+    for (int i = 0; i < FIXTURE_MAX_BOOT_LOOPS && !device.isBootComplete(); i++) {
+        device.loop();
+    }
+}
+
+std::vector<uint8_t> withInt(uint8_t feature, int value) {
+    std::vector<uint8_t> data(1 + sizeof(int));
+    data[0] = feature;
+    memcpy(data.data() + 1, &value, sizeof(int));
+    return data;
+}
+
+std::vector<uint8_t> withFloat(uint8_t feature, float value) {
+    std::vector<uint8_t> data(1 + sizeof(float));
+    data[0] = feature;
+    memcpy(data.data() + 1, &value, sizeof(float));
+    return data;
+}
+
+std::vector<uint8_t> withString(uint8_t feature, const char* value) {
+    std::vector<uint8_t> data(1 + strlen(value));
+    data[0] = feature;
+    memcpy(data.data() + 1, value, strlen(value));
+    return data;
+}
+
+void writeFeature(const uint8_t* data, size_t length) {
+    HostBle::write(SIM_FEATURES_UUID, data, length);
+}
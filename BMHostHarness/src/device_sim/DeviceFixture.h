@@ -0,0 +1,36 @@
+#ifndef DEVICE_SIM_DEVICE_FIXTURE_H
+#define DEVICE_SIM_DEVICE_FIXTURE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class BMDevice;
+
+// The service every scenario's prop advertises
+#define SIM_SERVICE_UUID "be3d7275-4bd2-4c41-b4c0-b3c4f1a6d5a1"
+#define SIM_FEATURES_UUID "be3d7275-4bd2-4c41-b4c0-b3c4f1a6d5a2"
+#define SIM_STATUS_UUID "be3d7275-4bd2-4c41-b4c0-b3c4f1a6d5a3"
+#define SIM_PREVIEW_UUID "be3d7275-4bd2-4c41-b4c0-b3c4f1a6d5a4"
+
+// A new BMDevice on a cold host: BLE shim reset, clock at 0 and, unless
+// keepPreferences (what a reset leaves), preferences erased. Not begun yet,
+// so strips, handlers and the like can be added before powerOn().
+std::unique_ptr<BMDevice> newDevice(bool keepPreferences = false);
+
+// Powers the prop on from cold (no scene snapshot) and runs its boot through,
+// so the app can connect; every scenario but boot starts this way
+void powerOn(BMDevice& device);
+
+// Feature commands as the app writes them: the feature byte, then the value
+// in the prop's own byte order
+std::vector<uint8_t> withInt(uint8_t feature, int value);
+std::vector<uint8_t> withFloat(uint8_t feature, float value);
+std::vector<uint8_t> withString(uint8_t feature, const char* value);
+
+// The app writes to the features characteristic, reaching the prop at once
+void writeFeature(const uint8_t* data, size_t length);
+inline void writeFeature(const std::vector<uint8_t>& data) { writeFeature(data.data(), data.size()); }
+
+#endif // DEVICE_SIM_DEVICE_FIXTURE_H
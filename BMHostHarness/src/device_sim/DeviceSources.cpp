@@ -0,0 +1,20 @@
+// BMDevice and what it links against, compiled directly against HostArduino's
+// BLE and Preferences shims, and the sound settings encoding from BMSound.
+#include "../../../libraries/BurningManLEDs/src/BMLog.cpp"
+#include "../../../libraries/BurningManLEDs/src/Clock.cpp"
+#include "../../../libraries/BurningManLEDs/src/LightShow.cpp"
+#include "../../../libraries/BurningManLEDs/src/Position.cpp"
+#include "../../../libraries/BurningManLEDs/src/LocationService.cpp"
+#include "../../../libraries/TinyGPSPlus/src/TinyGPS++.cpp"
+#include "../../../libraries/BMDevice/src/BMJsonPool.cpp"
+#include "../../../libraries/BMDevice/src/BMDeviceState.cpp"
+#include "../../../libraries/BMDevice/src/BMSettingsRecord.cpp"
+#include "../../../libraries/BMDevice/src/BMDeviceDefaults.cpp"
+#include "../../../libraries/BMDevice/src/BMSceneSnapshot.cpp"
+#include "../../../libraries/BMDevice/src/BMBluetoothHandler.cpp"
+#include "../../../libraries/BMDevice/src/BMStatusProtocol.cpp"
+#include "../../../libraries/BMDevice/src/BMPreviewProtocol.cpp"
+#include "../../../libraries/BMDevice/src/BMTransferProtocol.cpp"
+#include "../../../libraries/BMDevice/src/BMFeatureRegistry.cpp"
+#include "../../../libraries/BMDevice/src/BMDevice.cpp"
+#include "../../../libraries/BMSound/src/SoundSettings.cpp"
@@ -0,0 +1,259 @@
+// Features scenario: BMDevice's feature registry (BMFeatureRegistry.h).
+//
+// A complete BMDevice, with a sketch's "battery" namespace (0x50-0x5F, as
+// BatteryCharger registers it) and a legacy custom feature handler. Checks:
+// - registration: overlapping namespaces, opcodes outside their namespace
+//   and opcodes that already have a handler are refused;
+// - lengths: every core opcode written with a payload too short for it is
+//   rejected and counted, and changes no state;
+// - counters: --writes brightness commands show up as that many calls, each
+//   in one latency bucket;
+// - capabilities: BLE_FEATURE_GET_CAPABILITIES lists both namespaces and
+//   exactly the opcodes with handlers;
+// - the custom handler only sees opcodes nobody registered.
+// It also reports what one dispatch costs on the host.
+//
+// Usage:
+//   device_sim features [options]
+//     --writes <n>         brightness commands to count (default 1000)
+//
+// Exits non-zero if any check fails.
+
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+#include <Preferences.h>
+#include <BMDevice.h>
+#include "DeviceFixture.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define FEATURES_BATTERY "battery"
+#define FEATURES_BATTERY_FIRST 0x50
+#define FEATURES_BATTERY_LAST 0x5F
+#define FEATURES_UNREGISTERED 0x70
+#define FEATURES_TIMING_DISPATCHES 1000000
+
+namespace {
+
+struct Check {
+    std::string name;
+    bool ok;
+    std::string detail;
+};
+
+class FeaturesCheck {
+public:
+    explicit FeaturesCheck(int writes) : writes_(writes) {}
+
+    std::vector<Check> run() {
+        device_ = newDevice();
+        device_->setCustomFeatureHandler([this](uint8_t feature, const uint8_t*, size_t) {
+            customSeen_.push_back(feature);
+            return true;
+        });
+        powerOn(*device_);
+        HostBle::onNotify([this](const char*, const uint8_t* data, size_t length) {
+            lastNotification_.assign(data, data + length);
+        });
+        HostBle::connect();
+        loop(1000);
+
+        checkRegistration();
+        checkLengths();
+        checkCounters();
+        checkCapabilities();
+        checkCustomHandler();
+        measureDispatch();
+
+        HostBle::disconnect();
+        return checks_;
+    }
+
+    double dispatchNs() const { return dispatchNs_; }
+
+private:
+    void add(const std::string& name, bool ok, const std::string& detail) { checks_.push_back({name, ok, detail}); }
+
+    void loop(int steps) {
+        for (int i = 0; i < steps; i++) {
+            HostTime::setMicros(HostTime::micros() + 1000);
+            device_->loop();
+        }
+    }
+
+    void checkRegistration() {
+        BMFeatureRegistry& registry = device_->getFeatureRegistry();
+        auto noop = [](const uint8_t*, size_t) {};
+        bool battery = registry.registerNamespace(FEATURES_BATTERY, FEATURES_BATTERY_FIRST, FEATURES_BATTERY_LAST);
+        bool stoplight = registry.registerNamespace("stoplight", 0x50, 0x5F);
+        bool overlapsCore = registry.registerNamespace("sound", 0x30, 0x45);
+        bool batteryFeature = registry.registerFeature(FEATURES_BATTERY, FEATURES_BATTERY_FIRST, noop);
+        bool duplicate = registry.registerFeature(FEATURES_BATTERY, FEATURES_BATTERY_FIRST, noop);
+        bool takenCore = registry.registerFeature(CORE_FEATURE_NAMESPACE, BLE_FEATURE_POWER, noop);
+        bool outside = registry.registerFeature(FEATURES_BATTERY, FEATURES_BATTERY_LAST + 1, noop);
+        bool ok = battery && !stoplight && !overlapsCore && batteryFeature && !duplicate && !takenCore && !outside;
+        char detail[160];
+        snprintf(detail, sizeof(detail),
+                 "battery %s, overlapping stoplight/sound %s/%s, duplicate %s, core power %s, outside %s",
+                 battery ? "added" : "refused", stoplight ? "added" : "refused", overlapsCore ? "added" : "refused",
+                 duplicate ? "added" : "refused", takenCore ? "added" : "refused", outside ? "added" : "refused");
+        add("Registration", ok, detail);
+    }
+
+    void checkLengths() {
+        BMFeatureRegistry& registry = device_->getFeatureRegistry();
+        int opcodes = 0;
+        int rejected = 0;
+        int changed = 0;
+        for (int feature = CORE_FEATURE_FIRST; feature <= CORE_FEATURE_LAST; feature++) {
+            if (!registry.has(feature) || registry.accepts(feature, 1)) {
+                continue;
+            }
+            opcodes++;
+            uint32_t before = registry.getStats(feature).rejected;
+            uint32_t generation = device_->getState().getGeneration();
+            writeFeature({(uint8_t)feature});
+            loop(1);
+            rejected += registry.getStats(feature).rejected == before + 1;
+            changed += device_->getState().getGeneration() != generation;
+        }
+        // Too long counts as well
+        uint32_t before = registry.getStats(BLE_FEATURE_ORIGIN).rejected;
+        writeFeature(std::vector<uint8_t>(10, BLE_FEATURE_ORIGIN));
+        bool tooLong = registry.getStats(BLE_FEATURE_ORIGIN).rejected == before + 1;
+
+        char detail[160];
+        snprintf(detail, sizeof(detail), "%d of %d short writes rejected, %d changed state, long origin %s", rejected,
+                 opcodes, changed, tooLong ? "rejected" : "accepted");
+        add("Lengths", opcodes > 0 && rejected == opcodes && changed == 0 && tooLong, detail);
+    }
+
+    void checkCounters() {
+        BMFeatureRegistry& registry = device_->getFeatureRegistry();
+        uint32_t before = registry.getStats(BLE_FEATURE_BRIGHTNESS).calls;
+        for (int i = 0; i < writes_; i++) {
+            writeFeature(withInt(BLE_FEATURE_BRIGHTNESS, 10 + i % 90));
+        }
+        const FeatureStats& stats = registry.getStats(BLE_FEATURE_BRIGHTNESS);
+        uint32_t bucketed = 0;
+        for (int i = 0; i < FEATURE_LATENCY_BUCKETS; i++) {
+            bucketed += stats.latency[i];
+        }
+        char detail[160];
+        snprintf(detail, sizeof(detail), "%u calls counted for %d writes, %u in latency buckets",
+                 stats.calls - before, writes_, bucketed);
+        add("Counters", stats.calls - before == (uint32_t)writes_ && bucketed == stats.calls, detail);
+    }
+
+    void checkCapabilities() {
+        BMFeatureRegistry& registry = device_->getFeatureRegistry();
+        lastNotification_.clear();
+        writeFeature({BLE_FEATURE_GET_CAPABILITIES});
+        const std::vector<uint8_t>& data = lastNotification_;
+
+        bool parsed = data.size() >= 3 && data[0] == FEATURE_CAPABILITIES_MAGIC &&
+                      data[1] == FEATURE_CAPABILITIES_VERSION;
+        bool core = false;
+        bool battery = false;
+        size_t offset = 3;
+        for (int i = 0; parsed && i < data[2]; i++) {
+            if (offset + 3 > data.size() || offset + 3 + data[offset + 2] > data.size()) {
+                parsed = false;
+                break;
+            }
+            std::string name((const char*)data.data() + offset + 3, data[offset + 2]);
+            core |= name == CORE_FEATURE_NAMESPACE && data[offset] == CORE_FEATURE_FIRST &&
+                    data[offset + 1] == CORE_FEATURE_LAST;
+            battery |= name == FEATURES_BATTERY && data[offset] == FEATURES_BATTERY_FIRST &&
+                       data[offset + 1] == FEATURES_BATTERY_LAST;
+            offset += 3 + data[offset + 2];
+        }
+        parsed = parsed && offset + 32 == data.size();
+
+        int listed = 0;
+        int mismatched = 0;
+        for (int feature = 0; parsed && feature < 256; feature++) {
+            bool bit = data[offset + feature / 8] & (1 << (feature % 8));
+            listed += bit;
+            mismatched += bit != registry.has(feature);
+        }
+        char detail[160];
+        snprintf(detail, sizeof(detail), "%zu bytes, %s, %d opcodes listed, %d wrong", data.size(),
+                 core && battery ? "core and battery namespaces" : "namespaces missing", listed, mismatched);
+        add("Capabilities", parsed && core && battery && mismatched == 0, detail);
+    }
+
+    void checkCustomHandler() {
+        customSeen_.clear();
+        writeFeature({FEATURES_BATTERY_FIRST});
+        writeFeature({FEATURES_UNREGISTERED});
+        writeFeature({BLE_FEATURE_POWER});
+        bool ok = customSeen_.size() == 1 && customSeen_[0] == FEATURES_UNREGISTERED;
+        char detail[160];
+        snprintf(detail, sizeof(detail), "saw %zu of 3 writes (only the unregistered opcode expected)",
+                 customSeen_.size());
+        add("Custom handler", ok, detail);
+    }
+
+    // Dispatch alone, with a handler that does nothing
+    void measureDispatch() {
+        BMFeatureRegistry& registry = device_->getFeatureRegistry();
+        volatile uint32_t sink = 0;
+        registry.registerFeature(FEATURES_BATTERY, FEATURES_BATTERY_FIRST + 1,
+                                 [&sink](const uint8_t* buffer, size_t) { sink += buffer[0]; });
+        uint8_t data[1] = {FEATURES_BATTERY_FIRST + 1};
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < FEATURES_TIMING_DISPATCHES; i++) {
+            registry.dispatch(data[0], data, sizeof(data));
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        dispatchNs_ = std::chrono::duration<double, std::nano>(elapsed).count() / FEATURES_TIMING_DISPATCHES;
+    }
+
+    int writes_;
+    std::unique_ptr<BMDevice> device_;
+    std::vector<uint8_t> lastNotification_;
+    std::vector<uint8_t> customSeen_;
+    std::vector<Check> checks_;
+    double dispatchNs_ = 0;
+};
+
+void printUsage(const char* argv0) { fprintf(stderr, "usage: %s features [--writes n]\n", argv0); }
+
+}
+
+int runFeatures(int argc, char** argv) {
+    int writes = 1000;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--writes") writes = std::max(1, atoi(value));
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    printf("\n--- Feature registry ---\n");
+    FeaturesCheck check(writes);
+    std::vector<Check> checks = check.run();
+    int failures = 0;
+    for (const Check& c : checks) {
+        printf("%-16s %s: %s\n", (c.name + ":").c_str(), c.ok ? "ok" : "FAILED", c.detail.c_str());
+        failures += !c.ok;
+    }
+    printf("Dispatch:        %.1f ns per command on the host, handler excluded\n", check.dispatchNs());
+    printf("%s: %d of %zu checks failed\n", failures == 0 ? "PASS" : "FAIL", failures, checks.size());
+    return failures == 0 ? 0 : 1;
+}
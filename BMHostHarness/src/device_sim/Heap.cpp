@@ -0,0 +1,271 @@
+// Heap scenario: what BMDevice's status and control paths take from the heap.
+//
+// A complete BMDevice with a sketch's own status chunk (as BatteryCharger
+// registers them) and an app connected straight to HostBle. Every operator
+// new in the process is counted while a check runs. Checks:
+// - JSON status: --updates full rounds of JSON chunks, built-in and the
+//   sketch's, allocate nothing;
+// - binary status: --updates binary status messages, each after a
+//   brightness change so every one carries a delta, allocate nothing;
+// - control: owner, device type, defaults as JSON, get defaults and get
+//   configuration, --updates times each, allocate nothing;
+// - heap fields: the binary status carries free heap, minimum free heap and
+//   largest free block, and the basicStatus chunk a "heap" object;
+// - JSON pool: no document spilled out of BMJsonPool to the heap.
+// Each operation runs once before counting, so HostBle's buffers have grown
+// to size. Committing defaults to NVS is not a control path and is left out.
+//
+// Usage:
+//   device_sim heap [options]
+//     --updates <n>        rounds of each operation (default 200)
+//
+// Exits non-zero if any check fails.
+
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+#include <Preferences.h>
+#include <BMDevice.h>
+#include <BMJsonPool.h>
+#include "DeviceFixture.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#define HEAP_NOTIFICATION_MAX 512
+
+namespace {
+
+bool counting = false;
+uint64_t allocations = 0;
+uint64_t allocatedBytes = 0;
+
+}
+
+// Every allocation in the process goes through here; only counted while a
+// check runs
+void* operator new(size_t size) {
+    if (counting) {
+        allocations++;
+        allocatedBytes += size;
+    }
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+namespace {
+
+struct Check {
+    std::string name;
+    bool ok;
+    std::string detail;
+};
+
+struct Count {
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+class HeapCheck {
+public:
+    explicit HeapCheck(int updates) : updates_(updates) {}
+
+    std::vector<Check> run() {
+        notification_.reserve(HEAP_NOTIFICATION_MAX);
+        device_ = newDevice();
+        powerOn(*device_);
+        device_->setStatusUpdateInterval(3600000);     // Only the rounds the checks start
+        device_->registerStatusChunk("battery", [this]() {
+            device_->getBluetoothHandler().sendStatusUpdate("{\"type\":\"battery\",\"pct\":87}");
+        }, "A sketch's own chunk");
+        HostBle::onNotify([this](const char*, const uint8_t* data, size_t length) {
+            notification_.assign(data, data + length);
+            notifications_++;
+            checkNotification(data, length);
+        });
+        HostBle::connect();
+        loop(1000);
+
+        checkJsonStatus();
+        checkBinaryStatus();
+        checkControl();
+        checkHeapFields();
+        checkPool();
+
+        HostBle::disconnect();
+        return checks_;
+    }
+
+private:
+    void add(const std::string& name, bool ok, const std::string& detail) { checks_.push_back({name, ok, detail}); }
+
+    void loop(int steps) {
+        for (int i = 0; i < steps; i++) {
+            HostTime::setMicros(HostTime::micros() + 1000);
+            device_->loop();
+        }
+    }
+
+    template <typename F>
+    Count count(F operation) {
+        operation();    // Warm up
+        uint64_t before = allocations;
+        uint64_t beforeBytes = allocatedBytes;
+        counting = true;
+        for (int i = 0; i < updates_; i++) {
+            operation();
+        }
+        counting = false;
+        return {allocations - before, allocatedBytes - beforeBytes};
+    }
+
+    // One round of chunks, STATUS_UPDATE_DELAY apart
+    void statusRound() {
+        device_->startChunkedStatusUpdate();
+        loop(5 * STATUS_UPDATE_DELAY + 5);
+    }
+
+    void checkNotification(const uint8_t* data, size_t length) {
+        if (length > 0 && data[0] == '{' && memmem(data, length, "\"basicStatus\"", 13)) {
+            jsonHeap_ = memmem(data, length, "\"heap\":{\"free\":", 15) != nullptr;
+        }
+        StatusMessageHeader header;
+        parseStatusMessage(data, length, header, [this](uint8_t tag, const uint8_t*, size_t) {
+            if (tag >= STATUS_FREE_HEAP && tag <= STATUS_LARGEST_FREE_BLOCK) {
+                binaryHeap_ |= 1u << (tag - STATUS_FREE_HEAP);
+            }
+        });
+    }
+
+    static std::string describe(const Count& c, int operations, const char* per) {
+        char detail[160];
+        snprintf(detail, sizeof(detail), "%llu allocations (%llu bytes) in %d %s", (unsigned long long)c.allocations,
+                 (unsigned long long)c.bytes, operations, per);
+        return detail;
+    }
+
+    void checkJsonStatus() {
+        device_->setStatusFormat(STATUS_FORMAT_JSON);
+        uint32_t before = notifications_;
+        Count c = count([this]() { statusRound(); });
+        uint32_t sent = notifications_ - before;
+        bool complete = sent >= (uint32_t)(updates_ + 1) * 5;   // Periodic updates come on top
+        add("JSON status", c.allocations == 0 && complete,
+            describe(c, updates_, "rounds") + ", " + std::to_string(sent) + " chunks");
+    }
+
+    void checkBinaryStatus() {
+        device_->setStatusFormat(STATUS_FORMAT_BINARY);
+        int brightness = 10;
+        uint32_t before = notifications_;
+        Count c = count([this, &brightness]() {
+            brightness = brightness % 90 + 10;
+            uint8_t data[5] = {BLE_FEATURE_BRIGHTNESS};
+            memcpy(data + 1, &brightness, sizeof(int));
+            writeFeature(data, sizeof(data));
+            statusRound();
+        });
+        uint32_t sent = notifications_ - before;
+        add("Binary status", c.allocations == 0 && sent >= (uint32_t)updates_,
+            describe(c, updates_, "updates") + ", " + std::to_string(sent) + " notifications");
+    }
+
+    void checkControl() {
+        static const char owner[] = "\x1F" "Playa Owner";
+        static const char deviceType[] = "\x31" "Umbrella";
+        static const char defaults[] = "\x1B" "{\"brightness\":40,\"speed\":90,\"owner\":\"JSON Owner\"}";
+        static const uint8_t getDefaults[] = {BLE_FEATURE_GET_DEFAULTS};
+        static const uint8_t getConfiguration[] = {BLE_FEATURE_GET_CONFIGURATION};
+        uint32_t before = notifications_;
+        Count c = count([this]() {
+            writeFeature((const uint8_t*)owner, sizeof(owner) - 1);
+            writeFeature((const uint8_t*)deviceType, sizeof(deviceType) - 1);
+            writeFeature((const uint8_t*)defaults, sizeof(defaults) - 1);
+            writeFeature(getDefaults, sizeof(getDefaults));
+            writeFeature(getConfiguration, sizeof(getConfiguration));
+        });
+        uint32_t answered = notifications_ - before;
+        const DeviceDefaults& current = device_->getDefaults().getCurrentDefaults();
+        bool applied = strcmp(current.owner, "JSON Owner") == 0 && strcmp(current.deviceType, "Umbrella") == 0 &&
+                       current.speed == 90;
+        add("Control", c.allocations == 0 && applied && answered == (uint32_t)(updates_ + 1) * 2,
+            describe(c, updates_ * 5, "writes") + (applied ? ", applied" : ", NOT applied"));
+        device_->getDefaults().flush();
+    }
+
+    void checkHeapFields() {
+        binaryHeap_ = 0;
+        jsonHeap_ = false;
+        device_->setStatusFormat(STATUS_FORMAT_BINARY);
+        statusRound();
+        device_->setStatusFormat(STATUS_FORMAT_JSON);
+        statusRound();
+        char detail[160];
+        snprintf(detail, sizeof(detail), "binary %d of 3 fields, JSON heap object %s", __builtin_popcount(binaryHeap_),
+                 jsonHeap_ ? "present" : "missing");
+        add("Heap fields", binaryHeap_ == 0x7 && jsonHeap_, detail);
+    }
+
+    void checkPool() {
+        const BMJsonPool* pool = BMJsonPool::shared();
+        char detail[160];
+        snprintf(detail, sizeof(detail), "%u spills, high water %zu of %zu bytes", pool->getSpills(),
+                 pool->getHighWater(), (size_t)BM_JSON_POOL_SIZE);
+        add("JSON pool", pool->getSpills() == 0, detail);
+    }
+
+    int updates_;
+    std::unique_ptr<BMDevice> device_;
+    std::vector<uint8_t> notification_;
+    uint32_t notifications_ = 0;
+    uint32_t binaryHeap_ = 0;   // A bit per heap field seen
+    bool jsonHeap_ = false;
+    std::vector<Check> checks_;
+};
+
+void printUsage(const char* argv0) { fprintf(stderr, "usage: %s heap [--updates n]\n", argv0); }
+
+}
+
+int runHeap(int argc, char** argv) {
+    int updates = 200;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--updates") updates = std::max(1, atoi(value));
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    printf("\n--- Heap use on the status and control paths ---\n");
+    HeapCheck check(updates);
+    std::vector<Check> checks = check.run();
+    int failures = 0;
+    for (const Check& c : checks) {
+        printf("%-16s %s: %s\n", (c.name + ":").c_str(), c.ok ? "ok" : "FAILED", c.detail.c_str());
+        failures += !c.ok;
+    }
+    printf("%s: %d of %zu checks failed\n", failures == 0 ? "PASS" : "FAIL", failures, checks.size());
+    return failures == 0 ? 0 : 1;
+}
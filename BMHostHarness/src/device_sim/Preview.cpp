@@ -0,0 +1,414 @@
+// Preview scenario: the live pixel preview (BMPreviewProtocol.h) on a
+// simulated link.
+//
+// A complete BMDevice with --strips strips of --leds LEDs runs against
+// HostArduino's BLE shim, with a simulated app on the other end of a
+// BleLink. The app connects, sets the speed to --speed, turns the preview on
+// with the link's MTU and connection interval, and changes the effect every
+// --effect seconds,
+// through every animated effect; the status goes out as usual. Each run is
+// --seconds long and is repeated without the preview for a baseline.
+//
+// Runs: 4, 6 and 8 bits on the link given, then 6 bits at a 23-byte MTU and
+// at twice the interval, to show the governor following the link.
+//
+// Reported per run: preview frames per second, bytes per frame (keyframes,
+// deltas, and the same samples as raw RGB), fidelity of what the app decodes
+// against the samples the prop took (PSNR and mean error per channel), the
+// time from a frame's first fragment to the app having all of it, and the
+// same for status notifications against the baseline.
+//
+// Usage:
+//   device_sim preview [options]
+//     --seconds <s>        simulated time per run (default 60)
+//     --strips <n>         LED strips, 1-8 (default 4)
+//     --leds <n>           LEDs per strip (default 60)
+//     --samples <n>        preview samples per strip (default 16)
+//     --effect <s>         seconds between effect changes (default 4)
+//     --speed <ms>         light show speed, ms between renders (default 20)
+//     --interval <ms>      connection interval (default 30)
+//     --mtu <n>            ATT MTU (default 185)
+//
+// Exits non-zero if, in any run, the light show renders a frame fewer than
+// in the baseline, a preview frame takes more than PREVIEW_MAX_LATENCY_MS or
+// PREVIEW_MAX_LATENCY_INTERVALS connection intervals, whichever is longer, to
+// arrive at the 99th percentile (or, where status notifications alone take
+// longer, as at a 23-byte MTU where the app reads them in blobs, more than
+// those take in the baseline), status notifications arrive more than two
+// connection intervals later than in the baseline at the 99th percentile,
+// the app rejects a message, or fidelity is under the floor for the bit
+// depth; if deltas average more than PREVIEW_MAX_BYTES_RATIO of raw RGB at
+// 6 bits; or if the preview doesn't slow down for the smaller MTU and the
+// longer interval.
+
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+#include <Preferences.h>
+#include <BMDevice.h>
+#include "BleLink.h"
+#include "DeviceFixture.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define PREVIEW_STEP_US 1000ULL
+#define PREVIEW_SIM_MAX_LEDS 300
+#define PREVIEW_MAX_LATENCY_MS 250.0
+#define PREVIEW_MAX_LATENCY_INTERVALS 8     // A few hundred bytes at the preview's share of each event
+#define PREVIEW_MAX_BYTES_RATIO 0.5         // Delta bytes per frame at 6 bits, of raw RGB
+#define PREVIEW_STATUS_SLACK_INTERVALS 2
+
+namespace {
+
+// Every effect that animates, plus solid and a one-color one
+const LightSceneID kEffects[] = {
+    LightSceneID::palette_cycle,  LightSceneID::palette_stream, LightSceneID::spectrum_cycle,
+    LightSceneID::spectrum_stream, LightSceneID::breathe,       LightSceneID::pulse_wave,
+    LightSceneID::meteor_shower,  LightSceneID::fire_plasma,    LightSceneID::kaleidoscope,
+    LightSceneID::rainbow_comet,  LightSceneID::matrix_rain,    LightSceneID::plasma_clouds,
+    LightSceneID::lava_lamp,      LightSceneID::aurora_borealis, LightSceneID::lightning_storm,
+    LightSceneID::color_explosion, LightSceneID::spiral_galaxy, LightSceneID::solid,
+};
+const size_t kEffectCount = sizeof(kEffects) / sizeof(kEffects[0]);
+
+// Fidelity floor per bit depth
+double minPsnr(int bits) { return bits >= 8 ? 34 : bits >= 6 ? 30 : 26; }
+
+CRGB stripLeds[PREVIEW_MAX_STRIPS][PREVIEW_SIM_MAX_LEDS];
+
+struct PreviewConfig {
+    double seconds = 60;
+    int strips = 4;
+    int leds = 60;
+    int samples = 16;
+    double effectSeconds = 4;
+    int speed = 20;
+    double intervalMs = 30;
+    int mtu = 185;
+};
+
+struct RunSetup {
+    const char* name;
+    bool preview;
+    int bits;
+    int mtu;
+    double intervalMs;
+};
+
+struct RunResult {
+    uint32_t shows = 0;                 // LightShow::getShowCount()
+    uint64_t frames = 0;                // Completed at the app
+    uint32_t rejected = 0;
+    PreviewEncoderStats encoder = {};
+    double squaredError = 0;
+    uint64_t channels = 0;
+    double absoluteError = 0;
+    std::vector<double> previewLatencyMs;
+    std::vector<double> statusLatencyMs;
+    uint64_t previewAirBytes = 0;
+    bool finalMatches = false;
+};
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+    return values[index];
+}
+
+void addStrip(BMDevice& device, int strip, int leds) {
+    CRGB* array = stripLeds[strip];
+    switch (strip) {
+        case 0: device.addLEDStrip<WS2812B, 5, GRB>(array, leds); break;
+        case 1: device.addLEDStrip<WS2812B, 12, GRB>(array, leds); break;
+        case 2: device.addLEDStrip<WS2812B, 13, GRB>(array, leds); break;
+        case 3: device.addLEDStrip<WS2812B, 14, GRB>(array, leds); break;
+        case 4: device.addLEDStrip<WS2812B, 16, GRB>(array, leds); break;
+        case 5: device.addLEDStrip<WS2812B, 17, GRB>(array, leds); break;
+        case 6: device.addLEDStrip<WS2812B, 18, GRB>(array, leds); break;
+        default: device.addLEDStrip<WS2812B, 27, GRB>(array, leds); break;
+    }
+}
+
+class PreviewSim {
+public:
+    PreviewSim(const PreviewConfig& config, const RunSetup& setup)
+        : config_(config), setup_(setup), link_(linkModel(setup)) {}
+
+    RunResult run() {
+        randomSeed(1);
+        memset(stripLeds, 0, sizeof(stripLeds));
+
+        device_ = newDevice();
+        for (int s = 0; s < config_.strips; s++) {
+            addStrip(*device_, s, config_.leds);
+        }
+        device_->enablePreview(SIM_PREVIEW_UUID);
+        powerOn(*device_);
+        HostBle::onNotify([this](const char* uuid, const uint8_t* data, size_t length) { notified(uuid, data, length); });
+
+        link_.reset();
+        HostBle::connect();
+        appWrite(withInt(BLE_FEATURE_SPEED, config_.speed));
+        if (setup_.preview) {
+            uint16_t interval = (uint16_t)(setup_.intervalMs / 1.25 + 0.5);
+            appWrite({BLE_FEATURE_PREVIEW, 1, (uint8_t)config_.samples, (uint8_t)setup_.bits, (uint8_t)setup_.mtu,
+                      (uint8_t)(setup_.mtu >> 8), (uint8_t)interval, (uint8_t)(interval >> 8)});
+        }
+
+        uint64_t endUs = (uint64_t)(config_.seconds * 1e6);
+        uint64_t effectUs = (uint64_t)(config_.effectSeconds * 1e6);
+        size_t effect = 0;
+        for (uint64_t nextEffectUs = 0; HostTime::micros() < endUs; nextEffectUs += effectUs) {
+            appWrite({BLE_FEATURE_EFFECT, (uint8_t)kEffects[effect++ % kEffectCount]});
+            runUntil(std::min(endUs, nextEffectUs + effectUs));
+        }
+        // Let the link drain, with nothing new rendered
+        appWrite({BLE_FEATURE_POWER, 0});
+        runUntil(endUs + 3000000);
+
+        result_.shows = device_->getLightShow().getShowCount();
+        result_.rejected = decoder_.getRejected();
+        result_.encoder = device_->getPreviewEncoder()->getStats();
+        result_.finalMatches = !setup_.preview || finalMatches();
+        HostBle::disconnect();
+        return result_;
+    }
+
+private:
+    struct Event {
+        bool toApp;
+        bool preview;
+        uint64_t sentUs;
+        std::vector<uint8_t> data;
+    };
+
+    static BleLinkModel linkModel(const RunSetup& setup) {
+        BleLinkModel model;
+        model.mtu = setup.mtu;
+        model.intervalUs = setup.intervalMs * 1000;
+        return model;
+    }
+
+    void notified(const char* uuid, const uint8_t* data, size_t length) {
+        uint64_t nowUs = HostTime::micros();
+        bool preview = strcmp(uuid, SIM_PREVIEW_UUID) == 0;
+        uint64_t before = link_.stats().airBytes;
+        uint64_t atUs = link_.notify(nowUs, length);
+        if (preview) {
+            result_.previewAirBytes += link_.stats().airBytes - before;
+            if (length >= PREVIEW_HEADER_SIZE && data[5] == 0) {
+                // The samples this frame was made from, as the prop took them
+                uint16_t frame = data[3] | data[4] << 8;
+                const BMPreviewEncoder* encoder = device_->getPreviewEncoder();
+                std::vector<CRGB>& truth = truth_[frame];
+                truth.clear();
+                for (size_t i = 0; i < encoder->getSampleCount(); i++) {
+                    truth.push_back(encoder->getSample(i));
+                }
+                frameSentUs_[frame] = nowUs;
+            }
+        }
+        events_.insert({atUs, Event{true, preview, nowUs, std::vector<uint8_t>(data, data + length)}});
+    }
+
+    void appWrite(const std::vector<uint8_t>& data) {
+        uint64_t atUs = link_.write(HostTime::micros(), data.size());
+        events_.insert({atUs, Event{false, false, HostTime::micros(), data}});
+    }
+
+    void runUntil(uint64_t untilUs) {
+        for (uint64_t nowUs = HostTime::micros(); nowUs < untilUs; nowUs += PREVIEW_STEP_US) {
+            HostTime::setMicros(nowUs);
+            while (!events_.empty() && events_.begin()->first <= nowUs) {
+                Event event = events_.begin()->second;
+                events_.erase(events_.begin());
+                if (!event.toApp) {
+                    writeFeature(event.data);
+                } else if (event.preview) {
+                    appPreview(event.data);
+                } else {
+                    result_.statusLatencyMs.push_back((nowUs - event.sentUs) / 1000.0);
+                }
+            }
+            device_->loop();
+        }
+        HostTime::setMicros(untilUs);
+    }
+
+    void appPreview(const std::vector<uint8_t>& data) {
+        if (!decoder_.handleMessage(data.data(), data.size())) {
+            return;
+        }
+        uint16_t frame = decoder_.getFrame();
+        result_.frames++;
+        result_.previewLatencyMs.push_back((HostTime::micros() - frameSentUs_[frame]) / 1000.0);
+        const std::vector<CRGB>& truth = truth_[frame];
+        if (truth.size() == decoder_.getSampleCount()) {
+            for (size_t i = 0; i < truth.size(); i++) {
+                CRGB shown = decoder_.getSample(i);
+                for (int c = 0; c < 3; c++) {
+                    double error = (double)shown[c] - truth[i][c];
+                    result_.squaredError += error * error;
+                    result_.absoluteError += std::fabs(error);
+                    result_.channels++;
+                }
+            }
+        }
+        truth_.erase(truth_.begin(), truth_.upper_bound(frame));
+        frameSentUs_.erase(frameSentUs_.begin(), frameSentUs_.upper_bound(frame));
+    }
+
+    // With the strips dark and the link drained, the app shows black
+    bool finalMatches() const {
+        if (!decoder_.hasFrame() || decoder_.getSampleCount() != (size_t)config_.strips * config_.samples) {
+            return false;
+        }
+        for (size_t i = 0; i < decoder_.getSampleCount(); i++) {
+            if (decoder_.getSample(i) != CRGB(CRGB::Black)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    PreviewConfig config_;
+    RunSetup setup_;
+    BleLink link_;
+    std::unique_ptr<BMDevice> device_;
+    std::multimap<uint64_t, Event> events_;
+    BMPreviewDecoder decoder_;
+    std::map<uint16_t, std::vector<CRGB>> truth_;
+    std::map<uint16_t, uint64_t> frameSentUs_;
+    RunResult result_;
+};
+
+void printUsage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s preview [--seconds s] [--strips n] [--leds n] [--samples n] [--effect s] [--speed ms] "
+            "[--interval ms] [--mtu n]\n",
+            argv0);
+}
+
+struct RunReport {
+    RunSetup setup;
+    RunResult result;
+    RunResult baseline;
+    double fps;
+    double psnr;
+};
+
+}
+
+int runPreview(int argc, char** argv) {
+    PreviewConfig config;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--seconds") config.seconds = std::max(5.0, atof(value));
+        else if (arg == "--strips") config.strips = std::min(PREVIEW_MAX_STRIPS, std::max(1, atoi(value)));
+        else if (arg == "--leds") config.leds = std::min(PREVIEW_SIM_MAX_LEDS, std::max(1, atoi(value)));
+        else if (arg == "--samples") config.samples = std::min(PREVIEW_MAX_SAMPLES_PER_STRIP, std::max(1, atoi(value)));
+        else if (arg == "--effect") config.effectSeconds = std::max(0.5, atof(value));
+        else if (arg == "--speed") config.speed = std::min(200, std::max(5, atoi(value)));
+        else if (arg == "--interval") config.intervalMs = std::max(7.5, atof(value));
+        else if (arg == "--mtu") config.mtu = std::min(517, std::max(23, atoi(value)));
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    config.samples = std::min(config.samples, config.leds);
+
+    const RunSetup setups[] = {
+        {"4 bits", true, 4, config.mtu, config.intervalMs},
+        {"6 bits", true, 6, config.mtu, config.intervalMs},
+        {"8 bits", true, 8, config.mtu, config.intervalMs},
+        {"MTU 23", true, 6, 23, config.intervalMs},
+        {"2x intv", true, 6, config.mtu, config.intervalMs * 2},
+    };
+    std::map<std::pair<int, double>, RunResult> baselines;
+    std::vector<RunReport> reports;
+    for (const RunSetup& setup : setups) {
+        std::pair<int, double> link(setup.mtu, setup.intervalMs);
+        if (!baselines.count(link)) {
+            RunSetup off = setup;
+            off.preview = false;
+            baselines[link] = PreviewSim(config, off).run();
+        }
+        RunReport report = {setup, PreviewSim(config, setup).run(), baselines[link], 0, 0};
+        report.fps = report.result.frames / config.seconds;
+        double mse = report.result.channels ? report.result.squaredError / report.result.channels : 0;
+        report.psnr = mse > 0 ? 10 * std::log10(255.0 * 255.0 / mse) : 99;
+        reports.push_back(report);
+    }
+
+    size_t samples = (size_t)config.strips * config.samples;
+    size_t rawBytes = PREVIEW_HEADER_SIZE + samples * 3;
+    printf("\n--- Live pixel preview (%.0f s per run, %d strips x %d LEDs, %d samples per strip) ---\n",
+           config.seconds, config.strips, config.leds, config.samples);
+    printf("Raw RGB: %zu B per frame\n", rawBytes);
+    printf("%-8s %4s %5s %8s %6s %7s %9s %8s %8s %9s %9s %8s\n", "run", "MTU", "intv", "frames/s", "key B",
+           "delta B", "on air", "PSNR", "mean err", "p99 frame", "p99 stat", "renders");
+    int failures = 0;
+    double deltaRatio = 0;
+    double fps6 = 0, fpsSmallMtu = 0, fpsLongInterval = 0;
+    for (const RunReport& r : reports) {
+        const PreviewEncoderStats& e = r.result.encoder;
+        uint32_t deltas = e.frames - e.keyframes;
+        double keyBytes = e.keyframes ? (double)e.keyframeBytes / e.keyframes : 0;
+        double deltaBytes = deltas ? (double)(e.bytes - e.keyframeBytes) / deltas : 0;
+        double meanError = r.result.channels ? r.result.absoluteError / r.result.channels : 0;
+        double p99Frame = percentile(r.result.previewLatencyMs, 0.99);
+        double p99Status = percentile(r.result.statusLatencyMs, 0.99);
+        double p99StatusBaseline = percentile(r.baseline.statusLatencyMs, 0.99);
+
+        bool renders = r.result.shows >= r.baseline.shows;
+        double maxLatency = std::max(PREVIEW_MAX_LATENCY_MS, PREVIEW_MAX_LATENCY_INTERVALS * r.setup.intervalMs);
+        bool latency = p99Frame <= std::max(maxLatency, p99StatusBaseline);
+        bool status = p99Status <= p99StatusBaseline + PREVIEW_STATUS_SLACK_INTERVALS * r.setup.intervalMs;
+        bool fidelity = r.psnr >= minPsnr(r.setup.bits) && r.result.rejected == 0 && r.result.finalMatches;
+        bool ok = renders && latency && status && fidelity && r.result.frames > 0;
+        failures += !ok;
+        if (r.setup.bits == 6) {
+            if (r.setup.mtu != config.mtu) fpsSmallMtu = r.fps;
+            else if (r.setup.intervalMs != config.intervalMs) fpsLongInterval = r.fps;
+            else {
+                fps6 = r.fps;
+                deltaRatio = deltaBytes / rawBytes;
+            }
+        }
+        printf("%-8s %4d %5.1f %8.1f %6.0f %7.1f %7.0f/s %5.1f dB %8.2f %6.1f ms %6.1f ms %8s%s\n", r.setup.name,
+               r.setup.mtu, r.setup.intervalMs, r.fps, keyBytes, deltaBytes,
+               r.result.previewAirBytes / config.seconds, r.psnr, meanError, p99Frame, p99Status,
+               renders ? "same" : "FEWER", ok ? "" : "  FAILED");
+        if (!ok) {
+            printf("         baseline p99 status %.1f ms, %u rejected, final frame %s, floor %.0f dB\n",
+                   p99StatusBaseline, r.result.rejected, r.result.finalMatches ? "matches" : "differs",
+                   minPsnr(r.setup.bits));
+        }
+    }
+
+    bool small = deltaRatio <= PREVIEW_MAX_BYTES_RATIO;
+    bool adapts = fpsSmallMtu < fps6 && fpsLongInterval < fps6;
+    bool ok = failures == 0 && small && adapts;
+    printf("%s: %d of %zu runs failed, deltas %.0f%% of raw RGB at 6 bits, %.1f -> %.1f / %.1f frames/s at "
+           "MTU 23 / 2x interval (target: every run within its limits, at most %.0f%%, slower on both)\n",
+           ok ? "PASS" : "FAIL", failures, reports.size(), deltaRatio * 100, fps6, fpsSmallMtu, fpsLongInterval,
+           PREVIEW_MAX_BYTES_RATIO * 100);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,439 @@
+// Records scenario: BMSettingsRecord, the versioned settings record that
+// BMDeviceDefaults and the umbrella's settings are stored in.
+//
+// Migrations are checked on a made-up schema with three versions, each one a
+// firmware that only knows the versions up to its own:
+//   v1: brightness (percent, 1 byte)
+//   v2: v1, then speed (2 bytes)
+//   v3: brightness rescaled to 0-255, speed
+// Checks:
+// - upgrades: v1, v2 and v3 records all load on v3 firmware;
+// - rollback: v2 firmware skips a v3 record for the one before it, and its
+//   next commit still comes after the v3 one; commitAs() writes records v1
+//   and v2 firmware read, and going up and back down loses nothing;
+// - migrations: a record with no migration path, or whose migration or
+//   validator fails, falls back to the record before it;
+// - corruption: a newest record with a bad CRC, bad magic, wrong length or
+//   cut short falls back to the record before it, and the next commit goes
+//   over the damaged one; with both damaged nothing loads;
+// - boot reads: loading the device defaults from their record against the
+//   per-key layout, counted as HostPreferences lookups;
+// - sound settings: SoundSettings encodes to SOUND_SETTINGS_SIZE bytes and
+//   decodes back to the same settings.
+//
+// Usage:
+//   device_sim records
+//
+// Exits non-zero if any check fails.
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <BMDevice.h>
+#include <SoundSettings.h>
+#include "Scenarios.h"
+
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define RECORDS_NAMESPACE "records"
+#define RECORDS_NAME "test"
+#define RECORDS_KEY_OLDER "test0"           // First commit after a reset
+#define RECORDS_KEY_NEWER "test1"
+#define RECORDS_DEFAULT_SPEED 5
+
+namespace {
+
+struct Check {
+    std::string name;
+    bool ok;
+    std::string detail;
+};
+
+// The test schema's payloads, at each version
+std::vector<uint8_t> schemaV1(uint8_t percent) { return {percent}; }
+
+std::vector<uint8_t> schemaV2(uint8_t percent, uint16_t speed) {
+    return {percent, (uint8_t)(speed & 0xFF), (uint8_t)(speed >> 8)};
+}
+
+std::vector<uint8_t> schemaV3(uint8_t level, uint16_t speed) {
+    return {level, (uint8_t)(speed & 0xFF), (uint8_t)(speed >> 8)};
+}
+
+uint8_t percentToLevel(uint8_t percent) { return (percent * 255 + 50) / 100; }
+uint8_t levelToPercent(uint8_t level) { return (level * 100 + 127) / 255; }
+
+bool upgradeToV2(std::vector<uint8_t>& payload) {
+    if (payload.size() != 1) {
+        return false;
+    }
+    payload.push_back(RECORDS_DEFAULT_SPEED & 0xFF);
+    payload.push_back(RECORDS_DEFAULT_SPEED >> 8);
+    return true;
+}
+
+bool downgradeToV1(std::vector<uint8_t>& payload) {
+    if (payload.size() != 3) {
+        return false;
+    }
+    payload.resize(1);
+    return true;
+}
+
+bool upgradeToV3(std::vector<uint8_t>& payload) {
+    if (payload.size() != 3 || payload[0] > 100) {
+        return false;
+    }
+    payload[0] = percentToLevel(payload[0]);
+    return true;
+}
+
+bool downgradeToV2(std::vector<uint8_t>& payload) {
+    if (payload.size() != 3) {
+        return false;
+    }
+    payload[0] = levelToPercent(payload[0]);
+    return true;
+}
+
+// A firmware that knows the test schema up to `version`
+struct Firmware {
+    Firmware(Preferences& preferences, uint8_t version, bool withFirstStep = true)
+        : record(preferences, RECORDS_NAME, version) {
+        if (version > 1 && withFirstStep) {
+            record.addMigration(1, upgradeToV2, downgradeToV1);
+        }
+        if (version > 2) {
+            record.addMigration(2, upgradeToV3, downgradeToV2);
+        }
+    }
+
+    bool load(std::vector<uint8_t>& payload) {
+        payload.clear();
+        return record.load(payload);
+    }
+
+    BMSettingsRecord record;
+};
+
+std::string hex(const std::vector<uint8_t>& data) {
+    std::string out;
+    char byte[4];
+    for (uint8_t value : data) {
+        snprintf(byte, sizeof(byte), "%02X", value);
+        out += byte;
+    }
+    return out.empty() ? "-" : out;
+}
+
+class RecordsCheck {
+public:
+    std::vector<Check> run() {
+        checkUpgrades();
+        checkRollback();
+        checkRoundTrip();
+        checkMigrations();
+        checkCorruption();
+        checkBootReads();
+        checkSoundSettings();
+        return checks_;
+    }
+
+private:
+    void add(const std::string& name, bool ok, const std::string& detail) { checks_.push_back({name, ok, detail}); }
+
+    void fresh() {
+        HostPreferences::erase();
+        preferences_.reset(new Preferences());
+        preferences_->begin(RECORDS_NAMESPACE, false);
+    }
+
+    // Booted, then commits, as firmware of that version would
+    bool commitFrom(uint8_t version, const std::vector<uint8_t>& payload, bool withFirstStep = true) {
+        Firmware firmware(*preferences_, version, withFirstStep);
+        std::vector<uint8_t> ignored;
+        firmware.load(ignored);
+        return firmware.record.commit(payload);
+    }
+
+    void checkUpgrades() {
+        const std::vector<uint8_t> stored[] = {schemaV1(40), schemaV2(40, 300), schemaV3(102, 300)};
+        const std::vector<uint8_t> expected[] = {schemaV3(102, RECORDS_DEFAULT_SPEED), schemaV3(102, 300),
+                                                 schemaV3(102, 300)};
+        int loaded = 0;
+        std::string detail;
+        for (uint8_t version = 1; version <= 3; version++) {
+            fresh();
+            commitFrom(version, stored[version - 1]);
+            Firmware current(*preferences_, 3);
+            std::vector<uint8_t> payload;
+            bool ok = current.load(payload) && payload == expected[version - 1] &&
+                      current.record.getLoadedVersion() == version;
+            loaded += ok;
+            detail += (version > 1 ? ", v" : "v") + std::to_string(version) + " " + hex(stored[version - 1]) +
+                      " -> " + hex(payload);
+        }
+        add("Upgrades", loaded == 3, detail);
+    }
+
+    void checkRollback() {
+        // Updated to v3 and back to v2 without commitAs(): the v2 record is all v2 can read
+        fresh();
+        commitFrom(2, schemaV2(40, 300));
+        {
+            Firmware updated(*preferences_, 3);
+            std::vector<uint8_t> payload;
+            updated.load(payload);
+            payload[1] = 200;
+            updated.record.commit(payload);
+        }
+        Firmware rolledBack(*preferences_, 2);
+        std::vector<uint8_t> payload;
+        bool fellBack = rolledBack.load(payload) && payload == schemaV2(40, 300);
+        bool committed = rolledBack.record.commit(schemaV2(41, 300)) && rolledBack.record.getSequence() == 3;
+        std::vector<uint8_t> reloaded;
+        bool newest = Firmware(*preferences_, 2).load(reloaded) && reloaded == schemaV2(41, 300);
+
+        // Only a v3 record: nothing v2 can load
+        fresh();
+        commitFrom(3, schemaV3(102, 300));
+        bool refused = !Firmware(*preferences_, 2).load(payload);
+
+        // commitAs() ahead of the rollback
+        fresh();
+        Firmware current(*preferences_, 3);
+        bool asV2 = current.record.commitAs(2, schemaV3(102, 300));
+        bool v2Reads = Firmware(*preferences_, 2).load(payload) && payload == schemaV2(40, 300);
+        bool asV1 = current.record.commitAs(1, schemaV3(102, 300));
+        bool v1Reads = Firmware(*preferences_, 1).load(payload) && payload == schemaV1(40);
+
+        bool ok = fellBack && committed && newest && refused && asV2 && v2Reads && asV1 && v1Reads;
+        char detail[200];
+        snprintf(detail, sizeof(detail),
+                 "v2 after v3 %s, next commit %s; v3 alone %s; commitAs v2 %s, v1 %s",
+                 fellBack ? "loaded the v2 record" : "didn't fall back",
+                 committed && newest ? "newest" : "lost", refused ? "refused" : "loaded",
+                 asV2 && v2Reads ? "read" : "unreadable", asV1 && v1Reads ? "read" : "unreadable");
+        add("Rollback", ok, detail);
+    }
+
+    // Every v1 value through v3 firmware and back down
+    void checkRoundTrip() {
+        int kept = 0;
+        for (int percent = 0; percent <= 100; percent++) {
+            fresh();
+            commitFrom(1, schemaV1(percent));
+            Firmware current(*preferences_, 3);
+            std::vector<uint8_t> payload;
+            current.load(payload);
+            current.record.commitAs(1, payload);
+            kept += Firmware(*preferences_, 1).load(payload) && payload == schemaV1(percent);
+        }
+        char detail[160];
+        snprintf(detail, sizeof(detail), "%d of 101 brightness values v1 -> v3 -> v1 unchanged", kept);
+        add("Round trip", kept == 101, detail);
+    }
+
+    void checkMigrations() {
+        std::vector<uint8_t> payload;
+
+        // No way up from v1
+        fresh();
+        commitFrom(2, schemaV2(40, 300));
+        commitFrom(1, schemaV1(60));
+        Firmware missing(*preferences_, 3, false);
+        bool skippedMissing = missing.load(payload) && payload == schemaV3(102, 300);
+
+        // An upgrade that refuses the payload
+        fresh();
+        commitFrom(2, schemaV2(40, 300));
+        commitFrom(2, schemaV2(140, 300));
+        bool skippedFailed = Firmware(*preferences_, 3).load(payload) && payload == schemaV3(102, 300);
+
+        // A payload the validator turns down
+        fresh();
+        {
+            Firmware current(*preferences_, 3);
+            current.record.commit(schemaV3(102, 300));
+            current.record.commit(schemaV3(102, 0));
+        }
+        Firmware validating(*preferences_, 3);
+        payload.clear();
+        bool skippedInvalid = validating.record.load(payload, [](const std::vector<uint8_t>& candidate) {
+            return candidate[1] != 0 || candidate[2] != 0;
+        }) && payload == schemaV3(102, 300);
+
+        char detail[160];
+        snprintf(detail, sizeof(detail), "no migration %s, failed migration %s, rejected payload %s",
+                 skippedMissing ? "fell back" : "didn't fall back", skippedFailed ? "fell back" : "didn't fall back",
+                 skippedInvalid ? "fell back" : "didn't fall back");
+        add("Migrations", skippedMissing && skippedFailed && skippedInvalid, detail);
+    }
+
+    // Commits 1 and 2, then commit 2 damaged by `damage`
+    bool fallsBack(const std::function<void(std::vector<uint8_t>&)>& damage, bool& replaced) {
+        fresh();
+        {
+            Firmware current(*preferences_, 3);
+            current.record.commit(schemaV3(10, 1));
+            current.record.commit(schemaV3(20, 2));
+        }
+        std::vector<uint8_t> newest(preferences_->getBytesLength(RECORDS_KEY_NEWER));
+        preferences_->getBytes(RECORDS_KEY_NEWER, newest.data(), newest.size());
+        damage(newest);
+        preferences_->putBytes(RECORDS_KEY_NEWER, newest.data(), newest.size());
+
+        Firmware current(*preferences_, 3);
+        std::vector<uint8_t> payload;
+        bool ok = current.load(payload) && payload == schemaV3(10, 1);
+        current.record.commit(schemaV3(30, 3));
+        std::vector<uint8_t> older(preferences_->getBytesLength(RECORDS_KEY_OLDER));
+        preferences_->getBytes(RECORDS_KEY_OLDER, older.data(), older.size());
+        replaced = older.size() > SETTINGS_RECORD_HEADER && older[SETTINGS_RECORD_HEADER] == 10 &&
+                   Firmware(*preferences_, 3).load(payload) && payload == schemaV3(30, 3);
+        return ok;
+    }
+
+    // Header fields changed with the CRC recomputed, so only the field is wrong
+    static void resign(std::vector<uint8_t>& record) {
+        uint32_t crc = settingsCrc32(record.data() + SETTINGS_RECORD_HEADER, record.size() - SETTINGS_RECORD_HEADER,
+                                     settingsCrc32(record.data(), 8));
+        memcpy(record.data() + 8, &crc, sizeof(crc));
+    }
+
+    void checkCorruption() {
+        struct Damage {
+            const char* name;
+            std::function<void(std::vector<uint8_t>&)> apply;
+        };
+        const Damage damages[] = {
+            {"crc", [](std::vector<uint8_t>& record) { record[SETTINGS_RECORD_HEADER] ^= 0x40; }},
+            {"magic", [](std::vector<uint8_t>& record) { record[0] = 0xBE; resign(record); }},
+            {"length", [](std::vector<uint8_t>& record) { record[2]++; resign(record); }},
+            {"truncated", [](std::vector<uint8_t>& record) { record.resize(record.size() - 1); }},
+            {"header only", [](std::vector<uint8_t>& record) { record.resize(SETTINGS_RECORD_HEADER - 1); }},
+        };
+        int fellBack = 0;
+        int replaced = 0;
+        std::string failed;
+        for (const Damage& damage : damages) {
+            bool overwritten = false;
+            bool ok = fallsBack(damage.apply, overwritten);
+            fellBack += ok;
+            replaced += overwritten;
+            if (!ok || !overwritten) {
+                failed += std::string(failed.empty() ? " (" : ", ") + damage.name;
+            }
+        }
+        failed += failed.empty() ? "" : ")";
+
+        // Both records damaged
+        fresh();
+        {
+            Firmware current(*preferences_, 3);
+            current.record.commit(schemaV3(10, 1));
+            current.record.commit(schemaV3(20, 2));
+        }
+        uint8_t junk[4] = {SETTINGS_RECORD_MAGIC, 3, 0, 0};
+        preferences_->putBytes(RECORDS_KEY_OLDER, junk, sizeof(junk));
+        preferences_->putBytes(RECORDS_KEY_NEWER, junk, sizeof(junk));
+        std::vector<uint8_t> payload;
+        bool nothing = !Firmware(*preferences_, 3).load(payload);
+
+        int total = sizeof(damages) / sizeof(damages[0]);
+        char detail[200];
+        snprintf(detail, sizeof(detail), "%d of %d fell back, next commit replaced the damaged one %d times%s; both damaged %s",
+                 fellBack, total, replaced, failed.c_str(), nothing ? "loads nothing" : "loaded");
+        add("Corruption", fellBack == total && replaced == total && nothing, detail);
+    }
+
+    // A boot's lookups: the device defaults as a record and as the per-key layout
+    void checkBootReads() {
+        HostPreferences::erase();
+        {
+            BMDeviceDefaults defaults;
+            defaults.begin();
+        }
+        unsigned long before = HostPreferences::reads();
+        {
+            BMDeviceDefaults defaults;
+            defaults.begin();
+        }
+        unsigned long recordReads = HostPreferences::reads() - before;
+
+        HostPreferences::erase();
+        {
+            Preferences legacy;
+            legacy.begin(DEFAULTS_NAMESPACE, false);
+            legacy.putInt(PREF_VERSION, DEFAULTS_VERSION);
+            legacy.putInt(PREF_BRIGHTNESS, 64);
+            legacy.putString(PREF_OWNER, "Legacy");
+            legacy.end();
+        }
+        before = HostPreferences::reads();
+        {
+            BMDeviceDefaults defaults;
+            defaults.begin();
+        }
+        unsigned long perKeyReads = HostPreferences::reads() - before;
+
+        char detail[160];
+        snprintf(detail, sizeof(detail), "%lu lookups from the record, %lu from the per-key layout", recordReads,
+                 perKeyReads);
+        add("Boot reads", recordReads == 2 && perKeyReads > recordReads, detail);
+    }
+
+    void checkSoundSettings() {
+        SoundSettings settings;
+        settings.amplitude = 1234;
+        settings.rainbowMode = true;
+        settings.smoothingFactor = 0.55f;
+        settings.maxLEDs = 17;
+        settings.fillFromCenter = true;
+
+        uint8_t encoded[SOUND_SETTINGS_SIZE + 1];
+        size_t length = encodeSoundSettings(settings, encoded);
+        SoundSettings decoded;
+        bool ok = decodeSoundSettings(encoded, length, decoded);
+        uint8_t reencoded[SOUND_SETTINGS_SIZE + 1];
+        bool same = ok && encodeSoundSettings(decoded, reencoded) == length &&
+                    memcmp(encoded, reencoded, length) == 0 && decoded.amplitude == 1234 && decoded.rainbowMode &&
+                    decoded.smoothingFactor == 0.55f && decoded.maxLEDs == 17 && decoded.fillFromCenter;
+        SoundSettings ignored;
+        bool shortRefused = !decodeSoundSettings(encoded, length - 1, ignored);
+        bool longRefused = !decodeSoundSettings(encoded, length + 1, ignored);
+
+        char detail[160];
+        snprintf(detail, sizeof(detail), "%zu bytes (expected %d), %s, wrong lengths %s", length, SOUND_SETTINGS_SIZE,
+                 same ? "decodes unchanged" : "decodes differently",
+                 shortRefused && longRefused ? "refused" : "accepted");
+        add("Sound settings", length == SOUND_SETTINGS_SIZE && same && shortRefused && longRefused, detail);
+    }
+
+    std::unique_ptr<Preferences> preferences_;
+    std::vector<Check> checks_;
+};
+
+void printUsage(const char* argv0) { fprintf(stderr, "usage: %s records\n", argv0); }
+
+}
+
+int runRecords(int argc, char** argv) {
+    if (argc > 2) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    printf("\n--- Records: versioned settings records (%d-byte header) ---\n", SETTINGS_RECORD_HEADER);
+    std::vector<Check> checks = RecordsCheck().run();
+    int failures = 0;
+    for (const Check& c : checks) {
+        printf("%-16s %s: %s\n", (c.name + ":").c_str(), c.ok ? "ok" : "FAILED", c.detail.c_str());
+        failures += !c.ok;
+    }
+    printf("%s: %d of %zu checks failed\n", failures == 0 ? "PASS" : "FAIL", failures, checks.size());
+    return failures == 0 ? 0 : 1;
+}
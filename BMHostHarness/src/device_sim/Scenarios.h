@@ -0,0 +1,16 @@
+#ifndef DEVICE_SIM_SCENARIOS_H
+#define DEVICE_SIM_SCENARIOS_H
+
+// Each scenario parses its own options from argv[2] on and returns the exit code
+int runStatus(int argc, char** argv);
+int runState(int argc, char** argv);
+int runBatch(int argc, char** argv);
+int runFeatures(int argc, char** argv);
+int runDefaults(int argc, char** argv);
+int runRecords(int argc, char** argv);
+int runHeap(int argc, char** argv);
+int runPreview(int argc, char** argv);
+int runTransfer(int argc, char** argv);
+int runBoot(int argc, char** argv);
+
+#endif // DEVICE_SIM_SCENARIOS_H
@@ -0,0 +1,260 @@
+// State scenario: BMDeviceState's change tracking, and what BMDevice does
+// with the change stream.
+//
+// Setters: on a fresh state, every setter must mark exactly its own field
+// and bump the generation once per field, setting the same value again must
+// mark nothing, and a listener must get the field once from publishChanges().
+// The same goes for a JSON state update and reset().
+//
+// Device: a complete BMDevice with an app connected straight to HostBle
+// (no link model; the app acknowledges every status at once). A command from
+// the app must be answered with a status notification by the loop() that
+// follows it, a prop nobody touches for --seconds must notify nothing, and
+// GPS speed settings must reach Preferences in one commit.
+//
+// Usage:
+//   device_sim state [options]
+//     --seconds <s>        quiet time to watch (default 60)
+//
+// Exits non-zero if any check fails.
+
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+#include <Preferences.h>
+#include <BMDevice.h>
+#include "DeviceFixture.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define STATE_STEP_US 1000ULL
+
+namespace {
+
+struct SetterCase {
+    std::string name;
+    uint32_t fields;
+    std::function<void(BMDeviceState&)> set;
+};
+
+std::vector<SetterCase> setterCases() {
+    std::vector<SetterCase> cases = {
+        {"setPower", STATE_POWER, [](BMDeviceState& s) { s.setPower(false); }},
+        {"setBrightness", STATE_BRIGHTNESS, [](BMDeviceState& s) { s.setBrightness(42); }},
+        {"setSpeed", STATE_SPEED, [](BMDeviceState& s) { s.setSpeed(77); }},
+        {"setReverseStrip", STATE_DIRECTION, [](BMDeviceState& s) { s.setReverseStrip(false); }},
+        {"setPalette", STATE_PALETTE,
+         [](BMDeviceState& s) { s.setPalette((AvailablePalettes)((int)AvailablePalettes::cool + 1)); }},
+        {"setEffect", STATE_EFFECT,
+         [](BMDeviceState& s) { s.setEffect((LightSceneID)((int)LightSceneID::palette_stream + 1)); }},
+        {"setEffectColor", STATE_EFFECT_COLOR, [](BMDeviceState& s) { s.setEffectColor(CRGB(1, 2, 3)); }},
+        {"setOrigin", STATE_ORIGIN, [](BMDeviceState& s) { s.setOrigin(Position(1, 2)); }},
+        {"setCurrentPosition", STATE_POSITION, [](BMDeviceState& s) { s.setCurrentPosition(Position(3, 4)); }},
+        {"setPositionAvailable", STATE_POSITION_AVAILABLE, [](BMDeviceState& s) { s.setPositionAvailable(true); }},
+        {"setCurrentSpeed", STATE_CURRENT_SPEED, [](BMDeviceState& s) { s.setCurrentSpeed(12.5f); }},
+        {"setGpsLowSpeed", STATE_GPS_LOW_SPEED, [](BMDeviceState& s) { s.setGpsLowSpeed(7); }},
+        {"setGpsTopSpeed", STATE_GPS_TOP_SPEED, [](BMDeviceState& s) { s.setGpsTopSpeed(30); }},
+        {"setGpsLightshowSpeedEnabled", STATE_GPS_LIGHTSHOW_SPEED,
+         [](BMDeviceState& s) { s.setGpsLightshowSpeedEnabled(true); }},
+        {"setSpeedometerColors", STATE_SPEEDOMETER_COLORS,
+         [](BMDeviceState& s) { s.setSpeedometerColors(CRGB(1, 1, 1), CRGB(2, 2, 2)); }},
+        {"applyStateUpdate", STATE_BRIGHTNESS | STATE_EFFECT_PARAMETER(0),
+         [](BMDeviceState& s) { s.applyStateUpdate("{\"bri\":42,\"waveWidth\":7,\"spd\":100}"); }},
+    };
+    for (uint8_t i = 0; i < STATE_EFFECT_PARAMETER_COUNT; i++) {
+        cases.push_back({"setEffectParameter(" + std::to_string(i) + ")", STATE_EFFECT_PARAMETER(i),
+                         [i](BMDeviceState& s) { s.setEffectParameter(i, 99); }});
+    }
+    return cases;
+}
+
+// Returns the number of setters that fail
+int checkSetters(int& total) {
+    std::vector<SetterCase> cases = setterCases();
+    total = (int)cases.size() + 1;
+    int failures = 0;
+    for (const SetterCase& setter : cases) {
+        BMDeviceState state;
+        uint32_t published = 0;
+        int calls = 0;
+        state.onChange([&](uint32_t fields) {
+            published |= fields;
+            calls++;
+        });
+
+        uint32_t generation = state.getGeneration();
+        setter.set(state);
+        uint32_t marked = state.getChanged();
+        bool bumped = state.getGeneration() == generation + (uint32_t)__builtin_popcount(setter.fields);
+        state.publishChanges();
+        bool cleared = state.getChanged() == 0;
+        setter.set(state);
+        bool quiet = state.getChanged() == 0;
+        state.publishChanges();
+
+        if (marked != setter.fields || !bumped || !cleared || !quiet || published != setter.fields || calls != 1) {
+            printf("  %-28s marked 0x%08X (want 0x%08X), generation %s, %s, same value %s, %d publishes\n",
+                   setter.name.c_str(), marked, setter.fields, bumped ? "bumped" : "wrong",
+                   cleared ? "cleared" : "not cleared", quiet ? "quiet" : "marked again", calls);
+            failures++;
+        }
+    }
+
+    BMDeviceState state;
+    state.reset();
+    if (state.getChanged() != STATE_ALL) {
+        printf("  %-28s marked 0x%08X (want 0x%08X)\n", "reset", state.getChanged(), STATE_ALL);
+        failures++;
+    }
+    return failures;
+}
+
+struct DeviceResult {
+    bool commandAnswered = false;   // In the loop() after the command
+    bool commandField = false;      // ...with the changed field in it
+    unsigned long quietNotifications = 0;
+    unsigned long quietWrites = 0;
+    bool lowSpeedSaved = false;
+    bool topSpeedClamped = false;
+    unsigned long gpsWrites = 0;
+};
+
+class DeviceCheck {
+public:
+    explicit DeviceCheck(double seconds) : seconds_(seconds) {}
+
+    DeviceResult run() {
+        device_ = newDevice();
+        powerOn(*device_);
+        HostBle::onNotify([this](const char* uuid, const uint8_t* data, size_t length) {
+            (void)uuid;
+            notified(data, length);
+        });
+        HostBle::connect();
+        loopFor(1000000);
+
+        // A command is answered by the next loop()
+        notifications_ = 0;
+        fields_.clear();
+        std::vector<uint8_t> brightness = withInt(BLE_FEATURE_BRIGHTNESS, 33);
+        writeFeature(brightness);
+        loopFor(STATE_STEP_US);
+        result_.commandAnswered = notifications_ > 0;
+        result_.commandField = std::find(fields_.begin(), fields_.end(), STATUS_BRIGHTNESS) != fields_.end();
+        loopFor(1000000);
+
+        // Nothing changes, nothing is sent
+        notifications_ = 0;
+        unsigned long writes = HostPreferences::writes();
+        loopFor((uint64_t)(seconds_ * 1e6));
+        result_.quietNotifications = notifications_;
+        result_.quietWrites = HostPreferences::writes() - writes;
+
+        // GPS speed settings persist through the change stream
+        writes = HostPreferences::writes();
+        std::vector<uint8_t> low = withFloat(BLE_FEATURE_SET_GPS_LOW_SPEED, 7.5f);
+        writeFeature(low);
+        loopFor(STATE_STEP_US);
+        // A top speed under the low one is raised by the defaults, and the
+        // state follows
+        std::vector<uint8_t> top = withFloat(BLE_FEATURE_SET_GPS_TOP_SPEED, 5.0f);
+        writeFeature(top);
+        loopFor(10 * STATE_STEP_US);
+        result_.topSpeedClamped = device_->getState().gpsTopSpeed == 8.5f;
+        // Both settle into one commit
+        loopFor(DEFAULTS_COMMIT_IDLE_MS * 1000ULL + 10 * STATE_STEP_US);
+        result_.gpsWrites = HostPreferences::writes() - writes;
+        BMDeviceDefaults stored;
+        stored.begin();
+        result_.lowSpeedSaved = stored.getGPSLowSpeed() == 7.5f && stored.getGPSTopSpeed() == 8.5f;
+
+        HostBle::disconnect();
+        return result_;
+    }
+
+private:
+    void notified(const uint8_t* data, size_t length) {
+        notifications_++;
+        StatusMessageHeader header;
+        bool valid = parseStatusMessage(data, length, header, [this](uint8_t tag, const uint8_t*, size_t) {
+            fields_.push_back(tag);
+        });
+        if (valid && (header.flags & STATUS_FLAG_LAST)) {
+            acks_.push_back(header.seq);
+        }
+    }
+
+    // The app acknowledges between loops, never from inside a notification
+    void loopFor(uint64_t us) {
+        uint64_t endUs = HostTime::micros() + us;
+        for (uint64_t nowUs = HostTime::micros(); nowUs < endUs; nowUs += STATE_STEP_US) {
+            HostTime::setMicros(nowUs);
+            device_->loop();
+            std::vector<uint16_t> acks;
+            acks.swap(acks_);
+            for (uint16_t seq : acks) {
+                uint8_t ack[3] = {BLE_FEATURE_STATUS_ACK, (uint8_t)seq, (uint8_t)(seq >> 8)};
+                writeFeature(ack, sizeof(ack));
+            }
+        }
+        HostTime::setMicros(endUs);
+    }
+
+    double seconds_;
+    std::unique_ptr<BMDevice> device_;
+    unsigned long notifications_ = 0;
+    std::vector<uint8_t> fields_;
+    std::vector<uint16_t> acks_;
+    DeviceResult result_;
+};
+
+void printUsage(const char* argv0) { fprintf(stderr, "usage: %s state [--seconds s]\n", argv0); }
+
+}
+
+int runState(int argc, char** argv) {
+    double seconds = 60;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--seconds") seconds = std::max(1.0, atof(value));
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    printf("\n--- Device state change tracking ---\n");
+    int setters = 0;
+    int setterFailures = checkSetters(setters);
+    printf("Setters:  %d of %d mark exactly their fields\n", setters - setterFailures, setters);
+
+    DeviceResult device = DeviceCheck(seconds).run();
+    printf("Command:  %s\n", !device.commandAnswered ? "no status in the next loop"
+                             : device.commandField ? "status with the field in the next loop"
+                                                   : "status without the field in the next loop");
+    printf("Quiet:    %lu notifications, %lu Preferences writes in %.0f s\n", device.quietNotifications,
+           device.quietWrites, seconds);
+    printf("GPS:      speeds %s, top speed %s, %lu Preferences writes for two settings\n",
+           device.lowSpeedSaved ? "saved" : "not saved", device.topSpeedClamped ? "raised above it" : "not raised",
+           device.gpsWrites);
+
+    bool ok = setterFailures == 0 && device.commandAnswered && device.commandField &&
+              device.quietNotifications == 0 && device.quietWrites == 0 && device.lowSpeedSaved &&
+              device.topSpeedClamped && device.gpsWrites == 1;
+    printf("%s: %d setter failures, command %s, %lu quiet notifications, %lu GPS writes (target: 0, answered in "
+           "one loop, 0, 1)\n",
+           ok ? "PASS" : "FAIL", setterFailures, device.commandField ? "answered" : "not answered",
+           device.quietNotifications, device.gpsWrites);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,359 @@
+// Status scenario: what BMDevice's status notifications cost on the air.
+//
+// A complete BMDevice (state, defaults, BLE handler, light show) runs against
+// HostArduino's BLE shim, and a simulated app on the other end of a BleLink
+// receives its notifications. The app connects, then changes a setting every
+// --change seconds for --seconds; the prop sends its periodic status every
+// 5 s as usual.
+//
+// The run goes once with the JSON chunks (four documents, 25 ms apart, the
+// full set every time) and once with the binary status (BMStatusProtocol.h):
+// one full snapshot on connect, then only the fields changed since the app's
+// last acknowledgement. --ack-loss of the app's acknowledgements are never
+// sent, as when an app is backgrounded mid-update.
+//
+// Reported per format: time from connecting until the app has every field,
+// what that took on the air, and the bytes on air per minute afterwards. The
+// binary run then checks the state the app built from deltas against a full
+// snapshot sent on a fresh connection.
+//
+// Usage:
+//   device_sim status [options]
+//     --seconds <s>        simulated time after connecting (default 120)
+//     --change <s>         seconds between the app's setting changes (default 10)
+//     --interval <ms>      connection interval (default 30)
+//     --mtu <n>            ATT MTU (default 185)
+//     --dle                251-byte LL payloads (Data Length Extension)
+//     --ack-loss <pct>     acknowledgements the app never sends (default 10)
+//     --seed <n>           random seed
+//
+// Exits non-zero unless the binary status reaches full state no later than
+// the JSON chunks, uses at most a quarter of their bytes on air per minute,
+// and the app's delta-built state matches the fresh snapshot.
+
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include <BMDevice.h>
+#include "BleLink.h"
+#include "DeviceFixture.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#define STATUS_STEP_US 1000ULL
+#define STATUS_CONNECT_TIMEOUT_US 5000000ULL
+#define STATUS_SETTLE_US 6000000ULL         // A periodic update and its acknowledgement
+#define STATUS_BYTES_RATIO 0.25             // Binary bytes per minute at most this share of JSON's
+#define STATUS_JSON_CHUNKS 4
+
+namespace {
+
+struct StatusConfig {
+    double seconds = 120;
+    double changeSeconds = 10;
+    double intervalMs = 30;
+    int mtu = 185;
+    bool dle = false;
+    double ackLossPercent = 10;
+    unsigned seed = 1;
+};
+
+struct RunResult {
+    double connectMs = -1;              // -1: never had the full state
+    uint64_t connectAirBytes = 0;
+    uint64_t connectNotifications = 0;
+    uint64_t airBytes = 0;              // After connecting
+    uint64_t notifications = 0;
+    uint64_t valueBytes = 0;
+    uint64_t readBlobs = 0;
+    uint64_t changes = 0;
+    // Binary only
+    bool checked = false;
+    bool matches = false;
+    size_t fields = 0;
+    StatusEncoderStats encoder = {};
+};
+
+typedef std::map<uint8_t, std::vector<uint8_t>> FieldMap;
+
+class StatusSim {
+public:
+    StatusSim(const StatusConfig& config, StatusFormat format)
+        : config_(config), format_(format), link_(linkModel(config)), rng_(config.seed) {}
+
+    RunResult run() {
+        randomSeed(config_.seed);
+        device_ = newDevice();
+        powerOn(*device_);
+        device_->setStatusFormat(format_);
+        HostBle::onNotify([this](const char* uuid, const uint8_t* data, size_t length) {
+            (void)uuid;
+            uint64_t atUs = link_.notify(HostTime::micros(), length);
+            events_.insert({atUs, Event{true, std::vector<uint8_t>(data, data + length)}});
+        });
+
+        // Connect and wait for the whole state
+        connect();
+        uint64_t startUs = HostTime::micros();
+        runUntil(startUs + STATUS_CONNECT_TIMEOUT_US, [this]() { return fullAtUs_ != 0; });
+        if (fullAtUs_) {
+            result_.connectMs = (fullAtUs_ - startUs) / 1000.0;
+        }
+        result_.connectAirBytes = link_.stats().airBytes;
+        result_.connectNotifications = link_.stats().notifications;
+
+        // Then the app changes settings now and then
+        uint64_t endUs = startUs + (uint64_t)(config_.seconds * 1e6);
+        uint64_t changeUs = (uint64_t)(config_.changeSeconds * 1e6);
+        uint64_t nextChangeUs = startUs + changeUs;
+        BleLinkStats before = link_.stats();
+        while (HostTime::micros() < endUs) {
+            uint64_t untilUs = std::min(endUs, nextChangeUs);
+            runUntil(untilUs, nullptr);
+            if (HostTime::micros() >= nextChangeUs) {
+                changeSetting();
+                nextChangeUs += changeUs;
+            }
+        }
+        result_.airBytes = link_.stats().airBytes - before.airBytes;
+        result_.notifications = link_.stats().notifications - before.notifications;
+        result_.valueBytes = link_.stats().valueBytes - before.valueBytes;
+        result_.readBlobs = link_.stats().readBlobs - before.readBlobs;
+
+        if (format_ == STATUS_FORMAT_BINARY) {
+            check();
+            result_.encoder = device_->getStatusEncoder().getStats();
+        }
+        HostBle::disconnect();
+        return result_;
+    }
+
+private:
+    struct Event {
+        bool toApp;
+        std::vector<uint8_t> data;
+    };
+
+    static BleLinkModel linkModel(const StatusConfig& config) {
+        BleLinkModel model;
+        model.mtu = config.mtu;
+        model.llPayload = config.dle ? 251 : 27;
+        model.intervalUs = config.intervalMs * 1000;
+        return model;
+    }
+
+    void connect() {
+        mirror_.clear();
+        chunks_.clear();
+        fullAtUs_ = 0;
+        events_.clear();
+        link_.reset();
+        HostBle::connect();
+    }
+
+    // Steps the prop and delivers what the link carries until untilUs or done()
+    void runUntil(uint64_t untilUs, std::function<bool()> done) {
+        for (uint64_t nowUs = HostTime::micros(); nowUs < untilUs; nowUs += STATUS_STEP_US) {
+            HostTime::setMicros(nowUs);
+            while (!events_.empty() && events_.begin()->first <= nowUs) {
+                Event event = events_.begin()->second;
+                events_.erase(events_.begin());
+                if (event.toApp) {
+                    appReceive(event.data);
+                } else {
+                    writeFeature(event.data);
+                }
+            }
+            device_->loop();
+            if (done && done()) {
+                return;
+            }
+        }
+        HostTime::setMicros(untilUs);
+    }
+
+    void appWrite(const std::vector<uint8_t>& data) {
+        uint64_t atUs = link_.write(HostTime::micros(), data.size());
+        events_.insert({atUs, Event{false, data}});
+    }
+
+    void appReceive(const std::vector<uint8_t>& data) {
+        if (format_ == STATUS_FORMAT_JSON) {
+            JsonDocument doc;
+            if (deserializeJson(doc, (const char*)data.data(), data.size()) == DeserializationError::Ok) {
+                const char* type = doc["type"] | "";
+                chunks_.insert(type);
+            }
+            if (chunks_.size() >= STATUS_JSON_CHUNKS && !fullAtUs_) {
+                fullAtUs_ = HostTime::micros();
+            }
+            return;
+        }
+
+        StatusMessageHeader header;
+        FieldMap fields;
+        bool valid = parseStatusMessage(data.data(), data.size(), header,
+                                        [&fields](uint8_t tag, const uint8_t* value, size_t length) {
+                                            fields[tag].assign(value, value + length);
+                                        });
+        if (!valid) {
+            return;
+        }
+        if ((header.flags & STATUS_FLAG_FULL) && header.fragment == 0) {
+            mirror_.clear();
+        }
+        for (const auto& field : fields) {
+            mirror_[field.first] = field.second;
+        }
+        if (header.flags & STATUS_FLAG_LAST) {
+            if ((header.flags & STATUS_FLAG_FULL) && !fullAtUs_) {
+                fullAtUs_ = HostTime::micros();
+            }
+            if (std::uniform_real_distribution<double>(0, 100)(rng_) >= config_.ackLossPercent) {
+                appWrite({BLE_FEATURE_STATUS_ACK, (uint8_t)header.seq, (uint8_t)(header.seq >> 8)});
+            }
+        }
+    }
+
+    // What someone poking at the app does
+    void changeSetting() {
+        result_.changes++;
+        switch (std::uniform_int_distribution<int>(0, 4)(rng_)) {
+            case 0:
+                appWrite(withInt(BLE_FEATURE_BRIGHTNESS, std::uniform_int_distribution<int>(10, 100)(rng_)));
+                break;
+            case 1:
+                appWrite(withInt(BLE_FEATURE_SPEED, std::uniform_int_distribution<int>(5, 200)(rng_)));
+                break;
+            case 2:
+                appWrite({BLE_FEATURE_EFFECT,
+                          (uint8_t)std::uniform_int_distribution<int>(0, (int)LightSceneID::spiral_galaxy)(rng_)});
+                break;
+            case 3:
+                appWrite({BLE_FEATURE_PALETTE,
+                          (uint8_t)std::uniform_int_distribution<int>(0, (int)AvailablePalettes::moltenmetal)(rng_)});
+                break;
+            default: {
+                uint8_t feature = BLE_FEATURE_WAVE_WIDTH +
+                                  std::uniform_int_distribution<int>(0, BLE_FEATURE_SPIRAL_ARMS - BLE_FEATURE_WAVE_WIDTH)(rng_);
+                appWrite(withInt(feature, std::uniform_int_distribution<int>(1, 10)(rng_)));
+                break;
+            }
+        }
+    }
+
+    // The state the app built from deltas against a full snapshot on a new
+    // connection, with nothing changed in between
+    void check() {
+        runUntil(HostTime::micros() + STATUS_SETTLE_US, nullptr);
+        FieldMap built = mirror_;
+
+        HostBle::disconnect();
+        runUntil(HostTime::micros() + 1000000, nullptr);
+        connect();
+        runUntil(HostTime::micros() + STATUS_CONNECT_TIMEOUT_US, [this]() { return fullAtUs_ != 0; });
+
+        result_.checked = fullAtUs_ != 0;
+        result_.matches = result_.checked && built == mirror_;
+        result_.fields = mirror_.size();
+    }
+
+    StatusConfig config_;
+    StatusFormat format_;
+    BleLink link_;
+    std::mt19937 rng_;
+    std::unique_ptr<BMDevice> device_;
+    std::multimap<uint64_t, Event> events_;
+
+    // The app's view
+    FieldMap mirror_;
+    std::set<std::string> chunks_;
+    uint64_t fullAtUs_ = 0;
+
+    RunResult result_;
+};
+
+void printUsage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s status [--seconds s] [--change s] [--interval ms] [--mtu n] [--dle] [--ack-loss pct] "
+            "[--seed n]\n",
+            argv0);
+}
+
+double perMinute(uint64_t value, double seconds) { return seconds > 0 ? value * 60.0 / seconds : 0; }
+
+void printRun(const char* name, const RunResult& run, const StatusConfig& config) {
+    printf("%-8s full state %7.1f ms, %5llu B on air in %llu notifications; then %7.0f B/min on air "
+           "(%llu notifications, %llu B of values, %llu Read Blobs)\n",
+           name, run.connectMs, (unsigned long long)run.connectAirBytes,
+           (unsigned long long)run.connectNotifications, perMinute(run.airBytes, config.seconds),
+           (unsigned long long)run.notifications, (unsigned long long)run.valueBytes,
+           (unsigned long long)run.readBlobs);
+}
+
+int report(const StatusConfig& config, const RunResult& json, const RunResult& binary) {
+    printf("\n--- Status notifications (%.0f s simulated, a change every %.0f s) ---\n", config.seconds,
+           config.changeSeconds);
+    printf("Link:                    %d B MTU, %d B LL payload, %.1f ms interval, %.0f%% of ACKs lost\n",
+           config.mtu, config.dle ? 251 : 27, config.intervalMs, config.ackLossPercent);
+    printRun("JSON:", json, config);
+    printRun("Binary:", binary, config);
+    printf("Binary:  %u messages (%u full), %u fragments, %u fields; %u ACKs, %u stale\n",
+           binary.encoder.messages, binary.encoder.fullSnapshots, binary.encoder.fragments, binary.encoder.fields,
+           binary.encoder.acks, binary.encoder.staleAcks);
+    printf("Check:   %s (%zu fields after reconnecting)\n",
+           !binary.checked ? "no snapshot" : binary.matches ? "delta state matches" : "delta state differs",
+           binary.fields);
+
+    bool fast = json.connectMs >= 0 && binary.connectMs >= 0 && binary.connectMs <= json.connectMs;
+    double ratio = json.airBytes ? (double)binary.airBytes / json.airBytes : 1;
+    bool ok = fast && ratio <= STATUS_BYTES_RATIO && binary.matches;
+    printf("%s: full state in %.1f -> %.1f ms, %.0f -> %.0f B/min on air (%.0f%%), delta state %s "
+           "(target: no slower, at most %.0f%% of the bytes, matching)\n",
+           ok ? "PASS" : "FAIL", json.connectMs, binary.connectMs, perMinute(json.airBytes, config.seconds),
+           perMinute(binary.airBytes, config.seconds), ratio * 100, binary.matches ? "matches" : "differs",
+           STATUS_BYTES_RATIO * 100);
+    return ok ? 0 : 1;
+}
+
+}
+
+int runStatus(int argc, char** argv) {
+    StatusConfig config;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--dle") {
+            config.dle = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--seconds") config.seconds = std::max(10.0, atof(value));
+        else if (arg == "--change") config.changeSeconds = std::max(1.0, atof(value));
+        else if (arg == "--interval") config.intervalMs = std::max(7.5, atof(value));
+        else if (arg == "--mtu") config.mtu = std::max(23, atoi(value));
+        else if (arg == "--ack-loss") config.ackLossPercent = std::min(100.0, std::max(0.0, atof(value)));
+        else if (arg == "--seed") config.seed = (unsigned)atoi(value);
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    RunResult json = StatusSim(config, STATUS_FORMAT_JSON).run();
+    RunResult binary = StatusSim(config, STATUS_FORMAT_BINARY).run();
+    return report(config, json, binary);
+}
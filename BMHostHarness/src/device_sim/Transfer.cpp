@@ -0,0 +1,562 @@
+// Transfer scenario: bulk transfers (BMTransferProtocol.h) and the link the
+// prop negotiates for them, on simulated links.
+//
+// A complete BMDevice with four strips runs against HostArduino's BLE shim,
+// with a simulated app on the other end of a BleLink. The prop registers a
+// --log byte log as a transfer source and takes presets of up to --preset
+// bytes through a sink. Once connected, the app sets the MTU and, per link:
+//   - reads the configuration the old way (BLE_FEATURE_GET_CONFIGURATION:
+//     one notification, the rest with Read Blob) and as a transfer,
+//   - downloads the log,
+//   - uploads a preset with write commands,
+// each with a --window fragment window.
+//
+// Links: MTU 23, 185 and 247 without and with Data Length Extension, at 1M
+// and 2M PHY, and MTU 512; --interval ms connection events, each as long as
+// --event ms allows.
+//
+// Then, on the 185-byte link: a download the app stops acknowledging, one
+// the app aborts, one cut off by a disconnect, and a request and an upload
+// of a kind the prop has no source or sink for.
+//
+// Usage:
+//   device_sim transfer [options]
+//     --log <bytes>        log size (default 16384)
+//     --preset <bytes>     preset size (default 4096)
+//     --window <n>         fragments in flight, 1-32 (default 8); a
+//                          window of a fragment or two leaves transfers
+//                          bound by round trips, whatever the link
+//     --interval <ms>      connection interval (default 30)
+//     --event <ms>         connection event length (default 7.5)
+//
+// Exits non-zero if a payload arrives damaged or not at all, more fragments
+// are ever in flight than the window, a status or transfer notification
+// doesn't fit the MTU, the prop doesn't ask the controller for Data Length
+// Extension and 2M PHY once connected, log goodput on a larger MTU is no
+// higher than at 23 bytes, or no higher with Data Length Extension than
+// without or at 2M than at 1M, the configuration is slower as a transfer
+// than the old way where that takes Read Blob, or any of the last five
+// doesn't end as it should.
+
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+#include <Preferences.h>
+#include <BMDevice.h>
+#include "BleLink.h"
+#include "DeviceFixture.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define TRANSFER_STEP_US 1000ULL
+#define TRANSFER_SIM_LEDS 60
+#define TRANSFER_SIM_STRIPS 4
+#define TRANSFER_SIM_MAX_PAYLOAD 65536
+#define TRANSFER_PHASE_LIMIT_US 120000000ULL
+#define TRANSFER_HCI_LE_SET_DATA_LENGTH 0x2022
+#define TRANSFER_HCI_LE_SET_PHY 0x2032
+
+namespace {
+
+CRGB stripLeds[TRANSFER_SIM_STRIPS][TRANSFER_SIM_LEDS];
+
+struct TransferConfig {
+    size_t logSize = 16384;
+    size_t presetSize = 4096;
+    int window = TRANSFER_DEFAULT_WINDOW;
+    double intervalMs = 30;
+    double eventMs = 7.5;
+};
+
+struct LinkSetup {
+    const char* name;
+    int mtu;
+    int llPayload;
+    double phyMbps;
+};
+
+// One download or upload as the app saw it
+struct Phase {
+    bool ok = false;
+    size_t bytes = 0;
+    double ms = 0;
+    uint32_t fragments = 0;
+    uint32_t wireBytes = 0;     // Transfer messages, headers included
+    uint64_t airBytes = 0;      // LL packets, both directions
+
+    double goodput() const { return ms > 0 ? bytes / ms : 0; }     // kB/s
+    double overhead() const { return bytes ? (double)airBytes / bytes - 1 : 0; }
+};
+
+struct LinkResult {
+    Phase legacyConfig;
+    Phase config;
+    Phase log;
+    Phase preset;
+    bool linkRequested = false;
+    size_t maxStatus = 0;       // Longest status notification
+    size_t maxTransfer = 0;     // Longest transfer message, either way
+    uint16_t maxInFlight = 0;
+};
+
+std::vector<uint8_t> makePayload(size_t size, uint32_t seed) {
+    std::vector<uint8_t> payload(size);
+    uint32_t x = seed;
+    for (size_t i = 0; i < size; i++) {
+        x = x * 1664525u + 1013904223u;
+        payload[i] = (uint8_t)(x >> 24);
+    }
+    return payload;
+}
+
+void addStrip(BMDevice& device, int strip) {
+    CRGB* array = stripLeds[strip];
+    switch (strip) {
+        case 0: device.addLEDStrip<WS2812B, 5, GRB>(array, TRANSFER_SIM_LEDS); break;
+        case 1: device.addLEDStrip<WS2812B, 12, GRB>(array, TRANSFER_SIM_LEDS); break;
+        case 2: device.addLEDStrip<WS2812B, 13, GRB>(array, TRANSFER_SIM_LEDS); break;
+        default: device.addLEDStrip<WS2812B, 14, GRB>(array, TRANSFER_SIM_LEDS); break;
+    }
+}
+
+class TransferSim {
+public:
+    TransferSim(const TransferConfig& config, const LinkSetup& setup)
+        : config_(config), setup_(setup), link_(linkModel(config, setup)), appBuffer_(TRANSFER_SIM_MAX_PAYLOAD),
+          appReceiver_(appBuffer_.data(), appBuffer_.size()), log_(makePayload(config.logSize, 1)),
+          preset_(makePayload(config.presetSize, 2)) {}
+
+    // A device on a fresh connection at this link's MTU
+    void start() {
+        randomSeed(1);
+        memset(stripLeds, 0, sizeof(stripLeds));
+
+        device_ = newDevice();
+        for (int s = 0; s < TRANSFER_SIM_STRIPS; s++) {
+            addStrip(*device_, s);
+        }
+        device_->registerTransferSource(TRANSFER_KIND_LOG, [this]() { return (uint32_t)log_.size(); },
+                                        [this](uint32_t offset, uint8_t* out, size_t capacity) {
+                                            size_t n = std::min(capacity, log_.size() - offset);
+                                            memcpy(out, log_.data() + offset, n);
+                                            return n;
+                                        });
+        device_->registerTransferSink(TRANSFER_KIND_PRESET, config_.presetSize,
+                                      [this](const uint8_t* data, size_t length) {
+                                          received_.assign(data, data + length);
+                                      });
+        powerOn(*device_);
+        HostBle::onNotify([this](const char* uuid, const uint8_t* data, size_t length) {
+            (void)uuid;
+            notified(data, length);
+        });
+
+        link_.reset();
+        HostBle::connect();
+        HostBle::setMtu((uint16_t)setup_.mtu);
+        runUntil(HostTime::micros() + 100000);
+    }
+
+    LinkResult runLink() {
+        start();
+        const std::vector<HostBle::Command>& commands = HostBle::commands();
+        bool dataLength = false, phy = false;
+        for (const HostBle::Command& command : commands) {
+            dataLength |= command.opcode == TRANSFER_HCI_LE_SET_DATA_LENGTH;
+            phy |= command.opcode == TRANSFER_HCI_LE_SET_PHY;
+        }
+        result_.linkRequested = dataLength && phy;
+
+        // Something for status to say
+        appWrite({BLE_FEATURE_BRIGHTNESS, 40});
+        runUntil(HostTime::micros() + 500000);
+
+        result_.legacyConfig = readLegacyConfig();
+        result_.config = download(1, TRANSFER_KIND_CONFIGURATION, nullptr);
+        result_.config.ok = result_.config.ok && result_.legacyConfig.ok && downloaded_ == legacyJson_;
+        result_.log = download(2, TRANSFER_KIND_LOG, &log_);
+        result_.preset = upload(3, TRANSFER_KIND_PRESET, preset_);
+        HostBle::disconnect();
+        return result_;
+    }
+
+    // The app stops acknowledging; the prop gives up after TRANSFER_TIMEOUT_MS
+    bool timesOut() {
+        start();
+        ignoreTransfers_ = true;
+        requestDownload(4, TRANSFER_KIND_LOG);
+        runUntil(HostTime::micros() + TRANSFER_TIMEOUT_MS * 1000ULL - 500000);
+        bool waited = device_->getTransferSender().isActive() && aborts_ == 0;
+        runUntil(HostTime::micros() + 1500000);
+        bool ended = !device_->getTransferSender().isActive() && aborts_ == 1 &&
+                     device_->getTransferSender().getStats().aborted == 1;
+        HostBle::disconnect();
+        return waited && ended;
+    }
+
+    // The app aborts after the first fragment; nothing more comes but what
+    // was already in flight
+    bool appAborts() {
+        start();
+        abortAfterFirst_ = true;
+        requestDownload(5, TRANSFER_KIND_LOG);
+        runUntil(HostTime::micros() + 2000000);
+        bool ok = !device_->getTransferSender().isActive() && fragmentsReceived_ <= (uint32_t)config_.window &&
+                  device_->getTransferSender().getStats().aborted == 1;
+        HostBle::disconnect();
+        return ok;
+    }
+
+    // A disconnect ends the transfer; the next connection starts clean
+    bool disconnectEnds() {
+        start();
+        requestDownload(6, TRANSFER_KIND_LOG);
+        runUntil(HostTime::micros() + 100000);
+        bool started = device_->getTransferSender().isActive();
+        HostBle::disconnect();
+        events_.clear();
+        runUntil(HostTime::micros() + 100000);
+        bool ended = !device_->getTransferSender().isActive();
+        link_.reset();
+        HostBle::connect();
+        HostBle::setMtu((uint16_t)setup_.mtu);
+        Phase again = download(7, TRANSFER_KIND_LOG, &log_);
+        HostBle::disconnect();
+        return started && ended && again.ok;
+    }
+
+    // Neither a source nor a sink for animations: both are refused
+    bool refusesUnknownKinds() {
+        start();
+        requestDownload(8, TRANSFER_KIND_ANIMATION);
+        runUntil(HostTime::micros() + 500000);
+        bool refusedDownload = aborts_ == 1 && fragmentsReceived_ == 0;
+        Phase refused = upload(9, TRANSFER_KIND_ANIMATION, preset_);
+        bool refusedUpload = !refused.ok && aborts_ == 2 && received_.empty() && !appSender_.isActive();
+        HostBle::disconnect();
+        return refusedDownload && refusedUpload;
+    }
+
+private:
+    struct Event {
+        bool toApp;
+        std::vector<uint8_t> data;
+    };
+
+    static BleLinkModel linkModel(const TransferConfig& config, const LinkSetup& setup) {
+        BleLinkModel model;
+        model.mtu = setup.mtu;
+        model.llPayload = setup.llPayload;
+        model.phyMbps = setup.phyMbps;
+        model.intervalUs = config.intervalMs * 1000;
+        model.eventUs = config.eventMs * 1000;
+        model.packetsPerEvent = 64;
+        return model;
+    }
+
+    size_t maxValue() const { return (size_t)setup_.mtu - BLE_ATT_NOTIFY_HEADER; }
+
+    Phase readLegacyConfig() {
+        Phase phase;
+        legacyJson_.clear();
+        uint64_t startUs = HostTime::micros();
+        uint64_t startAir = link_.stats().airBytes;
+        appWrite({BLE_FEATURE_GET_CONFIGURATION}, true);
+        while (legacyJson_.empty() && HostTime::micros() - startUs < TRANSFER_PHASE_LIMIT_US) {
+            runUntil(HostTime::micros() + TRANSFER_STEP_US);
+        }
+        phase.ok = !legacyJson_.empty();
+        phase.bytes = legacyJson_.size();
+        phase.ms = (HostTime::micros() - startUs) / 1000.0;
+        phase.airBytes = link_.stats().airBytes - startAir;
+        return phase;
+    }
+
+    void requestDownload(uint8_t transfer, uint8_t kind) {
+        uint8_t message[1 + TRANSFER_HEADER_SIZE + 2] = {BLE_FEATURE_TRANSFER};
+        size_t length = buildTransferRequest(message + 1, transfer, kind, (uint8_t)config_.window);
+        appWrite(std::vector<uint8_t>(message, message + 1 + length), true);
+    }
+
+    Phase download(uint8_t transfer, uint8_t kind, const std::vector<uint8_t>* expected) {
+        Phase phase;
+        downloaded_.clear();
+        downloadDone_ = false;
+        uint64_t startUs = HostTime::micros();
+        uint64_t startAir = link_.stats().airBytes;
+        uint32_t startFragments = fragmentsReceived_;
+        uint32_t startWire = transferBytes_;
+        requestDownload(transfer, kind);
+        while (!downloadDone_ && HostTime::micros() - startUs < TRANSFER_PHASE_LIMIT_US) {
+            runUntil(HostTime::micros() + TRANSFER_STEP_US);
+        }
+        phase.bytes = downloaded_.size();
+        phase.ok = downloadDone_ && !downloaded_.empty() && (!expected || downloaded_ == *expected);
+        phase.ms = (HostTime::micros() - startUs) / 1000.0;
+        phase.fragments = fragmentsReceived_ - startFragments;
+        phase.wireBytes = transferBytes_ - startWire;
+        phase.airBytes = link_.stats().airBytes - startAir;
+        return phase;
+    }
+
+    Phase upload(uint8_t transfer, uint8_t kind, const std::vector<uint8_t>& payload) {
+        Phase phase;
+        received_.clear();
+        uint64_t startUs = HostTime::micros();
+        uint64_t startAir = link_.stats().airBytes;
+        const TransferStats& stats = appSender_.getStats();
+        uint32_t startFragments = stats.fragments;
+        uint32_t startWire = stats.bytes;
+        uint32_t startAborts = aborts_;
+        appSender_.begin(transfer, kind, payload.size(), (uint8_t)config_.window,
+                         [&payload](uint32_t offset, uint8_t* out, size_t capacity) {
+                             size_t n = std::min(capacity, payload.size() - offset);
+                             memcpy(out, payload.data() + offset, n);
+                             return n;
+                         },
+                         millis());
+        while (appSender_.isActive() && aborts_ == startAborts &&
+               HostTime::micros() - startUs < TRANSFER_PHASE_LIMIT_US) {
+            runUntil(HostTime::micros() + TRANSFER_STEP_US);
+        }
+        // The prop hands the payload over as soon as the last fragment is in
+        phase.ok = appSender_.isComplete() && received_ == payload;
+        phase.bytes = payload.size();
+        phase.ms = (HostTime::micros() - startUs) / 1000.0;
+        phase.fragments = stats.fragments - startFragments;
+        phase.wireBytes = stats.bytes - startWire;
+        phase.airBytes = link_.stats().airBytes - startAir;
+        return phase;
+    }
+
+    void notified(const uint8_t* data, size_t length) {
+        uint64_t atUs = link_.notify(HostTime::micros(), length);
+        bool transfer = length > 0 && data[0] == TRANSFER_MAGIC;
+        if (transfer) {
+            result_.maxTransfer = std::max(result_.maxTransfer, length);
+        } else if (length > 0 && data[0] == STATUS_MAGIC) {
+            result_.maxStatus = std::max(result_.maxStatus, length);
+        }
+        events_.insert({atUs, Event{true, std::vector<uint8_t>(data, data + length)}});
+    }
+
+    // A write request waits for the response to the one before; a write
+    // command goes right away
+    void appWrite(const std::vector<uint8_t>& data, bool command = false) {
+        uint64_t nowUs = std::max<uint64_t>(HostTime::micros(), writeReadyUs_);
+        uint64_t atUs = command ? link_.command(nowUs, data.size()) : link_.write(nowUs, data.size(), &writeReadyUs_);
+        if (data[0] == BLE_FEATURE_TRANSFER) {
+            result_.maxTransfer = std::max(result_.maxTransfer, data.size() - 1);
+        }
+        events_.insert({atUs, Event{false, data}});
+    }
+
+    void appTransfer(const uint8_t* message, size_t length) {
+        transferBytes_ += length;
+        uint8_t flags, transfer;
+        uint16_t fragment;
+        if (!parseTransferHeader(message, length, flags, transfer, fragment)) {
+            return;
+        }
+        if (flags & TRANSFER_FLAG_ABORT) {
+            aborts_++;
+        }
+        if (ignoreTransfers_) {
+            return;
+        }
+        if ((flags & (TRANSFER_FLAG_ACK | TRANSFER_FLAG_ABORT)) && appSender_.isActive()) {
+            appSender_.handleMessage(message, length, millis());
+            return;
+        }
+        if (flags & (TRANSFER_FLAG_ACK | TRANSFER_FLAG_ABORT)) {
+            return;
+        }
+
+        fragmentsReceived_++;
+        uint8_t reply[1 + TRANSFER_HEADER_SIZE] = {BLE_FEATURE_TRANSFER};
+        size_t replyLength = 0;
+        if (abortAfterFirst_) {
+            abortAfterFirst_ = false;
+            replyLength = buildTransferAbort(reply + 1, transfer);
+        } else {
+            TransferResult result = appReceiver_.handleMessage(message, length, reply + 1, replyLength);
+            if (result == TRANSFER_COMPLETE) {
+                downloaded_.assign(appReceiver_.getData(), appReceiver_.getData() + appReceiver_.getLength());
+                downloadDone_ = true;
+            }
+        }
+        if (replyLength > 0) {
+            appWrite(std::vector<uint8_t>(reply, reply + 1 + replyLength), true);
+        }
+    }
+
+    void appStatus(const std::vector<uint8_t>& data) {
+        // The configuration, whole once read
+        if (!data.empty() && data[0] == '{' && waitingLegacy_) {
+            legacyJson_ = data;
+        }
+    }
+
+    void runUntil(uint64_t untilUs) {
+        for (uint64_t nowUs = HostTime::micros(); nowUs < untilUs; nowUs += TRANSFER_STEP_US) {
+            HostTime::setMicros(nowUs);
+            while (!events_.empty() && events_.begin()->first <= nowUs) {
+                Event event = events_.begin()->second;
+                events_.erase(events_.begin());
+                if (!event.toApp) {
+                    waitingLegacy_ |= event.data[0] == BLE_FEATURE_GET_CONFIGURATION;
+                    writeFeature(event.data);
+                } else if (!event.data.empty() && event.data[0] == TRANSFER_MAGIC) {
+                    appTransfer(event.data.data(), event.data.size());
+                } else {
+                    appStatus(event.data);
+                }
+            }
+
+            // Uploads go as fast as the window lets them
+            uint8_t message[1 + TRANSFER_MAX_MESSAGE] = {BLE_FEATURE_TRANSFER};
+            size_t length;
+            while (appSender_.isActive() &&
+                   (length = appSender_.nextMessage(message + 1, maxValue() - 1, millis())) > 0) {
+                appWrite(std::vector<uint8_t>(message, message + 1 + length), true);
+            }
+            result_.maxInFlight = std::max(result_.maxInFlight, appSender_.getInFlight());
+
+            device_->loop();
+            result_.maxInFlight = std::max(result_.maxInFlight, device_->getTransferSender().getInFlight());
+        }
+        HostTime::setMicros(untilUs);
+    }
+
+    TransferConfig config_;
+    LinkSetup setup_;
+    BleLink link_;
+    std::unique_ptr<BMDevice> device_;
+    std::multimap<uint64_t, Event> events_;
+    uint64_t writeReadyUs_ = 0;
+    LinkResult result_;
+
+    std::vector<uint8_t> appBuffer_;
+    BMTransferReceiver appReceiver_;
+    BMTransferSender appSender_;
+    std::vector<uint8_t> log_;
+    std::vector<uint8_t> preset_;
+    std::vector<uint8_t> received_;         // By the prop's sink
+    std::vector<uint8_t> downloaded_;
+    std::vector<uint8_t> legacyJson_;
+    bool downloadDone_ = false;
+    bool waitingLegacy_ = false;
+    bool ignoreTransfers_ = false;
+    bool abortAfterFirst_ = false;
+    uint32_t fragmentsReceived_ = 0;
+    uint32_t transferBytes_ = 0;
+    uint32_t aborts_ = 0;
+};
+
+void printUsage(const char* argv0) {
+    fprintf(stderr, "usage: %s transfer [--log bytes] [--preset bytes] [--window n] [--interval ms] [--event ms]\n",
+            argv0);
+}
+
+}
+
+int runTransfer(int argc, char** argv) {
+    TransferConfig config;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--log") config.logSize = std::min(TRANSFER_SIM_MAX_PAYLOAD, std::max(1, atoi(value)));
+        else if (arg == "--preset") config.presetSize = std::min(TRANSFER_SIM_MAX_PAYLOAD, std::max(1, atoi(value)));
+        else if (arg == "--window") config.window = std::min(TRANSFER_MAX_WINDOW, std::max(1, atoi(value)));
+        else if (arg == "--interval") config.intervalMs = std::max(7.5, atof(value));
+        else if (arg == "--event") config.eventMs = std::max(1.25, atof(value));
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    const LinkSetup setups[] = {
+        {"23/27/1M", 23, 27, 1},      {"185/27/1M", 185, 27, 1},   {"247/27/1M", 247, 27, 1},
+        {"23/251/1M", 23, 251, 1},    {"185/251/1M", 185, 251, 1}, {"247/251/1M", 247, 251, 1},
+        {"185/251/2M", 185, 251, 2},  {"247/251/2M", 247, 251, 2}, {"512/251/2M", 512, 251, 2},
+    };
+    std::vector<LinkResult> results;
+    for (const LinkSetup& setup : setups) {
+        results.push_back(TransferSim(config, setup).runLink());
+    }
+
+    printf("\n--- Bulk transfers (%.0f ms interval, %.1f ms events, window %d) ---\n", config.intervalMs,
+           config.eventMs, config.window);
+    printf("MTU/LL payload/PHY; goodput in kB/s, overhead is LL bytes on air per payload byte, less one\n");
+    printf("%-11s %13s %13s %22s %22s %8s\n", "link", "config (old)", "config", "log download",
+           "preset upload", "largest");
+    int failures = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        const LinkSetup& s = setups[i];
+        const LinkResult& r = results[i];
+        size_t maxStatus = (size_t)s.mtu - BLE_ATT_NOTIFY_HEADER >= STATUS_MIN_MESSAGE
+                               ? std::min((size_t)s.mtu - BLE_ATT_NOTIFY_HEADER, (size_t)STATUS_MAX_MESSAGE)
+                               : (size_t)STATUS_DEFAULT_MESSAGE;
+        bool fits = r.maxStatus <= maxStatus && r.maxTransfer <= (size_t)s.mtu - BLE_ATT_NOTIFY_HEADER;
+        bool intact = r.legacyConfig.ok && r.config.ok && r.log.ok && r.preset.ok;
+        // Where it fits one notification, the old way saves the request
+        bool faster = r.legacyConfig.bytes <= (size_t)s.mtu - BLE_ATT_NOTIFY_HEADER || r.config.ms <= r.legacyConfig.ms;
+        bool ok = intact && fits && faster && r.linkRequested && r.maxInFlight <= config.window;
+        failures += !ok;
+        printf("%-11s %6.0f ms %4zu %6.0f ms %4zu %6.0f ms %5.1f %3u %4.0f%% %6.0f ms %5.1f %3u %4.0f%% %3zu/%3zu%s\n",
+               s.name, r.legacyConfig.ms, r.legacyConfig.bytes, r.config.ms, r.config.bytes, r.log.ms,
+               r.log.goodput(), r.log.fragments, r.log.overhead() * 100, r.preset.ms, r.preset.goodput(),
+               r.preset.fragments, r.preset.overhead() * 100, r.maxStatus, r.maxTransfer, ok ? "" : "  FAILED");
+        if (!ok) {
+            printf("            payloads %s, notifications %s, HCI %s, %u in flight\n", intact ? "intact" : "DAMAGED",
+                   fits ? "fit" : "TOO LONG", r.linkRequested ? "sent" : "MISSING", r.maxInFlight);
+        }
+    }
+
+    // Any MTU over the default is faster, as are, for the same MTU, Data
+    // Length Extension and 2M. (Without DLE, MTUs much past 185 only split
+    // into more LL packets, and aren't faster.)
+    int slower = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        for (size_t j = 0; j < results.size(); j++) {
+            const LinkSetup& a = setups[i];
+            const LinkSetup& b = setups[j];
+            bool larger = a.mtu == 23 && b.mtu > a.mtu && a.llPayload == b.llPayload && a.phyMbps == b.phyMbps;
+            bool longer = b.mtu > 23 && a.mtu == b.mtu && b.llPayload > a.llPayload && a.phyMbps == b.phyMbps;
+            bool fasterPhy = a.llPayload == b.llPayload && a.mtu == b.mtu && b.phyMbps > a.phyMbps;
+            if ((larger || longer || fasterPhy) && results[j].log.goodput() <= results[i].log.goodput()) {
+                printf("Log goodput %s %.1f kB/s is no higher than %s %.1f kB/s\n", b.name,
+                       results[j].log.goodput(), a.name, results[i].log.goodput());
+                slower++;
+            }
+        }
+    }
+
+    const LinkSetup edge = setups[1];
+    bool timeout = TransferSim(config, edge).timesOut();
+    bool appAbort = TransferSim(config, edge).appAborts();
+    bool disconnect = TransferSim(config, edge).disconnectEnds();
+    bool unknown = TransferSim(config, edge).refusesUnknownKinds();
+    printf("On %s: unacknowledged download %s, app abort %s, disconnect %s, unknown kinds %s\n", edge.name,
+           timeout ? "aborted after the timeout" : "NOT ABORTED IN TIME", appAbort ? "stops" : "DOESN'T STOP",
+           disconnect ? "ends it" : "DOESN'T END IT", unknown ? "refused" : "NOT REFUSED");
+
+    bool ok = failures == 0 && slower == 0 && timeout && appAbort && disconnect && unknown;
+    printf("%s: %d of %zu links failed, %d goodput inversions, %.1f -> %.1f kB/s log goodput from %s to %s "
+           "(target: every link within its limits, goodput up with MTU and PHY, every edge case handled)\n",
+           ok ? "PASS" : "FAIL", failures, results.size(), slower, results.front().log.goodput(),
+           results[7].log.goodput(), setups[0].name, setups[7].name);
+    return ok ? 0 : 1;
+}
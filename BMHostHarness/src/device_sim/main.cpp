@@ -0,0 +1,71 @@
+// Host simulations of a single BMDevice prop and the app talking to it.
+//
+// Usage:
+//   device_sim <scenario> [options]
+//
+// Scenarios:
+//   status      status notifications, JSON chunks vs the binary protocol:
+//               time to full state on connect, bytes on air (Status.cpp)
+//   state       change tracking in BMDeviceState: what each setter marks,
+//               status pushed on change and silence when idle (State.cpp)
+//   batch       a preset restored with one batch write instead of one write
+//               per setting: latency and light show rebuilds (Batch.cpp)
+//   features    the feature registry: collisions, length checks, counters
+//               and the capability list (Features.cpp)
+//   defaults    write-behind defaults: NVS writes per interaction, commits
+//               cut short by power loss (Defaults.cpp)
+//   records     versioned settings records: migrations both ways, damaged
+//               records, NVS lookups at boot (Records.cpp)
+//   heap        heap allocations on the status and control paths, heap
+//               fields in status, the JSON pool (Heap.cpp)
+//   preview     the live pixel preview: bytes per frame, fidelity, frame
+//               rate as the link allows, renders unaffected (Preview.cpp)
+//   transfer    bulk transfers on negotiated links: goodput by MTU, Data
+//               Length Extension and PHY, window, aborts (Transfer.cpp)
+//   boot        staged boot: first frame before Bluetooth and GPS, stage
+//               order, the scene restored after a reset (Boot.cpp)
+//
+// Each scenario documents its own options and exits non-zero when its
+// target is missed.
+
+#include <Arduino.h>
+#include "Scenarios.h"
+
+#include <cstdio>
+#include <cstring>
+
+int main(int argc, char** argv) {
+    Serial.setEnabled(false);
+    if (argc >= 2 && strcmp(argv[1], "status") == 0) {
+        return runStatus(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "state") == 0) {
+        return runState(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "batch") == 0) {
+        return runBatch(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "features") == 0) {
+        return runFeatures(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "defaults") == 0) {
+        return runDefaults(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "records") == 0) {
+        return runRecords(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "heap") == 0) {
+        return runHeap(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "preview") == 0) {
+        return runPreview(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "transfer") == 0) {
+        return runTransfer(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "boot") == 0) {
+        return runBoot(argc, argv);
+    }
+    fprintf(stderr, "usage: %s <status|state|batch|features|defaults|records|heap|preview|transfer|boot> [options]\n", argv[0]);
+    return 2;
+}
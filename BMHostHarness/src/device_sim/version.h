@@ -0,0 +1,7 @@
+#ifndef VERSION_H
+#define VERSION_H
+// Sketches generate this; host builds report a fixed version
+#ifndef FIRMWARE_VERSION
+#define FIRMWARE_VERSION "host"
+#endif
+#endif
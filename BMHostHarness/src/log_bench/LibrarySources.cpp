@@ -0,0 +1,3 @@
+// Library sources under test, compiled directly so this environment does not
+// pull in the rest of BurningManLEDs.
+#include "../../../libraries/BurningManLEDs/src/BMLog.cpp"
@@ -0,0 +1,331 @@
+// Host benchmark and checks for BMLog, the asynchronous ring-buffer logger.
+//
+// Measures what one log call costs the caller: a message compiled out by its
+// level, one queued for the print task, and the same line formatted and
+// printed on the spot as Serial.printf() did. Printing itself is timed
+// separately with a sink that discards the line; on a prop that is where the
+// UART's 115200 baud (86.8us per byte) is paid, on the print task.
+//
+// Checks:
+//   - format: lines printed from the ring match snprintf() for the formats
+//     the libraries use (widths, precision, %lu/%zu/%lld, %s, %c, %p, %%),
+//   - threads: --threads producers write --calls messages between them while
+//     a consumer drains; every message is printed or counted as dropped, each
+//     producer's messages come out in order and intact,
+//   - drops: a full ring drops messages, counts them and reports the count,
+//   - truncation: arguments that don't fit a slot are cut, not overrun.
+//
+// Usage:
+//   log_bench [options]
+//     --calls <n>          messages per measurement (default 1000000)
+//     --threads <n>        producers in the threads check (default 4)
+//
+// Exits non-zero if any check fails.
+
+#include <Arduino.h>
+#include <BMLog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define BENCH_TAG "Bench"
+#define UART_BAUD 115200
+
+typedef std::chrono::steady_clock HostClock;
+
+struct Config {
+    long calls = 1000000;
+    int threads = 4;
+};
+
+struct Check {
+    std::string name;
+    bool ok;
+    std::string detail;
+};
+
+static std::vector<std::string> captured;
+static size_t sinkBytes = 0;
+
+static void captureSink(const char* line, size_t len) { captured.push_back(std::string(line, len)); }
+static void countSink(const char*, size_t len) { sinkBytes += len; }
+
+static double nsSince(HostClock::time_point start, long calls) {
+    return std::chrono::duration<double, std::nano>(HostClock::now() - start).count() / calls;
+}
+
+static void drainAll() {
+    while (BMLog::drain() > 0) {
+    }
+}
+
+// Each case printed through the ring and with snprintf; the macro keeps the
+// format a literal as BMLOG_* requires
+#define FORMAT_CASE(format, ...)                                             \
+    do {                                                                     \
+        char expected[BMLOG_LINE];                                           \
+        snprintf(expected, sizeof(expected), "[" BENCH_TAG "] " format "\n", ##__VA_ARGS__); \
+        captured.clear();                                                    \
+        BMLOG_INFO(BENCH_TAG, format, ##__VA_ARGS__);                        \
+        BMLog::drain();                                                      \
+        total++;                                                             \
+        if (captured.size() == 1 && captured[0] == expected) {               \
+            matched++;                                                       \
+        } else if (mismatch.empty()) {                                       \
+            mismatch = std::string(expected, strlen(expected) - 1) + " != " + \
+                       (captured.empty() ? "nothing" : captured[0].substr(0, captured[0].size() - 1)); \
+        }                                                                    \
+    } while (0)
+
+static Check checkFormat() {
+    int total = 0;
+    int matched = 0;
+    std::string mismatch;
+    int value = -42;
+    unsigned long count = 4000000000UL;
+    size_t size = 512;
+    long long big = -9000000000LL;
+    const char* name = "umbrella";
+    std::string owner = "Cody";
+    uint8_t mac[6] = {0x24, 0x6F, 0x28, 0xAB, 0xCD, 0xEF};
+
+    BMLog::setSink(captureSink);
+    FORMAT_CASE("Plain text");
+    FORMAT_CASE("Brightness set to %d", value);
+    FORMAT_CASE("%u chunks, %lu bytes, %zu free", 7u, count, size);
+    FORMAT_CASE("Offset %lld us, %llu total", big, 18000000000ULL);
+    FORMAT_CASE("GPS fix: %.6f, %.6f (speed: %.2f km/h)", 40.786958, -119.202994, 12.5f);
+    FORMAT_CASE("Unknown feature 0x%02X, flags %#x, %o", 0x4B, 255, 8);
+    FORMAT_CASE("%-10s|%10s|%.3s", name, owner.c_str(), name);
+    FORMAT_CASE("MAC %02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    FORMAT_CASE("Mode %c, %5d%%, %+d", 'B', 75, 3);
+    FORMAT_CASE("Width %*d, precision %.*f", 6, 42, 3, 3.14159);
+    FORMAT_CASE("%e %g %G", 123456.789, 0.0001, 1e20);
+    FORMAT_CASE("Handler at %p", (void*)&matched);
+    FORMAT_CASE("Enabled %d, on %s", true, true ? "yes" : "no");
+    FORMAT_CASE("%s", "");
+    BMLog::setSink(nullptr);
+
+    char detail[200];
+    snprintf(detail, sizeof(detail), "%d of %d formats match snprintf%s%s", matched, total,
+             mismatch.empty() ? "" : ": ", mismatch.substr(0, 120).c_str());
+    return {"Format", matched == total, detail};
+}
+
+// Producers tag each message with their id and a counter; the consumer
+// checks both come back whole and in order
+static std::vector<std::vector<uint32_t>> received;
+static std::atomic<long> malformed(0);
+
+static void parseSink(const char* line, size_t) {
+    int producer;
+    unsigned counter;
+    char check[16];
+    if (strncmp(line, "[BMLog] ", 8) == 0) {
+        return;
+    }
+    if (sscanf(line, "[" BENCH_TAG "] producer %d message %u check %15s", &producer, &counter, check) != 3 ||
+        producer < 0 || producer >= (int)received.size() || strcmp(check, "ok") != 0) {
+        malformed++;
+        return;
+    }
+    received[producer].push_back(counter);
+}
+
+static Check checkThreads(const Config& config) {
+    received.assign(config.threads, std::vector<uint32_t>());
+    malformed = 0;
+    drainAll();
+    BMLog::resetStats();
+    BMLog::setSink(parseSink);
+
+    long perThread = std::max(1L, config.calls / config.threads);
+    std::atomic<int> running(config.threads);
+    std::thread consumer([&running]() {
+        while (running.load() > 0) {
+            if (BMLog::drain() == 0) {
+                std::this_thread::yield();
+            }
+        }
+        drainAll();
+    });
+    std::vector<std::thread> producers;
+    for (int t = 0; t < config.threads; t++) {
+        producers.emplace_back([t, perThread, &running]() {
+            for (long i = 0; i < perThread; i++) {
+                BMLOG_INFO(BENCH_TAG, "producer %d message %u check %s", t, (unsigned)i, "ok");
+                // Bursts about the ring's size, as a busy loop() would write
+                if (i % BMLOG_SLOTS == BMLOG_SLOTS - 1) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+            }
+            running--;
+        });
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    consumer.join();
+    BMLog::setSink(nullptr);
+
+    BMLogStats stats = BMLog::getStats();
+    long printed = 0;
+    long outOfOrder = 0;
+    for (const std::vector<uint32_t>& counters : received) {
+        printed += counters.size();
+        for (size_t i = 1; i < counters.size(); i++) {
+            outOfOrder += counters[i] <= counters[i - 1];
+        }
+    }
+    long attempted = perThread * config.threads;
+    bool accounted = stats.written + stats.dropped == (uint32_t)attempted && (long)stats.written == printed;
+    char detail[200];
+    snprintf(detail, sizeof(detail), "%d threads, %ld messages: %ld printed, %u dropped, %ld out of order, %ld malformed",
+             config.threads, attempted, printed, stats.dropped, outOfOrder, malformed.load());
+    return {"Threads", accounted && outOfOrder == 0 && malformed == 0 && printed > 0, detail};
+}
+
+static Check checkDrops() {
+    drainAll();
+    BMLog::resetStats();
+    for (int i = 0; i < BMLOG_SLOTS + 10; i++) {
+        BMLOG_INFO(BENCH_TAG, "filler %d", i);
+    }
+    BMLogStats stats = BMLog::getStats();
+    BMLog::setSink(captureSink);
+    captured.clear();
+    drainAll();
+    BMLog::setSink(nullptr);
+    bool reported = false;
+    for (const std::string& line : captured) {
+        reported |= line == "[BMLog] 10 messages dropped\n";
+    }
+    char detail[160];
+    snprintf(detail, sizeof(detail), "%d messages into %d slots: %u queued, %u dropped, %s", BMLOG_SLOTS + 10,
+             BMLOG_SLOTS, stats.written, stats.dropped, reported ? "reported" : "not reported");
+    return {"Drops", stats.written == BMLOG_SLOTS && stats.dropped == 10 && reported, detail};
+}
+
+static Check checkTruncation() {
+    drainAll();
+    BMLog::resetStats();
+    std::string longText(400, 'x');
+    BMLog::setSink(captureSink);
+    captured.clear();
+    BMLOG_INFO(BENCH_TAG, "status %s, then %d", longText.c_str(), 7);
+    BMLog::drain();
+    BMLog::setSink(nullptr);
+    BMLogStats stats = BMLog::getStats();
+    bool cut = captured.size() == 1 && captured[0].size() < BMLOG_SLOT_SIZE + 40 &&
+               captured[0].rfind("[" BENCH_TAG "] status xxx", 0) == 0 && captured[0].back() == '\n';
+    char detail[160];
+    snprintf(detail, sizeof(detail), "400-character argument printed as a %zu-byte line, %u truncated",
+             captured.empty() ? (size_t)0 : captured[0].size(), stats.truncated);
+    return {"Truncation", cut && stats.truncated == 1, detail};
+}
+
+struct Costs {
+    double strippedNs;
+    double queuedNs;
+    double drainNs;
+    double syncNs;
+    double lineBytes;
+};
+
+// A chunk log from BMDevice's status path, at each cost
+static Costs measure(long calls) {
+    Costs costs;
+    int chunk = 3;
+    int chunks = 5;
+    const char* json = "{\"power\":true,\"brightness\":75}";
+
+    drainAll();
+    auto start = HostClock::now();
+    for (long i = 0; i < calls; i++) {
+        BMLOG_DEBUG(BENCH_TAG, "Sending chunk %d/%d: %s", chunk, chunks, json);
+    }
+    costs.strippedNs = nsSince(start, calls);
+
+    // Queued in batches that fit the ring, drained outside the timed part
+    BMLog::setSink(countSink);
+    sinkBytes = 0;
+    double queued = 0;
+    double drained = 0;
+    for (long done = 0; done < calls; done += BMLOG_SLOTS) {
+        long batch = std::min<long>(BMLOG_SLOTS, calls - done);
+        start = HostClock::now();
+        for (long i = 0; i < batch; i++) {
+            BMLOG_INFO(BENCH_TAG, "Sending chunk %d/%d: %s", chunk, chunks, json);
+        }
+        queued += std::chrono::duration<double, std::nano>(HostClock::now() - start).count();
+        start = HostClock::now();
+        drainAll();
+        drained += std::chrono::duration<double, std::nano>(HostClock::now() - start).count();
+    }
+    costs.queuedNs = queued / calls;
+    costs.drainNs = drained / calls;
+    costs.lineBytes = (double)sinkBytes / calls;
+
+    // What Serial.printf() did on the caller, less the UART
+    sinkBytes = 0;
+    start = HostClock::now();
+    for (long i = 0; i < calls; i++) {
+        char line[BMLOG_LINE];
+        int len = snprintf(line, sizeof(line), "[" BENCH_TAG "] Sending chunk %d/%d: %s\n", chunk, chunks, json);
+        countSink(line, len);
+    }
+    costs.syncNs = nsSince(start, calls);
+    BMLog::setSink(nullptr);
+    return costs;
+}
+
+static void printUsage(const char* argv0) { fprintf(stderr, "usage: %s [--calls n] [--threads n]\n", argv0); }
+
+int main(int argc, char** argv) {
+    Serial.setEnabled(false);
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--calls") config.calls = std::max(1000L, atol(value));
+        else if (arg == "--threads") config.threads = std::max(1, atoi(value));
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    printf("\n--- BMLog: %d slots of %d bytes, level %d ---\n", BMLOG_SLOTS, BMLOG_SLOT_SIZE, BMLOG_LEVEL);
+    std::vector<Check> checks;
+    checks.push_back(checkFormat());
+    checks.push_back(checkThreads(config));
+    checks.push_back(checkDrops());
+    checks.push_back(checkTruncation());
+    int failures = 0;
+    for (const Check& c : checks) {
+        printf("%-16s %s: %s\n", (c.name + ":").c_str(), c.ok ? "ok" : "FAILED", c.detail.c_str());
+        failures += !c.ok;
+    }
+
+    Costs costs = measure(config.calls);
+    double uartUs = costs.lineBytes * 10 * 1e6 / UART_BAUD;
+    printf("\nPer call, on the caller (%.0f-byte line, %ld calls):\n", costs.lineBytes, config.calls);
+    printf("  compiled out:      %8.1f ns\n", costs.strippedNs);
+    printf("  queued:            %8.1f ns  (printed later by the print task: %.1f ns + UART)\n", costs.queuedNs,
+           costs.drainNs);
+    printf("  printed on the spot: %6.1f ns + %.0f us of UART at %d baud once its buffer is full\n", costs.syncNs,
+           uartUs, UART_BAUD);
+    printf("%s: %d of %zu checks failed\n", failures == 0 ? "PASS" : "FAIL", failures, checks.size());
+    return failures == 0 ? 0 : 1;
+}
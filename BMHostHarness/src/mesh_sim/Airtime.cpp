@@ -0,0 +1,45 @@
+#include "Airtime.h"
+
+#include <algorithm>
+
+static double backoffUs(const AirtimeModel& model, int cw, std::mt19937& rng) {
+    return model.difsUs + std::uniform_int_distribution<int>(0, cw)(rng) * model.slotUs;
+}
+
+Transmission transmitUnicast(const AirtimeModel& model, size_t payload, double lossProbability, std::mt19937& rng) {
+    std::uniform_real_distribution<double> chance(0, 1);
+    Transmission result;
+    int cw = model.cwMin;
+    double frame = model.frameUs(payload);
+    double ack = model.ackUs();
+
+    while (result.attempts <= model.retryLimit) {
+        result.attempts++;
+        result.elapsedUs += backoffUs(model, cw, rng) + frame;
+        result.airUs += frame;
+        if (chance(rng) >= lossProbability) {
+            // Receiver got it and ACKs after SIFS; the ACK can be lost too
+            result.received = true;
+            result.elapsedUs += model.sifsUs + ack;
+            result.airUs += ack;
+            if (chance(rng) >= lossProbability) {
+                result.acked = true;
+                return result;
+            }
+        } else {
+            // ACK timeout
+            result.elapsedUs += model.sifsUs + ack;
+        }
+        cw = std::min(cw * 2 + 1, model.cwMax);
+    }
+    return result;
+}
+
+Transmission transmitBroadcast(const AirtimeModel& model, size_t payload, std::mt19937& rng) {
+    Transmission result;
+    double frame = model.frameUs(payload);
+    result.attempts = 1;
+    result.elapsedUs = backoffUs(model, model.cwMin, rng) + frame;
+    result.airUs = frame;
+    return result;
+}
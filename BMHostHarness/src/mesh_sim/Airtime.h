@@ -0,0 +1,42 @@
+#ifndef MESH_SIM_AIRTIME_H
+#define MESH_SIM_AIRTIME_H
+
+#include <cstddef>
+#include <random>
+
+// 802.11 DCF timing for ESP-NOW action frames. ESP-NOW sends at 1 Mbps with
+// a long preamble by default; every unicast frame waits for an ACK and is
+// retried with a doubling contention window, broadcasts are sent once.
+struct AirtimeModel {
+    double rateMbps = 1.0;
+    double preambleUs = 192;   // Long PLCP preamble + header
+    int overheadBytes = 43;    // MAC header, action/vendor headers, FCS
+    int ackBytes = 14;
+    double sifsUs = 10;
+    double difsUs = 50;
+    double slotUs = 20;
+    int cwMin = 15;
+    int cwMax = 1023;
+    int retryLimit = 7;
+
+    double frameUs(size_t payload) const { return preambleUs + (overheadBytes + payload) * 8.0 / rateMbps; }
+    double ackUs() const { return preambleUs + ackBytes * 8.0 / rateMbps; }
+};
+
+struct Transmission {
+    double elapsedUs = 0;  // From queueing to the end of the last attempt
+    double airUs = 0;      // Time the channel was actually occupied
+    int attempts = 0;
+    bool received = false;  // At least one copy reached the receiver
+    bool acked = false;     // The sender saw an ACK
+};
+
+// One unicast frame, including retries. lossProbability applies to the data
+// frame and to its ACK independently.
+Transmission transmitUnicast(const AirtimeModel& model, size_t payload, double lossProbability, std::mt19937& rng);
+
+// One broadcast frame: a single attempt, no ACK. Whether each receiver got
+// it is decided by the caller.
+Transmission transmitBroadcast(const AirtimeModel& model, size_t payload, std::mt19937& rng);
+
+#endif // MESH_SIM_AIRTIME_H
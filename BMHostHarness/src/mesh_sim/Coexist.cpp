@@ -0,0 +1,371 @@
+// Coexist scenario: ESP-NOW sync sharing one 2.4 GHz radio with BLE.
+//
+// Every prop sends scene-sized unicasts to random others and a broadcast
+// heartbeat four times a second, while its BLE side advertises (a ~2.5 ms
+// event every 100 ms + random) or, once a phone is connected, holds a
+// connection event every 30 ms and pushes a status notification burst every
+// second. A frame is lost when the sender's or the receiver's radio is busy
+// with BLE as it goes out, and otherwise at the base loss rate.
+//
+// Each run goes first without, then with RadioSchedule: frames wait for the
+// ESP-NOW slot, advertising and notifications only happen in the BLE slot,
+// and the share adapts to the unicasts' results. Each prop's clock is off the
+// group's by up to --skew, as synced clocks are. The first half of a run has
+// no phones; in the second, --phones props are connected.
+//
+// Reported per half: ESP-NOW delivery, how long frames waited for their slot,
+// advertising events per second of props without a phone, how late status
+// notifications went out, and where the shares ended up.
+//
+// Usage:
+//   mesh_sim coexist [options]
+//     --props <n>          props in range of each other (default 6)
+//     --phones <n>         props with a phone connected in the second half (default 2)
+//     --rate <n>           unicasts per second per prop (default 20)
+//     --seconds <s>        simulated duration (default 60)
+//     --skew <us>          largest clock error against the group (default 1000)
+//     --loss <pct>         base per-copy loss (default 1)
+//     --seed <n>           random seed
+//
+// Exits non-zero unless the schedule at least halves the ESP-NOW loss, the
+// 99th percentile wait stays within one period, nothing is dropped from the
+// queue, and props without a phone still advertise at least 5 times a second.
+
+#include <Arduino.h>
+#include <RadioSchedule.h>
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#define COEXIST_STEP_US 250ULL
+#define COEXIST_ADV_EVENT_US 2500ULL        // Three advertising channels and a scan response
+#define COEXIST_ADV_INTERVAL_US 100000ULL   // Plus 0-10 ms advDelay
+#define COEXIST_CONN_EVENT_US 1250ULL
+#define COEXIST_CONN_INTERVAL_US 30000ULL
+#define COEXIST_NOTIFY_PERIOD_US 1000000ULL // One status update a second...
+#define COEXIST_NOTIFY_CHUNKS 4             // ...in this many notifications
+#define COEXIST_NOTIFY_EVENT_US 2500ULL
+#define COEXIST_NOTIFY_SPACING_US 10000ULL
+#define COEXIST_HEARTBEAT_US 250000ULL
+#define COEXIST_PAYLOAD_SIZE 24
+#define COEXIST_LOSS_RATIO 0.5              // Scheduled loss at most this share of unscheduled
+#define COEXIST_MIN_ADVERTISING 5.0         // Events per second
+
+namespace {
+
+struct CoexistConfig {
+    int props = 6;
+    int phones = 2;
+    double rate = 20;
+    double seconds = 60;
+    double skewUs = 1000;
+    double lossPercent = 1;
+    unsigned seed = 1;
+};
+
+struct CoexistProp {
+    uint8_t mac[6];
+    int64_t offsetUs;           // Clock error against the group
+    bool advertising = true;
+    bool connected = false;
+    uint64_t busyUntil = 0;     // BLE holds the radio until then
+    uint64_t nextAdvUs = 0;
+    uint64_t nextConnUs = 0;
+    uint64_t nextNotifyUs = 0;
+    uint64_t nextChunkUs = 0;
+    uint64_t notifyDueUs = 0;
+    int chunksLeft = 0;
+    uint64_t nextHeartbeatUs = 0;
+    RadioSchedule schedule;
+
+    bool busy(uint64_t t) const { return t < busyUntil; }
+};
+
+// One half of a run
+struct HalfResult {
+    unsigned long copies = 0;
+    unsigned long delivered = 0;
+    unsigned long unicasts = 0;
+    unsigned long unicastsDelivered = 0;
+    unsigned long advertisingEvents = 0;
+    double advertisingSeconds = 0;      // Summed over props without a phone
+    std::vector<double> waitMs;
+    std::vector<double> notifyLateMs;
+
+    double lossPercent() const { return copies ? 100.0 * (copies - delivered) / copies : 0; }
+};
+
+struct RunResult {
+    HalfResult halves[2];
+    unsigned long deferred = 0;
+    unsigned long dropped = 0;
+    unsigned long widened = 0;
+    unsigned long narrowed = 0;
+    int minShare = 100;
+    int maxShare = 0;
+};
+
+class CoexistSim {
+public:
+    CoexistSim(const CoexistConfig& config, bool scheduled) : config_(config), scheduled_(scheduled), rng_(config.seed) {
+        std::uniform_real_distribution<double> offset(-config.skewUs, config.skewUs);
+        std::uniform_int_distribution<uint64_t> phase(0, COEXIST_HEARTBEAT_US);
+
+        for (int i = 0; i < config.props; i++) {
+            props_.emplace_back(new CoexistProp());
+            CoexistProp& prop = *props_.back();
+            uint8_t mac[6] = {0x24, 0x6F, 0x28, 0x00, (uint8_t)(i >> 8), (uint8_t)i};
+            memcpy(prop.mac, mac, 6);
+            prop.offsetUs = (int64_t)offset(rng_);
+            prop.nextAdvUs = advDelay();
+            prop.nextHeartbeatUs = phase(rng_);
+            prop.schedule.setSendFunction([this, i](const uint8_t* to, const uint8_t* data, size_t len) {
+                transmit(i, to, data, len);
+                return true;
+            });
+            prop.schedule.onBleSlot([this, i](bool open) {
+                CoexistProp& prop = *props_[i];
+                prop.advertising = open;
+                if (open) prop.nextAdvUs = now_;
+            });
+        }
+    }
+
+    RunResult run() {
+        const uint64_t endUs = (uint64_t)(config_.seconds * 1e6);
+        const uint64_t halfUs = endUs / 2;
+        std::uniform_real_distribution<double> chance(0, 1);
+        std::uniform_int_distribution<int> pick(0, config_.props - 2);
+        const double unicastChance = config_.rate * COEXIST_STEP_US / 1e6;
+
+        for (uint64_t t = 0; t < endUs; t += COEXIST_STEP_US) {
+            now_ = t;
+            if (t == halfUs) {
+                half_ = 1;
+                for (int i = 0; i < std::min(config_.phones, config_.props); i++) {
+                    connect(*props_[i]);
+                }
+            }
+            HalfResult& half = result_.halves[half_];
+
+            for (int i = 0; i < config_.props; i++) {
+                CoexistProp& prop = *props_[i];
+                if (scheduled_) {
+                    prop.schedule.update((uint64_t)((int64_t)t + prop.offsetUs + 1000000000LL));
+                }
+                bleStep(prop, half);
+
+                if (chance(rng_) < unicastChance) {
+                    int to = pick(rng_);
+                    if (to >= i) to++;
+                    submit(i, props_[to]->mac);
+                }
+                if (t >= prop.nextHeartbeatUs) {
+                    prop.nextHeartbeatUs += COEXIST_HEARTBEAT_US;
+                    static const uint8_t BROADCAST[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+                    submit(i, BROADCAST);
+                }
+                int share = prop.schedule.getShare();
+                if (scheduled_ && t > COEXIST_NOTIFY_PERIOD_US) {
+                    result_.minShare = std::min(result_.minShare, share);
+                    result_.maxShare = std::max(result_.maxShare, share);
+                }
+            }
+        }
+
+        for (const auto& prop : props_) {
+            const RadioScheduleStats& stats = prop->schedule.getStats();
+            result_.deferred += stats.deferred;
+            result_.dropped += stats.dropped;
+            result_.widened += stats.widened;
+            result_.narrowed += stats.narrowed;
+        }
+        return result_;
+    }
+
+private:
+    uint64_t advDelay() {
+        std::uniform_int_distribution<uint64_t> delay(0, 10000);
+        return delay(rng_);
+    }
+
+    void connect(CoexistProp& prop) {
+        prop.connected = true;
+        prop.advertising = false;
+        prop.nextConnUs = now_;
+        prop.nextNotifyUs = now_;
+    }
+
+    void bleStep(CoexistProp& prop, HalfResult& half) {
+        uint64_t t = now_;
+        if (!prop.connected) {
+            half.advertisingSeconds += COEXIST_STEP_US / 1e6;
+            // Without the schedule the sketch advertises all the time
+            if ((prop.advertising || !scheduled_) && t >= prop.nextAdvUs && !prop.busy(t)) {
+                prop.busyUntil = t + COEXIST_ADV_EVENT_US;
+                prop.nextAdvUs = t + COEXIST_ADV_INTERVAL_US + advDelay();
+                half.advertisingEvents++;
+            }
+            return;
+        }
+
+        // Connection events belong to the BLE controller, scheduled or not
+        if (t >= prop.nextConnUs) {
+            prop.busyUntil = std::max<uint64_t>(prop.busyUntil, t + COEXIST_CONN_EVENT_US);
+            prop.nextConnUs += COEXIST_CONN_INTERVAL_US;
+        }
+        if (t >= prop.nextNotifyUs) {
+            prop.chunksLeft = COEXIST_NOTIFY_CHUNKS;
+            prop.notifyDueUs = t;
+            prop.nextNotifyUs += COEXIST_NOTIFY_PERIOD_US;
+        }
+        if (prop.chunksLeft > 0 && t >= prop.nextChunkUs && (!scheduled_ || prop.schedule.isBleSlot())) {
+            prop.busyUntil = std::max<uint64_t>(prop.busyUntil, t + COEXIST_NOTIFY_EVENT_US);
+            prop.nextChunkUs = t + COEXIST_NOTIFY_SPACING_US;
+            if (--prop.chunksLeft == 0) {
+                half.notifyLateMs.push_back((t - prop.notifyDueUs) / 1000.0);
+            }
+        }
+    }
+
+    void submit(int from, const uint8_t* to) {
+        uint8_t data[COEXIST_PAYLOAD_SIZE] = {};
+        memcpy(data, &now_, sizeof(now_));
+        if (scheduled_) {
+            props_[from]->schedule.send(to, data, sizeof(data));
+        } else {
+            transmit(from, to, data, sizeof(data));
+        }
+    }
+
+    void transmit(int from, const uint8_t* to, const uint8_t* data, size_t len) {
+        (void)len;
+        HalfResult& half = result_.halves[half_];
+        uint64_t submittedUs;
+        memcpy(&submittedUs, data, sizeof(submittedUs));
+        half.waitMs.push_back((now_ - submittedUs) / 1000.0);
+
+        std::uniform_real_distribution<double> chance(0, 100);
+        bool broadcast = to[0] == 0xFF;
+        const CoexistProp& sender = *props_[from];
+        for (int i = 0; i < config_.props; i++) {
+            const CoexistProp& receiver = *props_[i];
+            if (i == from || (!broadcast && memcmp(receiver.mac, to, 6) != 0)) continue;
+            bool delivered = !sender.busy(now_) && !receiver.busy(now_) && chance(rng_) >= config_.lossPercent;
+            half.copies++;
+            half.delivered += delivered;
+            if (!broadcast) {
+                half.unicasts++;
+                half.unicastsDelivered += delivered;
+                props_[from]->schedule.recordResult(delivered);
+            }
+        }
+    }
+
+    const CoexistConfig& config_;
+    bool scheduled_;
+    std::mt19937 rng_;
+    std::vector<std::unique_ptr<CoexistProp>> props_;
+    RunResult result_;
+    uint64_t now_ = 0;
+    int half_ = 0;
+};
+
+double advertisingRate(const HalfResult& half) {
+    return half.advertisingSeconds > 0 ? half.advertisingEvents / half.advertisingSeconds : 0;
+}
+
+void printHalf(const char* name, const HalfResult& without, const HalfResult& with) {
+    printf("%s\n", name);
+    printf("  ESP-NOW loss:          %5.1f%% -> %5.1f%% (unicasts %.1f%% -> %.1f%% delivered)\n",
+           without.lossPercent(), with.lossPercent(),
+           without.unicasts ? 100.0 * without.unicastsDelivered / without.unicasts : 0,
+           with.unicasts ? 100.0 * with.unicastsDelivered / with.unicasts : 0);
+    printf("  Wait for the slot:     p50 %.1f ms, p99 %.1f ms, max %.1f ms\n", percentile(with.waitMs, 0.5),
+           percentile(with.waitMs, 0.99), percentile(with.waitMs, 1.0));
+    if (without.advertisingSeconds > 0) {
+        printf("  Advertising:           %.1f -> %.1f events/s per prop without a phone\n",
+               advertisingRate(without), advertisingRate(with));
+    }
+    if (!with.notifyLateMs.empty()) {
+        printf("  Status notifications:  done after p50 %.0f -> %.0f ms, p99 %.0f -> %.0f ms\n",
+               percentile(without.notifyLateMs, 0.5), percentile(with.notifyLateMs, 0.5),
+               percentile(without.notifyLateMs, 0.99), percentile(with.notifyLateMs, 0.99));
+    }
+}
+
+int report(const CoexistConfig& config, const RunResult& without, const RunResult& with) {
+    printf("\n--- Radio coexistence (%d props, %d with a phone later, %.0f s simulated) ---\n", config.props,
+           config.phones, config.seconds);
+    printf("Traffic:                 %.0f unicasts/s + %.0f heartbeats/s per prop, %.1f%% base loss\n",
+           config.rate, 1e6 / COEXIST_HEARTBEAT_US, config.lossPercent);
+    printf("Schedule:                %d ms period, share %d%% to start (%d-%d%%), clocks within %.0f us\n",
+           RADIO_SCHEDULE_PERIOD_MS, RADIO_SCHEDULE_DEFAULT_SHARE, RADIO_SCHEDULE_MIN_SHARE,
+           RADIO_SCHEDULE_MAX_SHARE, config.skewUs);
+    printf("Unscheduled -> scheduled:\n");
+    printHalf("Advertising only:", without.halves[0], with.halves[0]);
+    printHalf("With phones connected:", without.halves[1], with.halves[1]);
+    printf("Queue:                   %lu frames deferred, %lu dropped\n", with.deferred, with.dropped);
+    printf("Shares:                  %d-%d%% after the first second; %lu widened, %lu narrowed\n",
+           with.minShare, with.maxShare, with.widened, with.narrowed);
+
+    unsigned long copies = without.halves[0].copies + without.halves[1].copies;
+    unsigned long lost = copies - without.halves[0].delivered - without.halves[1].delivered;
+    unsigned long scheduledCopies = with.halves[0].copies + with.halves[1].copies;
+    unsigned long scheduledLost = scheduledCopies - with.halves[0].delivered - with.halves[1].delivered;
+    double loss = copies ? 100.0 * lost / copies : 0;
+    double scheduledLoss = scheduledCopies ? 100.0 * scheduledLost / scheduledCopies : 0;
+    double worstWaitMs = std::max(percentile(with.halves[0].waitMs, 0.99), percentile(with.halves[1].waitMs, 0.99));
+    double advertising = advertisingRate(with.halves[0]);
+
+    bool ok = scheduledLoss <= loss * COEXIST_LOSS_RATIO && worstWaitMs <= RADIO_SCHEDULE_PERIOD_MS &&
+              with.dropped == 0 && advertising >= COEXIST_MIN_ADVERTISING;
+    printf("%s: %.1f%% -> %.1f%% lost, p99 wait %.1f ms, %.1f advertising events/s (target: at most %.0f%% of the "
+           "loss, p99 wait within %d ms, nothing dropped, %.0f events/s)\n",
+           ok ? "PASS" : "FAIL", loss, scheduledLoss, worstWaitMs, advertising, COEXIST_LOSS_RATIO * 100,
+           RADIO_SCHEDULE_PERIOD_MS, COEXIST_MIN_ADVERTISING);
+    return ok ? 0 : 1;
+}
+
+void printUsage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s coexist [--props n] [--phones n] [--rate n] [--seconds s] [--skew us] [--loss pct] "
+            "[--seed n]\n",
+            argv0);
+}
+
+} // namespace
+
+int runCoexist(int argc, char** argv) {
+    CoexistConfig config;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--props") config.props = std::max(2, atoi(value));
+        else if (arg == "--phones") config.phones = std::max(0, atoi(value));
+        else if (arg == "--rate") config.rate = std::max(0.0, atof(value));
+        else if (arg == "--seconds") config.seconds = std::max(2.0, atof(value));
+        else if (arg == "--skew") config.skewUs = std::max(0.0, atof(value));
+        else if (arg == "--loss") config.lossPercent = atof(value);
+        else if (arg == "--seed") config.seed = (unsigned)atoi(value);
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    RunResult without = CoexistSim(config, false).run();
+    RunResult with = CoexistSim(config, true).run();
+    return report(config, without, with);
+}
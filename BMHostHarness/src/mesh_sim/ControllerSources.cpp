@@ -0,0 +1,14 @@
+// SyncController and what it links against, for the props scenario. Kept out
+// of LibrarySources.cpp because ClockSync.cpp and PeerDiscovery.cpp both
+// define a file-scope BROADCAST_ADDRESS.
+#include "../../../libraries/BurningManLEDs/src/BMLog.cpp"
+#include "../../../libraries/BurningManLEDs/src/Clock.cpp"
+#include "../../../libraries/BurningManLEDs/src/ClockSync.cpp"
+#include "../../../libraries/BurningManLEDs/src/LightShow.cpp"
+#include "../../../libraries/BurningManLEDs/src/Position.cpp"
+#include "../../../libraries/BurningManLEDs/src/LocationService.cpp"
+#include "../../../libraries/TinyGPSPlus/src/TinyGPS++.cpp"
+#include "../../../libraries/BurningManLEDs/DeviceRoles.cpp"
+#include "../../../libraries/BurningManLEDs/src/EspNowTransport.cpp"
+#include "../../../libraries/BurningManLEDs/src/UdpMulticastTransport.cpp"
+#include "../../../libraries/BurningManLEDs/SyncController.cpp"
@@ -0,0 +1,301 @@
+// Dial scenario: a dial spun fast, synced over a lossy link by SyncChannel.
+//
+// One device (or several at once) turns its dial at a fixed detent rate,
+// changing brightness by 5 per detent the way handleDialChange() does. Every
+// device runs the real SyncChannel on its own virtual clock over a Medium
+// with loss, jitter and duplicated frames. After the last detent the harness
+// measures how long until every device shows the same scene, and counts the
+// frames it took: coalesced scene messages, retransmits and acks. The legacy
+// path (one broadcast per detent, nothing resent) is shown for comparison.
+//
+// Usage:
+//   mesh_sim dial [options]
+//     --devices <n>        devices in the group (default 5)
+//     --writers <n>        devices turning their dial at once (default 1)
+//     --rate <n>           detents per second (default 100)
+//     --spin <s>           how long the dial turns (default 2)
+//     --trials <n>         independent runs (default 20)
+//     --latency <us>       base one-way latency (default 1500)
+//     --jitter <us>        mean exponential jitter (default 1500)
+//     --loss <pct>         per-copy loss (default 20)
+//     --duplicates <pct>   copies delivered twice (default 5)
+//     --seed <n>           random seed
+//
+// Exits non-zero unless every trial converges within 1s of the last detent
+// and coalescing sends fewer scene frames than there were detents.
+
+#include <Arduino.h>
+#include <SyncChannel.h>
+#include "Medium.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#define DIAL_CONVERGENCE_TARGET_MS 1000
+#define DIAL_SETTLE_LIMIT_US 5000000ULL
+
+namespace {
+
+struct DialConfig {
+    int devices = 5;
+    int writers = 1;
+    double rate = 100;
+    double spinSeconds = 2;
+    int trials = 20;
+    MediumConfig medium;
+    unsigned seed = 1;
+
+    DialConfig() {
+        medium.lossPercent = 20;
+        medium.duplicatePercent = 5;
+    }
+};
+
+struct DialNode {
+    uint8_t mac[6];
+    double epochUs;
+    SyncChannel channel{SyncProtocol::groupId("CL")};
+    int direction = 1;
+    uint64_t nextDetentUs = 0;
+
+    uint64_t localAt(uint64_t trueUs) const { return (uint64_t)(epochUs + trueUs); }
+};
+
+struct TrialResult {
+    int detents = 0;
+    unsigned long sceneFrames = 0;
+    unsigned long retransmits = 0;
+    unsigned long ackFrames = 0;
+    unsigned long bytes = 0;
+    unsigned long stale = 0;
+    unsigned long gaveUp = 0;
+    double convergedMs = -1;
+    int legacyStale = 0;     // Receivers that would have missed the final value
+};
+
+class DialTrial {
+public:
+    DialTrial(const DialConfig& config, unsigned seed)
+        : config_(config), rng_(seed), medium_(config.medium, config.devices, rng_) {
+        std::uniform_real_distribution<double> epoch(0, 600e6);
+        std::uniform_int_distribution<int> phase(0, 9999);
+
+        LightScene initial = {};
+        initial.scene_id = palette_stream;
+        initial.brightness = 25;
+        initial.speed = 50;
+
+        for (int i = 0; i < config.devices; i++) {
+            nodes_.emplace_back(new DialNode());
+            DialNode& node = *nodes_.back();
+            Medium::macFor(i, node.mac);
+            node.epochUs = epoch(rng_);
+            node.nextDetentUs = 100000 + phase(rng_);
+            node.channel.setSendFunction([this, i](const uint8_t* to, const uint8_t* data, size_t len) {
+                countFrame(data, len);
+                return medium_.send(i, to, data, len, now_);
+            });
+            enter(i, 0);
+            node.channel.begin(node.mac, initial);
+        }
+        for (auto& node : nodes_) {
+            for (auto& other : nodes_) {
+                if (other != node) node->channel.addReceiver(other->mac);
+            }
+        }
+    }
+
+    TrialResult run() {
+        const uint64_t detentUs = (uint64_t)(1e6 / config_.rate);
+        const uint64_t spinEndUs = 100000 + (uint64_t)(config_.spinSeconds * 1e6);
+        uint64_t lastDetentUs = 0;
+
+        for (uint64_t t = 0;; t += 1000) {
+            now_ = t;
+            medium_.deliverUntil(t, [this](int to, int from, const uint8_t* data, size_t len, uint64_t trueUs) {
+                enter(to, trueUs);
+                nodes_[to]->channel.handleMessage(nodes_[from]->mac, data, len);
+            });
+
+            for (int i = 0; i < config_.writers && i < (int)nodes_.size(); i++) {
+                DialNode& node = *nodes_[i];
+                if (t < spinEndUs && t >= node.nextDetentUs) {
+                    enter(i, t);
+                    turn(node);
+                    node.nextDetentUs += detentUs;
+                    lastDetentUs = t;
+                }
+            }
+
+            for (size_t i = 0; i < nodes_.size(); i++) {
+                enter(i, t);
+                nodes_[i]->channel.update();
+            }
+
+            if (t < spinEndUs) continue;
+            if (result_.convergedMs < 0 && allAgree()) {
+                result_.convergedMs = (t - lastDetentUs) / 1000.0;
+            }
+            if ((result_.convergedMs >= 0 && allSettled()) || t - lastDetentUs > DIAL_SETTLE_LIMIT_US) {
+                break;
+            }
+        }
+
+        for (auto& node : nodes_) {
+            const SyncChannelStats& stats = node->channel.getStats();
+            result_.retransmits += stats.retransmits;
+            result_.stale += stats.stale;
+            result_.gaveUp += stats.gave_up;
+        }
+
+        // Legacy: every receiver keeps whatever the last detent's broadcast said, if it arrived
+        std::uniform_real_distribution<double> chance(0, 100);
+        for (int r = 0; r < (int)nodes_.size() - 1; r++) {
+            result_.legacyStale += chance(rng_) < config_.medium.lossPercent;
+        }
+        return result_;
+    }
+
+private:
+    void enter(size_t i, uint64_t trueUs) { HostTime::setMicros(nodes_[i]->localAt(trueUs)); }
+
+    void turn(DialNode& node) {
+        // What handleDialChange() does to the prop's current scene
+        LightScene scene = node.channel.getScene();
+        int brightness = scene.brightness + node.direction * 5;
+        if (brightness > 150 || brightness < 0) {
+            node.direction = -node.direction;
+            brightness = scene.brightness + node.direction * 5;
+        }
+        scene.brightness = (uint8_t)brightness;
+        node.channel.submit(scene);
+        result_.detents++;
+    }
+
+    void countFrame(const uint8_t* data, size_t len) {
+        result_.bytes += len;
+        if (len > 2 && data[2] == SYNC_MESSAGE_ACK) {
+            result_.ackFrames++;
+        } else {
+            result_.sceneFrames++;
+        }
+    }
+
+    bool allAgree() const {
+        const LightScene& first = nodes_[0]->channel.getScene();
+        for (const auto& node : nodes_) {
+            if (SyncProtocol::diffScene(first, node->channel.getScene()) != 0) return false;
+        }
+        return true;
+    }
+
+    bool allSettled() const {
+        for (const auto& node : nodes_) {
+            if (!node->channel.isSettled()) return false;
+        }
+        return true;
+    }
+
+    const DialConfig& config_;
+    std::mt19937 rng_;
+    Medium medium_;
+    std::vector<std::unique_ptr<DialNode>> nodes_;
+    uint64_t now_ = 0;
+    TrialResult result_;
+};
+
+void printUsage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s dial [--devices n] [--writers n] [--rate n] [--spin s] [--trials n] [--latency us] "
+            "[--jitter us] [--loss pct] [--duplicates pct] [--seed n]\n",
+            argv0);
+}
+
+} // namespace
+
+int runDial(int argc, char** argv) {
+    DialConfig config;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--devices") config.devices = std::max(2, atoi(value));
+        else if (arg == "--writers") config.writers = std::max(1, atoi(value));
+        else if (arg == "--rate") config.rate = std::max(1.0, atof(value));
+        else if (arg == "--spin") config.spinSeconds = atof(value);
+        else if (arg == "--trials") config.trials = std::max(1, atoi(value));
+        else if (arg == "--latency") config.medium.latencyUs = atof(value);
+        else if (arg == "--jitter") config.medium.jitterUs = atof(value);
+        else if (arg == "--loss") config.medium.lossPercent = atof(value);
+        else if (arg == "--duplicates") config.medium.duplicatePercent = atof(value);
+        else if (arg == "--seed") config.seed = (unsigned)atoi(value);
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    config.writers = std::min(config.writers, config.devices);
+
+    std::vector<TrialResult> results;
+    for (int trial = 0; trial < config.trials; trial++) {
+        DialTrial sim(config, config.seed * 7919 + trial);
+        results.push_back(sim.run());
+    }
+
+    double detents = 0, scenes = 0, retransmits = 0, acks = 0, bytes = 0, stale = 0, legacyStale = 0;
+    unsigned long gaveUp = 0;
+    std::vector<double> convergence;
+    int converged = 0;
+    for (const TrialResult& r : results) {
+        detents += r.detents;
+        scenes += r.sceneFrames;
+        retransmits += r.retransmits;
+        acks += r.ackFrames;
+        bytes += r.bytes;
+        stale += r.stale;
+        legacyStale += r.legacyStale;
+        gaveUp += r.gaveUp;
+        if (r.convergedMs >= 0) {
+            converged++;
+            convergence.push_back(r.convergedMs);
+        }
+    }
+    double n = results.size();
+    std::sort(convergence.begin(), convergence.end());
+    double mean = 0;
+    for (double c : convergence) mean += c;
+    mean /= std::max<size_t>(1, convergence.size());
+
+    printf("\n--- Dial sync (%d devices, %d writer%s, %.0f detents/s for %.1f s, %.1f%% loss, %.1f%% duplicates, "
+           "%d trials) ---\n",
+           config.devices, config.writers, config.writers == 1 ? "" : "s", config.rate, config.spinSeconds,
+           config.medium.lossPercent, config.medium.duplicatePercent, config.trials);
+    printf("Detents:                 %.0f per trial\n", detents / n);
+    printf("Frames:                  %.1f scene (%.1f of them retransmits) + %.1f acks (%.1f per receiver) per "
+           "trial, %.0f bytes\n",
+           scenes / n, retransmits / n, acks / n, acks / (n * (config.devices - 1)), bytes / n);
+    printf("Legacy:                  %.0f scene frames per trial, %.1f%% of receivers left on an old value\n",
+           detents / n, 100.0 * legacyStale / (n * (config.devices - 1)));
+    if (!convergence.empty()) {
+        printf("Convergence:             %d/%d trials, mean %.0f ms, max %.0f ms after the last detent\n", converged,
+               config.trials, mean, convergence.back());
+    } else {
+        printf("Convergence:             0/%d trials\n", config.trials);
+    }
+    printf("Ignored:                 %.1f stale or duplicate scenes per trial, %lu receivers given up on\n",
+           stale / n, gaveUp);
+
+    bool ok = converged == config.trials && convergence.back() <= DIAL_CONVERGENCE_TARGET_MS && scenes < detents;
+    printf("%s: %s (target: every trial within %d ms, fewer scene frames than detents)\n", ok ? "PASS" : "FAIL",
+           ok ? "every device converged" : "target missed", DIAL_CONVERGENCE_TARGET_MS);
+    return ok ? 0 : 1;
+}
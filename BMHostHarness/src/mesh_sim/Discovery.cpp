@@ -0,0 +1,296 @@
+// Discovery scenario: PeerDiscovery membership across a camp of props.
+//
+// Devices from several owners boot at random times over a few seconds. Each
+// runs the real PeerDiscovery on its own virtual clock (one device's millis()
+// wraps during the run) over a lossy, jittery Medium. The harness checks
+// every 10ms whether every device knows every running peer it should: its
+// whole group, plus everyone else while the camp fits in the table. Later
+// some devices are switched off, and the time until every table has dropped
+// them is measured.
+//
+// Usage:
+//   mesh_sim discovery [options]
+//     --devices <n>        devices (default 50)
+//     --groups <n>         owners they are split between (default 5)
+//     --boot-spread <ms>   devices boot within this window (default 2000)
+//     --leave <n>          devices switched off mid-run (default 5)
+//     --seconds <s>        simulated duration (default 30)
+//     --latency <us>       base one-way latency (default 1500)
+//     --jitter <us>        mean exponential jitter (default 1500)
+//     --loss <pct>         per-copy loss (default 5)
+//     --seed <n>           random seed
+//
+// Exits non-zero unless membership converges within 5s of the last boot.
+
+#include <Arduino.h>
+#include <PeerDiscovery.h>
+#include "Airtime.h"
+#include "Medium.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#define CONVERGENCE_TARGET_MS 5000
+#define CHECK_INTERVAL_US 10000ULL
+
+namespace {
+
+struct DiscoveryConfig {
+    int devices = 50;
+    int groups = 5;
+    double bootSpreadMs = 2000;
+    int leave = 5;
+    double seconds = 30;
+    MediumConfig medium;
+    unsigned seed = 1;
+};
+
+struct DiscoveryNode {
+    uint8_t mac[6];
+    uint16_t group;
+    double epochUs;     // Local time at true time zero
+    double drift;
+    uint64_t bootUs;
+    bool booted = false;
+    bool up = true;
+    PeerDiscovery discovery;
+
+    uint64_t localAt(uint64_t trueUs) const { return (uint64_t)(epochUs + trueUs * (1.0 + drift)); }
+};
+
+class DiscoverySim {
+public:
+    explicit DiscoverySim(const DiscoveryConfig& config)
+        : config_(config), rng_(config.seed), medium_(config.medium, config.devices, rng_) {
+        std::uniform_real_distribution<double> drift(-40e-6, 40e-6);
+        std::uniform_real_distribution<double> epoch(0, 600e6);
+        std::uniform_real_distribution<double> boot(0, config.bootSpreadMs * 1000);
+
+        for (int i = 0; i < config.devices; i++) {
+            nodes_.emplace_back(new DiscoveryNode());
+            DiscoveryNode& node = *nodes_.back();
+            Medium::macFor(i, node.mac);
+            node.group = (uint16_t)('A' << 8 | ('A' + i % config.groups));
+            node.epochUs = epoch(rng_);
+            node.drift = drift(rng_);
+            node.bootUs = (uint64_t)boot(rng_);
+            node.discovery.setSendFunction([this, i](const uint8_t* to, const uint8_t* data, size_t len) {
+                return medium_.send(i, to, data, len, now_);
+            });
+            node.discovery.onPeerRemoved([this](const PeerInfo& peer) {
+                // Evictions make room in a full table; only timeouts of running peers are false
+                int node = medium_.nodeFor(peer.mac);
+                bool timedOut = (int32_t)(millis() - peer.last_seen_ms) > PEER_DISCOVERY_TIMEOUT;
+                if (timedOut && node >= 0 && nodes_[node]->up) {
+                    falseRemovals_++;
+                }
+            });
+            medium_.setNodeUp(i, false);
+            lastBootUs_ = std::max(lastBootUs_, node.bootUs);
+        }
+        // millis() wraps 10s into the run on the first device
+        nodes_[0]->epochUs = (4294967296.0 - 10000.0) * 1000.0;
+    }
+
+    int run() {
+        const uint64_t endUs = (uint64_t)(config_.seconds * 1e6);
+        const uint64_t leaveUs = std::max<uint64_t>(lastBootUs_ + 10000000ULL, endUs / 2);
+        std::vector<int> leavers = pickLeavers();
+
+        double convergedUs = -1;
+        double departedUs = -1;
+
+        for (uint64_t t = 0; t <= endUs; t += 1000) {
+            now_ = t;
+            if (t == leaveUs) {
+                for (int i : leavers) {
+                    nodes_[i]->up = false;
+                    medium_.setNodeUp(i, false);
+                }
+            }
+            bootDue(t);
+            medium_.deliverUntil(t, [this](int to, int from, const uint8_t* data, size_t len, uint64_t trueUs) {
+                enter(to, trueUs);
+                nodes_[to]->discovery.handleMessage(nodes_[from]->mac, data, len);
+            });
+            for (size_t i = 0; i < nodes_.size(); i++) {
+                if (nodes_[i]->booted && nodes_[i]->up) {
+                    enter(i, t);
+                    nodes_[i]->discovery.update();
+                }
+            }
+
+            if (t % CHECK_INTERVAL_US != 0) {
+                continue;
+            }
+            if (convergedUs < 0 && t >= lastBootUs_ && t < leaveUs && allComplete()) {
+                convergedUs = (double)(t - lastBootUs_);
+            }
+            if (departedUs < 0 && t >= leaveUs && noneRemember(leavers)) {
+                departedUs = (double)(t - leaveUs);
+            }
+        }
+
+        return report(convergedUs, departedUs, leavers.size(), endUs);
+    }
+
+private:
+    void enter(size_t i, uint64_t trueUs) { HostTime::setMicros(nodes_[i]->localAt(trueUs)); }
+
+    void bootDue(uint64_t t) {
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            DiscoveryNode& node = *nodes_[i];
+            if (!node.booted && t >= node.bootUs) {
+                node.booted = true;
+                medium_.setNodeUp(i, true);
+                enter(i, t);
+                node.discovery.begin(node.group, (uint8_t)(i % 10), PEER_CAP_LEDS);
+            }
+        }
+    }
+
+    std::vector<int> pickLeavers() {
+        std::vector<int> order;
+        for (int i = 1; i < config_.devices; i++) order.push_back(i);
+        std::shuffle(order.begin(), order.end(), rng_);
+        order.resize(std::min<size_t>(order.size(), (size_t)std::max(0, config_.leave)));
+        return order;
+    }
+
+    bool shouldKnow(const DiscoveryNode& node, const DiscoveryNode& other, int running) const {
+        return other.booted && other.up && (other.group == node.group || running - 1 <= PEER_DISCOVERY_MAX_PEERS);
+    }
+
+    bool allComplete() const {
+        int running = 0;
+        for (const auto& node : nodes_) running += node->booted && node->up;
+
+        for (const auto& node : nodes_) {
+            if (!node->booted || !node->up) continue;
+            int groupRunning = 0;
+            for (const auto& other : nodes_) groupRunning += other->booted && other->up && other->group == node->group;
+            if (groupRunning - 1 > PEER_DISCOVERY_MAX_PEERS) {
+                // A group bigger than the table can only fill it
+                if (node->discovery.getPeerCount() < PEER_DISCOVERY_MAX_PEERS) return false;
+                continue;
+            }
+            for (const auto& other : nodes_) {
+                if (other != node && shouldKnow(*node, *other, running) && !node->discovery.findPeer(other->mac)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool noneRemember(const std::vector<int>& leavers) const {
+        for (const auto& node : nodes_) {
+            if (!node->up) continue;
+            for (int i : leavers) {
+                if (node->discovery.findPeer(nodes_[i]->mac)) return false;
+            }
+        }
+        return true;
+    }
+
+    int report(double convergedUs, double departedUs, size_t left, uint64_t endUs) {
+        unsigned long beacons = 0, overflows = 0, evictions = 0, tableFull = 0;
+        double knownSum = 0;
+        int running = 0;
+        for (const auto& node : nodes_) {
+            const PeerDiscoveryStats& stats = node->discovery.getStats();
+            beacons += stats.beacons_sent;
+            overflows += stats.queue_overflows;
+            evictions += stats.evictions;
+            tableFull += stats.table_full;
+            if (node->up) {
+                knownSum += node->discovery.getPeerCount();
+                running++;
+            }
+        }
+
+        AirtimeModel airtime;
+        double beaconUs = airtime.difsUs + airtime.cwMin / 2.0 * airtime.slotUs + airtime.frameUs(PEER_DISCOVERY_BEACON_SIZE);
+        double seconds = endUs / 1e6;
+
+        printf("\n--- Peer discovery ---\n");
+        printf("Devices:                 %d in %d groups, booted over %.0f ms, %.0f s simulated\n", config_.devices,
+               config_.groups, config_.bootSpreadMs, seconds);
+        printf("Link:                    %.0f us + exp(%.0f us) jitter, %.1f%% loss\n", config_.medium.latencyUs,
+               config_.medium.jitterUs, config_.medium.lossPercent);
+        if (convergedUs >= 0) {
+            printf("Convergence:             %.2f s after the last device booted\n", convergedUs / 1e6);
+        } else {
+            printf("Convergence:             not reached\n");
+        }
+        if (departedUs >= 0) {
+            printf("Departure:               %zu devices dropped from every table after %.2f s\n", left,
+                   departedUs / 1e6);
+        } else if (left) {
+            printf("Departure:               departed devices still listed at the end\n");
+        }
+        printf("Tables:                  %.1f peers known on average (max %d), %lu evictions, %lu beacons ignored "
+               "while full\n",
+               knownSum / std::max(1, running), PEER_DISCOVERY_MAX_PEERS, evictions, tableFull);
+        printf("False removals:          %lu (running peers timed out)\n", falseRemovals_);
+        printf("Beacons:                 %.1f/s camp-wide, ~%.1f%% of channel airtime, %lu queue overflows\n",
+               beacons / seconds, 100.0 * beacons * beaconUs / (seconds * 1e6), overflows);
+
+        bool ok = convergedUs >= 0 && convergedUs <= CONVERGENCE_TARGET_MS * 1000.0;
+        printf("%s: membership %s (target < %d ms)\n", ok ? "PASS" : "FAIL",
+               convergedUs >= 0 ? "converged" : "did not converge", CONVERGENCE_TARGET_MS);
+        return ok ? 0 : 1;
+    }
+
+    DiscoveryConfig config_;
+    std::mt19937 rng_;
+    Medium medium_;
+    std::vector<std::unique_ptr<DiscoveryNode>> nodes_;
+    uint64_t now_ = 0;
+    uint64_t lastBootUs_ = 0;
+    unsigned long falseRemovals_ = 0;
+};
+
+void printUsage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s discovery [--devices n] [--groups n] [--boot-spread ms] [--leave n] [--seconds s] "
+            "[--latency us] [--jitter us] [--loss pct] [--seed n]\n",
+            argv0);
+}
+
+} // namespace
+
+int runDiscovery(int argc, char** argv) {
+    DiscoveryConfig config;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--devices") config.devices = std::max(2, atoi(value));
+        else if (arg == "--groups") config.groups = std::max(1, atoi(value));
+        else if (arg == "--boot-spread") config.bootSpreadMs = atof(value);
+        else if (arg == "--leave") config.leave = atoi(value);
+        else if (arg == "--seconds") config.seconds = atof(value);
+        else if (arg == "--latency") config.medium.latencyUs = atof(value);
+        else if (arg == "--jitter") config.medium.jitterUs = atof(value);
+        else if (arg == "--loss") config.medium.lossPercent = atof(value);
+        else if (arg == "--seed") config.seed = (unsigned)atoi(value);
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    config.groups = std::min(config.groups, 26);
+
+    DiscoverySim sim(config);
+    return sim.run();
+}
@@ -0,0 +1,417 @@
+// Election scenario: LeaderElection across a camp, with props coming and going.
+//
+// Devices from several owners boot at random times. Each runs the real
+// PeerDiscovery, which feeds its group peers to the real LeaderElection as
+// candidates, on its own virtual clock over a lossy, jittery Medium. A group
+// has elected once every running member follows the same leader and only
+// that one leads. Once every group has, one group at a time sees an event,
+// cycling through: its leader switched off (failover), the old leader
+// switched back on, a follower switched off, and that follower back on.
+//
+// Reported: how long after its last member booted each group first agreed,
+// how long each failover took, and whether a prop joining or leaving ever
+// moved the leadership (it shouldn't: only losing the leader does).
+//
+// Usage:
+//   mesh_sim election [options]
+//     --devices <n>        devices (default 50)
+//     --groups <n>         owners they are split between (default 5)
+//     --boot-spread <ms>   devices boot within this window (default 2000)
+//     --interval <ms>      time between events, each in the next group (default 1000)
+//     --seconds <s>        simulated duration (default 60)
+//     --latency <us>       base one-way latency (default 1500)
+//     --jitter <us>        mean exponential jitter (default 1500)
+//     --loss <pct>         per-copy loss (default 5)
+//     --seed <n>           random seed
+//
+// Exits non-zero unless every election and failover settles within 2.5s and no
+// join or leave moves the leadership.
+
+#include <Arduino.h>
+#include <LeaderElection.h>
+#include <PeerDiscovery.h>
+#include "Airtime.h"
+#include "Medium.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#define ELECTION_TARGET_MS 2500
+#define ELECTION_CHECK_INTERVAL_US 5000ULL
+#define ELECTION_EVENTS_AFTER_US 3000000ULL // After the last boot
+
+namespace {
+
+struct ElectionConfig {
+    int devices = 50;
+    int groups = 5;
+    double bootSpreadMs = 2000;
+    double intervalMs = 1000;
+    double seconds = 60;
+    MediumConfig medium;
+    unsigned seed = 1;
+};
+
+struct ElectionNode {
+    uint8_t mac[6];
+    uint16_t group;
+    double epochUs;     // Local time at true time zero
+    double drift;
+    uint64_t bootUs;
+    bool booted = false;
+    bool up = true;
+    // Recreated on every boot, the way a power cycle starts from scratch
+    std::unique_ptr<PeerDiscovery> discovery;
+    std::unique_ptr<LeaderElection> election;
+
+    uint64_t localAt(uint64_t trueUs) const { return (uint64_t)(epochUs + trueUs * (1.0 + drift)); }
+    bool running() const { return booted && up; }
+};
+
+enum EventKind { EVENT_LEADER_OFF, EVENT_LEADER_BACK, EVENT_FOLLOWER_OFF, EVENT_FOLLOWER_BACK, EVENT_KINDS };
+
+const char* const EVENT_NAMES[EVENT_KINDS] = {"leader off", "old leader back", "follower off", "follower back"};
+
+struct Event {
+    EventKind kind;
+    int group;
+    int node;
+    int leaderBefore;
+    uint64_t trueUs;
+};
+
+class ElectionSim {
+public:
+    explicit ElectionSim(const ElectionConfig& config)
+        : config_(config), rng_(config.seed), medium_(config.medium, config.devices, rng_),
+          electedMs_(config.groups, -1), switchedOff_(config.groups, -1), firstBootUs_(config.groups, UINT64_MAX),
+          lastBootUs_(config.groups, 0) {
+        std::uniform_real_distribution<double> drift(-40e-6, 40e-6);
+        std::uniform_real_distribution<double> epoch(0, 600e6);
+        std::uniform_real_distribution<double> boot(0, config.bootSpreadMs * 1000);
+
+        for (int i = 0; i < config.devices; i++) {
+            nodes_.emplace_back(new ElectionNode());
+            ElectionNode& node = *nodes_.back();
+            Medium::macFor(i, node.mac);
+            int group = i % config.groups;
+            node.group = (uint16_t)('A' << 8 | ('A' + group));
+            node.epochUs = epoch(rng_);
+            node.drift = drift(rng_);
+            node.bootUs = (uint64_t)boot(rng_);
+            medium_.setNodeUp(i, false);
+            firstBootUs_[group] = std::min(firstBootUs_[group], node.bootUs);
+            lastBootUs_[group] = std::max(lastBootUs_[group], node.bootUs);
+            lastBootAllUs_ = std::max(lastBootAllUs_, node.bootUs);
+        }
+    }
+
+    int run() {
+        const uint64_t endUs = (uint64_t)(config_.seconds * 1e6);
+        const uint64_t intervalUs = (uint64_t)(config_.intervalMs * 1000);
+        uint64_t nextEventUs = lastBootAllUs_ + ELECTION_EVENTS_AFTER_US;
+        int eventCount = 0;
+
+        for (uint64_t t = 0; t <= endUs; t += 1000) {
+            now_ = t;
+            bootDue(t);
+            medium_.deliverUntil(t, [this](int to, int from, const uint8_t* data, size_t len, uint64_t trueUs) {
+                ElectionNode& node = *nodes_[to];
+                if (!node.running()) return;
+                enter(to, trueUs);
+                if (!node.discovery->handleMessage(nodes_[from]->mac, data, len)) {
+                    node.election->handleMessage(nodes_[from]->mac, data, len);
+                }
+            });
+            for (size_t i = 0; i < nodes_.size(); i++) {
+                if (nodes_[i]->running()) {
+                    enter(i, t);
+                    nodes_[i]->discovery->update();
+                    nodes_[i]->election->update();
+                }
+            }
+
+            if (t % ELECTION_CHECK_INTERVAL_US != 0) {
+                continue;
+            }
+            checkElections(t);
+            checkEvents(t);
+            // Late events would have no time left to settle
+            if (t >= nextEventUs && t + ELECTION_TARGET_MS * 1000ULL <= endUs) {
+                startEvent(eventCount++, t);
+                nextEventUs += intervalUs;
+            }
+        }
+
+        return report(endUs);
+    }
+
+private:
+    void enter(size_t i, uint64_t trueUs) { HostTime::setMicros(nodes_[i]->localAt(trueUs)); }
+
+    void bootDue(uint64_t t) {
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            if (!nodes_[i]->booted && t >= nodes_[i]->bootUs) {
+                boot(i, t);
+            }
+        }
+    }
+
+    void boot(size_t i, uint64_t t) {
+        ElectionNode& node = *nodes_[i];
+        node.booted = true;
+        node.up = true;
+        medium_.setNodeUp(i, true);
+        enter(i, t);
+
+        node.discovery.reset(new PeerDiscovery());
+        node.election.reset(new LeaderElection());
+        ElectionNode* self = &node;
+        // What SyncController does: group peers are the candidates
+        node.discovery->setSendFunction([this, i](const uint8_t* to, const uint8_t* data, size_t len) {
+            return medium_.send(i, to, data, len, now_);
+        });
+        node.discovery->onPeerAdded([self](const PeerInfo& peer) {
+            if (peer.group_id == self->group) self->election->addCandidate(peer.mac);
+        });
+        node.discovery->onPeerRemoved([self](const PeerInfo& peer) { self->election->removeCandidate(peer.mac); });
+        node.election->setSendFunction([this, i](const uint8_t* to, const uint8_t* data, size_t len) {
+            return medium_.send(i, to, data, len, now_);
+        });
+        node.discovery->begin(node.group, (uint8_t)(i % 10), PEER_CAP_LEDS);
+        node.election->begin(node.mac, node.group);
+    }
+
+    void switchOff(int i) {
+        ElectionNode& node = *nodes_[i];
+        // Keep its stats for the report
+        const LeaderElectionStats& stats = node.election->getStats();
+        claims_ += stats.claims;
+        stepDowns_ += stats.step_downs;
+        expired_ += stats.leases_expired;
+        heartbeats_ += stats.heartbeats_sent;
+        node.up = false;
+        medium_.setNodeUp(i, false);
+    }
+
+    // The node every running member of the group follows, or -1
+    int agreedLeader(int group) const {
+        int leader = -1;
+        for (size_t i = group; i < nodes_.size(); i += config_.groups) {
+            const ElectionNode& node = *nodes_[i];
+            if (!node.running()) continue;
+            if (!node.election->hasLeader()) return -1;
+            int follows = medium_.nodeFor(node.election->getLeader());
+            if (leader >= 0 && follows != leader) return -1;
+            leader = follows;
+        }
+        if (leader < 0 || !nodes_[leader]->running() || !nodes_[leader]->election->isLeader()) return -1;
+        return leader;
+    }
+
+    void checkElections(uint64_t t) {
+        for (int g = 0; g < config_.groups; g++) {
+            if (electedMs_[g] < 0 && t >= lastBootUs_[g] && agreedLeader(g) >= 0) {
+                electedMs_[g] = (t - lastBootUs_[g]) / 1000.0;
+                fromFirstBootMs_.push_back((t - firstBootUs_[g]) / 1000.0);
+            }
+        }
+    }
+
+    void startEvent(int count, uint64_t t) {
+        Event event;
+        event.group = count % config_.groups;
+        event.kind = (EventKind)((count / config_.groups) % EVENT_KINDS);
+        event.leaderBefore = agreedLeader(event.group);
+        event.trueUs = t;
+        event.node = -1;
+
+        // The previous event in this group never settled; it counts as missed
+        for (size_t e = 0; e < events_.size();) {
+            if (events_[e].group == event.group) {
+                unsettled_[events_[e].kind]++;
+                events_.erase(events_.begin() + e);
+            } else {
+                e++;
+            }
+        }
+
+        switch (event.kind) {
+        case EVENT_LEADER_OFF:
+            event.node = event.leaderBefore;
+            break;
+        case EVENT_FOLLOWER_OFF: {
+            std::vector<int> followers;
+            for (size_t i = event.group; i < nodes_.size(); i += config_.groups) {
+                if (nodes_[i]->running() && (int)i != event.leaderBefore) followers.push_back((int)i);
+            }
+            if (!followers.empty()) {
+                event.node = followers[std::uniform_int_distribution<size_t>(0, followers.size() - 1)(rng_)];
+            }
+            break;
+        }
+        default:
+            event.node = switchedOff_[event.group];
+            break;
+        }
+        if (event.node < 0 || event.leaderBefore < 0) {
+            skipped_++;
+            return;
+        }
+
+        if (event.kind == EVENT_LEADER_OFF || event.kind == EVENT_FOLLOWER_OFF) {
+            switchOff(event.node);
+            switchedOff_[event.group] = event.node;
+        } else {
+            boot(event.node, t);
+            switchedOff_[event.group] = -1;
+        }
+        events_.push_back(event);
+    }
+
+    void checkEvents(uint64_t t) {
+        for (size_t e = 0; e < events_.size();) {
+            const Event& event = events_[e];
+            int leader = agreedLeader(event.group);
+            if (leader < 0) {
+                e++;
+                continue;
+            }
+            settleMs_[event.kind].push_back((t - event.trueUs) / 1000.0);
+            if (event.kind != EVENT_LEADER_OFF && leader != event.leaderBefore) {
+                moved_[event.kind]++;
+            }
+            events_.erase(events_.begin() + e);
+        }
+    }
+
+    int report(uint64_t endUs) {
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            if (nodes_[i]->running()) switchOff((int)i);
+        }
+        for (const Event& event : events_) unsettled_[event.kind]++;
+
+        std::vector<double> elected;
+        int notElected = 0;
+        for (double ms : electedMs_) {
+            if (ms < 0) notElected++;
+            else elected.push_back(ms);
+        }
+
+        AirtimeModel airtime;
+        double heartbeatUs = airtime.difsUs + airtime.cwMin / 2.0 * airtime.slotUs + airtime.frameUs(LEADER_HEARTBEAT_SIZE);
+        double seconds = endUs / 1e6;
+
+        printf("\n--- Leader election ---\n");
+        printf("Devices:                 %d in %d groups, booted over %.0f ms, %.0f s simulated\n", config_.devices,
+               config_.groups, config_.bootSpreadMs, seconds);
+        printf("Link:                    %.0f us + exp(%.0f us) jitter, %.1f%% loss\n", config_.medium.latencyUs,
+               config_.medium.jitterUs, config_.medium.lossPercent);
+        printf("Lease:                   %d ms, heartbeat every %d ms, %d ms per rank\n", LEADER_LEASE,
+               LEADER_HEARTBEAT_INTERVAL, LEADER_RANK_DELAY);
+        if (!elected.empty()) {
+            printf("Election:                mean %.0f ms, max %.0f ms after a group's last device booted "
+                   "(max %.0f ms after its first)\n",
+                   mean(elected), percentile(elected, 1.0), percentile(fromFirstBootMs_, 1.0));
+        }
+        if (notElected) {
+            printf("Election:                %d groups never agreed\n", notElected);
+        }
+        for (int kind = 0; kind < EVENT_KINDS; kind++) {
+            const std::vector<double>& settle = settleMs_[kind];
+            printf("  %-22s %3zu: agreed after mean %4.0f ms, max %4.0f ms; leader moved %d, never agreed %d\n",
+                   EVENT_NAMES[kind], settle.size(), mean(settle), percentile(settle, 1.0), moved_[kind],
+                   unsettled_[kind]);
+        }
+        if (skipped_) {
+            printf("Skipped:                 %d events (group had no agreed leader yet)\n", skipped_);
+        }
+        printf("Leadership:              %lu claims, %lu step-downs, %lu leases expired\n", claims_, stepDowns_,
+               expired_);
+        printf("Heartbeats:              %.1f/s camp-wide, ~%.2f%% of channel airtime\n", heartbeats_ / seconds,
+               100.0 * heartbeats_ * heartbeatUs / (seconds * 1e6));
+
+        double worstElection = percentile(elected, 1.0);
+        double worstFailover = percentile(settleMs_[EVENT_LEADER_OFF], 1.0);
+        int moved = 0, unsettled = 0;
+        for (int kind = 0; kind < EVENT_KINDS; kind++) {
+            moved += moved_[kind];
+            unsettled += unsettled_[kind];
+        }
+        bool ok = notElected == 0 && unsettled == 0 && moved == 0 && worstElection <= ELECTION_TARGET_MS &&
+                  worstFailover <= ELECTION_TARGET_MS;
+        printf("%s: %s (target: elections and failovers within %d ms, joins and leaves keep the leader)\n",
+               ok ? "PASS" : "FAIL", ok ? "every group agreed on one leader" : "target missed", ELECTION_TARGET_MS);
+        return ok ? 0 : 1;
+    }
+
+    ElectionConfig config_;
+    std::mt19937 rng_;
+    Medium medium_;
+    std::vector<std::unique_ptr<ElectionNode>> nodes_;
+    uint64_t now_ = 0;
+
+    std::vector<double> electedMs_;         // Per group, -1 until it agrees
+    std::vector<double> fromFirstBootMs_;
+    std::vector<int> switchedOff_;          // Per group, the node the last "off" event took out
+    std::vector<uint64_t> firstBootUs_;
+    std::vector<uint64_t> lastBootUs_;
+    uint64_t lastBootAllUs_ = 0;
+
+    std::vector<Event> events_;             // Waiting for their group to agree
+    std::vector<double> settleMs_[EVENT_KINDS];
+    int moved_[EVENT_KINDS] = {};
+    int unsettled_[EVENT_KINDS] = {};
+    int skipped_ = 0;
+
+    unsigned long claims_ = 0;
+    unsigned long stepDowns_ = 0;
+    unsigned long expired_ = 0;
+    unsigned long heartbeats_ = 0;
+};
+
+void printUsage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s election [--devices n] [--groups n] [--boot-spread ms] [--interval ms] [--seconds s] "
+            "[--latency us] [--jitter us] [--loss pct] [--seed n]\n",
+            argv0);
+}
+
+} // namespace
+
+int runElection(int argc, char** argv) {
+    ElectionConfig config;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--devices") config.devices = std::max(2, atoi(value));
+        else if (arg == "--groups") config.groups = std::max(1, atoi(value));
+        else if (arg == "--boot-spread") config.bootSpreadMs = atof(value);
+        else if (arg == "--interval") config.intervalMs = std::max(10.0, atof(value));
+        else if (arg == "--seconds") config.seconds = atof(value);
+        else if (arg == "--latency") config.medium.latencyUs = atof(value);
+        else if (arg == "--jitter") config.medium.jitterUs = atof(value);
+        else if (arg == "--loss") config.medium.lossPercent = atof(value);
+        else if (arg == "--seed") config.seed = (unsigned)atoi(value);
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    config.groups = std::min(config.groups, 26);
+    // Every group needs a follower left once its leader is off
+    config.devices = std::max(config.devices, config.groups * 3);
+
+    ElectionSim sim(config);
+    return sim.run();
+}
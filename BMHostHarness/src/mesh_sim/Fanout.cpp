@@ -0,0 +1,171 @@
+// Fan-out scenario: scene updates from one device to the rest of its group.
+//
+// A group of devices shares one channel. One of them turns the dial and sends
+// scene updates (real SyncEncoder output, so message sizes are what the props
+// send) to the rest, either as one broadcast frame or as the old loop of
+// acknowledged unicasts. The 802.11 DCF timing in Airtime.h gives the
+// channel airtime each update costs and the send latency: the time from
+// sendUpdate() until the last receiver has the update.
+//
+// Usage:
+//   mesh_sim fanout [options]
+//     --devices <list>     group sizes to compare (default 5,20,50)
+//     --updates <n>        updates per run (default 2000)
+//     --loss <pct>         per-frame loss (default 5)
+//     --seed <n>           random seed
+//
+// Exits non-zero if broadcast fan-out is not cheaper than unicast for every
+// group size.
+
+#include <FastLED.h>
+#include <SyncProtocol.h>
+#include "Airtime.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+struct SimConfig {
+    std::vector<int> devices = {5, 20, 50};
+    int updates = 2000;
+    double lossPercent = 5;
+    unsigned seed = 1;
+};
+
+struct FanoutResult {
+    double framesPerUpdate = 0;
+    double airUsPerUpdate = 0;
+    double meanLatencyUs = 0;
+    double p99LatencyUs = 0;
+    double receivedPercent = 0;  // Receiver copies that arrived
+};
+
+// What a dial session produces: mostly brightness ticks, now and then a
+// palette or scene change, and a keyframe every SYNC_KEYFRAME_INTERVAL
+static std::vector<size_t> encodeUpdates(int count, std::mt19937& rng) {
+    SyncEncoder encoder(SyncProtocol::groupId("CL"));
+    LightScene scene = {};
+    scene.scene_id = palette_stream;
+    scene.brightness = 25;
+    std::vector<size_t> sizes;
+    uint8_t buffer[SYNC_MAX_MESSAGE_SIZE];
+    while ((int)sizes.size() < count) {
+        switch (std::uniform_int_distribution<int>(0, 9)(rng)) {
+            case 0: scene.primary_palette = (AvailablePalettes)((scene.primary_palette + 1) % (SYNC_LAST_PALETTE + 1)); break;
+            case 1:
+                scene.scene_id = (LightSceneID)std::uniform_int_distribution<int>(1, SYNC_LAST_SCENE_ID)(rng);
+                scene.scenes.palette_stream.duration = std::uniform_int_distribution<int>(10, 500)(rng);
+                break;
+            default: scene.brightness += 5; break;
+        }
+        size_t len = encoder.encode(scene, buffer, sizeof(buffer));
+        if (len) {
+            sizes.push_back(len);
+        }
+    }
+    return sizes;
+}
+
+static FanoutResult runFanout(int devices, bool broadcast, const std::vector<size_t>& sizes, double loss,
+                              std::mt19937& rng) {
+    AirtimeModel model;
+    std::uniform_real_distribution<double> chance(0, 1);
+    int receivers = devices - 1;
+    std::vector<double> latencies;
+    double frames = 0, air = 0, received = 0;
+
+    for (size_t payload : sizes) {
+        if (broadcast) {
+            Transmission tx = transmitBroadcast(model, payload, rng);
+            frames += tx.attempts;
+            air += tx.airUs;
+            for (int r = 0; r < receivers; r++) {
+                received += chance(rng) >= loss;
+            }
+            latencies.push_back(tx.elapsedUs);
+        } else {
+            // esp_now_send() queues every peer; the driver sends them back to back
+            double elapsed = 0;
+            for (int r = 0; r < receivers; r++) {
+                Transmission tx = transmitUnicast(model, payload, loss, rng);
+                frames += tx.attempts;
+                air += tx.airUs;
+                elapsed += tx.elapsedUs;
+                received += tx.received;
+            }
+            latencies.push_back(elapsed);
+        }
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    double sum = 0;
+    for (double l : latencies) sum += l;
+
+    FanoutResult result;
+    result.framesPerUpdate = frames / sizes.size();
+    result.airUsPerUpdate = air / sizes.size();
+    result.meanLatencyUs = sum / latencies.size();
+    result.p99LatencyUs = latencies[(size_t)(latencies.size() * 0.99)];
+    result.receivedPercent = 100.0 * received / ((double)sizes.size() * receivers);
+    return result;
+}
+
+static void printUsage(const char* argv0) {
+    fprintf(stderr, "usage: %s fanout [--devices 5,20,50] [--updates n] [--loss pct] [--seed n]\n", argv0);
+}
+
+int runFanout(int argc, char** argv) {
+    SimConfig config;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--devices") {
+            if (!parseList(value, config.devices, 2)) {
+                printUsage(argv[0]);
+                return 2;
+            }
+        } else if (arg == "--updates") config.updates = std::max(1, atoi(value));
+        else if (arg == "--loss") config.lossPercent = atof(value);
+        else if (arg == "--seed") config.seed = (unsigned)atoi(value);
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    std::mt19937 rng(config.seed);
+    std::vector<size_t> sizes = encodeUpdates(config.updates, rng);
+    double meanSize = 0;
+    for (size_t s : sizes) meanSize += s;
+    meanSize /= sizes.size();
+
+    printf("\n--- Sync fan-out (%d updates, %.1f byte mean payload, %.1f%% loss) ---\n", config.updates, meanSize,
+           config.lossPercent);
+    printf("%-8s %-10s %10s %14s %14s %14s %10s %12s\n", "devices", "fan-out", "frames", "airtime us", "latency us",
+           "p99 us", "received", "max upd/s");
+
+    bool ok = true;
+    for (int devices : config.devices) {
+        FanoutResult unicast = runFanout(devices, false, sizes, config.lossPercent / 100.0, rng);
+        FanoutResult broadcast = runFanout(devices, true, sizes, config.lossPercent / 100.0, rng);
+        const FanoutResult* results[2] = {&unicast, &broadcast};
+        const char* names[2] = {"unicast", "broadcast"};
+        for (int m = 0; m < 2; m++) {
+            const FanoutResult& r = *results[m];
+            printf("%-8d %-10s %10.1f %14.0f %14.0f %14.0f %9.1f%% %12.0f\n", devices, names[m], r.framesPerUpdate,
+                   r.airUsPerUpdate, r.meanLatencyUs, r.p99LatencyUs, r.receivedPercent, 1e6 / r.meanLatencyUs);
+        }
+        ok = ok && broadcast.airUsPerUpdate < unicast.airUsPerUpdate &&
+             broadcast.meanLatencyUs < unicast.meanLatencyUs;
+    }
+    printf("%s\n", ok ? "PASS: broadcast is cheaper at every group size" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,9 @@
+// Library sources under test, compiled directly so this environment does not
+// pull in the rest of BurningManLEDs (LocationService needs TinyGPSPlus).
+#include "../../../libraries/BurningManLEDs/src/SyncProtocol.cpp"
+#include "../../../libraries/BurningManLEDs/src/SyncChannel.cpp"
+#include "../../../libraries/BurningManLEDs/src/PeerDiscovery.cpp"
+#include "../../../libraries/BurningManLEDs/src/LeaderElection.cpp"
+#include "../../../libraries/BurningManLEDs/src/MeshRelay.cpp"
+#include "../../../libraries/BurningManLEDs/src/PixelStream.cpp"
+#include "../../../libraries/BurningManLEDs/src/RadioSchedule.cpp"
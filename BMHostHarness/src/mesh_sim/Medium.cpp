@@ -0,0 +1,92 @@
+#include "Medium.h"
+
+#include <algorithm>
+#include <cstring>
+
+Medium::Medium(const MediumConfig& config, int nodes, std::mt19937& rng)
+    : config_(config), rng_(rng), up_(nodes, true), partition_(nodes, 0) {}
+
+void Medium::macFor(int node, uint8_t mac[6]) {
+    const uint8_t base[6] = {0x24, 0x0A, 0xC4, 0x00, (uint8_t)(node >> 8), (uint8_t)node};
+    memcpy(mac, base, 6);
+}
+
+int Medium::nodeFor(const uint8_t mac[6]) const {
+    uint8_t expected[6];
+    int node = mac[4] << 8 | mac[5];
+    if (node >= (int)up_.size()) {
+        return -1;
+    }
+    macFor(node, expected);
+    return memcmp(expected, mac, 6) == 0 ? node : -1;
+}
+
+bool Medium::send(int from, const uint8_t* to, const uint8_t* data, size_t len, uint64_t trueUs) {
+    static const uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    if (!up_[from]) {
+        return false;
+    }
+    framesSent_++;
+    bytesSent_ += len;
+
+    if (memcmp(to, broadcast, 6) == 0) {
+        for (int node = 0; node < (int)up_.size(); node++) {
+            if (node != from) {
+                enqueue(from, node, data, len, trueUs);
+            }
+        }
+        return true;
+    }
+    int node = nodeFor(to);
+    if (node < 0 || node == from) {
+        return false;
+    }
+    for (int attempt = 0; attempt <= config_.macRetries; attempt++) {
+        if (enqueue(from, node, data, len, trueUs + (uint64_t)(attempt * config_.latencyUs))) {
+            return up_[node];
+        }
+        if (!inRange(from, node)) {
+            break;
+        }
+    }
+    return false;
+}
+
+bool Medium::enqueue(int from, int to, const uint8_t* data, size_t len, uint64_t trueUs) {
+    if (!inRange(from, to)) {
+        copiesOutOfRange_++;
+        return false;
+    }
+    if (std::uniform_real_distribution<double>(0, 100)(rng_) < config_.lossPercent) {
+        copiesLost_++;
+        return false;
+    }
+    std::exponential_distribution<double> jitter(1.0 / std::max(1.0, config_.jitterUs));
+    Delivery delivery;
+    delivery.trueUs = trueUs + (uint64_t)(config_.latencyUs + jitter(rng_));
+    delivery.order = order_++;
+    delivery.from = from;
+    delivery.to = to;
+    delivery.data.assign(data, data + len);
+    queue_.push(delivery);
+
+    if (std::uniform_real_distribution<double>(0, 100)(rng_) < config_.duplicatePercent) {
+        copiesDuplicated_++;
+        delivery.trueUs += (uint64_t)(config_.latencyUs + jitter(rng_));
+        delivery.order = order_++;
+        queue_.push(delivery);
+    }
+    return true;
+}
+
+void Medium::deliverUntil(uint64_t trueUs, const DeliverFunction& deliver) {
+    while (!queue_.empty() && queue_.top().trueUs <= trueUs) {
+        Delivery delivery = queue_.top();
+        queue_.pop();
+        if (!up_[delivery.to]) {
+            copiesLost_++;
+            continue;
+        }
+        deliver(delivery.to, delivery.from, delivery.data.data(), delivery.data.size(), delivery.trueUs);
+    }
+}
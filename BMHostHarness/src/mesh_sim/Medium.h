@@ -0,0 +1,89 @@
+#ifndef MESH_SIM_MEDIUM_H
+#define MESH_SIM_MEDIUM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+
+// Shared ESP-NOW channel for in-process simulations.
+//
+// Nodes are addressed by index; their MAC is macFor(index). send() copies the
+// frame to every other node (broadcast) or to the addressed one, dropping
+// each copy with the configured loss and delaying it by a base latency plus
+// exponential jitter. Some copies arrive twice, the way a frame is repeated
+// when its MAC ACK is lost. A lost unicast copy can be retried like the MAC
+// layer does. Nodes in different partitions, or that the range function
+// keeps apart (a line of props, say), are out of range of each other.
+// deliverUntil() hands due frames to the simulator in arrival order.
+struct MediumConfig {
+    double latencyUs = 1500;
+    double jitterUs = 1500;
+    double lossPercent = 5;
+    double duplicatePercent = 0;
+    int macRetries = 0;     // Extra attempts for a lost unicast copy
+};
+
+class Medium {
+public:
+    typedef std::function<void(int to, int from, const uint8_t* data, size_t len, uint64_t trueUs)> DeliverFunction;
+    typedef std::function<bool(int a, int b)> RangeFunction;
+
+    Medium(const MediumConfig& config, int nodes, std::mt19937& rng);
+
+    static void macFor(int node, uint8_t mac[6]);
+    int nodeFor(const uint8_t mac[6]) const;
+
+    // Frames sent by or to a node that is down are lost
+    void setNodeUp(int node, bool up) { up_[node] = up; }
+    bool isNodeUp(int node) const { return up_[node]; }
+    // Only nodes in the same partition hear each other (all start in 0)
+    void setPartition(int node, int partition) { partition_[node] = partition; }
+    int partitionOf(int node) const { return partition_[node]; }
+    // Topology on top of partitions; without one everyone hears everyone
+    void setRange(RangeFunction inRange) { inRange_ = inRange; }
+    bool inRange(int a, int b) const { return partition_[a] == partition_[b] && (!inRange_ || inRange_(a, b)); }
+
+    // Returns false if the sender is down; for a unicast, whether a copy
+    // reached the addressee (what its MAC ACK would report)
+    bool send(int from, const uint8_t* to, const uint8_t* data, size_t len, uint64_t trueUs);
+    void deliverUntil(uint64_t trueUs, const DeliverFunction& deliver);
+
+    unsigned long framesSent() const { return framesSent_; }
+    unsigned long copiesLost() const { return copiesLost_; }
+    unsigned long copiesDuplicated() const { return copiesDuplicated_; }
+    unsigned long copiesOutOfRange() const { return copiesOutOfRange_; }
+    unsigned long bytesSent() const { return bytesSent_; }
+
+private:
+    struct Delivery {
+        uint64_t trueUs;
+        uint64_t order;
+        int from;
+        int to;
+        std::vector<uint8_t> data;
+
+        bool operator>(const Delivery& other) const {
+            return trueUs != other.trueUs ? trueUs > other.trueUs : order > other.order;
+        }
+    };
+
+    bool enqueue(int from, int to, const uint8_t* data, size_t len, uint64_t trueUs);
+
+    MediumConfig config_;
+    std::mt19937& rng_;
+    std::vector<bool> up_;
+    std::vector<int> partition_;
+    RangeFunction inRange_;
+    std::priority_queue<Delivery, std::vector<Delivery>, std::greater<Delivery>> queue_;
+    uint64_t order_ = 0;
+    unsigned long framesSent_ = 0;
+    unsigned long copiesLost_ = 0;
+    unsigned long copiesDuplicated_ = 0;
+    unsigned long copiesOutOfRange_ = 0;
+    unsigned long bytesSent_ = 0;
+};
+
+#endif // MESH_SIM_MEDIUM_H
@@ -0,0 +1,569 @@
+// Props scenario: whole props sharing one channel, end to end.
+//
+// Every device is a complete prop: the real SyncController (discovery, leader
+// election, scene sync, clock sync) driving a LightShow that renders into a capture
+// controller instead of a strip. Each prop runs on its own virtual clock with
+// crystal drift, and reaches the others through HostArduino's ESP-NOW shim
+// (HostEspNow.h) over a Medium with loss, jitter, duplicated frames and MAC
+// retries for unicasts. Props of several owners boot over a few seconds;
+// then each owner keeps changing the scene from random props of their group:
+// dial turns, palettes, speeds and modes. Optionally every group is split in
+// two halves that are out of range of each other for a while, or the props
+// stand along a line of spots that only hear their neighbours, with the mesh
+// relay carrying scene updates and heartbeats to the far end.
+//
+// Reported: how long until a group shows the same scene after a change (for
+// changes made while split, after the split heals), frames, bytes and airtime
+// per message type, and the frame-phase error: how far each follower's show
+// clock, which decides where in its animation a frame is, is from its
+// leader's (the group's time master) when both render.
+//
+// Usage:
+//   mesh_sim props [options]
+//     --devices <n>          props (default 50)
+//     --groups <n>           owners they are split between (default 5)
+//     --seconds <s>          simulated duration (default 60)
+//     --changes <n>          scene changes per owner per minute (default 30)
+//     --partition <s>        split every group in two at this time (default: never)
+//     --partition-length <s> how long the split lasts (default 10)
+//     --spots <n>            props stand along a line of this many spots (default 1: all in range)
+//     --relay <ttl>          enable the mesh relay on every prop (default: off)
+//     --latency <us>         base one-way latency (default 1500)
+//     --jitter <us>          mean exponential jitter (default 1500)
+//     --loss <pct>           per-copy loss (default 5)
+//     --duplicates <pct>     copies delivered twice (default 1)
+//     --seed <n>             random seed
+//
+// Exits non-zero unless every change converges within 1s (of the change, or
+// of the heal) and the 99th percentile frame-phase error of locked followers
+// stays under 2ms.
+
+#include <Arduino.h>
+#include <HostEspNow.h>
+#include <SyncController.h>
+#include "Airtime.h"
+#include "Medium.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#define PROPS_CONVERGENCE_TARGET_MS 1000
+#define PROPS_PHASE_TARGET_US 2000
+#define PROPS_LEDS 60
+#define PROPS_FRAME_US 20000ULL
+#define PROPS_CHECK_US 5000ULL
+#define PROPS_PHASE_SAMPLE_US 100000ULL
+#define PROPS_BOOT_SPREAD_US 2000000ULL
+#define PROPS_WARMUP_US 5000000ULL   // After the last boot: discovery and clock lock
+#define PROPS_DETENT_US 10000ULL
+
+namespace {
+
+struct PropsConfig {
+    int devices = 50;
+    int groups = 5;
+    double seconds = 60;
+    double changesPerMinute = 30;
+    double partitionAt = -1;
+    double partitionLength = 10;
+    int spots = 1;
+    int relayTtl = -1;      // Relay off
+    MediumConfig medium;
+    unsigned seed = 1;
+
+    PropsConfig() {
+        medium.duplicatePercent = 1;
+        medium.macRetries = 7;
+    }
+};
+
+// Stands in for a strip: keeps the last frame the show rendered
+class CaptureController : public CLEDController {
+public:
+    CaptureController() : pixels_(PROPS_LEDS) { setLeds(pixels_.data(), PROPS_LEDS); }
+
+    void init() override {}
+    void showColor(const CRGB& color, int nLeds, uint8_t brightness) override {
+        frame_.assign(nLeds, color);
+        capture(brightness);
+    }
+    void show(const CRGB* data, int nLeds, uint8_t brightness) override {
+        frame_.assign(data, data + nLeds);
+        capture(brightness);
+    }
+
+    unsigned long frames() const { return frames_; }
+
+private:
+    void capture(uint8_t brightness) {
+        brightness_ = brightness;
+        frames_++;
+    }
+
+    std::vector<CRGB> pixels_;
+    std::vector<CRGB> frame_;
+    uint8_t brightness_ = 0;
+    unsigned long frames_ = 0;
+};
+
+struct PropNode {
+    PropNode(const uint8_t address[6], const std::string& ownerName)
+        : radio(address), owner(ownerName), show(std::vector<CLEDController*>{&capture}, clock),
+          controller(show, owner, device) {
+        memcpy(mac, address, 6);
+    }
+
+    uint8_t mac[6];
+    HostRadio radio;
+    std::string owner;
+    Device device = Device::backpack;
+    double epochUs = 0;     // Local time at true time zero
+    double drift = 0;
+    uint64_t bootUs = 0;
+    bool booted = false;
+    Clock clock;
+    CaptureController capture;
+    LightShow show;
+    SyncController controller;
+
+    uint64_t localAt(uint64_t trueUs) const { return (uint64_t)(epochUs + trueUs * (1.0 + drift)); }
+};
+
+// A dial turned a few detents, or a single palette/speed/mode change
+struct Gesture {
+    int node;
+    int detents;        // Dial detents still to come; 0 for other changes
+    int8_t direction;
+    uint64_t nextUs;
+};
+
+struct Change {
+    int group;
+    uint64_t trueUs;    // Last input of the gesture
+    bool split;         // Made while the group was split
+};
+
+struct TrafficCount {
+    unsigned long frames = 0;
+    unsigned long bytes = 0;
+    double airUs = 0;
+};
+
+enum TrafficKind {
+    TRAFFIC_SCENE,
+    TRAFFIC_ACK,
+    TRAFFIC_BEACON,
+    TRAFFIC_HEARTBEAT,
+    TRAFFIC_CLOCK,
+    TRAFFIC_RELAY,
+    TRAFFIC_OTHER,
+    TRAFFIC_KINDS
+};
+
+const char* const TRAFFIC_NAMES[TRAFFIC_KINDS] = {"scene", "scene ack", "discovery", "leader heartbeat",
+                                                  "clock sync", "mesh relay", "other"};
+
+// What the sketches switch between with changeMode(). It only sets the
+// scene id, so modes whose parameters LightShow has to set up first (breathe,
+// sparkle, ...) are changed through LightShow, not synced this way.
+const LightSceneID MODES[] = {palette_stream, palette_cycle};
+
+class PropsSim {
+public:
+    explicit PropsSim(const PropsConfig& config)
+        : config_(config), rng_(config.seed), medium_(config.medium, config.devices, rng_) {
+        std::uniform_real_distribution<double> drift(-40e-6, 40e-6);
+        std::uniform_real_distribution<double> epoch(0, 600e6);
+        std::uniform_real_distribution<double> boot(0, (double)PROPS_BOOT_SPREAD_US);
+        randomSeed(config.seed);
+
+        for (int i = 0; i < config.devices; i++) {
+            uint8_t mac[6];
+            Medium::macFor(i, mac);
+            std::string owner = {'A', (char)('A' + i % config.groups)};
+            double epochUs = epoch(rng_);
+            HostTime::setMicros((uint64_t)epochUs);
+            nodes_.emplace_back(new PropNode(mac, owner));
+
+            PropNode& node = *nodes_.back();
+            node.epochUs = epochUs;
+            node.drift = drift(rng_);
+            node.bootUs = (uint64_t)boot(rng_);
+            node.radio.setTransmitFunction([this, i](const uint8_t* to, const uint8_t* data, size_t len) {
+                count(to, data, len);
+                return medium_.send(i, to, data, len, now_);
+            });
+            medium_.setNodeUp(i, false);
+            lastBootUs_ = std::max(lastBootUs_, node.bootUs);
+        }
+        // Each group has members at every spot
+        if (config.spots > 1) {
+            medium_.setRange([this](int a, int b) { return std::abs(spotOf(a) - spotOf(b)) <= 1; });
+        }
+    }
+
+    int run() {
+        const uint64_t endUs = (uint64_t)(config_.seconds * 1e6);
+        const uint64_t changesFromUs = lastBootUs_ + PROPS_WARMUP_US;
+        const bool partitioned = config_.partitionAt >= 0;
+        const uint64_t splitUs = partitioned ? (uint64_t)(config_.partitionAt * 1000) * 1000 : UINT64_MAX;
+        const uint64_t healUs = partitioned ? splitUs + (uint64_t)(config_.partitionLength * 1000) * 1000 : UINT64_MAX;
+        std::exponential_distribution<double> gap(config_.changesPerMinute / 60e6);
+        std::vector<uint64_t> nextChangeUs(config_.groups);
+        for (uint64_t& next : nextChangeUs) next = changesFromUs + (uint64_t)gap(rng_);
+
+        for (uint64_t t = 0; t <= endUs; t += 1000) {
+            now_ = t;
+            if (t == splitUs || t == healUs) {
+                split(t == splitUs);
+            }
+            bootDue(t);
+            medium_.deliverUntil(t, [this](int to, int from, const uint8_t* data, size_t len, uint64_t trueUs) {
+                enter(to, trueUs);
+                nodes_[to]->radio.receive(nodes_[from]->mac, data, len);
+            });
+
+            for (int group = 0; group < config_.groups; group++) {
+                if (t >= nextChangeUs[group] && t + 2000000ULL < endUs) {
+                    startGesture(group, t);
+                    nextChangeUs[group] = t + 1000 + (uint64_t)gap(rng_);
+                }
+            }
+            runGestures(t);
+
+            for (size_t i = 0; i < nodes_.size(); i++) {
+                PropNode& node = *nodes_[i];
+                if (!node.booted) continue;
+                enter(i, t);
+                node.controller.update();
+                node.radio.poll();
+                if (t % PROPS_FRAME_US == 0) {
+                    node.show.render();
+                }
+            }
+
+            if (t % PROPS_CHECK_US == 0) {
+                checkConvergence(t, healUs);
+            }
+            if (t % PROPS_PHASE_SAMPLE_US == 0 && t >= changesFromUs) {
+                samplePhase(t);
+            }
+        }
+        return report(endUs);
+    }
+
+private:
+    void enter(size_t i, uint64_t trueUs) {
+        PropNode& node = *nodes_[i];
+        HostTime::setMicros(node.localAt(trueUs));
+        HostEspNow::setRadio(&node.radio);
+        node.controller.makeCallbackTarget();
+    }
+
+    int groupOf(size_t i) const { return (int)(i % config_.groups); }
+    int spotOf(size_t i) const { return (int)(i / config_.groups) % config_.spots; }
+
+    void bootDue(uint64_t t) {
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            PropNode& node = *nodes_[i];
+            if (node.booted || t < node.bootUs) continue;
+            node.booted = true;
+            medium_.setNodeUp(i, true);
+            enter(i, t);
+            // What the sketches do in setup()
+            node.show.palette_stream(100, AvailablePalettes::cool);
+            node.show.brightness(25);
+            node.controller.begin(node.owner);
+            // Nobody is pinned; the group elects its time master
+            node.controller.enableClockSync(node.clock, false);
+            if (config_.relayTtl >= 0) {
+                node.controller.enableRelay((uint8_t)config_.relayTtl);
+            }
+        }
+    }
+
+    // Alternate members of every group go out of range of each other; the
+    // half without the leader elects its own until the split heals
+    void split(bool apart) {
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            medium_.setPartition(i, apart ? (int)(i / config_.groups) % 2 : 0);
+        }
+        split_ = apart;
+        // Changes still spreading when the group splits finish after it heals
+        for (Change& change : pending_) {
+            change.split = change.split || apart;
+        }
+    }
+
+    void startGesture(int group, uint64_t t) {
+        std::vector<int> members;
+        for (size_t i = group; i < nodes_.size(); i += config_.groups) members.push_back((int)i);
+        Gesture gesture;
+        gesture.node = members[std::uniform_int_distribution<size_t>(0, members.size() - 1)(rng_)];
+        gesture.direction = std::uniform_int_distribution<int>(0, 1)(rng_) ? 1 : -1;
+        gesture.nextUs = t;
+
+        PropNode& node = *nodes_[gesture.node];
+        int kind = std::uniform_int_distribution<int>(0, 9)(rng_);
+        gesture.detents = kind < 5 ? std::uniform_int_distribution<int>(3, 30)(rng_) : 0;
+        if (gesture.detents == 0) {
+            enter(gesture.node, t);
+            if (kind < 7) {
+                node.controller.setPalette((AvailablePalettes)std::uniform_int_distribution<int>(0, SYNC_LAST_PALETTE)(rng_));
+            } else if (kind < 8) {
+                node.controller.setSpeed((uint16_t)std::uniform_int_distribution<int>(1, 255)(rng_));
+            } else {
+                size_t mode = std::uniform_int_distribution<size_t>(0, sizeof(MODES) / sizeof(MODES[0]) - 1)(rng_);
+                node.controller.changeMode(MODES[mode]);
+            }
+            recordChange(gesture.node, t);
+            return;
+        }
+        gestures_.push_back(gesture);
+    }
+
+    void runGestures(uint64_t t) {
+        for (size_t g = 0; g < gestures_.size();) {
+            Gesture& gesture = gestures_[g];
+            if (t < gesture.nextUs) {
+                g++;
+                continue;
+            }
+            enter(gesture.node, t);
+            nodes_[gesture.node]->controller.handleDialChange(gesture.direction);
+            gesture.nextUs = t + PROPS_DETENT_US;
+            if (--gesture.detents > 0) {
+                g++;
+                continue;
+            }
+            recordChange(gesture.node, t);
+            gestures_.erase(gestures_.begin() + g);
+        }
+    }
+
+    void recordChange(int node, uint64_t t) {
+        Change change;
+        change.group = groupOf(node);
+        change.trueUs = t;
+        change.split = split_;
+        pending_.push_back(change);
+        changes_++;
+    }
+
+    bool groupAgrees(int group) const {
+        const LightScene first = nodes_[group]->show.getCurrentScene();
+        for (size_t i = group; i < nodes_.size(); i += config_.groups) {
+            if (!nodes_[i]->booted || SyncProtocol::diffScene(first, nodes_[i]->show.getCurrentScene()) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void checkConvergence(uint64_t t, uint64_t healUs) {
+        std::vector<int> agrees(config_.groups, -1);
+        for (size_t c = 0; c < pending_.size();) {
+            const Change& change = pending_[c];
+            // A split group cannot agree until it heals
+            if (split_ && change.split) {
+                c++;
+                continue;
+            }
+            int& group = agrees[change.group];
+            if (group < 0) group = groupAgrees(change.group) ? 1 : 0;
+            if (!group) {
+                c++;
+                continue;
+            }
+            uint64_t from = change.split ? std::max(change.trueUs, healUs) : change.trueUs;
+            (change.split ? healLatenciesMs_ : latenciesMs_).push_back((t - std::min(t, from)) / 1000.0);
+            pending_.erase(pending_.begin() + c);
+        }
+    }
+
+    // Against whichever prop each follower currently takes as its leader
+    void samplePhase(uint64_t t) {
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            PropNode& node = *nodes_[i];
+            if (node.controller.isLeader()) continue;
+            phaseSamples_++;
+            const LeaderElection& election = node.controller.getLeaderElection();
+            if (!node.booted || !node.controller.isClockSynced() || !election.hasLeader()) continue;
+            int leader = medium_.nodeFor(election.getLeader());
+            if (leader < 0) continue;
+            enter(leader, t);
+            uint64_t masterUs = nodes_[leader]->clock.nowMicros();
+            enter(i, t);
+            uint64_t followerUs = node.clock.nowMicros();
+            phaseErrorsUs_.push_back(std::abs((double)((int64_t)(followerUs - masterUs))));
+        }
+    }
+
+    void count(const uint8_t* to, const uint8_t* data, size_t len) {
+        static const uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+        TrafficKind kind = TRAFFIC_OTHER;
+        if (data[0] == SYNC_PROTOCOL_MAGIC) {
+            kind = len > 2 && data[2] == SYNC_MESSAGE_ACK ? TRAFFIC_ACK : TRAFFIC_SCENE;
+        } else if (data[0] == PEER_DISCOVERY_MAGIC) {
+            kind = TRAFFIC_BEACON;
+        } else if (data[0] == LEADER_ELECTION_MAGIC) {
+            kind = TRAFFIC_HEARTBEAT;
+        } else if (data[0] == CLOCK_SYNC_MAGIC) {
+            kind = TRAFFIC_CLOCK;
+        } else if (data[0] == MESH_RELAY_MAGIC) {
+            kind = TRAFFIC_RELAY;
+        }
+        // One attempt each; MAC retries of lost unicasts are not counted
+        double air = airtime_.difsUs + airtime_.cwMin / 2.0 * airtime_.slotUs + airtime_.frameUs(len);
+        if (memcmp(to, broadcast, 6) != 0) {
+            air += airtime_.sifsUs + airtime_.ackUs();
+        }
+        TrafficCount& traffic = traffic_[kind];
+        traffic.frames++;
+        traffic.bytes += len;
+        traffic.airUs += air;
+    }
+
+    int report(uint64_t endUs) {
+        double seconds = endUs / 1e6;
+        unsigned long frames = 0, sendErrors = 0, gaveUp = 0, rendered = 0;
+        unsigned long claims = 0, stepDowns = 0, relayed = 0, meshRelayed = 0, suppressed = 0;
+        int leaders = 0;
+        double air = 0;
+        for (const TrafficCount& traffic : traffic_) {
+            frames += traffic.frames;
+            air += traffic.airUs;
+        }
+        for (const auto& node : nodes_) {
+            sendErrors += node->radio.sendErrors();
+            gaveUp += node->controller.getSyncChannel().getStats().gave_up;
+            relayed += node->controller.getSyncChannel().getStats().relayed;
+            claims += node->controller.getLeaderElection().getStats().claims;
+            stepDowns += node->controller.getLeaderElection().getStats().step_downs;
+            leaders += node->controller.isLeader();
+            meshRelayed += node->controller.getMeshRelay().getStats().relayed;
+            suppressed += node->controller.getMeshRelay().getStats().suppressed;
+            rendered += node->capture.frames();
+        }
+
+        printf("\n--- Props (%d devices in %d groups, %.0f s simulated) ---\n", config_.devices, config_.groups,
+               seconds);
+        printf("Link:                    %.0f us + exp(%.0f us) jitter, %.1f%% loss, %.1f%% duplicates, %d MAC "
+               "retries\n",
+               config_.medium.latencyUs, config_.medium.jitterUs, config_.medium.lossPercent,
+               config_.medium.duplicatePercent, config_.medium.macRetries);
+        if (config_.partitionAt >= 0) {
+            printf("Split:                   every group halved from %.1f s for %.1f s\n", config_.partitionAt,
+                   config_.partitionLength);
+        }
+        if (config_.spots > 1) {
+            printf("Line:                    %d spots, each in range of its neighbours only\n", config_.spots);
+        }
+        if (config_.relayTtl >= 0) {
+            printf("Mesh relay:              ttl %d, %lu frames relayed, %lu suppressed\n", config_.relayTtl,
+                   meshRelayed, suppressed);
+        }
+        printf("Changes:                 %lu (%zu converged, %zu after a split, %zu never)\n", changes_,
+               latenciesMs_.size(), healLatenciesMs_.size(), pending_.size());
+        if (!latenciesMs_.empty()) {
+            printf("Convergence:             mean %.0f ms, p99 %.0f ms, max %.0f ms after the change\n",
+                   mean(latenciesMs_), percentile(latenciesMs_, 0.99), percentile(latenciesMs_, 1.0));
+        }
+        if (!healLatenciesMs_.empty()) {
+            printf("After the split:         mean %.0f ms, max %.0f ms after it healed\n", mean(healLatenciesMs_),
+                   percentile(healLatenciesMs_, 1.0));
+        }
+        printf("Frame phase:             mean %.0f us, p99 %.0f us, max %.0f us from the time master (%.1f%% of "
+               "samples locked)\n",
+               mean(phaseErrorsUs_), percentile(phaseErrorsUs_, 0.99), percentile(phaseErrorsUs_, 1.0),
+               100.0 * phaseErrorsUs_.size() / std::max(1UL, phaseSamples_));
+        printf("Leaders:                 %d at the end, %lu claims, %lu step-downs, %lu changes relayed\n", leaders,
+               claims, stepDowns, relayed);
+        printf("Traffic:                 %.1f frames/s, ~%.1f%% of channel airtime\n", frames / seconds,
+               100.0 * air / (seconds * 1e6));
+        for (int kind = 0; kind < TRAFFIC_KINDS; kind++) {
+            const TrafficCount& traffic = traffic_[kind];
+            if (traffic.frames == 0) continue;
+            printf("  %-22s %8.1f frames/s %8.0f bytes/s   %5.2f%% airtime\n", TRAFFIC_NAMES[kind],
+                   traffic.frames / seconds, traffic.bytes / seconds, 100.0 * traffic.airUs / (seconds * 1e6));
+        }
+        printf("Medium:                  %lu copies lost, %lu out of range, %lu duplicated\n", medium_.copiesLost(),
+               medium_.copiesOutOfRange(), medium_.copiesDuplicated());
+        printf("Props:                   %lu frames rendered, %lu esp_now_send errors, %lu sync receivers given "
+               "up on\n",
+               rendered, sendErrors, gaveUp);
+
+        double worst = std::max(percentile(latenciesMs_, 1.0), percentile(healLatenciesMs_, 1.0));
+        double phase = percentile(phaseErrorsUs_, 0.99);
+        bool ok = pending_.empty() && worst <= PROPS_CONVERGENCE_TARGET_MS && phase <= PROPS_PHASE_TARGET_US;
+        printf("%s: %s (target: every change within %d ms, p99 frame phase under %d us)\n", ok ? "PASS" : "FAIL",
+               ok ? "every group converged" : "target missed", PROPS_CONVERGENCE_TARGET_MS, PROPS_PHASE_TARGET_US);
+        return ok ? 0 : 1;
+    }
+
+    PropsConfig config_;
+    std::mt19937 rng_;
+    Medium medium_;
+    AirtimeModel airtime_;
+    std::vector<std::unique_ptr<PropNode>> nodes_;
+    std::vector<Gesture> gestures_;
+    std::vector<Change> pending_;
+    std::vector<double> latenciesMs_;
+    std::vector<double> healLatenciesMs_;
+    std::vector<double> phaseErrorsUs_;
+    unsigned long phaseSamples_ = 0;
+    unsigned long changes_ = 0;
+    TrafficCount traffic_[TRAFFIC_KINDS];
+    uint64_t now_ = 0;
+    uint64_t lastBootUs_ = 0;
+    bool split_ = false;
+};
+
+void printUsage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s props [--devices n] [--groups n] [--seconds s] [--changes n] [--partition s] "
+            "[--partition-length s] [--spots n] [--relay ttl] [--latency us] [--jitter us] [--loss pct] [--duplicates pct] [--seed n]\n",
+            argv0);
+}
+
+} // namespace
+
+int runProps(int argc, char** argv) {
+    PropsConfig config;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--devices") config.devices = std::max(2, atoi(value));
+        else if (arg == "--groups") config.groups = std::max(1, atoi(value));
+        else if (arg == "--seconds") config.seconds = atof(value);
+        else if (arg == "--changes") config.changesPerMinute = std::max(0.1, atof(value));
+        else if (arg == "--partition") config.partitionAt = atof(value);
+        else if (arg == "--partition-length") config.partitionLength = atof(value);
+        else if (arg == "--spots") config.spots = std::max(1, atoi(value));
+        else if (arg == "--relay") config.relayTtl = std::max(0, std::min(255, atoi(value)));
+        else if (arg == "--latency") config.medium.latencyUs = atof(value);
+        else if (arg == "--jitter") config.medium.jitterUs = atof(value);
+        else if (arg == "--loss") config.medium.lossPercent = atof(value);
+        else if (arg == "--duplicates") config.medium.duplicatePercent = atof(value);
+        else if (arg == "--seed") config.seed = (unsigned)atoi(value);
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    config.groups = std::min(config.groups, std::min(26, config.devices));
+
+    PropsSim sim(config);
+    return sim.run();
+}
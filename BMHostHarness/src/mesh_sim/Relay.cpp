@@ -0,0 +1,345 @@
+// Relay scenario: MeshRelay along a chain of props that only hear their neighbours.
+//
+// Props stand in clusters along a line, --per-hop at each spot, and a frame
+// only reaches the clusters on either side, so the two ends are --hops hops
+// apart. Every prop runs the real MeshRelay on its own virtual clock over a
+// lossy, jittery Medium. Every --interval ms a prop at one end floods a
+// scene-sized message; every third one is addressed to a single prop at the
+// far end instead of the whole group. The same traffic is then sent again
+// without the relay, as a baseline.
+//
+// Reported, per hop distance from the origin: the share of props that got
+// each message and how long it took, the latency each hop adds, and what the
+// flooding costs in frames and airtime.
+//
+// Usage:
+//   mesh_sim relay [options]
+//     --hops <n>           hops between the two ends (default 4)
+//     --per-hop <n>        props at each spot (default 3)
+//     --ttl <n>            relays after the origin's copy (default MESH_RELAY_DEFAULT_TTL)
+//     --interval <ms>      time between messages (default 100)
+//     --seconds <s>        simulated duration (default 30)
+//     --latency <us>       base one-way latency (default 1500)
+//     --jitter <us>        mean exponential jitter (default 1500)
+//     --loss <pct>         per-copy loss (default 5)
+//     --seed <n>           random seed
+//
+// Exits non-zero unless, with the relay, at least 99% of messages reach every
+// prop within the ttl and every hop adds under 40ms on average.
+
+#include <Arduino.h>
+#include <MeshRelay.h>
+#include "Airtime.h"
+#include "Medium.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#define RELAY_DELIVERY_TARGET 99.0      // percent, at every hop distance within the ttl
+#define RELAY_HOP_TARGET_MS 40.0        // mean latency each hop adds
+#define RELAY_PAYLOAD_SIZE 24           // A typical scene delta
+#define RELAY_GROUP ('A' << 8 | 'A')
+#define RELAY_DRAIN_US 1000000ULL       // No new messages this close to the end
+
+namespace {
+
+struct RelayConfig {
+    int hops = 4;
+    int perHop = 3;
+    int ttl = MESH_RELAY_DEFAULT_TTL;
+    double intervalMs = 100;
+    double seconds = 30;
+    MediumConfig medium;
+    unsigned seed = 1;
+};
+
+struct RelayNode {
+    uint8_t mac[6];
+    int spot;
+    double epochUs;     // Local time at true time zero
+    double drift;
+    MeshRelay relay;
+
+    uint64_t localAt(uint64_t trueUs) const { return (uint64_t)(epochUs + trueUs * (1.0 + drift)); }
+};
+
+struct Sent {
+    int origin;
+    int destination;    // -1 for the whole group
+    uint64_t trueUs;
+    std::vector<bool> got;
+};
+
+// Per hop distance from the origin
+struct HopResult {
+    unsigned long expected = 0;
+    unsigned long delivered = 0;
+    std::vector<double> latenciesMs;
+};
+
+struct RunResult {
+    std::vector<HopResult> hops;        // 0: the origin's own spot
+    HopResult unicast;                  // Messages for a single far prop
+    unsigned long messages = 0;
+    unsigned long frames = 0;
+    unsigned long relayed = 0;
+    unsigned long suppressed = 0;
+    unsigned long duplicates = 0;
+    unsigned long dropped = 0;
+    unsigned long overflows = 0;
+    double airUs = 0;
+};
+
+class RelaySim {
+public:
+    RelaySim(const RelayConfig& config, bool relay)
+        : config_(config), relay_(relay), rng_(config.seed),
+          medium_(config.medium, (config.hops + 1) * config.perHop, rng_) {
+        std::uniform_real_distribution<double> drift(-40e-6, 40e-6);
+        std::uniform_real_distribution<double> epoch(0, 600e6);
+        int total = (config.hops + 1) * config.perHop;
+
+        for (int i = 0; i < total; i++) {
+            nodes_.emplace_back(new RelayNode());
+            RelayNode& node = *nodes_.back();
+            Medium::macFor(i, node.mac);
+            node.spot = i / config.perHop;
+            node.epochUs = epoch(rng_);
+            node.drift = drift(rng_);
+            enter(i, 0);
+            node.relay.setSendFunction([this, i](const uint8_t* to, const uint8_t* data, size_t len) {
+                count(len);
+                return medium_.send(i, to, data, len, now_);
+            });
+            node.relay.onDeliver([this, i](const uint8_t*, const uint8_t* data, size_t len, const uint8_t*, uint8_t) {
+                deliver(i, data, len);
+            });
+            node.relay.setTtl((uint8_t)config.ttl);
+            node.relay.begin(node.mac, RELAY_GROUP);
+        }
+        // A line: each spot hears only the spots next to it
+        medium_.setRange([this](int a, int b) { return std::abs(nodes_[a]->spot - nodes_[b]->spot) <= 1; });
+    }
+
+    RunResult run() {
+        const uint64_t endUs = (uint64_t)(config_.seconds * 1e6);
+        const uint64_t intervalUs = (uint64_t)(config_.intervalMs * 1000);
+        uint64_t nextUs = intervalUs;
+
+        for (uint64_t t = 0; t <= endUs; t += 1000) {
+            now_ = t;
+            medium_.deliverUntil(t, [this](int to, int from, const uint8_t* data, size_t len, uint64_t trueUs) {
+                enter(to, trueUs);
+                if (relay_) {
+                    nodes_[to]->relay.handleMessage(nodes_[from]->mac, data, len);
+                } else {
+                    deliver(to, data, len);
+                }
+            });
+            if (relay_) {
+                for (size_t i = 0; i < nodes_.size(); i++) {
+                    enter(i, t);
+                    nodes_[i]->relay.update();
+                }
+            }
+            if (t >= nextUs && t + RELAY_DRAIN_US <= endUs) {
+                sendNext(t);
+                nextUs += intervalUs;
+            }
+        }
+        return collect();
+    }
+
+private:
+    void enter(size_t i, uint64_t trueUs) { HostTime::setMicros(nodes_[i]->localAt(trueUs)); }
+
+    int spotSize() const { return config_.perHop; }
+
+    // Alternates ends; every third message is for one prop at the far end
+    void sendNext(uint64_t t) {
+        uint32_t id = (uint32_t)sent_.size();
+        bool fromStart = id % 2 == 0;
+        int first = fromStart ? 0 : config_.hops * spotSize();
+        int farFirst = fromStart ? config_.hops * spotSize() : 0;
+        std::uniform_int_distribution<int> pick(0, spotSize() - 1);
+
+        Sent sent;
+        sent.origin = first + pick(rng_);
+        sent.destination = id % 3 == 2 ? farFirst + pick(rng_) : -1;
+        sent.trueUs = t;
+        sent.got.assign(nodes_.size(), false);
+        sent_.push_back(sent);
+
+        uint8_t payload[RELAY_PAYLOAD_SIZE] = {};
+        memcpy(payload, &id, sizeof(id));
+        static const uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+        const uint8_t* to = sent.destination < 0 ? broadcast : nodes_[sent.destination]->mac;
+        enter(sent.origin, t);
+        if (relay_) {
+            nodes_[sent.origin]->relay.send(to, payload, sizeof(payload));
+        } else {
+            // One broadcast to whoever is in range, unicasts included: the far end never is
+            count(sizeof(payload));
+            medium_.send(sent.origin, broadcast, payload, sizeof(payload), t);
+        }
+    }
+
+    void deliver(int node, const uint8_t* data, size_t len) {
+        uint32_t id;
+        if (len < sizeof(id)) return;
+        memcpy(&id, data, sizeof(id));
+        if (id >= sent_.size()) return;
+        Sent& sent = sent_[id];
+        if (sent.got[node] || (sent.destination >= 0 && sent.destination != node)) return;
+        sent.got[node] = true;
+        double ms = (now_ - sent.trueUs) / 1000.0;
+        HopResult& result = resultFor(sent, node);
+        result.delivered++;
+        result.latenciesMs.push_back(ms);
+    }
+
+    HopResult& resultFor(const Sent& sent, int node) {
+        if (sent.destination >= 0) return result_.unicast;
+        return result_.hops[std::abs(nodes_[node]->spot - nodes_[sent.origin]->spot)];
+    }
+
+    void count(size_t len) {
+        result_.frames++;
+        result_.airUs += airtime_.difsUs + airtime_.cwMin / 2.0 * airtime_.slotUs + airtime_.frameUs(len);
+    }
+
+    RunResult collect() {
+        result_.messages = sent_.size();
+        for (const Sent& sent : sent_) {
+            if (sent.destination >= 0) {
+                result_.unicast.expected++;
+                continue;
+            }
+            for (size_t i = 0; i < nodes_.size(); i++) {
+                if ((int)i != sent.origin) {
+                    result_.hops[std::abs(nodes_[i]->spot - nodes_[sent.origin]->spot)].expected++;
+                }
+            }
+        }
+        for (const auto& node : nodes_) {
+            const MeshRelayStats& stats = node->relay.getStats();
+            result_.relayed += stats.relayed;
+            result_.suppressed += stats.suppressed;
+            result_.duplicates += stats.duplicates;
+            result_.dropped += stats.dropped;
+            result_.overflows += stats.queue_overflows;
+        }
+        return result_;
+    }
+
+    const RelayConfig& config_;
+    bool relay_;
+    std::mt19937 rng_;
+    Medium medium_;
+    AirtimeModel airtime_;
+    std::vector<std::unique_ptr<RelayNode>> nodes_;
+    std::vector<Sent> sent_;
+    RunResult result_ = initialResult();
+    uint64_t now_ = 0;
+
+    RunResult initialResult() const {
+        RunResult result;
+        result.hops.resize(config_.hops + 1);
+        return result;
+    }
+};
+
+double ratio(const HopResult& result) { return result.expected ? 100.0 * result.delivered / result.expected : 0; }
+
+int report(const RelayConfig& config, const RunResult& flooded, const RunResult& direct) {
+    double seconds = config.seconds;
+    int reach = std::min(config.hops, config.ttl + 1);
+
+    printf("\n--- Mesh relay (%d hops, %d props per spot, %.0f s simulated) ---\n", config.hops, config.perHop,
+           seconds);
+    printf("Link:                    %.0f us + exp(%.0f us) jitter, %.1f%% loss; neighbouring spots only\n",
+           config.medium.latencyUs, config.medium.jitterUs, config.medium.lossPercent);
+    printf("Relay:                   ttl %d, %d + up to %d ms backoff, cancelled after %d copies\n", config.ttl,
+           MESH_RELAY_MIN_DELAY, MESH_RELAY_JITTER, MESH_RELAY_SUPPRESS_COPIES);
+    printf("Messages:                %lu, every %.0f ms from alternating ends\n", flooded.messages,
+           config.intervalMs);
+    printf("  %-6s %22s %34s\n", "hops", "without relay", "with relay");
+    for (int hop = 0; hop <= config.hops; hop++) {
+        const HopResult& without = direct.hops[hop];
+        const HopResult& with = flooded.hops[hop];
+        if (with.expected == 0) continue;
+        printf("  %-6d %6.1f%% delivered        %6.1f%% delivered, mean %5.1f ms, p99 %5.1f ms\n", hop,
+               ratio(without), ratio(with), mean(with.latenciesMs), percentile(with.latenciesMs, 0.99));
+    }
+    printf("  %-6s %6.1f%% delivered        %6.1f%% delivered, mean %5.1f ms, p99 %5.1f ms\n", "to one",
+           ratio(direct.unicast), ratio(flooded.unicast), mean(flooded.unicast.latenciesMs),
+           percentile(flooded.unicast.latenciesMs, 0.99));
+
+    double perHopMs = 0;
+    if (reach > 1) {
+        perHopMs = (mean(flooded.hops[reach].latenciesMs) - mean(flooded.hops[1].latenciesMs)) / (reach - 1);
+        printf("Added latency:           %.1f ms per hop\n", perHopMs);
+    }
+    printf("Cost:                    %.1f frames per message (%.1f without), ~%.2f%% airtime (%.2f%% without)\n",
+           (double)flooded.frames / std::max(1UL, flooded.messages),
+           (double)direct.frames / std::max(1UL, direct.messages), 100.0 * flooded.airUs / (seconds * 1e6),
+           100.0 * direct.airUs / (seconds * 1e6));
+    printf("Relays:                  %lu sent, %lu suppressed, %lu duplicate copies; %lu dropped with the pending "
+           "list full, %lu frames with the queue full\n",
+           flooded.relayed, flooded.suppressed, flooded.duplicates, flooded.dropped, flooded.overflows);
+
+    double worst = 100;
+    for (int hop = 0; hop <= reach; hop++) {
+        if (flooded.hops[hop].expected) worst = std::min(worst, ratio(flooded.hops[hop]));
+    }
+    if (reach == config.hops) worst = std::min(worst, ratio(flooded.unicast));
+    bool ok = worst >= RELAY_DELIVERY_TARGET && perHopMs <= RELAY_HOP_TARGET_MS;
+    printf("%s: %s (target: %.0f%% delivered within the ttl, under %.0f ms per hop)\n", ok ? "PASS" : "FAIL",
+           ok ? "every hop covered" : "target missed", RELAY_DELIVERY_TARGET, RELAY_HOP_TARGET_MS);
+    return ok ? 0 : 1;
+}
+
+void printUsage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s relay [--hops n] [--per-hop n] [--ttl n] [--interval ms] [--seconds s] [--latency us] "
+            "[--jitter us] [--loss pct] [--seed n]\n",
+            argv0);
+}
+
+} // namespace
+
+int runRelay(int argc, char** argv) {
+    RelayConfig config;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--hops") config.hops = std::max(1, atoi(value));
+        else if (arg == "--per-hop") config.perHop = std::max(1, atoi(value));
+        else if (arg == "--ttl") config.ttl = std::max(0, std::min(255, atoi(value)));
+        else if (arg == "--interval") config.intervalMs = std::max(1.0, atof(value));
+        else if (arg == "--seconds") config.seconds = atof(value);
+        else if (arg == "--latency") config.medium.latencyUs = atof(value);
+        else if (arg == "--jitter") config.medium.jitterUs = atof(value);
+        else if (arg == "--loss") config.medium.lossPercent = atof(value);
+        else if (arg == "--seed") config.seed = (unsigned)atoi(value);
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    RunResult flooded = RelaySim(config, true).run();
+    RunResult direct = RelaySim(config, false).run();
+    return report(config, flooded, direct);
+}
@@ -0,0 +1,26 @@
+#ifndef MESH_SIM_SCENARIOS_H
+#define MESH_SIM_SCENARIOS_H
+
+#include <string>
+#include <vector>
+
+// Each scenario parses its own options from argv[2] on and returns the exit code
+int runFanout(int argc, char** argv);
+int runDiscovery(int argc, char** argv);
+int runDial(int argc, char** argv);
+int runProps(int argc, char** argv);
+int runElection(int argc, char** argv);
+int runRelay(int argc, char** argv);
+int runStream(int argc, char** argv);
+int runUdp(int argc, char** argv);
+int runCoexist(int argc, char** argv);
+
+// "5,20,50" -> {5, 20, 50}; every value must be at least minimum
+bool parseList(const std::string& text, std::vector<int>& values, int minimum);
+
+// The value a fraction p (0.99 for the 99th percentile, 1.0 for the max) of
+// values are at or below; 0 for none
+double percentile(std::vector<double> values, double p);
+double mean(const std::vector<double>& values);
+
+#endif // MESH_SIM_SCENARIOS_H
@@ -0,0 +1,340 @@
+// Stream scenario: a master renders, fixtures only display (PixelStream).
+//
+// One master runs a LightShow through a series of effects and broadcasts
+// every rendered frame with PixelStreamSender over a lossy, jittery Medium.
+// Each fixture runs a PixelStreamReceiver that decodes its own share of the
+// pixels straight into its array, the way the BMFloodLights slaves do. A
+// shadow receiver that gets every slice checks that each frame decodes back
+// to exactly what was rendered.
+//
+// Reported, per effect: bytes per frame against raw pixels, the encodings the
+// slices went out with, host time to encode a frame and to decode a slice, the
+// share of frames each fixture showed exactly as rendered, and the longest a
+// fixture showed anything else (a lost keyframe is only repaired by the
+// next one).
+//
+// Usage:
+//   mesh_sim stream [options]
+//     --leds <n>           pixels per frame (default 24, three strips of floods)
+//     --fixtures <n>       fixtures sharing them (default 3)
+//     --fps <n>            frames per second (default 25)
+//     --speed <ms>         effect speed (default 100; the floods run at 1000)
+//     --keyframe <n>       frames between keyframes of a slice (default PIXEL_STREAM_KEYFRAME_INTERVAL)
+//     --seconds <s>        simulated time per effect (default 10)
+//     --latency <us>       base one-way latency (default 1500)
+//     --jitter <us>        mean exponential jitter (default 1500)
+//     --loss <pct>         per-copy loss (default 5)
+//     --seed <n>           random seed
+//
+// Exits non-zero if a frame does not decode to what was rendered, if any
+// effect needs as many bytes as raw pixels, or if a fixture shows a wrong
+// frame for longer than two keyframe intervals.
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <LightShow.h>
+#include <PixelStream.h>
+#include "Airtime.h"
+#include "Medium.h"
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#define STREAM_GROUP ('F' << 8 | 'L')
+
+namespace {
+
+typedef std::chrono::steady_clock HostClock;
+
+struct StreamConfig {
+    int leds = 24;
+    int fixtures = 3;
+    int fps = 25;
+    uint16_t speed = 100;
+    int keyframeInterval = PIXEL_STREAM_KEYFRAME_INTERVAL;
+    double seconds = 10;
+    MediumConfig medium;
+    unsigned seed = 1;
+};
+
+struct Effect {
+    const char* name;
+    std::function<void(LightShow& show, uint16_t speed)> start;
+};
+
+// What the floods cycle through, plus a few busier ones
+const Effect EFFECTS[] = {
+    {"solid", [](LightShow& show, uint16_t) { show.solid(CRGB(255, 120, 20)); }},
+    {"breathe", [](LightShow& show, uint16_t speed) { show.breathe(speed / 10 + 1, 100, CRGB::OrangeRed); }},
+    {"palette_stream", [](LightShow& show, uint16_t speed) { show.palette_stream(speed, AvailablePalettes::sunset); }},
+    {"fire_plasma", [](LightShow& show, uint16_t speed) { show.fire_plasma(speed, 50, AvailablePalettes::flame); }},
+    {"plasma_clouds", [](LightShow& show, uint16_t speed) { show.plasma_clouds(speed, 30, AvailablePalettes::sunset); }},
+    {"lava_lamp", [](LightShow& show, uint16_t speed) { show.lava_lamp(speed, 3, AvailablePalettes::lava); }},
+    {"aurora_borealis", [](LightShow& show, uint16_t speed) { show.aurora_borealis(speed, 3, AvailablePalettes::emerald); }},
+    {"sparkle", [](LightShow& show, uint16_t speed) { show.sparkle(speed, 40, CRGB::White); }},
+    {"rainbow_comet", [](LightShow& show, uint16_t speed) { show.rainbow_comet(speed, 2, 8); }},
+};
+
+// Stands in for the master's strips: keeps the last frame the show rendered
+class CaptureController : public CLEDController {
+public:
+    explicit CaptureController(int leds) : pixels_(leds), frame_(leds) { setLeds(pixels_.data(), leds); }
+
+    void init() override {}
+    void showColor(const CRGB& color, int nLeds, uint8_t) override { frame_.assign(nLeds, color); }
+    void show(const CRGB* data, int nLeds, uint8_t) override { frame_.assign(data, data + nLeds); }
+
+    const std::vector<CRGB>& frame() const { return frame_; }
+
+private:
+    std::vector<CRGB> pixels_;
+    std::vector<CRGB> frame_;
+};
+
+struct Fixture {
+    int first;
+    std::vector<CRGB> leds;
+    PixelStreamReceiver receiver;
+    int wrongFrames = 0;        // Current run of frames not shown as rendered
+};
+
+struct EffectResult {
+    const char* name;
+    unsigned long frames = 0;
+    unsigned long bytes = 0;
+    unsigned long slices = 0;
+    unsigned long encodings[PIXEL_ENCODING_COUNT] = {};
+    unsigned long exact = 0;        // Fixture frames shown as rendered
+    unsigned long shown = 0;
+    int longestWrong = 0;           // Frames
+    unsigned long codecErrors = 0;
+    double encodeNs = 0;
+    double decodeNs = 0;
+    unsigned long decoded = 0;      // Slices the fixtures decoded
+    double airUs = 0;
+};
+
+class StreamSim {
+public:
+    explicit StreamSim(const StreamConfig& config)
+        : config_(config), rng_(config.seed), medium_(config.medium, config.fixtures + 1, rng_),
+          capture_(config.leds), show_(std::vector<CLEDController*>{&capture_}, clock_), shadowLeds_(config.leds) {
+        sender_.setSendFunction([this](const uint8_t*, const uint8_t* data, size_t len) {
+            outbox_.emplace_back(data, data + len);
+            return true;
+        });
+        sender_.setKeyframeInterval((uint8_t)config.keyframeInterval);
+        sender_.begin(STREAM_GROUP);
+        shadow_.begin(shadowLeds_.data(), config.leds, STREAM_GROUP);
+
+        // Consecutive shares; the last fixture takes what is left
+        int share = config.leds / config.fixtures;
+        for (int i = 0; i < config.fixtures; i++) {
+            fixtures_.emplace_back(new Fixture());
+            Fixture& fixture = *fixtures_.back();
+            fixture.first = i * share;
+            int count = i + 1 < config.fixtures ? share : config.leds - fixture.first;
+            fixture.leds.assign(count, CRGB::Black);
+            fixture.receiver.begin(fixture.leds.data(), count, STREAM_GROUP, fixture.first);
+        }
+    }
+
+    std::vector<EffectResult> run() {
+        std::vector<EffectResult> results;
+        const uint64_t frameUs = 1000000ULL / config_.fps;
+        const uint64_t effectUs = (uint64_t)(config_.seconds * 1e6);
+        uint64_t t = 0;
+
+        for (const Effect& effect : EFFECTS) {
+            results.emplace_back();
+            EffectResult& result = results.back();
+            result.name = effect.name;
+            HostTime::setMicros(t);
+            effect.start(show_, config_.speed);
+
+            const uint64_t endUs = t + effectUs;
+            uint64_t nextFrameUs = t;
+            for (; t < endUs; t += 1000) {
+                medium_.deliverUntil(t, [this](int to, int, const uint8_t* data, size_t len, uint64_t) {
+                    fixtures_[to - 1]->receiver.handleMessage(nullptr, data, len);
+                });
+                for (auto& fixture : fixtures_) {
+                    HostClock::time_point started = HostClock::now();
+                    PixelStreamReceiverStats before = fixture->receiver.getStats();
+                    fixture->receiver.update();
+                    unsigned long slices = fixture->receiver.getStats().slices - before.slices;
+                    if (slices) {
+                        result.decodeNs += std::chrono::duration<double, std::nano>(HostClock::now() - started).count();
+                        result.decoded += slices;
+                    }
+                }
+                if (t >= nextFrameUs) {
+                    // What the fixtures show of the previous frame, just before the next
+                    if (!lastFrame_.empty()) compareFixtures(result);
+                    sendFrame(t, result);
+                    nextFrameUs += frameUs;
+                }
+            }
+        }
+        return results;
+    }
+
+private:
+    void sendFrame(uint64_t t, EffectResult& result) {
+        HostTime::setMicros(t);
+        show_.render();
+        lastFrame_ = capture_.frame();
+
+        HostClock::time_point started = HostClock::now();
+        sender_.sendFrame(lastFrame_.data(), (uint16_t)lastFrame_.size());
+        result.encodeNs += std::chrono::duration<double, std::nano>(HostClock::now() - started).count();
+        result.frames++;
+
+        for (const std::vector<uint8_t>& message : outbox_) {
+            result.slices++;
+            result.bytes += message.size();
+            result.encodings[message[11]]++;
+            result.airUs += airtime_.difsUs + airtime_.cwMin / 2.0 * airtime_.slotUs + airtime_.frameUs(message.size());
+            shadow_.handleMessage(nullptr, message.data(), message.size());
+            medium_.send(0, BROADCAST, message.data(), message.size(), t);
+        }
+        outbox_.clear();
+
+        // Every slice arrived: the frame must come back exactly
+        shadow_.update();
+        if (!std::equal(lastFrame_.begin(), lastFrame_.end(), shadowLeds_.begin())) {
+            result.codecErrors++;
+        }
+    }
+
+    void compareFixtures(EffectResult& result) {
+        for (auto& fixture : fixtures_) {
+            bool exact = std::equal(fixture->leds.begin(), fixture->leds.end(), lastFrame_.begin() + fixture->first);
+            result.shown++;
+            if (exact) {
+                result.exact++;
+                fixture->wrongFrames = 0;
+            } else {
+                fixture->wrongFrames++;
+                result.longestWrong = std::max(result.longestWrong, fixture->wrongFrames);
+            }
+        }
+    }
+
+    static const uint8_t BROADCAST[6];
+
+    const StreamConfig& config_;
+    std::mt19937 rng_;
+    Medium medium_;
+    AirtimeModel airtime_;
+    Clock clock_;
+    CaptureController capture_;
+    LightShow show_;
+    PixelStreamSender sender_;
+    PixelStreamReceiver shadow_;
+    std::vector<CRGB> shadowLeds_;
+    std::vector<std::unique_ptr<Fixture>> fixtures_;
+    std::vector<std::vector<uint8_t>> outbox_;
+    std::vector<CRGB> lastFrame_;
+};
+
+const uint8_t StreamSim::BROADCAST[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+int report(const StreamConfig& config, const std::vector<EffectResult>& results) {
+    const char* names[PIXEL_ENCODING_COUNT] = {"", "raw", "palette", "rle", "sparse", "nibble"};
+    double rawBytes = PIXEL_STREAM_HEADER_SIZE * ((config.leds + PIXEL_STREAM_SLICE_PIXELS - 1) / PIXEL_STREAM_SLICE_PIXELS) +
+                      3.0 * config.leds;
+
+    printf("\n--- Pixel stream (%d leds, %d fixtures, %d fps, speed %u, %.0f s per effect) ---\n", config.leds,
+           config.fixtures, config.fps, config.speed, config.seconds);
+    printf("Link:                    %.0f us + exp(%.0f us) jitter, %.1f%% loss\n", config.medium.latencyUs,
+           config.medium.jitterUs, config.medium.lossPercent);
+    printf("Keyframes:               every %d frames per slice; raw frames would be %.0f bytes\n",
+           config.keyframeInterval, rawBytes);
+    printf("  %-16s %8s %7s %8s %9s %8s %8s  %s\n", "effect", "bytes", "of raw", "airtime", "encode", "decode",
+           "exact", "longest wrong");
+
+    bool codecOk = true;
+    bool smaller = true;
+    bool recovered = true;
+    double totalBytes = 0;
+    unsigned long totalFrames = 0;
+    for (const EffectResult& result : results) {
+        double bytesPerFrame = (double)result.bytes / std::max(1UL, result.frames);
+        double exact = result.shown ? 100.0 * result.exact / result.shown : 0;
+        printf("  %-16s %8.1f %6.0f%% %7.2f%% %6.2f us %5.2f us %7.1f%%  %d frames (%.0f ms)\n", result.name,
+               bytesPerFrame, 100.0 * bytesPerFrame / rawBytes, 100.0 * result.airUs / (config.seconds * 1e6),
+               result.encodeNs / std::max(1UL, result.frames) / 1000.0,
+               result.decodeNs / std::max(1UL, result.decoded) / 1000.0, exact, result.longestWrong,
+               result.longestWrong * 1000.0 / config.fps);
+        printf("  %-16s", "");
+        for (int e = PIXEL_ENCODING_RAW; e < PIXEL_ENCODING_COUNT; e++) {
+            if (result.encodings[e]) {
+                printf(" %s %.0f%%", names[e], 100.0 * result.encodings[e] / std::max(1UL, result.slices));
+            }
+        }
+        printf("\n");
+
+        codecOk = codecOk && result.codecErrors == 0;
+        smaller = smaller && bytesPerFrame < rawBytes;
+        recovered = recovered && result.longestWrong <= 2 * config.keyframeInterval;
+        totalBytes += result.bytes;
+        totalFrames += result.frames;
+    }
+    printf("Overall:                 %.1f bytes per frame (%.0f%% of raw)\n", totalBytes / std::max(1UL, totalFrames),
+           100.0 * totalBytes / std::max(1UL, totalFrames) / rawBytes);
+    if (!codecOk) printf("Codec:                   frames that did not decode to what was rendered\n");
+
+    bool ok = codecOk && smaller && recovered;
+    printf("%s: %s (target: every frame decodes exactly, below raw size, wrong for at most %d frames)\n",
+           ok ? "PASS" : "FAIL", ok ? "every effect streamed" : "target missed", 2 * config.keyframeInterval);
+    return ok ? 0 : 1;
+}
+
+void printUsage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s stream [--leds n] [--fixtures n] [--fps n] [--speed ms] [--keyframe n] [--seconds s] "
+            "[--latency us] [--jitter us] [--loss pct] [--seed n]\n",
+            argv0);
+}
+
+} // namespace
+
+int runStream(int argc, char** argv) {
+    StreamConfig config;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--leds") config.leds = std::max(1, std::min(PIXEL_STREAM_MAX_PIXELS, atoi(value)));
+        else if (arg == "--fixtures") config.fixtures = std::max(1, atoi(value));
+        else if (arg == "--fps") config.fps = std::max(1, std::min(1000, atoi(value)));
+        else if (arg == "--speed") config.speed = (uint16_t)std::max(1, std::min(65535, atoi(value)));
+        else if (arg == "--keyframe") config.keyframeInterval = std::max(1, std::min(255, atoi(value)));
+        else if (arg == "--seconds") config.seconds = atof(value);
+        else if (arg == "--latency") config.medium.latencyUs = atof(value);
+        else if (arg == "--jitter") config.medium.jitterUs = atof(value);
+        else if (arg == "--loss") config.medium.lossPercent = atof(value);
+        else if (arg == "--seed") config.seed = (unsigned)atoi(value);
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    config.fixtures = std::min(config.fixtures, config.leds);
+
+    std::vector<EffectResult> results = StreamSim(config).run();
+    return report(config, results);
+}
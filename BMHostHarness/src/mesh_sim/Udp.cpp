@@ -0,0 +1,426 @@
+// UDP scenario: the multicast transport over real sockets on loopback.
+//
+// Two parts. The first drives UdpMulticastTransport directly: every node
+// sends a burst of scene-sized messages each tick, and one node (the master)
+// also a frame of pixel-stream-sized slices, while all of them poll their
+// sockets between ticks the way loop() would. It runs once with batching and
+// once with every message in its own datagram, in real time.
+//
+// The second runs complete props (SyncController + LightShow) with
+// setTransport() pointing them at a UdpMulticastTransport instead of ESP-NOW:
+// discovery, leader election, clock sync and scene sync all over the same
+// sockets. Time is simulated as in the props scenario; the sockets deliver
+// whatever was sent before the next device polls.
+//
+// Reported: messages, datagrams and bytes per second, loss, latency from
+// send() to the receive callback (mean, 99th percentile, max), host CPU time
+// per message spent sending (send() and flush(); the receive side is hidden
+// in the polling loop); then scene convergence and clock lock of the props.
+//
+// Usage:
+//   mesh_sim udp [options]
+//     --nodes <n>          transports in the benchmark (default 4)
+//     --rate <n>           ticks per second (default 500)
+//     --messages <n>       scene messages per node per tick (default 4)
+//     --size <bytes>       scene message size (default 40)
+//     --slices <n>         pixel slices the master adds per tick (default 3)
+//     --seconds <s>        real time per benchmark run (default 2)
+//     --props <n>          props in the end-to-end part (default 8)
+//     --prop-seconds <s>   its simulated duration (default 30)
+//     --port <n>           UDP port on 127.0.0.1 (default 42100)
+//     --seed <n>           random seed
+//
+// Exits non-zero if the benchmark loses messages, if its p99 latency reaches
+// 5 ms, if batching doesn't at least halve the datagrams, or if a prop's scene
+// change takes over 1s to converge or a follower never locks its clock.
+
+#include <Arduino.h>
+#include <HostEspNow.h>
+#include <SyncController.h>
+#include <UdpMulticastTransport.h>
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#define UDP_GROUP "239.66.77.1"
+#define UDP_INTERFACE "127.0.0.1"
+#define UDP_LATENCY_TARGET_US 5000
+#define UDP_CONVERGENCE_TARGET_MS 1000
+#define UDP_PROPS_LEDS 60
+#define UDP_PROPS_STEP_US 1000ULL
+#define UDP_PROPS_FRAME_US 20000ULL
+#define UDP_PROPS_WARMUP_US 5000000ULL
+#define UDP_PROPS_CHANGE_US 2000000ULL
+
+namespace {
+
+typedef std::chrono::steady_clock HostClock;
+
+struct UdpConfig {
+    int nodes = 4;
+    int rate = 500;
+    int messages = 4;
+    int size = 40;
+    int slices = 3;
+    double seconds = 2;
+    int props = 8;
+    double propSeconds = 30;
+    uint16_t port = 42100;
+    unsigned seed = 1;
+};
+
+const uint8_t BROADCAST[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+uint64_t hostNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(HostClock::now().time_since_epoch()).count();
+}
+
+uint64_t cpuNs() {
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void nodeMac(int i, uint8_t mac[6]) {
+    const uint8_t base[6] = {0x24, 0x0A, 0xC4, 0x55, 0x00, 0x00};
+    memcpy(mac, base, 6);
+    mac[4] = (uint8_t)(i >> 8);
+    mac[5] = (uint8_t)i;
+}
+
+struct BenchResult {
+    bool batching = false;
+    unsigned long sent = 0;         // Messages, times the receivers that should get them
+    unsigned long delivered = 0;
+    unsigned long duplicates = 0;
+    unsigned long datagrams = 0;
+    unsigned long bytes = 0;
+    unsigned long sendErrors = 0;
+    double seconds = 0;
+    double sendCpuNs = 0;
+    std::vector<double> latenciesUs;
+};
+
+// Message payload: sender index, sequence and send time, padded to size
+class Bench {
+public:
+    Bench(const UdpConfig& config, bool batching) : config_(config) {
+        result_.batching = batching;
+        for (int i = 0; i < config.nodes; i++) {
+            std::unique_ptr<UdpMulticastTransport> transport(new UdpMulticastTransport(UDP_GROUP, config.port));
+            uint8_t mac[6];
+            nodeMac(i, mac);
+            transport->setMac(mac);
+            transport->setInterface(UDP_INTERFACE);
+            transport->setLoopback(true);
+            transport->setBatching(batching);
+            transport->onReceive([this, i](const uint8_t*, const uint8_t* data, size_t len) { receive(i, data, len); });
+            transports_.push_back(std::move(transport));
+        }
+        nextSequence_.assign(config.nodes, 0);
+        seen_.assign(config.nodes, std::vector<std::vector<bool>>(config.nodes));
+    }
+
+    bool run(BenchResult& result) {
+        for (auto& transport : transports_) {
+            if (!transport->begin() || !transport->isOpen()) return false;
+        }
+        uint64_t tickNs = 1000000000ULL / config_.rate;
+        uint64_t startNs = hostNs();
+        uint64_t endNs = startNs + (uint64_t)(config_.seconds * 1e9);
+        uint64_t nextTickNs = startNs;
+        while (hostNs() < endNs) {
+            if (hostNs() >= nextTickNs) {
+                uint64_t startCpu = cpuNs();
+                tick();
+                result_.sendCpuNs += (double)(cpuNs() - startCpu);
+                nextTickNs += tickNs;
+            }
+            for (auto& transport : transports_) transport->update();
+        }
+        // Whatever is still in flight
+        uint64_t drainNs = hostNs() + 50000000ULL;
+        while (hostNs() < drainNs) {
+            for (auto& transport : transports_) transport->update();
+        }
+        result_.seconds = config_.seconds;
+        for (auto& transport : transports_) {
+            const UdpMulticastStats& stats = transport->getStats();
+            result_.datagrams += stats.datagrams_sent;
+            result_.bytes += stats.bytes_sent;
+            result_.sendErrors += stats.send_errors;
+        }
+        result = result_;
+        return true;
+    }
+
+private:
+    void tick() {
+        for (int i = 0; i < config_.nodes; i++) {
+            for (int m = 0; m < config_.messages; m++) send(i, config_.size);
+            if (i == 0) {
+                for (int s = 0; s < config_.slices; s++) send(i, UDP_SYNC_MAX_MESSAGE);
+            }
+            // Where SyncController::update() flushes
+            transports_[i]->flush();
+        }
+    }
+
+    void send(int i, int size) {
+        uint8_t message[UDP_SYNC_MAX_MESSAGE] = {};
+        uint32_t sequence = nextSequence_[i]++;
+        uint64_t now = hostNs();
+        message[0] = (uint8_t)i;
+        memcpy(message + 1, &sequence, 4);
+        memcpy(message + 5, &now, 8);
+        if (transports_[i]->send(BROADCAST, message, std::max(13, size))) {
+            result_.sent += config_.nodes - 1;
+        }
+    }
+
+    void receive(int at, const uint8_t* data, size_t len) {
+        if (len < 13) return;
+        uint64_t sentNs;
+        uint32_t sequence;
+        int from = data[0];
+        memcpy(&sequence, data + 1, 4);
+        memcpy(&sentNs, data + 5, 8);
+        std::vector<bool>& seen = seen_[at][from];
+        if (sequence >= seen.size()) seen.resize(sequence + 1024, false);
+        if (seen[sequence]) {
+            result_.duplicates++;
+            return;
+        }
+        seen[sequence] = true;
+        result_.delivered++;
+        result_.latenciesUs.push_back((hostNs() - sentNs) / 1000.0);
+    }
+
+    const UdpConfig& config_;
+    std::vector<std::unique_ptr<UdpMulticastTransport>> transports_;
+    std::vector<uint32_t> nextSequence_;
+    std::vector<std::vector<std::vector<bool>>> seen_;    // [receiver][sender][sequence]
+    BenchResult result_;
+};
+
+// A LightShow output that keeps nothing; the props part only compares scenes
+class NullController : public CLEDController {
+public:
+    NullController() : pixels_(UDP_PROPS_LEDS) { setLeds(pixels_.data(), UDP_PROPS_LEDS); }
+    void init() override {}
+    void showColor(const CRGB&, int, uint8_t) override {}
+    void show(const CRGB*, int, uint8_t) override {}
+
+private:
+    std::vector<CRGB> pixels_;
+};
+
+struct UdpProp {
+    UdpProp(const uint8_t address[6], uint16_t port)
+        : radio(address), transport(UDP_GROUP, port), show(std::vector<CLEDController*>{&output}, clock),
+          controller(show, "UD", device) {
+        memcpy(mac, address, 6);
+        transport.setMac(address);
+        transport.setInterface(UDP_INTERFACE);
+        transport.setLoopback(true);
+        controller.setTransport(transport);
+    }
+
+    uint8_t mac[6];
+    HostRadio radio;        // Never initialized; only answers esp_wifi_get_mac()
+    UdpMulticastTransport transport;
+    Device device = Device::backpack;
+    Clock clock;
+    NullController output;
+    LightShow show;
+    SyncController controller;
+};
+
+struct PropsResult {
+    std::vector<double> latenciesMs;
+    int changes = 0;
+    int unconverged = 0;
+    int followers = 0;
+    int locked = 0;
+    int leaders = 0;
+    unsigned long datagrams = 0;
+    unsigned long messages = 0;
+    bool opened = true;
+};
+
+PropsResult runUdpProps(const UdpConfig& config) {
+    PropsResult result;
+    std::mt19937 rng(config.seed);
+    std::vector<std::unique_ptr<UdpProp>> props;
+    for (int i = 0; i < config.props; i++) {
+        uint8_t mac[6];
+        nodeMac(0x100 + i, mac);
+        props.emplace_back(new UdpProp(mac, config.port + 1));
+    }
+    auto enter = [&](int i, uint64_t t) {
+        HostTime::setMicros(t);
+        HostEspNow::setRadio(&props[i]->radio);
+    };
+
+    for (int i = 0; i < config.props; i++) {
+        enter(i, 0);
+        props[i]->show.palette_stream(100, AvailablePalettes::cool);
+        props[i]->show.brightness(25);
+        props[i]->controller.begin("UD");
+        props[i]->controller.enableClockSync(props[i]->clock, false);
+        result.opened = result.opened && props[i]->transport.isOpen();
+    }
+
+    auto agrees = [&]() {
+        const LightScene first = props[0]->show.getCurrentScene();
+        for (auto& prop : props) {
+            if (SyncProtocol::diffScene(first, prop->show.getCurrentScene()) != 0) return false;
+        }
+        return true;
+    };
+
+    uint64_t endUs = (uint64_t)(config.propSeconds * 1e6);
+    uint64_t changeUs = 0;
+    bool pending = false;
+    for (uint64_t t = UDP_PROPS_STEP_US; t <= endUs; t += UDP_PROPS_STEP_US) {
+        // The last change still gets a full interval to converge
+        if (t >= UDP_PROPS_WARMUP_US && t + UDP_PROPS_CHANGE_US <= endUs && t % UDP_PROPS_CHANGE_US == 0) {
+            if (pending) result.unconverged++;
+            int i = std::uniform_int_distribution<int>(0, config.props - 1)(rng);
+            enter(i, t);
+            if (rng() % 2) {
+                props[i]->controller.setBrightness((uint8_t)std::uniform_int_distribution<int>(10, 150)(rng));
+            } else {
+                props[i]->controller.setPalette((AvailablePalettes)std::uniform_int_distribution<int>(0, SYNC_LAST_PALETTE)(rng));
+            }
+            result.changes++;
+            changeUs = t;
+            pending = true;
+        }
+        for (int i = 0; i < config.props; i++) {
+            enter(i, t);
+            props[i]->controller.update();
+            if (t % UDP_PROPS_FRAME_US == 0) props[i]->show.render();
+        }
+        if (pending && agrees()) {
+            result.latenciesMs.push_back((t - changeUs) / 1000.0);
+            pending = false;
+        }
+    }
+    if (pending) result.unconverged++;
+
+    for (auto& prop : props) {
+        if (prop->controller.isLeader()) {
+            result.leaders++;
+        } else {
+            result.followers++;
+            if (prop->controller.isClockSynced()) result.locked++;
+        }
+        result.datagrams += prop->transport.getStats().datagrams_sent;
+        result.messages += prop->transport.getStats().messages_sent;
+    }
+    return result;
+}
+
+int report(const UdpConfig& config, const BenchResult results[2], const PropsResult& props) {
+    printf("\n--- UDP multicast transport (%d nodes on loopback, %d ticks/s, %.0f s per run) ---\n", config.nodes,
+           config.rate, config.seconds);
+    printf("Per tick:                %d x %d-byte messages per node, plus %d x %d-byte slices from the master\n",
+           config.messages, config.size, config.slices, UDP_SYNC_MAX_MESSAGE);
+    printf("  %-10s %10s %11s %10s %7s %9s %9s %9s %10s\n", "mode", "msgs/s", "datagrams/s", "KB/s", "loss",
+           "latency", "p99", "max", "send cpu");
+
+    bool delivered = true;
+    bool fast = true;
+    for (int r = 0; r < 2; r++) {
+        const BenchResult& result = results[r];
+        double lossPercent = result.sent ? 100.0 * (result.sent - std::min(result.sent, result.delivered)) / result.sent : 0;
+        double p99 = percentile(result.latenciesUs, 0.99);
+        printf("  %-10s %10.0f %11.0f %10.1f %6.2f%% %6.0f us %6.0f us %6.0f us %7.2f us\n",
+               result.batching ? "batched" : "unbatched", result.delivered / result.seconds,
+               result.datagrams / result.seconds, result.bytes / result.seconds / 1024.0, lossPercent,
+               mean(result.latenciesUs), p99, percentile(result.latenciesUs, 1.0),
+               result.sendCpuNs * (config.nodes - 1) / std::max(1UL, result.sent) / 1000.0);
+        if (result.duplicates || result.sendErrors) {
+            printf("  %-10s %lu duplicates, %lu datagrams refused by the socket\n", "", result.duplicates,
+                   result.sendErrors);
+        }
+        delivered = delivered && result.sent > 0 && result.delivered == result.sent && result.duplicates == 0;
+        fast = fast && p99 < UDP_LATENCY_TARGET_US;
+    }
+    bool batched = results[0].datagrams * 2 <= results[1].datagrams;
+    printf("Batching:                %.1f messages per datagram (%.1f without)\n",
+           (double)results[0].sent / (config.nodes - 1) / std::max(1UL, results[0].datagrams),
+           (double)results[1].sent / (config.nodes - 1) / std::max(1UL, results[1].datagrams));
+
+    printf("\n--- Props over UDP (%d props, %.0f s simulated) ---\n", config.props, config.propSeconds);
+    printf("Convergence:             %zu/%d changes, mean %.0f ms, max %.0f ms\n", props.latenciesMs.size(),
+           props.changes, mean(props.latenciesMs), percentile(props.latenciesMs, 1.0));
+    printf("Leadership:              %d leader(s), %d/%d followers clock-locked\n", props.leaders, props.locked,
+           props.followers);
+    printf("Traffic:                 %lu messages in %lu datagrams\n", props.messages, props.datagrams);
+
+    bool converged = props.opened && props.changes > 0 && props.unconverged == 0 &&
+                     percentile(props.latenciesMs, 1.0) <= UDP_CONVERGENCE_TARGET_MS && props.leaders == 1 &&
+                     props.locked == props.followers;
+    bool ok = delivered && fast && batched && converged;
+    printf("%s: %s (target: no loss, p99 under %d us, batching halves datagrams, props converge within %d ms and lock)\n",
+           ok ? "PASS" : "FAIL", ok ? "transport and props met their targets" : "target missed", UDP_LATENCY_TARGET_US,
+           UDP_CONVERGENCE_TARGET_MS);
+    return ok ? 0 : 1;
+}
+
+void printUsage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s udp [--nodes n] [--rate n] [--messages n] [--size bytes] [--slices n] [--seconds s] "
+            "[--props n] [--prop-seconds s] [--port n] [--seed n]\n",
+            argv0);
+}
+
+} // namespace
+
+int runUdp(int argc, char** argv) {
+    UdpConfig config;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--nodes") config.nodes = std::max(2, std::min(255, atoi(value)));
+        else if (arg == "--rate") config.rate = std::max(1, atoi(value));
+        else if (arg == "--messages") config.messages = std::max(0, atoi(value));
+        else if (arg == "--size") config.size = std::max(13, std::min(UDP_SYNC_MAX_MESSAGE, atoi(value)));
+        else if (arg == "--slices") config.slices = std::max(0, atoi(value));
+        else if (arg == "--seconds") config.seconds = atof(value);
+        else if (arg == "--props") config.props = std::max(2, atoi(value));
+        else if (arg == "--prop-seconds") config.propSeconds = atof(value);
+        else if (arg == "--port") config.port = (uint16_t)std::max(1, std::min(65534, atoi(value)));
+        else if (arg == "--seed") config.seed = (unsigned)atoi(value);
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    BenchResult results[2];
+    for (int r = 0; r < 2; r++) {
+        Bench bench(config, r == 0);
+        if (!bench.run(results[r])) {
+            fprintf(stderr, "could not join %s on %s:%u\n", UDP_GROUP, UDP_INTERFACE, config.port);
+            return 1;
+        }
+    }
+    PropsResult props = runUdpProps(config);
+    return report(config, results, props);
+}
@@ -0,0 +1,97 @@
+// Host simulations of ESP-NOW groups of props.
+//
+// Usage:
+//   mesh_sim <scenario> [options]
+//
+// Scenarios:
+//   fanout      airtime and send latency of scene updates, broadcast vs
+//               per-peer unicast (Fanout.cpp)
+//   discovery   beacon-based membership: join convergence and departure
+//               detection (Discovery.cpp)
+//   dial        a dial spun fast over a lossy link: coalescing, acks and
+//               convergence of the final value (Dial.cpp)
+//   props       complete props (SyncController + LightShow) of several
+//               owners: scene convergence, traffic, airtime and frame phase
+//               (Props.cpp)
+//   election    leader election with props coming and going: election and
+//               failover time, leadership stability (Election.cpp)
+//   relay       multi-hop flooding along a chain of props: delivery and
+//               added latency per hop, cost in frames (Relay.cpp)
+//   stream      rendered pixels streamed to fixtures that only display them:
+//               bytes per frame, encode/decode time, loss recovery (Stream.cpp)
+//   udp         the UDP multicast transport over loopback sockets: throughput
+//               and latency with and without batching, then props syncing
+//               over it (Udp.cpp)
+//   coexist     ESP-NOW sharing the radio with BLE advertising and a phone,
+//               with and without the radio schedule (Coexist.cpp)
+//
+// Each scenario documents its own options and exits non-zero when its
+// target is missed.
+
+#include <Arduino.h>
+#include "Scenarios.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+bool parseList(const std::string& text, std::vector<int>& values, int minimum) {
+    values.clear();
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        int value = atoi(item.c_str());
+        if (value < minimum) {
+            return false;
+        }
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(values.size() * p))];
+}
+
+double mean(const std::vector<double>& values) {
+    double sum = 0;
+    for (double v : values) sum += v;
+    return values.empty() ? 0 : sum / values.size();
+}
+
+int main(int argc, char** argv) {
+    Serial.setEnabled(false);
+    if (argc >= 2 && strcmp(argv[1], "fanout") == 0) {
+        return runFanout(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "discovery") == 0) {
+        return runDiscovery(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "dial") == 0) {
+        return runDial(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "props") == 0) {
+        return runProps(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "election") == 0) {
+        return runElection(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "relay") == 0) {
+        return runRelay(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "stream") == 0) {
+        return runStream(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "udp") == 0) {
+        return runUdp(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "coexist") == 0) {
+        return runCoexist(argc, argv);
+    }
+    fprintf(stderr, "usage: %s <fanout|discovery|dial|props|election|relay|stream|udp|coexist> [options]\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,51 @@
+#include "HeapCounter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Each block carries its size in a header so delete can account for it
+static const size_t HEADER_SIZE = alignof(std::max_align_t);
+
+static std::atomic<size_t> liveBytes_(0);
+static std::atomic<size_t> peakBytes_(0);
+static std::atomic<size_t> allocations_(0);
+
+static void* countedAlloc(size_t size) {
+    void* block = std::malloc(size + HEADER_SIZE);
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    *static_cast<size_t*>(block) = size;
+
+    size_t live = liveBytes_.fetch_add(size) + size;
+    size_t peak = peakBytes_.load();
+    while (live > peak && !peakBytes_.compare_exchange_weak(peak, live)) {
+    }
+    allocations_++;
+    return static_cast<char*>(block) + HEADER_SIZE;
+}
+
+static void countedFree(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    void* block = static_cast<char*>(ptr) - HEADER_SIZE;
+    liveBytes_ -= *static_cast<size_t*>(block);
+    std::free(block);
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void* ptr) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr) noexcept { countedFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { countedFree(ptr); }
+
+namespace HeapCounter {
+    size_t liveBytes() { return liveBytes_.load(); }
+    size_t peakBytes() { return peakBytes_.load(); }
+    size_t allocations() { return allocations_.load(); }
+    void resetPeak() { peakBytes_ = liveBytes_.load(); }
+}
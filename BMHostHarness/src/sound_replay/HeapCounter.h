@@ -0,0 +1,18 @@
+#ifndef BM_HOST_HEAP_COUNTER_H
+#define BM_HOST_HEAP_COUNTER_H
+
+#include <stddef.h>
+
+// Live heap accounting for the harness process.
+//
+// HeapCounter.cpp replaces the global operator new/delete, so every C++
+// allocation (ours, FastLED's, the standard library's) is counted. Used to
+// check that pipeline reconfiguration never touches the heap.
+namespace HeapCounter {
+    size_t liveBytes();
+    size_t peakBytes();
+    size_t allocations();     // Total operator new calls since start
+    void resetPeak();         // Peak := current live bytes
+}
+
+#endif // BM_HOST_HEAP_COUNTER_H
@@ -0,0 +1,117 @@
+#include "WavSoundSource.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+static uint16_t readLE16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t readLE32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Decode one sample to a normalized [-1, 1] value
+static float decodeSample(const uint8_t* p, uint16_t format, uint16_t bits) {
+    if (format == 3 && bits == 32) {
+        float value;
+        uint32_t raw = readLE32(p);
+        memcpy(&value, &raw, sizeof(value));
+        return value;
+    }
+    switch (bits) {
+        case 8:
+            return ((int)p[0] - 128) / 128.0f;
+        case 16:
+            return (int16_t)readLE16(p) / 32768.0f;
+        case 24: {
+            int32_t v = (int32_t)(p[0] | (p[1] << 8) | (p[2] << 16));
+            if (v & 0x800000) v |= ~0xFFFFFF;
+            return v / 8388608.0f;
+        }
+        case 32:
+            return (int32_t)readLE32(p) / 2147483648.0f;
+        default:
+            return 0;
+    }
+}
+
+WavSoundSource::WavSoundSource()
+    : position_(0), sampleRate_(0), channels_(0), bitsPerSample_(0) {
+}
+
+bool WavSoundSource::load(const std::string& path, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (data.size() < 12 || memcmp(data.data(), "RIFF", 4) != 0 || memcmp(data.data() + 8, "WAVE", 4) != 0) {
+        error = "not a RIFF/WAVE file";
+        return false;
+    }
+
+    uint16_t format = 0;
+    const uint8_t* pcm = nullptr;
+    size_t pcmBytes = 0;
+
+    // Walk the chunk list looking for "fmt " and "data"
+    size_t offset = 12;
+    while (offset + 8 <= data.size()) {
+        const uint8_t* chunk = data.data() + offset;
+        uint32_t chunkSize = readLE32(chunk + 4);
+        size_t available = std::min<size_t>(chunkSize, data.size() - offset - 8);
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && available >= 16) {
+            format = readLE16(chunk + 8);
+            channels_ = readLE16(chunk + 10);
+            sampleRate_ = readLE32(chunk + 12);
+            bitsPerSample_ = readLE16(chunk + 22);
+            if (format == 0xFFFE && available >= 26) {
+                // WAVE_FORMAT_EXTENSIBLE: real format is the first word of the sub-format GUID
+                format = readLE16(chunk + 32);
+            }
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            pcm = chunk + 8;
+            pcmBytes = available;
+        }
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    if (format != 1 && format != 3) {
+        error = "unsupported WAV format " + std::to_string(format) + " (PCM or float only)";
+        return false;
+    }
+    if (!pcm || channels_ == 0 || sampleRate_ == 0 ||
+        (bitsPerSample_ != 8 && bitsPerSample_ != 16 && bitsPerSample_ != 24 && bitsPerSample_ != 32)) {
+        error = "missing or malformed fmt/data chunk";
+        return false;
+    }
+
+    // Mix down to mono 16-bit, the same format the I2S driver delivers
+    size_t bytesPerSample = bitsPerSample_ / 8;
+    size_t frameBytes = bytesPerSample * channels_;
+    size_t frames = pcmBytes / frameBytes;
+    samples_.resize(frames);
+    for (size_t f = 0; f < frames; f++) {
+        float mix = 0;
+        for (uint16_t c = 0; c < channels_; c++) {
+            mix += decodeSample(pcm + f * frameBytes + c * bytesPerSample, format, bitsPerSample_);
+        }
+        mix = std::max(-1.0f, std::min(1.0f, mix / channels_));
+        samples_[f] = (int16_t)(mix * 32767.0f);
+    }
+
+    position_ = 0;
+    return true;
+}
+
+size_t WavSoundSource::read(int16_t* buffer, size_t count) {
+    size_t available = samples_.size() - position_;
+    size_t n = std::min(count, available);
+    memcpy(buffer, samples_.data() + position_, n * sizeof(int16_t));
+    position_ += n;
+    return n;
+}
@@ -0,0 +1,34 @@
+#ifndef WAV_SOUND_SOURCE_H
+#define WAV_SOUND_SOURCE_H
+
+#include <SoundSource.h>
+#include <string>
+#include <vector>
+
+// Stands in for the I2S microphone on a host: serves PCM from a WAV file.
+// Multi-channel files are mixed down to mono; 8/16/24/32-bit integer and
+// 32-bit float PCM are supported.
+class WavSoundSource : public SoundSource {
+public:
+    WavSoundSource();
+
+    bool load(const std::string& path, std::string& error);
+
+    size_t read(int16_t* buffer, size_t count) override;
+    uint32_t getSampleRate() const override { return sampleRate_; }
+
+    void rewind() { position_ = 0; }
+    size_t getPosition() const { return position_; }
+    size_t getTotalSamples() const { return samples_.size(); }
+    uint16_t getChannels() const { return channels_; }
+    uint16_t getBitsPerSample() const { return bitsPerSample_; }
+
+private:
+    std::vector<int16_t> samples_;
+    size_t position_;
+    uint32_t sampleRate_;
+    uint16_t channels_;
+    uint16_t bitsPerSample_;
+};
+
+#endif // WAV_SOUND_SOURCE_H
@@ -0,0 +1,324 @@
+// Host replay harness for the BTUmbrellaV3 sound visualization.
+//
+// Feeds WAV files through the same SoundVisualizer pipeline the umbrella runs
+// (capture -> FFT -> band mapping -> beat/auto-gain -> LED render), pushes the
+// frames through FastLED's stub platform and writes per-window results to CSV.
+//
+// Usage:
+//   sound_replay <file.wav> [options]
+//     --csv <path>          write per-window bands/beats/timing to CSV
+//     --repeat <n>          replay the file n times (benchmarking)
+//     --bench               benchmark only: skip CSV, print throughput summary
+//     --no-secondary        render with the secondary palette "off"
+//     --set <key>=<value>   override a SoundSettings field (see applySetting)
+//     --stress-reconfigure <n>
+//                           switch FFT size and sample rate before every one
+//                           of n windows and fail if the heap moves
+//
+// Time inside the pipeline is virtual: each window advances the clock by
+// sampleCount / sampleRate, so beat timing and peak hold behave exactly as
+// they would on the device regardless of how fast the host runs.
+
+#include <FastLED.h>
+#include <SoundVisualizer.h>
+#include <Palettes.h>
+#include "WavSoundSource.h"
+#include "HeapCounter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define NUM_STRIPS SOUND_NUM_BANDS
+#define LEDS_PER_STRIP SOUND_LEDS_PER_BAND
+
+static CRGB leds0[LEDS_PER_STRIP], leds1[LEDS_PER_STRIP], leds2[LEDS_PER_STRIP], leds3[LEDS_PER_STRIP];
+static CRGB leds4[LEDS_PER_STRIP], leds5[LEDS_PER_STRIP], leds6[LEDS_PER_STRIP], leds7[LEDS_PER_STRIP];
+static CRGB* const leds[NUM_STRIPS] = {leds0, leds1, leds2, leds3, leds4, leds5, leds6, leds7};
+
+typedef std::chrono::steady_clock HostClock;
+
+static double elapsedMicros(HostClock::time_point start, HostClock::time_point end) {
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+// Apply a "--set key=value" override. Returns false for unknown keys.
+static bool applySetting(SoundSettings& s, const std::string& key, const std::string& value) {
+    int i = atoi(value.c_str());
+    float f = (float)atof(value.c_str());
+    bool b = (value == "1" || value == "true" || value == "on");
+
+    if (key == "amplitude") s.amplitude = i;
+    else if (key == "noiseThreshold") s.noiseThreshold = i;
+    else if (key == "barMode") s.barMode = b;
+    else if (key == "rainbowMode") s.rainbowMode = b;
+    else if (key == "colorSpeed") s.colorSpeed = i;
+    else if (key == "peakHold") s.peakHold = b;
+    else if (key == "peakHoldTime") s.peakHoldTime = i;
+    else if (key == "smoothing") s.smoothing = b;
+    else if (key == "smoothingFactor") s.smoothingFactor = f;
+    else if (key == "intensityMapping") s.intensityMapping = b;
+    else if (key == "beatDetection") s.beatDetection = b;
+    else if (key == "beatSensitivity") s.beatSensitivity = i;
+    else if (key == "strobeOnBeat") s.strobeOnBeat = b;
+    else if (key == "pulseOnBeat") s.pulseOnBeat = b;
+    else if (key == "bassEmphasis") s.bassEmphasis = i;
+    else if (key == "midEmphasis") s.midEmphasis = i;
+    else if (key == "trebleEmphasis") s.trebleEmphasis = i;
+    else if (key == "logarithmicMapping") s.logarithmicMapping = b;
+    else if (key == "autoGain") s.autoGain = b;
+    else if (key == "ambientCompensation") s.ambientCompensation = b;
+    else if (key == "stripMapping") s.stripMapping = i;
+    else if (key == "individualDirections") s.individualDirections = b;
+    else if (key == "sampleCount") s.sampleCount = i;
+    else if (key == "gainMultiplier") s.gainMultiplier = f;
+    else if (key == "minLEDs") s.minLEDs = i;
+    else if (key == "maxLEDs") s.maxLEDs = i;
+    else if (key == "frequencyMin") s.frequencyMin = i;
+    else if (key == "frequencyMax") s.frequencyMax = i;
+    else if (key == "doubleHeight") s.doubleHeight = b;
+    else if (key == "ledMultiplier") s.ledMultiplier = f;
+    else if (key == "fillFromCenter") s.fillFromCenter = b;
+    else return false;
+    return true;
+}
+
+static void printUsage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s <file.wav> [--csv out.csv] [--repeat n] [--bench] [--no-secondary] [--set key=value]...\n"
+            "       %s <file.wav> --stress-reconfigure n\n",
+            argv0, argv0);
+}
+
+// Hammer runtime reconfiguration the way the BLE handlers (0x5B/0x5C) can:
+// a new FFT size and sample rate before every window, with capture, analysis
+// and render in between. The live heap must not move once the first window
+// has been processed.
+static int runReconfigureStress(SoundVisualizer& visualizer, SoundSettings& settings, WavSoundSource& source,
+                                const CRGBPalette16& primaryPalette, const CRGBPalette16& secondaryPalette,
+                                long iterations) {
+    static const int rates[] = {8000, 16000, 22050, 32000, 44100, 46000, 48000, 96000};
+    const int rateCount = sizeof(rates) / sizeof(rates[0]);
+
+    uint32_t seed = 12345;
+    uint32_t now = 0;
+
+    auto runWindow = [&]() {
+        if (!visualizer.capture(source)) {
+            source.rewind();
+            visualizer.capture(source);
+        }
+        now += (uint32_t)(visualizer.getSampleCount() * 1000 / visualizer.getSamplingFrequency());
+        const SoundFeatures& features = visualizer.analyze(now);
+        visualizer.render(features, leds, LEDS_PER_STRIP, primaryPalette, secondaryPalette, false, false, now);
+        FastLED.show();
+    };
+
+    // Warm up at the current configuration so lazy one-time allocations
+    // (FastLED controllers, stdio buffers) are part of the baseline
+    runWindow();
+    size_t baselineBytes = HeapCounter::liveBytes();
+    size_t baselineAllocations = HeapCounter::allocations();
+    HeapCounter::resetPeak();
+
+    HostClock::time_point start = HostClock::now();
+    for (long i = 0; i < iterations; i++) {
+        seed = seed * 1103515245 + 12345;
+        int size = SOUND_FFT_MIN_SIZE << ((seed >> 16) % SOUND_FFT_SIZE_COUNT);
+        int rate = rates[(seed >> 8) % rateCount];
+
+        settings.sampleCount = size;
+        settings.samplingFrequency = rate;
+        visualizer.configure(size, rate);
+        runWindow();
+    }
+    double seconds = elapsedMicros(start, HostClock::now()) / 1e6;
+
+    size_t endBytes = HeapCounter::liveBytes();
+    size_t allocations = HeapCounter::allocations() - baselineAllocations;
+
+    printf("\n--- Reconfiguration stress ---\n");
+    printf("Reconfigurations:        %ld (%.0f/sec)\n", iterations, iterations / seconds);
+    printf("Live heap:               start %zu B, end %zu B, peak %zu B\n", baselineBytes, endBytes,
+           HeapCounter::peakBytes());
+    printf("Allocations during run:  %zu\n", allocations);
+
+    if (endBytes != baselineBytes || HeapCounter::peakBytes() != baselineBytes || allocations != 0) {
+        printf("FAIL: heap changed while reconfiguring\n");
+        return 1;
+    }
+    printf("PASS: heap flat\n");
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    SoundSettings settings;
+    std::string wavPath;
+    std::string csvPath;
+    int repeat = 1;
+    bool benchOnly = false;
+    bool secondaryPaletteOff = false;
+    long stressIterations = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--csv" && i + 1 < argc) {
+            csvPath = argv[++i];
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--bench") {
+            benchOnly = true;
+        } else if (arg == "--stress-reconfigure" && i + 1 < argc) {
+            stressIterations = std::max(1L, atol(argv[++i]));
+        } else if (arg == "--no-secondary") {
+            secondaryPaletteOff = true;
+        } else if (arg == "--set" && i + 1 < argc) {
+            std::string kv = argv[++i];
+            size_t eq = kv.find('=');
+            if (eq == std::string::npos || !applySetting(settings, kv.substr(0, eq), kv.substr(eq + 1))) {
+                fprintf(stderr, "unknown setting: %s\n", kv.c_str());
+                return 2;
+            }
+        } else if (arg[0] != '-' && wavPath.empty()) {
+            wavPath = arg;
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    WavSoundSource source;
+    std::string error;
+    if (!source.load(wavPath, error)) {
+        fprintf(stderr, "failed to load %s: %s\n", wavPath.c_str(), error.c_str());
+        return 1;
+    }
+
+    // The stub source replaces I2S, so analysis runs at the file's own rate
+    settings.samplingFrequency = (int)source.getSampleRate();
+
+    printf("Replaying %s: %zu samples, %u Hz, %u ch, %u-bit\n", wavPath.c_str(), source.getTotalSamples(),
+           source.getSampleRate(), source.getChannels(), source.getBitsPerSample());
+    printf("Analysis: %d-point FFT, %.2f ms windows\n", settings.sampleCount,
+           settings.sampleCount * 1000.0 / settings.samplingFrequency);
+
+    // Same strip layout as the umbrella, driven through FastLED's stub platform
+    FastLED.addLeds<WS2812B, 32, GRB>(leds0, LEDS_PER_STRIP);
+    FastLED.addLeds<WS2812B, 33, GRB>(leds1, LEDS_PER_STRIP);
+    FastLED.addLeds<WS2812B, 27, GRB>(leds2, LEDS_PER_STRIP);
+    FastLED.addLeds<WS2812B, 14, GRB>(leds3, LEDS_PER_STRIP);
+    FastLED.addLeds<WS2812B, 12, GRB>(leds4, LEDS_PER_STRIP);
+    FastLED.addLeds<WS2812B, 13, GRB>(leds5, LEDS_PER_STRIP);
+    FastLED.addLeds<WS2812B, 18, GRB>(leds6, LEDS_PER_STRIP);
+    FastLED.addLeds<WS2812B, 5, GRB>(leds7, LEDS_PER_STRIP);
+
+    // LightShow defaults: cool primary, earth secondary
+    CRGBPalette16 primaryPalette = coolPalette;
+    CRGBPalette16 secondaryPalette = earthPalette;
+
+    SoundVisualizer visualizer(settings);
+    visualizer.configure(settings.sampleCount, settings.samplingFrequency);
+
+    if (stressIterations > 0) {
+        return runReconfigureStress(visualizer, settings, source, primaryPalette, secondaryPalette,
+                                    stressIterations);
+    }
+
+    FILE* csv = nullptr;
+    if (!csvPath.empty() && !benchOnly) {
+        csv = fopen(csvPath.c_str(), "w");
+        if (!csv) {
+            fprintf(stderr, "cannot write %s\n", csvPath.c_str());
+            return 1;
+        }
+        fprintf(csv, "window,t_ms,avg_volume,rms");
+        for (int b = 0; b < NUM_STRIPS; b++) fprintf(csv, ",band%d", b);
+        for (int b = 0; b < NUM_STRIPS; b++) fprintf(csv, ",peak%d", b);
+        for (int b = 0; b < NUM_STRIPS; b++) fprintf(csv, ",height%d", b);
+        fprintf(csv, ",beat,beat_phase,amplitude,noise_threshold,analyze_us,render_us,show_us,latency_us\n");
+    }
+
+    const double windowMicros = settings.sampleCount * 1e6 / settings.samplingFrequency;
+    std::vector<double> processingMicros;
+    uint64_t samplesConsumed = 0;
+    long windows = 0;
+    long beats = 0;
+    double worstLatency = 0;
+
+    HostClock::time_point runStart = HostClock::now();
+
+    for (int pass = 0; pass < repeat; pass++) {
+        source.rewind();
+        while (visualizer.capture(source)) {
+            samplesConsumed += settings.sampleCount;
+            uint32_t now = (uint32_t)(samplesConsumed * 1000 / settings.samplingFrequency);
+
+            HostClock::time_point t0 = HostClock::now();
+            const SoundFeatures& features = visualizer.analyze(now);
+            HostClock::time_point t1 = HostClock::now();
+            visualizer.render(features, leds, LEDS_PER_STRIP, primaryPalette, secondaryPalette,
+                              secondaryPaletteOff, false, now);
+            HostClock::time_point t2 = HostClock::now();
+            FastLED.show();
+            HostClock::time_point t3 = HostClock::now();
+
+            double analyzeUs = elapsedMicros(t0, t1);
+            double renderUs = elapsedMicros(t1, t2);
+            double showUs = elapsedMicros(t2, t3);
+            double processUs = analyzeUs + renderUs + showUs;
+
+            // Worst case sample-to-LED latency: the first sample of the window
+            // waits for the whole window to fill, then for processing
+            double latencyUs = windowMicros + processUs;
+            worstLatency = std::max(worstLatency, latencyUs);
+            processingMicros.push_back(processUs);
+            if (features.beat) beats++;
+
+            if (csv) {
+                const int* heights = visualizer.getBarHeights();
+                fprintf(csv, "%ld,%u,%.1f,%.1f", windows, now, features.averageVolume, features.rms);
+                for (int b = 0; b < NUM_STRIPS; b++) fprintf(csv, ",%.1f", features.levels[b]);
+                for (int b = 0; b < NUM_STRIPS; b++) fprintf(csv, ",%.1f", features.peaks[b]);
+                for (int b = 0; b < NUM_STRIPS; b++) fprintf(csv, ",%d", heights[b]);
+                fprintf(csv, ",%d,%.2f,%d,%d,%.1f,%.1f,%.1f,%.1f\n", features.beat ? 1 : 0, features.beatPhase,
+                        features.amplitude, features.noiseThreshold, analyzeUs, renderUs, showUs, latencyUs);
+            }
+            windows++;
+        }
+    }
+
+    double wallSeconds = elapsedMicros(runStart, HostClock::now()) / 1e6;
+    if (csv) {
+        fclose(csv);
+        printf("Wrote %ld windows to %s\n", windows, csvPath.c_str());
+    }
+
+    if (windows == 0) {
+        printf("File shorter than one analysis window, nothing to do\n");
+        return 1;
+    }
+
+    std::sort(processingMicros.begin(), processingMicros.end());
+    double sum = 0;
+    for (double us : processingMicros) sum += us;
+    double p99 = processingMicros[(size_t)(processingMicros.size() * 0.99)];
+
+    printf("\n--- Sound pipeline benchmark ---\n");
+    printf("Windows analysed:        %ld (%ld beats)\n", windows, beats);
+    printf("Throughput:              %.0f windows/sec (real-time needs %.0f)\n",
+           windows / wallSeconds, 1e6 / windowMicros);
+    printf("Processing per window:   mean %.1f us, p99 %.1f us, max %.1f us\n",
+           sum / windows, p99, processingMicros.back());
+    printf("Sample-to-LED latency:   window %.1f us + processing, worst case %.1f us\n",
+           windowMicros, worstLatency);
+    return 0;
+}
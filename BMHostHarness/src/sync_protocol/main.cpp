@@ -0,0 +1,332 @@
+// Host fuzz and benchmark harness for the scene sync wire format (SyncProtocol).
+//
+// Fuzzing runs three checks:
+//   - round trip: random scenes survive encode/decode unchanged,
+//   - stream: a sender mutates its scene and ships deltas over a lossy link;
+//     the receiver must match the sender whenever it has seen every message
+//     since the last keyframe it received,
+//   - mutation: valid messages are bit-flipped, truncated, extended or
+//     replaced with noise; the decoder must either reject them without
+//     touching the scene or produce a scene with in-range ids.
+// Build with -fsanitize=address,undefined to catch out-of-bounds reads.
+//
+// Usage:
+//   sync_protocol [options]
+//     --fuzz <n>       iterations of each fuzz check (default 200000)
+//     --bench <n>      encode/decode iterations (default 1000000)
+//     --loss <pct>     stream check packet loss (default 20)
+//     --seed <n>       random seed
+//
+// Exits non-zero if any check fails.
+
+#include <FastLED.h>
+#include <SyncProtocol.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+typedef std::chrono::steady_clock HostClock;
+
+// What SyncController used to memcpy onto the air
+struct LegacySyncData {
+    char identifier[2];
+    LightScene scene;
+    uint8_t messageType;
+    int currentSetting;
+};
+
+struct Config {
+    long fuzzIterations = 200000;
+    long benchIterations = 1000000;
+    double lossPercent = 20;
+    unsigned seed = 1;
+};
+
+static std::mt19937 rng;
+
+static uint32_t randomInt(uint32_t maxInclusive) {
+    return std::uniform_int_distribution<uint32_t>(0, maxInclusive)(rng);
+}
+
+static bool sameScene(const LightScene& a, const LightScene& b) {
+    return SyncProtocol::diffScene(a, b) == 0;
+}
+
+// Random bytes pushed through a keyframe give a random scene in canonical
+// form; parameter sets with an out-of-range palette are simply redrawn
+static LightScene randomScene(LightSceneID sceneId) {
+    for (;;) {
+        LightScene raw = {};
+        raw.scene_id = sceneId;
+        raw.brightness = randomInt(255);
+        raw.speed = randomInt(65535);
+        raw.primary_palette = (AvailablePalettes)randomInt(SYNC_LAST_PALETTE);
+        raw.color = CRGB(randomInt(255), randomInt(255), randomInt(255));
+        raw.direction = randomInt(1);
+        raw.selected_devices = randomInt(255);
+        raw.reference_time = rng();
+        uint8_t* params = reinterpret_cast<uint8_t*>(&raw.scenes);
+        for (size_t i = 0; i < sizeof(raw.scenes); i++) {
+            params[i] = randomInt(255);
+        }
+
+        SyncHeader header = {};
+        header.fields = SYNC_FIELD_ALL;
+        uint8_t buffer[SYNC_MAX_MESSAGE_SIZE];
+        size_t len = SyncProtocol::encodeScene(header, raw, buffer, sizeof(buffer));
+        LightScene scene = {};
+        if (len && SyncProtocol::decodeScene(buffer, len, header, scene)) {
+            return scene;
+        }
+    }
+}
+
+static LightScene randomScene() { return randomScene((LightSceneID)randomInt(SYNC_LAST_SCENE_ID)); }
+
+// One user action: a dial tick, a palette/color/direction change or a new scene
+static void mutate(LightScene& scene) {
+    switch (randomInt(5)) {
+        case 0: scene.brightness += randomInt(1) ? 5 : -5; break;
+        case 1: scene.speed = randomInt(65535); break;
+        case 2: scene.primary_palette = (AvailablePalettes)randomInt(SYNC_LAST_PALETTE); break;
+        case 3: scene.color = CRGB(randomInt(255), randomInt(255), randomInt(255)); break;
+        case 4: scene.direction = !scene.direction; break;
+        default: {
+            // Same scene with new parameters, or a different scene
+            LightScene next = randomScene(randomInt(1) ? scene.scene_id : (LightSceneID)randomInt(SYNC_LAST_SCENE_ID));
+            scene.scene_id = next.scene_id;
+            scene.scenes = next.scenes;
+            break;
+        }
+    }
+}
+
+static bool fuzzRoundTrip(long iterations) {
+    for (long i = 0; i < iterations; i++) {
+        LightScene scene = randomScene();
+        SyncEncoder encoder((uint16_t)rng());
+        uint8_t buffer[SYNC_MAX_MESSAGE_SIZE];
+        size_t len = encoder.encode(scene, buffer, sizeof(buffer));
+
+        LightScene decoded = randomScene();
+        SyncHeader header;
+        if (len == 0 || !SyncProtocol::decodeScene(buffer, len, header, decoded) || !sameScene(scene, decoded) ||
+            header.group_id != encoder.getGroupId() || !(header.flags & SYNC_FLAG_KEYFRAME)) {
+            printf("FAIL: round trip of scene %d (%zu bytes)\n", scene.scene_id, len);
+            return false;
+        }
+    }
+    printf("Round trip:   %ld random keyframes decoded identically\n", iterations);
+    return true;
+}
+
+static bool fuzzStream(long iterations, double lossPercent) {
+    SyncEncoder encoder(SyncProtocol::groupId("CL"));
+    LightScene sender = randomScene();
+    LightScene receiver = randomScene();
+    bool inSync = false;
+    long delivered = 0, dropped = 0, keyframes = 0, checked = 0;
+    uint16_t expectedSequence = 0;
+
+    for (long i = 0; i < iterations; i++) {
+        mutate(sender);
+        uint8_t buffer[SYNC_MAX_MESSAGE_SIZE];
+        size_t len = encoder.encode(sender, buffer, sizeof(buffer));
+        if (len == 0) {
+            continue;
+        }
+        if (std::uniform_real_distribution<double>(0, 100)(rng) < lossPercent) {
+            dropped++;
+            inSync = false;
+            continue;
+        }
+
+        SyncHeader header;
+        if (!SyncProtocol::decodeScene(buffer, len, header, receiver)) {
+            printf("FAIL: stream message %ld rejected\n", i);
+            return false;
+        }
+        delivered++;
+        if (header.sequence != expectedSequence) {
+            inSync = false;
+        }
+        expectedSequence = header.sequence + 1;
+        if (header.flags & SYNC_FLAG_KEYFRAME) {
+            keyframes++;
+            inSync = true;
+        }
+        if (inSync) {
+            checked++;
+            if (!sameScene(sender, receiver)) {
+                printf("FAIL: receiver diverged at message %ld (fields 0x%03x)\n", i,
+                       SyncProtocol::diffScene(sender, receiver));
+                return false;
+            }
+        }
+    }
+    printf("Stream:       %ld delivered, %ld dropped (%.0f%%), %ld keyframes, %ld checked in sync\n", delivered,
+           dropped, lossPercent, keyframes, checked);
+    return true;
+}
+
+static bool fuzzMutation(long iterations) {
+    long accepted = 0;
+    for (long i = 0; i < iterations; i++) {
+        LightScene scene = randomScene();
+        SyncEncoder encoder;
+        uint8_t valid[SYNC_MAX_MESSAGE_SIZE];
+        size_t validLen = encoder.encode(scene, valid, sizeof(valid));
+        if (randomInt(1)) {
+            mutate(scene);
+            size_t deltaLen = encoder.encode(scene, valid, sizeof(valid));
+            validLen = deltaLen ? deltaLen : validLen;
+        }
+
+        size_t len = validLen;
+        uint8_t work[SYNC_MAX_MESSAGE_SIZE * 2];
+        memcpy(work, valid, validLen);
+        switch (randomInt(4)) {
+            case 0:
+                for (uint32_t flips = randomInt(3) + 1; flips; flips--) {
+                    work[randomInt(len - 1)] ^= 1 << randomInt(7);
+                }
+                break;
+            case 1: work[randomInt(len - 1)] = randomInt(255); break;
+            case 2: len = randomInt(len); break;
+            case 3:
+                for (uint32_t extra = randomInt(SYNC_MAX_MESSAGE_SIZE - 1) + 1; extra; extra--) {
+                    work[len++] = randomInt(255);
+                }
+                break;
+            default:
+                len = randomInt(sizeof(work));
+                for (size_t b = 0; b < len; b++) work[b] = randomInt(255);
+                if (len && randomInt(1)) work[0] = SYNC_PROTOCOL_MAGIC;
+                if (len > 1 && randomInt(1)) work[1] = SYNC_PROTOCOL_VERSION;
+                break;
+        }
+        // Exact-size heap copy so ASan flags any read past the end
+        uint8_t* message = (uint8_t*)malloc(len ? len : 1);
+        memcpy(message, work, len);
+
+        LightScene target = randomScene();
+        LightScene before = target;
+        SyncHeader header;
+        bool ok = SyncProtocol::decodeScene(message, len, header, target);
+        free(message);
+
+        if (!ok && memcmp(&before, &target, sizeof(target)) != 0) {
+            printf("FAIL: rejected message modified the scene\n");
+            return false;
+        }
+        if (ok) {
+            accepted++;
+            if (target.scene_id > SYNC_LAST_SCENE_ID || target.primary_palette > SYNC_LAST_PALETTE) {
+                printf("FAIL: accepted message produced scene %d palette %d\n", target.scene_id,
+                       target.primary_palette);
+                return false;
+            }
+        }
+    }
+    printf("Mutation:     %ld corrupted messages, %ld still decodable, none out of range\n", iterations, accepted);
+    return true;
+}
+
+static double nanosPer(HostClock::time_point start, long count) {
+    return std::chrono::duration<double, std::nano>(HostClock::now() - start).count() / count;
+}
+
+static void bench(long iterations) {
+    // Pre-generate the actions so the timing is only encode/decode
+    const int ACTIONS = 4096;
+    static LightScene scenes[ACTIONS];
+    LightScene scene = randomScene();
+    for (int i = 0; i < ACTIONS; i++) {
+        if (randomInt(7) == 0) {
+            mutate(scene);
+        } else {
+            scene.brightness += 5; // Dial ticks dominate real traffic
+        }
+        scenes[i] = scene;
+    }
+
+    SyncEncoder encoder(SyncProtocol::groupId("CL"));
+    static uint8_t messages[ACTIONS][SYNC_MAX_MESSAGE_SIZE];
+    static size_t lengths[ACTIONS];
+    long totalBytes = 0, sent = 0;
+    HostClock::time_point start = HostClock::now();
+    for (long i = 0; i < iterations; i++) {
+        int a = i % ACTIONS;
+        lengths[a] = encoder.encode(scenes[a], messages[a], SYNC_MAX_MESSAGE_SIZE);
+        totalBytes += lengths[a];
+        sent += lengths[a] != 0;
+    }
+    double encodeNs = nanosPer(start, iterations);
+
+    LightScene receiver = scenes[0];
+    start = HostClock::now();
+    for (long i = 0; i < iterations; i++) {
+        int a = i % ACTIONS;
+        SyncHeader header;
+        SyncProtocol::decodeScene(messages[a], lengths[a], header, receiver);
+    }
+    double decodeNs = nanosPer(start, iterations);
+
+    SyncHeader header = {};
+    header.fields = SYNC_FIELD_ALL;
+    uint8_t keyframe[SYNC_MAX_MESSAGE_SIZE];
+    size_t largest = 0;
+    for (int id = 0; id <= SYNC_LAST_SCENE_ID; id++) {
+        LightScene s = randomScene((LightSceneID)id);
+        largest = std::max(largest, SyncProtocol::encodeScene(header, s, keyframe, sizeof(keyframe)));
+    }
+    header.fields = SYNC_FIELD_BRIGHTNESS;
+    size_t dialTick = SyncProtocol::encodeScene(header, scene, keyframe, sizeof(keyframe));
+
+    printf("Encode:       %.1f ns/message (%ld messages)\n", encodeNs, sent);
+    printf("Decode:       %.1f ns/message\n", decodeNs);
+    printf("Size:         dial tick %zu bytes, mean %.1f bytes, largest keyframe %zu bytes (legacy SyncData %zu)\n",
+           dialTick, (double)totalBytes / std::max(1L, sent), largest, sizeof(LegacySyncData));
+}
+
+static void printUsage(const char* argv0) {
+    fprintf(stderr, "usage: %s [--fuzz n] [--bench n] [--loss pct] [--seed n]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--fuzz") config.fuzzIterations = atol(value);
+        else if (arg == "--bench") config.benchIterations = atol(value);
+        else if (arg == "--loss") config.lossPercent = atof(value);
+        else if (arg == "--seed") config.seed = (unsigned)atoi(value);
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    rng.seed(config.seed);
+
+    printf("\n--- Sync protocol v%d ---\n", SYNC_PROTOCOL_VERSION);
+    bool ok = true;
+    if (config.fuzzIterations > 0) {
+        ok = fuzzRoundTrip(config.fuzzIterations) && ok;
+        ok = fuzzStream(config.fuzzIterations, config.lossPercent) && ok;
+        ok = fuzzMutation(config.fuzzIterations) && ok;
+    }
+    if (config.benchIterations > 0) {
+        bench(config.benchIterations);
+    }
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
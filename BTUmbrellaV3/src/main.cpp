@@ -1,6 +1,6 @@
 #include <BMDevice.h>
-#include <driver/i2s.h>
-#include <arduinoFFT.h>
+#include <BMSettingsRecord.h>
+#include <BMSound.h>
 #include <Preferences.h>
 
 // === HARDWARE CONFIGURATION ===
@@ -15,8 +15,6 @@
 #define STATUS_UUID "0b95cc9e-288e-49d2-a2aa-7230ed489ec8"
 
 // Sound Analysis Configuration
-#define DEFAULT_SAMPLES 256
-#define DEFAULT_SAMPLING_FREQ 46000
 #define I2S_PORT I2S_NUM_0
 #define I2S_SCK_PIN GPIO_NUM_26
 #define I2S_WS_PIN GPIO_NUM_22
@@ -25,10 +23,19 @@
 // === PREFERENCES CONFIGURATION ===
 Preferences preferences;
 const char* PREFS_NAMESPACE = "umbrella";
-const char* PREFS_SOUND_KEY = "sound";
-const char* PREFS_UMBRELLA_KEY = "umbrella";
-const char* PREFS_VERSION_KEY = "version";
-const int CURRENT_SETTINGS_VERSION = 1;
+// All umbrella settings are one record ("settings0"/"settings1"), payload:
+//   secondary palette off | secondary palette ID | sound settings (SOUND_SETTINGS_SIZE)
+// Bump the version when it changes and add a migration from the old one.
+const char* PREFS_RECORD_NAME = "settings";
+const uint8_t UMBRELLA_SETTINGS_VERSION = 1;
+const size_t UMBRELLA_SETTINGS_SIZE = 2 + SOUND_SETTINGS_SIZE;
+BMSettingsRecord settingsRecord(preferences, PREFS_RECORD_NAME, UMBRELLA_SETTINGS_VERSION);
+
+// Before the record: a version key, the SoundSettings struct as a raw blob,
+// and the secondary palette in keys of its own. Read once and converted.
+const char* LEGACY_SOUND_KEY = "sound";
+const char* LEGACY_VERSION_KEY = "version";
+const int LEGACY_SETTINGS_VERSION = 1;
 
 // === LED SETUP ===
 // Individual LED strip arrays for BMDevice
@@ -38,10 +45,10 @@ CRGB leds4[LEDS_PER_STRIP], leds5[LEDS_PER_STRIP], leds6[LEDS_PER_STRIP], leds7[
 // 2D array for easy sound analysis access
 CRGB* leds[NUM_STRIPS] = {leds0, leds1, leds2, leds3, leds4, leds5, leds6, leds7};
 
-// === SOUND ANALYSIS VARIABLES ===
-double* vReal = nullptr;
-double* vImag = nullptr;
-ArduinoFFT<double>* FFT = nullptr;
+static_assert(NUM_STRIPS == SOUND_NUM_BANDS, "BMSound band count must match the umbrella strip count");
+
+// === SOUND ANALYSIS ===
+I2SSoundSource micSource(I2S_PORT, I2S_SCK_PIN, I2S_WS_PIN, I2S_SD_PIN);
 
 // === PALETTE MANAGEMENT ===
 // Simple, clean palette variables (like original Umbrella.ino)
@@ -51,70 +58,11 @@ AvailablePalettes currentSecondaryPaletteId = AvailablePalettes::earth;
 bool secondaryPaletteOff = false;  // Start with secondary palette ON for proper visualization
 
 // === SOUND SETTINGS ===
-struct SoundSettings {
-    // Basic settings
-    bool soundSensitive = true;
-    int amplitude = 1000;
-    int noiseThreshold = 500;
-    float reference = log10(50.0);
-    bool decay = false;
-    int decayRate = 100;
-    
-    // Visual modes
-    bool barMode = true;
-    bool rainbowMode = false;
-    int colorSpeed = 50;
-    bool reverseDirection = false;
-    
-    // Advanced features
-    bool peakHold = false;
-    int peakHoldTime = 500;
-    bool smoothing = true;
-    float smoothingFactor = 0.3;
-    bool intensityMapping = false;
-    
-    // Beat detection
-    bool beatDetection = false;
-    int beatSensitivity = 70;
-    bool strobeOnBeat = false;
-    bool pulseOnBeat = false;
-    
-    // Frequency controls
-    int bassEmphasis = 50;
-    int midEmphasis = 50;
-    int trebleEmphasis = 50;
-    bool logarithmicMapping = true;
-    
-    // Auto features
-    bool autoGain = false;
-    bool ambientCompensation = false;
-    int stripMapping = 0;
-    bool individualDirections = false;
-    
-    // Advanced audio settings
-    int samplingFrequency = DEFAULT_SAMPLING_FREQ;
-    int sampleCount = DEFAULT_SAMPLES;
-    float gainMultiplier = 1.0;
-    int minLEDs = 0;
-    int maxLEDs = LEDS_PER_STRIP;
-    int frequencyMin = 50;
-    int frequencyMax = 8000;
-    bool doubleHeight = false;
-    float ledMultiplier = 1.0;
-    bool fillFromCenter = false;
-};
-
 SoundSettings soundSettings;
+SoundVisualizer soundVisualizer(soundSettings);
 
-// === TRACKING VARIABLES ===
-float peakValues[NUM_STRIPS] = {0};
-unsigned long peakTimes[NUM_STRIPS] = {0};
-float smoothedValues[NUM_STRIPS] = {0};
-float previousAverage = 0;
-unsigned long lastBeatTime = 0;
-bool beatDetected = false;
-float recentMax = 0;
-unsigned long lastGainAdjust = 0;
+// Capture + FFT run on core 0; loop() (core 1) only renders the latest snapshot
+SoundAnalysisTask soundTask(soundVisualizer, micSource);
 
 // === BMDevice ===
 BMDevice device("Umbrella-CL", SERVICE_UUID, FEATURES_UUID, STATUS_UUID);
@@ -153,146 +101,103 @@ void updatePalettesFromBMDevice() {
     primaryPalette = palettes.first;
     secondaryPalette = palettes.second;
     
-    Serial.printf("🎨 [PALETTE UPDATE] Primary: %s, Secondary: %s (Off: %s)\n",
-                 LightShow::paletteIdToName(state.currentPalette),
-                 LightShow::paletteIdToName(currentSecondaryPaletteId),
-                 secondaryPaletteOff ? "true" : "false");
+    BMLOG_DEBUG("BTUmbrellaV3", "Palettes: primary %s, secondary %s (Off: %s)",
+                LightShow::paletteIdToName(state.currentPalette),
+                LightShow::paletteIdToName(currentSecondaryPaletteId),
+                secondaryPaletteOff ? "true" : "false");
 }
 
 // === PREFERENCES MANAGEMENT ===
+std::vector<uint8_t> encodeUmbrellaSettings() {
+    std::vector<uint8_t> payload(UMBRELLA_SETTINGS_SIZE);
+    payload[0] = secondaryPaletteOff ? 1 : 0;
+    payload[1] = (uint8_t)currentSecondaryPaletteId;
+    encodeSoundSettings(soundSettings, payload.data() + 2);
+    return payload;
+}
+
+bool decodeUmbrellaSettings(const std::vector<uint8_t>& payload) {
+    SoundSettings loaded;
+    if (payload.size() != UMBRELLA_SETTINGS_SIZE ||
+        payload[1] > (uint8_t)AvailablePalettes::moltenmetal ||
+        !decodeSoundSettings(payload.data() + 2, payload.size() - 2, loaded)) {
+        return false;
+    }
+    secondaryPaletteOff = payload[0] != 0;
+    currentSecondaryPaletteId = (AvailablePalettes)payload[1];
+    soundSettings = loaded;
+    return true;
+}
+
 void saveUmbrellaSettings() {
     Serial.println("💾 [SAVE UMBRELLA] Starting umbrella settings save...");
-    Serial.printf("💾 [SAVE UMBRELLA] Namespace: %s\n", PREFS_NAMESPACE);
     
     bool success = preferences.begin(PREFS_NAMESPACE, false);
     if (!success) {
         Serial.println("❌ [SAVE UMBRELLA] Failed to begin preferences!");
         return;
     }
-    Serial.println("✅ [SAVE UMBRELLA] Preferences opened successfully");
-    
-    // Save settings version
-    size_t versionBytes = preferences.putInt(PREFS_VERSION_KEY, CURRENT_SETTINGS_VERSION);
-    Serial.printf("💾 [SAVE UMBRELLA] Version save: %d bytes (key: %s, value: %d)\n", 
-                 versionBytes, PREFS_VERSION_KEY, CURRENT_SETTINGS_VERSION);
-    
-    // Save umbrella-specific settings
-    size_t palOffBytes = preferences.putBool("secPalOff", secondaryPaletteOff);
-    size_t palIdBytes = preferences.putUChar("secPalId", (uint8_t)currentSecondaryPaletteId);
-    Serial.printf("💾 [SAVE UMBRELLA] SecPalOff: %d bytes, SecPalId: %d bytes\n", palOffBytes, palIdBytes);
-    
-    // Save all sound settings as a blob
-    size_t soundBytes = preferences.putBytes(PREFS_SOUND_KEY, &soundSettings, sizeof(soundSettings));
-    Serial.printf("💾 [SAVE UMBRELLA] Sound blob: %d bytes (expected: %d)\n", soundBytes, sizeof(soundSettings));
-    
-    // ALSO save critical settings individually for debugging
-    size_t rainbowBytes = preferences.putBool("rainbowMode", soundSettings.rainbowMode);
-    size_t soundSensBytes = preferences.putBool("soundSensitive", soundSettings.soundSensitive);
-    size_t ampBytes = preferences.putInt("amplitude", soundSettings.amplitude);
-    Serial.printf("💾 [SAVE UMBRELLA] Individual: rainbow=%d, sound=%d, amp=%d bytes\n", 
-                 rainbowBytes, soundSensBytes, ampBytes);
     
+    // One write for the palette and all sound settings
+    bool saved = settingsRecord.commit(encodeUmbrellaSettings());
     preferences.end();
     
-    if (versionBytes > 0 && palOffBytes > 0 && soundBytes > 0) {
-        Serial.println("✅ [PREFERENCES] Umbrella settings saved successfully");
+    if (saved) {
+        Serial.printf("✅ [PREFERENCES] Umbrella settings saved (version %d, commit %u, %d bytes)\n",
+                     UMBRELLA_SETTINGS_VERSION, (unsigned)settingsRecord.getSequence(), UMBRELLA_SETTINGS_SIZE);
     } else {
-        Serial.println("❌ [PREFERENCES] Some umbrella settings failed to save!");
+        Serial.println("❌ [PREFERENCES] Umbrella settings failed to save!");
     }
     
     Serial.printf("💾 [SAVE DEBUG] Saved rainbowMode: %s\n", soundSettings.rainbowMode ? "ON" : "OFF");
     Serial.printf("💾 [SAVE DEBUG] Saved secondaryPaletteOff: %s\n", secondaryPaletteOff ? "true" : "false");
 }
 
-void loadUmbrellaSettings() {
-    preferences.begin(PREFS_NAMESPACE, true); // read-only
-    
-    // Check settings version
-    int version = preferences.getInt(PREFS_VERSION_KEY, 0);
-    Serial.printf("🔍 [LOAD DEBUG] Settings version in flash: %d (expected: %d)\n", version, CURRENT_SETTINGS_VERSION);
-    
-    if (version != CURRENT_SETTINGS_VERSION) {
-        Serial.printf("⚠️ [PREFERENCES] Settings version mismatch (found: %d, expected: %d), using defaults\n", 
-                     version, CURRENT_SETTINGS_VERSION);
-        preferences.end();
-        return;
+// The layout from before the record; false if there is nothing in it
+bool loadLegacyUmbrellaSettings() {
+    int version = preferences.getInt(LEGACY_VERSION_KEY, 0);
+    if (version != LEGACY_SETTINGS_VERSION) {
+        return false;
     }
     
-    // Load umbrella-specific settings with debugging
-    bool oldSecondaryPaletteOff = secondaryPaletteOff;
-    AvailablePalettes oldSecondaryPaletteId = currentSecondaryPaletteId;
-    
     secondaryPaletteOff = preferences.getBool("secPalOff", false);
     currentSecondaryPaletteId = (AvailablePalettes)preferences.getUChar("secPalId", (uint8_t)AvailablePalettes::earth);
     
-    Serial.printf("🔍 [LOAD DEBUG] Secondary palette OFF: %s -> %s\n", 
-                 oldSecondaryPaletteOff ? "true" : "false",
-                 secondaryPaletteOff ? "true" : "false");
-    Serial.printf("🔍 [LOAD DEBUG] Secondary palette ID: %s -> %s\n",
-                 LightShow::paletteIdToName(oldSecondaryPaletteId),
-                 LightShow::paletteIdToName(currentSecondaryPaletteId));
-    
-    // Load sound settings with debugging
-    size_t settingsSize = preferences.getBytesLength(PREFS_SOUND_KEY);
-    Serial.printf("🔍 [LOAD DEBUG] Sound settings blob size: %d bytes (expected: %d)\n", 
-                 settingsSize, sizeof(soundSettings));
-    
-    if (settingsSize == sizeof(soundSettings)) {
-        // Save old values for comparison
-        bool oldRainbowMode = soundSettings.rainbowMode;
-        bool oldSoundSensitive = soundSettings.soundSensitive;
-        int oldAmplitude = soundSettings.amplitude;
-        
-        preferences.getBytes(PREFS_SOUND_KEY, &soundSettings, sizeof(soundSettings));
-        
-        Serial.printf("🔍 [LOAD DEBUG] Rainbow mode: %s -> %s\n",
-                     oldRainbowMode ? "ON" : "OFF",
-                     soundSettings.rainbowMode ? "ON" : "OFF");
-        Serial.printf("🔍 [LOAD DEBUG] Sound mode: %s -> %s\n",
-                     oldSoundSensitive ? "ON" : "OFF", 
-                     soundSettings.soundSensitive ? "ON" : "OFF");
-        Serial.printf("🔍 [LOAD DEBUG] Amplitude: %d -> %d\n",
-                     oldAmplitude, soundSettings.amplitude);
-        
-        Serial.println("📂 [PREFERENCES] Sound settings loaded from flash");
-        
-        // COMPARE with individually saved settings for debugging
-        bool individualRainbow = preferences.getBool("rainbowMode", false);
-        bool individualSoundSensitive = preferences.getBool("soundSensitive", true);
-        int individualAmplitude = preferences.getInt("amplitude", 1000);
-        
-        Serial.printf("🔍 [COMPARE DEBUG] Blob vs Individual:\n");
-        Serial.printf("  Rainbow: blob=%s, individual=%s\n", 
-                     soundSettings.rainbowMode ? "ON" : "OFF",
-                     individualRainbow ? "ON" : "OFF");
-        Serial.printf("  SoundSensitive: blob=%s, individual=%s\n",
-                     soundSettings.soundSensitive ? "ON" : "OFF", 
-                     individualSoundSensitive ? "ON" : "OFF");
-        Serial.printf("  Amplitude: blob=%d, individual=%d\n",
-                     soundSettings.amplitude, individualAmplitude);
-        
-        // FALLBACK: If blob and individual don't match, use individual values
-        if (soundSettings.rainbowMode != individualRainbow || 
-            soundSettings.soundSensitive != individualSoundSensitive ||
-            soundSettings.amplitude != individualAmplitude) {
-            Serial.println("⚠️ [FALLBACK] Blob and individual settings mismatch, using individual values");
-            soundSettings.rainbowMode = individualRainbow;
-            soundSettings.soundSensitive = individualSoundSensitive;
-            soundSettings.amplitude = individualAmplitude;
-        }
+    // The struct as it was laid out in memory; only trusted at the same size
+    if (preferences.getBytesLength(LEGACY_SOUND_KEY) == sizeof(soundSettings)) {
+        preferences.getBytes(LEGACY_SOUND_KEY, &soundSettings, sizeof(soundSettings));
+    }
+    // Saved next to the blob, and preferred over it when they disagreed
+    soundSettings.rainbowMode = preferences.getBool("rainbowMode", soundSettings.rainbowMode);
+    soundSettings.soundSensitive = preferences.getBool("soundSensitive", soundSettings.soundSensitive);
+    soundSettings.amplitude = preferences.getInt("amplitude", soundSettings.amplitude);
+    return true;
+}
+
+void loadUmbrellaSettings() {
+    preferences.begin(PREFS_NAMESPACE, false);
+    
+    std::vector<uint8_t> payload;
+    if (settingsRecord.load(payload, [](const std::vector<uint8_t>& candidate) {
+            return candidate.size() == UMBRELLA_SETTINGS_SIZE;
+        }) && decodeUmbrellaSettings(payload)) {
+        Serial.printf("📂 [PREFERENCES] Umbrella settings loaded (version %d, commit %u)\n",
+                     settingsRecord.getLoadedVersion(), (unsigned)settingsRecord.getSequence());
+    } else if (loadLegacyUmbrellaSettings()) {
+        // Written as a record from now on; the old keys stay for older firmware
+        settingsRecord.commit(encodeUmbrellaSettings());
+        Serial.println("📂 [PREFERENCES] Converted umbrella settings to a record");
     } else {
-        Serial.printf("⚠️ [PREFERENCES] Sound settings size mismatch (expected: %d, found: %d), using individual fallback\n", 
-                     sizeof(soundSettings), settingsSize);
-        
-        // FALLBACK: Load critical settings individually
-        soundSettings.rainbowMode = preferences.getBool("rainbowMode", false);
-        soundSettings.soundSensitive = preferences.getBool("soundSensitive", true);
-        soundSettings.amplitude = preferences.getInt("amplitude", 1000);
-        Serial.println("📂 [FALLBACK] Loaded critical settings individually");
+        Serial.println("⚠️ [PREFERENCES] No stored umbrella settings, using defaults");
     }
     
     preferences.end();
-    Serial.println("📂 [PREFERENCES] Umbrella settings loaded successfully");
+    Serial.printf("🔍 [LOAD DEBUG] Secondary palette: %s (Off: %s), Rainbow: %s, Sound: %s, Amplitude: %d\n",
+                 LightShow::paletteIdToName(currentSecondaryPaletteId),
+                 secondaryPaletteOff ? "true" : "false",
+                 soundSettings.rainbowMode ? "ON" : "OFF",
+                 soundSettings.soundSensitive ? "ON" : "OFF",
+                 soundSettings.amplitude);
 }
 
 // === STRUCT DEBUGGING ===
@@ -463,12 +368,13 @@ void loadAllSettings() {
 
 // === SETTINGS VERIFICATION ===
 void verifyAllSettings() {
+    BMLog::flush();     // The audit goes straight to Serial; print what's queued first
     Serial.println("🔍 [VERIFICATION] Complete settings audit:");
     
     // Verify BMDevice current state and saved defaults
     BMDeviceState& state = device.getState();
     BMDeviceDefaults& defaults = device.getDefaults();
-    DeviceDefaults currentDefaults = defaults.getCurrentDefaults();
+    const DeviceDefaults& currentDefaults = defaults.getCurrentDefaults();
     
     Serial.println("🔍 [BMDevice CURRENT STATE]:");
     Serial.printf("  Power: %s, Brightness: %d, Speed: %d\n",
@@ -490,8 +396,8 @@ void verifyAllSettings() {
                  LightShow::paletteIdToName(currentDefaults.palette),
                  currentDefaults.reverseDirection ? "Reverse" : "Normal");
     Serial.printf("  Device: Name=%s, Owner=%s, AutoOn=%s\n",
-                 currentDefaults.deviceName.c_str(),
-                 currentDefaults.owner.c_str(),
+                 currentDefaults.deviceName,
+                 currentDefaults.owner,
                  currentDefaults.autoOn ? "Yes" : "No");
     Serial.printf("  Behavior: StatusInterval=%lums, GPS=%s\n",
                  currentDefaults.statusUpdateInterval,
@@ -558,7 +464,7 @@ void verifyAllSettings() {
 
 // === SOUND FEATURE HANDLER ===
 bool handleSoundFeatures(uint8_t feature, const uint8_t* data, size_t length) {
-    Serial.printf("🔧 [SOUND FEATURE] Received: 0x%02X, length: %d\n", feature, length);
+    BMLOG_DEBUG("BTUmbrellaV3", "Sound feature 0x%02X, length: %u", feature, (unsigned)length);
     
     // Handle save settings command (use new dedicated command)
     if (feature == 0x6A) {
@@ -573,10 +479,11 @@ bool handleSoundFeatures(uint8_t feature, const uint8_t* data, size_t length) {
         // IMMEDIATE VERIFICATION: Try to read back what we just saved
         Serial.println("🔍 [IMMEDIATE READ-BACK TEST]");
         preferences.begin(PREFS_NAMESPACE, true); // read-only
-        int savedVersion = preferences.getInt(PREFS_VERSION_KEY, -1);
-        bool savedSecPalOff = preferences.getBool("secPalOff", false);
-        Serial.printf("  Read-back version: %d (should be 1)\n", savedVersion);
-        Serial.printf("  Read-back secPalOff: %s\n", savedSecPalOff ? "true" : "false");
+        std::vector<uint8_t> payload;
+        bool readBack = settingsRecord.load(payload) && payload == encodeUmbrellaSettings();
+        Serial.printf("  Read-back version: %d (should be %d), commit %u\n", settingsRecord.getLoadedVersion(),
+                     UMBRELLA_SETTINGS_VERSION, (unsigned)settingsRecord.getSequence());
+        Serial.printf("  Read-back matches: %s\n", readBack ? "true" : "false");
         preferences.end();
         
         return true;
@@ -694,6 +601,7 @@ bool handleSoundFeatures(uint8_t feature, const uint8_t* data, size_t length) {
         case 0x43: // Amplitude (was 0x0B)
             if (length >= sizeof(int) + 1) {
                 memcpy(&soundSettings.amplitude, data + 1, sizeof(int));
+                soundTask.requestLevels(soundSettings.amplitude, soundSettings.noiseThreshold);
                 Serial.printf("✅ Amplitude: %d\n", soundSettings.amplitude);
                 return true;
             }
@@ -702,6 +610,7 @@ bool handleSoundFeatures(uint8_t feature, const uint8_t* data, size_t length) {
         case 0x44: // Noise Threshold (was 0x0C)
             if (length >= sizeof(int) + 1) {
                 memcpy(&soundSettings.noiseThreshold, data + 1, sizeof(int));
+                soundTask.requestLevels(soundSettings.amplitude, soundSettings.noiseThreshold);
                 Serial.printf("✅ Noise Threshold: %d\n", soundSettings.noiseThreshold);
                 return true;
             }
@@ -1001,400 +910,82 @@ void handleConnectionChange(bool connected) {
 }
 
 // === FFT INITIALIZATION ===
+// Once the analysis task is running, changes are applied by the task itself
+// at the next window boundary.
 void initializeFFT(int sampleCount, int samplingFreq) {
-    if (FFT) {
-        delete FFT;
-        delete[] vReal;
-        delete[] vImag;
-    }
-    
-    vReal = new double[sampleCount];
-    vImag = new double[sampleCount];
-    FFT = new ArduinoFFT<double>(vReal, vImag, sampleCount, samplingFreq);
-    
-    Serial.printf("🎵 [FFT] Initialized: %d samples at %d Hz\n", sampleCount, samplingFreq);
+    soundTask.requestReconfigure(sampleCount, samplingFreq);
+    Serial.printf("🎵 [FFT] Configured: %d samples at %d Hz\n", sampleCount, samplingFreq);
 }
 
 // === I2S REINITIALIZATION ===
 void reinitializeI2S(int samplingFreq) {
-    // Uninstall existing I2S driver
-    i2s_driver_uninstall(I2S_PORT);
-    
-    // I2S Microphone Configuration with new sampling frequency
-    i2s_config_t i2s_config = {
-        .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX),
-        .sample_rate = (uint32_t)samplingFreq,
-        .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
-        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
-        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
-        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-        .dma_buf_count = 8,
-        .dma_buf_len = 1024,
-        .use_apll = false
-    };
-
-    i2s_pin_config_t pin_config = {
-        .bck_io_num = I2S_SCK_PIN,
-        .ws_io_num = I2S_WS_PIN,
-        .data_out_num = I2S_PIN_NO_CHANGE,
-        .data_in_num = I2S_SD_PIN
-    };
-
-    esp_err_t err = i2s_driver_install(I2S_PORT, &i2s_config, 0, NULL);
-    if (err != ESP_OK) {
-        Serial.printf("❌ I2S driver reinstall failed: %s\n", esp_err_to_name(err));
-        return;
-    }
-    i2s_set_pin(I2S_PORT, &pin_config);
-    
-    // Update current frequency and reinitialize FFT
+    // Retune the I2S clock and FFT bins; the driver stays installed
     soundSettings.samplingFrequency = samplingFreq;
     initializeFFT(soundSettings.sampleCount, samplingFreq);
     
-    Serial.printf("🎤 I2S reinitialized with sampling frequency: %d Hz\n", samplingFreq);
+    Serial.printf("🎤 I2S sampling frequency set to %d Hz\n", samplingFreq);
 }
 
 // === I2S INITIALIZATION ===
 void initializeI2S() {
-    i2s_config_t i2s_config = {
-        .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX),
-        .sample_rate = (uint32_t)soundSettings.samplingFrequency,
-        .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
-        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
-        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
-        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-        .dma_buf_count = 8,
-        .dma_buf_len = 1024,
-        .use_apll = false
-    };
-
-    i2s_pin_config_t pin_config = {
-        .bck_io_num = I2S_SCK_PIN,
-        .ws_io_num = I2S_WS_PIN,
-        .data_out_num = I2S_PIN_NO_CHANGE,
-        .data_in_num = I2S_SD_PIN
-    };
-
-    esp_err_t err = i2s_driver_install(I2S_PORT, &i2s_config, 0, NULL);
-    if (err != ESP_OK) {
-        Serial.printf("❌ I2S driver install failed: %s\n", esp_err_to_name(err));
+    if (!micSource.begin(soundSettings.samplingFrequency)) {
+        Serial.println("❌ I2S driver install failed");
         while (true);
     }
-    i2s_set_pin(I2S_PORT, &pin_config);
     Serial.printf("🎤 I2S microphone initialized at %d Hz\n", soundSettings.samplingFrequency);
 }
 
 // === ADVANCED SOUND VISUALIZATION ===
+// Capture and analysis run in soundTask (BMSound); here we only draw the latest
+// feature snapshot, so LED/BLE work in loop() never delays the microphone.
 void handleSoundVisualization() {
-    // Ensure FFT is initialized
-    if (!FFT || !vReal || !vImag) {
-        Serial.println("❌ FFT not initialized, skipping analysis");
+    if (!soundTask.isRunning()) {
+        BMLOG_WARN("BTUmbrellaV3", "Sound analysis not running, skipping visualization");
         return;
     }
 
-    // Reset FFT arrays
-    for (int i = 0; i < soundSettings.sampleCount; i++) {
-        vReal[i] = 0;
-        vImag[i] = 0;
+    bool newSnapshot = false;
+    const SoundFeatures& features = soundTask.acquireLatest(&newSnapshot);
+    
+    if (newSnapshot && features.beat) {
+        BMLOG_VERBOSE("BTUmbrellaV3", "Beat detected");
     }
-
-    // Sample audio from INMP441
-    for (int i = 0; i < soundSettings.sampleCount; i++) {
-        int16_t sample;
-        size_t bytes_read;
-        i2s_read(I2S_PORT, &sample, sizeof(sample), &bytes_read, portMAX_DELAY);
-        if (bytes_read > 0) {
-            // Apply gain multiplier early in the chain
-            vReal[i] = (double)sample * soundSettings.gainMultiplier;
-        }
+    // The task owns the levels it adjusts; take them over so they are saved
+    if (newSnapshot && features.gainAdjusted) {
+        soundSettings.amplitude = features.amplitude;
+        BMLOG_DEBUG("BTUmbrellaV3", "Auto-gain adjusted amplitude to: %d", soundSettings.amplitude);
+    }
+    if (newSnapshot && soundSettings.ambientCompensation) {
+        soundSettings.noiseThreshold = features.noiseThreshold;
     }
-
-    // Compute FFT
-    FFT->dcRemoval();
-    FFT->windowing(FFT_WIN_TYP_HAMMING, FFT_FORWARD);
-    FFT->compute(FFT_FORWARD);
-    FFT->complexToMagnitude();
 
     // Get lightShow reference for rendering
     LightShow& lightShow = device.getLightShow();
     
     // Get current state for direction setting
     BMDeviceState& state = device.getState();
-    bool reverseDirection = state.reverseStrip;
-
-    // Calculate frequency range for analysis based on settings
-    int minFreqBin = (soundSettings.frequencyMin * soundSettings.sampleCount) / soundSettings.samplingFrequency;
-    int maxFreqBin = (soundSettings.frequencyMax * soundSettings.sampleCount) / soundSettings.samplingFrequency;
-    minFreqBin = constrain(minFreqBin, 2, soundSettings.sampleCount / 2);
-    maxFreqBin = constrain(maxFreqBin, minFreqBin + 1, soundSettings.sampleCount / 2);
-    
-    // Calculate overall volume for beat detection and auto-gain
-    float totalVolume = 0;
-    for (int i = minFreqBin; i < maxFreqBin; i++) {
-        totalVolume += vReal[i];
-    }
-    float averageVolume = totalVolume / (maxFreqBin - minFreqBin);
-    
-    // Beat detection
-    beatDetected = false;
-    if (soundSettings.beatDetection) {
-        float beatThreshold = previousAverage * (1.0 + soundSettings.beatSensitivity / 100.0);
-        unsigned long currentTime = millis();
-        
-        if (averageVolume > beatThreshold && (currentTime - lastBeatTime) > 100) { // 100ms minimum between beats
-            beatDetected = true;
-            lastBeatTime = currentTime;
-            Serial.println("🎵 Beat detected!");
-        }
-        previousAverage = averageVolume * 0.9 + previousAverage * 0.1; // Smooth average
-    }
-    
-    // Auto-gain adjustment
-    if (soundSettings.autoGain) {
-        if (averageVolume > recentMax) {
-            recentMax = averageVolume;
-        }
-        
-        unsigned long currentTime = millis();
-        if (currentTime - lastGainAdjust > 2000) { // Adjust every 2 seconds
-            if (recentMax > 0) {
-                float targetAmplitude = 32000; // Target for good visual range
-                float gainAdjustment = targetAmplitude / recentMax;
-                soundSettings.amplitude = (int)(soundSettings.amplitude * gainAdjustment);
-                soundSettings.amplitude = constrain(soundSettings.amplitude, 100, 10000);
-                Serial.printf("🔧 Auto-gain adjusted amplitude to: %d\n", soundSettings.amplitude);
-            }
-            recentMax *= 0.8; // Decay recent max
-            lastGainAdjust = currentTime;
-        }
-    }
-    
-    // Ambient noise compensation
-    if (soundSettings.ambientCompensation) {
-        float ambientLevel = averageVolume * 0.1; // Estimate ambient as 10% of current
-        soundSettings.noiseThreshold = (int)(ambientLevel * 1.5);
-    }
 
-    // Initialize band values
-    float rawBandValues[NUM_STRIPS] = {0};
-    
-    // Calculate frequency ranges for each strip based on mapping mode
-    int stripOrder[NUM_STRIPS];
-    switch (soundSettings.stripMapping) {
-        case 0: // Normal (0,1,2,3,4,5,6,7)
-            for (int i = 0; i < NUM_STRIPS; i++) stripOrder[i] = i;
-            break;
-        case 1: // Bass to Treble (low freq to high freq)
-            for (int i = 0; i < NUM_STRIPS; i++) stripOrder[i] = i;
-            break;
-        case 2: // Treble to Bass (high freq to low freq)
-            for (int i = 0; i < NUM_STRIPS; i++) stripOrder[i] = NUM_STRIPS - 1 - i;
-            break;
-        case 3: // Center out (mid frequencies in center)
-            int centerOut[8] = {3, 4, 2, 5, 1, 6, 0, 7};
-            for (int i = 0; i < NUM_STRIPS; i++) stripOrder[i] = centerOut[i];
-            break;
-    }
-
-    // Map FFT results to LED strips with frequency emphasis
-    for (int i = minFreqBin; i < maxFreqBin; i++) {
-        if (vReal[i] > soundSettings.noiseThreshold) {
-            int bandIndex;
-            
-            if (soundSettings.logarithmicMapping) {
-                // Logarithmic mapping for more musical response
-                float logPos = log(i - minFreqBin + 1) / log(maxFreqBin - minFreqBin);
-                bandIndex = (int)(logPos * NUM_STRIPS);
-            } else {
-                // Linear mapping
-                bandIndex = map(i, minFreqBin, maxFreqBin - 1, 0, NUM_STRIPS - 1);
-            }
-            
-            bandIndex = constrain(bandIndex, 0, NUM_STRIPS - 1);
-            
-            // Apply frequency emphasis
-            float emphasis = 1.0;
-            if (bandIndex < NUM_STRIPS / 3) {
-                // Bass range
-                emphasis = soundSettings.bassEmphasis / 50.0;
-            } else if (bandIndex < 2 * NUM_STRIPS / 3) {
-                // Mid range  
-                emphasis = soundSettings.midEmphasis / 50.0;
-            } else {
-                // Treble range
-                emphasis = soundSettings.trebleEmphasis / 50.0;
-            }
-            
-            rawBandValues[stripOrder[bandIndex]] += vReal[i] * emphasis;
-        }
-    }
-
-    // Apply smoothing
-    for (int strip = 0; strip < NUM_STRIPS; strip++) {
-        if (soundSettings.smoothing) {
-            smoothedValues[strip] = smoothedValues[strip] * (1.0 - soundSettings.smoothingFactor) + 
-                                   rawBandValues[strip] * soundSettings.smoothingFactor;
-            rawBandValues[strip] = smoothedValues[strip];
-        }
-    }
-    
-    // Apply peak hold
     unsigned long currentTime = millis();
-    for (int strip = 0; strip < NUM_STRIPS; strip++) {
-        if (soundSettings.peakHold) {
-            if (rawBandValues[strip] > peakValues[strip]) {
-                peakValues[strip] = rawBandValues[strip];
-                peakTimes[strip] = currentTime;
-            } else if (currentTime - peakTimes[strip] > soundSettings.peakHoldTime) {
-                peakValues[strip] *= 0.95; // Gradual decay
-            }
-            rawBandValues[strip] = max(rawBandValues[strip], peakValues[strip]);
-        }
-    }
+    soundVisualizer.render(features, leds, LEDS_PER_STRIP, primaryPalette, secondaryPalette,
+                           secondaryPaletteOff, state.reverseStrip, currentTime);
 
-    // Update each LED strip with all the visual modes
-    for (int strip = 0; strip < NUM_STRIPS; strip++) {
-        // Calculate bar height with new enhancement features
-        float rawHeight = rawBandValues[strip] / soundSettings.amplitude;
-        
-        // Apply LED multiplier for more sensitivity
-        rawHeight *= soundSettings.ledMultiplier;
-        
-        // Apply double height if enabled
-        if (soundSettings.doubleHeight) {
-            rawHeight *= 2.0;
-        }
-        
-        int barHeight = (int)rawHeight;
-        
-        // Apply min/max LED constraints
-        if (barHeight > 0) {
-            barHeight = max(barHeight, soundSettings.minLEDs);
-        }
-        barHeight = min(barHeight, soundSettings.maxLEDs);
-        
-        // Beat effects
-        bool applyBeatEffect = beatDetected && (soundSettings.strobeOnBeat || soundSettings.pulseOnBeat);
-        
-        for (int i = 0; i < LEDS_PER_STRIP; i++) {
-            CRGB color = CRGB::Black;
-            
-            // Calculate if this LED is part of the sound visualization
-            bool isInSoundVisualization = false;
-            float soundIntensity = 0.0; // 0.0 = background, 1.0 = full sound intensity
-            
-            if (soundSettings.barMode) {
-                if (soundSettings.fillFromCenter) {
-                    // Fill from center outward
-                    int center = LEDS_PER_STRIP / 2;
-                    int halfHeight = barHeight / 2;
-                    isInSoundVisualization = (i >= (center - halfHeight) && i <= (center + halfHeight));
-                    if (isInSoundVisualization) {
-                        // Calculate intensity based on distance from center
-                        int distanceFromCenter = abs(i - center);
-                        soundIntensity = 1.0 - ((float)distanceFromCenter / (halfHeight + 1));
-                    }
-                } else {
-                    // Bar mode - fill from bottom
-                    isInSoundVisualization = (i < barHeight);
-                    if (isInSoundVisualization) {
-                        // Calculate intensity - higher LEDs get more intensity
-                        soundIntensity = (float)(barHeight - i) / barHeight;
-                    }
-                }
-            } else {
-                // Dot mode - only peak
-                if (soundSettings.fillFromCenter) {
-                    int center = LEDS_PER_STRIP / 2;
-                    isInSoundVisualization = (i == center) && (barHeight > 0);
-                    soundIntensity = isInSoundVisualization ? 1.0 : 0.0;
-                } else {
-                    isInSoundVisualization = (i == barHeight - 1) && (barHeight > 0);
-                    soundIntensity = isInSoundVisualization ? 1.0 : 0.0;
-                }
-            }
-            
-            // Calculate palette index for gradient
-            uint8_t paletteIndex;
-            if (soundSettings.intensityMapping && isInSoundVisualization) {
-                // Map volume to color intensity instead of height
-                paletteIndex = map(rawBandValues[strip] / soundSettings.amplitude, 0, LEDS_PER_STRIP, 0, 255);
-            } else {
-                // Normal palette mapping by position
-                paletteIndex = map(i, 0, LEDS_PER_STRIP - 1, 0, 255);
-                paletteIndex += (millis() * soundSettings.colorSpeed / 500) % 256; // Color cycling
-            }
-            
-            if (soundSettings.rainbowMode) {
-                // Rainbow mode overrides palettes
-                uint8_t hue = map(strip, 0, NUM_STRIPS - 1, 0, 255);
-                hue += (millis() * soundSettings.colorSpeed / 100) % 256; // Color cycling
-                if (isInSoundVisualization) {
-                    color = CHSV(hue, 255, 255 * soundIntensity); // Intensity based on sound level
-                } else {
-                    color = CHSV(hue, 255, 64);  // Dimmed for background
-                }
-            } else {
-                // SOUND VISUALIZATION ALWAYS USES PRIMARY PALETTE
-                if (isInSoundVisualization) {
-                    // Get primary palette color and adjust brightness based on sound intensity
-                    color = ColorFromPalette(primaryPalette, paletteIndex);
-                    if (soundIntensity < 1.0) {
-                        // Fade the primary palette color based on sound intensity
-                        color.fadeToBlackBy(255 * (1.0 - soundIntensity));
-                    }
-                } else {
-                    // Background uses secondary palette or black
-                    if (secondaryPaletteOff) {
-                        color = CRGB::Black;
-                        // Debug: occasionally log that we're using black background
-                        static unsigned long lastSecondaryDebug = 0;
-                        if (millis() - lastSecondaryDebug > 2000) { // Every 2 seconds
-                            Serial.printf("🎨 [RENDER DEBUG] Using BLACK background (secondaryPaletteOff=true)\n");
-                            lastSecondaryDebug = millis();
-                        }
-                    } else {
-                        color = ColorFromPalette(secondaryPalette, paletteIndex);
-                        color.fadeToBlackBy(192); // Dim background to 25% brightness
-                        // Debug: occasionally log that we're using secondary palette
-                        static unsigned long lastSecondaryDebug2 = 0;
-                        if (millis() - lastSecondaryDebug2 > 2000) { // Every 2 seconds
-                            Serial.printf("🎨 [RENDER DEBUG] Using secondary palette: %s (secondaryPaletteOff=false)\n",
-                                         LightShow::paletteIdToName(currentSecondaryPaletteId));
-                            lastSecondaryDebug2 = millis();
-                        }
-                    }
-                }
-            }
-            
-            // Beat effects
-            if (applyBeatEffect) {
-                if (soundSettings.strobeOnBeat) {
-                    color = CRGB::White; // Flash white on beat
-                } else if (soundSettings.pulseOnBeat && isInSoundVisualization) {
-                    color.fadeToBlackBy(128); // Dim on beat for pulse effect
-                }
-            }
-            
-            leds[strip][i] = color;
-        }
-    }
-
-    // Apply individual directions if enabled
-    if (soundSettings.individualDirections) {
-        // For now, alternate direction every other strip
-        for (int i = 1; i < NUM_STRIPS; i += 2) {
-            std::reverse(leds[i], leds[i] + LEDS_PER_STRIP);
-        }
-    } else if (reverseDirection) {
-        // Apply global direction
-        for (int i = 0; i < NUM_STRIPS; i++) {
-            std::reverse(leds[i], leds[i] + LEDS_PER_STRIP);
-        }
+    // Debug: occasionally log which background is in use
+#if BMLOG_LEVEL >= BMLOG_LEVEL_VERBOSE
+    static unsigned long lastSecondaryDebug = 0;
+    if (!soundSettings.rainbowMode && currentTime - lastSecondaryDebug > 2000) { // Every 2 seconds
+        BMLOG_VERBOSE("BTUmbrellaV3", "Render background: %s",
+                      secondaryPaletteOff ? "black" : LightShow::paletteIdToName(currentSecondaryPaletteId));
+        lastSecondaryDebug = currentTime;
     }
+#endif
 
     // Let BMDevice handle the rendering
     lightShow.render();
+
+    // Microphone-to-LED latency, measured once per analysis window
+    if (newSnapshot) {
+        soundTask.recordLedUpdate(features);
+    }
 }
 
 // === CHUNKED STATUS UPDATES ===
@@ -1404,7 +995,8 @@ enum UmbrellaStatusUpdateState {
     UMBRELLA_STATUS_BASIC_SENT,
     UMBRELLA_STATUS_SOUND_SENT,
     UMBRELLA_STATUS_ADVANCED_SENT,
-    UMBRELLA_STATUS_SUPER_ADVANCED_SENT
+    UMBRELLA_STATUS_SUPER_ADVANCED_SENT,
+    UMBRELLA_STATUS_AUDIO_STATS_SENT
 };
 UmbrellaStatusUpdateState umbrellaStatusUpdateState = UMBRELLA_STATUS_IDLE;
 unsigned long umbrellaStatusUpdateTimer = 0;
@@ -1414,7 +1006,7 @@ const unsigned long UMBRELLA_STATUS_UPDATE_DELAY = 25; // 25ms delay between chu
 void sendBasicStatus() {
     BMDeviceState& state = device.getState();
     BMDeviceDefaults& defaults = device.getDefaults();
-    DeviceDefaults currentDefaults = defaults.getCurrentDefaults();
+    const DeviceDefaults& currentDefaults = defaults.getCurrentDefaults();
     
     // Create basic status JSON (under 512 bytes)
     StaticJsonDocument<512> doc;
@@ -1447,7 +1039,7 @@ void sendBasicStatus() {
     
     String basicStatus;
     serializeJson(doc, basicStatus);
-    Serial.printf("🌂 [BASIC STATUS] %s\n", basicStatus.c_str());
+    BMLOG_DEBUG("BTUmbrellaV3", "Basic status chunk: %s", basicStatus.c_str());
     
     BMBluetoothHandler& bluetoothHandler = device.getBluetoothHandler();
     bluetoothHandler.sendStatusUpdate(basicStatus);
@@ -1480,7 +1072,7 @@ void sendSoundSettings() {
     
     String soundStatus;
     serializeJson(doc, soundStatus);
-    Serial.printf("🔊 [SOUND SETTINGS] %s\n", soundStatus.c_str());
+    BMLOG_DEBUG("BTUmbrellaV3", "Sound settings chunk: %s", soundStatus.c_str());
     
     BMBluetoothHandler& bluetoothHandler = device.getBluetoothHandler();
     bluetoothHandler.sendStatusUpdate(soundStatus);
@@ -1516,7 +1108,7 @@ void sendAdvancedSoundSettings() {
     
     String advancedStatus;
     serializeJson(doc, advancedStatus);
-    Serial.printf("🎛️ [ADVANCED SOUND] %s\n", advancedStatus.c_str());
+    BMLOG_DEBUG("BTUmbrellaV3", "Advanced sound chunk: %s", advancedStatus.c_str());
     
     BMBluetoothHandler& bluetoothHandler = device.getBluetoothHandler();
     bluetoothHandler.sendStatusUpdate(advancedStatus);
@@ -1548,16 +1140,40 @@ void sendSuperAdvancedSoundSettings() {
     
     String superAdvancedStatus;
     serializeJson(doc, superAdvancedStatus);
-    Serial.printf("🚀 [SUPER ADVANCED SOUND] %s\n", superAdvancedStatus.c_str());
+    BMLOG_DEBUG("BTUmbrellaV3", "Super advanced sound chunk: %s", superAdvancedStatus.c_str());
     
     BMBluetoothHandler& bluetoothHandler = device.getBluetoothHandler();
     bluetoothHandler.sendStatusUpdate(superAdvancedStatus);
 }
 
+// Function to send audio pipeline performance (latency target: < 30ms)
+void sendAudioStats() {
+    StaticJsonDocument<256> doc;
+    
+    doc["type"] = "audioStats";
+    
+    const SoundLatencyStats& latency = soundTask.getLatencyStats();
+    doc["latencyMs"] = latency.lastUs / 1000.0;
+    doc["latencyAvgMs"] = latency.averageUs / 1000.0;
+    doc["latencyMaxMs"] = latency.maxUs / 1000.0;
+    doc["windowsPerSec"] = soundTask.getWindowsPerSecond();
+    doc["analysisUs"] = soundTask.getAnalysisMicros();
+    
+    String audioStats;
+    serializeJson(doc, audioStats);
+    BMLOG_DEBUG("BTUmbrellaV3", "Audio stats chunk: %s", audioStats.c_str());
+    
+    BMBluetoothHandler& bluetoothHandler = device.getBluetoothHandler();
+    bluetoothHandler.sendStatusUpdate(audioStats);
+    
+    // Max is reported per status interval
+    soundTask.resetLatencyMax();
+}
+
 void sendUmbrellaStatus() {
     umbrellaStatusUpdateState = UMBRELLA_STATUS_START_BASIC;
     umbrellaStatusUpdateTimer = millis();
-    Serial.println("🌂 [CHUNKED STATUS] Starting non-blocking chunked status update...");
+    BMLOG_DEBUG("BTUmbrellaV3", "Starting chunked status update");
 }
 
 void handleStatusUpdate() {
@@ -1599,8 +1215,16 @@ void handleStatusUpdate() {
             break;
             
         case UMBRELLA_STATUS_SUPER_ADVANCED_SENT:
+            if (currentTime - umbrellaStatusUpdateTimer >= UMBRELLA_STATUS_UPDATE_DELAY) {
+                sendAudioStats();
+                umbrellaStatusUpdateState = UMBRELLA_STATUS_AUDIO_STATS_SENT;
+                umbrellaStatusUpdateTimer = currentTime;
+            }
+            break;
+            
+        case UMBRELLA_STATUS_AUDIO_STATS_SENT:
             umbrellaStatusUpdateState = UMBRELLA_STATUS_IDLE;
-            Serial.println("🌂 [CHUNKED STATUS] Completed non-blocking chunked status update!");
+            BMLOG_DEBUG("BTUmbrellaV3", "Chunked status update complete");
             break;
             
         default:
@@ -1643,9 +1267,13 @@ void setup() {
                  secondaryPaletteOff ? "true" : "false");
     Serial.printf("  Rainbow Mode: %s\n", soundSettings.rainbowMode ? "ON" : "OFF");
     
-    // Initialize hardware with loaded settings
+    // Initialize hardware with loaded settings, then hand audio to its own task
     initializeI2S();
     initializeFFT(soundSettings.sampleCount, soundSettings.samplingFrequency);
+    soundTask.requestLevels(soundSettings.amplitude, soundSettings.noiseThreshold);
+    if (!soundTask.begin()) {
+        Serial.println("❌ Failed to start sound analysis task!");
+    }
     
     // CHECKPOINT 2: Validate settings after hardware initialization
     Serial.println("🔍 [CHECKPOINT 2] Settings after hardware init:");
@@ -1703,18 +1331,15 @@ void loop() {
     // Debug power state changes
     static bool lastPowerState = true;
     if (state.power != lastPowerState) {
-        Serial.printf("🔋 [POWER DEBUG] Power changed: %s -> %s\n", 
-                     lastPowerState ? "ON" : "OFF", 
-                     state.power ? "ON" : "OFF");
+        BMLOG_INFO("BTUmbrellaV3", "Power changed: %s -> %s", lastPowerState ? "ON" : "OFF", state.power ? "ON" : "OFF");
         lastPowerState = state.power;
     }
     
     // Check for palette updates
     static AvailablePalettes lastPrimaryPalette = state.currentPalette;
     if (state.currentPalette != lastPrimaryPalette) {
-        Serial.printf("🎨 [PALETTE CHANGE] Primary: %s->%s\n",
-                     LightShow::paletteIdToName(lastPrimaryPalette),
-                     LightShow::paletteIdToName(state.currentPalette));
+        BMLOG_DEBUG("BTUmbrellaV3", "Primary palette: %s -> %s", LightShow::paletteIdToName(lastPrimaryPalette),
+                    LightShow::paletteIdToName(state.currentPalette));
         
         updatePalettesFromBMDevice();
         lastPrimaryPalette = state.currentPalette;
@@ -1728,15 +1353,17 @@ void loop() {
     }
     
     // Debug status
+#if BMLOG_LEVEL >= BMLOG_LEVEL_DEBUG
     static unsigned long lastDebugPrint = 0;
     if (millis() - lastDebugPrint > 5000) {  // Every 5 seconds
-        Serial.printf("🎵 [STATUS] Power: %s, SoundMode: %s\n", 
-                     state.power ? "ON" : "OFF",
-                     soundSettings.soundSensitive ? "ON" : "OFF");
+        BMLOG_DEBUG("BTUmbrellaV3", "Power: %s, SoundMode: %s", state.power ? "ON" : "OFF",
+                    soundSettings.soundSensitive ? "ON" : "OFF");
         lastDebugPrint = millis();
     }
+#endif
     
     // Main visualization logic
+    soundTask.setPaused(!soundSettings.soundSensitive);
     if (soundSettings.soundSensitive) {
         handleSoundVisualization();
     } else {
@@ -1850,7 +1477,7 @@ void loop() {
 // - Save current settings as defaults (0x6A) with comprehensive verification
 // - Factory reset capability (0x65) with complete restoration and verification
 // - Complete settings verification (0x66) showing all 57 parameters organized by category
-// - Automatic 4-part chunked status reporting
+// - Automatic 5-part chunked status reporting (incl. audio latency stats)
 // - Power management
 // - Complete parameter control via Bluetooth with NO conflicts! 
 
@@ -1861,6 +1488,7 @@ void restoreFactoryDefaults() {
     preferences.begin(PREFS_NAMESPACE, false);
     preferences.clear();
     preferences.end();
+    settingsRecord.reset();
     
     // Reset BMDevice to factory defaults using correct API
     bool bmDeviceReset = device.resetToFactoryDefaults();
@@ -1878,10 +1506,8 @@ void restoreFactoryDefaults() {
     soundSettings = SoundSettings(); // Use default constructor values
     
     // Reinitialize with default values
-    if (FFT) {
-        initializeFFT(soundSettings.sampleCount, soundSettings.samplingFrequency);
-        reinitializeI2S(soundSettings.samplingFrequency);
-    }
+    reinitializeI2S(soundSettings.samplingFrequency);
+    soundTask.requestLevels(soundSettings.amplitude, soundSettings.noiseThreshold);
     
     // Update palettes
     updatePalettesFromBMDevice();
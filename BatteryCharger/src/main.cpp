@@ -11,7 +11,10 @@ const int NUM_VOLTAGE_PINS = sizeof(VOLTAGE_PINS) / sizeof(VOLTAGE_PINS[0]);
 #define FEATURES_UUID "12345678-1234-1234-1234-123456789abd"
 #define STATUS_UUID "12345678-1234-1234-1234-123456789abe"
 
-// Custom feature commands for battery charger
+// Custom feature commands for battery charger, in their own namespace
+#define BATTERY_FEATURE_NAMESPACE "battery"
+#define BATTERY_FEATURE_FIRST 0x50
+#define BATTERY_FEATURE_LAST 0x5F
 #define BLE_FEATURE_GET_BATTERY_VOLTAGE 0x50
 #define BLE_FEATURE_SET_CALIBRATION 0x51
 #define BLE_FEATURE_RESET_CALIBRATION 0x52
@@ -58,7 +61,10 @@ unsigned long lastLoopCountReport = 0;
 const unsigned long LOOP_COUNT_REPORT_INTERVAL = 5000;  // Report every 5 seconds
 
 // Forward declarations
-bool handleCustomFeature(uint8_t feature, const uint8_t* data, size_t length);
+void registerBatteryFeatures();
+void handleGetBatteryVoltage(const uint8_t* data, size_t length);
+void handleSetCalibration(const uint8_t* data, size_t length);
+void handleResetCalibration(const uint8_t* data, size_t length);
 void handleConnectionChange(bool connected);
 float getMedian(int readings[], int size);
 
@@ -96,8 +102,8 @@ void setup() {
   Serial.println("Initializing Bluetooth...");
   bmDevice = new BMDevice(DEVICE_NAME, SERVICE_UUID, FEATURES_UUID, STATUS_UUID);
   
-  // Set custom feature handler for battery-specific commands
-  bmDevice->setCustomFeatureHandler(handleCustomFeature);
+  // Register battery-specific commands
+  registerBatteryFeatures();
   bmDevice->setCustomConnectionHandler(handleConnectionChange);
   
   // Register status chunks for periodic battery updates
@@ -156,46 +162,42 @@ void setup() {
   Serial.println("");
 }
 
-// Custom BLE feature handler for battery charger commands
-bool handleCustomFeature(uint8_t feature, const uint8_t* data, size_t length) {
-  switch (feature) {
-    case BLE_FEATURE_GET_BATTERY_VOLTAGE: {
-      // Send current battery voltage readings for all pins
-      String voltageData = "";
-      for (int i = 0; i < NUM_VOLTAGE_PINS; i++) {
-        if (i > 0) voltageData += "|";
-        voltageData += "P" + String(VOLTAGE_PINS[i]) + ":" + String(latestBatteryVoltage[i], 3) + "V";
-      }
-      bmDevice->getBluetoothHandler().sendStatusUpdate("BATTERY_VOLTAGES:" + voltageData);
-      Serial.println("[BLE] Sent all battery voltages: " + voltageData);
-      return true;
-    }
-    
-    case BLE_FEATURE_SET_CALIBRATION: {
-      if (length == 4) {
-        // Receive new calibration factor as float
-        float newCalibration;
-        memcpy(&newCalibration, data, sizeof(float));
-        if (newCalibration > 0.5 && newCalibration < 2.0) {  // Sanity check
-          // Note: We'd need to make CALIBRATION_FACTOR non-const to modify it
-          Serial.printf("[BLE] Calibration update requested: %.3f (not implemented - restart required)\n", newCalibration);
-          bmDevice->getBluetoothHandler().sendStatusUpdate("CALIBRATION_UPDATE_REQUIRES_RESTART");
-        }
-      }
-      return true;
-    }
-    
-    case BLE_FEATURE_RESET_CALIBRATION: {
-      Serial.println("[BLE] Calibration reset requested (restart required)");
-      bmDevice->getBluetoothHandler().sendStatusUpdate("CALIBRATION_RESET_REQUIRES_RESTART");
-      return true;
-    }
-    
-    default:
-      return false;  // Feature not handled
+// Battery charger commands, each [feature, payload...]
+void registerBatteryFeatures() {
+  BMFeatureRegistry& features = bmDevice->getFeatureRegistry();
+  features.registerNamespace(BATTERY_FEATURE_NAMESPACE, BATTERY_FEATURE_FIRST, BATTERY_FEATURE_LAST);
+  features.registerFeature(BATTERY_FEATURE_NAMESPACE, BLE_FEATURE_GET_BATTERY_VOLTAGE, handleGetBatteryVoltage);
+  features.registerFeature(BATTERY_FEATURE_NAMESPACE, BLE_FEATURE_SET_CALIBRATION, handleSetCalibration, 5, 5);
+  features.registerFeature(BATTERY_FEATURE_NAMESPACE, BLE_FEATURE_RESET_CALIBRATION, handleResetCalibration);
+}
+
+void handleGetBatteryVoltage(const uint8_t* data, size_t length) {
+  // Send current battery voltage readings for all pins
+  String voltageData = "";
+  for (int i = 0; i < NUM_VOLTAGE_PINS; i++) {
+    if (i > 0) voltageData += "|";
+    voltageData += "P" + String(VOLTAGE_PINS[i]) + ":" + String(latestBatteryVoltage[i], 3) + "V";
+  }
+  bmDevice->getBluetoothHandler().sendStatusUpdate("BATTERY_VOLTAGES:" + voltageData);
+  Serial.println("[BLE] Sent all battery voltages: " + voltageData);
+}
+
+void handleSetCalibration(const uint8_t* data, size_t length) {
+  // Receive new calibration factor as float
+  float newCalibration;
+  memcpy(&newCalibration, data + 1, sizeof(float));
+  if (newCalibration > 0.5 && newCalibration < 2.0) {  // Sanity check
+    // Note: We'd need to make CALIBRATION_FACTOR non-const to modify it
+    Serial.printf("[BLE] Calibration update requested: %.3f (not implemented - restart required)\n", newCalibration);
+    bmDevice->getBluetoothHandler().sendStatusUpdate("CALIBRATION_UPDATE_REQUIRES_RESTART");
   }
 }
 
+void handleResetCalibration(const uint8_t* data, size_t length) {
+  Serial.println("[BLE] Calibration reset requested (restart required)");
+  bmDevice->getBluetoothHandler().sendStatusUpdate("CALIBRATION_RESET_REQUIRES_RESTART");
+}
+
 // BLE connection status handler
 void handleConnectionChange(bool connected) {
   if (connected) {
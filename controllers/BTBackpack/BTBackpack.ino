@@ -86,6 +86,11 @@ void sendStatusUpdate()
   doc["current_speed"] = location_service.current_speed();
   JsonObject positionObject = doc.createNestedObject("current_position");
   location_service.current_position().toJson(positionObject);
+  const RadioSchedule &radio = syncController.getRadioSchedule();
+  JsonObject radioObject = doc.createNestedObject("radio");
+  radioObject["espnow_share"] = radio.getShare();
+  radioObject["deferred"] = radio.getStats().deferred;
+  radioObject["dropped"] = radio.getStats().dropped;
   String output;
   serializeJson(doc, output);
 
@@ -324,6 +329,21 @@ void setup()
 
   // Start Sync
   syncController.begin(CURRENT_USER);
+  // Advertise only in the BLE slots, so sync frames aren't lost to it
+  syncController.enableRadioSchedule([](bool bleSlot)
+                                     {
+                                       if (deviceConnected)
+                                       {
+                                         return;
+                                       }
+                                       if (bleSlot)
+                                       {
+                                         BLE.advertise();
+                                       }
+                                       else
+                                       {
+                                         BLE.stopAdvertise();
+                                       } });
 
   location_service.start_tracking_position();
   light_show.brightness(brightness);
@@ -333,6 +353,7 @@ void setup()
 void loop()
 {
   BLE.poll();
+  syncController.update();
   handleButton();
   syncBluetoothSettings();
   unsigned long now = backpackClock.now();
@@ -447,7 +468,8 @@ void handleBackpackFeatures()
 
 void syncBluetoothSettings()
 {
-  if ((millis() - lastBluetoothSync) > DEFAULT_BT_REFRESH_INTERVAL && deviceConnected)
+  if ((millis() - lastBluetoothSync) > DEFAULT_BT_REFRESH_INTERVAL && deviceConnected &&
+      syncController.getRadioSchedule().isBleSlot())
   {
     sendStatusUpdate();
     lastBluetoothSync = millis();
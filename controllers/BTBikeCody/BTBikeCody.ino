@@ -311,6 +311,7 @@ void setup()
 void loop()
 {
   BLE.poll();
+  syncController.update();
   handleEncoderChange();
   yield();
   syncBluetoothSettings();
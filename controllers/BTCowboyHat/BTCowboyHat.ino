@@ -33,7 +33,8 @@ CRGB leds[NUM_LEDS];
 
 static CLEDController &led_controller_1 = FastLED.addLeds<WS2812B, LED_OUTPUT_PIN, COLOR_ORDER>(leds, NUM_LEDS);
 static std::vector<CLEDController *> led_controllers = {&led_controller_1};
-static LightShow light_show(led_controllers);
+static Clock show_clock;
+static LightShow light_show(led_controllers, show_clock);
 
 std::pair<CRGBPalette16, CRGBPalette16> palettes = light_show.getPrimarySecondaryPalettes();
 CRGBPalette16 primaryPalette = palettes.first;
@@ -226,6 +227,7 @@ void setup()
 
   // Start Sync
   syncController.begin(CURRENT_USER);
+  syncController.enableClockSync(show_clock, false);
 
   light_show.brightness(brightness);
   light_show.palette_stream(speed, AP_palette);
@@ -235,6 +237,7 @@ void loop()
 {
 
   BLE.poll();
+  syncController.update();
   syncBluetoothSettings();
   // TODO sync?
   if (!power)
@@ -166,6 +166,7 @@ void setup()
 void loop()
 {
   BLE.poll();
+  syncController.update();
 
   // TODO sync?
   if (!power)
@@ -189,6 +189,7 @@ void setup()
 void loop()
 {
   BLE.poll();
+  syncController.update();
   handleButton();
 
   if (!power)
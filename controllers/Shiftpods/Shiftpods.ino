@@ -7,6 +7,10 @@
 #include "Helpers.h"
 #include "SyncController.h"
 #include <ArduinoJson.h>
+#ifdef CAMP_WIFI_SSID
+#include <CampWifiLink.h>
+#include <UdpMulticastTransport.h>
+#endif
 
 // BT Devices
 bool deviceConnected = false;
@@ -118,6 +122,17 @@ CRGBPalette16 secondaryPalette = palettes.second;
 // Sync Controller
 SyncController syncController(light_show, CURRENT_USER, camp);
 
+#ifdef CAMP_WIFI_SSID
+// Camp network: sync over UDP multicast if it is up at boot, ESP-NOW otherwise
+#ifndef CAMP_WIFI_PASSWORD
+#define CAMP_WIFI_PASSWORD ""
+#endif
+#define CAMP_WIFI_CONNECT_TIMEOUT 10000
+CampWifiLink campWifi(CAMP_WIFI_SSID, CAMP_WIFI_PASSWORD);
+UdpMulticastTransport udpTransport;
+bool syncOverWifi = false;
+#endif
+
 // variables
 int brightness = 25;
 uint16_t speed = 100;
@@ -311,6 +326,17 @@ void setup()
   BLE.advertise();
 
   // Start Sync
+#ifdef CAMP_WIFI_SSID
+  if (campWifi.connect(CAMP_WIFI_CONNECT_TIMEOUT))
+  {
+    syncController.setTransport(udpTransport);
+    syncOverWifi = true;
+  }
+  else
+  {
+    Serial.println("Camp wifi not found, syncing over ESP-NOW");
+  }
+#endif
   syncController.begin("XX");
 
   // Begin Lightshow
@@ -321,6 +347,13 @@ void setup()
 void loop()
 {
   BLE.poll();
+#ifdef CAMP_WIFI_SSID
+  if (syncOverWifi)
+  {
+    campWifi.update_connectivity();
+  }
+#endif
+  syncController.update();
   handleEncoderChange();
   yield();
   syncBluetoothSettings();
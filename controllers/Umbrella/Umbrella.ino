@@ -275,6 +275,7 @@ void setup()
 void loop()
 {
   BLE.poll();
+  syncController.update();
   syncBluetoothSettings();
   if (!power)
   {
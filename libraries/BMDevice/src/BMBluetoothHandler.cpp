@@ -1,32 +1,46 @@
 #include "BMBluetoothHandler.h"
+#include <BMLog.h>
+
+#define HCI_LE_SET_DATA_LENGTH 0x2022
+#define HCI_LE_SET_PHY 0x2032
 
 // Static instance pointer
 BMBluetoothHandler* BMBluetoothHandler::instance_ = nullptr;
 
 BMBluetoothHandler::BMBluetoothHandler(const char* deviceName, const char* serviceUUID, 
                                        const char* featuresUUID, const char* statusUUID)
-    : deviceName_(deviceName), serviceUUID_(serviceUUID), featuresUUID_(featuresUUID), 
-      statusUUID_(statusUUID), deviceConnected_(false), initialized_(false), lastBluetoothSync_(0),
-      service_(nullptr), featuresCharacteristic_(nullptr), statusCharacteristic_(nullptr) {
+    : serviceUUID_(serviceUUID), featuresUUID_(featuresUUID), 
+      statusUUID_(statusUUID), previewUUID_(nullptr), deviceConnected_(false),
+      connectionHandle_(0xffff), linkRequestPending_(false), initialized_(false),
+      lastBluetoothSync_(0), service_(nullptr), featuresCharacteristic_(nullptr), statusCharacteristic_(nullptr),
+      previewCharacteristic_(nullptr) {
+    snprintf(deviceName_, sizeof(deviceName_), "%s", deviceName);
     instance_ = this;
 }
 
 bool BMBluetoothHandler::begin() {
     if (!BLE.begin()) {
-        Serial.println("[BMBluetoothHandler] Starting Bluetooth® Low Energy module failed!");
+        BMLOG_ERROR("BMBluetoothHandler", "Starting Bluetooth® Low Energy module failed!");
         return false;
     }
     
     // Create service and characteristics
-    service_ = new BLEService(serviceUUID_.c_str());
-    featuresCharacteristic_ = new BLECharacteristic(featuresUUID_.c_str(), BLERead | BLEWrite, 512);
-    statusCharacteristic_ = new BLECharacteristic(statusUUID_.c_str(), BLERead | BLENotify, 512);
+    service_ = new BLEService(serviceUUID_);
+    // Writes without response let an app stream uploads and acknowledgements
+    // instead of waiting a round trip for each
+    featuresCharacteristic_ = new BLECharacteristic(featuresUUID_, BLERead | BLEWrite | BLEWriteWithoutResponse,
+                                                    BLE_VALUE_SIZE);
+    statusCharacteristic_ = new BLECharacteristic(statusUUID_, BLERead | BLENotify, BLE_VALUE_SIZE);
     
     // Configure BLE
-    BLE.setLocalName(deviceName_.c_str());
+    BLE.setLocalName(deviceName_);
     BLE.setAdvertisedService(*service_);
     service_->addCharacteristic(*featuresCharacteristic_);
     service_->addCharacteristic(*statusCharacteristic_);
+    if (previewUUID_) {
+        previewCharacteristic_ = new BLECharacteristic(previewUUID_, BLERead | BLENotify, BLE_PREVIEW_VALUE_SIZE);
+        service_->addCharacteristic(*previewCharacteristic_);
+    }
     BLE.addService(*service_);
     
     // Set BLE event handlers
@@ -39,14 +53,59 @@ bool BMBluetoothHandler::begin() {
     
     initialized_ = true;
     
-    Serial.print("[BMBluetoothHandler] BLE initialized for device: ");
-    Serial.println(deviceName_);
+    BMLOG_INFO("BMBluetoothHandler", "BLE initialized for device: %s", deviceName_);
     
     return true;
 }
 
 void BMBluetoothHandler::poll() {
+    if (!initialized_) {
+        return;
+    }
     BLE.poll();
+    // Not from the connection handler: HCI commands poll for their answer,
+    // and the handler runs inside a poll
+    if (linkRequestPending_) {
+        linkRequestPending_ = false;
+        requestFastLink();
+    }
+}
+
+void BMBluetoothHandler::requestFastLink() {
+    if (!deviceConnected_ || connectionHandle_ == 0xffff) {
+        return;
+    }
+    // The controller negotiates both with the phone in the background. A
+    // phone or controller without them (the original ESP32 has neither 2M
+    // nor, on some stacks, DLE) keeps 27-byte packets on 1M, which is what
+    // every transfer is paced for anyway.
+    struct __attribute__((packed)) {
+        uint16_t handle;
+        uint16_t txOctets;
+        uint16_t txTime;
+    } dataLength = {connectionHandle_, BLE_MAX_LL_OCTETS, BLE_MAX_LL_TIME_US};
+    int dataLengthStatus = HCI.sendCommand(HCI_LE_SET_DATA_LENGTH, sizeof(dataLength), &dataLength);
+    
+    struct __attribute__((packed)) {
+        uint16_t handle;
+        uint8_t allPhys;
+        uint8_t txPhys;
+        uint8_t rxPhys;
+        uint16_t options;
+    } phy = {connectionHandle_, 0, BLE_PHY_2M, BLE_PHY_2M, 0};
+    int phyStatus = HCI.sendCommand(HCI_LE_SET_PHY, sizeof(phy), &phy);
+    
+    BMLOG_DEBUG("BMBluetoothHandler", "Requested DLE (status %d) and 2M PHY (status %d) on handle %u",
+                dataLengthStatus, phyStatus, connectionHandle_);
+}
+
+uint16_t BMBluetoothHandler::getMtu() const {
+    return deviceConnected_ && connectionHandle_ != 0xffff ? ATT.mtu(connectionHandle_) : BLE_DEFAULT_MTU;
+}
+
+size_t BMBluetoothHandler::getMaxNotification() const {
+    size_t size = getMtu() - BLE_ATT_NOTIFY_HEADER;
+    return size < BLE_VALUE_SIZE ? size : BLE_VALUE_SIZE;
 }
 
 void BMBluetoothHandler::setFeatureCallback(std::function<void(uint8_t, const uint8_t*, size_t)> callback) {
@@ -57,50 +116,105 @@ void BMBluetoothHandler::setConnectionCallback(std::function<void(bool)> callbac
     connectionCallback_ = callback;
 }
 
+void BMBluetoothHandler::setStatusSentCallback(std::function<void(size_t)> callback) {
+    statusSentCallback_ = callback;
+}
+
+void BMBluetoothHandler::statusSent(size_t length) {
+    if (statusSentCallback_) {
+        statusSentCallback_(length);
+    }
+}
+
 void BMBluetoothHandler::setDeviceName(const char* deviceName) {
-    deviceName_ = String(deviceName);
+    snprintf(deviceName_, sizeof(deviceName_), "%s", deviceName);
     
     // Only update BLE if it's already initialized
     if (initialized_) {
         // Update the BLE local name
-        BLE.setLocalName(deviceName_.c_str());
+        BLE.setLocalName(deviceName_);
         
         // Stop and restart advertising to update the name
         BLE.stopAdvertise();
         BLE.advertise();
     }
     
-    Serial.print("[BMBluetoothHandler] Device name set to: ");
-    Serial.println(deviceName_);
+    BMLOG_DEBUG("BMBluetoothHandler", "Device name set to: %s", deviceName_);
 }
 
-void BMBluetoothHandler::sendStatusUpdate(const String& status) {
+void BMBluetoothHandler::sendStatusUpdate(const char* status) {
     if (deviceConnected_ && statusCharacteristic_) {
-        Serial.print("[BMBluetoothHandler] Sending status update: ");
-        Serial.println(status);
-        statusCharacteristic_->setValue(status.c_str());
+        BMLOG_DEBUG("BMBluetoothHandler", "Sending status update: %s", status);
+        statusCharacteristic_->setValue(status);
+        statusSent(strlen(status));
     }
 }
 
+bool BMBluetoothHandler::sendStatusJson(const JsonDocument& doc) {
+    if (!deviceConnected_ || !statusCharacteristic_) {
+        return true;
+    }
+    size_t length = measureJson(doc);
+    if (length >= sizeof(statusValue_)) {
+        BMLOG_WARN("BMBluetoothHandler", "Status of %u bytes doesn't fit in %u", (unsigned)length,
+                   (unsigned)sizeof(statusValue_));
+        return false;
+    }
+    serializeJson(doc, statusValue_, sizeof(statusValue_));
+    BMLOG_DEBUG("BMBluetoothHandler", "Sending status update: %s", statusValue_);
+    statusCharacteristic_->setValue((const uint8_t*)statusValue_, (int)length);
+    statusSent(length);
+    return true;
+}
+
+void BMBluetoothHandler::sendStatusUpdate(const uint8_t* data, size_t length) {
+    if (deviceConnected_ && statusCharacteristic_) {
+        statusCharacteristic_->setValue(data, length);
+        statusSent(length);
+    }
+}
+
+bool BMBluetoothHandler::sendPreview(const uint8_t* data, size_t length) {
+    if (!previewCharacteristic_ || !deviceConnected_) {
+        return false;
+    }
+    previewCharacteristic_->setValue(data, length);
+    return true;
+}
+
 void BMBluetoothHandler::startAdvertising() {
     if (initialized_) {
         BLE.advertise();
-        Serial.println("[BMBluetoothHandler] Advertising started");
+        BMLOG_DEBUG("BMBluetoothHandler", "Advertising started");
     }
 }
 
 void BMBluetoothHandler::stopAdvertising() {
     if (initialized_) {
         BLE.stopAdvertise();
-        Serial.println("[BMBluetoothHandler] Advertising stopped");
+        BMLOG_DEBUG("BMBluetoothHandler", "Advertising stopped");
     }
 }
 
 void BMBluetoothHandler::onBLEConnected(BLEDevice central) {
     if (instance_) {
-        Serial.print("[BMBluetoothHandler] Connected to central: ");
-        Serial.println(central.address());
+        BMLOG_INFO("BMBluetoothHandler", "Connected to central: %s", central.address().c_str());
         instance_->deviceConnected_ = true;
+        
+        // ArduinoBLE keeps the handle to itself; look it up by address, of
+        // whichever type the central's is
+        unsigned int a[6] = {0};
+        uint8_t address[6] = {0};
+        instance_->connectionHandle_ = 0xffff;
+        if (sscanf(central.address().c_str(), "%x:%x:%x:%x:%x:%x", &a[5], &a[4], &a[3], &a[2], &a[1], &a[0]) == 6) {
+            for (int i = 0; i < 6; i++) {
+                address[i] = (uint8_t)a[i];
+            }
+            for (uint8_t type = 0; type < 4 && instance_->connectionHandle_ == 0xffff; type++) {
+                instance_->connectionHandle_ = ATT.connectionHandle(type, address);
+            }
+        }
+        instance_->linkRequestPending_ = true;
         if (instance_->connectionCallback_) {
             instance_->connectionCallback_(true);
         }
@@ -109,9 +223,10 @@ void BMBluetoothHandler::onBLEConnected(BLEDevice central) {
 
 void BMBluetoothHandler::onBLEDisconnected(BLEDevice central) {
     if (instance_) {
-        Serial.print("[BMBluetoothHandler] Disconnected from central: ");
-        Serial.println(central.address());
+        BMLOG_INFO("BMBluetoothHandler", "Disconnected from central: %s", central.address().c_str());
         instance_->deviceConnected_ = false;
+        instance_->connectionHandle_ = 0xffff;
+        instance_->linkRequestPending_ = false;
         if (instance_->connectionCallback_) {
             instance_->connectionCallback_(false);
         }
@@ -127,25 +242,23 @@ void BMBluetoothHandler::onFeatureWritten(BLEDevice central, BLECharacteristic c
 }
 
 void BMBluetoothHandler::processFeatureData(const uint8_t* buffer, size_t length) {
-    Serial.print("[BMBluetoothHandler] Data length: ");
-    Serial.println(length);
-    Serial.print("[BMBluetoothHandler] Raw buffer: ");
-    for (size_t i = 0; i < length; ++i) {
-        Serial.print("0x"); 
-        Serial.print(buffer[i], HEX); 
-        Serial.print(" ");
-    }
-    Serial.println();
+    BMLOG_DEBUG("BMBluetoothHandler", "Data length: %u", (unsigned)length);
+#if BMLOG_LEVEL >= BMLOG_LEVEL_VERBOSE
+    char hex[3 * 32 + 1] = "";
+    for (size_t i = 0; i < length && i < 32; ++i) {
+        snprintf(hex + 3 * i, 4, "%02X ", buffer[i]);
+    }
+    BMLOG_VERBOSE("BMBluetoothHandler", "Raw buffer: %s%s", hex, length > 32 ? "..." : "");
+#endif
     
     if (length > 0) {
         uint8_t feature = buffer[0];
-        Serial.print("[BMBluetoothHandler] Received feature: 0x");
-        Serial.println(feature, HEX);
+        BMLOG_DEBUG("BMBluetoothHandler", "Received feature: 0x%X", feature);
         
         if (featureCallback_) {
             featureCallback_(feature, buffer, length);
         }
     } else {
-        Serial.println("[BMBluetoothHandler] No data received!");
+        BMLOG_WARN("BMBluetoothHandler", "No data received!");
     }
 } 
\ No newline at end of file
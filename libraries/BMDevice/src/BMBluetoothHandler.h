@@ -3,6 +3,9 @@
 
 #include <Arduino.h>
 #include <ArduinoBLE.h>
+#include <ArduinoJson.h>
+#include <utility/ATT.h>
+#include <utility/HCI.h>
 #include <functional>
 
 // BLE Feature Constants (from your existing code)
@@ -55,12 +58,43 @@
 #define BLE_FEATURE_GET_WIFI_STATUS 0x36
 #define BLE_FEATURE_SET_WIFI_PASSWORD 0x37
 
+// Status protocol (see BMStatusProtocol.h)
+#define BLE_FEATURE_STATUS_ACK 0x38             // seq u16: the app has this status
+#define BLE_FEATURE_SET_STATUS_FORMAT 0x39      // 0 binary, 1 JSON chunks
+
+// Several commands in one write: count, then count x (feature, length, payload)
+#define BLE_FEATURE_BATCH 0x3A
+// Which namespaces and opcodes this device handles (see BMFeatureRegistry.h)
+#define BLE_FEATURE_GET_CAPABILITIES 0x3B
+// Live pixel preview (BMPreviewProtocol.h): on u8, then optionally samples
+// per strip u8, bits u8, the link's ATT MTU u16 (0: as negotiated) and
+// connection interval u16 (1.25 ms units)
+#define BLE_FEATURE_PREVIEW 0x3C
+// Bulk transfers (BMTransferProtocol.h): a transfer message, app to device
+#define BLE_FEATURE_TRANSFER 0x3D
+
+#define BLE_DEVICE_NAME_SIZE 48     // "BMDevice - " and a 32-character owner
+#define BLE_VALUE_SIZE 512          // Features and status characteristic values
+#define BLE_PREVIEW_VALUE_SIZE 244  // PREVIEW_MAX_MESSAGE
+
+// Link
+#define BLE_DEFAULT_MTU 23          // Until the app exchanges MTUs; ArduinoBLE offers the controller's most
+#define BLE_ATT_NOTIFY_HEADER 3     // Opcode, handle
+#define BLE_MAX_LL_OCTETS 251       // Data Length Extension
+#define BLE_MAX_LL_TIME_US 2120     // 251 octets at 1M
+#define BLE_PHY_2M 0x02
+
 class BMBluetoothHandler {
 public:
+    // The UUIDs are kept as given (literals); the name is copied
     BMBluetoothHandler(const char* deviceName, const char* serviceUUID, 
                        const char* featuresUUID,
                        const char* statusUUID);
     
+    // The preview characteristic is only added if this is called before
+    // begin(); the UUID is kept as given (a literal)
+    void setPreviewUUID(const char* previewUUID) { previewUUID_ = previewUUID; }
+    
     // Initialization
     bool begin();
     void poll();
@@ -68,15 +102,30 @@ public:
     // Callback registration
     void setFeatureCallback(std::function<void(uint8_t feature, const uint8_t* data, size_t length)> callback);
     void setConnectionCallback(std::function<void(bool connected)> callback);
+    // Every status notification, with its length, as it goes out
+    void setStatusSentCallback(std::function<void(size_t length)> callback);
     
     // Status updates
-    void sendStatusUpdate(const String& status);
+    void sendStatusUpdate(const char* status);
+    void sendStatusUpdate(const uint8_t* data, size_t length);
+    // Serialized straight into the status value; false if it doesn't fit
+    bool sendStatusJson(const JsonDocument& doc);
+    // For sketches that build their status in a String
+    void sendStatusUpdate(const String& status) { sendStatusUpdate(status.c_str()); }
+    // One preview notification; false without a preview characteristic
+    bool sendPreview(const uint8_t* data, size_t length);
+    bool hasPreview() const { return previewCharacteristic_ != nullptr; }
     
-    // Device name management
+    // Device name management (truncated to BLE_DEVICE_NAME_SIZE - 1)
     void setDeviceName(const char* deviceName);
+    const char* getDeviceName() const { return deviceName_; }
     
     // Connection state
     bool isConnected() const { return deviceConnected_; }
+    // The ATT MTU the app exchanged, BLE_DEFAULT_MTU until it has
+    uint16_t getMtu() const;
+    // The most one notification carries whole
+    size_t getMaxNotification() const;
     unsigned long getLastSyncTime() const { return lastBluetoothSync_; }
     void updateSyncTime() { lastBluetoothSync_ = millis(); }
 
@@ -89,21 +138,33 @@ private:
     BLEService* service_;
     BLECharacteristic* featuresCharacteristic_;
     BLECharacteristic* statusCharacteristic_;
+    BLECharacteristic* previewCharacteristic_;
     
     // Device info
-    String deviceName_;
-    String serviceUUID_;
-    String featuresUUID_;
-    String statusUUID_;
+    char deviceName_[BLE_DEVICE_NAME_SIZE];
+    const char* serviceUUID_;
+    const char* featuresUUID_;
+    const char* statusUUID_;
+    const char* previewUUID_;
+    
+    // Status values are serialized here, then handed to the characteristic
+    char statusValue_[BLE_VALUE_SIZE];
     
     // Connection state
     bool deviceConnected_;
+    uint16_t connectionHandle_;     // 0xffff when unknown
+    bool linkRequestPending_;
     bool initialized_;
     unsigned long lastBluetoothSync_;
     
     // Callbacks
     std::function<void(uint8_t, const uint8_t*, size_t)> featureCallback_;
     std::function<void(bool)> connectionCallback_;
+    std::function<void(size_t)> statusSentCallback_;
+    
+    void statusSent(size_t length);
+    // 251-byte LL packets and the 2M PHY, where the phone supports them
+    void requestFastLink();
     
     // Static callbacks for BLE events
     static void onBLEConnected(BLEDevice central);
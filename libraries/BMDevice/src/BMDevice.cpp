@@ -1,6 +1,22 @@
 #include "BMDevice.h"
+#include "BMJsonPool.h"
+#include "BMSceneSnapshot.h"
 #include "version.h"
 
+#if defined(ARDUINO_ARCH_ESP32)
+#include <esp_heap_caps.h>
+#endif
+
+HeapStats readHeapStats() {
+    HeapStats stats = {0, 0, 0};
+#if defined(ARDUINO_ARCH_ESP32)
+    stats.freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    stats.minFreeBytes = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    stats.largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+#endif
+    return stats;
+}
+
 BMDevice::BMDevice(const char* deviceName, const char* serviceUUID, const char* featuresUUID, const char* statusUUID)
     : bluetoothHandler_(deviceName, serviceUUID, featuresUUID, statusUUID), lightShow_(std::vector<CLEDController*>(), deviceClock_),
       gpsEnabled_(false),
@@ -8,9 +24,26 @@ BMDevice::BMDevice(const char* deviceName, const char* serviceUUID, const char*
       ownGPSSerial_(false), locationService_(nullptr),
 #endif
       lastBluetoothSync_(0), 
-      statusUpdateInterval_(DEFAULT_BT_REFRESH_INTERVAL), statusUpdateState_(STATUS_IDLE), statusUpdateTimer_(0), currentChunkIndex_(0) {
+      statusUpdateInterval_(DEFAULT_BT_REFRESH_INTERVAL), builtInChunksEnabled_(false), statusChunkCount_(0),
+      statusUpdateState_(STATUS_IDLE), statusUpdateTimer_(0), currentChunkIndex_(0),
+      statusFormat_(STATUS_FORMAT_BINARY), dynamicNaming_(false), previewEncoder_(nullptr), previewOn_(false),
+      previewPending_(false), previewShows_(0), previewPower_(false), transferSourceCount_(0), transferSinkCount_(0),
+      transferReceiver_(nullptr), transferUpload_(nullptr), transferUploadSize_(0), lightShowUpdates_(0),
+      applyingBatch_(false), lightShowPending_(false), bootStage_(BOOT_SETTINGS), bluetoothStarting_(false),
+      bluetoothResult_(-1) {
+    
+    // Initialize LED arrays
+    for (int i = 0; i < MAX_LED_STRIPS; i++) {
+        ledArrays_[i] = nullptr;
+    }
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        bootProfile_.stageMs[i] = BOOT_STAGE_PENDING;
+    }
+    bootProfile_.sceneRestored = false;
     
     // Set up callbacks
+    initializeStateListeners();
+    initializeFeatureHandlers();
     bluetoothHandler_.setFeatureCallback([this](uint8_t feature, const uint8_t* data, size_t length) {
         this->handleFeatureCommand(feature, data, length);
     });
@@ -27,14 +60,26 @@ BMDevice::BMDevice(const char* serviceUUID, const char* featuresUUID, const char
       ownGPSSerial_(false), locationService_(nullptr),
 #endif
       lastBluetoothSync_(0), 
-      statusUpdateInterval_(DEFAULT_BT_REFRESH_INTERVAL), dynamicNaming_(true), statusUpdateState_(STATUS_IDLE), statusUpdateTimer_(0), currentChunkIndex_(0) {
+      statusUpdateInterval_(DEFAULT_BT_REFRESH_INTERVAL), dynamicNaming_(true), builtInChunksEnabled_(false),
+      statusChunkCount_(0), statusUpdateState_(STATUS_IDLE), statusUpdateTimer_(0), currentChunkIndex_(0),
+      statusFormat_(STATUS_FORMAT_BINARY), previewEncoder_(nullptr), previewOn_(false), previewPending_(false),
+      previewShows_(0), previewPower_(false), transferSourceCount_(0), transferSinkCount_(0),
+      transferReceiver_(nullptr), transferUpload_(nullptr), transferUploadSize_(0), lightShowUpdates_(0),
+      applyingBatch_(false), lightShowPending_(false), bootStage_(BOOT_SETTINGS), bluetoothStarting_(false),
+      bluetoothResult_(-1) {
     
     // Initialize LED arrays
     for (int i = 0; i < MAX_LED_STRIPS; i++) {
         ledArrays_[i] = nullptr;
     }
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        bootProfile_.stageMs[i] = BOOT_STAGE_PENDING;
+    }
+    bootProfile_.sceneRestored = false;
     
     // Set up callbacks
+    initializeStateListeners();
+    initializeFeatureHandlers();
     bluetoothHandler_.setFeatureCallback([this](uint8_t feature, const uint8_t* data, size_t length) {
         this->handleFeatureCommand(feature, data, length);
     });
@@ -58,31 +103,37 @@ BMDevice::~BMDevice() {
             ledArrays_[i] = nullptr;
         }
     }
+    
+    delete previewEncoder_;
+    delete transferReceiver_;
+    delete[] transferUpload_;
 }
 
 #ifndef TARGET_ESP32_C6
 void BMDevice::enableGPS(int rxPin, int txPin, int baud) {
-    Serial.printf("[BMDevice] enableGPS() called with pins RX:%d TX:%d @ %d baud\n", rxPin, txPin, baud);
+    BMLOG_DEBUG("BMDevice", "enableGPS() called with pins RX:%d TX:%d @ %d baud", rxPin, txPin, baud);
     
     // Create and configure LocationService
     if (!locationService_) {
-        Serial.println("[BMDevice] Creating new LocationService");
+        BMLOG_DEBUG("BMDevice", "Creating new LocationService");
         locationService_ = new LocationService();
         ownGPSSerial_ = true; // We created the LocationService
     } else {
-        Serial.println("[BMDevice] Using existing LocationService");
+        BMLOG_DEBUG("BMDevice", "Using existing LocationService");
     }
     
     gpsEnabled_ = true;
-    Serial.println("[BMDevice] Calling locationService_->start_tracking_position()");
-    locationService_->start_tracking_position();
+    // Before begin(), the GPS stage starts it once the LEDs are lit
+    if (bootStage_ > BOOT_GPS) {
+        locationService_->start_tracking_position();
+    }
     
     // Also update the defaults to reflect GPS is enabled
     defaults_.setGPSEnabled(true);
     
-    Serial.printf("[BMDevice] GPS enabled using LocationService (pins RX:%d TX:%d @ %d baud)\n", 
-                 rxPin, txPin, baud);
-    Serial.println("[BMDevice] GPS will auto-update position and speed");
+    BMLOG_INFO("BMDevice", "GPS enabled using LocationService (pins RX:%d TX:%d @ %d baud)",
+               rxPin, txPin, baud);
+    BMLOG_INFO("BMDevice", "GPS will auto-update position and speed");
 }
 #endif
 
@@ -92,48 +143,55 @@ void BMDevice::setLocationService(LocationService* locationService) {
     gpsEnabled_ = true;
     ownGPSSerial_ = false;
     
-    // Ensure GPS tracking is started
-    locationService_->start_tracking_position();
+    // Ensure GPS tracking is started, now or at the GPS stage
+    if (bootStage_ > BOOT_GPS) {
+        locationService_->start_tracking_position();
+    }
     
     // Also update the defaults to reflect GPS is enabled
     defaults_.setGPSEnabled(true);
     
-    Serial.println("[BMDevice] Using external LocationService for GPS");
+    BMLOG_INFO("BMDevice", "Using external LocationService for GPS");
 }
 #endif
 
 bool BMDevice::begin() {
     Serial.begin(115200);
-    delay(2000);
+    BMLog::begin();
+    
+    // The settings and scene rebuild the light show once, for the first frame
+    applyingBatch_ = true;
     
     // Initialize defaults system
     if (!defaults_.begin()) {
-        Serial.println("[BMDevice] Failed to initialize defaults!");
+        applyingBatch_ = false;
+        BMLOG_ERROR("BMDevice", "Failed to initialize defaults!");
+        finishBootStage(BOOT_SETTINGS, false);
         return false;
     }
     
     // Load and apply defaults
     if (loadDefaults()) {
-        Serial.println("[BMDevice] Loaded and applied defaults");
+        BMLOG_INFO("BMDevice", "Loaded and applied defaults");
     } else {
-        Serial.println("[BMDevice] Using factory defaults");
+        BMLOG_INFO("BMDevice", "Using factory defaults");
     }
+    finishBootStage(BOOT_SETTINGS);
+    
+    restoreScene();
+    finishBootStage(BOOT_SCENE);
     
     // Handle dynamic naming
     if (dynamicNaming_) {
-        DeviceDefaults currentDefaults = defaults_.getCurrentDefaults();
-        String deviceName;
-        if (currentDefaults.owner.length() > 0) {
-            deviceName = "BMDevice - " + currentDefaults.owner;
-        } else {
-            deviceName = "BMDevice - New";
-        }
+        const DeviceDefaults& currentDefaults = defaults_.getCurrentDefaults();
+        char deviceName[BLE_DEVICE_NAME_SIZE];
+        snprintf(deviceName, sizeof(deviceName), "BMDevice - %s",
+                 currentDefaults.owner[0] ? currentDefaults.owner : "New");
         
-        Serial.print("[BMDevice] Dynamic device name: ");
-        Serial.println(deviceName);
+        BMLOG_INFO("BMDevice", "Dynamic device name: %s", deviceName);
         
         // Update the Bluetooth handler with the new name
-        bluetoothHandler_.setDeviceName(deviceName.c_str());
+        bluetoothHandler_.setDeviceName(deviceName);
     }
     
     // Initialize LED strips from configuration (if using dynamic constructor)
@@ -141,31 +199,46 @@ bool BMDevice::begin() {
         initializeLEDStrips();
     }
     
-    // Initialize Bluetooth
-    if (!bluetoothHandler_.begin()) {
-        return false;
-    }
-    
     // Set initial brightness (may be overridden by defaults). Internal scale is 1-255.
     lightShow_.brightness(deviceState_.brightness);
     
     // Update light show with initial state
+    applyingBatch_ = false;
+    lightShowPending_ = false;
     updateLightShow();
     
+    // First photon: everything after this waits for loop()
+    if (!deviceState_.power) {
+        FastLED.clear();
+        FastLED.show();
+    } else {
+        lightShow_.render();
+    }
+    finishBootStage(BOOT_FIRST_FRAME);
+    
     // Initialize default status chunks for all devices
     initializeDefaultStatusChunks();
     
-    Serial.println("[BMDevice] Setup complete");
+    BMLOG_INFO("BMDevice", "First frame at %u ms; Bluetooth and GPS follow from loop()",
+               bootProfile_.stageMs[BOOT_FIRST_FRAME]);
     return true;
 }
 
 void BMDevice::loop() {
     // Update GPS first and more frequently to prevent data loss
-    if (gpsEnabled_) {
+    if (gpsEnabled_ && bootStage_ > BOOT_GPS) {
         updateGPS();
     }
     
-    bluetoothHandler_.poll();
+    if (bootStage_ > BOOT_BLUETOOTH) {
+        bluetoothHandler_.poll();
+    }
+    
+    // Whatever changed since the last loop, including commands just received
+    deviceState_.publishChanges();
+    
+    // Commit changed defaults to flash once they've settled
+    defaults_.loop();
     
     // Handle chunked status updates
     handleChunkedStatusUpdate();
@@ -180,25 +253,110 @@ void BMDevice::loop() {
     if (!deviceState_.power) {
         FastLED.clear();
         FastLED.show();
-        return;
+    } else {
+        // Render light show
+        lightShow_.render();
     }
     
-    // Render light show
-    lightShow_.render();
+    // After the frame is out, so the preview never holds one up
+    updatePreview();
+    updateTransfer();
+    
+    // And so does the rest of the boot
+    if (bootStage_ < BOOT_STAGE_COUNT) {
+        continueBoot();
+    }
+}
+
+// One stage per loop. Bluetooth starts in a task of its own on the ESP32:
+// bringing the controller up takes hundreds of milliseconds, during which
+// the LEDs keep animating.
+void BMDevice::continueBoot() {
+    switch (bootStage_) {
+        case BOOT_GPS:
+#ifndef TARGET_ESP32_C6
+            if (gpsEnabled_ && locationService_) {
+                locationService_->start_tracking_position();
+            }
+#endif
+            finishBootStage(BOOT_GPS);
+            break;
+        
+        case BOOT_BLUETOOTH:
+            if (!bluetoothStarting_) {
+                bluetoothStarting_ = true;
+                startBluetooth();
+            }
+            if (bluetoothResult_.load() >= 0) {
+                bool started = bluetoothResult_.load() == 1;
+                if (!started) {
+                    // The lights work without it; status says it failed
+                    BMLOG_ERROR("BMDevice", "Bluetooth failed to start");
+                }
+                finishBootStage(BOOT_BLUETOOTH, started);
+            }
+            break;
+        
+        case BOOT_READY:
+            finishBootStage(BOOT_READY);
+            BMLOG_INFO("BMDevice", "Setup complete at %u ms", bootProfile_.stageMs[BOOT_READY]);
+            break;
+        
+        default:
+            break;
+    }
+}
+
+void BMDevice::startBluetooth() {
+#if defined(ARDUINO_ARCH_ESP32)
+    auto task = [](void* device) {
+        BMDevice* self = static_cast<BMDevice*>(device);
+        self->bluetoothResult_.store(self->bluetoothHandler_.begin() ? 1 : 0);
+        vTaskDelete(nullptr);
+    };
+    if (xTaskCreate(task, "bmboot", BOOT_BLUETOOTH_TASK_STACK, this, 1, nullptr) == pdPASS) {
+        return;
+    }
+    BMLOG_WARN("BMDevice", "No task for Bluetooth, starting it inline");
+#endif
+    bluetoothResult_.store(bluetoothHandler_.begin() ? 1 : 0);
+}
+
+void BMDevice::finishBootStage(BootStage stage, bool succeeded) {
+    unsigned long now = millis();
+    bootProfile_.stageMs[stage] = succeeded ? (uint16_t)min(now, (unsigned long)BOOT_STAGE_FAILED - 1)
+                                            : BOOT_STAGE_FAILED;
+    bootStage_ = stage + 1;
+    BMLOG_DEBUG("BMDevice", "Boot stage %u %s at %lu ms", (unsigned)stage, succeeded ? "done" : "failed", now);
+}
+
+// A reset that wasn't a power cycle (brownout, watchdog, crash) shows what
+// was showing rather than the defaults
+void BMDevice::restoreScene() {
+    bootProfile_.sceneRestored = BMSceneSnapshot::restore(deviceState_);
+    if (!bootProfile_.sceneRestored) {
+        return;
+    }
+    int maxScaled = (defaults_.getCurrentDefaults().maxBrightness * 255) / 100;
+    if (deviceState_.brightness > maxScaled) {
+        deviceState_.setBrightness(maxScaled);
+    }
+    BMLOG_INFO("BMDevice", "Restored scene: effect %u, palette %u", (unsigned)deviceState_.currentEffect,
+               (unsigned)deviceState_.currentPalette);
 }
 
 void BMDevice::setBrightness(int brightness) {
-    deviceState_.brightness = constrain(brightness, 1, 255);
+    deviceState_.setBrightness(constrain(brightness, 1, 255));
     lightShow_.brightness(deviceState_.brightness);
 }
 
 void BMDevice::setEffect(LightSceneID effect) {
-    deviceState_.currentEffect = effect;
+    deviceState_.setEffect(effect);
     updateLightShow();
 }
 
 void BMDevice::setPalette(AvailablePalettes palette) {
-    deviceState_.currentPalette = palette;
+    deviceState_.setPalette(palette);
     updateLightShow();
 }
 
@@ -210,118 +368,98 @@ void BMDevice::setCustomConnectionHandler(std::function<void(bool)> handler) {
     customConnectionHandler_ = handler;
 }
 
+void BMDevice::enablePreview(const char* previewUUID) {
+    if (previewEncoder_) {
+        return;
+    }
+    previewEncoder_ = new BMPreviewEncoder();
+    bluetoothHandler_.setPreviewUUID(previewUUID);
+    featureRegistry_.registerFeature(CORE_FEATURE_NAMESPACE, BLE_FEATURE_PREVIEW,
+        [this](const uint8_t* buffer, size_t length) { handlePreviewFeature(buffer, length); }, 2, 8);
+    // Status notifications share the link with the preview
+    bluetoothHandler_.setStatusSentCallback([this](size_t length) {
+        if (previewOn_) {
+            previewGovernor_.statusSent(length, micros());
+        }
+    });
+}
+
 void BMDevice::handleFeatureCommand(uint8_t feature, const uint8_t* buffer, size_t length) {
-    // Allow custom handler to override
-    if (customFeatureHandler_ && customFeatureHandler_(feature, buffer, length)) {
+    if (featureRegistry_.dispatch(feature, buffer, length) || featureRegistry_.has(feature)) {
         return;
     }
     
-    // Handle standard features
-    switch (feature) {
-        case BLE_FEATURE_POWER:
-            handlePowerFeature(buffer, length);
-            break;
-        case BLE_FEATURE_BRIGHTNESS:
-            handleBrightnessFeature(buffer, length);
-            break;
-        case BLE_FEATURE_SPEED:
-            handleSpeedFeature(buffer, length);
-            break;
-        case BLE_FEATURE_DIRECTION:
-            handleDirectionFeature(buffer, length);
-            break;
-        case BLE_FEATURE_ORIGIN:
-            handleOriginFeature(buffer, length);
-            break;
-        case BLE_FEATURE_PALETTE:
-            handlePaletteFeature(buffer, length);
-            break;
-        case BLE_FEATURE_SPEEDOMETER:
-            handleSpeedometerFeature(buffer, length);
-            break;
-        case BLE_FEATURE_EFFECT:
-            handleEffectFeature(buffer, length);
-            break;
-        case BLE_FEATURE_COLOR:
-            handleColorFeature(buffer, length);
-            break;
-        case BLE_FEATURE_WAVE_WIDTH:
-        case BLE_FEATURE_METEOR_COUNT:
-        case BLE_FEATURE_TRAIL_LENGTH:
-        case BLE_FEATURE_HEAT_VARIANCE:
-        case BLE_FEATURE_MIRROR_COUNT:
-        case BLE_FEATURE_COMET_COUNT:
-        case BLE_FEATURE_DROP_RATE:
-        case BLE_FEATURE_CLOUD_SCALE:
-        case BLE_FEATURE_BLOB_COUNT:
-        case BLE_FEATURE_WAVE_COUNT:
-        case BLE_FEATURE_FLASH_INTENSITY:
-        case BLE_FEATURE_FLASH_FREQUENCY:
-        case BLE_FEATURE_EXPLOSION_SIZE:
-        case BLE_FEATURE_SPIRAL_ARMS:
-            handleEffectParameterFeature(feature, buffer, length);
-            break;
-        
-        // Defaults Management Features
-        case BLE_FEATURE_GET_DEFAULTS:
-            handleGetDefaultsFeature(buffer, length);
-            break;
-        case BLE_FEATURE_SET_DEFAULTS:
-            handleSetDefaultsFeature(buffer, length);
-            break;
-        case BLE_FEATURE_SAVE_CURRENT_AS_DEFAULTS:
-            handleSaveCurrentAsDefaultsFeature(buffer, length);
-            break;
-        case BLE_FEATURE_RESET_TO_FACTORY:
-            handleResetToFactoryFeature(buffer, length);
-            break;
-        case BLE_FEATURE_SET_MAX_BRIGHTNESS:
-            handleSetMaxBrightnessFeature(buffer, length);
-            break;
-        case BLE_FEATURE_SET_DEVICE_OWNER:
-            handleSetDeviceOwnerFeature(buffer, length);
-            break;
-        case BLE_FEATURE_SET_AUTO_ON:
-            handleSetAutoOnFeature(buffer, length);
-            break;
-        
-        // GPS Speed configuration commands
-        case BLE_FEATURE_SET_GPS_LOW_SPEED:
-            handleSetGPSLowSpeedFeature(buffer, length);
-            break;
-        case BLE_FEATURE_SET_GPS_TOP_SPEED:
-            handleSetGPSTopSpeedFeature(buffer, length);
-            break;
-        case BLE_FEATURE_SET_GPS_LIGHTSHOW_SPEED_ENABLED:
-            handleSetGPSLightshowSpeedEnabledFeature(buffer, length);
-            break;
-        
-        // Generic device configuration commands
-        case BLE_FEATURE_SET_OWNER:
-            handleSetDeviceOwnerFeature(buffer, length);
-            break;
-        case BLE_FEATURE_SET_DEVICE_TYPE:
-            handleSetDeviceTypeFeature(buffer, length);
-            break;
-        case BLE_FEATURE_CONFIGURE_LED_STRIP:
-            handleConfigureLEDStripFeature(buffer, length);
-            break;
-        case BLE_FEATURE_GET_CONFIGURATION:
-            handleGetConfigurationFeature(buffer, length);
-            break;
-        case BLE_FEATURE_RESET_TO_DEFAULTS:
-            handleResetToDefaultsFeature(buffer, length);
-            break;
-            
-        default:
-            Serial.print("[BMDevice] Unknown feature: 0x");
-            Serial.println(feature, HEX);
-            break;
+    // Opcodes nobody registered go to the sketch's own handler
+    if (customFeatureHandler_ && customFeatureHandler_(feature, buffer, length)) {
+        return;
     }
+    BMLOG_WARN("BMDevice", "Unknown feature: 0x%X", feature);
+}
+
+void BMDevice::initializeFeatureHandlers() {
+    featureRegistry_.registerNamespace(CORE_FEATURE_NAMESPACE, CORE_FEATURE_FIRST, CORE_FEATURE_LAST);
+    auto add = [this](uint8_t feature, void (BMDevice::*handler)(const uint8_t*, size_t), size_t minLength,
+                      size_t maxLength = 512) {
+        featureRegistry_.registerFeature(CORE_FEATURE_NAMESPACE, feature,
+            [this, handler](const uint8_t* buffer, size_t length) { (this->*handler)(buffer, length); },
+            minLength, maxLength);
+    };
+    
+    add(BLE_FEATURE_POWER, &BMDevice::handlePowerFeature, 2);
+    add(BLE_FEATURE_BRIGHTNESS, &BMDevice::handleBrightnessFeature, 5);
+    add(BLE_FEATURE_SPEED, &BMDevice::handleSpeedFeature, 5);
+    add(BLE_FEATURE_DIRECTION, &BMDevice::handleDirectionFeature, 2);
+    add(BLE_FEATURE_ORIGIN, &BMDevice::handleOriginFeature, 9, 9);
+    add(BLE_FEATURE_PALETTE, &BMDevice::handlePaletteFeature, 2);
+    add(BLE_FEATURE_SPEEDOMETER, &BMDevice::handleSpeedometerFeature, 7);
+    add(BLE_FEATURE_EFFECT, &BMDevice::handleEffectFeature, 2);
+    add(BLE_FEATURE_COLOR, &BMDevice::handleColorFeature, 4);
+    for (uint8_t feature = BLE_FEATURE_WAVE_WIDTH; feature <= BLE_FEATURE_SPIRAL_ARMS; feature++) {
+        featureRegistry_.registerFeature(CORE_FEATURE_NAMESPACE, feature,
+            [this, feature](const uint8_t* buffer, size_t length) { handleEffectParameterFeature(feature, buffer, length); },
+            5);
+    }
+    
+    // Defaults Management Features
+    add(BLE_FEATURE_GET_DEFAULTS, &BMDevice::handleGetDefaultsFeature, 1);
+    add(BLE_FEATURE_SET_DEFAULTS, &BMDevice::handleSetDefaultsFeature, 2);
+    add(BLE_FEATURE_SAVE_CURRENT_AS_DEFAULTS, &BMDevice::handleSaveCurrentAsDefaultsFeature, 1);
+    add(BLE_FEATURE_RESET_TO_FACTORY, &BMDevice::handleResetToFactoryFeature, 1);
+    add(BLE_FEATURE_SET_MAX_BRIGHTNESS, &BMDevice::handleSetMaxBrightnessFeature, 5);
+    add(BLE_FEATURE_SET_DEVICE_OWNER, &BMDevice::handleSetDeviceOwnerFeature, 2);
+    add(BLE_FEATURE_SET_AUTO_ON, &BMDevice::handleSetAutoOnFeature, 2);
+    
+    // GPS Speed configuration commands
+    add(BLE_FEATURE_SET_GPS_LOW_SPEED, &BMDevice::handleSetGPSLowSpeedFeature, 5);
+    add(BLE_FEATURE_SET_GPS_TOP_SPEED, &BMDevice::handleSetGPSTopSpeedFeature, 5);
+    add(BLE_FEATURE_SET_GPS_LIGHTSHOW_SPEED_ENABLED, &BMDevice::handleSetGPSLightshowSpeedEnabledFeature, 2);
+    
+    // Generic device configuration commands
+    add(BLE_FEATURE_SET_OWNER, &BMDevice::handleSetDeviceOwnerFeature, 2);
+    add(BLE_FEATURE_SET_DEVICE_TYPE, &BMDevice::handleSetDeviceTypeFeature, 2);
+    add(BLE_FEATURE_CONFIGURE_LED_STRIP, &BMDevice::handleConfigureLEDStripFeature, 6);
+    add(BLE_FEATURE_GET_CONFIGURATION, &BMDevice::handleGetConfigurationFeature, 1);
+    add(BLE_FEATURE_RESET_TO_DEFAULTS, &BMDevice::handleResetToDefaultsFeature, 1);
+    
+    // Protocol
+    add(BLE_FEATURE_STATUS_ACK, &BMDevice::handleStatusAckFeature, 3);
+    add(BLE_FEATURE_SET_STATUS_FORMAT, &BMDevice::handleSetStatusFormatFeature, 2);
+    add(BLE_FEATURE_BATCH, &BMDevice::handleBatchFeature, 2);
+    add(BLE_FEATURE_GET_CAPABILITIES, &BMDevice::handleGetCapabilitiesFeature, 1);
+    add(BLE_FEATURE_TRANSFER, &BMDevice::handleTransferFeature, 1 + TRANSFER_HEADER_SIZE);
 }
 
 void BMDevice::handleConnectionChange(bool connected) {
+    // Each app turns the preview on for itself
+    previewOn_ = false;
+    // Transfers don't outlive the connection
+    transferSender_.abort(nullptr);
+    if (transferReceiver_) {
+        transferReceiver_->reset();
+    }
     if (connected) {
+        // A new app instance knows nothing: start again from a full snapshot
+        statusEncoder_.reset();
         startChunkedStatusUpdate();
     }
     
@@ -341,46 +479,46 @@ void BMDevice::updateGPS() {
         
         // Update device state from LocationService
         if (locationService_->is_current_position_available()) {
-            deviceState_.currentPosition = locationService_->current_position();
-            deviceState_.positionAvailable = true;
-            deviceState_.currentSpeed = locationService_->current_speed();
+            deviceState_.setCurrentPosition(locationService_->current_position());
+            deviceState_.setPositionAvailable(true);
+            deviceState_.setCurrentSpeed(locationService_->current_speed());
             
             // Log position changes
             if (!lastPositionState) {
                 Position pos = deviceState_.currentPosition;
-                Serial.printf("[BMDevice] GPS fix acquired: %.6f, %.6f (speed: %.2f km/h)\n", 
-                            pos.latitude(), pos.longitude(), deviceState_.currentSpeed);
+                BMLOG_INFO("BMDevice", "GPS fix acquired: %.6f, %.6f (speed: %.2f km/h)",
+                           pos.latitude(), pos.longitude(), deviceState_.currentSpeed);
                 lastPositionState = true;
             }
         } else {
-            deviceState_.positionAvailable = false;
+            deviceState_.setPositionAvailable(false);
             if (lastPositionState) {
-                Serial.println("[BMDevice] GPS fix lost");
+                BMLOG_INFO("BMDevice", "GPS fix lost");
                 lastPositionState = false;
             }
         }
         
         // Debug output every 60 seconds
         if (millis() - lastGPSDebug > 60000) {
-            Serial.printf("[BMDevice] GPS Status - Fix: %s, Speed: %.2f km/h\n",
-                         deviceState_.positionAvailable ? "YES" : "NO",
-                         deviceState_.currentSpeed);
+            BMLOG_DEBUG("BMDevice", "GPS Status - Fix: %s, Speed: %.2f km/h",
+                        deviceState_.positionAvailable ? "YES" : "NO",
+                        deviceState_.currentSpeed);
             
             // Check LocationService directly
             bool locAvail = locationService_->is_current_position_available();
             bool initialAvail = locationService_->is_initial_position_available();
-            Serial.printf("[BMDevice] LocationService - Current: %s, Initial: %s\n",
-                         locAvail ? "YES" : "NO", initialAvail ? "YES" : "NO");
+            BMLOG_DEBUG("BMDevice", "LocationService - Current: %s, Initial: %s",
+                        locAvail ? "YES" : "NO", initialAvail ? "YES" : "NO");
             
             if (locAvail) {
                 Position pos = locationService_->current_position();
                 float speed = locationService_->current_speed();
-                Serial.printf("[BMDevice] LocationService pos: %.6f, %.6f, speed: %.2f\n",
-                             pos.latitude(), pos.longitude(), speed);
+                BMLOG_DEBUG("BMDevice", "LocationService pos: %.6f, %.6f, speed: %.2f",
+                            pos.latitude(), pos.longitude(), speed);
             }
             
             if (!deviceState_.positionAvailable) {
-                Serial.println("[BMDevice] No GPS fix yet - move device outdoors with clear sky view");
+                BMLOG_INFO("BMDevice", "No GPS fix yet - move device outdoors with clear sky view");
             }
             
             lastGPSDebug = millis();
@@ -388,8 +526,8 @@ void BMDevice::updateGPS() {
     }
 #else
     // GPS not supported on C6 - just disable GPS features
-    deviceState_.positionAvailable = false;
-    deviceState_.currentSpeed = 0.0f;
+    deviceState_.setPositionAvailable(false);
+    deviceState_.setCurrentSpeed(0.0f);
 #endif
 }
 
@@ -426,8 +564,8 @@ uint16_t BMDevice::calculateEffectiveSpeed() {
     // Debug output
     static unsigned long lastDebugTime = 0;
     if (millis() - lastDebugTime > 5000) { // Debug every 5 seconds
-        Serial.printf("[BMDevice] GPS Speed Mapping: GPS=%.1f km/h, Lightshow Speed=%d ms\n", 
-                     currentGPSSpeed, effectiveSpeed);
+        BMLOG_DEBUG("BMDevice", "GPS Speed Mapping: GPS=%.1f km/h, Lightshow Speed=%d ms",
+                    currentGPSSpeed, effectiveSpeed);
         lastDebugTime = millis();
     }
     
@@ -435,6 +573,12 @@ uint16_t BMDevice::calculateEffectiveSpeed() {
 }
 
 void BMDevice::updateLightShow() {
+    if (applyingBatch_) {
+        lightShowPending_ = true;
+        return;
+    }
+    lightShowUpdates_++;
+    
     // Calculate effective speed (may be GPS-adjusted)
     uint16_t effectiveSpeed = calculateEffectiveSpeed();
     
@@ -518,10 +662,10 @@ void BMDevice::updateLightShow() {
 
 void BMDevice::sendStatusUpdate() {
     // Get current defaults for additional status info
-    DeviceDefaults defaults = defaults_.getCurrentDefaults();
+    const DeviceDefaults& defaults = defaults_.getCurrentDefaults();
     
     // Start with the basic device state JSON
-    StaticJsonDocument<896> doc;
+    JsonDocument doc(BMJsonPool::shared());
     
     // Basic device state. Report brightness as 1-100 (percent) for app
     doc["pwr"] = deviceState_.power;
@@ -530,11 +674,8 @@ void BMDevice::sendStatusUpdate() {
     doc["dir"] = deviceState_.reverseStrip;
     
     const char* effectName = LightShow::effectIdToName(deviceState_.currentEffect);
-    Serial.print("[BMDevice] sendStatusUpdate: Current effect ID: ");
-    Serial.print((uint8_t)deviceState_.currentEffect);
-    Serial.print(" (");
-    Serial.print(effectName);
-    Serial.println(")");
+    BMLOG_DEBUG("BMDevice", "sendStatusUpdate: Current effect ID: %u (%s)", (uint8_t)deviceState_.currentEffect,
+                effectName);
     
     doc["fx"] = effectName;
     doc["pal"] = LightShow::paletteIdToName(deviceState_.currentPalette);
@@ -557,19 +698,18 @@ void BMDevice::sendStatusUpdate() {
     doc["deviceName"] = defaults.deviceName;
     doc["fwVer"] = FIRMWARE_VERSION;
     
-    String status;
-    serializeJson(doc, status);
-    Serial.print("[BMDevice] sendStatusUpdate: Sending status: ");
-    Serial.println(status);
-    bluetoothHandler_.sendStatusUpdate(status);
+    bluetoothHandler_.sendStatusJson(doc);
 }
 
 // Feature handler implementations
 void BMDevice::handlePowerFeature(const uint8_t* buffer, size_t length) {
     if (length >= 2) {
-        deviceState_.power = buffer[1] != 0;
-        Serial.print("[BMDevice] Power set to: ");
-        Serial.println(deviceState_.power ? "On" : "Off");
+        deviceState_.setPower(buffer[1] != 0);
+        BMLOG_DEBUG("BMDevice", "Power set to: %s", deviceState_.power ? "On" : "Off");
+        // Switched off from the app, likely before being unplugged
+        if (!deviceState_.power) {
+            defaults_.flush();
+        }
     }
 }
 
@@ -578,12 +718,11 @@ void BMDevice::handleBrightnessFeature(const uint8_t* buffer, size_t length) {
         int b = 0;
         memcpy(&b, buffer + 1, sizeof(int));
         // App sends 1-100 (percent); scale to internal 1-255 and cap by max brightness
-        DeviceDefaults defaults = defaults_.getCurrentDefaults();
+        const DeviceDefaults& defaults = defaults_.getCurrentDefaults();
         int scaledB = (b * 255) / 100;
         int maxScaled = (defaults.maxBrightness * 255) / 100;
         setBrightness(min(scaledB, maxScaled));
-        Serial.print("[BMDevice] Brightness set to: ");
-        Serial.println(deviceState_.brightness);
+        BMLOG_DEBUG("BMDevice", "Brightness set to: %d", deviceState_.brightness);
     }
 }
 
@@ -591,18 +730,16 @@ void BMDevice::handleSpeedFeature(const uint8_t* buffer, size_t length) {
     if (length >= 5) {
         int s = 0;
         memcpy(&s, buffer + 1, sizeof(int));
-        deviceState_.speed = constrain(s, 5, 200);
-        Serial.print("[BMDevice] Speed set to: ");
-        Serial.println(deviceState_.speed);
+        deviceState_.setSpeed(constrain(s, 5, 200));
+        BMLOG_DEBUG("BMDevice", "Speed set to: %d", deviceState_.speed);
         updateLightShow();
     }
 }
 
 void BMDevice::handleDirectionFeature(const uint8_t* buffer, size_t length) {
     if (length >= 2) {
-        deviceState_.reverseStrip = buffer[1] != 0;
-        Serial.print("[BMDevice] Direction set to: ");
-        Serial.println(deviceState_.reverseStrip ? "Up" : "Down");
+        deviceState_.setReverseStrip(buffer[1] != 0);
+        BMLOG_DEBUG("BMDevice", "Direction set to: %s", deviceState_.reverseStrip ? "Up" : "Down");
         updateLightShow();
     }
 }
@@ -612,11 +749,8 @@ void BMDevice::handleOriginFeature(const uint8_t* buffer, size_t length) {
         float latitude, longitude;
         memcpy(&latitude, buffer + 1, sizeof(float));
         memcpy(&longitude, buffer + 5, sizeof(float));
-        deviceState_.origin = Position(latitude, longitude);
-        Serial.print("[BMDevice] Origin set to: ");
-        Serial.print(latitude, 6);
-        Serial.print(", ");
-        Serial.println(longitude, 6);
+        deviceState_.setOrigin(Position(latitude, longitude));
+        BMLOG_DEBUG("BMDevice", "Origin set to: %.6f, %.6f", latitude, longitude);
     }
 }
 
@@ -626,16 +760,14 @@ void BMDevice::handlePaletteFeature(const uint8_t* buffer, size_t length) {
             uint8_t paletteId = buffer[1];
             if (paletteId <= (uint8_t)AvailablePalettes::moltenmetal) {
                 setPalette((AvailablePalettes)paletteId);
-                Serial.print("[BMDevice] Palette set to ID: ");
-                Serial.println(paletteId);
+                BMLOG_DEBUG("BMDevice", "Palette set to ID: %d", paletteId);
             }
         } else { // String
             char paletteStr[32] = {0};
             memcpy(paletteStr, buffer + 1, min(length - 1, sizeof(paletteStr) - 1));
             AvailablePalettes palette = LightShow::paletteNameToId(paletteStr);
             setPalette(palette);
-            Serial.print("[BMDevice] Palette set to: ");
-            Serial.println(paletteStr);
+            BMLOG_DEBUG("BMDevice", "Palette set to: %s", paletteStr);
         }
     }
 }
@@ -645,29 +777,21 @@ void BMDevice::handleEffectFeature(const uint8_t* buffer, size_t length) {
         if (length == 2) { // ID
             uint8_t effectId = buffer[1];
             if (effectId <= (uint8_t)LightSceneID::spiral_galaxy) {
-                Serial.print("[BMDevice] handleEffectFeature: Received effect ID: ");
-                Serial.println(effectId);
+                BMLOG_DEBUG("BMDevice", "handleEffectFeature: Received effect ID: %d", effectId);
                 setEffect((LightSceneID)effectId);
-                Serial.print("[BMDevice] Effect set to ID: ");
-                Serial.println(effectId);
+                BMLOG_DEBUG("BMDevice", "Effect set to ID: %d", effectId);
             }
         } else { // String
             char effectStr[32] = {0};
             memcpy(effectStr, buffer + 1, min(length - 1, sizeof(effectStr) - 1));
-            Serial.print("[BMDevice] handleEffectFeature: Received effect string: '");
-            Serial.print(effectStr);
-            Serial.println("'");
+            BMLOG_DEBUG("BMDevice", "handleEffectFeature: Received effect string: '%s'", effectStr);
             
             LightSceneID effect = LightShow::effectNameToId(effectStr);
-            Serial.print("[BMDevice] handleEffectFeature: Converted to effect ID: ");
-            Serial.print((uint8_t)effect);
-            Serial.print(" (");
-            Serial.print(LightShow::effectIdToName(effect));
-            Serial.println(")");
+            BMLOG_DEBUG("BMDevice", "handleEffectFeature: Converted to effect ID: %u (%s)", (uint8_t)effect,
+                        LightShow::effectIdToName(effect));
             
             setEffect(effect);
-            Serial.print("[BMDevice] Effect set to: ");
-            Serial.println(effectStr);
+            BMLOG_DEBUG("BMDevice", "Effect set to: %s", effectStr);
         }
     }
 }
@@ -679,77 +803,63 @@ void BMDevice::handleEffectParameterFeature(uint8_t feature, const uint8_t* buff
         
         switch (feature) {
             case BLE_FEATURE_WAVE_WIDTH:
-                deviceState_.waveWidth = constrain(value, 1, 50);
-                Serial.print("[BMDevice] Wave width set to: ");
-                Serial.println(deviceState_.waveWidth);
+                deviceState_.setEffectParameter(feature - BLE_FEATURE_WAVE_WIDTH, constrain(value, 1, 50));
+                BMLOG_DEBUG("BMDevice", "Wave width set to: %d", deviceState_.waveWidth);
                 break;
             case BLE_FEATURE_METEOR_COUNT:
-                deviceState_.meteorCount = constrain(value, 1, 20);
-                Serial.print("[BMDevice] Meteor count set to: ");
-                Serial.println(deviceState_.meteorCount);
+                deviceState_.setEffectParameter(feature - BLE_FEATURE_WAVE_WIDTH, constrain(value, 1, 20));
+                BMLOG_DEBUG("BMDevice", "Meteor count set to: %d", deviceState_.meteorCount);
                 break;
             case BLE_FEATURE_TRAIL_LENGTH:
-                deviceState_.trailLength = constrain(value, 1, 30);
-                Serial.print("[BMDevice] Trail length set to: ");
-                Serial.println(deviceState_.trailLength);
+                deviceState_.setEffectParameter(feature - BLE_FEATURE_WAVE_WIDTH, constrain(value, 1, 30));
+                BMLOG_DEBUG("BMDevice", "Trail length set to: %d", deviceState_.trailLength);
                 break;
             case BLE_FEATURE_HEAT_VARIANCE:
-                deviceState_.heatVariance = constrain(value, 1, 100);
-                Serial.print("[BMDevice] Heat variance set to: ");
-                Serial.println(deviceState_.heatVariance);
+                deviceState_.setEffectParameter(feature - BLE_FEATURE_WAVE_WIDTH, constrain(value, 1, 100));
+                BMLOG_DEBUG("BMDevice", "Heat variance set to: %d", deviceState_.heatVariance);
                 break;
             case BLE_FEATURE_MIRROR_COUNT:
-                deviceState_.mirrorCount = constrain(value, 1, 10);
-                Serial.print("[BMDevice] Mirror count set to: ");
-                Serial.println(deviceState_.mirrorCount);
+                deviceState_.setEffectParameter(feature - BLE_FEATURE_WAVE_WIDTH, constrain(value, 1, 10));
+                BMLOG_DEBUG("BMDevice", "Mirror count set to: %d", deviceState_.mirrorCount);
                 break;
             case BLE_FEATURE_COMET_COUNT:
-                deviceState_.cometCount = constrain(value, 1, 10);
-                Serial.print("[BMDevice] Comet count set to: ");
-                Serial.println(deviceState_.cometCount);
+                deviceState_.setEffectParameter(feature - BLE_FEATURE_WAVE_WIDTH, constrain(value, 1, 10));
+                BMLOG_DEBUG("BMDevice", "Comet count set to: %d", deviceState_.cometCount);
                 break;
             case BLE_FEATURE_DROP_RATE:
-                deviceState_.dropRate = constrain(value, 1, 100);
-                Serial.print("[BMDevice] Drop rate set to: ");
-                Serial.println(deviceState_.dropRate);
+                deviceState_.setEffectParameter(feature - BLE_FEATURE_WAVE_WIDTH, constrain(value, 1, 100));
+                BMLOG_DEBUG("BMDevice", "Drop rate set to: %d", deviceState_.dropRate);
                 break;
             case BLE_FEATURE_CLOUD_SCALE:
-                deviceState_.cloudScale = constrain(value, 1, 50);
-                Serial.print("[BMDevice] Cloud scale set to: ");
-                Serial.println(deviceState_.cloudScale);
+                deviceState_.setEffectParameter(feature - BLE_FEATURE_WAVE_WIDTH, constrain(value, 1, 50));
+                BMLOG_DEBUG("BMDevice", "Cloud scale set to: %d", deviceState_.cloudScale);
                 break;
             case BLE_FEATURE_BLOB_COUNT:
-                deviceState_.blobCount = constrain(value, 1, 20);
-                Serial.print("[BMDevice] Blob count set to: ");
-                Serial.println(deviceState_.blobCount);
+                deviceState_.setEffectParameter(feature - BLE_FEATURE_WAVE_WIDTH, constrain(value, 1, 20));
+                BMLOG_DEBUG("BMDevice", "Blob count set to: %d", deviceState_.blobCount);
                 break;
             case BLE_FEATURE_WAVE_COUNT:
-                deviceState_.waveCount = constrain(value, 1, 15);
-                Serial.print("[BMDevice] Wave count set to: ");
-                Serial.println(deviceState_.waveCount);
+                deviceState_.setEffectParameter(feature - BLE_FEATURE_WAVE_WIDTH, constrain(value, 1, 15));
+                BMLOG_DEBUG("BMDevice", "Wave count set to: %d", deviceState_.waveCount);
                 break;
             case BLE_FEATURE_FLASH_INTENSITY:
-                deviceState_.flashIntensity = constrain(value, 1, 100);
-                Serial.print("[BMDevice] Flash intensity set to: ");
-                Serial.println(deviceState_.flashIntensity);
+                deviceState_.setEffectParameter(feature - BLE_FEATURE_WAVE_WIDTH, constrain(value, 1, 100));
+                BMLOG_DEBUG("BMDevice", "Flash intensity set to: %d", deviceState_.flashIntensity);
                 break;
             case BLE_FEATURE_FLASH_FREQUENCY:
-                deviceState_.flashFrequency = constrain(value, 100, 5000);
-                Serial.print("[BMDevice] Flash frequency set to: ");
-                Serial.println(deviceState_.flashFrequency);
+                deviceState_.setEffectParameter(feature - BLE_FEATURE_WAVE_WIDTH, constrain(value, 100, 5000));
+                BMLOG_DEBUG("BMDevice", "Flash frequency set to: %d", deviceState_.flashFrequency);
                 break;
             case BLE_FEATURE_EXPLOSION_SIZE:
-                deviceState_.explosionSize = constrain(value, 1, 50);
-                Serial.print("[BMDevice] Explosion size set to: ");
-                Serial.println(deviceState_.explosionSize);
+                deviceState_.setEffectParameter(feature - BLE_FEATURE_WAVE_WIDTH, constrain(value, 1, 50));
+                BMLOG_DEBUG("BMDevice", "Explosion size set to: %d", deviceState_.explosionSize);
                 break;
             case BLE_FEATURE_SPIRAL_ARMS:
-                deviceState_.spiralArms = constrain(value, 1, 10);
-                Serial.print("[BMDevice] Spiral arms set to: ");
-                Serial.println(deviceState_.spiralArms);
+                deviceState_.setEffectParameter(feature - BLE_FEATURE_WAVE_WIDTH, constrain(value, 1, 10));
+                BMLOG_DEBUG("BMDevice", "Spiral arms set to: %d", deviceState_.spiralArms);
                 break;
             default:
-                Serial.printf("[BMDevice] Unknown effect parameter: 0x%02X\n", feature);
+                BMLOG_WARN("BMDevice", "Unknown effect parameter: 0x%02X", feature);
                 return;
         }
         updateLightShow();
@@ -759,10 +869,8 @@ void BMDevice::handleEffectParameterFeature(uint8_t feature, const uint8_t* buff
 void BMDevice::handleColorFeature(const uint8_t* buffer, size_t length) {
     if (length >= 4) {
         uint8_t r = buffer[1], g = buffer[2], b = buffer[3];
-        deviceState_.effectColor = CRGB(r, g, b);
-        Serial.print("[BMDevice] Effect color set to RGB(");
-        Serial.print(r); Serial.print(","); Serial.print(g); Serial.print(","); Serial.print(b);
-        Serial.println(")");
+        deviceState_.setEffectColor(CRGB(r, g, b));
+        BMLOG_DEBUG("BMDevice", "Effect color set to RGB(%d,%d,%d)", r, g, b);
         updateLightShow();
     }
 }
@@ -772,30 +880,26 @@ void BMDevice::handleSpeedometerFeature(const uint8_t* buffer, size_t length) {
         uint8_t slowR = buffer[1], slowG = buffer[2], slowB = buffer[3];
         uint8_t fastR = buffer[4], fastG = buffer[5], fastB = buffer[6];
         
-        deviceState_.gpsSlowColor = CRGB(slowR, slowG, slowB);
-        deviceState_.gpsFastColor = CRGB(fastR, fastG, fastB);
+        deviceState_.setSpeedometerColors(CRGB(slowR, slowG, slowB), CRGB(fastR, fastG, fastB));
         
-        Serial.print("[BMDevice] Speedometer colors set - Slow: RGB(");
-        Serial.print(slowR); Serial.print(","); Serial.print(slowG); Serial.print(","); Serial.print(slowB);
-        Serial.print("), Fast: RGB(");
-        Serial.print(fastR); Serial.print(","); Serial.print(fastG); Serial.print(","); Serial.print(fastB);
-        Serial.println(")");
+        BMLOG_DEBUG("BMDevice", "Speedometer colors set - Slow: RGB(%d,%d,%d), Fast: RGB(%d,%d,%d)", slowR, slowG,
+                    slowB, fastR, fastG, fastB);
         
         updateLightShow();
     } else {
-        Serial.println("[BMDevice] Invalid speedometer data length");
+        BMLOG_WARN("BMDevice", "Invalid speedometer data length");
     }
 }
 
 // Defaults Management Methods
 bool BMDevice::loadDefaults() {
-    DeviceDefaults defaults = defaults_.getCurrentDefaults();
+    const DeviceDefaults& defaults = defaults_.getCurrentDefaults();
     applyDefaults();
     return true;
 }
 
 bool BMDevice::saveCurrentAsDefaults() {
-    DeviceDefaults currentDefaults = defaults_.getCurrentDefaults();
+    const DeviceDefaults& currentDefaults = defaults_.getCurrentDefaults();
     DeviceDefaults newDefaults;
     
     // Copy current state to defaults. Internal brightness is 1-255; store as 1-100 for app
@@ -808,18 +912,18 @@ bool BMDevice::saveCurrentAsDefaults() {
     
     // Keep existing identity and behavior settings
     newDefaults.maxBrightness = currentDefaults.maxBrightness;
-    newDefaults.owner = currentDefaults.owner;
-    newDefaults.deviceName = currentDefaults.deviceName;
+    copyDefaultsString(newDefaults.owner, currentDefaults.owner);
+    copyDefaultsString(newDefaults.deviceName, currentDefaults.deviceName);
     newDefaults.autoOn = currentDefaults.autoOn;
     newDefaults.statusUpdateInterval = currentDefaults.statusUpdateInterval;
     newDefaults.gpsEnabled = currentDefaults.gpsEnabled;
     newDefaults.version = currentDefaults.version;
     
-    bool success = defaults_.saveDefaults(newDefaults);
+    bool success = defaults_.saveDefaults(newDefaults) && defaults_.flush();
     if (success) {
-        Serial.println("[BMDevice] Current state saved as defaults");
+        BMLOG_INFO("BMDevice", "Current state saved as defaults");
     } else {
-        Serial.println("[BMDevice] Failed to save current state as defaults");
+        BMLOG_ERROR("BMDevice", "Failed to save current state as defaults");
     }
     
     return success;
@@ -829,15 +933,15 @@ bool BMDevice::resetToFactoryDefaults() {
     bool success = defaults_.resetToFactory();
     if (success) {
         applyDefaults();
-        Serial.println("[BMDevice] Reset to factory defaults and applied");
+        BMLOG_INFO("BMDevice", "Reset to factory defaults and applied");
     } else {
-        Serial.println("[BMDevice] Failed to reset to factory defaults");
+        BMLOG_ERROR("BMDevice", "Failed to reset to factory defaults");
     }
     return success;
 }
 
 void BMDevice::applyDefaults() {
-    DeviceDefaults defaults = defaults_.getCurrentDefaults();
+    const DeviceDefaults& defaults = defaults_.getCurrentDefaults();
     
     // Apply defaults to current state. Stored brightness/max are 1-100; scale to 1-255 for LED
     int scaledB = (defaults.brightness * 255) / 100;
@@ -845,15 +949,15 @@ void BMDevice::applyDefaults() {
     setBrightness(min(scaledB, maxScaled));
     setEffect(defaults.effect);
     setPalette(defaults.palette);
-    deviceState_.speed = defaults.speed;
-    deviceState_.reverseStrip = defaults.reverseDirection;
-    deviceState_.effectColor = defaults.effectColor;
-    deviceState_.power = defaults.autoOn;
+    deviceState_.setSpeed(defaults.speed);
+    deviceState_.setReverseStrip(defaults.reverseDirection);
+    deviceState_.setEffectColor(defaults.effectColor);
+    deviceState_.setPower(defaults.autoOn);
     
     // Apply GPS speed settings
-    deviceState_.gpsLowSpeed = defaults.gpsLowSpeed;
-    deviceState_.gpsTopSpeed = defaults.gpsTopSpeed;
-    deviceState_.gpsLightshowSpeedEnabled = defaults.gpsLightshowSpeedEnabled;
+    deviceState_.setGpsLowSpeed(defaults.gpsLowSpeed);
+    deviceState_.setGpsTopSpeed(defaults.gpsTopSpeed);
+    deviceState_.setGpsLightshowSpeedEnabled(defaults.gpsLightshowSpeedEnabled);
     
     // Apply status update interval
     statusUpdateInterval_ = defaults.statusUpdateInterval;
@@ -861,54 +965,47 @@ void BMDevice::applyDefaults() {
     // Update light show
     updateLightShow();
     
-    Serial.println("[BMDevice] Applied defaults to current state");
+    BMLOG_INFO("BMDevice", "Applied defaults to current state");
 }
 
 void BMDevice::setMaxBrightness(int maxBrightness) {
     bool success = defaults_.setMaxBrightness(maxBrightness);
     if (success) {
         // App sends 1-100; cap internal brightness (1-255) to new max scaled to 1-255
-        DeviceDefaults currentDefaults = defaults_.getCurrentDefaults();
+        const DeviceDefaults& currentDefaults = defaults_.getCurrentDefaults();
         int maxScaled = (currentDefaults.maxBrightness * 255) / 100;
         if (deviceState_.brightness > maxScaled) {
             setBrightness(maxScaled);
         }
-        Serial.print("[BMDevice] Max brightness set to: ");
-        Serial.println(currentDefaults.maxBrightness);
+        BMLOG_DEBUG("BMDevice", "Max brightness set to: %d", currentDefaults.maxBrightness);
     }
 }
 
-void BMDevice::setDeviceOwner(const String& owner) {
+void BMDevice::setDeviceOwner(const char* owner) {
     bool success = defaults_.setOwner(owner);
     if (success) {
-        Serial.print("[BMDevice] Device owner set to: ");
-        Serial.println(owner);
+        BMLOG_DEBUG("BMDevice", "Device owner set to: %s", defaults_.getCurrentDefaults().owner);
     }
 }
 
 // Defaults Feature Handlers
 void BMDevice::handleGetDefaultsFeature(const uint8_t* buffer, size_t length) {
-    String defaultsJson = defaults_.defaultsToJSON();
+    JsonDocument doc(BMJsonPool::shared());
+    defaults_.defaultsToJSON(doc);
     
     // Send as status notification (you might want a separate characteristic for this)
-    bluetoothHandler_.sendStatusUpdate(defaultsJson);
+    bluetoothHandler_.sendStatusJson(doc);
     
-    Serial.println("[BMDevice] Sent defaults over BLE");
-    Serial.print("Defaults JSON: ");
-    Serial.println(defaultsJson);
+    BMLOG_INFO("BMDevice", "Sent defaults over BLE");
 }
 
 void BMDevice::handleSetDefaultsFeature(const uint8_t* buffer, size_t length) {
     if (length > 1) {
-        char jsonStr[1024] = {0};
-        size_t jsonLength = min(length - 1, sizeof(jsonStr) - 1);
-        memcpy(jsonStr, buffer + 1, jsonLength);
-        
-        bool success = defaults_.defaultsFromJSON(String(jsonStr));
+        bool success = defaults_.defaultsFromJSON((const char*)buffer + 1, length - 1);
         if (success) {
-            Serial.println("[BMDevice] Defaults updated from JSON");
+            BMLOG_INFO("BMDevice", "Defaults updated from JSON");
         } else {
-            Serial.println("[BMDevice] Failed to update defaults from JSON");
+            BMLOG_ERROR("BMDevice", "Failed to update defaults from JSON");
         }
     }
 }
@@ -917,20 +1014,26 @@ void BMDevice::handleSaveCurrentAsDefaultsFeature(const uint8_t* buffer, size_t
     bool success = saveCurrentAsDefaults();
     
     // Send confirmation via status
-    String response = success ? "{\"defaultsSaved\":true}" : "{\"defaultsSaved\":false}";
-    bluetoothHandler_.sendStatusUpdate(response);
+    bluetoothHandler_.sendStatusUpdate(success ? "{\"defaultsSaved\":true}" : "{\"defaultsSaved\":false}");
     
-    Serial.println(success ? "[BMDevice] Current state saved as defaults" : "[BMDevice] Failed to save current state as defaults");
+    if (success) {
+        BMLOG_INFO("BMDevice", "Current state saved as defaults");
+    } else {
+        BMLOG_ERROR("BMDevice", "Failed to save current state as defaults");
+    }
 }
 
 void BMDevice::handleResetToFactoryFeature(const uint8_t* buffer, size_t length) {
     bool success = resetToFactoryDefaults();
     
     // Send confirmation via status
-    String response = success ? "{\"factoryReset\":true}" : "{\"factoryReset\":false}";
-    bluetoothHandler_.sendStatusUpdate(response);
+    bluetoothHandler_.sendStatusUpdate(success ? "{\"factoryReset\":true}" : "{\"factoryReset\":false}");
     
-    Serial.println(success ? "[BMDevice] Reset to factory defaults" : "[BMDevice] Failed to reset to factory defaults");
+    if (success) {
+        BMLOG_INFO("BMDevice", "Reset to factory defaults");
+    } else {
+        BMLOG_ERROR("BMDevice", "Failed to reset to factory defaults");
+    }
 }
 
 void BMDevice::handleSetMaxBrightnessFeature(const uint8_t* buffer, size_t length) {
@@ -943,10 +1046,9 @@ void BMDevice::handleSetMaxBrightnessFeature(const uint8_t* buffer, size_t lengt
 
 void BMDevice::handleSetDeviceOwnerFeature(const uint8_t* buffer, size_t length) {
     if (length > 1) {
-        char ownerStr[33] = {0};
-        size_t ownerLength = min(length - 1, sizeof(ownerStr) - 1);
-        memcpy(ownerStr, buffer + 1, ownerLength);
-        setDeviceOwner(String(ownerStr));
+        char ownerStr[DEFAULTS_STRING_MAX + 1];
+        copyDefaultsString(ownerStr, (const char*)buffer + 1, length - 1);
+        setDeviceOwner(ownerStr);
     }
 }
 
@@ -955,8 +1057,7 @@ void BMDevice::handleSetAutoOnFeature(const uint8_t* buffer, size_t length) {
         bool autoOn = buffer[1] != 0;
         bool success = defaults_.setAutoOn(autoOn);
         if (success) {
-            Serial.print("[BMDevice] Auto-on set to: ");
-            Serial.println(autoOn ? "true" : "false");
+            BMLOG_DEBUG("BMDevice", "Auto-on set to: %s", autoOn ? "true" : "false");
         }
     }
 }
@@ -965,14 +1066,9 @@ void BMDevice::handleSetGPSLowSpeedFeature(const uint8_t* buffer, size_t length)
     if (length >= 5) {
         float speed;
         memcpy(&speed, buffer + 1, sizeof(float));
-        bool success = defaults_.setGPSLowSpeed(speed);
-        if (success) {
-            // Update device state
-            deviceState_.gpsLowSpeed = defaults_.getGPSLowSpeed();
-            Serial.print("[BMDevice] GPS low speed set to: ");
-            Serial.print(speed);
-            Serial.println(" km/h");
-        }
+        // Saved to defaults by saveStateToDefaults()
+        deviceState_.setGpsLowSpeed(constrain(speed, 0.0f, 100.0f));
+        BMLOG_DEBUG("BMDevice", "GPS low speed set to: %.2f km/h", speed);
     }
 }
 
@@ -980,37 +1076,24 @@ void BMDevice::handleSetGPSTopSpeedFeature(const uint8_t* buffer, size_t length)
     if (length >= 5) {
         float speed;
         memcpy(&speed, buffer + 1, sizeof(float));
-        bool success = defaults_.setGPSTopSpeed(speed);
-        if (success) {
-            // Update device state
-            deviceState_.gpsTopSpeed = defaults_.getGPSTopSpeed();
-            Serial.print("[BMDevice] GPS top speed set to: ");
-            Serial.print(speed);
-            Serial.println(" km/h");
-        }
+        deviceState_.setGpsTopSpeed(constrain(speed, 0.0f, 200.0f));
+        BMLOG_DEBUG("BMDevice", "GPS top speed set to: %.2f km/h", speed);
     }
 }
 
 void BMDevice::handleSetGPSLightshowSpeedEnabledFeature(const uint8_t* buffer, size_t length) {
     if (length >= 2) {
         bool enabled = buffer[1] != 0;
-        bool success = defaults_.setGPSLightshowSpeedEnabled(enabled);
-        if (success) {
-            // Update device state
-            deviceState_.gpsLightshowSpeedEnabled = enabled;
-            Serial.print("[BMDevice] GPS lightshow speed control ");
-            Serial.println(enabled ? "enabled" : "disabled");
-        }
+        deviceState_.setGpsLightshowSpeedEnabled(enabled);
+        BMLOG_DEBUG("BMDevice", "GPS lightshow speed control %s", enabled ? "enabled" : "disabled");
     }
 }
 
 void BMDevice::handleSetDeviceTypeFeature(const uint8_t* buffer, size_t length) {
     if (length > 1) {
-        String deviceType = String((char*)(buffer + 1), length - 1);
-        bool success = defaults_.setDeviceType(deviceType);
+        bool success = defaults_.setDeviceType((const char*)buffer + 1, length - 1);
         if (success) {
-            Serial.print("[BMDevice] Device type set to: ");
-            Serial.println(deviceType);
+            BMLOG_DEBUG("BMDevice", "Device type set to: %s", defaults_.getCurrentDefaults().deviceType);
         }
     }
 }
@@ -1025,16 +1108,22 @@ void BMDevice::handleConfigureLEDStripFeature(const uint8_t* buffer, size_t leng
         
         bool success = defaults_.setLEDStripConfig(stripIndex, pin, numLeds, colorOrder, enabled);
         if (success) {
-            Serial.printf("[BMDevice] LED strip %d configured: Pin %d, %d LEDs, Color order %d, %s\n", 
-                         stripIndex, pin, numLeds, colorOrder, enabled ? "enabled" : "disabled");
+            BMLOG_DEBUG("BMDevice", "LED strip %d configured: Pin %d, %d LEDs, Color order %d, %s",
+                        stripIndex, pin, numLeds, colorOrder, enabled ? "enabled" : "disabled");
         }
     }
 }
 
 void BMDevice::handleGetConfigurationFeature(const uint8_t* buffer, size_t length) {
     // Send configuration as JSON via status notification
-    StaticJsonDocument<2048> doc;
-    DeviceDefaults defaults = defaults_.getCurrentDefaults();
+    JsonDocument doc(BMJsonPool::shared());
+    fillConfiguration(doc);
+    bluetoothHandler_.sendStatusJson(doc);
+    BMLOG_INFO("BMDevice", "Configuration sent via BLE");
+}
+
+void BMDevice::fillConfiguration(JsonDocument& doc) {
+    const DeviceDefaults& defaults = defaults_.getCurrentDefaults();
     
     doc["owner"] = defaults.owner;
     doc["deviceType"] = defaults.deviceType;
@@ -1048,21 +1137,18 @@ void BMDevice::handleGetConfigurationFeature(const uint8_t* buffer, size_t lengt
         strip["colorOrder"] = defaults.ledStrips[i].colorOrder;
         strip["enabled"] = defaults.ledStrips[i].enabled;
     }
-    
-    String configJson;
-    serializeJson(doc, configJson);
-    
-    bluetoothHandler_.sendStatusUpdate(configJson);
-    Serial.println("[BMDevice] Configuration sent via BLE");
 }
 
 void BMDevice::handleResetToDefaultsFeature(const uint8_t* buffer, size_t length) {
     bool success = resetToFactoryDefaults();
     
-    String response = success ? "{\"factoryReset\":true}" : "{\"factoryReset\":false}";
-    bluetoothHandler_.sendStatusUpdate(response);
+    bluetoothHandler_.sendStatusUpdate(success ? "{\"factoryReset\":true}" : "{\"factoryReset\":false}");
     
-    Serial.println(success ? "[BMDevice] Reset to factory defaults" : "[BMDevice] Failed to reset to factory defaults");
+    if (success) {
+        BMLOG_INFO("BMDevice", "Reset to factory defaults");
+    } else {
+        BMLOG_ERROR("BMDevice", "Failed to reset to factory defaults");
+    }
 }
 
 void BMDevice::addLEDStripByPin(int pin, CRGB* ledArray, int numLeds, int colorOrder) {
@@ -1104,19 +1190,19 @@ void BMDevice::addLEDStripByPin(int pin, CRGB* ledArray, int numLeds, int colorO
             break;
 #endif
         default:
-            Serial.printf("[BMDevice] Error: Pin %d not supported. Only pins 5,12,13,14,16,17,18,27", pin);
 #ifndef TARGET_ESP32_C6
-            Serial.print(",32,33");
+            BMLOG_ERROR("BMDevice", "Pin %d not supported. Only pins 5,12,13,14,16,17,18,27,32,33 are supported for LEDs.", pin);
+#else
+            BMLOG_ERROR("BMDevice", "Pin %d not supported. Only pins 5,12,13,14,16,17,18,27 are supported for LEDs.", pin);
 #endif
-            Serial.println(" are supported for LEDs.");
             break;
     }
 }
 
 void BMDevice::initializeLEDStrips() {
-    Serial.println("[BMDevice] Initializing LED strips...");
+    BMLOG_INFO("BMDevice", "Initializing LED strips...");
     
-    DeviceDefaults defaults = defaults_.getCurrentDefaults();
+    const DeviceDefaults& defaults = defaults_.getCurrentDefaults();
     
     for (int i = 0; i < defaults.activeLEDStrips; i++) {
         if (!defaults.ledStrips[i].enabled) continue;
@@ -1131,46 +1217,91 @@ void BMDevice::initializeLEDStrips() {
         // Add LED strip using our wrapper function
         addLEDStripByPin(pin, ledArrays_[i], numLeds, colorOrder);
         
-        Serial.printf("[BMDevice] LED Strip %d: Pin %d, %d LEDs, Color Order %d\n", 
-                     i, pin, numLeds, colorOrder);
+        BMLOG_INFO("BMDevice", "LED Strip %d: Pin %d, %d LEDs, Color Order %d",
+                   i, pin, numLeds, colorOrder);
     }
 }
 
 // Chunked Status Update Implementation
-void BMDevice::registerStatusChunk(const String& type, std::function<void()> sendFunction, const String& description) {
-    StatusChunk chunk;
+const BuiltInStatusChunk BMDevice::builtInStatusChunks_[] = {
+    {"basicStatus", "Core device state and settings", &BMDevice::sendBasicStatusChunk},
+    {"devConfig", "Device configuration and LED setup", &BMDevice::sendDeviceConfigChunk},
+    {"effectParams", "Effect parameters controlled via BLE commands 0x0B-0x19", &BMDevice::sendEffectParametersChunk},
+    {"defaults", "Persistent default settings", &BMDevice::sendDefaultsChunk}
+};
+const size_t BMDevice::builtInStatusChunkCount_ = sizeof(builtInStatusChunks_) / sizeof(builtInStatusChunks_[0]);
+
+bool BMDevice::registerStatusChunk(const char* type, std::function<void()> sendFunction, const char* description) {
+    if (statusChunkCount_ >= STATUS_MAX_CHUNKS) {
+        BMLOG_WARN("BMDevice", "No room for status chunk %s (%d max)", type, STATUS_MAX_CHUNKS);
+        return false;
+    }
+    StatusChunk& chunk = statusChunks_[statusChunkCount_++];
     chunk.type = type;
-    chunk.sendFunction = sendFunction;
     chunk.description = description;
-    statusChunks_.push_back(chunk);
+    chunk.sendFunction = sendFunction;
     
-    Serial.print("[BMDevice] Registered status chunk: ");
-    Serial.print(type);
-    if (description.length() > 0) {
-        Serial.print(" - ");
-        Serial.print(description);
+    BMLOG_DEBUG("BMDevice", "Registered status chunk: %s%s%s", type, description[0] ? " - " : "", description);
+    return true;
+}
+
+size_t BMDevice::countStatusChunks(bool includeBuiltIn) const {
+    return (includeBuiltIn && builtInChunksEnabled_ ? builtInStatusChunkCount_ : 0) + statusChunkCount_;
+}
+
+// Built-in chunks first, then the sketch's
+void BMDevice::sendStatusChunk(size_t index) {
+    size_t builtIn = countStatusChunks(true) - statusChunkCount_;
+    if (index < builtIn) {
+        BMLOG_DEBUG("BMDevice", "Sending chunk %u/%u: %s", (unsigned)(index + 1), (unsigned)countStatusChunks(true),
+                    builtInStatusChunks_[index].type);
+        (this->*builtInStatusChunks_[index].send)();
+    } else {
+        StatusChunk& chunk = statusChunks_[index - builtIn];
+        BMLOG_DEBUG("BMDevice", "Sending chunk %u/%u: %s", (unsigned)(index + 1), (unsigned)countStatusChunks(true),
+                    chunk.type);
+        chunk.sendFunction();
     }
-    Serial.println();
 }
 
 void BMDevice::startChunkedStatusUpdate() {
-    if (statusChunks_.size() == 0) {
+    size_t chunks = countStatusChunks(true);
+    if (statusFormat_ == STATUS_FORMAT_BINARY) {
+        // The binary status stands in for the built-in chunks; a sketch's own
+        // chunks still follow it
+        sendBinaryStatus();
+        chunks = countStatusChunks(false);
+        if (chunks == 0) {
+            return;
+        }
+    } else if (chunks == 0) {
         // Fallback to legacy status update if no chunks registered
         sendStatusUpdate();
         return;
     }
     
     statusUpdateState_ = STATUS_SENDING_CHUNKS;
-    currentChunkIndex_ = 0;
+    // Binary: straight to the sketch's chunks
+    currentChunkIndex_ = statusFormat_ == STATUS_FORMAT_BINARY ? countStatusChunks(true) - statusChunkCount_ : 0;
     statusUpdateTimer_ = millis();
     
-    Serial.printf("[BMDevice] Starting chunked status update (%d chunks)\n", statusChunks_.size());
+    BMLOG_DEBUG("BMDevice", "Starting chunked status update (%u chunks)", (unsigned)chunks);
+}
+
+void BMDevice::setStatusFormat(StatusFormat format) {
+    statusFormat_ = format;
+    statusEncoder_.reset();
+    statusUpdateState_ = STATUS_IDLE;
 }
 
 void BMDevice::clearStatusChunks() {
-    statusChunks_.clear();
+    for (size_t i = 0; i < statusChunkCount_; i++) {
+        statusChunks_[i] = StatusChunk();
+    }
+    statusChunkCount_ = 0;
+    builtInChunksEnabled_ = false;
     statusUpdateState_ = STATUS_IDLE;
-    Serial.println("[BMDevice] Cleared all status chunks");
+    BMLOG_DEBUG("BMDevice", "Cleared all status chunks");
 }
 
 void BMDevice::handleChunkedStatusUpdate() {
@@ -1182,13 +1313,9 @@ void BMDevice::handleChunkedStatusUpdate() {
     
     // Check if it's time to send the next chunk
     if (currentTime - statusUpdateTimer_ >= STATUS_UPDATE_DELAY) {
-        if (currentChunkIndex_ < statusChunks_.size()) {
+        if (currentChunkIndex_ < countStatusChunks(true)) {
             // Send current chunk
-            StatusChunk& chunk = statusChunks_[currentChunkIndex_];
-            Serial.printf("[BMDevice] Sending chunk %d/%d: %s\n", 
-                         currentChunkIndex_ + 1, statusChunks_.size(), chunk.type.c_str());
-            
-            chunk.sendFunction();
+            sendStatusChunk(currentChunkIndex_);
             
             // Move to next chunk
             currentChunkIndex_++;
@@ -1196,17 +1323,17 @@ void BMDevice::handleChunkedStatusUpdate() {
         } else {
             // All chunks sent
             statusUpdateState_ = STATUS_IDLE;
-            Serial.println("[BMDevice] Chunked status update complete");
+            BMLOG_DEBUG("BMDevice", "Chunked status update complete");
         }
     }
 }
 
 void BMDevice::sendBasicStatusChunk() {
     // Get current defaults for additional status info
-    DeviceDefaults defaults = defaults_.getCurrentDefaults();
+    const DeviceDefaults& defaults = defaults_.getCurrentDefaults();
     
     // Start with the basic device state JSON
-    StaticJsonDocument<512> doc;
+    JsonDocument doc(BMJsonPool::shared());
     
     // Mark this as basic status chunk
     doc["type"] = "basicStatus";
@@ -1236,19 +1363,30 @@ void BMDevice::sendBasicStatusChunk() {
     // Essential info only (move others to device config chunk)
     doc["maxBri"] = defaults.maxBrightness;
     
-    String status;
-    serializeJson(doc, status);
-    Serial.printf("[BMDevice] Basic status chunk: %s\n", status.c_str());
-    bluetoothHandler_.sendStatusUpdate(status);
+    // Heap, to spot fragmentation
+    HeapStats heap = readHeapStats();
+    JsonObject heapObj = doc.createNestedObject("heap");
+    heapObj["free"] = heap.freeBytes;
+    heapObj["min"] = heap.minFreeBytes;
+    heapObj["blk"] = heap.largestFreeBlock;
+    
+    // Boot stages in ms, BootStage order; BOOT_STAGE_PENDING until reached
+    JsonArray bootArray = doc.createNestedArray("boot");
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        bootArray.add(bootProfile_.stageMs[i]);
+    }
+    doc["restored"] = bootProfile_.sceneRestored;
+    
+    bluetoothHandler_.sendStatusJson(doc);
 }
 
 void BMDevice::sendDeviceConfigChunk() {
-    StaticJsonDocument<512> doc;
+    JsonDocument doc(BMJsonPool::shared());
     
     // Mark this as device configuration chunk
     doc["type"] = "devConfig";
     
-    DeviceDefaults defaults = defaults_.getCurrentDefaults();
+    const DeviceDefaults& defaults = defaults_.getCurrentDefaults();
     
     // Device configuration - abbreviated keys
     doc["devType"] = defaults.deviceType;
@@ -1274,19 +1412,16 @@ void BMDevice::sendDeviceConfigChunk() {
         stripObj["e"] = defaults.ledStrips[i].enabled;       // enabled
     }
     
-    String status;
-    serializeJson(doc, status);
-    Serial.printf("[BMDevice] Device config chunk: %s\n", status.c_str());
-    bluetoothHandler_.sendStatusUpdate(status);
+    bluetoothHandler_.sendStatusJson(doc);
 }
 
 void BMDevice::sendDefaultsChunk() {
-    StaticJsonDocument<512> doc;
+    JsonDocument doc(BMJsonPool::shared());
     
     // Mark this as defaults chunk
     doc["type"] = "defaults";
     
-    DeviceDefaults defaults = defaults_.getCurrentDefaults();
+    const DeviceDefaults& defaults = defaults_.getCurrentDefaults();
     
     // All default settings - abbreviated keys
     doc["dBri"] = defaults.brightness;
@@ -1304,14 +1439,11 @@ void BMDevice::sendDefaultsChunk() {
     // Version info
     doc["ver"] = defaults.version;
     
-    String status;
-    serializeJson(doc, status);
-    Serial.printf("[BMDevice] Defaults chunk: %s\n", status.c_str());
-    bluetoothHandler_.sendStatusUpdate(status);
+    bluetoothHandler_.sendStatusJson(doc);
 }
 
 void BMDevice::sendEffectParametersChunk() {
-    StaticJsonDocument<512> doc;
+    JsonDocument doc(BMJsonPool::shared());
     
     // Mark this as effect parameters chunk
     doc["type"] = "effectParams";
@@ -1338,21 +1470,475 @@ void BMDevice::sendEffectParametersChunk() {
     effectColorObj["g"] = deviceState_.effectColor.g;
     effectColorObj["b"] = deviceState_.effectColor.b;
     
-    String status;
-    serializeJson(doc, status);
-    Serial.printf("[BMDevice] Effect parameters chunk: %s\n", status.c_str());
-    bluetoothHandler_.sendStatusUpdate(status);
+    bluetoothHandler_.sendStatusJson(doc);
 }
 
 void BMDevice::initializeDefaultStatusChunks() {
     // Clear any existing chunks
     clearStatusChunks();
     
-    // Register default chunks that all BMDevice instances will send (using abbreviated types)
-    registerStatusChunk("basicStatus", [this]() { sendBasicStatusChunk(); }, "Core device state and settings");
-    registerStatusChunk("devConfig", [this]() { sendDeviceConfigChunk(); }, "Device configuration and LED setup");
-    registerStatusChunk("effectParams", [this]() { sendEffectParametersChunk(); }, "Effect parameters controlled via BLE commands 0x0B-0x19");
-    registerStatusChunk("defaults", [this]() { sendDefaultsChunk(); }, "Persistent default settings");
+    // The default chunks that all BMDevice instances send (abbreviated types)
+    builtInChunksEnabled_ = true;
+    
+    BMLOG_DEBUG("BMDevice", "Initialized %u default status chunks", (unsigned)builtInStatusChunkCount_);
+} 
+
+// State change listeners: everything that reacts to a change in the device
+// state hangs off the one stream published from loop()
+void BMDevice::initializeStateListeners() {
+    deviceState_.onChange([this](uint32_t fields) { saveStateToDefaults(fields); });
+    deviceState_.onChange([this](uint32_t fields) { pushStatusChanges(fields); });
+    deviceState_.onChange([this](uint32_t fields) { saveScene(fields); });
+}
+
+void BMDevice::pushStatusChanges(uint32_t fields) {
+    if (!(fields & STATUS_EVENT_FIELDS) || !bluetoothHandler_.isConnected()) {
+        return;
+    }
+    if (statusFormat_ == STATUS_FORMAT_BINARY) {
+        sendBinaryStatus();
+    } else {
+        startChunkedStatusUpdate();
+    }
+}
+
+void BMDevice::saveStateToDefaults(uint32_t fields) {
+    // The GPS speed settings persist as soon as they change; the defaults
+    // clamp them (top stays above low), and the state follows
+    if ((fields & STATE_GPS_LOW_SPEED) && deviceState_.gpsLowSpeed != defaults_.getGPSLowSpeed()) {
+        defaults_.setGPSLowSpeed(deviceState_.gpsLowSpeed);
+        deviceState_.setGpsLowSpeed(defaults_.getGPSLowSpeed());
+    }
+    if ((fields & STATE_GPS_TOP_SPEED) && deviceState_.gpsTopSpeed != defaults_.getGPSTopSpeed()) {
+        defaults_.setGPSTopSpeed(deviceState_.gpsTopSpeed);
+        deviceState_.setGpsTopSpeed(defaults_.getGPSTopSpeed());
+    }
+    if ((fields & STATE_GPS_LIGHTSHOW_SPEED) &&
+        deviceState_.gpsLightshowSpeedEnabled != defaults_.isGPSLightshowSpeedEnabled()) {
+        defaults_.setGPSLightshowSpeedEnabled(deviceState_.gpsLightshowSpeedEnabled);
+    }
+}
+
+void BMDevice::saveScene(uint32_t fields) {
+    if (fields & SCENE_SNAPSHOT_FIELDS) {
+        BMSceneSnapshot::save(deviceState_);
+    }
+}
+
+// Binary status (BMStatusProtocol.h): the same values as the four built-in
+// chunks, as dictionary fields
+void BMDevice::fillStatusFields() {
+    const DeviceDefaults& defaults = defaults_.getCurrentDefaults();
+    
+    statusEncoder_.beginSnapshot();
+    
+    // basicStatus
+    statusEncoder_.addU8(STATUS_POWER, deviceState_.power);
+    statusEncoder_.addU8(STATUS_BRIGHTNESS, (deviceState_.brightness * 100) / 255);
+    statusEncoder_.addU16(STATUS_SPEED, deviceState_.speed);
+    statusEncoder_.addU8(STATUS_DIRECTION, deviceState_.reverseStrip);
+    statusEncoder_.addU8(STATUS_EFFECT, (uint8_t)deviceState_.currentEffect);
+    statusEncoder_.addU8(STATUS_PALETTE, (uint8_t)deviceState_.currentPalette);
+    statusEncoder_.addU8(STATUS_GPS_ENABLED, gpsEnabled_);
+    statusEncoder_.addU8(STATUS_POSITION_AVAILABLE, deviceState_.positionAvailable);
+    float gpsSpeed = constrain(deviceState_.currentSpeed * 100.0f, 0.0f, 65535.0f);
+    statusEncoder_.addU16(STATUS_GPS_SPEED, (uint16_t)gpsSpeed);
+    if (deviceState_.positionAvailable) {
+        Position& currentPos = const_cast<Position&>(deviceState_.currentPosition);
+        int32_t lat = (int32_t)lround(currentPos.latitude() * 1e6);
+        int32_t lon = (int32_t)lround(currentPos.longitude() * 1e6);
+        uint8_t position[8];
+        memcpy(position, &lat, 4);
+        memcpy(position + 4, &lon, 4);
+        statusEncoder_.addField(STATUS_POSITION, position, sizeof(position));
+    }
+    statusEncoder_.addU8(STATUS_MAX_BRIGHTNESS, defaults.maxBrightness);
+    HeapStats heap = readHeapStats();
+    statusEncoder_.addU32(STATUS_FREE_HEAP, heap.freeBytes / STATUS_HEAP_GRANULARITY * STATUS_HEAP_GRANULARITY);
+    statusEncoder_.addU32(STATUS_MIN_FREE_HEAP, heap.minFreeBytes / STATUS_HEAP_GRANULARITY * STATUS_HEAP_GRANULARITY);
+    statusEncoder_.addU32(STATUS_LARGEST_FREE_BLOCK,
+                          heap.largestFreeBlock / STATUS_HEAP_GRANULARITY * STATUS_HEAP_GRANULARITY);
+    uint8_t stages[BOOT_STAGE_COUNT * 2];
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        stages[i * 2] = (uint8_t)bootProfile_.stageMs[i];
+        stages[i * 2 + 1] = (uint8_t)(bootProfile_.stageMs[i] >> 8);
+    }
+    statusEncoder_.addField(STATUS_BOOT_PROFILE, stages, sizeof(stages));
+    statusEncoder_.addU8(STATUS_SCENE_RESTORED, bootProfile_.sceneRestored);
+    
+    // devConfig
+    statusEncoder_.addString(STATUS_DEVICE_TYPE, defaults.deviceType);
+    statusEncoder_.addU8(STATUS_AUTO_ON, defaults.autoOn);
+    statusEncoder_.addU32(STATUS_INTERVAL, defaults.statusUpdateInterval);
+    statusEncoder_.addString(STATUS_OWNER, defaults.owner);
+    statusEncoder_.addString(STATUS_DEVICE_NAME, defaults.deviceName);
+    statusEncoder_.addString(STATUS_FIRMWARE, FIRMWARE_VERSION);
+    uint8_t strips[MAX_LED_STRIPS * 6];
+    size_t stripsLength = 0;
+    for (int i = 0; i < defaults.activeLEDStrips && i < MAX_LED_STRIPS; i++) {
+        const LEDStripConfig& strip = defaults.ledStrips[i];
+        strips[stripsLength++] = i;
+        strips[stripsLength++] = strip.pin;
+        strips[stripsLength++] = (uint8_t)strip.numLeds;
+        strips[stripsLength++] = (uint8_t)(strip.numLeds >> 8);
+        strips[stripsLength++] = strip.colorOrder;
+        strips[stripsLength++] = strip.enabled;
+    }
+    statusEncoder_.addField(STATUS_LED_STRIPS, strips, stripsLength);
+    
+    // effectParams, in BLE feature order
+    for (uint8_t i = 0; i < STATE_EFFECT_PARAMETER_COUNT; i++) {
+        statusEncoder_.addU16(STATUS_EFFECT_PARAMETERS + i, deviceState_.getEffectParameter(i));
+    }
+    statusEncoder_.addField(STATUS_EFFECT_COLOR, deviceState_.effectColor.raw, 3);
+    
+    // defaults
+    statusEncoder_.addU8(STATUS_DEFAULT_BRIGHTNESS, defaults.brightness);
+    statusEncoder_.addU16(STATUS_DEFAULT_SPEED, defaults.speed);
+    statusEncoder_.addU8(STATUS_DEFAULT_PALETTE, (uint8_t)defaults.palette);
+    statusEncoder_.addU8(STATUS_DEFAULT_EFFECT, (uint8_t)defaults.effect);
+    statusEncoder_.addU8(STATUS_DEFAULT_DIRECTION, defaults.reverseDirection);
+    statusEncoder_.addField(STATUS_DEFAULT_COLOR, defaults.effectColor.raw, 3);
+    statusEncoder_.addU8(STATUS_DEFAULTS_VERSION, defaults.version);
+}
+
+void BMDevice::sendBinaryStatus() {
+    fillStatusFields();
+    if (!statusEncoder_.prepare()) {
+        return;  // The app already has all of it
+    }
+    
+    // Fragments go back to back: notifications queue in the stack in order
+    uint8_t message[STATUS_MAX_MESSAGE];
+    size_t capacity = getStatusMessageSize();
+    size_t total = 0;
+    size_t length;
+    while ((length = statusEncoder_.nextFragment(message, capacity)) > 0) {
+        bluetoothHandler_.sendStatusUpdate(message, length);
+        total += length;
+    }
+    BMLOG_DEBUG("BMDevice", "Status %u (base %u): %u bytes",
+                statusEncoder_.getSeq(), statusEncoder_.getAckedSeq(), (unsigned)total);
+}
+
+size_t BMDevice::getStatusMessageSize() const {
+    // A link too small for the largest field keeps the size apps have always
+    // had, and reads the rest of each notification
+    size_t size = bluetoothHandler_.getMaxNotification();
+    if (size < STATUS_MIN_MESSAGE) {
+        return STATUS_DEFAULT_MESSAGE;
+    }
+    return size < STATUS_MAX_MESSAGE ? size : STATUS_MAX_MESSAGE;
+}
+
+void BMDevice::handleStatusAckFeature(const uint8_t* buffer, size_t length) {
+    if (length >= 3) {
+        uint16_t seq = buffer[1] | (buffer[2] << 8);
+        if (!statusEncoder_.acknowledge(seq)) {
+            BMLOG_WARN("BMDevice", "Ignored status ACK %u", seq);
+        }
+    }
+}
+
+void BMDevice::handleSetStatusFormatFeature(const uint8_t* buffer, size_t length) {
+    if (length >= 2) {
+        setStatusFormat(buffer[1] ? STATUS_FORMAT_JSON : STATUS_FORMAT_BINARY);
+        BMLOG_DEBUG("BMDevice", "Status format: %s", buffer[1] ? "JSON" : "binary");
+        startChunkedStatusUpdate();
+    }
+}
+
+void BMDevice::handleBatchFeature(const uint8_t* buffer, size_t length) {
+    if (length < 2 || buffer[1] == 0 || buffer[1] > BATCH_MAX_RECORDS) {
+        BMLOG_WARN("BMDevice", "Invalid batch header");
+        return;
+    }
+    
+    // Check every record before applying any, so a batch applies whole or not at all
+    uint8_t count = buffer[1];
+    size_t offsets[BATCH_MAX_RECORDS];
+    size_t offset = 2;
+    for (uint8_t i = 0; i < count; i++) {
+        if (offset + 2 > length || offset + 2 + buffer[offset + 1] > length ||
+            !isValidBatchRecord(buffer[offset], buffer + offset + 2, buffer[offset + 1])) {
+            BMLOG_WARN("BMDevice", "Rejected batch: record %u of %u is invalid", i, count);
+            return;
+        }
+        offsets[i] = offset;
+        offset += 2 + buffer[offset + 1];
+    }
+    if (offset != length) {
+        BMLOG_WARN("BMDevice", "Rejected batch: trailing bytes");
+        return;
+    }
+    
+    // Each record goes through its usual handler, as [feature, payload...]
+    uint8_t record[1 + 255];
+    applyingBatch_ = true;
+    lightShowPending_ = false;
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t feature = buffer[offsets[i]];
+        uint8_t recordLength = buffer[offsets[i] + 1];
+        record[0] = feature;
+        memcpy(record + 1, buffer + offsets[i] + 2, recordLength);
+        handleFeatureCommand(feature, record, 1 + recordLength);
+    }
+    applyingBatch_ = false;
+    if (lightShowPending_) {
+        updateLightShow();
+    }
+    BMLOG_DEBUG("BMDevice", "Applied batch of %u commands", count);
+}
+
+bool BMDevice::isValidBatchRecord(uint8_t feature, const uint8_t* payload, size_t length) {
+    // Only commands that set state, with a payload their handler takes
+    if (!featureRegistry_.accepts(feature, 1 + length)) {
+        return false;
+    }
+    switch (feature) {
+        case BLE_FEATURE_POWER:
+        case BLE_FEATURE_DIRECTION:
+        case BLE_FEATURE_BRIGHTNESS:
+        case BLE_FEATURE_SPEED:
+        case BLE_FEATURE_ORIGIN:
+        case BLE_FEATURE_COLOR:
+        case BLE_FEATURE_SPEEDOMETER:
+            return true;
+        case BLE_FEATURE_PALETTE:
+            return length > 1 || payload[0] <= (uint8_t)AvailablePalettes::moltenmetal;
+        case BLE_FEATURE_EFFECT:
+            return length > 1 || payload[0] <= (uint8_t)LightSceneID::spiral_galaxy;
+        default:
+            return feature >= BLE_FEATURE_WAVE_WIDTH && feature <= BLE_FEATURE_SPIRAL_ARMS;
+    }
+}
+
+void BMDevice::handleGetCapabilitiesFeature(const uint8_t* buffer, size_t length) {
+    uint8_t capabilities[STATUS_DEFAULT_MESSAGE];
+    size_t capabilitiesLength = featureRegistry_.getCapabilities(capabilities, sizeof(capabilities));
+    if (capabilitiesLength > 0) {
+        bluetoothHandler_.sendStatusUpdate(capabilities, capabilitiesLength);
+    }
+}
+
+void BMDevice::handlePreviewFeature(const uint8_t* buffer, size_t length) {
+    if (length >= 4) {
+        previewEncoder_->configure(buffer[2], buffer[3]);
+    }
+    // The MTU as the stack has it unless the app says otherwise; only the
+    // app knows the interval. Only what a BLE link can negotiate counts.
+    uint16_t mtu = bluetoothHandler_.getMtu();
+    uint32_t intervalUs = 0;
+    if (length >= 8) {
+        uint16_t appMtu = buffer[4] | (buffer[5] << 8);
+        uint16_t interval = buffer[6] | (buffer[7] << 8);
+        if (appMtu >= 23 && appMtu <= 517) {
+            mtu = appMtu;
+        }
+        intervalUs = interval >= 6 && interval <= 3200 ? interval * 1250UL : 0;
+    }
+    previewGovernor_.setLink(mtu, intervalUs);
+    previewOn_ = buffer[1] != 0;
+    if (previewOn_) {
+        previewEncoder_->reset();
+        previewGovernor_.reset(micros());
+        previewPending_ = true;
+    }
+    BMLOG_DEBUG("BMDevice", "Preview %s: %u samples per strip, %u bits, MTU %u, interval %lu us",
+                previewOn_ ? "on" : "off", previewEncoder_->getSamplesPerStrip(), previewEncoder_->getBits(),
+                previewGovernor_.getMtu(), (unsigned long)previewGovernor_.getIntervalUs());
+}
+
+void BMDevice::updatePreview() {
+    if (!previewOn_ || !bluetoothHandler_.isConnected()) {
+        return;
+    }
+    uint32_t now = micros();
+    if (!previewEncoder_->isSending() && !startPreviewFrame(now)) {
+        return;
+    }
+    
+    // Fragments go out as the link takes them, never more than the stack can
+    // queue without holding up the loop
+    uint8_t message[PREVIEW_MAX_MESSAGE];
+    size_t length;
+    while (previewGovernor_.ready(now) &&
+           (length = previewEncoder_->nextFragment(message, previewGovernor_.getMessageSize())) > 0) {
+        bluetoothHandler_.sendPreview(message, length);
+        previewGovernor_.sent(length, now);
+    }
+}
+
+bool BMDevice::startPreviewFrame(uint32_t now) {
+    if (!previewGovernor_.due(now)) {
+        return false;
+    }
+    // Only once the strips have shown something new
+    uint32_t shows = lightShow_.getShowCount();
+    if (!previewPending_ && shows == previewShows_ && deviceState_.power == previewPower_) {
+        return false;
+    }
+    previewPending_ = false;
+    previewShows_ = shows;
+    previewPower_ = deviceState_.power;
+    
+    previewEncoder_->beginFrame();
+    for (size_t i = 0; i < lightShow_.getStripCount(); i++) {
+        LightShow::ShownStrip strip = lightShow_.getShownStrip(i);
+        if (!deviceState_.power) {
+            previewEncoder_->addSolidStrip(CRGB::Black, strip.count, 0);
+        } else if (strip.leds) {
+            previewEncoder_->addStrip(strip.leds, strip.count, strip.brightness);
+        } else {
+            previewEncoder_->addSolidStrip(strip.color, strip.count, strip.brightness);
+        }
+    }
+    if (!previewEncoder_->prepare()) {
+        return false;  // The app already shows it
+    }
+    previewGovernor_.frameStarted(now);
+    return true;
+}
+
+bool BMDevice::registerTransferSource(uint8_t kind, std::function<uint32_t()> open,
+                                      BMTransferSender::ReadFunction read) {
+    if (transferSourceCount_ >= TRANSFER_MAX_KINDS || kind == TRANSFER_KIND_CONFIGURATION) {
+        BMLOG_WARN("BMDevice", "Transfer source 0x%X not registered", kind);
+        return false;
+    }
+    transferSources_[transferSourceCount_++] = {kind, open, read};
+    return true;
+}
+
+bool BMDevice::registerTransferSink(uint8_t kind, size_t maxLength,
+                                    std::function<void(const uint8_t*, size_t)> receive) {
+    if (transferSinkCount_ >= TRANSFER_MAX_KINDS) {
+        BMLOG_WARN("BMDevice", "Transfer sink 0x%X not registered", kind);
+        return false;
+    }
+    transferSinks_[transferSinkCount_++] = {kind, maxLength, receive};
+    if (maxLength > transferUploadSize_) {
+        delete transferReceiver_;
+        delete[] transferUpload_;
+        transferUpload_ = new uint8_t[maxLength];
+        transferUploadSize_ = maxLength;
+        transferReceiver_ = new BMTransferReceiver(transferUpload_, transferUploadSize_);
+    }
+    return true;
+}
+
+void BMDevice::handleTransferFeature(const uint8_t* buffer, size_t length) {
+    const uint8_t* message = buffer + 1;
+    size_t messageLength = length - 1;
+    uint8_t flags, transfer;
+    uint16_t fragment;
+    if (!parseTransferHeader(message, messageLength, flags, transfer, fragment)) {
+        BMLOG_WARN("BMDevice", "Not a transfer message");
+        return;
+    }
+    if (flags & TRANSFER_FLAG_REQUEST) {
+        if (messageLength >= TRANSFER_HEADER_SIZE + 2) {
+            startTransfer(transfer, message[TRANSFER_HEADER_SIZE], message[TRANSFER_HEADER_SIZE + 1]);
+        }
+    } else if (flags & TRANSFER_FLAG_ACK) {
+        transferSender_.handleMessage(message, messageLength, millis());
+    } else if ((flags & TRANSFER_FLAG_ABORT) && transferSender_.isActive() &&
+               transferSender_.getTransfer() == transfer) {
+        transferSender_.handleMessage(message, messageLength, millis());
+        BMLOG_DEBUG("BMDevice", "Transfer %u aborted by the app", transfer);
+    } else {
+        receiveTransfer(message, messageLength);
+    }
+}
+
+void BMDevice::startTransfer(uint8_t transfer, uint8_t kind, uint8_t window) {
+    uint8_t abortMessage[TRANSFER_HEADER_SIZE];
+    size_t abortLength = transferSender_.abort(abortMessage);
+    if (abortLength > 0) {
+        bluetoothHandler_.sendStatusUpdate(abortMessage, abortLength);
+    }
+    
+    if (kind == TRANSFER_KIND_CONFIGURATION) {
+        JsonDocument doc(BMJsonPool::shared());
+        fillConfiguration(doc);
+        size_t size = serializeJson(doc, transferConfiguration_, sizeof(transferConfiguration_));
+        transferSender_.begin(transfer, kind, size, window, [this, size](uint32_t offset, uint8_t* out, size_t capacity) {
+            size_t n = offset < size ? min(capacity, size - offset) : 0;
+            memcpy(out, transferConfiguration_ + offset, n);
+            return n;
+        }, millis());
+    } else {
+        const TransferSource* source = nullptr;
+        for (size_t i = 0; i < transferSourceCount_ && !source; i++) {
+            if (transferSources_[i].kind == kind) {
+                source = &transferSources_[i];
+            }
+        }
+        if (!source) {
+            BMLOG_WARN("BMDevice", "No transfer source for kind 0x%X", kind);
+            abortLength = buildTransferAbort(abortMessage, transfer);
+            bluetoothHandler_.sendStatusUpdate(abortMessage, abortLength);
+            return;
+        }
+        transferSender_.begin(transfer, kind, source->open(), window, source->read, millis());
+    }
+    BMLOG_DEBUG("BMDevice", "Transfer %u: kind 0x%X, window %u", transfer, kind, transferSender_.getWindow());
+    updateTransfer();
+}
+
+void BMDevice::receiveTransfer(const uint8_t* message, size_t length) {
+    uint8_t reply[TRANSFER_HEADER_SIZE];
+    size_t replyLength = 0;
+    TransferResult result = TRANSFER_FAILED;
+    const TransferSink* sink = nullptr;
+    
+    // Only kinds a sink takes, no larger than it takes
+    uint8_t flags = message[2];
+    uint8_t kind = (flags & TRANSFER_FLAG_FIRST) && length > TRANSFER_HEADER_SIZE ? message[TRANSFER_HEADER_SIZE] :
+                   transferReceiver_ && transferReceiver_->isActive() ? transferReceiver_->getKind() : 0;
+    for (size_t i = 0; i < transferSinkCount_ && !sink; i++) {
+        if (transferSinks_[i].kind == kind) {
+            sink = &transferSinks_[i];
+        }
+    }
+    if (sink && transferReceiver_) {
+        result = transferReceiver_->handleMessage(message, length, reply, replyLength);
+        if (transferReceiver_->getTotalLength() > sink->maxLength && result != TRANSFER_FAILED) {
+            transferReceiver_->reset();
+            result = TRANSFER_FAILED;
+            replyLength = buildTransferAbort(reply, message[3]);
+        }
+    } else if (flags & TRANSFER_FLAG_FIRST) {
+        replyLength = buildTransferAbort(reply, message[3]);
+    }
+    if (replyLength > 0) {
+        bluetoothHandler_.sendStatusUpdate(reply, replyLength);
+    }
     
-    Serial.printf("[BMDevice] Initialized %d default status chunks\n", statusChunks_.size());
-} 
\ No newline at end of file
+    if (result == TRANSFER_COMPLETE) {
+        BMLOG_DEBUG("BMDevice", "Received %u bytes of kind 0x%X", (unsigned)transferReceiver_->getLength(), kind);
+        sink->receive(transferReceiver_->getData(), transferReceiver_->getLength());
+    } else if (result == TRANSFER_FAILED) {
+        BMLOG_WARN("BMDevice", "Transfer %u of kind 0x%X failed", message[3], kind);
+    }
+}
+
+void BMDevice::updateTransfer() {
+    if (!transferSender_.isActive() || !bluetoothHandler_.isConnected()) {
+        return;
+    }
+    uint8_t message[TRANSFER_MAX_MESSAGE];
+    if (transferSender_.timedOut(millis())) {
+        BMLOG_WARN("BMDevice", "Transfer %u timed out", transferSender_.getTransfer());
+        size_t length = transferSender_.abort(message);
+        bluetoothHandler_.sendStatusUpdate(message, length);
+        return;
+    }
+    
+    // As far as the window goes; the app's acknowledgements open it again
+    size_t capacity = bluetoothHandler_.getMaxNotification();
+    size_t length;
+    while ((length = transferSender_.nextMessage(message, capacity, millis())) > 0) {
+        bluetoothHandler_.sendStatusUpdate(message, length);
+    }
+}
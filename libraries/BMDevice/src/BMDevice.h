@@ -4,6 +4,7 @@
 #include <Arduino.h>
 #include <FastLED.h>
 #include <LightShow.h>
+#include <BMLog.h>
 #ifndef TARGET_ESP32_C6
 #include <LocationService.h>
 #endif
@@ -11,10 +12,15 @@
 #include <HardwareSerial.h>
 #include <vector>
 #include <functional>
+#include <atomic>
 
 #include "BMDeviceState.h"
 #include "BMBluetoothHandler.h"
 #include "BMDeviceDefaults.h"
+#include "BMStatusProtocol.h"
+#include "BMPreviewProtocol.h"
+#include "BMTransferProtocol.h"
+#include "BMFeatureRegistry.h"
 
 #define DEFAULT_BT_REFRESH_INTERVAL 5000
 #define DEFAULT_GPS_BAUD 9600
@@ -25,14 +31,95 @@ enum StatusUpdateState {
     STATUS_SENDING_CHUNKS
 };
 
+class BMDevice;
+
+// A sketch's own JSON status chunk. Type and description are kept as given
+// (literals), not copied.
 struct StatusChunk {
-    String type;
+    const char* type;
+    const char* description;
     std::function<void()> sendFunction;
-    String description;
+};
+
+// BMDevice's own JSON chunks, which the binary status replaces
+struct BuiltInStatusChunk {
+    const char* type;
+    const char* description;
+    void (BMDevice::*send)();
+};
+
+#define STATUS_MAX_CHUNKS 8     // A sketch's own chunks
+
+// A sketch's own bulk payloads, by kind (BMTransferProtocol.h)
+struct TransferSource {
+    uint8_t kind;
+    std::function<uint32_t()> open;             // The length, when the app asks
+    BMTransferSender::ReadFunction read;
+};
+
+struct TransferSink {
+    uint8_t kind;
+    size_t maxLength;
+    std::function<void(const uint8_t* data, size_t length)> receive;
+};
+
+#define TRANSFER_MAX_KINDS 8            // Sources, and sinks
+#define TRANSFER_CONFIGURATION_SIZE 1024 // The configuration JSON, while it is sent
+
+// The heap as status reports it: free now, the least ever free, and the
+// largest block that can still be allocated, which drops as the heap
+// fragments. All 0 where the platform keeps no statistics (host builds).
+struct HeapStats {
+    uint32_t freeBytes;
+    uint32_t minFreeBytes;
+    uint32_t largestFreeBlock;
+};
+
+HeapStats readHeapStats();
+
+// begin() runs the stages up to the first frame, so the LEDs light with the
+// restored scene before anything slow starts; loop() brings up the rest one
+// stage at a time without holding up a frame.
+enum BootStage : uint8_t {
+    BOOT_SETTINGS,      // Defaults read from flash
+    BOOT_SCENE,         // The scene a reset interrupted, or the defaults'
+    BOOT_FIRST_FRAME,   // On the LEDs; begin() returns
+    BOOT_GPS,           // Serial open; the NMEA check comes later
+    BOOT_BLUETOOTH,     // Advertising
+    BOOT_READY,
+    BOOT_STAGE_COUNT
+};
+
+#define BOOT_STAGE_PENDING 0xFFFF
+#define BOOT_STAGE_FAILED 0xFFFE
+#define BOOT_BLUETOOTH_TASK_STACK 4096
+
+// When each stage finished, in millis() since boot
+struct BootProfile {
+    uint16_t stageMs[BOOT_STAGE_COUNT];
+    bool sceneRestored;
+};
+
+// Binary (BMStatusProtocol.h) is the default; JSON chunks are a debug view
+enum StatusFormat {
+    STATUS_FORMAT_BINARY,
+    STATUS_FORMAT_JSON
 };
 
 #define STATUS_UPDATE_DELAY 25  // 25ms delay between chunks
 
+#define BATCH_MAX_RECORDS 32
+
+// BMDevice's own BLE commands; sketches register theirs in other namespaces
+#define CORE_FEATURE_NAMESPACE "core"
+#define CORE_FEATURE_FIRST 0x01
+#define CORE_FEATURE_LAST 0x3F
+
+// State changes that push a status update at once. Position and GPS speed
+// change with every fix and go out with the periodic update instead.
+#define STATUS_EVENT_FIELDS (STATE_POWER | STATE_BRIGHTNESS | STATE_SPEED | STATE_DIRECTION | STATE_PALETTE | \
+                             STATE_EFFECT | STATE_EFFECT_PARAMETERS | STATE_EFFECT_COLOR | STATE_POSITION_AVAILABLE)
+
 class BMDevice {
 public:
     BMDevice(const char* deviceName, const char* serviceUUID, const char* featuresUUID, const char* statusUUID);
@@ -44,10 +131,7 @@ public:
     void addLEDStrip(CRGB* ledArray, int numLeds) {
         CLEDController& controller = FastLED.addLeds<CHIPSET, DATA_PIN, RGB_ORDER>(ledArray, numLeds);
         lightShow_.add_led_controller(&controller);
-        Serial.print("[BMDevice] Added LED strip: ");
-        Serial.print(numLeds);
-        Serial.print(" LEDs on pin ");
-        Serial.println(DATA_PIN);
+        BMLOG_DEBUG("BMDevice", "Added LED strip: %d LEDs on pin %d", numLeds, DATA_PIN);
     }
     
     // GPS Integration (optional)
@@ -56,9 +140,12 @@ public:
     void setLocationService(LocationService* locationService);
 #endif
     
-    // Device lifecycle
+    // Device lifecycle. begin() returns once the first frame is out;
+    // Bluetooth and GPS come up from loop() after it.
     bool begin();
     void loop();
+    const BootProfile& getBootProfile() const { return bootProfile_; }
+    bool isBootComplete() const { return bootStage_ == BOOT_STAGE_COUNT; }
     
     // State access
     BMDeviceState& getState() { return deviceState_; }
@@ -68,9 +155,14 @@ public:
     LocationService* getLocationService() { return locationService_; }
 #endif
     BMDeviceDefaults& getDefaults() { return defaults_; }
+    BMFeatureRegistry& getFeatureRegistry() { return featureRegistry_; }
     
     // Configuration
     void setStatusUpdateInterval(unsigned long interval) { statusUpdateInterval_ = interval; }
+    void setStatusFormat(StatusFormat format);
+    StatusFormat getStatusFormat() const { return statusFormat_; }
+    const BMStatusEncoder& getStatusEncoder() const { return statusEncoder_; }
+    uint32_t getLightShowUpdateCount() const { return lightShowUpdates_; }
     void setBrightness(int brightness);
     void setEffect(LightSceneID effect);
     void setPalette(AvailablePalettes palette);
@@ -81,14 +173,37 @@ public:
     bool resetToFactoryDefaults();
     void applyDefaults();
     void setMaxBrightness(int maxBrightness);
-    void setDeviceOwner(const String& owner);
+    void setDeviceOwner(const char* owner);
     
-    // Callbacks for custom behavior
+    // Callbacks for custom behavior. New commands should go in the feature
+    // registry; this handler only sees opcodes nobody registered.
     void setCustomFeatureHandler(std::function<bool(uint8_t feature, const uint8_t* data, size_t length)> handler);
     void setCustomConnectionHandler(std::function<void(bool connected)> handler);
     
+    // Live pixel preview (BMPreviewProtocol.h): adds the preview
+    // characteristic, so call before begin(). The app turns it on with
+    // BLE_FEATURE_PREVIEW once connected.
+    void enablePreview(const char* previewUUID);
+    bool isPreviewOn() const { return previewOn_; }
+    const BMPreviewEncoder* getPreviewEncoder() const { return previewEncoder_; }
+    const BMPreviewGovernor& getPreviewGovernor() const { return previewGovernor_; }
+    
+    // Bulk transfers (BMTransferProtocol.h). The app asks for a kind with
+    // BLE_FEATURE_TRANSFER: open() gives its length, then read() is called
+    // for it piece by piece as the link takes it. The configuration
+    // (TRANSFER_KIND_CONFIGURATION) is built in. False once
+    // TRANSFER_MAX_KINDS are registered.
+    bool registerTransferSource(uint8_t kind, std::function<uint32_t()> open, BMTransferSender::ReadFunction read);
+    // Payloads of this kind the app sends, up to maxLength bytes, go to
+    // receive() once complete. Register before begin(): the reassembly
+    // buffer is allocated here, as large as the largest.
+    bool registerTransferSink(uint8_t kind, size_t maxLength,
+                              std::function<void(const uint8_t* data, size_t length)> receive);
+    const BMTransferSender& getTransferSender() const { return transferSender_; }
+    
     // Chunked status update system
-    void registerStatusChunk(const String& type, std::function<void()> sendFunction, const String& description = "");
+    // False once STATUS_MAX_CHUNKS are registered
+    bool registerStatusChunk(const char* type, std::function<void()> sendFunction, const char* description = "");
     void startChunkedStatusUpdate();
     void clearStatusChunks();
     
@@ -99,6 +214,7 @@ private:
     LightShow lightShow_;
     Clock deviceClock_;
     BMDeviceDefaults defaults_;
+    BMFeatureRegistry featureRegistry_;
     
     // GPS components (optional)
     bool gpsEnabled_;
@@ -116,21 +232,70 @@ private:
     std::function<void(bool)> customConnectionHandler_;
     
     // Chunked status update system
-    std::vector<StatusChunk> statusChunks_;
+    static const BuiltInStatusChunk builtInStatusChunks_[];
+    static const size_t builtInStatusChunkCount_;
+    bool builtInChunksEnabled_;     // Until clearStatusChunks()
+    StatusChunk statusChunks_[STATUS_MAX_CHUNKS];
+    size_t statusChunkCount_;
     StatusUpdateState statusUpdateState_;
     unsigned long statusUpdateTimer_;
     size_t currentChunkIndex_;
+    StatusFormat statusFormat_;
+    BMStatusEncoder statusEncoder_;
     
     // LED strip management
     CRGB* ledArrays_[MAX_LED_STRIPS];
     bool dynamicNaming_;
     
+    // Live pixel preview; the encoder only exists once enabled
+    BMPreviewEncoder* previewEncoder_;
+    BMPreviewGovernor previewGovernor_;
+    bool previewOn_;
+    bool previewPending_;       // A frame is due whatever the strips show
+    uint32_t previewShows_;     // LightShow::getShowCount() at the last frame
+    bool previewPower_;
+    
+    // Bulk transfers: one each way at a time
+    TransferSource transferSources_[TRANSFER_MAX_KINDS];
+    size_t transferSourceCount_;
+    TransferSink transferSinks_[TRANSFER_MAX_KINDS];
+    size_t transferSinkCount_;
+    BMTransferSender transferSender_;
+    BMTransferReceiver* transferReceiver_;  // Once a sink is registered
+    uint8_t* transferUpload_;
+    size_t transferUploadSize_;
+    char transferConfiguration_[TRANSFER_CONFIGURATION_SIZE];
+    
+    // Light show rebuilds; a batch defers them to one at the end
+    uint32_t lightShowUpdates_;
+    bool applyingBatch_;
+    bool lightShowPending_;
+    
+    // Staged boot: the next stage to finish, and when each did
+    uint8_t bootStage_;
+    BootProfile bootProfile_;
+    bool bluetoothStarting_;
+    std::atomic<int8_t> bluetoothResult_;   // -1 until BLE.begin() returns, then whether it worked
+    
     // Internal methods
     void handleFeatureCommand(uint8_t feature, const uint8_t* buffer, size_t length);
+    void initializeFeatureHandlers();
     void handleConnectionChange(bool connected);
     void updateGPS();
     void updateLightShow();
+    void continueBoot();
+    void finishBootStage(BootStage stage, bool succeeded = true);
+    void startBluetooth();
+    void restoreScene();
     void sendStatusUpdate();
+    void updatePreview();
+    bool startPreviewFrame(uint32_t now);
+    void updateTransfer();
+    void startTransfer(uint8_t transfer, uint8_t kind, uint8_t window);
+    void receiveTransfer(const uint8_t* message, size_t length);
+    void fillConfiguration(JsonDocument& doc);
+    // What one status notification carries at the link's MTU
+    size_t getStatusMessageSize() const;
     
     // GPS speed mapping helper
     uint16_t calculateEffectiveSpeed();
@@ -142,6 +307,16 @@ private:
     void sendDefaultsChunk();
     void sendEffectParametersChunk();
     void initializeDefaultStatusChunks();
+    size_t countStatusChunks(bool includeBuiltIn) const;
+    void sendStatusChunk(size_t index);
+    void sendBinaryStatus();
+    void fillStatusFields();
+    
+    // State change listeners
+    void initializeStateListeners();
+    void pushStatusChanges(uint32_t fields);
+    void saveStateToDefaults(uint32_t fields);
+    void saveScene(uint32_t fields);
     
     // Feature handlers
     void handlePowerFeature(const uint8_t* buffer, size_t length);
@@ -164,6 +339,17 @@ private:
     void handleSetDeviceOwnerFeature(const uint8_t* buffer, size_t length);
     void handleSetAutoOnFeature(const uint8_t* buffer, size_t length);
     
+    // Status protocol handlers
+    void handleStatusAckFeature(const uint8_t* buffer, size_t length);
+    void handleSetStatusFormatFeature(const uint8_t* buffer, size_t length);
+    
+    // Batched commands
+    void handleBatchFeature(const uint8_t* buffer, size_t length);
+    bool isValidBatchRecord(uint8_t feature, const uint8_t* payload, size_t length);
+    void handleGetCapabilitiesFeature(const uint8_t* buffer, size_t length);
+    void handlePreviewFeature(const uint8_t* buffer, size_t length);
+    void handleTransferFeature(const uint8_t* buffer, size_t length);
+    
     // GPS Speed feature handlers
     void handleSetGPSLowSpeedFeature(const uint8_t* buffer, size_t length);
     void handleSetGPSTopSpeedFeature(const uint8_t* buffer, size_t length);
@@ -1,7 +1,109 @@
 #include "BMDeviceDefaults.h"
+#include "BMJsonPool.h"
+#include <BMLog.h>
 
-BMDeviceDefaults::BMDeviceDefaults() : initialized_(false) {
-    // Constructor intentionally minimal
+#if defined(ARDUINO_ARCH_ESP32)
+#include <esp_system.h>
+#endif
+
+namespace {
+
+#if defined(ARDUINO_ARCH_ESP32)
+// esp_restart() and panics run shutdown handlers; a brownout reset doesn't
+BMDeviceDefaults* shutdownDefaults = nullptr;
+
+void flushOnShutdown() {
+    if (shutdownDefaults) {
+        shutdownDefaults->flush();
+    }
+}
+#endif
+
+// Little-endian, whatever the target
+void putU16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(value & 0xFF);
+    out.push_back(value >> 8);
+}
+
+void putU32(std::vector<uint8_t>& out, uint32_t value) {
+    putU16(out, value & 0xFFFF);
+    putU16(out, value >> 16);
+}
+
+void putFloat(std::vector<uint8_t>& out, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    putU32(out, bits);
+}
+
+void putString(std::vector<uint8_t>& out, const char* value) {
+    size_t length = min(strlen(value), (size_t)DEFAULTS_STRING_MAX);
+    out.push_back((uint8_t)length);
+    out.insert(out.end(), (const uint8_t*)value, (const uint8_t*)value + length);
+}
+
+uint16_t getU16(const uint8_t* data) {
+    return data[0] | (data[1] << 8);
+}
+
+uint32_t getU32(const uint8_t* data) {
+    return getU16(data) | ((uint32_t)getU16(data + 2) << 16);
+}
+
+// Reads fields in order, failing once one runs past the end
+class RecordReader {
+public:
+    RecordReader(const uint8_t* data, size_t length) : data_(data), length_(length), offset_(0), ok_(true) {}
+
+    uint8_t u8() { return take(1) ? data_[offset_ - 1] : 0; }
+    uint16_t u16() { return take(2) ? getU16(data_ + offset_ - 2) : 0; }
+    uint32_t u32() { return take(4) ? getU32(data_ + offset_ - 4) : 0; }
+
+    float f32() {
+        uint32_t bits = u32();
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // Into a DEFAULTS_STRING_MAX + 1 byte field
+    void string(char* out) {
+        uint8_t length = u8();
+        if (length > DEFAULTS_STRING_MAX || !take(length)) {
+            ok_ = false;
+            out[0] = '\0';
+            return;
+        }
+        memcpy(out, data_ + offset_ - length, length);
+        out[length] = '\0';
+    }
+
+    // Every byte used, none missing
+    bool complete() const { return ok_ && offset_ == length_; }
+
+private:
+    bool take(size_t count) {
+        if (!ok_ || offset_ + count > length_) {
+            ok_ = false;
+            return false;
+        }
+        offset_ += count;
+        return true;
+    }
+
+    const uint8_t* data_;
+    size_t length_;
+    size_t offset_;
+    bool ok_;
+};
+
+}
+
+BMDeviceDefaults::BMDeviceDefaults()
+    : record_(preferences_, DEFAULTS_RECORD_NAME, DEFAULTS_VERSION), initialized_(false), dirty_(false),
+      changedAt_(0), commits_(0) {
+    // When the payload changes: bump DEFAULTS_VERSION, and add a
+    // record_.addMigration() from the old version here
 }
 
 BMDeviceDefaults::~BMDeviceDefaults() {
@@ -18,22 +120,34 @@ bool BMDeviceDefaults::begin() {
     bool success = preferences_.begin(DEFAULTS_NAMESPACE, false);
     if (success) {
         initialized_ = true;
-        migrateIfNeeded();
         
         // Load current defaults from storage
         DeviceDefaults defaults;
-        if (loadDefaults(defaults)) {
+        if (loadRecord(defaults)) {
+            currentDefaults_ = defaults;
+            BMLOG_INFO("BMDeviceDefaults", "Loaded defaults from storage (version %d, commit %u)",
+                       record_.getLoadedVersion(), (unsigned)record_.getSequence());
+        } else if (preferences_.isKey(PREF_VERSION) && migrateIfNeeded() && loadLegacyKeys(defaults)) {
+            // Stored one key per setting; from now on it's the record
             currentDefaults_ = defaults;
-            Serial.println("[BMDeviceDefaults] Loaded defaults from storage");
+            markDirty();
+            flush();
+            BMLOG_INFO("BMDeviceDefaults", "Converted per-key defaults to a record");
         } else {
-            Serial.println("[BMDeviceDefaults] No stored defaults found, using factory defaults");
+            BMLOG_INFO("BMDeviceDefaults", "No stored defaults found, using factory defaults");
             currentDefaults_.setFactoryDefaults();
-            saveDefaults(currentDefaults_);
+            markDirty();
+            flush();
         }
+        dirty_ = false;
         
+#if defined(ARDUINO_ARCH_ESP32)
+        shutdownDefaults = this;
+        esp_register_shutdown_handler(flushOnShutdown);
+#endif
         printCurrentDefaults();
     } else {
-        Serial.println("[BMDeviceDefaults] Failed to initialize preferences storage");
+        BMLOG_ERROR("BMDeviceDefaults", "Failed to initialize preferences storage");
     }
     
     return success;
@@ -41,16 +155,155 @@ bool BMDeviceDefaults::begin() {
 
 void BMDeviceDefaults::end() {
     if (initialized_) {
+        flush();
+#if defined(ARDUINO_ARCH_ESP32)
+        if (shutdownDefaults == this) {
+            esp_unregister_shutdown_handler(flushOnShutdown);
+            shutdownDefaults = nullptr;
+        }
+#endif
         preferences_.end();
         initialized_ = false;
     }
 }
 
+void BMDeviceDefaults::loop() {
+    if (dirty_ && millis() - changedAt_ >= DEFAULTS_COMMIT_IDLE_MS) {
+        flush();
+    }
+}
+
+bool BMDeviceDefaults::flush() {
+    if (!dirty_) {
+        return true;
+    }
+    if (!initialized_) {
+        return false;
+    }
+    if (!commitRecord()) {
+        // Stays dirty; loop() tries again after another idle period
+        changedAt_ = millis();
+        BMLOG_ERROR("BMDeviceDefaults", "Failed to commit defaults");
+        return false;
+    }
+    dirty_ = false;
+    BMLOG_INFO("BMDeviceDefaults", "Committed defaults (commit %u)", (unsigned)record_.getSequence());
+    return true;
+}
+
+void BMDeviceDefaults::markDirty() {
+    dirty_ = true;
+    changedAt_ = millis();
+}
+
+bool BMDeviceDefaults::updateString(char* field, const char* value, size_t length) {
+    char copy[DEFAULTS_STRING_MAX + 1];
+    copyDefaultsString(copy, value, length);
+    if (strcmp(field, copy) != 0) {
+        memcpy(field, copy, sizeof(copy));
+        markDirty();
+    }
+    return initialized_;
+}
+
+bool BMDeviceDefaults::commitRecord() {
+    if (!record_.commit(encodePayload(currentDefaults_))) {
+        return false;
+    }
+    commits_++;
+    return true;
+}
+
+bool BMDeviceDefaults::loadRecord(DeviceDefaults& defaults) {
+    std::vector<uint8_t> payload;
+    DeviceDefaults loaded;
+    auto decodes = [this, &loaded](const std::vector<uint8_t>& candidate) {
+        if (!decodePayload(candidate.data(), candidate.size(), loaded)) {
+            return false;
+        }
+        constrainValues(loaded);
+        return validateDefaults(loaded);
+    };
+    if (!record_.load(payload, decodes)) {
+        return false;
+    }
+    decodePayload(payload.data(), payload.size(), defaults);
+    constrainValues(defaults);
+    return true;
+}
+
+std::vector<uint8_t> BMDeviceDefaults::encodePayload(const DeviceDefaults& defaults) {
+    std::vector<uint8_t> out;
+    out.reserve(DEFAULTS_PAYLOAD_MAX);
+    out.push_back((uint8_t)defaults.brightness);
+    out.push_back((uint8_t)defaults.maxBrightness);
+    out.push_back((uint8_t)defaults.speed);
+    out.push_back((uint8_t)defaults.palette);
+    out.push_back((uint8_t)defaults.effect);
+    out.push_back(defaults.reverseDirection);
+    out.push_back(defaults.autoOn);
+    putU32(out, defaults.statusUpdateInterval);
+    out.push_back(defaults.effectColor.r);
+    out.push_back(defaults.effectColor.g);
+    out.push_back(defaults.effectColor.b);
+    out.push_back(defaults.gpsEnabled);
+    putFloat(out, defaults.gpsLowSpeed);
+    putFloat(out, defaults.gpsTopSpeed);
+    out.push_back(defaults.gpsLightshowSpeedEnabled);
+    out.push_back(defaults.syncEnabled);
+    out.push_back((uint8_t)defaults.activeLEDStrips);
+    for (int i = 0; i < MAX_LED_STRIPS; i++) {
+        out.push_back((uint8_t)defaults.ledStrips[i].pin);
+        putU16(out, (uint16_t)defaults.ledStrips[i].numLeds);
+        out.push_back((uint8_t)defaults.ledStrips[i].colorOrder);
+        out.push_back(defaults.ledStrips[i].enabled);
+    }
+    putString(out, defaults.owner);
+    putString(out, defaults.deviceName);
+    putString(out, defaults.deviceType);
+    return out;
+}
+
+bool BMDeviceDefaults::decodePayload(const uint8_t* data, size_t length, DeviceDefaults& defaults) {
+    RecordReader in(data, length);
+    defaults.brightness = in.u8();
+    defaults.maxBrightness = in.u8();
+    defaults.speed = in.u8();
+    defaults.palette = (AvailablePalettes)in.u8();
+    defaults.effect = (LightSceneID)in.u8();
+    defaults.reverseDirection = in.u8() != 0;
+    defaults.autoOn = in.u8() != 0;
+    defaults.statusUpdateInterval = in.u32();
+    defaults.effectColor.r = in.u8();
+    defaults.effectColor.g = in.u8();
+    defaults.effectColor.b = in.u8();
+    defaults.gpsEnabled = in.u8() != 0;
+    defaults.gpsLowSpeed = in.f32();
+    defaults.gpsTopSpeed = in.f32();
+    defaults.gpsLightshowSpeedEnabled = in.u8() != 0;
+    defaults.syncEnabled = in.u8() != 0;
+    defaults.activeLEDStrips = in.u8();
+    for (int i = 0; i < MAX_LED_STRIPS; i++) {
+        defaults.ledStrips[i].pin = in.u8();
+        defaults.ledStrips[i].numLeds = in.u16();
+        defaults.ledStrips[i].colorOrder = in.u8();
+        defaults.ledStrips[i].enabled = in.u8() != 0;
+    }
+    in.string(defaults.owner);
+    in.string(defaults.deviceName);
+    in.string(defaults.deviceType);
+    defaults.version = DEFAULTS_VERSION;
+    return in.complete();
+}
+
 bool BMDeviceDefaults::loadDefaults(DeviceDefaults& defaults) {
     if (!initialized_) {
         return false;
     }
-    
+    return loadRecord(defaults) || loadLegacyKeys(defaults);
+}
+
+bool BMDeviceDefaults::loadLegacyKeys(DeviceDefaults& defaults) {
     // Check if we have stored defaults
     if (!preferences_.isKey(PREF_VERSION)) {
         return false;
@@ -63,9 +316,9 @@ bool BMDeviceDefaults::loadDefaults(DeviceDefaults& defaults) {
     defaults.palette = (AvailablePalettes)preferences_.getUChar(PREF_PALETTE, (uint8_t)defaults.palette);
     defaults.effect = (LightSceneID)preferences_.getUChar(PREF_EFFECT, (uint8_t)defaults.effect);
     defaults.reverseDirection = preferences_.getBool(PREF_DIRECTION, defaults.reverseDirection);
-    defaults.owner = readString(PREF_OWNER, defaults.owner);
-    defaults.deviceName = readString(PREF_DEVICE_NAME, defaults.deviceName);
-    defaults.deviceType = readString(PREF_DEVICE_TYPE, defaults.deviceType);
+    copyDefaultsString(defaults.owner, readString(PREF_OWNER, defaults.owner).c_str());
+    copyDefaultsString(defaults.deviceName, readString(PREF_DEVICE_NAME, defaults.deviceName).c_str());
+    copyDefaultsString(defaults.deviceType, readString(PREF_DEVICE_TYPE, defaults.deviceType).c_str());
     defaults.autoOn = preferences_.getBool(PREF_AUTO_ON, defaults.autoOn);
     defaults.activeLEDStrips = preferences_.getInt(PREF_LED_COUNT, defaults.activeLEDStrips);
     defaults.statusUpdateInterval = preferences_.getULong(PREF_STATUS_INTERVAL, defaults.statusUpdateInterval);
@@ -126,67 +379,14 @@ bool BMDeviceDefaults::saveDefaults(const DeviceDefaults& defaults) {
     constrainValues(validatedDefaults);
     
     if (!validateDefaults(validatedDefaults)) {
-        Serial.println("[BMDeviceDefaults] Invalid defaults, cannot save");
+        BMLOG_WARN("BMDeviceDefaults", "Invalid defaults, cannot save");
         return false;
     }
     
-    bool success = true;
-    
-    // Save core settings
-    success &= preferences_.putInt(PREF_BRIGHTNESS, validatedDefaults.brightness);
-    success &= preferences_.putInt(PREF_MAX_BRIGHTNESS, validatedDefaults.maxBrightness);
-    success &= preferences_.putInt(PREF_SPEED, validatedDefaults.speed);
-    success &= preferences_.putUChar(PREF_PALETTE, (uint8_t)validatedDefaults.palette);
-    success &= preferences_.putUChar(PREF_EFFECT, (uint8_t)validatedDefaults.effect);
-    success &= preferences_.putBool(PREF_DIRECTION, validatedDefaults.reverseDirection);
-    success &= writeString(PREF_OWNER, validatedDefaults.owner);
-    success &= writeString(PREF_DEVICE_NAME, validatedDefaults.deviceName);
-    success &= writeString(PREF_DEVICE_TYPE, validatedDefaults.deviceType);
-    success &= preferences_.putBool(PREF_AUTO_ON, validatedDefaults.autoOn);
-    success &= preferences_.putInt(PREF_LED_COUNT, validatedDefaults.activeLEDStrips);
-    success &= preferences_.putULong(PREF_STATUS_INTERVAL, validatedDefaults.statusUpdateInterval);
-    success &= preferences_.putBool(PREF_GPS_ENABLED, validatedDefaults.gpsEnabled);
-    
-    // Save GPS speed settings
-    success &= preferences_.putFloat(PREF_GPS_LOW_SPEED, validatedDefaults.gpsLowSpeed);
-    success &= preferences_.putFloat(PREF_GPS_TOP_SPEED, validatedDefaults.gpsTopSpeed);
-    success &= preferences_.putBool(PREF_GPS_LIGHTSHOW_SPEED_ENABLED, validatedDefaults.gpsLightshowSpeedEnabled);
-    
-    success &= preferences_.putInt(PREF_VERSION, validatedDefaults.version);
-    
-    // Save effect color
-    success &= preferences_.putUChar(PREF_EFFECT_COLOR_R, validatedDefaults.effectColor.r);
-    success &= preferences_.putUChar(PREF_EFFECT_COLOR_G, validatedDefaults.effectColor.g);
-    success &= preferences_.putUChar(PREF_EFFECT_COLOR_B, validatedDefaults.effectColor.b);
-    
-    // Save LED configuration as JSON
-    DynamicJsonDocument pinsDoc(1024);
-    DynamicJsonDocument ordersDoc(1024);
-    
-    for (int i = 0; i < validatedDefaults.activeLEDStrips; i++) {
-        JsonObject pinObj = pinsDoc.createNestedObject();
-        pinObj["pin"] = validatedDefaults.ledStrips[i].pin;
-        pinObj["leds"] = validatedDefaults.ledStrips[i].numLeds;
-        pinObj["enabled"] = validatedDefaults.ledStrips[i].enabled;
-        
-        ordersDoc.add(validatedDefaults.ledStrips[i].colorOrder);
-    }
-    
-    String pinsJson, ordersJson;
-    serializeJson(pinsDoc, pinsJson);
-    serializeJson(ordersDoc, ordersJson);
-    
-    success &= writeString(PREF_LED_PINS, pinsJson);
-    success &= writeString(PREF_COLOR_ORDERS, ordersJson);
-    
-    if (success) {
-        currentDefaults_ = validatedDefaults;
-        Serial.println("[BMDeviceDefaults] Defaults saved successfully");
-    } else {
-        Serial.println("[BMDeviceDefaults] Failed to save some default values");
-    }
-    
-    return success;
+    // Committed by loop() or flush()
+    currentDefaults_ = validatedDefaults;
+    markDirty();
+    return true;
 }
 
 bool BMDeviceDefaults::resetToFactory() {
@@ -194,106 +394,90 @@ bool BMDeviceDefaults::resetToFactory() {
         return false;
     }
     
-    // Clear all preferences
+    // Clear all preferences, then commit the factory defaults straight away
     bool success = preferences_.clear();
     if (success) {
+        record_.reset();
         currentDefaults_.setFactoryDefaults();
-        success = saveDefaults(currentDefaults_);
-        Serial.println("[BMDeviceDefaults] Reset to factory defaults");
+        markDirty();
+        success = flush();
+        BMLOG_INFO("BMDeviceDefaults", "Reset to factory defaults");
     } else {
-        Serial.println("[BMDeviceDefaults] Failed to clear preferences");
+        BMLOG_ERROR("BMDeviceDefaults", "Failed to clear preferences");
     }
     
     return success;
 }
 
-// Individual setting operations
+// Individual setting operations: RAM only, committed by loop() or flush()
 bool BMDeviceDefaults::setBrightness(int brightness) {
-    currentDefaults_.brightness = constrain(brightness, 1, currentDefaults_.maxBrightness);
-    return preferences_.putInt(PREF_BRIGHTNESS, currentDefaults_.brightness);
+    return update(currentDefaults_.brightness, (int)constrain(brightness, 1, currentDefaults_.maxBrightness));
 }
 
 bool BMDeviceDefaults::setMaxBrightness(int maxBrightness) {
-    currentDefaults_.maxBrightness = constrain(maxBrightness, 1, 256);
+    update(currentDefaults_.maxBrightness, (int)constrain(maxBrightness, 1, 256));
     // If current brightness exceeds new max, adjust it
     if (currentDefaults_.brightness > currentDefaults_.maxBrightness) {
-        currentDefaults_.brightness = currentDefaults_.maxBrightness;
-        preferences_.putInt(PREF_BRIGHTNESS, currentDefaults_.brightness);
+        update(currentDefaults_.brightness, currentDefaults_.maxBrightness);
     }
-    return preferences_.putInt(PREF_MAX_BRIGHTNESS, currentDefaults_.maxBrightness);
+    return initialized_;
 }
 
 bool BMDeviceDefaults::setSpeed(int speed) {
-    currentDefaults_.speed = constrain(speed, 5, 200);
-    return preferences_.putInt(PREF_SPEED, currentDefaults_.speed);
+    return update(currentDefaults_.speed, (int)constrain(speed, 5, 200));
 }
 
 bool BMDeviceDefaults::setPalette(AvailablePalettes palette) {
-    currentDefaults_.palette = palette;
-    return preferences_.putUChar(PREF_PALETTE, (uint8_t)palette);
+    return update(currentDefaults_.palette, palette);
 }
 
 bool BMDeviceDefaults::setEffect(LightSceneID effect) {
-    currentDefaults_.effect = effect;
-    return preferences_.putUChar(PREF_EFFECT, (uint8_t)effect);
+    return update(currentDefaults_.effect, effect);
 }
 
 bool BMDeviceDefaults::setDirection(bool reverse) {
-    currentDefaults_.reverseDirection = reverse;
-    return preferences_.putBool(PREF_DIRECTION, reverse);
+    return update(currentDefaults_.reverseDirection, reverse);
 }
 
-bool BMDeviceDefaults::setOwner(const String& owner) {
-    currentDefaults_.owner = owner;
-    return writeString(PREF_OWNER, owner);
+bool BMDeviceDefaults::setOwner(const char* owner, size_t length) {
+    return updateString(currentDefaults_.owner, owner, length);
 }
 
-bool BMDeviceDefaults::setDeviceName(const String& name) {
-    currentDefaults_.deviceName = name;
-    return writeString(PREF_DEVICE_NAME, name);
+bool BMDeviceDefaults::setDeviceName(const char* name, size_t length) {
+    return updateString(currentDefaults_.deviceName, name, length);
 }
 
 bool BMDeviceDefaults::setAutoOn(bool autoOn) {
-    currentDefaults_.autoOn = autoOn;
-    return preferences_.putBool(PREF_AUTO_ON, autoOn);
+    return update(currentDefaults_.autoOn, autoOn);
 }
 
 bool BMDeviceDefaults::setStatusInterval(unsigned long interval) {
-    currentDefaults_.statusUpdateInterval = constrain(interval, 1000UL, 60000UL);
-    return preferences_.putULong(PREF_STATUS_INTERVAL, currentDefaults_.statusUpdateInterval);
+    return update(currentDefaults_.statusUpdateInterval, (unsigned long)constrain(interval, 1000UL, 60000UL));
 }
 
 bool BMDeviceDefaults::setEffectColor(CRGB color) {
-    currentDefaults_.effectColor = color;
-    bool success = true;
-    success &= preferences_.putUChar(PREF_EFFECT_COLOR_R, color.r);
-    success &= preferences_.putUChar(PREF_EFFECT_COLOR_G, color.g);
-    success &= preferences_.putUChar(PREF_EFFECT_COLOR_B, color.b);
-    return success;
+    return update(currentDefaults_.effectColor, color);
 }
 
 bool BMDeviceDefaults::setGPSEnabled(bool enabled) {
-    currentDefaults_.gpsEnabled = enabled;
-    return preferences_.putBool(PREF_GPS_ENABLED, enabled);
+    return update(currentDefaults_.gpsEnabled, enabled);
 }
 
 bool BMDeviceDefaults::setGPSLowSpeed(float speed) {
-    currentDefaults_.gpsLowSpeed = constrain(speed, 0.0f, 100.0f);
-    return preferences_.putFloat(PREF_GPS_LOW_SPEED, currentDefaults_.gpsLowSpeed);
+    return update(currentDefaults_.gpsLowSpeed, (float)constrain(speed, 0.0f, 100.0f));
 }
 
 bool BMDeviceDefaults::setGPSTopSpeed(float speed) {
-    currentDefaults_.gpsTopSpeed = constrain(speed, 0.0f, 200.0f);
+    float topSpeed = constrain(speed, 0.0f, 200.0f);
     // Ensure top speed is always higher than low speed
-    if (currentDefaults_.gpsTopSpeed <= currentDefaults_.gpsLowSpeed) {
-        currentDefaults_.gpsTopSpeed = currentDefaults_.gpsLowSpeed + 1.0f;
+    if (topSpeed <= currentDefaults_.gpsLowSpeed) {
+        topSpeed = currentDefaults_.gpsLowSpeed + 1.0f;
     }
-    return preferences_.putFloat(PREF_GPS_TOP_SPEED, currentDefaults_.gpsTopSpeed);
+    return update(currentDefaults_.gpsTopSpeed, topSpeed);
 }
 
 bool BMDeviceDefaults::setGPSLightshowSpeedEnabled(bool enabled) {
-    currentDefaults_.gpsLightshowSpeedEnabled = enabled;
-    return preferences_.putBool(PREF_GPS_LIGHTSHOW_SPEED_ENABLED, enabled);
+    return update(currentDefaults_.gpsLightshowSpeedEnabled, enabled);
 }
 
 float BMDeviceDefaults::getGPSLowSpeed() {
@@ -309,36 +493,31 @@ bool BMDeviceDefaults::isGPSLightshowSpeedEnabled() {
 }
 
 bool BMDeviceDefaults::setSyncEnabled(bool enabled) {
-    currentDefaults_.syncEnabled = enabled;
-    return preferences_.putBool(PREF_SYNC_ENABLED, enabled);
+    return update(currentDefaults_.syncEnabled, enabled);
 }
 
 bool BMDeviceDefaults::isSyncEnabled() {
     return currentDefaults_.syncEnabled;
 }
 
-bool BMDeviceDefaults::setDeviceType(const String& deviceType) {
-    currentDefaults_.deviceType = deviceType;
-    return writeString(PREF_DEVICE_TYPE, deviceType);
+bool BMDeviceDefaults::setDeviceType(const char* deviceType, size_t length) {
+    return updateString(currentDefaults_.deviceType, deviceType, length);
 }
 
 bool BMDeviceDefaults::setLEDStripConfig(int stripIndex, int pin, int numLeds, int colorOrder, bool enabled) {
     if (stripIndex >= MAX_LED_STRIPS || stripIndex < 0) return false;
     
-    currentDefaults_.ledStrips[stripIndex].pin = pin;
-    currentDefaults_.ledStrips[stripIndex].numLeds = numLeds;
-    currentDefaults_.ledStrips[stripIndex].colorOrder = colorOrder;
-    currentDefaults_.ledStrips[stripIndex].enabled = enabled;
-    
-    // Save the updated defaults
-    return saveDefaults(currentDefaults_);
+    LEDStripConfig& strip = currentDefaults_.ledStrips[stripIndex];
+    update(strip.pin, pin);
+    update(strip.numLeds, numLeds);
+    update(strip.colorOrder, colorOrder);
+    return update(strip.enabled, enabled);
 }
 
 bool BMDeviceDefaults::setActiveLEDStrips(int count) {
     if (count > MAX_LED_STRIPS || count < 0) return false;
     
-    currentDefaults_.activeLEDStrips = count;
-    return preferences_.putInt(PREF_LED_COUNT, count);
+    return update(currentDefaults_.activeLEDStrips, count);
 }
 
 LEDStripConfig BMDeviceDefaults::getLEDStripConfig(int stripIndex) {
@@ -352,13 +531,7 @@ int BMDeviceDefaults::getActiveLEDStrips() {
     return currentDefaults_.activeLEDStrips;
 }
 
-DeviceDefaults BMDeviceDefaults::getCurrentDefaults() {
-    return currentDefaults_;
-}
-
-String BMDeviceDefaults::defaultsToJSON() const {
-    StaticJsonDocument<1024> doc;
-    
+void BMDeviceDefaults::defaultsToJSON(JsonDocument& doc) const {
     doc["brightness"] = currentDefaults_.brightness;
     doc["maxBrightness"] = currentDefaults_.maxBrightness;
     doc["speed"] = currentDefaults_.speed;
@@ -378,19 +551,14 @@ String BMDeviceDefaults::defaultsToJSON() const {
     colorObj["r"] = currentDefaults_.effectColor.r;
     colorObj["g"] = currentDefaults_.effectColor.g;
     colorObj["b"] = currentDefaults_.effectColor.b;
-    
-    String output;
-    serializeJson(doc, output);
-    return output;
 }
 
-bool BMDeviceDefaults::defaultsFromJSON(const String& json) {
-    StaticJsonDocument<1024> doc;
-    DeserializationError error = deserializeJson(doc, json);
+bool BMDeviceDefaults::defaultsFromJSON(const char* json, size_t length) {
+    JsonDocument doc(BMJsonPool::shared());
+    DeserializationError error = deserializeJson(doc, json, length);
     
     if (error) {
-        Serial.print("[BMDeviceDefaults] JSON parse error: ");
-        Serial.println(error.c_str());
+        BMLOG_WARN("BMDeviceDefaults", "JSON parse error: %s", error.c_str());
         return false;
     }
     
@@ -403,8 +571,8 @@ bool BMDeviceDefaults::defaultsFromJSON(const String& json) {
     if (doc.containsKey("paletteId")) newDefaults.palette = (AvailablePalettes)(uint8_t)doc["paletteId"];
     if (doc.containsKey("effectId")) newDefaults.effect = (LightSceneID)(uint8_t)doc["effectId"];
     if (doc.containsKey("reverseDirection")) newDefaults.reverseDirection = doc["reverseDirection"];
-    if (doc.containsKey("owner")) newDefaults.owner = doc["owner"].as<String>();
-    if (doc.containsKey("deviceName")) newDefaults.deviceName = doc["deviceName"].as<String>();
+    if (doc["owner"].is<const char*>()) copyDefaultsString(newDefaults.owner, doc["owner"]);
+    if (doc["deviceName"].is<const char*>()) copyDefaultsString(newDefaults.deviceName, doc["deviceName"]);
     if (doc.containsKey("autoOn")) newDefaults.autoOn = doc["autoOn"];
     if (doc.containsKey("statusInterval")) newDefaults.statusUpdateInterval = doc["statusInterval"];
     if (doc.containsKey("gpsEnabled")) newDefaults.gpsEnabled = doc["gpsEnabled"];
@@ -443,18 +611,18 @@ bool BMDeviceDefaults::migrateIfNeeded() {
     
     if (storedVersion == 0) {
         // Fresh install or very old version
-        Serial.println("[BMDeviceDefaults] Fresh installation, no migration needed");
+        BMLOG_INFO("BMDeviceDefaults", "Fresh installation, no migration needed");
         return true;
     }
     
     if (storedVersion < DEFAULTS_VERSION) {
-        Serial.printf("[BMDeviceDefaults] Migrating from version %d to %d\n", storedVersion, DEFAULTS_VERSION);
+        BMLOG_INFO("BMDeviceDefaults", "Migrating from version %d to %d", storedVersion, DEFAULTS_VERSION);
         
         // Add migration logic here for future versions
         // For now, just update the version
         preferences_.putInt(PREF_VERSION, DEFAULTS_VERSION);
         
-        Serial.println("[BMDeviceDefaults] Migration complete");
+        BMLOG_INFO("BMDeviceDefaults", "Migration complete");
     }
     
     return true;
@@ -466,13 +634,14 @@ bool BMDeviceDefaults::hasValidDefaults() {
 
 void BMDeviceDefaults::printCurrentDefaults() {
     if (!initialized_) {
-        Serial.println("[BMDeviceDefaults] Not initialized");
+        BMLOG_WARN("BMDeviceDefaults", "Not initialized");
         return;
     }
     
+    BMLog::flush();     // Print queued messages first so they don't land in the middle
     Serial.println("═══ Current Device Defaults ═══");
-    Serial.printf("Owner: %s\n", currentDefaults_.owner.c_str());
-    Serial.printf("Device Name: %s\n", currentDefaults_.deviceName.c_str());
+    Serial.printf("Owner: %s\n", currentDefaults_.owner);
+    Serial.printf("Device Name: %s\n", currentDefaults_.deviceName);
     Serial.printf("Brightness: %d (max: %d)\n", currentDefaults_.brightness, currentDefaults_.maxBrightness);
     Serial.printf("Speed: %d\n", currentDefaults_.speed);
     Serial.printf("Palette: %s (%d)\n", LightShow::paletteIdToName(currentDefaults_.palette), (uint8_t)currentDefaults_.palette);
@@ -509,21 +678,10 @@ void BMDeviceDefaults::constrainValues(DeviceDefaults& defaults) {
         defaults.gpsTopSpeed = defaults.gpsLowSpeed + 1.0f;
     }
     
-    // Constrain string lengths
-    if (defaults.owner.length() > 32) {
-        defaults.owner = defaults.owner.substring(0, 32);
-    }
-    if (defaults.deviceName.length() > 32) {
-        defaults.deviceName = defaults.deviceName.substring(0, 32);
-    }
-}
-
-bool BMDeviceDefaults::writeString(const char* key, const String& value) {
-    if (!initialized_) {
-        return false;
-    }
-    
-    return preferences_.putString(key, value) == value.length();
+    // Terminate the strings
+    defaults.owner[DEFAULTS_STRING_MAX] = '\0';
+    defaults.deviceName[DEFAULTS_STRING_MAX] = '\0';
+    defaults.deviceType[DEFAULTS_STRING_MAX] = '\0';
 }
 
 String BMDeviceDefaults::readString(const char* key, const String& defaultValue) {
@@ -6,6 +6,8 @@
 #include <ArduinoJson.h>
 #include <FastLED.h>
 #include <LightShow.h>
+#include <vector>
+#include "BMSettingsRecord.h"
 
 #define MAX_LED_STRIPS 8
 
@@ -26,7 +28,19 @@ struct LEDStripConfig {
 #define DEFAULTS_NAMESPACE "bmdefaults"
 #define DEFAULTS_VERSION 1
 
-// Default setting keys
+// Setters only change the copy in RAM; loop() commits it once nothing has
+// changed for DEFAULTS_COMMIT_IDLE_MS, and flush() commits it right away.
+// A commit is one BMSettingsRecord (schema DEFAULTS_VERSION) in the
+// "record0"/"record1" keys, so boot reads the defaults with two getBytes().
+#define DEFAULTS_RECORD_NAME "record"
+#define DEFAULTS_RECORD_KEY_A "record0"
+#define DEFAULTS_RECORD_KEY_B "record1"
+#define DEFAULTS_PAYLOAD_MAX 180
+#define DEFAULTS_STRING_MAX 32
+#define DEFAULTS_COMMIT_IDLE_MS 2000
+
+// Default setting keys: the per-key layout from before the record, read
+// once and converted
 #define PREF_BRIGHTNESS "brightness"
 #define PREF_MAX_BRIGHTNESS "maxBrightness"
 #define PREF_SPEED "speed"
@@ -51,6 +65,17 @@ struct LEDStripConfig {
 #define PREF_GPS_LIGHTSHOW_SPEED_ENABLED "gpsLightshowSpeedEnabled"
 #define PREF_SYNC_ENABLED "syncEnabled"
 
+// Copies value into a DeviceDefaults string, cut at DEFAULTS_STRING_MAX
+// characters (or length, for values that aren't NUL-terminated)
+inline void copyDefaultsString(char* out, const char* value, size_t length = DEFAULTS_STRING_MAX) {
+    size_t n = 0;
+    while (n < length && n < DEFAULTS_STRING_MAX && value[n]) {
+        n++;
+    }
+    memcpy(out, value, n);
+    out[n] = '\0';
+}
+
 struct DeviceDefaults {
     // Core settings
     int brightness;
@@ -61,9 +86,9 @@ struct DeviceDefaults {
     bool reverseDirection;
     
     // Device identity
-    String owner;
-    String deviceName;
-    String deviceType;
+    char owner[DEFAULTS_STRING_MAX + 1];
+    char deviceName[DEFAULTS_STRING_MAX + 1];
+    char deviceType[DEFAULTS_STRING_MAX + 1];
     
     // LED configuration
     LEDStripConfig ledStrips[MAX_LED_STRIPS];
@@ -97,9 +122,9 @@ struct DeviceDefaults {
         palette = AvailablePalettes::cool;
         effect = LightSceneID::palette_stream;
         reverseDirection = true;
-        owner = "New";
-        deviceName = "BMDevice";
-        deviceType = "Generic";
+        copyDefaultsString(owner, "New");
+        copyDefaultsString(deviceName, "BMDevice");
+        copyDefaultsString(deviceType, "Generic");
         autoOn = true;
         
         // Initialize LED strips
@@ -146,9 +171,9 @@ public:
     bool setPalette(AvailablePalettes palette);
     bool setEffect(LightSceneID effect);
     bool setDirection(bool reverse);
-    bool setOwner(const String& owner);
-    bool setDeviceName(const String& name);
-    bool setDeviceType(const String& deviceType);
+    bool setOwner(const char* owner, size_t length = DEFAULTS_STRING_MAX);
+    bool setDeviceName(const char* name, size_t length = DEFAULTS_STRING_MAX);
+    bool setDeviceType(const char* deviceType, size_t length = DEFAULTS_STRING_MAX);
     bool setAutoOn(bool autoOn);
     
     // LED strip configuration
@@ -173,15 +198,21 @@ public:
     bool isSyncEnabled();
     
     // Get current defaults
-    DeviceDefaults getCurrentDefaults();
+    const DeviceDefaults& getCurrentDefaults() const { return currentDefaults_; }
     
     // JSON operations
-    String defaultsToJSON() const;
-    bool defaultsFromJSON(const String& json);
+    void defaultsToJSON(JsonDocument& doc) const;
+    bool defaultsFromJSON(const char* json, size_t length);
     
     // Validation
     bool validateDefaults(const DeviceDefaults& defaults);
     
+    // Write-behind
+    void loop();                      // Commits once the defaults have been left alone
+    bool flush();                     // Commits now if anything changed (power off, shutdown)
+    bool isDirty() const { return dirty_; }
+    uint32_t getCommitCount() const { return commits_; }
+    
     // Migration
     bool migrateIfNeeded();
     
@@ -191,12 +222,30 @@ public:
     
 private:
     Preferences preferences_;
+    BMSettingsRecord record_;
     DeviceDefaults currentDefaults_;
     bool initialized_;
+    bool dirty_;
+    unsigned long changedAt_;
+    uint32_t commits_;
     
     // Helper methods
+    template <typename T>
+    bool update(T& field, const T& value) {
+        if (!(field == value)) {
+            field = value;
+            markDirty();
+        }
+        return initialized_;
+    }
+    bool updateString(char* field, const char* value, size_t length);
+    void markDirty();
+    bool commitRecord();
+    bool loadRecord(DeviceDefaults& defaults);
+    bool loadLegacyKeys(DeviceDefaults& defaults);
+    static std::vector<uint8_t> encodePayload(const DeviceDefaults& defaults);
+    static bool decodePayload(const uint8_t* data, size_t length, DeviceDefaults& defaults);
     void constrainValues(DeviceDefaults& defaults);
-    bool writeString(const char* key, const String& value);
     String readString(const char* key, const String& defaultValue = "");
 };
 
@@ -1,9 +1,122 @@
 #include "BMDeviceState.h"
+#include "BMJsonPool.h"
+#include <BMLog.h>
 
-BMDeviceState::BMDeviceState() {
+int BMDeviceState::* const BMDeviceState::effectParameters_[STATE_EFFECT_PARAMETER_COUNT] = {
+    &BMDeviceState::waveWidth, &BMDeviceState::meteorCount, &BMDeviceState::trailLength,
+    &BMDeviceState::heatVariance, &BMDeviceState::mirrorCount, &BMDeviceState::cometCount,
+    &BMDeviceState::dropRate, &BMDeviceState::cloudScale, &BMDeviceState::blobCount,
+    &BMDeviceState::waveCount, &BMDeviceState::flashIntensity, &BMDeviceState::flashFrequency,
+    &BMDeviceState::explosionSize, &BMDeviceState::spiralArms
+};
+
+BMDeviceState::BMDeviceState() : changed_(0), generation_(0) {
     initializeDefaults();
 }
 
+void BMDeviceState::setPower(bool value) {
+    update(power, value, STATE_POWER);
+}
+
+void BMDeviceState::setBrightness(int value) {
+    update(brightness, value, STATE_BRIGHTNESS);
+}
+
+void BMDeviceState::setSpeed(uint16_t value) {
+    update(speed, value, STATE_SPEED);
+}
+
+void BMDeviceState::setReverseStrip(bool value) {
+    update(reverseStrip, value, STATE_DIRECTION);
+}
+
+void BMDeviceState::setPalette(AvailablePalettes value) {
+    update(currentPalette, value, STATE_PALETTE);
+}
+
+void BMDeviceState::setEffect(LightSceneID value) {
+    update(currentEffect, value, STATE_EFFECT);
+}
+
+void BMDeviceState::setEffectParameter(uint8_t index, int value) {
+    if (index < STATE_EFFECT_PARAMETER_COUNT) {
+        update(this->*effectParameters_[index], value, STATE_EFFECT_PARAMETER(index));
+    }
+}
+
+int BMDeviceState::getEffectParameter(uint8_t index) const {
+    return index < STATE_EFFECT_PARAMETER_COUNT ? this->*effectParameters_[index] : 0;
+}
+
+void BMDeviceState::setEffectColor(const CRGB& value) {
+    update(effectColor, value, STATE_EFFECT_COLOR);
+}
+
+void BMDeviceState::setOrigin(const Position& value) {
+    Position next = value;
+    if (origin.latitude() != next.latitude() || origin.longitude() != next.longitude()) {
+        origin = next;
+        markChanged(STATE_ORIGIN);
+    }
+}
+
+void BMDeviceState::setCurrentPosition(const Position& value) {
+    Position next = value;
+    if (currentPosition.latitude() != next.latitude() || currentPosition.longitude() != next.longitude()) {
+        currentPosition = next;
+        markChanged(STATE_POSITION);
+    }
+}
+
+void BMDeviceState::setPositionAvailable(bool value) {
+    update(positionAvailable, value, STATE_POSITION_AVAILABLE);
+}
+
+void BMDeviceState::setCurrentSpeed(float value) {
+    update(currentSpeed, value, STATE_CURRENT_SPEED);
+}
+
+void BMDeviceState::setGpsLowSpeed(float value) {
+    update(gpsLowSpeed, value, STATE_GPS_LOW_SPEED);
+}
+
+void BMDeviceState::setGpsTopSpeed(float value) {
+    update(gpsTopSpeed, value, STATE_GPS_TOP_SPEED);
+}
+
+void BMDeviceState::setGpsLightshowSpeedEnabled(bool value) {
+    update(gpsLightshowSpeedEnabled, value, STATE_GPS_LIGHTSHOW_SPEED);
+}
+
+void BMDeviceState::setSpeedometerColors(const CRGB& slow, const CRGB& fast) {
+    if (gpsSlowColor != slow || gpsFastColor != fast) {
+        gpsSlowColor = slow;
+        gpsFastColor = fast;
+        markChanged(STATE_SPEEDOMETER_COLORS);
+    }
+}
+
+void BMDeviceState::markChanged(uint32_t fields) {
+    changed_ |= fields;
+    generation_++;
+}
+
+void BMDeviceState::onChange(ChangeListener listener) {
+    listeners_.push_back(listener);
+}
+
+void BMDeviceState::publishChanges() {
+    if (changed_ == 0) {
+        return;
+    }
+    // Changes a listener makes go out with the next call
+    uint32_t fields = changed_;
+    changed_ = 0;
+    for (ChangeListener& listener : listeners_) {
+        listener(fields);
+    }
+}
+
 void BMDeviceState::initializeDefaults() {
     // Core device state
     power = true;
@@ -48,8 +161,8 @@ void BMDeviceState::initializeDefaults() {
     gpsFastColor = CRGB::Blue;    // Blue for fast speeds
 }
 
-String BMDeviceState::toJSON() const {
-    StaticJsonDocument<1024> doc; // Increased size for all effect parameters
+size_t BMDeviceState::toJSON(char* buffer, size_t size) const {
+    JsonDocument doc(BMJsonPool::shared());
     
     // Core device state
     doc["pwr"] = power;
@@ -97,128 +210,88 @@ String BMDeviceState::toJSON() const {
         posObj["lon"] = currentPos.longitude();
     }
     
-    String output;
-    serializeJson(doc, output);
-    return output;
+    if (measureJson(doc) >= size) {
+        return 0;
+    }
+    return serializeJson(doc, buffer, size);
 }
 
-void BMDeviceState::applyStateUpdate(const String& json) {
-    StaticJsonDocument<512> doc;
-    DeserializationError error = deserializeJson(doc, json);
+void BMDeviceState::applyStateUpdate(const char* json, size_t length) {
+    JsonDocument doc(BMJsonPool::shared());
+    DeserializationError error = deserializeJson(doc, json, length);
     
     if (error) {
-        Serial.print("[BMDeviceState] JSON parse error: ");
-        Serial.println(error.c_str());
+        BMLOG_WARN("BMDeviceState", "JSON parse error: %s", error.c_str());
         return;
     }
     
     // Update core state if present
-    if (doc.containsKey("pwr")) power = doc["pwr"];
+    if (doc.containsKey("pwr")) setPower(doc["pwr"]);
     if (doc.containsKey("bri")) {
-        brightness = doc["bri"];
-        constrainBrightness();
+        int value = doc["bri"];
+        setBrightness(constrain(value, 1, 100));
     }
     if (doc.containsKey("spd")) {
-        speed = doc["spd"];
-        constrainSpeed();
+        int value = doc["spd"];
+        setSpeed(constrain(value, 5, 200));
     }
-    if (doc.containsKey("dir")) reverseStrip = doc["dir"];
+    if (doc.containsKey("dir")) setReverseStrip(doc["dir"]);
     
     // Update effect state
     if (doc.containsKey("fxId")) {
         uint8_t effectId = doc["fxId"];
         if (effectId <= (uint8_t)LightSceneID::spiral_galaxy) {
-            currentEffect = (LightSceneID)effectId;
+            setEffect((LightSceneID)effectId);
         }
     }
     if (doc.containsKey("palId")) {
         uint8_t paletteId = doc["palId"];
         if (paletteId <= (uint8_t)AvailablePalettes::moltenmetal) {
-            currentPalette = (AvailablePalettes)paletteId;
+            setPalette((AvailablePalettes)paletteId);
         }
     }
     
-    // Update effect parameters with constraints
-    if (doc.containsKey("waveWidth")) {
-        waveWidth = doc["waveWidth"];
-        constrainEffectParameter(waveWidth, 1, 50);
-    }
-    if (doc.containsKey("meteorCount")) {
-        meteorCount = doc["meteorCount"];
-        constrainEffectParameter(meteorCount, 1, 20);
-    }
-    if (doc.containsKey("trailLength")) {
-        trailLength = doc["trailLength"];
-        constrainEffectParameter(trailLength, 1, 30);
-    }
-    if (doc.containsKey("heatVariance")) {
-        heatVariance = doc["heatVariance"];
-        constrainEffectParameter(heatVariance, 1, 100);
-    }
-    if (doc.containsKey("mirrorCount")) {
-        mirrorCount = doc["mirrorCount"];
-        constrainEffectParameter(mirrorCount, 1, 10);
-    }
-    if (doc.containsKey("cometCount")) {
-        cometCount = doc["cometCount"];
-        constrainEffectParameter(cometCount, 1, 10);
-    }
-    if (doc.containsKey("dropRate")) {
-        dropRate = doc["dropRate"];
-        constrainEffectParameter(dropRate, 1, 100);
-    }
-    if (doc.containsKey("cloudScale")) {
-        cloudScale = doc["cloudScale"];
-        constrainEffectParameter(cloudScale, 1, 50);
-    }
-    if (doc.containsKey("blobCount")) {
-        blobCount = doc["blobCount"];
-        constrainEffectParameter(blobCount, 1, 20);
-    }
-    if (doc.containsKey("waveCount")) {
-        waveCount = doc["waveCount"];
-        constrainEffectParameter(waveCount, 1, 15);
-    }
-    if (doc.containsKey("flashIntensity")) {
-        flashIntensity = doc["flashIntensity"];
-        constrainEffectParameter(flashIntensity, 1, 100);
-    }
-    if (doc.containsKey("flashFrequency")) {
-        flashFrequency = doc["flashFrequency"];
-        constrainEffectParameter(flashFrequency, 100, 5000);
-    }
-    if (doc.containsKey("explosionSize")) {
-        explosionSize = doc["explosionSize"];
-        constrainEffectParameter(explosionSize, 1, 50);
-    }
-    if (doc.containsKey("spiralArms")) {
-        spiralArms = doc["spiralArms"];
-        constrainEffectParameter(spiralArms, 1, 10);
+    // Update effect parameters with constraints, in BLE feature order
+    static const struct {
+        const char* key;
+        int min;
+        int max;
+    } parameters[STATE_EFFECT_PARAMETER_COUNT] = {
+        {"waveWidth", 1, 50}, {"meteorCount", 1, 20}, {"trailLength", 1, 30}, {"heatVariance", 1, 100},
+        {"mirrorCount", 1, 10}, {"cometCount", 1, 10}, {"dropRate", 1, 100}, {"cloudScale", 1, 50},
+        {"blobCount", 1, 20}, {"waveCount", 1, 15}, {"flashIntensity", 1, 100}, {"flashFrequency", 100, 5000},
+        {"explosionSize", 1, 50}, {"spiralArms", 1, 10}
+    };
+    for (uint8_t i = 0; i < STATE_EFFECT_PARAMETER_COUNT; i++) {
+        if (doc.containsKey(parameters[i].key)) {
+            int value = doc[parameters[i].key];
+            setEffectParameter(i, constrain(value, parameters[i].min, parameters[i].max));
+        }
     }
     
     // Update effect color
     if (doc.containsKey("effectColor")) {
         JsonObject colorObj = doc["effectColor"];
         if (colorObj.containsKey("r") && colorObj.containsKey("g") && colorObj.containsKey("b")) {
-            effectColor.r = constrain(colorObj["r"], 0, 255);
-            effectColor.g = constrain(colorObj["g"], 0, 255);
-            effectColor.b = constrain(colorObj["b"], 0, 255);
+            int r = colorObj["r"], g = colorObj["g"], b = colorObj["b"];
+            setEffectColor(CRGB(constrain(r, 0, 255), constrain(g, 0, 255), constrain(b, 0, 255)));
         }
     }
     
     // Update GPS/position data
-    if (doc.containsKey("posAvail")) positionAvailable = doc["posAvail"];
-    if (doc.containsKey("spdCur")) currentSpeed = doc["spdCur"];
+    if (doc.containsKey("posAvail")) setPositionAvailable(doc["posAvail"]);
+    if (doc.containsKey("spdCur")) setCurrentSpeed(doc["spdCur"]);
     if (doc.containsKey("pos")) {
         JsonObject posObj = doc["pos"];
         if (posObj.containsKey("lat") && posObj.containsKey("lon")) {
-            currentPosition = Position(posObj["lat"], posObj["lon"]);
+            setCurrentPosition(Position(posObj["lat"], posObj["lon"]));
         }
     }
 }
 
 void BMDeviceState::reset() {
     initializeDefaults();
+    markChanged(STATE_ALL);
 }
 
 void BMDeviceState::constrainBrightness(int min, int max) {
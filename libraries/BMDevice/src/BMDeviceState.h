@@ -6,9 +6,39 @@
 #include <FastLED.h>
 #include <LightShow.h>
 #include <Position.h>
+#include <functional>
+#include <vector>
+
+// Change tracking: a bit per field, or per group of fields that change
+// together. The setters set it and bump the generation when the value really
+// changes; code that assigns a public field directly calls markChanged().
+// BMDevice::loop() hands the bits gathered since the last loop to every
+// listener, then clears them.
+#define STATE_POWER (UINT32_C(1) << 0)
+#define STATE_BRIGHTNESS (UINT32_C(1) << 1)
+#define STATE_SPEED (UINT32_C(1) << 2)
+#define STATE_DIRECTION (UINT32_C(1) << 3)
+#define STATE_PALETTE (UINT32_C(1) << 4)
+#define STATE_EFFECT (UINT32_C(1) << 5)
+#define STATE_EFFECT_PARAMETER(index) (UINT32_C(1) << (6 + (index)))  // index in BLE feature order (0x0B-0x18)
+#define STATE_EFFECT_PARAMETERS (UINT32_C(0x3FFF) << 6)
+#define STATE_EFFECT_COLOR (UINT32_C(1) << 20)
+#define STATE_ORIGIN (UINT32_C(1) << 21)
+#define STATE_POSITION (UINT32_C(1) << 22)
+#define STATE_POSITION_AVAILABLE (UINT32_C(1) << 23)
+#define STATE_CURRENT_SPEED (UINT32_C(1) << 24)
+#define STATE_GPS_LOW_SPEED (UINT32_C(1) << 25)
+#define STATE_GPS_TOP_SPEED (UINT32_C(1) << 26)
+#define STATE_GPS_LIGHTSHOW_SPEED (UINT32_C(1) << 27)
+#define STATE_SPEEDOMETER_COLORS (UINT32_C(1) << 28)
+#define STATE_ALL ((UINT32_C(1) << 29) - 1)
+
+#define STATE_EFFECT_PARAMETER_COUNT 14
 
 class BMDeviceState {
 public:
+    typedef std::function<void(uint32_t fields)> ChangeListener;
+    
     BMDeviceState();
     
     // Core device state
@@ -53,9 +83,36 @@ public:
     CRGB gpsSlowColor;
     CRGB gpsFastColor;
     
-    // State management
-    String toJSON() const;
-    void applyStateUpdate(const String& json);
+    // Setters that track changes
+    void setPower(bool value);
+    void setBrightness(int value);
+    void setSpeed(uint16_t value);
+    void setReverseStrip(bool value);
+    void setPalette(AvailablePalettes value);
+    void setEffect(LightSceneID value);
+    void setEffectParameter(uint8_t index, int value);
+    int getEffectParameter(uint8_t index) const;
+    void setEffectColor(const CRGB& value);
+    void setOrigin(const Position& value);
+    void setCurrentPosition(const Position& value);
+    void setPositionAvailable(bool value);
+    void setCurrentSpeed(float value);
+    void setGpsLowSpeed(float value);
+    void setGpsTopSpeed(float value);
+    void setGpsLightshowSpeedEnabled(bool value);
+    void setSpeedometerColors(const CRGB& slow, const CRGB& fast);
+    
+    // Change stream
+    void markChanged(uint32_t fields);
+    uint32_t getChanged() const { return changed_; }
+    uint32_t getGeneration() const { return generation_; }
+    void onChange(ChangeListener listener);
+    void publishChanges();
+    
+    // State management. toJSON returns the length, or 0 if it doesn't fit
+    size_t toJSON(char* buffer, size_t size) const;
+    void applyStateUpdate(const char* json, size_t length);
+    void applyStateUpdate(const char* json) { applyStateUpdate(json, strlen(json)); }
     void reset();
     
     // Parameter validation and constraints
@@ -65,6 +122,21 @@ public:
     
 private:
     void initializeDefaults();
+    
+    template <typename T>
+    void update(T& field, const T& value, uint32_t bit) {
+        if (field != value) {
+            field = value;
+            markChanged(bit);
+        }
+    }
+    
+    // The effect parameters, in BLE feature order
+    static int BMDeviceState::* const effectParameters_[STATE_EFFECT_PARAMETER_COUNT];
+    
+    uint32_t changed_;
+    uint32_t generation_;
+    std::vector<ChangeListener> listeners_;
 };
 
 #endif // BM_DEVICE_STATE_H 
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "BMFeatureRegistry.h"
+#include <BMLog.h>
+
+BMFeatureRegistry::BMFeatureRegistry() : namespaceCount_(0) {
+    memset(namespaces_, 0, sizeof(namespaces_));
+    memset(index_, FEATURE_NO_HANDLER, sizeof(index_));
+    memset(&noStats_, 0, sizeof(noStats_));
+}
+
+bool BMFeatureRegistry::registerNamespace(const char* name, uint8_t first, uint8_t last) {
+    if (first > last || namespaceCount_ >= FEATURE_MAX_NAMESPACES || strlen(name) > FEATURE_NAMESPACE_NAME ||
+        findNamespace(name) >= 0) {
+        BMLOG_WARN("BMFeatureRegistry", "Can't add namespace %s (0x%02X-0x%02X)", name, first, last);
+        return false;
+    }
+    for (uint8_t i = 0; i < namespaceCount_; i++) {
+        if (first <= namespaces_[i].last && last >= namespaces_[i].first) {
+            BMLOG_WARN("BMFeatureRegistry", "Namespace %s (0x%02X-0x%02X) overlaps %s (0x%02X-0x%02X)", name,
+                       first, last, namespaces_[i].name, namespaces_[i].first, namespaces_[i].last);
+            return false;
+        }
+    }
+    Namespace& space = namespaces_[namespaceCount_++];
+    strncpy(space.name, name, FEATURE_NAMESPACE_NAME);
+    space.first = first;
+    space.last = last;
+    return true;
+}
+
+bool BMFeatureRegistry::registerFeature(const char* space, uint8_t feature, Handler handler, size_t minLength,
+                                        size_t maxLength) {
+    int spaceIndex = findNamespace(space);
+    if (spaceIndex < 0 || feature < namespaces_[spaceIndex].first || feature > namespaces_[spaceIndex].last) {
+        BMLOG_WARN("BMFeatureRegistry", "Feature 0x%02X is outside namespace %s", feature, space);
+        return false;
+    }
+    if (has(feature)) {
+        BMLOG_WARN("BMFeatureRegistry", "Feature 0x%02X already has a handler", feature);
+        return false;
+    }
+    if (entries_.size() >= FEATURE_NO_HANDLER || !handler || minLength < 1 || minLength > maxLength) {
+        BMLOG_WARN("BMFeatureRegistry", "Can't add feature 0x%02X", feature);
+        return false;
+    }
+
+    Entry entry;
+    entry.handler = handler;
+    entry.minLength = (uint16_t)minLength;
+    entry.maxLength = (uint16_t)(maxLength < 0xFFFF ? maxLength : 0xFFFF);
+    entry.space = (uint8_t)spaceIndex;
+    memset(&entry.stats, 0, sizeof(entry.stats));
+    index_[feature] = (uint8_t)entries_.size();
+    entries_.push_back(entry);
+    return true;
+}
+
+bool BMFeatureRegistry::accepts(uint8_t feature, size_t length) const {
+    if (!has(feature)) {
+        return false;
+    }
+    const Entry& entry = entries_[index_[feature]];
+    return length >= entry.minLength && length <= entry.maxLength;
+}
+
+bool BMFeatureRegistry::dispatch(uint8_t feature, const uint8_t* buffer, size_t length) {
+    if (!has(feature)) {
+        return false;
+    }
+    Entry& entry = entries_[index_[feature]];
+    if (length < entry.minLength || length > entry.maxLength) {
+        entry.stats.rejected++;
+        BMLOG_WARN("BMFeatureRegistry", "Feature 0x%02X: %u bytes, takes %u-%u", feature, (unsigned)length,
+                   entry.minLength, entry.maxLength);
+        return false;
+    }
+
+    unsigned long start = micros();
+    entry.handler(buffer, length);
+    unsigned long elapsed = micros() - start;
+
+    // Buckets grow 4x from 16us
+    uint8_t bucket = 0;
+    for (unsigned long limit = 16; bucket < FEATURE_LATENCY_BUCKETS - 1 && elapsed >= limit; limit *= 4) {
+        bucket++;
+    }
+    entry.stats.latency[bucket]++;
+    entry.stats.calls++;
+    return true;
+}
+
+const FeatureStats& BMFeatureRegistry::getStats(uint8_t feature) const {
+    return has(feature) ? entries_[index_[feature]].stats : noStats_;
+}
+
+const char* BMFeatureRegistry::getNamespace(uint8_t feature) const {
+    return has(feature) ? namespaces_[entries_[index_[feature]].space].name : nullptr;
+}
+
+size_t BMFeatureRegistry::getCapabilities(uint8_t* out, size_t capacity) const {
+    size_t needed = 3 + 32;
+    for (uint8_t i = 0; i < namespaceCount_; i++) {
+        needed += 3 + strlen(namespaces_[i].name);
+    }
+    if (needed > capacity) {
+        return 0;
+    }
+
+    size_t length = 0;
+    out[length++] = FEATURE_CAPABILITIES_MAGIC;
+    out[length++] = FEATURE_CAPABILITIES_VERSION;
+    out[length++] = namespaceCount_;
+    for (uint8_t i = 0; i < namespaceCount_; i++) {
+        size_t nameLength = strlen(namespaces_[i].name);
+        out[length++] = namespaces_[i].first;
+        out[length++] = namespaces_[i].last;
+        out[length++] = (uint8_t)nameLength;
+        memcpy(out + length, namespaces_[i].name, nameLength);
+        length += nameLength;
+    }
+    uint8_t* bitmap = out + length;
+    memset(bitmap, 0, 32);
+    for (int feature = 0; feature < 256; feature++) {
+        if (has((uint8_t)feature)) {
+            bitmap[feature / 8] |= 1 << (feature % 8);
+        }
+    }
+    return length + 32;
+}
+
+int BMFeatureRegistry::findNamespace(const char* name) const {
+    for (uint8_t i = 0; i < namespaceCount_; i++) {
+        if (strcmp(namespaces_[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
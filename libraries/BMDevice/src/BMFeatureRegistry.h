@@ -0,0 +1,79 @@
+#ifndef BM_FEATURE_REGISTRY_H
+#define BM_FEATURE_REGISTRY_H
+
+#include <Arduino.h>
+#include <functional>
+#include <vector>
+
+// BLE feature dispatch: one handler per opcode, found through a 256-entry
+// index. Opcodes are grouped in namespaces, each claiming a range at startup
+// (BMDevice's own commands are "core", 0x01-0x3F), so two parts of a firmware
+// can't both take the same opcode without it showing at registration.
+//
+// Capabilities (BLE_FEATURE_GET_CAPABILITIES), notified on the status
+// characteristic:
+//   magic 0xCA | version | namespace count
+//   | per namespace: first | last | name length | name
+//   | 32-byte bitmap, bit n set when opcode n has a handler
+#define FEATURE_CAPABILITIES_MAGIC 0xCA
+#define FEATURE_CAPABILITIES_VERSION 1
+#define FEATURE_NO_HANDLER 0xFF
+#define FEATURE_MAX_NAMESPACES 8
+#define FEATURE_NAMESPACE_NAME 15
+#define FEATURE_LATENCY_BUCKETS 8     // Under 16us, 64us, 256us, 1ms, 4ms, 16ms, 65ms, and longer
+
+struct FeatureStats {
+    uint32_t calls;
+    uint32_t rejected;                // Shorter or longer than the handler takes
+    uint32_t latency[FEATURE_LATENCY_BUCKETS];
+};
+
+class BMFeatureRegistry {
+public:
+    typedef std::function<void(const uint8_t* buffer, size_t length)> Handler;
+
+    BMFeatureRegistry();
+
+    // Claims opcodes first..last; false if the range overlaps another namespace
+    bool registerNamespace(const char* name, uint8_t first, uint8_t last);
+    // Lengths count the whole write, opcode included. False if the opcode is
+    // outside the namespace or already has a handler.
+    bool registerFeature(const char* space, uint8_t feature, Handler handler, size_t minLength = 1,
+                         size_t maxLength = 512);
+
+    bool has(uint8_t feature) const { return index_[feature] != FEATURE_NO_HANDLER; }
+    bool accepts(uint8_t feature, size_t length) const;
+
+    // Runs the opcode's handler; false if there is none or the length is wrong
+    bool dispatch(uint8_t feature, const uint8_t* buffer, size_t length);
+
+    // Empty stats for an opcode without a handler
+    const FeatureStats& getStats(uint8_t feature) const;
+    const char* getNamespace(uint8_t feature) const;
+    size_t getCapabilities(uint8_t* out, size_t capacity) const;
+
+private:
+    struct Namespace {
+        char name[FEATURE_NAMESPACE_NAME + 1];
+        uint8_t first;
+        uint8_t last;
+    };
+
+    struct Entry {
+        Handler handler;
+        uint16_t minLength;
+        uint16_t maxLength;
+        uint8_t space;
+        FeatureStats stats;
+    };
+
+    int findNamespace(const char* name) const;
+
+    Namespace namespaces_[FEATURE_MAX_NAMESPACES];
+    uint8_t namespaceCount_;
+    std::vector<Entry> entries_;
+    uint8_t index_[256];              // Opcode to entry, FEATURE_NO_HANDLER if none
+    FeatureStats noStats_;
+};
+
+#endif // BM_FEATURE_REGISTRY_H
@@ -0,0 +1,102 @@
+#include "BMJsonPool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Each allocation: its size, padded to BM_JSON_POOL_ALIGN, then the bytes
+#define POOL_HEADER BM_JSON_POOL_ALIGN
+
+namespace {
+
+size_t roundUp(size_t size) {
+    return (size + BM_JSON_POOL_ALIGN - 1) & ~(size_t)(BM_JSON_POOL_ALIGN - 1);
+}
+
+}
+
+BMJsonPool::BMJsonPool() : used_(0), newest_(0), live_(0), highWater_(0), spills_(0) {}
+
+BMJsonPool* BMJsonPool::shared() {
+    static BMJsonPool pool;
+    return &pool;
+}
+
+bool BMJsonPool::owns(const void* ptr) const {
+    const uint8_t* p = (const uint8_t*)ptr;
+    return p >= bytes_ && p < bytes_ + sizeof(bytes_);
+}
+
+size_t BMJsonPool::blockSize(const void* ptr) {
+    uint32_t size;
+    memcpy(&size, (const uint8_t*)ptr - POOL_HEADER, sizeof(size));
+    return size;
+}
+
+void* BMJsonPool::allocate(size_t size) {
+    size_t needed = POOL_HEADER + roundUp(size);
+    if (needed > sizeof(bytes_) - used_) {
+        spills_++;
+        return malloc(size);
+    }
+    uint32_t stored = (uint32_t)size;
+    memcpy(bytes_ + used_, &stored, sizeof(stored));
+    newest_ = used_;
+    used_ += needed;
+    live_++;
+    if (used_ > highWater_) {
+        highWater_ = used_;
+    }
+    return bytes_ + newest_ + POOL_HEADER;
+}
+
+void BMJsonPool::deallocate(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    if (!owns(ptr)) {
+        free(ptr);
+        return;
+    }
+    size_t offset = (uint8_t*)ptr - bytes_ - POOL_HEADER;
+    if (offset == newest_) {
+        used_ = newest_;
+    }
+    if (--live_ == 0) {
+        used_ = 0;
+    }
+    newest_ = used_;
+}
+
+void* BMJsonPool::reallocate(void* ptr, size_t newSize) {
+    if (!ptr) {
+        return allocate(newSize);
+    }
+    if (!owns(ptr)) {
+        return realloc(ptr, newSize);
+    }
+
+    size_t offset = (uint8_t*)ptr - bytes_ - POOL_HEADER;
+    size_t oldSize = blockSize(ptr);
+    uint32_t stored = (uint32_t)newSize;
+    if (offset == newest_ && POOL_HEADER + roundUp(newSize) <= sizeof(bytes_) - offset) {
+        // Grow or shrink in place
+        memcpy(bytes_ + offset, &stored, sizeof(stored));
+        used_ = offset + POOL_HEADER + roundUp(newSize);
+        if (used_ > highWater_) {
+            highWater_ = used_;
+        }
+        return ptr;
+    }
+    if (newSize <= oldSize) {
+        // Shrinking something older: keep the space until the block starts over
+        memcpy(bytes_ + offset, &stored, sizeof(stored));
+        return ptr;
+    }
+
+    void* moved = allocate(newSize);
+    if (moved) {
+        memcpy(moved, ptr, oldSize);
+        deallocate(ptr);
+    }
+    return moved;
+}
@@ -0,0 +1,50 @@
+#ifndef BM_JSON_POOL_H
+#define BM_JSON_POOL_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// ArduinoJson allocator over one fixed block, so the documents BMDevice builds
+// for status and control don't come from the heap:
+//   JsonDocument doc(BMJsonPool::shared());
+// Allocations stack up in the block; freeing the newest one gives its space
+// back, and the block starts over once everything in it has been freed. A
+// document that outgrows what is left spills to the heap, and that is counted.
+// Only for the loop task.
+#ifndef BM_JSON_POOL_SIZE
+#define BM_JSON_POOL_SIZE (1024 * sizeof(void*))    // A config document's variant pools
+#endif
+#define BM_JSON_POOL_ALIGN 8
+
+class BMJsonPool : public ArduinoJson::Allocator {
+public:
+    BMJsonPool();
+
+    static BMJsonPool* shared();
+
+    void* allocate(size_t size) override;
+    void deallocate(void* ptr) override;
+    void* reallocate(void* ptr, size_t newSize) override;
+
+    size_t getHighWater() const { return highWater_; }    // Bytes of the block ever in use
+    uint32_t getSpills() const { return spills_; }        // Allocations that went to the heap
+
+private:
+    BMJsonPool(const BMJsonPool&);
+    BMJsonPool& operator=(const BMJsonPool&);
+
+    bool owns(const void* ptr) const;
+    static size_t blockSize(const void* ptr);
+
+    union {
+        uint8_t bytes_[BM_JSON_POOL_SIZE];
+        double align_;
+    };
+    size_t used_;
+    size_t newest_;     // Offset of the newest allocation's header
+    size_t live_;       // Allocations in the block not yet freed
+    size_t highWater_;
+    uint32_t spills_;
+};
+
+#endif // BM_JSON_POOL_H
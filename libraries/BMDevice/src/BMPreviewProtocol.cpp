@@ -0,0 +1,493 @@
+#include "BMPreviewProtocol.h"
+
+#define ATT_NOTIFY_HEADER 3     // Opcode, handle
+#define ATT_READ_BLOB_HEADER 1  // Opcode
+#define L2CAP_HEADER 4
+#define ANY_DISTANCE 0xFFFF
+
+namespace {
+
+// Sum of the channel differences a sample may be off by, per bit depth
+const uint16_t kTolerance[PREVIEW_MAX_BITS - PREVIEW_MIN_BITS + 1] = {48, 36, 24, 16, 8};
+
+void writeBits(uint8_t* buffer, size_t bit, uint8_t value, uint8_t bits) {
+    for (uint8_t i = 0; i < bits; i++, bit++) {
+        if (value & (1 << i)) {
+            buffer[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+}
+
+uint8_t readBits(const uint8_t* buffer, size_t bit, uint8_t bits) {
+    uint8_t value = 0;
+    for (uint8_t i = 0; i < bits; i++, bit++) {
+        if (buffer[bit / 8] & (1 << (bit % 8))) {
+            value |= 1 << i;
+        }
+    }
+    return value;
+}
+
+size_t bitBytes(size_t bits) { return (bits + 7) / 8; }
+
+}
+
+BMPreviewEncoder::BMPreviewEncoder()
+    : samplesPerStrip_(PREVIEW_DEFAULT_SAMPLES), bits_(PREVIEW_DEFAULT_BITS), tolerance_(0), strips_(0),
+      sampleCount_(0), key_(true), sentStrips_(0), slotsKnown_(0), freeCursor_(0), bodyLength_(0), cursor_(0),
+      frame_(0), fragment_(0), sending_(false), sendingKey_(false) {
+    memset(stripSamples_, 0, sizeof(stripSamples_));
+    memset(sentStripSamples_, 0, sizeof(sentStripSamples_));
+    memset(index_, 0, sizeof(index_));
+    memset(&stats_, 0, sizeof(stats_));
+    configure(samplesPerStrip_, bits_);
+}
+
+void BMPreviewEncoder::configure(uint8_t samplesPerStrip, uint8_t bits) {
+    samplesPerStrip_ = constrain(samplesPerStrip, 1, PREVIEW_MAX_SAMPLES_PER_STRIP);
+    bits_ = constrain(bits, PREVIEW_MIN_BITS, PREVIEW_MAX_BITS);
+    tolerance_ = kTolerance[bits_ - PREVIEW_MIN_BITS];
+    reset();
+}
+
+void BMPreviewEncoder::reset() {
+    key_ = true;
+    sending_ = false;
+}
+
+void BMPreviewEncoder::beginFrame() {
+    strips_ = 0;
+    sampleCount_ = 0;
+}
+
+void BMPreviewEncoder::addStrip(const CRGB* leds, uint16_t count, uint8_t brightness) {
+    if (strips_ >= PREVIEW_MAX_STRIPS) {
+        return;
+    }
+    uint8_t samples = count < samplesPerStrip_ ? count : samplesPerStrip_;
+    stripSamples_[strips_++] = samples;
+    for (uint8_t s = 0; s < samples; s++) {
+        // Each sample is the average of its span
+        uint16_t first = (uint32_t)s * count / samples;
+        uint16_t end = (uint32_t)(s + 1) * count / samples;
+        uint32_t r = 0, g = 0, b = 0;
+        for (uint16_t i = first; i < end; i++) {
+            r += leds[i].r;
+            g += leds[i].g;
+            b += leds[i].b;
+        }
+        uint16_t n = end - first;
+        samples_[sampleCount_++] = CRGB(scale8(r / n, brightness), scale8(g / n, brightness), scale8(b / n, brightness));
+    }
+}
+
+void BMPreviewEncoder::addSolidStrip(const CRGB& color, uint16_t count, uint8_t brightness) {
+    if (strips_ >= PREVIEW_MAX_STRIPS) {
+        return;
+    }
+    uint8_t samples = count < samplesPerStrip_ ? count : samplesPerStrip_;
+    stripSamples_[strips_++] = samples;
+    CRGB shown(scale8(color.r, brightness), scale8(color.g, brightness), scale8(color.b, brightness));
+    for (uint8_t s = 0; s < samples; s++) {
+        samples_[sampleCount_++] = shown;
+    }
+}
+
+uint16_t BMPreviewEncoder::distance(const CRGB& a, const CRGB& b) {
+    // Off is never close to lit, so a dark strip shows dark
+    if (!a != !b) {
+        return ANY_DISTANCE - 1;
+    }
+    return abs((int)a.r - b.r) + abs((int)a.g - b.g) + abs((int)a.b - b.b);
+}
+
+int BMPreviewEncoder::nearest(const CRGB& color, uint16_t tolerance) const {
+    int best = -1;
+    uint16_t bestDistance = 0;
+    for (size_t slot = 0; slot < slotsKnown_; slot++) {
+        if (!known_[slot]) {
+            continue;
+        }
+        uint16_t d = distance(palette_[slot], color);
+        if (d <= tolerance && (best < 0 || d < bestDistance)) {
+            best = (int)slot;
+            bestDistance = d;
+            if (d == 0) {
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+int BMPreviewEncoder::freeSlot() {
+    // Round the slots, so the one given up longest ago goes first
+    size_t slots = (size_t)1 << bits_;
+    for (size_t i = 0; i < slots; i++) {
+        size_t slot = (freeCursor_ + i) % slots;
+        if (!used_[slot]) {
+            freeCursor_ = (slot + 1) % slots;
+            return (int)slot;
+        }
+    }
+    return -1;
+}
+
+bool BMPreviewEncoder::prepare() {
+    bool key = key_ || strips_ != sentStrips_ || memcmp(stripSamples_, sentStripSamples_, strips_) != 0;
+    size_t slots = (size_t)1 << bits_;
+    if (key) {
+        memset(known_, 0, sizeof(known_));
+        slotsKnown_ = 0;
+        freeCursor_ = 0;
+    }
+    memset(used_, 0, sizeof(used_));
+    memset(updated_, 0, sizeof(updated_));
+
+    // Samples still close to their slot, or to another the app has
+    bool pending[PREVIEW_MAX_SAMPLES];
+    bool anyPending = false;
+    for (size_t i = 0; i < sampleCount_; i++) {
+        int slot;
+        if (!key && known_[index_[i]] && distance(palette_[index_[i]], samples_[i]) <= tolerance_) {
+            slot = index_[i];
+        } else {
+            slot = nearest(samples_[i], tolerance_);
+        }
+        pending[i] = slot < 0;
+        anyPending |= pending[i];
+        if (slot >= 0) {
+            next_[i] = (uint8_t)slot;
+            used_[slot] = true;
+        }
+    }
+
+    // The rest: a slot filled this frame, a free one, or failing both the nearest
+    for (size_t i = 0; anyPending && i < sampleCount_; i++) {
+        if (!pending[i]) {
+            continue;
+        }
+        int slot = nearest(samples_[i], tolerance_);
+        if (slot < 0) {
+            slot = freeSlot();
+            if (slot >= 0) {
+                palette_[slot] = samples_[i];
+                known_[slot] = true;
+                updated_[slot] = true;
+                if ((size_t)slot >= slotsKnown_) {
+                    slotsKnown_ = slot + 1;
+                }
+            } else {
+                slot = nearest(samples_[i], ANY_DISTANCE);
+            }
+        }
+        next_[i] = (uint8_t)slot;
+        used_[slot] = true;
+    }
+
+    // Anything for the app?
+    size_t changed = 0;
+    size_t updates = 0;
+    for (size_t slot = 0; slot < slots; slot++) {
+        updates += updated_[slot];
+    }
+    for (size_t i = 0; i < sampleCount_; i++) {
+        changed += key || next_[i] != index_[i];
+    }
+    if (!key && changed == 0 && updates == 0) {
+        return false;
+    }
+
+    encodeBody(key);
+    memcpy(index_, next_, sampleCount_);
+    sentStrips_ = strips_;
+    memcpy(sentStripSamples_, stripSamples_, sizeof(sentStripSamples_));
+    key_ = false;
+
+    frame_++;
+    cursor_ = 0;
+    fragment_ = 0;
+    sending_ = true;
+    sendingKey_ = key;
+    stats_.frames++;
+    stats_.samples += sampleCount_;
+    stats_.paletteUpdates += updates;
+    if (key) {
+        stats_.keyframes++;
+    } else {
+        stats_.changedSamples += changed;
+    }
+    return true;
+}
+
+void BMPreviewEncoder::encodeBody(bool key) {
+    size_t slots = (size_t)1 << bits_;
+    size_t length = 0;
+    memset(body_, 0, sizeof(body_));
+    if (key) {
+        body_[length++] = bits_;
+        body_[length++] = strips_;
+        memcpy(body_ + length, stripSamples_, strips_);
+        length += strips_;
+    }
+
+    size_t updatesAt = length;
+    uint16_t updates = 0;
+    length += 2;
+    for (size_t slot = 0; slot < slots; slot++) {
+        if (updated_[slot]) {
+            body_[length++] = (uint8_t)slot;
+            body_[length++] = palette_[slot].r;
+            body_[length++] = palette_[slot].g;
+            body_[length++] = palette_[slot].b;
+            updates++;
+        }
+    }
+    body_[updatesAt] = (uint8_t)updates;
+    body_[updatesAt + 1] = (uint8_t)(updates >> 8);
+
+    size_t bit = 0;
+    uint8_t* indices = body_ + length;
+    if (key) {
+        for (size_t i = 0; i < sampleCount_; i++, bit += bits_) {
+            writeBits(indices, bit, next_[i], bits_);
+        }
+    } else {
+        // The change bitmap, then the changed samples' slots
+        for (size_t i = 0; i < sampleCount_; i++, bit++) {
+            if (next_[i] != index_[i]) {
+                writeBits(indices, bit, 1, 1);
+            }
+        }
+        bit = bitBytes(sampleCount_) * 8;
+        for (size_t i = 0; i < sampleCount_; i++) {
+            if (next_[i] != index_[i]) {
+                writeBits(indices, bit, next_[i], bits_);
+                bit += bits_;
+            }
+        }
+    }
+    bodyLength_ = length + bitBytes(bit);
+}
+
+size_t BMPreviewEncoder::nextFragment(uint8_t* out, size_t capacity) {
+    if (!sending_) {
+        return 0;
+    }
+    if (capacity > PREVIEW_MAX_MESSAGE) {
+        capacity = PREVIEW_MAX_MESSAGE;
+    }
+    if (capacity <= PREVIEW_HEADER_SIZE) {
+        sending_ = false;
+        return 0;
+    }
+    size_t part = bodyLength_ - cursor_;
+    if (part > capacity - PREVIEW_HEADER_SIZE) {
+        part = capacity - PREVIEW_HEADER_SIZE;
+    }
+    memcpy(out + PREVIEW_HEADER_SIZE, body_ + cursor_, part);
+    cursor_ += part;
+    bool last = cursor_ >= bodyLength_;
+
+    out[0] = PREVIEW_MAGIC;
+    out[1] = PREVIEW_VERSION;
+    out[2] = (sendingKey_ ? PREVIEW_FLAG_KEY : 0) | (last ? PREVIEW_FLAG_LAST : 0);
+    out[3] = (uint8_t)frame_;
+    out[4] = (uint8_t)(frame_ >> 8);
+    out[5] = fragment_++;
+    sending_ = !last;
+    stats_.fragments++;
+    stats_.bytes += PREVIEW_HEADER_SIZE + part;
+    if (sendingKey_) {
+        stats_.keyframeBytes += PREVIEW_HEADER_SIZE + part;
+    }
+    return PREVIEW_HEADER_SIZE + part;
+}
+
+BMPreviewDecoder::BMPreviewDecoder() : rejected_(0) {
+    reset();
+}
+
+void BMPreviewDecoder::reset() {
+    hasFrame_ = false;
+    frame_ = 0;
+    bits_ = 0;
+    strips_ = 0;
+    sampleCount_ = 0;
+    memset(stripSamples_, 0, sizeof(stripSamples_));
+    memset(palette_, 0, sizeof(palette_));
+    memset(index_, 0, sizeof(index_));
+    assembling_ = false;
+    bodyLength_ = 0;
+}
+
+bool BMPreviewDecoder::handleMessage(const uint8_t* data, size_t length) {
+    if (length < PREVIEW_HEADER_SIZE || data[0] != PREVIEW_MAGIC || data[1] != PREVIEW_VERSION) {
+        rejected_++;
+        return false;
+    }
+    uint8_t flags = data[2];
+    uint16_t frame = data[3] | data[4] << 8;
+    uint8_t fragment = data[5];
+    size_t part = length - PREVIEW_HEADER_SIZE;
+
+    if (fragment == 0) {
+        assembling_ = true;
+        assemblingFrame_ = frame;
+        assemblingFlags_ = flags & PREVIEW_FLAG_KEY;
+        nextFragment_ = 0;
+        bodyLength_ = 0;
+    }
+    if (!assembling_ || frame != assemblingFrame_ || fragment != nextFragment_ ||
+        bodyLength_ + part > sizeof(body_)) {
+        assembling_ = false;
+        rejected_++;
+        return false;
+    }
+    memcpy(body_ + bodyLength_, data + PREVIEW_HEADER_SIZE, part);
+    bodyLength_ += part;
+    nextFragment_++;
+    if (!(flags & PREVIEW_FLAG_LAST)) {
+        return false;
+    }
+
+    assembling_ = false;
+    bool key = assemblingFlags_ & PREVIEW_FLAG_KEY;
+    // A delta only goes on the frame before it
+    if (!key && (!hasFrame_ || frame != (uint16_t)(frame_ + 1))) {
+        rejected_++;
+        return false;
+    }
+    if (!apply(key)) {
+        rejected_++;
+        return false;
+    }
+    frame_ = frame;
+    hasFrame_ = true;
+    return true;
+}
+
+bool BMPreviewDecoder::apply(bool key) {
+    size_t offset = 0;
+    uint8_t bits = bits_;
+    uint8_t strips = strips_;
+    uint8_t stripSamples[PREVIEW_MAX_STRIPS];
+    memcpy(stripSamples, stripSamples_, sizeof(stripSamples));
+    size_t sampleCount = sampleCount_;
+
+    if (key) {
+        if (bodyLength_ < 2) {
+            return false;
+        }
+        bits = body_[offset++];
+        strips = body_[offset++];
+        if (bits < PREVIEW_MIN_BITS || bits > PREVIEW_MAX_BITS || strips > PREVIEW_MAX_STRIPS ||
+            offset + strips > bodyLength_) {
+            return false;
+        }
+        sampleCount = 0;
+        for (uint8_t s = 0; s < strips; s++) {
+            stripSamples[s] = body_[offset++];
+            if (stripSamples[s] > PREVIEW_MAX_SAMPLES_PER_STRIP) {
+                return false;
+            }
+            sampleCount += stripSamples[s];
+        }
+    }
+
+    // Check every part fits before taking any of it
+    if (offset + 2 > bodyLength_) {
+        return false;
+    }
+    uint16_t updates = body_[offset] | body_[offset + 1] << 8;
+    offset += 2;
+    size_t updatesAt = offset;
+    offset += (size_t)updates * 4;
+    if (updates > (1 << bits) || offset > bodyLength_) {
+        return false;
+    }
+    size_t changed = sampleCount;
+    size_t bitmapAt = offset;
+    if (!key) {
+        if (offset + bitBytes(sampleCount) > bodyLength_) {
+            return false;
+        }
+        changed = 0;
+        for (size_t i = 0; i < sampleCount; i++) {
+            changed += readBits(body_ + bitmapAt, i, 1);
+        }
+        offset += bitBytes(sampleCount);
+    }
+    if (offset + bitBytes(changed * bits) > bodyLength_) {
+        return false;
+    }
+
+    if (key) {
+        memset(palette_, 0, sizeof(palette_));
+    }
+    for (uint16_t u = 0; u < updates; u++) {
+        const uint8_t* update = body_ + updatesAt + u * 4;
+        palette_[update[0]] = CRGB(update[1], update[2], update[3]);
+    }
+    size_t bit = 0;
+    for (size_t i = 0; i < sampleCount; i++) {
+        if (key || readBits(body_ + bitmapAt, i, 1)) {
+            index_[i] = readBits(body_ + offset, bit, bits);
+            bit += bits;
+        }
+    }
+    bits_ = bits;
+    strips_ = strips;
+    memcpy(stripSamples_, stripSamples, sizeof(stripSamples_));
+    sampleCount_ = sampleCount;
+    return true;
+}
+
+BMPreviewGovernor::BMPreviewGovernor()
+    : mtu_(PREVIEW_DEFAULT_MTU), intervalUs_(PREVIEW_DEFAULT_INTERVAL_US), readyUs_(0), nextFrameUs_(0) {}
+
+void BMPreviewGovernor::setLink(uint16_t mtu, uint32_t intervalUs) {
+    mtu_ = mtu ? mtu : PREVIEW_DEFAULT_MTU;
+    intervalUs_ = intervalUs ? intervalUs : PREVIEW_DEFAULT_INTERVAL_US;
+}
+
+void BMPreviewGovernor::reset(uint32_t nowUs) {
+    readyUs_ = nowUs;
+    nextFrameUs_ = nowUs;
+}
+
+bool BMPreviewGovernor::due(uint32_t nowUs) const {
+    return reached(nowUs, readyUs_) && reached(nowUs, nextFrameUs_);
+}
+
+void BMPreviewGovernor::frameStarted(uint32_t nowUs) {
+    nextFrameUs_ = nowUs + 1000000UL / PREVIEW_MAX_FPS;
+}
+
+void BMPreviewGovernor::sent(size_t length, uint32_t nowUs) {
+    size_t packets = (ATT_NOTIFY_HEADER + L2CAP_HEADER + length + PREVIEW_LL_PAYLOAD - 1) / PREVIEW_LL_PAYLOAD;
+    owe((uint32_t)((uint64_t)packets * intervalUs_ / PREVIEW_PACKETS_PER_EVENT), nowUs);
+}
+
+void BMPreviewGovernor::statusSent(size_t length, uint32_t nowUs) {
+    size_t notified = mtu_ - ATT_NOTIFY_HEADER;
+    if (length <= notified) {
+        sent(length, nowUs);
+        return;
+    }
+    sent(notified, nowUs);
+    size_t blobs = (length - notified + mtu_ - ATT_READ_BLOB_HEADER - 1) / (mtu_ - ATT_READ_BLOB_HEADER);
+    owe((uint32_t)(blobs * 2 * intervalUs_), nowUs);
+}
+
+void BMPreviewGovernor::owe(uint32_t debtUs, uint32_t nowUs) {
+    if (reached(nowUs, readyUs_)) {
+        readyUs_ = nowUs;
+    }
+    readyUs_ += debtUs;
+}
+
+size_t BMPreviewGovernor::getMessageSize() const {
+    size_t size = mtu_ - ATT_NOTIFY_HEADER;
+    return size < PREVIEW_MAX_MESSAGE ? size : PREVIEW_MAX_MESSAGE;
+}
@@ -0,0 +1,229 @@
+#ifndef BM_PREVIEW_PROTOCOL_H
+#define BM_PREVIEW_PROTOCOL_H
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+// Live pixel preview (preview characteristic, opt-in; see BMDevice::enablePreview).
+//
+// What the strips show, downsampled: each strip is cut into up to
+// samples-per-strip spans and each span averaged into one sample, at the
+// brightness it was shown. Samples are colors from a palette of 2^bits slots
+// that the device fills as colors come up, and a frame only carries what
+// changed since the frame before it.
+//
+// Message:  magic 0xB8 | version | flags | frame u16 | fragment | body part
+// A frame's body is split over fragments 0, 1, ... of the same frame number,
+// each one notification; PREVIEW_FLAG_LAST marks the last one.
+//
+// flags: PREVIEW_FLAG_KEY  - forget the layout, palette and samples, and take
+//                            these; the body starts with the layout
+//        PREVIEW_FLAG_LAST - the last fragment of the frame
+//
+// Body:     [key: bits | strips | samples per strip, one byte each]
+//           palette updates u16 | (slot, r, g, b) per update
+//           key:   every sample's slot, bits each
+//           delta: a bit per sample, set if it changed; then the slot of
+//                  each changed sample, bits each
+// Bit fields are packed least significant bit first. A delta is against the
+// frame numbered one less and only applies on top of it. Notifications
+// arrive in order and none are lost within a connection, so the device only
+// sends a keyframe when the preview starts or its layout changes; an app
+// that loses track turns the preview on again.
+#define PREVIEW_MAGIC 0xB8
+#define PREVIEW_VERSION 1
+#define PREVIEW_HEADER_SIZE 6
+#define PREVIEW_FLAG_KEY 0x01
+#define PREVIEW_FLAG_LAST 0x02
+#define PREVIEW_MAX_STRIPS 8
+#define PREVIEW_MAX_SAMPLES_PER_STRIP 32
+#define PREVIEW_MAX_SAMPLES (PREVIEW_MAX_STRIPS * PREVIEW_MAX_SAMPLES_PER_STRIP)
+#define PREVIEW_MIN_BITS 4
+#define PREVIEW_MAX_BITS 8
+#define PREVIEW_DEFAULT_SAMPLES 16
+#define PREVIEW_DEFAULT_BITS 6
+#define PREVIEW_MAX_MESSAGE 244         // One 251-byte LL packet, less L2CAP and ATT headers
+#define PREVIEW_BUFFER_SIZE 1320        // The largest body: every slot updated, every sample changed
+
+// Governor (BMPreviewGovernor)
+#define PREVIEW_MAX_FPS 20
+#define PREVIEW_LL_PAYLOAD 27           // Without Data Length Extension, as every phone can
+#define PREVIEW_PACKETS_PER_EVENT 2     // Of the 4 or more a phone takes; the rest is for status
+#define PREVIEW_DEFAULT_MTU 23
+#define PREVIEW_DEFAULT_INTERVAL_US 30000
+
+struct PreviewEncoderStats {
+    uint32_t frames;
+    uint32_t keyframes;
+    uint32_t fragments;
+    uint32_t bytes;             // Including headers
+    uint32_t keyframeBytes;     // Of those
+    uint32_t samples;
+    uint32_t changedSamples;    // Sent in deltas
+    uint32_t paletteUpdates;
+};
+
+// Device side. Quantization keeps a sample on its slot while the slot's color
+// is within the tolerance for the bit depth, so slow fades don't churn; a
+// color no slot is close to takes a slot no sample uses this frame, or the
+// nearest slot once all are taken. Black only ever matches black.
+class BMPreviewEncoder {
+public:
+    BMPreviewEncoder();
+
+    // samplesPerStrip 1..PREVIEW_MAX_SAMPLES_PER_STRIP, bits
+    // PREVIEW_MIN_BITS..PREVIEW_MAX_BITS; the next frame is a keyframe
+    void configure(uint8_t samplesPerStrip, uint8_t bits);
+    // The app has nothing (new connection, preview turned on again)
+    void reset();
+
+    // Describe what the strips show: beginFrame(), then every strip in order
+    void beginFrame();
+    void addStrip(const CRGB* leds, uint16_t count, uint8_t brightness);
+    void addSolidStrip(const CRGB& color, uint16_t count, uint8_t brightness);
+
+    // Quantizes and codes the frame; false when the app already shows it.
+    // Then nextFragment() until it returns 0.
+    bool prepare();
+    size_t nextFragment(uint8_t* out, size_t capacity);
+
+    uint8_t getSamplesPerStrip() const { return samplesPerStrip_; }
+    uint8_t getBits() const { return bits_; }
+    uint16_t getFrame() const { return frame_; }
+    // Fragments of the last prepared frame are left
+    bool isSending() const { return sending_; }
+    // The frame as sampled, before quantization
+    size_t getSampleCount() const { return sampleCount_; }
+    CRGB getSample(size_t index) const { return samples_[index]; }
+    const PreviewEncoderStats& getStats() const { return stats_; }
+
+private:
+    static uint16_t distance(const CRGB& a, const CRGB& b);
+    // The nearest known slot within tolerance (any distance if tolerance is
+    // 0xFFFF); -1 if none
+    int nearest(const CRGB& color, uint16_t tolerance) const;
+    int freeSlot();
+    void encodeBody(bool key);
+
+    uint8_t samplesPerStrip_;
+    uint8_t bits_;
+    uint16_t tolerance_;
+
+    // The frame being described
+    uint8_t strips_;
+    uint8_t stripSamples_[PREVIEW_MAX_STRIPS];
+    CRGB samples_[PREVIEW_MAX_SAMPLES];
+    size_t sampleCount_;
+
+    // What the app has
+    bool key_;
+    uint8_t sentStrips_;
+    uint8_t sentStripSamples_[PREVIEW_MAX_STRIPS];
+    CRGB palette_[1 << PREVIEW_MAX_BITS];
+    bool known_[1 << PREVIEW_MAX_BITS];
+    size_t slotsKnown_;         // Slots below this may be known
+    uint8_t index_[PREVIEW_MAX_SAMPLES];
+
+    // This frame
+    uint8_t next_[PREVIEW_MAX_SAMPLES];
+    bool used_[1 << PREVIEW_MAX_BITS];
+    bool updated_[1 << PREVIEW_MAX_BITS];
+    size_t freeCursor_;
+
+    uint8_t body_[PREVIEW_BUFFER_SIZE];
+    size_t bodyLength_;
+    size_t cursor_;
+    uint16_t frame_;
+    uint8_t fragment_;
+    bool sending_;
+    bool sendingKey_;
+
+    PreviewEncoderStats stats_;
+};
+
+// App side, and tests: rebuilds the samples from notifications
+class BMPreviewDecoder {
+public:
+    BMPreviewDecoder();
+
+    // One notification; true when it completed a frame
+    bool handleMessage(const uint8_t* data, size_t length);
+    void reset();
+
+    bool hasFrame() const { return hasFrame_; }
+    uint16_t getFrame() const { return frame_; }
+    uint8_t getBits() const { return bits_; }
+    uint8_t getStripCount() const { return strips_; }
+    uint8_t getStripSamples(uint8_t strip) const { return strip < strips_ ? stripSamples_[strip] : 0; }
+    size_t getSampleCount() const { return sampleCount_; }
+    CRGB getSample(size_t index) const { return palette_[index_[index]]; }
+    // Messages that weren't the preview, were out of order, or whose frame
+    // didn't follow the one shown
+    uint32_t getRejected() const { return rejected_; }
+
+private:
+    bool apply(bool key);
+
+    bool hasFrame_;
+    uint16_t frame_;
+    uint8_t bits_;
+    uint8_t strips_;
+    uint8_t stripSamples_[PREVIEW_MAX_STRIPS];
+    size_t sampleCount_;
+    CRGB palette_[1 << PREVIEW_MAX_BITS];
+    uint8_t index_[PREVIEW_MAX_SAMPLES];
+
+    // Reassembly
+    bool assembling_;
+    uint16_t assemblingFrame_;
+    uint8_t assemblingFlags_;
+    uint8_t nextFragment_;
+    uint8_t body_[PREVIEW_BUFFER_SIZE];
+    size_t bodyLength_;
+
+    uint32_t rejected_;
+};
+
+// Paces preview frames to what the link carries, so the preview never queues
+// up behind itself or crowds out status notifications. A notification costs
+// its value plus ATT and L2CAP headers in PREVIEW_LL_PAYLOAD-byte LL packets;
+// the preview gets PREVIEW_PACKETS_PER_EVENT of them per connection event, and
+// status notifications count against the same budget.
+// What a frame costs beyond that is a debt: its fragments wait until no more
+// than one connection event's worth is queued, and the next frame until the
+// debt is paid. Frames are at most PREVIEW_MAX_FPS.
+class BMPreviewGovernor {
+public:
+    BMPreviewGovernor();
+
+    // As the app reports them; 0 keeps the default
+    void setLink(uint16_t mtu, uint32_t intervalUs);
+    void reset(uint32_t nowUs);
+
+    // A new frame may start
+    bool due(uint32_t nowUs) const;
+    // Another notification may go out
+    bool ready(uint32_t nowUs) const { return reached(nowUs + intervalUs_, readyUs_); }
+    void frameStarted(uint32_t nowUs);
+    void sent(size_t length, uint32_t nowUs);
+    // A status notification went out; the preview waits for it, and for the
+    // Read Blob round trips (two events each) the app needs for what doesn't
+    // fit in the MTU
+    void statusSent(size_t length, uint32_t nowUs);
+
+    // The most a notification can carry
+    size_t getMessageSize() const;
+    uint16_t getMtu() const { return mtu_; }
+    uint32_t getIntervalUs() const { return intervalUs_; }
+
+private:
+    static bool reached(uint32_t nowUs, uint32_t atUs) { return (int32_t)(nowUs - atUs) >= 0; }
+    void owe(uint32_t debtUs, uint32_t nowUs);
+
+    uint16_t mtu_;
+    uint32_t intervalUs_;
+    uint32_t readyUs_;          // When the debt is paid
+    uint32_t nextFrameUs_;      // PREVIEW_MAX_FPS
+};
+
+#endif // BM_PREVIEW_PROTOCOL_H
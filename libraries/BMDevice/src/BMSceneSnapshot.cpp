@@ -0,0 +1,83 @@
+#include "BMSceneSnapshot.h"
+#include "BMSettingsRecord.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <esp_attr.h>
+#define SCENE_SNAPSHOT_STORAGE RTC_NOINIT_ATTR
+#else
+#define SCENE_SNAPSHOT_STORAGE
+#endif
+
+namespace {
+
+struct __attribute__((packed)) SceneRecord {
+    uint8_t magic;
+    uint8_t version;
+    uint8_t power;
+    uint8_t reverse;
+    uint8_t palette;
+    uint8_t effect;
+    uint8_t brightness;
+    uint16_t speed;
+    int16_t effectParameters[STATE_EFFECT_PARAMETER_COUNT];
+    uint8_t effectColor[3];
+    uint32_t crc;
+};
+
+// Not initialized: whatever the last run left, or noise after power-on
+SCENE_SNAPSHOT_STORAGE SceneRecord snapshot;
+
+uint32_t recordCrc(const SceneRecord& record) {
+    return settingsCrc32((const uint8_t*)&record, offsetof(SceneRecord, crc));
+}
+
+}
+
+void BMSceneSnapshot::save(const BMDeviceState& state) {
+    SceneRecord record;
+    record.magic = SCENE_SNAPSHOT_MAGIC;
+    record.version = SCENE_SNAPSHOT_VERSION;
+    record.power = state.power;
+    record.reverse = state.reverseStrip;
+    record.palette = (uint8_t)state.currentPalette;
+    record.effect = (uint8_t)state.currentEffect;
+    record.brightness = (uint8_t)constrain(state.brightness, 1, 255);
+    record.speed = state.speed;
+    for (uint8_t i = 0; i < STATE_EFFECT_PARAMETER_COUNT; i++) {
+        record.effectParameters[i] = (int16_t)constrain(state.getEffectParameter(i), -32768, 32767);
+    }
+    record.effectColor[0] = state.effectColor.r;
+    record.effectColor[1] = state.effectColor.g;
+    record.effectColor[2] = state.effectColor.b;
+    record.crc = recordCrc(record);
+    snapshot = record;
+}
+
+bool BMSceneSnapshot::restore(BMDeviceState& state) {
+    if (!isValid()) {
+        return false;
+    }
+    const SceneRecord record = snapshot;
+    state.setPower(record.power);
+    state.setBrightness(record.brightness);
+    state.setSpeed(record.speed);
+    state.setReverseStrip(record.reverse);
+    state.setPalette((AvailablePalettes)record.palette);
+    state.setEffect((LightSceneID)record.effect);
+    for (uint8_t i = 0; i < STATE_EFFECT_PARAMETER_COUNT; i++) {
+        state.setEffectParameter(i, record.effectParameters[i]);
+    }
+    state.setEffectColor(CRGB(record.effectColor[0], record.effectColor[1], record.effectColor[2]));
+    return true;
+}
+
+void BMSceneSnapshot::clear() {
+    memset(&snapshot, 0, sizeof(snapshot));
+}
+
+bool BMSceneSnapshot::isValid() {
+    // A CRC that happens to match noise still has to name a real scene
+    return snapshot.magic == SCENE_SNAPSHOT_MAGIC && snapshot.version == SCENE_SNAPSHOT_VERSION &&
+           snapshot.crc == recordCrc(snapshot) && snapshot.effect <= (uint8_t)LightSceneID::spiral_galaxy &&
+           snapshot.palette <= (uint8_t)AvailablePalettes::moltenmetal && snapshot.brightness > 0;
+}
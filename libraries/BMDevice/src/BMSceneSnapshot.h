@@ -0,0 +1,34 @@
+#ifndef BM_SCENE_SNAPSHOT_H
+#define BM_SCENE_SNAPSHOT_H
+
+#include <Arduino.h>
+#include "BMDeviceState.h"
+
+// The scene as last shown, kept in memory a reset doesn't clear: RTC slow
+// memory on the ESP32, which survives brownout, watchdog and software resets
+// but not power loss. BMDevice saves it on every change and restores it at
+// boot right after the settings, so a prop that browns out lights up with
+// what it showed before anything else starts. A cold boot finds no valid
+// snapshot and starts from the defaults.
+//
+//   magic 0xBE | version | power | direction | palette | effect | brightness
+//   | speed u16 | effect parameters 14x i16 | effect color rgb | CRC-32
+#define SCENE_SNAPSHOT_MAGIC 0xBE
+#define SCENE_SNAPSHOT_VERSION 1
+
+// The state the snapshot follows
+#define SCENE_SNAPSHOT_FIELDS (STATE_POWER | STATE_BRIGHTNESS | STATE_SPEED | STATE_DIRECTION | STATE_PALETTE | \
+                               STATE_EFFECT | STATE_EFFECT_PARAMETERS | STATE_EFFECT_COLOR)
+
+class BMSceneSnapshot {
+public:
+    static void save(const BMDeviceState& state);
+    // Into state through its setters; false, with state untouched, when there
+    // is no valid snapshot
+    static bool restore(BMDeviceState& state);
+    // Forgets it, as power loss does
+    static void clear();
+    static bool isValid();
+};
+
+#endif // BM_SCENE_SNAPSHOT_H
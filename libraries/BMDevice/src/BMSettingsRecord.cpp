@@ -0,0 +1,177 @@
+#include "BMSettingsRecord.h"
+#include <BMLog.h>
+
+namespace {
+
+void storeU16(uint8_t* out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+void storeU32(uint8_t* out, uint32_t value) {
+    storeU16(out, value & 0xFFFF);
+    storeU16(out + 2, value >> 16);
+}
+
+uint16_t loadU16(const uint8_t* data) {
+    return data[0] | (data[1] << 8);
+}
+
+uint32_t loadU32(const uint8_t* data) {
+    return loadU16(data) | ((uint32_t)loadU16(data + 2) << 16);
+}
+
+}
+
+// CRC-32 (zlib's), continuing from crc
+uint32_t settingsCrc32(const uint8_t* data, size_t length, uint32_t crc) {
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+BMSettingsRecord::BMSettingsRecord(Preferences& preferences, const char* name, uint8_t version)
+    : preferences_(preferences), version_(version), loadedVersion_(0), sequence_(0), nextSlot_(0) {
+    strncpy(name_, name, SETTINGS_RECORD_NAME);
+    name_[SETTINGS_RECORD_NAME] = '\0';
+}
+
+bool BMSettingsRecord::addMigration(uint8_t from, Migration upgrade, Migration downgrade) {
+    if (from >= version_ || findStep(from) || !upgrade) {
+        BMLOG_WARN("BMSettingsRecord", "%s: can't add a migration from version %d", name_, from);
+        return false;
+    }
+    steps_.push_back({from, upgrade, downgrade});
+    return true;
+}
+
+bool BMSettingsRecord::load(std::vector<uint8_t>& payload, Validator validator) {
+    uint8_t record[SETTINGS_RECORD_MAX];
+    bool found = false;
+    uint32_t loadedSequence = 0;
+    uint32_t newestSequence = 0;
+    uint8_t newestSlot = 0;
+    for (uint8_t slot = 0; slot < 2; slot++) {
+        char slotKey[SETTINGS_RECORD_NAME + 2];
+        key(slot, slotKey);
+        size_t length = preferences_.getBytes(slotKey, record, sizeof(record));
+        if (length == 0) {
+            continue;
+        }
+        if (length < SETTINGS_RECORD_HEADER || record[0] != SETTINGS_RECORD_MAGIC ||
+            loadU16(record + 2) != length - SETTINGS_RECORD_HEADER ||
+            loadU32(record + 8) != settingsCrc32(record + SETTINGS_RECORD_HEADER, length - SETTINGS_RECORD_HEADER,
+                                                settingsCrc32(record, 8))) {
+            BMLOG_WARN("BMSettingsRecord", "Ignoring damaged record %s", slotKey);
+            continue;
+        }
+        // Commits continue past every intact record, even one this firmware can't read
+        uint32_t sequence = loadU32(record + 4);
+        if (sequence > newestSequence) {
+            newestSequence = sequence;
+            newestSlot = slot;
+        }
+        if (found && sequence <= loadedSequence) {
+            continue;
+        }
+
+        std::vector<uint8_t> candidate(record + SETTINGS_RECORD_HEADER, record + length);
+        if (!migrate(candidate, record[1], version_)) {
+            BMLOG_WARN("BMSettingsRecord", "%s: no way from version %d to %d", slotKey, record[1], version_);
+            continue;
+        }
+        if (validator && !validator(candidate)) {
+            BMLOG_WARN("BMSettingsRecord", "%s: version %d doesn't decode", slotKey, record[1]);
+            continue;
+        }
+        payload.swap(candidate);
+        loadedVersion_ = record[1];
+        loadedSequence = sequence;
+        // The other key is older, damaged or unreadable: the next commit replaces it
+        nextSlot_ = slot ^ 1;
+        found = true;
+    }
+    if (!found && newestSequence > 0) {
+        // Nothing readable: keep the newest record for the firmware that wrote it
+        nextSlot_ = newestSlot ^ 1;
+    }
+    sequence_ = max(sequence_, newestSequence);
+    return found;
+}
+
+bool BMSettingsRecord::commit(const std::vector<uint8_t>& payload) {
+    return write(version_, payload);
+}
+
+bool BMSettingsRecord::commitAs(uint8_t version, const std::vector<uint8_t>& payload) {
+    std::vector<uint8_t> migrated = payload;
+    if (!migrate(migrated, version_, version)) {
+        BMLOG_WARN("BMSettingsRecord", "%s: no way from version %d to %d", name_, version_, version);
+        return false;
+    }
+    return write(version, migrated);
+}
+
+void BMSettingsRecord::reset() {
+    sequence_ = 0;
+    nextSlot_ = 0;
+}
+
+bool BMSettingsRecord::migrate(std::vector<uint8_t>& payload, uint8_t from, uint8_t to) const {
+    while (from < to) {
+        const Step* step = findStep(from);
+        if (!step || !step->upgrade(payload)) {
+            return false;
+        }
+        from++;
+    }
+    while (from > to) {
+        const Step* step = findStep(from - 1);
+        if (!step || !step->downgrade || !step->downgrade(payload)) {
+            return false;
+        }
+        from--;
+    }
+    return true;
+}
+
+const BMSettingsRecord::Step* BMSettingsRecord::findStep(uint8_t from) const {
+    for (const Step& step : steps_) {
+        if (step.from == from) {
+            return &step;
+        }
+    }
+    return nullptr;
+}
+
+bool BMSettingsRecord::write(uint8_t version, const std::vector<uint8_t>& payload) {
+    if (payload.size() > SETTINGS_RECORD_MAX - SETTINGS_RECORD_HEADER) {
+        return false;
+    }
+    uint8_t record[SETTINGS_RECORD_MAX];
+    size_t length = SETTINGS_RECORD_HEADER + payload.size();
+    record[0] = SETTINGS_RECORD_MAGIC;
+    record[1] = version;
+    storeU16(record + 2, (uint16_t)payload.size());
+    storeU32(record + 4, sequence_ + 1);
+    memcpy(record + SETTINGS_RECORD_HEADER, payload.data(), payload.size());
+    storeU32(record + 8, settingsCrc32(record + SETTINGS_RECORD_HEADER, payload.size(), settingsCrc32(record, 8)));
+
+    char slotKey[SETTINGS_RECORD_NAME + 2];
+    key(nextSlot_, slotKey);
+    if (preferences_.putBytes(slotKey, record, length) != length) {
+        return false;
+    }
+    sequence_++;
+    nextSlot_ ^= 1;
+    return true;
+}
+
+void BMSettingsRecord::key(uint8_t slot, char* out) const {
+    snprintf(out, SETTINGS_RECORD_NAME + 2, "%s%c", name_, (char)('0' + slot));
+}
@@ -0,0 +1,76 @@
+#ifndef BM_SETTINGS_RECORD_H
+#define BM_SETTINGS_RECORD_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <functional>
+#include <vector>
+
+// One subsystem's settings as a single versioned record in NVS, read with one
+// getBytes() per key. Commits alternate between two keys (name + "0", name +
+// "1"), each holding:
+//   magic 0xBD | schema version | length (2) | sequence (4) | CRC-32 (4) | payload
+// The CRC covers the first eight header bytes and the payload. load() takes
+// the valid record with the highest sequence, so a commit cut short by power
+// loss leaves the one before it in place.
+//
+// The payload layout belongs to the subsystem. When it changes, bump the
+// version and add a migration between the old version and the new one:
+// upgrade() turns an old payload into the new layout when an older firmware's
+// record is loaded, and downgrade() does the reverse for commitAs(), ahead of
+// going back to a firmware that only knows the older layout.
+#define SETTINGS_RECORD_MAGIC 0xBD
+#define SETTINGS_RECORD_HEADER 12
+#define SETTINGS_RECORD_MAX 512
+#define SETTINGS_RECORD_NAME 14           // NVS keys are at most 15 characters
+
+class BMSettingsRecord {
+public:
+    // Rewrites a payload to the next version up or down; false if it can't
+    typedef std::function<bool(std::vector<uint8_t>& payload)> Migration;
+    // Whether a payload, already migrated to the current version, decodes
+    typedef std::function<bool(const std::vector<uint8_t>& payload)> Validator;
+
+    BMSettingsRecord(Preferences& preferences, const char* name, uint8_t version);
+
+    // Between `from` and `from + 1`
+    bool addMigration(uint8_t from, Migration upgrade, Migration downgrade);
+
+    // The newest record, migrated to the current version, that the validator
+    // accepts. False if there is none.
+    bool load(std::vector<uint8_t>& payload, Validator validator = nullptr);
+    // Writes the payload over the older of the two records
+    bool commit(const std::vector<uint8_t>& payload);
+    // Migrates the payload down to an older version first
+    bool commitAs(uint8_t version, const std::vector<uint8_t>& payload);
+    // Forgets both records, after the namespace is cleared
+    void reset();
+
+    uint8_t getVersion() const { return version_; }
+    uint8_t getLoadedVersion() const { return loadedVersion_; }   // As stored, before migrating
+    uint32_t getSequence() const { return sequence_; }
+
+private:
+    struct Step {
+        uint8_t from;
+        Migration upgrade;
+        Migration downgrade;
+    };
+
+    bool migrate(std::vector<uint8_t>& payload, uint8_t from, uint8_t to) const;
+    const Step* findStep(uint8_t from) const;
+    bool write(uint8_t version, const std::vector<uint8_t>& payload);
+    void key(uint8_t slot, char* out) const;
+
+    Preferences& preferences_;
+    char name_[SETTINGS_RECORD_NAME + 1];
+    uint8_t version_;
+    std::vector<Step> steps_;
+    uint8_t loadedVersion_;
+    uint32_t sequence_;               // Of the newest record in storage
+    uint8_t nextSlot_;                // Key the next commit overwrites
+};
+
+uint32_t settingsCrc32(const uint8_t* data, size_t length, uint32_t crc = 0);
+
+#endif // BM_SETTINGS_RECORD_H
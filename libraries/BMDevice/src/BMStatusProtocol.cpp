@@ -0,0 +1,174 @@
+#include "BMStatusProtocol.h"
+#include <BMLog.h>
+
+BMStatusEncoder::BMStatusEncoder() : snapshotLength_(0), seq_(0), ackedSeq_(0), cursor_(0), fragment_(0), full_(false) {
+    memset(snapshot_, 0, sizeof(snapshot_));
+    memset(pending_, 0, sizeof(pending_));
+    memset(&stats_, 0, sizeof(stats_));
+    reset();
+}
+
+void BMStatusEncoder::reset() {
+    memset(ackedHash_, 0, sizeof(ackedHash_));
+    memset(sentHash_, 0, sizeof(sentHash_));
+    memset(sentSeq_, 0, sizeof(sentSeq_));
+    ackedSeq_ = 0;
+}
+
+void BMStatusEncoder::beginSnapshot() {
+    snapshotLength_ = 0;
+}
+
+void BMStatusEncoder::addU8(uint8_t tag, uint8_t value) {
+    addField(tag, &value, 1);
+}
+
+void BMStatusEncoder::addU16(uint8_t tag, uint16_t value) {
+    uint8_t bytes[2] = {(uint8_t)value, (uint8_t)(value >> 8)};
+    addField(tag, bytes, sizeof(bytes));
+}
+
+void BMStatusEncoder::addU32(uint8_t tag, uint32_t value) {
+    uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+    addField(tag, bytes, sizeof(bytes));
+}
+
+void BMStatusEncoder::addString(uint8_t tag, const char* value) {
+    size_t length = strlen(value);
+    addField(tag, (const uint8_t*)value, length < STATUS_MAX_FIELD ? length : STATUS_MAX_FIELD);
+}
+
+void BMStatusEncoder::addField(uint8_t tag, const uint8_t* value, size_t length) {
+    if (tag == 0 || tag >= STATUS_MAX_TAG || length > STATUS_MAX_FIELD ||
+        snapshotLength_ + 2 + length > sizeof(snapshot_)) {
+        BMLOG_WARN("BMStatusEncoder", "Dropped field 0x%02X (%u bytes)", tag, (unsigned)length);
+        return;
+    }
+    snapshot_[snapshotLength_++] = tag;
+    snapshot_[snapshotLength_++] = (uint8_t)length;
+    memcpy(snapshot_ + snapshotLength_, value, length);
+    snapshotLength_ += length;
+}
+
+uint32_t BMStatusEncoder::hash(const uint8_t* data, size_t length) {
+    // FNV-1a over the length and value; 0 is kept for "unknown"
+    uint32_t h = 2166136261u;
+    h = (h ^ (uint8_t)length) * 16777619u;
+    for (size_t i = 0; i < length; i++) {
+        h = (h ^ data[i]) * 16777619u;
+    }
+    return h ? h : 1;
+}
+
+bool BMStatusEncoder::prepare() {
+    uint16_t seq = (uint16_t)(seq_ + 1);
+    if (seq == 0) {
+        seq = 1;
+    }
+    size_t fields = 0;
+    for (size_t offset = 0; offset < snapshotLength_; offset += 2 + snapshot_[offset + 1]) {
+        uint8_t tag = snapshot_[offset];
+        uint32_t h = hash(snapshot_ + offset + 2, snapshot_[offset + 1]);
+        // Changed since the app's last acknowledged state, or still in flight
+        bool unacked = sentSeq_[tag] != 0 && (ackedSeq_ == 0 || after(sentSeq_[tag], ackedSeq_));
+        pending_[tag] = h != ackedHash_[tag] || unacked;
+        if (pending_[tag]) {
+            sentSeq_[tag] = seq;
+            sentHash_[tag] = h;
+            fields++;
+        }
+    }
+    if (fields == 0) {
+        return false;
+    }
+
+    seq_ = seq;
+    full_ = ackedSeq_ == 0;
+    cursor_ = 0;
+    fragment_ = 0;
+    stats_.messages++;
+    stats_.fields += fields;
+    if (full_) {
+        stats_.fullSnapshots++;
+    }
+    return true;
+}
+
+size_t BMStatusEncoder::nextFragment(uint8_t* out, size_t capacity) {
+    if (capacity > STATUS_MAX_MESSAGE) {
+        capacity = STATUS_MAX_MESSAGE;
+    }
+    size_t length = STATUS_HEADER_SIZE;
+    bool more = false;
+    while (cursor_ < snapshotLength_) {
+        uint8_t tag = snapshot_[cursor_];
+        size_t fieldLength = 2 + snapshot_[cursor_ + 1];
+        if (pending_[tag]) {
+            if (length + fieldLength > capacity) {
+                more = true;
+                break;
+            }
+            memcpy(out + length, snapshot_ + cursor_, fieldLength);
+            length += fieldLength;
+            pending_[tag] = false;
+        }
+        cursor_ += fieldLength;
+    }
+    if (length == STATUS_HEADER_SIZE) {
+        return 0;
+    }
+
+    out[0] = STATUS_MAGIC;
+    out[1] = STATUS_VERSION;
+    out[2] = (full_ ? STATUS_FLAG_FULL : 0) | (more ? 0 : STATUS_FLAG_LAST);
+    out[3] = (uint8_t)seq_;
+    out[4] = (uint8_t)(seq_ >> 8);
+    out[5] = (uint8_t)ackedSeq_;
+    out[6] = (uint8_t)(ackedSeq_ >> 8);
+    out[7] = fragment_++;
+    stats_.fragments++;
+    stats_.bytes += length;
+    return length;
+}
+
+bool BMStatusEncoder::acknowledge(uint16_t seq) {
+    bool sent = seq != 0 && seq_ != 0 && !after(seq, seq_);
+    if (!sent || (ackedSeq_ != 0 && !after(seq, ackedSeq_))) {
+        stats_.staleAcks++;
+        return false;
+    }
+    for (uint8_t tag = 0; tag < STATUS_MAX_TAG; tag++) {
+        if (sentSeq_[tag] != 0 && !after(sentSeq_[tag], seq)) {
+            ackedHash_[tag] = sentHash_[tag];
+        }
+    }
+    ackedSeq_ = seq;
+    stats_.acks++;
+    return true;
+}
+
+bool parseStatusMessage(const uint8_t* data, size_t length, StatusMessageHeader& header,
+                        std::function<void(uint8_t tag, const uint8_t* value, size_t length)> onField) {
+    if (length < STATUS_HEADER_SIZE || data[0] != STATUS_MAGIC || data[1] != STATUS_VERSION) {
+        return false;
+    }
+    // Check every field fits before handing any out
+    size_t offset = STATUS_HEADER_SIZE;
+    while (offset < length) {
+        if (offset + 2 > length || offset + 2 + data[offset + 1] > length) {
+            return false;
+        }
+        offset += 2 + data[offset + 1];
+    }
+
+    header.flags = data[2];
+    header.seq = data[3] | data[4] << 8;
+    header.base = data[5] | data[6] << 8;
+    header.fragment = data[7];
+    for (offset = STATUS_HEADER_SIZE; offset < length; offset += 2 + data[offset + 1]) {
+        if (onField) {
+            onField(data[offset], data + offset + 2, data[offset + 1]);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,168 @@
+#ifndef BM_STATUS_PROTOCOL_H
+#define BM_STATUS_PROTOCOL_H
+
+#include <Arduino.h>
+#include <functional>
+
+// Binary status notifications (status characteristic, default format).
+//
+// Message:  magic 0xB7 | version | flags | seq u16 | base u16 | fragment | fields...
+// Field:    tag | length | value (little-endian), so unknown tags can be skipped
+//
+// flags: STATUS_FLAG_FULL - base is 0: forget everything and take these fields
+//        STATUS_FLAG_LAST - the last fragment of seq
+//
+// A message carries every field whose value differs from what the app last
+// acknowledged (BLE_FEATURE_STATUS_ACK with the seq), plus any sent since and
+// not yet acknowledged, so applying it to whatever the app holds always ends
+// in the current state. An app that never acknowledges gets full snapshots.
+// Messages larger than one notification go out as several fragments with
+// the same seq; the app acknowledges once it has the LAST one and all before.
+// A notification is as large as the negotiated MTU allows, up to
+// STATUS_MAX_MESSAGE; a link too small for the largest field gets
+// STATUS_DEFAULT_MESSAGE and the app reads the rest.
+//
+// Field dictionary (see BMDevice::fillStatusFields):
+//   0x01 power u8              0x10 device type str       0x20-0x2D effect
+//   0x02 brightness u8 (%)     0x11 auto on u8                 parameters u16, in
+//   0x03 speed u16             0x12 status interval u32        BLE feature order
+//   0x04 direction u8          0x13 owner str                  (0x0B-0x18)
+//   0x05 effect u8 (ID)        0x14 device name str       0x2E effect color rgb
+//   0x06 palette u8 (ID)       0x15 firmware str          0x30 default brightness u8
+//   0x07 GPS enabled u8        0x16 LED strips, 6 bytes   0x31 default speed u16
+//   0x08 position valid u8          each: index, pin,     0x32 default palette u8
+//   0x09 GPS speed u16              leds u16, order,      0x33 default effect u8
+//        (0.01 km/h)                enabled               0x34 default direction u8
+//   0x0A position 2x i32 (1e-6 deg)                       0x35 default color rgb
+//   0x0B max brightness u8 (%) 0x17 free heap u32         0x36 defaults version u8
+//                              0x18 min free heap u32
+//                              0x19 largest free block u32
+//                              0x1A boot stages, u16 ms
+//                                   each (BootStage order)
+//                              0x1B scene restored u8
+// The heap fields are in bytes, rounded down to STATUS_HEAP_GRANULARITY so
+// that allocator noise doesn't put them in every delta. A boot stage not
+// reached yet reads BOOT_STAGE_PENDING, one that failed BOOT_STAGE_FAILED.
+#define STATUS_MAGIC 0xB7
+#define STATUS_VERSION 1
+#define STATUS_HEADER_SIZE 8
+#define STATUS_FLAG_FULL 0x01
+#define STATUS_FLAG_LAST 0x02
+#define STATUS_MAX_MESSAGE 244      // One 251-byte LL packet, less L2CAP and ATT headers
+#define STATUS_DEFAULT_MESSAGE 180  // Fits one notification at iOS's 185-byte ATT MTU
+#define STATUS_MAX_FIELD 64
+#define STATUS_MIN_MESSAGE (STATUS_HEADER_SIZE + 2 + STATUS_MAX_FIELD)
+#define STATUS_MAX_TAG 0x40
+#define STATUS_BUFFER_SIZE 512      // Every field of one snapshot
+#define STATUS_HEAP_GRANULARITY 512
+
+enum StatusField : uint8_t {
+    STATUS_POWER = 0x01,
+    STATUS_BRIGHTNESS = 0x02,
+    STATUS_SPEED = 0x03,
+    STATUS_DIRECTION = 0x04,
+    STATUS_EFFECT = 0x05,
+    STATUS_PALETTE = 0x06,
+    STATUS_GPS_ENABLED = 0x07,
+    STATUS_POSITION_AVAILABLE = 0x08,
+    STATUS_GPS_SPEED = 0x09,
+    STATUS_POSITION = 0x0A,
+    STATUS_MAX_BRIGHTNESS = 0x0B,
+
+    STATUS_DEVICE_TYPE = 0x10,
+    STATUS_AUTO_ON = 0x11,
+    STATUS_INTERVAL = 0x12,
+    STATUS_OWNER = 0x13,
+    STATUS_DEVICE_NAME = 0x14,
+    STATUS_FIRMWARE = 0x15,
+    STATUS_LED_STRIPS = 0x16,
+    STATUS_FREE_HEAP = 0x17,
+    STATUS_MIN_FREE_HEAP = 0x18,
+    STATUS_LARGEST_FREE_BLOCK = 0x19,
+    STATUS_BOOT_PROFILE = 0x1A,
+    STATUS_SCENE_RESTORED = 0x1B,
+
+    STATUS_EFFECT_PARAMETERS = 0x20, // + (BLE feature - BLE_FEATURE_WAVE_WIDTH)
+    STATUS_EFFECT_COLOR = 0x2E,
+
+    STATUS_DEFAULT_BRIGHTNESS = 0x30,
+    STATUS_DEFAULT_SPEED = 0x31,
+    STATUS_DEFAULT_PALETTE = 0x32,
+    STATUS_DEFAULT_EFFECT = 0x33,
+    STATUS_DEFAULT_DIRECTION = 0x34,
+    STATUS_DEFAULT_COLOR = 0x35,
+    STATUS_DEFAULTS_VERSION = 0x36
+};
+
+struct StatusEncoderStats {
+    uint32_t messages;
+    uint32_t fragments;
+    uint32_t bytes;
+    uint32_t fields;
+    uint32_t fullSnapshots;
+    uint32_t acks;
+    uint32_t staleAcks;     // Older than one already applied, or never sent
+};
+
+class BMStatusEncoder {
+public:
+    BMStatusEncoder();
+
+    // Forget what the app has (new connection); the next message is full
+    void reset();
+
+    // Describe the current state: beginSnapshot(), then every field once
+    void beginSnapshot();
+    void addU8(uint8_t tag, uint8_t value);
+    void addU16(uint8_t tag, uint16_t value);
+    void addU32(uint8_t tag, uint32_t value);
+    void addString(uint8_t tag, const char* value);
+    void addField(uint8_t tag, const uint8_t* value, size_t length);
+
+    // Picks the fields to send under a new seq; false when there are none.
+    // Then nextFragment() until it returns 0.
+    bool prepare();
+    size_t nextFragment(uint8_t* out, size_t capacity);
+
+    bool acknowledge(uint16_t seq);
+
+    uint16_t getSeq() const { return seq_; }
+    uint16_t getAckedSeq() const { return ackedSeq_; }
+    const StatusEncoderStats& getStats() const { return stats_; }
+
+private:
+    static uint32_t hash(const uint8_t* data, size_t length);
+    static bool after(uint16_t a, uint16_t b) { return (int16_t)(a - b) > 0; }
+
+    // The snapshot, as tag/length/value
+    uint8_t snapshot_[STATUS_BUFFER_SIZE];
+    size_t snapshotLength_;
+
+    // Per tag; a hash of 0 means unknown
+    uint32_t ackedHash_[STATUS_MAX_TAG];
+    uint32_t sentHash_[STATUS_MAX_TAG];
+    uint16_t sentSeq_[STATUS_MAX_TAG];
+
+    uint16_t seq_;
+    uint16_t ackedSeq_;     // 0: the app has nothing we know of
+    bool pending_[STATUS_MAX_TAG];
+    size_t cursor_;         // Into snapshot_, while fragmenting
+    uint8_t fragment_;
+    bool full_;
+
+    StatusEncoderStats stats_;
+};
+
+// For the app side and tests: walks one message. Returns false if it is not
+// a well-formed status message.
+struct StatusMessageHeader {
+    uint8_t flags;
+    uint16_t seq;
+    uint16_t base;
+    uint8_t fragment;
+};
+
+bool parseStatusMessage(const uint8_t* data, size_t length, StatusMessageHeader& header,
+                        std::function<void(uint8_t tag, const uint8_t* value, size_t length)> onField);
+
+#endif // BM_STATUS_PROTOCOL_H
@@ -0,0 +1,238 @@
+#include "BMTransferProtocol.h"
+
+namespace {
+
+bool after(uint16_t a, uint16_t b) { return (int16_t)(a - b) > 0; }
+
+size_t writeHeader(uint8_t* out, uint8_t flags, uint8_t transfer, uint16_t fragment) {
+    out[0] = TRANSFER_MAGIC;
+    out[1] = TRANSFER_VERSION;
+    out[2] = flags;
+    out[3] = transfer;
+    out[4] = (uint8_t)fragment;
+    out[5] = (uint8_t)(fragment >> 8);
+    return TRANSFER_HEADER_SIZE;
+}
+
+}
+
+size_t buildTransferRequest(uint8_t* out, uint8_t transfer, uint8_t kind, uint8_t window) {
+    size_t length = writeHeader(out, TRANSFER_FLAG_REQUEST, transfer, 0);
+    out[length++] = kind;
+    out[length++] = window;
+    return length;
+}
+
+size_t buildTransferAck(uint8_t* out, uint8_t transfer, uint16_t nextFragment) {
+    return writeHeader(out, TRANSFER_FLAG_ACK, transfer, nextFragment);
+}
+
+size_t buildTransferAbort(uint8_t* out, uint8_t transfer) {
+    return writeHeader(out, TRANSFER_FLAG_ABORT, transfer, 0);
+}
+
+bool parseTransferHeader(const uint8_t* data, size_t length, uint8_t& flags, uint8_t& transfer, uint16_t& fragment) {
+    if (length < TRANSFER_HEADER_SIZE || data[0] != TRANSFER_MAGIC || data[1] != TRANSFER_VERSION) {
+        return false;
+    }
+    flags = data[2];
+    transfer = data[3];
+    fragment = data[4] | (data[5] << 8);
+    return true;
+}
+
+BMTransferSender::BMTransferSender()
+    : active_(false), complete_(false), stalled_(false), transfer_(0), kind_(0), window_(TRANSFER_DEFAULT_WINDOW),
+      totalLength_(0), offset_(0), nextFragment_(0), ackedFragment_(0), lastSent_(false),
+      progressMs_(0) {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void BMTransferSender::begin(uint8_t transfer, uint8_t kind, uint32_t totalLength, uint8_t window,
+                             ReadFunction read, unsigned long nowMs) {
+    read_ = read;
+    active_ = true;
+    complete_ = false;
+    stalled_ = false;
+    transfer_ = transfer;
+    kind_ = kind;
+    window_ = constrain(window ? window : TRANSFER_DEFAULT_WINDOW, 1, TRANSFER_MAX_WINDOW);
+    totalLength_ = totalLength;
+    offset_ = 0;
+    nextFragment_ = 0;
+    ackedFragment_ = 0;
+    lastSent_ = false;
+    progressMs_ = nowMs;
+    stats_.transfers++;
+}
+
+size_t BMTransferSender::nextMessage(uint8_t* out, size_t capacity, unsigned long nowMs) {
+    if (!active_ || lastSent_) {
+        return 0;
+    }
+    if ((uint16_t)(nextFragment_ - ackedFragment_) >= window_) {
+        if (!stalled_) {
+            stalled_ = true;
+            stats_.stalls++;
+        }
+        return 0;
+    }
+    if (capacity > TRANSFER_MAX_MESSAGE) {
+        capacity = TRANSFER_MAX_MESSAGE;
+    }
+    if (capacity < TRANSFER_MIN_MESSAGE) {
+        return 0;
+    }
+
+    bool first = nextFragment_ == 0;
+    size_t length = TRANSFER_HEADER_SIZE;
+    if (first) {
+        out[length++] = kind_;
+        out[length++] = window_;
+        for (int i = 0; i < 4; i++) {
+            out[length++] = (uint8_t)(totalLength_ >> (8 * i));
+        }
+    }
+    size_t wanted = totalLength_ - offset_;
+    if (wanted > capacity - length) {
+        wanted = capacity - length;
+    }
+    size_t got = wanted ? read_(offset_, out + length, wanted) : 0;
+    if (got > wanted) {
+        got = wanted;
+    }
+    length += got;
+    offset_ += got;
+    // A source that runs short ends the transfer there
+    lastSent_ = offset_ >= totalLength_ || got < wanted;
+
+    uint8_t flags = (first ? TRANSFER_FLAG_FIRST : 0) | (lastSent_ ? TRANSFER_FLAG_LAST : 0);
+    writeHeader(out, flags, transfer_, nextFragment_);
+    nextFragment_++;
+    progressMs_ = nowMs;
+    stats_.fragments++;
+    stats_.bytes += length;
+    stats_.payloadBytes += got;
+    return length;
+}
+
+bool BMTransferSender::handleMessage(const uint8_t* data, size_t length, unsigned long nowMs) {
+    uint8_t flags, transfer;
+    uint16_t fragment;
+    if (!active_ || !parseTransferHeader(data, length, flags, transfer, fragment) || transfer != transfer_) {
+        return false;
+    }
+    if (flags & TRANSFER_FLAG_ABORT) {
+        active_ = false;
+        stats_.aborted++;
+        return true;
+    }
+    if (!(flags & TRANSFER_FLAG_ACK) || after(fragment, nextFragment_)) {
+        return false;
+    }
+    if (after(fragment, ackedFragment_)) {
+        ackedFragment_ = fragment;
+        progressMs_ = nowMs;
+        stalled_ = false;
+        stats_.acks++;
+    }
+    if (lastSent_ && ackedFragment_ == nextFragment_) {
+        active_ = false;
+        complete_ = true;
+        stats_.completed++;
+    }
+    return true;
+}
+
+bool BMTransferSender::timedOut(unsigned long nowMs) const {
+    return active_ && nowMs - progressMs_ >= TRANSFER_TIMEOUT_MS;
+}
+
+size_t BMTransferSender::abort(uint8_t* out) {
+    if (!active_) {
+        return 0;
+    }
+    active_ = false;
+    stats_.aborted++;
+    return out ? buildTransferAbort(out, transfer_) : 0;
+}
+
+BMTransferReceiver::BMTransferReceiver(uint8_t* buffer, size_t capacity)
+    : buffer_(buffer), capacity_(capacity), active_(false), transfer_(0), kind_(0), window_(TRANSFER_DEFAULT_WINDOW),
+      totalLength_(0), length_(0), nextFragment_(0), ackedFragment_(0), failures_(0) {}
+
+void BMTransferReceiver::reset() {
+    active_ = false;
+    length_ = 0;
+}
+
+TransferResult BMTransferReceiver::fail(uint8_t transfer, uint8_t* ack, size_t& ackLength) {
+    active_ = false;
+    failures_++;
+    ackLength = buildTransferAbort(ack, transfer);
+    return TRANSFER_FAILED;
+}
+
+TransferResult BMTransferReceiver::handleMessage(const uint8_t* data, size_t length, uint8_t* ack,
+                                                 size_t& ackLength) {
+    ackLength = 0;
+    uint8_t flags, transfer;
+    uint16_t fragment;
+    if (!parseTransferHeader(data, length, flags, transfer, fragment) ||
+        (flags & (TRANSFER_FLAG_REQUEST | TRANSFER_FLAG_ACK))) {
+        return TRANSFER_IGNORED;
+    }
+    if (flags & TRANSFER_FLAG_ABORT) {
+        if (!active_ || transfer != transfer_) {
+            return TRANSFER_IGNORED;
+        }
+        active_ = false;
+        failures_++;
+        return TRANSFER_FAILED;
+    }
+
+    const uint8_t* payload = data + TRANSFER_HEADER_SIZE;
+    size_t payloadLength = length - TRANSFER_HEADER_SIZE;
+    if (flags & TRANSFER_FLAG_FIRST) {
+        // A new transfer replaces any unfinished one
+        if (fragment != 0 || payloadLength < TRANSFER_FIRST_SIZE) {
+            return fail(transfer, ack, ackLength);
+        }
+        active_ = true;
+        transfer_ = transfer;
+        kind_ = payload[0];
+        window_ = constrain(payload[1], 1, TRANSFER_MAX_WINDOW);
+        totalLength_ = payload[2] | (payload[3] << 8) | ((uint32_t)payload[4] << 16) | ((uint32_t)payload[5] << 24);
+        length_ = 0;
+        nextFragment_ = 0;
+        ackedFragment_ = 0;
+        payload += TRANSFER_FIRST_SIZE;
+        payloadLength -= TRANSFER_FIRST_SIZE;
+        if (totalLength_ > capacity_) {
+            return fail(transfer, ack, ackLength);
+        }
+    } else if (!active_ || transfer != transfer_) {
+        return TRANSFER_IGNORED;
+    } else if (fragment != nextFragment_) {
+        return fail(transfer, ack, ackLength);
+    }
+
+    if (length_ + payloadLength > capacity_) {
+        return fail(transfer, ack, ackLength);
+    }
+    memcpy(buffer_ + length_, payload, payloadLength);
+    length_ += payloadLength;
+    nextFragment_++;
+
+    bool last = flags & TRANSFER_FLAG_LAST;
+    uint16_t ackEvery = window_ > 1 ? window_ / 2 : 1;
+    if (last || (uint16_t)(nextFragment_ - ackedFragment_) >= ackEvery) {
+        ackedFragment_ = nextFragment_;
+        ackLength = buildTransferAck(ack, transfer_, nextFragment_);
+    }
+    if (last) {
+        active_ = false;
+        return TRANSFER_COMPLETE;
+    }
+    return TRANSFER_PENDING;
+}
@@ -0,0 +1,161 @@
+#ifndef BM_TRANSFER_PROTOCOL_H
+#define BM_TRANSFER_PROTOCOL_H
+
+#include <Arduino.h>
+#include <functional>
+
+// Bulk transfers: payloads of any size (configuration, presets, animations,
+// logs) split into messages that fit the link, and put back together.
+//
+// Message:  magic 0xB9 | version | flags | transfer | fragment u16 | data
+// Device to app, messages are notifications of the status characteristic
+// (the magic tells them from status); app to device, writes of
+// BLE_FEATURE_TRANSFER followed by the message.
+//
+// flags: TRANSFER_FLAG_REQUEST - data is kind u8, window u8: send me this
+//                                kind as this transfer (app to device only)
+//        TRANSFER_FLAG_FIRST   - data starts with kind u8, window u8 and the
+//                                total length u32, then the payload
+//        TRANSFER_FLAG_LAST    - the last fragment of the transfer
+//        TRANSFER_FLAG_ACK     - no data; the receiver has every fragment
+//                                before this one
+//        TRANSFER_FLAG_ABORT   - no data; the transfer is over, unfinished
+//
+// Fragments of a transfer are numbered from 0 and sent in order. Flow
+// control is a window: the sender has at most window fragments out that the
+// receiver hasn't acknowledged, and the receiver acknowledges once it has
+// half a window more, and the last fragment. So a sender never queues more
+// notifications than the stack has buffers for, and never blocks on one; a
+// receiver that stops acknowledging stalls the transfer, and after
+// TRANSFER_TIMEOUT_MS the sender aborts it.
+#define TRANSFER_MAGIC 0xB9
+#define TRANSFER_VERSION 1
+#define TRANSFER_HEADER_SIZE 6
+#define TRANSFER_FIRST_SIZE 6           // kind, window, total length
+#define TRANSFER_FLAG_REQUEST 0x01
+#define TRANSFER_FLAG_FIRST 0x02
+#define TRANSFER_FLAG_LAST 0x04
+#define TRANSFER_FLAG_ACK 0x08
+#define TRANSFER_FLAG_ABORT 0x10
+#define TRANSFER_MIN_MESSAGE 13         // A first fragment with a byte of payload
+#define TRANSFER_MAX_MESSAGE 512        // A characteristic value
+#define TRANSFER_DEFAULT_WINDOW 8
+#define TRANSFER_MAX_WINDOW 32
+#define TRANSFER_TIMEOUT_MS 3000
+
+// Kinds; the ones from TRANSFER_KIND_PRESET on are the sketch's to provide
+#define TRANSFER_KIND_CONFIGURATION 0x01    // JSON, as BLE_FEATURE_GET_CONFIGURATION
+#define TRANSFER_KIND_PRESET 0x10
+#define TRANSFER_KIND_ANIMATION 0x11
+#define TRANSFER_KIND_LOG 0x12
+
+struct TransferStats {
+    uint32_t transfers;
+    uint32_t completed;
+    uint32_t aborted;
+    uint32_t fragments;
+    uint32_t bytes;             // Including headers
+    uint32_t payloadBytes;
+    uint32_t acks;
+    uint32_t stalls;            // Times the window was full
+};
+
+// Builds the messages that carry no payload; each returns its length
+size_t buildTransferRequest(uint8_t* out, uint8_t transfer, uint8_t kind, uint8_t window);
+size_t buildTransferAck(uint8_t* out, uint8_t transfer, uint16_t nextFragment);
+size_t buildTransferAbort(uint8_t* out, uint8_t transfer);
+
+// Whether a message is a transfer message, and its header
+bool parseTransferHeader(const uint8_t* data, size_t length, uint8_t& flags, uint8_t& transfer, uint16_t& fragment);
+
+class BMTransferSender {
+public:
+    // Fills out with up to capacity bytes from offset of the payload
+    typedef std::function<size_t(uint32_t offset, uint8_t* out, size_t capacity)> ReadFunction;
+
+    BMTransferSender();
+
+    // Starts sending totalLength bytes read through read; any transfer still
+    // going is dropped (abort() it first to tell the receiver)
+    void begin(uint8_t transfer, uint8_t kind, uint32_t totalLength, uint8_t window, ReadFunction read,
+               unsigned long nowMs);
+    // The next message, at most capacity bytes; 0 while the window is full
+    // or when everything is sent
+    size_t nextMessage(uint8_t* out, size_t capacity, unsigned long nowMs);
+    // An ACK or ABORT from the receiver; false if it wasn't for this transfer
+    bool handleMessage(const uint8_t* data, size_t length, unsigned long nowMs);
+    // No acknowledgement for TRANSFER_TIMEOUT_MS
+    bool timedOut(unsigned long nowMs) const;
+    // Ends the transfer; the message to tell the receiver, if out is given
+    size_t abort(uint8_t* out);
+
+    bool isActive() const { return active_; }
+    // Every fragment is out and acknowledged
+    bool isComplete() const { return !active_ && complete_; }
+    uint8_t getTransfer() const { return transfer_; }
+    uint8_t getKind() const { return kind_; }
+    uint8_t getWindow() const { return window_; }
+    uint16_t getInFlight() const { return (uint16_t)(nextFragment_ - ackedFragment_); }
+    const TransferStats& getStats() const { return stats_; }
+
+private:
+    ReadFunction read_;
+    bool active_;
+    bool complete_;
+    bool stalled_;
+    uint8_t transfer_;
+    uint8_t kind_;
+    uint8_t window_;
+    uint32_t totalLength_;
+    uint32_t offset_;
+    uint16_t nextFragment_;
+    uint16_t ackedFragment_;
+    bool lastSent_;
+    unsigned long progressMs_;
+
+    TransferStats stats_;
+};
+
+enum TransferResult {
+    TRANSFER_IGNORED,       // Not a transfer message, or not this receiver's
+    TRANSFER_PENDING,
+    TRANSFER_COMPLETE,      // getData() holds the payload
+    TRANSFER_FAILED         // Out of order, too large, or aborted
+};
+
+// Reassembles into a buffer the caller owns
+class BMTransferReceiver {
+public:
+    BMTransferReceiver(uint8_t* buffer, size_t capacity);
+
+    // One message; when the sender is owed an acknowledgement (or told of a
+    // failure), ackLength is set to the length of the message in ack
+    // (TRANSFER_HEADER_SIZE bytes), else 0
+    TransferResult handleMessage(const uint8_t* data, size_t length, uint8_t* ack, size_t& ackLength);
+    void reset();
+
+    bool isActive() const { return active_; }
+    uint8_t getTransfer() const { return transfer_; }
+    uint8_t getKind() const { return kind_; }
+    uint32_t getTotalLength() const { return totalLength_; }
+    size_t getLength() const { return length_; }
+    const uint8_t* getData() const { return buffer_; }
+    uint32_t getFailures() const { return failures_; }
+
+private:
+    TransferResult fail(uint8_t transfer, uint8_t* ack, size_t& ackLength);
+
+    uint8_t* buffer_;
+    size_t capacity_;
+    bool active_;
+    uint8_t transfer_;
+    uint8_t kind_;
+    uint8_t window_;
+    uint32_t totalLength_;
+    size_t length_;
+    uint16_t nextFragment_;
+    uint16_t ackedFragment_;    // The last acknowledgement sent
+    uint32_t failures_;
+};
+
+#endif // BM_TRANSFER_PROTOCOL_H
@@ -0,0 +1,12 @@
+#ifndef BM_SOUND_MAIN_H
+#define BM_SOUND_MAIN_H
+
+// Main BMSound library includes
+#include "src/SoundSettings.h"
+#include "src/SoundSource.h"
+#include "src/SoundVisualizer.h"
+#include "src/TripleBuffer.h"
+#include "src/I2SSoundSource.h"
+#include "src/SoundAnalysisTask.h"
+
+#endif // BM_SOUND_MAIN_H
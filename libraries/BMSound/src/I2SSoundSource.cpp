@@ -0,0 +1,83 @@
+#include "I2SSoundSource.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <BMLog.h>
+
+I2SSoundSource::I2SSoundSource(i2s_port_t port, int sckPin, int wsPin, int sdPin)
+    : port_(port), sckPin_(sckPin), wsPin_(wsPin), sdPin_(sdPin),
+      sampleRate_(0), installed_(false) {
+}
+
+I2SSoundSource::~I2SSoundSource() {
+    end();
+}
+
+bool I2SSoundSource::begin(uint32_t sampleRate) {
+    i2s_config_t i2s_config = {
+        .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX),
+        .sample_rate = sampleRate,
+        .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
+        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+        .dma_buf_count = I2S_SOUND_DMA_BUF_COUNT,
+        .dma_buf_len = I2S_SOUND_DMA_BUF_LEN,
+        .use_apll = false
+    };
+
+    i2s_pin_config_t pin_config = {
+        .bck_io_num = sckPin_,
+        .ws_io_num = wsPin_,
+        .data_out_num = I2S_PIN_NO_CHANGE,
+        .data_in_num = sdPin_
+    };
+
+    esp_err_t err = i2s_driver_install(port_, &i2s_config, 0, NULL);
+    if (err != ESP_OK) {
+        BMLOG_ERROR("I2SSoundSource", "Driver install failed: %s", esp_err_to_name(err));
+        installed_ = false;
+        return false;
+    }
+    i2s_set_pin(port_, &pin_config);
+
+    sampleRate_ = sampleRate;
+    installed_ = true;
+    return true;
+}
+
+void I2SSoundSource::end() {
+    if (installed_) {
+        i2s_driver_uninstall(port_);
+        installed_ = false;
+    }
+}
+
+bool I2SSoundSource::setSampleRate(uint32_t sampleRate) {
+    if (!installed_) {
+        return begin(sampleRate);
+    }
+    if (sampleRate == sampleRate_) {
+        return true;
+    }
+
+    // Retune the clock in place; the driver restarts DMA with the same buffers
+    esp_err_t err = i2s_set_sample_rates(port_, sampleRate);
+    if (err != ESP_OK) {
+        BMLOG_ERROR("I2SSoundSource", "Sample rate change failed: %s", esp_err_to_name(err));
+        return false;
+    }
+    sampleRate_ = sampleRate;
+    return true;
+}
+
+size_t I2SSoundSource::read(int16_t* buffer, size_t count) {
+    if (!installed_) {
+        return 0;
+    }
+
+    size_t bytesRead = 0;
+    i2s_read(port_, buffer, count * sizeof(int16_t), &bytesRead, portMAX_DELAY);
+    return bytesRead / sizeof(int16_t);
+}
+
+#endif // ARDUINO_ARCH_ESP32
@@ -0,0 +1,43 @@
+#ifndef BM_I2S_SOUND_SOURCE_H
+#define BM_I2S_SOUND_SOURCE_H
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include <Arduino.h>
+#include <driver/i2s.h>
+#include "SoundSource.h"
+
+// DMA buffers are handed to i2s_read() only once full, so their length bounds
+// capture latency: 256 frames is ~5.6ms at 46kHz (1024 was ~22ms). Eight of
+// them still give ~44ms of slack if the reader stalls.
+#define I2S_SOUND_DMA_BUF_COUNT 8
+#define I2S_SOUND_DMA_BUF_LEN 256
+
+// I2S MEMS microphone (INMP441 and friends), 16-bit mono, left channel
+class I2SSoundSource : public SoundSource {
+public:
+    I2SSoundSource(i2s_port_t port, int sckPin, int wsPin, int sdPin);
+    ~I2SSoundSource();
+
+    bool begin(uint32_t sampleRate);
+    void end();
+
+    // Retunes the I2S clock without reinstalling the driver (installs it if needed)
+    bool setSampleRate(uint32_t sampleRate);
+
+    size_t read(int16_t* buffer, size_t count) override;
+    uint32_t getSampleRate() const override { return sampleRate_; }
+    bool isInstalled() const { return installed_; }
+
+private:
+    i2s_port_t port_;
+    int sckPin_;
+    int wsPin_;
+    int sdPin_;
+    uint32_t sampleRate_;
+    bool installed_;
+};
+
+#endif // ARDUINO_ARCH_ESP32
+
+#endif // BM_I2S_SOUND_SOURCE_H
@@ -0,0 +1,139 @@
+#include "SoundAnalysisTask.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <BMLog.h>
+
+SoundAnalysisTask::SoundAnalysisTask(SoundVisualizer& visualizer, I2SSoundSource& source)
+    : visualizer_(visualizer), source_(source), taskHandle_(nullptr),
+      paused_(false), reconfigurePending_(false), pendingSampleCount_(0), pendingSamplingFreq_(0),
+      levelsPending_(false), pendingAmplitude_(0), pendingNoiseThreshold_(0), settlingWindows_(0),
+      windowsPerSecond_(0), analysisMicros_(0) {
+    memset(&latency_, 0, sizeof(latency_));
+}
+
+bool SoundAnalysisTask::begin(BaseType_t core, UBaseType_t priority, uint32_t stackSize) {
+    if (taskHandle_) {
+        return true;
+    }
+
+    BaseType_t result = xTaskCreatePinnedToCore(taskEntry, "soundAnalysis", stackSize, this,
+                                                priority, &taskHandle_, core);
+    if (result != pdPASS) {
+        BMLOG_ERROR("SoundAnalysisTask", "Failed to create analysis task");
+        taskHandle_ = nullptr;
+        return false;
+    }
+
+    BMLOG_INFO("SoundAnalysisTask", "Running on core %d (priority %u)", (int)core, (unsigned)priority);
+    return true;
+}
+
+void SoundAnalysisTask::requestReconfigure(int sampleCount, int samplingFreq) {
+    if (!taskHandle_) {
+        applyConfiguration(sampleCount, samplingFreq);
+        return;
+    }
+
+    pendingSampleCount_ = sampleCount;
+    pendingSamplingFreq_ = samplingFreq;
+    reconfigurePending_.store(true, std::memory_order_release);
+}
+
+void SoundAnalysisTask::requestLevels(int amplitude, int noiseThreshold) {
+    if (!taskHandle_) {
+        visualizer_.setLevels(amplitude, noiseThreshold);
+        return;
+    }
+
+    pendingAmplitude_ = amplitude;
+    pendingNoiseThreshold_ = noiseThreshold;
+    levelsPending_.store(true, std::memory_order_release);
+}
+
+void SoundAnalysisTask::applyConfiguration(int sampleCount, int samplingFreq) {
+    if ((uint32_t)samplingFreq != source_.getSampleRate() || !source_.isInstalled()) {
+        source_.setSampleRate(samplingFreq);
+        // The first window after a clock change straddles both rates
+        settlingWindows_ = 1;
+    }
+    if (sampleCount != visualizer_.getSampleCount() || samplingFreq != visualizer_.getSamplingFrequency()) {
+        visualizer_.configure(sampleCount, samplingFreq);
+    }
+}
+
+const SoundFeatures& SoundAnalysisTask::acquireLatest(bool* isNew) {
+    bool updated = snapshots_.update();
+    if (isNew) {
+        *isNew = updated;
+    }
+    return snapshots_.readBuffer();
+}
+
+void SoundAnalysisTask::recordLedUpdate(const SoundFeatures& features) {
+    if (features.sampleTimeUs == 0) {
+        return;
+    }
+
+    uint32_t latencyUs = micros() - features.sampleTimeUs;
+    latency_.lastUs = latencyUs;
+    latency_.averageUs = latency_.samples == 0 ? latencyUs : (latency_.averageUs * 7 + latencyUs) / 8;
+    if (latencyUs > latency_.maxUs) {
+        latency_.maxUs = latencyUs;
+    }
+    latency_.samples++;
+}
+
+void SoundAnalysisTask::taskEntry(void* arg) {
+    static_cast<SoundAnalysisTask*>(arg)->run();
+}
+
+void SoundAnalysisTask::run() {
+    uint32_t windows = 0;
+    uint32_t windowStart = millis();
+
+    while (true) {
+        if (reconfigurePending_.exchange(false, std::memory_order_acquire)) {
+            applyConfiguration(pendingSampleCount_, pendingSamplingFreq_);
+        }
+        if (levelsPending_.exchange(false, std::memory_order_acquire)) {
+            visualizer_.setLevels(pendingAmplitude_, pendingNoiseThreshold_);
+        }
+
+        if (!visualizer_.capture(source_)) {
+            // Driver not installed (or reinstall failed) - don't spin
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+
+        uint32_t readDone = micros();
+        if (paused_) {
+            continue;
+        }
+
+        // Keep showing the previous snapshot until the new rate has settled
+        if (settlingWindows_ > 0) {
+            settlingWindows_--;
+            continue;
+        }
+
+        // The oldest sample in the window arrived one window length ago
+        uint32_t windowUs = (uint32_t)((uint64_t)visualizer_.getSampleCount() * 1000000ULL /
+                                       visualizer_.getSamplingFrequency());
+
+        SoundFeatures& snapshot = snapshots_.writeBuffer();
+        snapshot = visualizer_.analyze(millis(), readDone - windowUs);
+        snapshots_.publish();
+
+        analysisMicros_ = micros() - readDone;
+        windows++;
+
+        uint32_t now = millis();
+        if (now - windowStart >= 1000) {
+            windowsPerSecond_ = windows * 1000 / (now - windowStart);
+            windows = 0;
+            windowStart = now;
+        }
+    }
+}
+
+#endif // ARDUINO_ARCH_ESP32
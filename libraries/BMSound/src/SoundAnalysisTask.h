@@ -0,0 +1,99 @@
+#ifndef BM_SOUND_ANALYSIS_TASK_H
+#define BM_SOUND_ANALYSIS_TASK_H
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include <Arduino.h>
+#include <atomic>
+#include "SoundVisualizer.h"
+#include "I2SSoundSource.h"
+#include "TripleBuffer.h"
+
+#define SOUND_TASK_DEFAULT_CORE 0
+#define SOUND_TASK_DEFAULT_PRIORITY 3
+#define SOUND_TASK_STACK_SIZE 4096
+
+// Sample-to-LED latency statistics, recorded by the render side
+struct SoundLatencyStats {
+    uint32_t lastUs;
+    uint32_t averageUs;   // Exponential moving average
+    uint32_t maxUs;       // Since the last resetMax()
+    uint32_t samples;
+};
+
+// Runs capture + analysis on its own pinned FreeRTOS task.
+//
+// The task publishes a SoundFeatures snapshot per analysis window through a
+// triple buffer; the render path (loop()) picks up the latest complete
+// snapshot with acquireLatest() without ever blocking on the audio side.
+// Sample rate / FFT size changes are handed to the task and applied between
+// windows, so the I2S driver and FFT buffers are only touched by one task.
+// Amplitude and noise threshold changes are handed over the same way.
+// Neither reinstalls nor allocates: the FFT size is an index change and the
+// I2S clock is retuned in place, with the straddling window discarded.
+class SoundAnalysisTask {
+public:
+    SoundAnalysisTask(SoundVisualizer& visualizer, I2SSoundSource& source);
+
+    bool begin(BaseType_t core = SOUND_TASK_DEFAULT_CORE,
+               UBaseType_t priority = SOUND_TASK_DEFAULT_PRIORITY,
+               uint32_t stackSize = SOUND_TASK_STACK_SIZE);
+    bool isRunning() const { return taskHandle_ != nullptr; }
+
+    // Skip analysis (the microphone is still drained so data stays fresh)
+    void setPaused(bool paused) { paused_ = paused; }
+
+    // Apply a new FFT size / sample rate at the next window boundary.
+    // Before begin() the change is applied immediately.
+    void requestReconfigure(int sampleCount, int samplingFreq);
+
+    // Restart auto-gain / ambient compensation from these levels at the next
+    // window boundary (see SoundVisualizer::setLevels()); the values the task
+    // arrives at come back in SoundFeatures. Before begin() they are applied
+    // immediately.
+    void requestLevels(int amplitude, int noiseThreshold);
+
+    // Render side: latest complete snapshot. isNew is set when it has not
+    // been returned before.
+    const SoundFeatures& acquireLatest(bool* isNew = nullptr);
+
+    // Render side: call right after the LEDs were pushed for a new snapshot
+    void recordLedUpdate(const SoundFeatures& features);
+
+    const SoundLatencyStats& getLatencyStats() const { return latency_; }
+    void resetLatencyMax() { latency_.maxUs = 0; }
+
+    // Analysis side statistics (written by the task, read anywhere)
+    uint32_t getWindowsPerSecond() const { return windowsPerSecond_; }
+    uint32_t getAnalysisMicros() const { return analysisMicros_; }
+
+private:
+    static void taskEntry(void* arg);
+    void run();
+    void applyConfiguration(int sampleCount, int samplingFreq);
+
+    SoundVisualizer& visualizer_;
+    I2SSoundSource& source_;
+    TripleBuffer<SoundFeatures> snapshots_;
+    TaskHandle_t taskHandle_;
+
+    std::atomic<bool> paused_;
+    std::atomic<bool> reconfigurePending_;
+    std::atomic<int> pendingSampleCount_;
+    std::atomic<int> pendingSamplingFreq_;
+    std::atomic<bool> levelsPending_;
+    std::atomic<int> pendingAmplitude_;
+    std::atomic<int> pendingNoiseThreshold_;
+    uint8_t settlingWindows_;           // Windows to discard after a rate change (task only)
+
+    // Task statistics
+    volatile uint32_t windowsPerSecond_;
+    volatile uint32_t analysisMicros_;
+
+    // Render side state
+    SoundLatencyStats latency_;
+};
+
+#endif // ARDUINO_ARCH_ESP32
+
+#endif // BM_SOUND_ANALYSIS_TASK_H
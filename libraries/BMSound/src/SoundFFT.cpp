@@ -0,0 +1,127 @@
+#include "SoundFFT.h"
+#include <math.h>
+#include <string.h>
+
+SoundFFT::SoundFFT() : size_(0), sizeIndex_(-1) {
+    memset(real_, 0, sizeof(real_));
+    memset(imag_, 0, sizeof(imag_));
+
+    for (int k = 0; k < SOUND_FFT_MAX_SIZE / 2; k++) {
+        double angle = 2.0 * M_PI * k / SOUND_FFT_MAX_SIZE;
+        twiddleCos_[k] = (float)cos(angle);
+        twiddleSin_[k] = (float)sin(angle);
+    }
+
+    // Hamming window, same definition as arduinoFFT (symmetric, N - 1 denominator)
+    uint16_t offset = 0;
+    for (int index = 0; index < SOUND_FFT_SIZE_COUNT; index++) {
+        int size = SOUND_FFT_MIN_SIZE << index;
+        windowOffsets_[index] = offset;
+        for (int i = 0; i < size / 2; i++) {
+            double ratio = (double)i / (size - 1);
+            windows_[offset + i] = (float)(0.54 - 0.46 * cos(2.0 * M_PI * ratio));
+        }
+        offset += size / 2;
+    }
+}
+
+int SoundFFT::sizeIndex(int size) {
+    for (int index = 0; index < SOUND_FFT_SIZE_COUNT; index++) {
+        if ((SOUND_FFT_MIN_SIZE << index) == size) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+bool SoundFFT::isSupportedSize(int size) {
+    return sizeIndex(size) >= 0;
+}
+
+int SoundFFT::supportedSize(int size) {
+    int result = SOUND_FFT_MIN_SIZE;
+    while (result < size && result < SOUND_FFT_MAX_SIZE) {
+        result <<= 1;
+    }
+    return result;
+}
+
+bool SoundFFT::setSize(int size) {
+    int index = sizeIndex(size);
+    if (index < 0) {
+        return false;
+    }
+
+    size_ = size;
+    sizeIndex_ = index;
+    return true;
+}
+
+void SoundFFT::dcRemoval() {
+    float mean = 0;
+    for (int i = 0; i < size_; i++) {
+        mean += real_[i];
+    }
+    mean /= size_;
+    for (int i = 0; i < size_; i++) {
+        real_[i] -= mean;
+    }
+}
+
+void SoundFFT::applyWindow() {
+    const float* window = windows_ + windowOffsets_[sizeIndex_];
+    for (int i = 0; i < size_ / 2; i++) {
+        real_[i] *= window[i];
+        real_[size_ - (i + 1)] *= window[i];
+    }
+}
+
+void SoundFFT::forward() {
+    const int n = size_;
+
+    // Bit-reversal permutation
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            float t = real_[i];
+            real_[i] = real_[j];
+            real_[j] = t;
+            t = imag_[i];
+            imag_[i] = imag_[j];
+            imag_[j] = t;
+        }
+    }
+
+    // Iterative radix-2 butterflies; stage twiddles stride through the max-size table
+    for (int length = 2; length <= n; length <<= 1) {
+        int half = length >> 1;
+        int stride = SOUND_FFT_MAX_SIZE / length;
+        for (int start = 0; start < n; start += length) {
+            for (int k = 0; k < half; k++) {
+                float wr = twiddleCos_[k * stride];
+                float wi = -twiddleSin_[k * stride];
+                int a = start + k;
+                int b = a + half;
+                float tr = wr * real_[b] - wi * imag_[b];
+                float ti = wr * imag_[b] + wi * real_[b];
+                real_[b] = real_[a] - tr;
+                imag_[b] = imag_[a] - ti;
+                real_[a] += tr;
+                imag_[a] += ti;
+            }
+        }
+    }
+
+    // Match arduinoFFT: clear the DC bin
+    real_[0] = 0;
+}
+
+void SoundFFT::complexToMagnitude() {
+    for (int i = 0; i < size_; i++) {
+        real_[i] = sqrtf(real_[i] * real_[i] + imag_[i] * imag_[i]);
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef BM_SOUND_FFT_H
+#define BM_SOUND_FFT_H
+
+#include <stdint.h>
+
+// Supported FFT sizes: every power of two from MIN to MAX
+#define SOUND_FFT_MIN_SIZE 64
+#define SOUND_FFT_MAX_SIZE 2048
+#define SOUND_FFT_SIZE_COUNT 6
+
+// Fixed-capacity radix-2 FFT for the sound pipeline.
+//
+// All storage is inline and sized for SOUND_FFT_MAX_SIZE, and every table is
+// built once in the constructor:
+//   - one twiddle table for the largest size; smaller sizes stride through it
+//   - one half-length Hamming window per supported size
+// so switching size with setSize() is just an index change - no allocation,
+// no trig, and it can happen between any two windows.
+//
+// Results match arduinoFFT's dcRemoval/Hamming/compute/complexToMagnitude
+// chain (same unnormalized magnitudes, bin 0 cleared), in single precision
+// since the ESP32 FPU has no double support.
+class SoundFFT {
+public:
+    SoundFFT();
+
+    static bool isSupportedSize(int size);
+    // Nearest supported size (rounded up to a power of two, clamped)
+    static int supportedSize(int size);
+
+    bool setSize(int size);
+    int getSize() const { return size_; }
+
+    float* real() { return real_; }
+    float* imag() { return imag_; }
+
+    void dcRemoval();
+    void applyWindow();
+    void forward();
+    void complexToMagnitude();
+
+private:
+    static int sizeIndex(int size);
+
+    float real_[SOUND_FFT_MAX_SIZE];
+    float imag_[SOUND_FFT_MAX_SIZE];
+
+    // cos/sin(2*pi*k / MAX) for k < MAX/2
+    float twiddleCos_[SOUND_FFT_MAX_SIZE / 2];
+    float twiddleSin_[SOUND_FFT_MAX_SIZE / 2];
+
+    // Half windows for each size, packed back to back (32 + 64 + ... + 1024)
+    float windows_[SOUND_FFT_MAX_SIZE - SOUND_FFT_MIN_SIZE / 2];
+    uint16_t windowOffsets_[SOUND_FFT_SIZE_COUNT];
+
+    int size_;
+    int sizeIndex_;
+};
+
+#endif // BM_SOUND_FFT_H
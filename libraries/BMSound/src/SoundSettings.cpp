@@ -0,0 +1,104 @@
+#include "SoundSettings.h"
+#include <string.h>
+
+namespace {
+
+// Every stored field, in order; encode and decode share it so they can't
+// drift apart
+template <typename Visitor>
+void visitFields(SoundSettings& s, Visitor& visit) {
+    visit(s.soundSensitive);
+    visit(s.amplitude);
+    visit(s.noiseThreshold);
+    visit(s.reference);
+    visit(s.decay);
+    visit(s.decayRate);
+    visit(s.barMode);
+    visit(s.rainbowMode);
+    visit(s.colorSpeed);
+    visit(s.reverseDirection);
+    visit(s.peakHold);
+    visit(s.peakHoldTime);
+    visit(s.smoothing);
+    visit(s.smoothingFactor);
+    visit(s.intensityMapping);
+    visit(s.beatDetection);
+    visit(s.beatSensitivity);
+    visit(s.strobeOnBeat);
+    visit(s.pulseOnBeat);
+    visit(s.bassEmphasis);
+    visit(s.midEmphasis);
+    visit(s.trebleEmphasis);
+    visit(s.logarithmicMapping);
+    visit(s.autoGain);
+    visit(s.ambientCompensation);
+    visit(s.stripMapping);
+    visit(s.individualDirections);
+    visit(s.samplingFrequency);
+    visit(s.sampleCount);
+    visit(s.gainMultiplier);
+    visit(s.minLEDs);
+    visit(s.maxLEDs);
+    visit(s.frequencyMin);
+    visit(s.frequencyMax);
+    visit(s.doubleHeight);
+    visit(s.ledMultiplier);
+    visit(s.fillFromCenter);
+}
+
+struct Writer {
+    uint8_t* out;
+
+    void operator()(bool& value) { *out++ = value ? 1 : 0; }
+    void operator()(int& value) { word((uint32_t)value); }
+
+    void operator()(float& value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        word(bits);
+    }
+
+    void word(uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            *out++ = (value >> (8 * i)) & 0xFF;
+        }
+    }
+};
+
+struct Reader {
+    const uint8_t* data;
+
+    void operator()(bool& value) { value = *data++ != 0; }
+    void operator()(int& value) { value = (int)word(); }
+
+    void operator()(float& value) {
+        uint32_t bits = word();
+        memcpy(&value, &bits, sizeof(value));
+    }
+
+    uint32_t word() {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            value |= (uint32_t)*data++ << (8 * i);
+        }
+        return value;
+    }
+};
+
+}
+
+size_t encodeSoundSettings(const SoundSettings& settings, uint8_t* out) {
+    SoundSettings copy = settings;
+    Writer writer = {out};
+    visitFields(copy, writer);
+    return writer.out - out;
+}
+
+bool decodeSoundSettings(const uint8_t* data, size_t length, SoundSettings& settings) {
+    if (length != SOUND_SETTINGS_SIZE) {
+        return false;
+    }
+    Reader reader = {data};
+    visitFields(settings, reader);
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef BM_SOUND_SETTINGS_H
+#define BM_SOUND_SETTINGS_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of frequency bands (one per LED strip on the umbrella)
+#ifndef SOUND_NUM_BANDS
+#define SOUND_NUM_BANDS 8
+#endif
+
+// Default LED count per band, used as the maxLEDs default
+#ifndef SOUND_LEDS_PER_BAND
+#define SOUND_LEDS_PER_BAND 38
+#endif
+
+#define SOUND_DEFAULT_SAMPLES 256
+#define SOUND_DEFAULT_SAMPLING_FREQ 46000
+
+// Sound settings as stored: every field in declaration order, bools as one
+// byte, ints and floats as four bytes little-endian. A new field goes at the
+// end and bumps SOUND_SETTINGS_VERSION; the sketch storing the settings then
+// needs a migration for its record.
+#define SOUND_SETTINGS_VERSION 1
+#define SOUND_SETTINGS_SIZE 97
+
+// All tunable sound visualization parameters.
+struct SoundSettings {
+    // Basic settings
+    bool soundSensitive = true;
+    int amplitude = 1000;
+    int noiseThreshold = 500;
+    float reference = log10(50.0);
+    bool decay = false;
+    int decayRate = 100;
+
+    // Visual modes
+    bool barMode = true;
+    bool rainbowMode = false;
+    int colorSpeed = 50;
+    bool reverseDirection = false;
+
+    // Advanced features
+    bool peakHold = false;
+    int peakHoldTime = 500;
+    bool smoothing = true;
+    float smoothingFactor = 0.3;
+    bool intensityMapping = false;
+
+    // Beat detection
+    bool beatDetection = false;
+    int beatSensitivity = 70;
+    bool strobeOnBeat = false;
+    bool pulseOnBeat = false;
+
+    // Frequency controls
+    int bassEmphasis = 50;
+    int midEmphasis = 50;
+    int trebleEmphasis = 50;
+    bool logarithmicMapping = true;
+
+    // Auto features
+    bool autoGain = false;
+    bool ambientCompensation = false;
+    int stripMapping = 0;
+    bool individualDirections = false;
+
+    // Advanced audio settings
+    int samplingFrequency = SOUND_DEFAULT_SAMPLING_FREQ;
+    int sampleCount = SOUND_DEFAULT_SAMPLES;
+    float gainMultiplier = 1.0;
+    int minLEDs = 0;
+    int maxLEDs = SOUND_LEDS_PER_BAND;
+    int frequencyMin = 50;
+    int frequencyMax = 8000;
+    bool doubleHeight = false;
+    float ledMultiplier = 1.0;
+    bool fillFromCenter = false;
+};
+
+// Writes SOUND_SETTINGS_SIZE bytes
+size_t encodeSoundSettings(const SoundSettings& settings, uint8_t* out);
+// False unless length is SOUND_SETTINGS_SIZE; settings is left alone then
+bool decodeSoundSettings(const uint8_t* data, size_t length, SoundSettings& settings);
+
+#endif // BM_SOUND_SETTINGS_H
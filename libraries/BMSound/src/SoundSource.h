@@ -0,0 +1,23 @@
+#ifndef BM_SOUND_SOURCE_H
+#define BM_SOUND_SOURCE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Abstract source of mono 16-bit audio samples.
+// On the device this is the I2S microphone; on a host it can be a WAV file,
+// a synthetic generator, or anything else that produces PCM.
+class SoundSource {
+public:
+    virtual ~SoundSource() {}
+
+    // Fill buffer with up to count samples. Blocks until samples are
+    // available (device) or the source is exhausted (host).
+    // Returns the number of samples written.
+    virtual size_t read(int16_t* buffer, size_t count) = 0;
+
+    // Current sample rate in Hz
+    virtual uint32_t getSampleRate() const = 0;
+};
+
+#endif // BM_SOUND_SOURCE_H
@@ -0,0 +1,375 @@
+#include "SoundVisualizer.h"
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Arduino-compatible helpers (integer map/constrain) so the pipeline does not
+// depend on the Arduino core and behaves identically on a host
+static long mapRange(long x, long inMin, long inMax, long outMin, long outMax) {
+    if (inMax == inMin) {
+        return outMin;
+    }
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+template <typename T>
+static T constrainValue(T value, T low, T high) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+SoundVisualizer::SoundVisualizer(SoundSettings& settings)
+    : settings_(settings), sampleCount_(0), samplingFreq_(0), amplitude_(settings.amplitude),
+      noiseThreshold_(settings.noiseThreshold) {
+    memset(samples_, 0, sizeof(samples_));
+    resetTracking();
+}
+
+void SoundVisualizer::configure(int sampleCount, int samplingFreq) {
+    fft_.setSize(SoundFFT::supportedSize(sampleCount));
+    sampleCount_ = fft_.getSize();
+    samplingFreq_ = samplingFreq;
+}
+
+void SoundVisualizer::resetTracking() {
+    for (int i = 0; i < SOUND_NUM_BANDS; i++) {
+        peakValues_[i] = 0;
+        peakTimes_[i] = 0;
+        smoothedValues_[i] = 0;
+    }
+    previousAverage_ = 0;
+    lastBeatTime_ = 0;
+    recentMax_ = 0;
+    lastGainAdjust_ = 0;
+    beatInterval_ = 500;
+    rms_ = 0;
+    memset(&features_, 0, sizeof(features_));
+    features_.amplitude = amplitude_;
+    features_.noiseThreshold = noiseThreshold_;
+    memset(barHeights_, 0, sizeof(barHeights_));
+    lastRenderedBeat_ = 0;
+}
+
+void SoundVisualizer::setLevels(int amplitude, int noiseThreshold) {
+    amplitude_ = amplitude;
+    noiseThreshold_ = noiseThreshold;
+    features_.amplitude = amplitude_;
+    features_.noiseThreshold = noiseThreshold_;
+}
+
+bool SoundVisualizer::capture(SoundSource& source) {
+    if (!isReady()) {
+        return false;
+    }
+
+    size_t count = source.read(samples_, sampleCount_);
+
+    float* vReal = fft_.real();
+    float* vImag = fft_.imag();
+    double sum = 0;
+    double sumSquares = 0;
+    for (int i = 0; i < sampleCount_; i++) {
+        // Apply gain multiplier early in the chain
+        float sample = (i < (int)count) ? samples_[i] * settings_.gainMultiplier : 0;
+        vReal[i] = sample;
+        vImag[i] = 0;
+        sum += sample;
+        sumSquares += (double)sample * sample;
+    }
+
+    // RMS around the window mean (the microphone has a DC offset)
+    double mean = sum / sampleCount_;
+    double variance = sumSquares / sampleCount_ - mean * mean;
+    rms_ = variance > 0 ? sqrt(variance) : 0;
+
+    return count == (size_t)sampleCount_;
+}
+
+const SoundFeatures& SoundVisualizer::analyze(uint32_t now, uint32_t sampleTimeUs) {
+    features_.timestamp = now;
+    features_.sampleTimeUs = sampleTimeUs;
+    features_.sequence++;
+    features_.beat = false;
+    features_.gainAdjusted = false;
+    features_.rms = rms_;
+
+    if (!isReady()) {
+        return features_;
+    }
+
+    // Compute FFT
+    fft_.dcRemoval();
+    fft_.applyWindow();
+    fft_.forward();
+    fft_.complexToMagnitude();
+    const float* vReal = fft_.real();
+
+    // Calculate frequency range for analysis based on settings
+    int minFreqBin = (settings_.frequencyMin * sampleCount_) / samplingFreq_;
+    int maxFreqBin = (settings_.frequencyMax * sampleCount_) / samplingFreq_;
+    minFreqBin = constrainValue(minFreqBin, 2, sampleCount_ / 2);
+    maxFreqBin = constrainValue(maxFreqBin, minFreqBin + 1, sampleCount_ / 2);
+
+    // Calculate overall volume for beat detection and auto-gain
+    float totalVolume = 0;
+    for (int i = minFreqBin; i < maxFreqBin; i++) {
+        totalVolume += vReal[i];
+    }
+    float averageVolume = totalVolume / (maxFreqBin - minFreqBin);
+    features_.averageVolume = averageVolume;
+
+    // Beat detection
+    if (settings_.beatDetection) {
+        float beatThreshold = previousAverage_ * (1.0 + settings_.beatSensitivity / 100.0);
+
+        if (averageVolume > beatThreshold && (now - lastBeatTime_) > 100) { // 100ms minimum between beats
+            // Track the beat period (30-240 BPM) to derive a phase between beats
+            uint32_t interval = now - lastBeatTime_;
+            if (interval >= 250 && interval <= 2000) {
+                beatInterval_ = beatInterval_ * 0.8 + interval * 0.2;
+            }
+            features_.beat = true;
+            features_.beatCount++;
+            lastBeatTime_ = now;
+        }
+        previousAverage_ = averageVolume * 0.9 + previousAverage_ * 0.1; // Smooth average
+    }
+    features_.beatPhase = std::min(1.0f, (now - lastBeatTime_) / beatInterval_);
+
+    // Auto-gain adjustment
+    if (settings_.autoGain) {
+        if (averageVolume > recentMax_) {
+            recentMax_ = averageVolume;
+        }
+
+        if (now - lastGainAdjust_ > 2000) { // Adjust every 2 seconds
+            if (recentMax_ > 0) {
+                float targetAmplitude = 32000; // Target for good visual range
+                float gainAdjustment = targetAmplitude / recentMax_;
+                amplitude_ = constrainValue((int)(amplitude_ * gainAdjustment), 100, 10000);
+                features_.gainAdjusted = true;
+            }
+            recentMax_ *= 0.8; // Decay recent max
+            lastGainAdjust_ = now;
+        }
+    }
+
+    // Ambient noise compensation
+    if (settings_.ambientCompensation) {
+        float ambientLevel = averageVolume * 0.1; // Estimate ambient as 10% of current
+        noiseThreshold_ = (int)(ambientLevel * 1.5);
+    }
+    features_.amplitude = amplitude_;
+    features_.noiseThreshold = noiseThreshold_;
+
+    // Initialize band values
+    float rawBandValues[SOUND_NUM_BANDS] = {0};
+
+    // Calculate frequency ranges for each strip based on mapping mode
+    int stripOrder[SOUND_NUM_BANDS];
+    switch (settings_.stripMapping) {
+        case 2: // Treble to Bass (high freq to low freq)
+            for (int i = 0; i < SOUND_NUM_BANDS; i++) stripOrder[i] = SOUND_NUM_BANDS - 1 - i;
+            break;
+        case 3: { // Center out (mid frequencies in center)
+            int centerOut[8] = {3, 4, 2, 5, 1, 6, 0, 7};
+            for (int i = 0; i < SOUND_NUM_BANDS; i++) stripOrder[i] = centerOut[i % 8];
+            break;
+        }
+        case 0: // Normal (0,1,2,3,4,5,6,7)
+        case 1: // Bass to Treble (low freq to high freq)
+        default:
+            for (int i = 0; i < SOUND_NUM_BANDS; i++) stripOrder[i] = i;
+            break;
+    }
+
+    // Map FFT results to LED strips with frequency emphasis
+    for (int i = minFreqBin; i < maxFreqBin; i++) {
+        if (vReal[i] > noiseThreshold_) {
+            int bandIndex;
+
+            if (settings_.logarithmicMapping) {
+                // Logarithmic mapping for more musical response
+                float logPos = log(i - minFreqBin + 1) / log(maxFreqBin - minFreqBin);
+                bandIndex = (int)(logPos * SOUND_NUM_BANDS);
+            } else {
+                // Linear mapping
+                bandIndex = mapRange(i, minFreqBin, maxFreqBin - 1, 0, SOUND_NUM_BANDS - 1);
+            }
+
+            bandIndex = constrainValue(bandIndex, 0, SOUND_NUM_BANDS - 1);
+
+            // Apply frequency emphasis
+            float emphasis = 1.0;
+            if (bandIndex < SOUND_NUM_BANDS / 3) {
+                // Bass range
+                emphasis = settings_.bassEmphasis / 50.0;
+            } else if (bandIndex < 2 * SOUND_NUM_BANDS / 3) {
+                // Mid range
+                emphasis = settings_.midEmphasis / 50.0;
+            } else {
+                // Treble range
+                emphasis = settings_.trebleEmphasis / 50.0;
+            }
+
+            rawBandValues[stripOrder[bandIndex]] += vReal[i] * emphasis;
+        }
+    }
+
+    // Apply smoothing
+    for (int strip = 0; strip < SOUND_NUM_BANDS; strip++) {
+        if (settings_.smoothing) {
+            smoothedValues_[strip] = smoothedValues_[strip] * (1.0 - settings_.smoothingFactor) +
+                                     rawBandValues[strip] * settings_.smoothingFactor;
+            rawBandValues[strip] = smoothedValues_[strip];
+        }
+    }
+
+    // Apply peak hold
+    for (int strip = 0; strip < SOUND_NUM_BANDS; strip++) {
+        if (settings_.peakHold) {
+            if (rawBandValues[strip] > peakValues_[strip]) {
+                peakValues_[strip] = rawBandValues[strip];
+                peakTimes_[strip] = now;
+            } else if (now - peakTimes_[strip] > (uint32_t)settings_.peakHoldTime) {
+                peakValues_[strip] *= 0.95; // Gradual decay
+            }
+            features_.peaks[strip] = peakValues_[strip];
+        } else {
+            features_.peaks[strip] = 0;
+        }
+        features_.levels[strip] = rawBandValues[strip];
+    }
+
+    return features_;
+}
+
+void SoundVisualizer::render(const SoundFeatures& features, CRGB* const strips[SOUND_NUM_BANDS], int ledsPerStrip,
+                             const CRGBPalette16& primaryPalette, const CRGBPalette16& secondaryPalette,
+                             bool secondaryPaletteOff, bool reverseDirection, uint32_t now) {
+    // Beat effects fire once per new beat, however many frames a snapshot is drawn for
+    bool newBeat = features.beatCount != lastRenderedBeat_;
+    lastRenderedBeat_ = features.beatCount;
+
+    // Update each LED strip with all the visual modes
+    for (int strip = 0; strip < SOUND_NUM_BANDS; strip++) {
+        float bandValue = std::max(features.levels[strip], features.peaks[strip]);
+
+        // Calculate bar height with new enhancement features
+        float rawHeight = bandValue / features.amplitude;
+
+        // Apply LED multiplier for more sensitivity
+        rawHeight *= settings_.ledMultiplier;
+
+        // Apply double height if enabled
+        if (settings_.doubleHeight) {
+            rawHeight *= 2.0;
+        }
+
+        int barHeight = (int)rawHeight;
+
+        // Apply min/max LED constraints
+        if (barHeight > 0) {
+            barHeight = std::max(barHeight, settings_.minLEDs);
+        }
+        barHeight = std::min(barHeight, settings_.maxLEDs);
+        barHeights_[strip] = barHeight;
+
+        // Beat effects
+        bool applyBeatEffect = newBeat && (settings_.strobeOnBeat || settings_.pulseOnBeat);
+
+        for (int i = 0; i < ledsPerStrip; i++) {
+            CRGB color = CRGB::Black;
+
+            // Calculate if this LED is part of the sound visualization
+            bool isInSoundVisualization = false;
+            float soundIntensity = 0.0; // 0.0 = background, 1.0 = full sound intensity
+
+            if (settings_.barMode) {
+                if (settings_.fillFromCenter) {
+                    // Fill from center outward
+                    int center = ledsPerStrip / 2;
+                    int halfHeight = barHeight / 2;
+                    isInSoundVisualization = (i >= (center - halfHeight) && i <= (center + halfHeight));
+                    if (isInSoundVisualization) {
+                        // Calculate intensity based on distance from center
+                        int distanceFromCenter = abs(i - center);
+                        soundIntensity = 1.0 - ((float)distanceFromCenter / (halfHeight + 1));
+                    }
+                } else {
+                    // Bar mode - fill from bottom
+                    isInSoundVisualization = (i < barHeight);
+                    if (isInSoundVisualization) {
+                        // Calculate intensity - higher LEDs get more intensity
+                        soundIntensity = (float)(barHeight - i) / barHeight;
+                    }
+                }
+            } else {
+                // Dot mode - only peak
+                if (settings_.fillFromCenter) {
+                    int center = ledsPerStrip / 2;
+                    isInSoundVisualization = (i == center) && (barHeight > 0);
+                } else {
+                    isInSoundVisualization = (i == barHeight - 1) && (barHeight > 0);
+                }
+                soundIntensity = isInSoundVisualization ? 1.0 : 0.0;
+            }
+
+            // Calculate palette index for gradient
+            uint8_t paletteIndex;
+            if (settings_.intensityMapping && isInSoundVisualization) {
+                // Map volume to color intensity instead of height
+                paletteIndex = mapRange((long)(bandValue / features.amplitude), 0, ledsPerStrip, 0, 255);
+            } else {
+                // Normal palette mapping by position
+                paletteIndex = mapRange(i, 0, ledsPerStrip - 1, 0, 255);
+                paletteIndex += (now * settings_.colorSpeed / 500) % 256; // Color cycling
+            }
+
+            if (settings_.rainbowMode) {
+                // Rainbow mode overrides palettes
+                uint8_t hue = mapRange(strip, 0, SOUND_NUM_BANDS - 1, 0, 255);
+                hue += (now * settings_.colorSpeed / 100) % 256; // Color cycling
+                if (isInSoundVisualization) {
+                    color = CHSV(hue, 255, (uint8_t)(255 * soundIntensity)); // Intensity based on sound level
+                } else {
+                    color = CHSV(hue, 255, 64);  // Dimmed for background
+                }
+            } else if (isInSoundVisualization) {
+                // Sound visualization always uses the primary palette, faded by intensity
+                color = ColorFromPalette(primaryPalette, paletteIndex);
+                if (soundIntensity < 1.0) {
+                    color.fadeToBlackBy((uint8_t)(255 * (1.0 - soundIntensity)));
+                }
+            } else if (!secondaryPaletteOff) {
+                // Background uses secondary palette (or black when off)
+                color = ColorFromPalette(secondaryPalette, paletteIndex);
+                color.fadeToBlackBy(192); // Dim background to 25% brightness
+            }
+
+            // Beat effects
+            if (applyBeatEffect) {
+                if (settings_.strobeOnBeat) {
+                    color = CRGB::White; // Flash white on beat
+                } else if (settings_.pulseOnBeat && isInSoundVisualization) {
+                    color.fadeToBlackBy(128); // Dim on beat for pulse effect
+                }
+            }
+
+            strips[strip][i] = color;
+        }
+    }
+
+    // Apply individual directions if enabled
+    if (settings_.individualDirections) {
+        // For now, alternate direction every other strip
+        for (int i = 1; i < SOUND_NUM_BANDS; i += 2) {
+            std::reverse(strips[i], strips[i] + ledsPerStrip);
+        }
+    } else if (reverseDirection) {
+        // Apply global direction
+        for (int i = 0; i < SOUND_NUM_BANDS; i++) {
+            std::reverse(strips[i], strips[i] + ledsPerStrip);
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef BM_SOUND_VISUALIZER_H
+#define BM_SOUND_VISUALIZER_H
+
+#include <FastLED.h>
+#include "SoundFFT.h"
+#include "SoundSettings.h"
+#include "SoundSource.h"
+
+// Compact result of one analysis window. This is what the analysis side
+// publishes and the render side consumes, so it is kept small and flat.
+struct SoundFeatures {
+    float levels[SOUND_NUM_BANDS];     // Band energy after smoothing
+    float peaks[SOUND_NUM_BANDS];      // Peak-hold values (0 when peak hold is off)
+    float averageVolume;               // Mean magnitude across the analysed bins
+    float rms;                         // Time-domain RMS of the window (after gain)
+    bool beat;                         // Beat detected in this window
+    uint32_t beatCount;                // Running beat count, lets readers catch beats between frames
+    float beatPhase;                   // 0..1 position within the estimated beat period
+    bool gainAdjusted;                 // Auto-gain changed amplitude
+    int amplitude;                     // Band level per LED, as auto-gain left it
+    int noiseThreshold;                // Bin magnitude floor, as ambient compensation left it
+    uint32_t timestamp;                // Time (ms) passed to analyze()
+    uint32_t sampleTimeUs;             // When the oldest sample of the window was captured (micros)
+    uint32_t sequence;                 // Window counter
+};
+
+// FFT sound analysis and LED rendering for the umbrella visualization.
+//
+// The pipeline is split into three steps so the same code runs on the device
+// (I2S microphone) and on a host (WAV replay):
+//   capture(source)  - fill the FFT input from a SoundSource
+//   analyze(now)     - FFT, band mapping, beat detection, auto-gain, smoothing
+//   render(features) - draw a feature snapshot onto the LED strips
+//
+// capture/analyze and render may run on different tasks (see
+// SoundAnalysisTask); they only share the SoundFeatures snapshot and settings.
+// Auto-gain and ambient compensation keep amplitude and noise threshold as
+// analysis-side state, seeded from the settings and changed with setLevels(),
+// and publish them in the snapshot; analyze() never writes the settings.
+// Time is always passed in by the caller instead of calling millis(), so host
+// replays run on virtual (sample-accurate) time.
+class SoundVisualizer {
+public:
+    explicit SoundVisualizer(SoundSettings& settings);
+
+    // Switch window size and rate. Buffers are sized for SOUND_FFT_MAX_SIZE up
+    // front, so this never allocates and is safe between any two windows.
+    // Unsupported sizes are rounded up to the next power of two (64..2048).
+    void configure(int sampleCount, int samplingFreq);
+    bool isReady() const { return sampleCount_ > 0; }
+
+    // Read one analysis window from the source. Returns false if the source
+    // could not supply a full window (host sources at end of file).
+    bool capture(SoundSource& source);
+
+    // Analysis side only (SoundAnalysisTask::requestLevels() from elsewhere):
+    // restart auto-gain and ambient compensation from these values
+    void setLevels(int amplitude, int noiseThreshold);
+
+    const SoundFeatures& analyze(uint32_t now, uint32_t sampleTimeUs = 0);
+
+    void render(const SoundFeatures& features, CRGB* const strips[SOUND_NUM_BANDS], int ledsPerStrip,
+                const CRGBPalette16& primaryPalette, const CRGBPalette16& secondaryPalette,
+                bool secondaryPaletteOff, bool reverseDirection, uint32_t now);
+
+    // Clear beat/peak/smoothing history
+    void resetTracking();
+
+    const SoundFeatures& getFeatures() const { return features_; }
+    const int* getBarHeights() const { return barHeights_; }
+    int getSampleCount() const { return sampleCount_; }
+    int getSamplingFrequency() const { return samplingFreq_; }
+
+private:
+    SoundSettings& settings_;
+
+    // FFT state
+    SoundFFT fft_;
+    int16_t samples_[SOUND_FFT_MAX_SIZE];
+    int sampleCount_;
+    int samplingFreq_;
+
+    // Tracking state
+    float peakValues_[SOUND_NUM_BANDS];
+    uint32_t peakTimes_[SOUND_NUM_BANDS];
+    float smoothedValues_[SOUND_NUM_BANDS];
+    float previousAverage_;
+    uint32_t lastBeatTime_;
+    float recentMax_;
+    uint32_t lastGainAdjust_;
+    float beatInterval_;
+    float rms_;
+    int amplitude_;
+    int noiseThreshold_;
+
+    SoundFeatures features_;
+
+    // Render state
+    int barHeights_[SOUND_NUM_BANDS];
+    uint32_t lastRenderedBeat_;
+};
+
+#endif // BM_SOUND_VISUALIZER_H
@@ -0,0 +1,49 @@
+#ifndef BM_TRIPLE_BUFFER_H
+#define BM_TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Lock-free single-producer / single-consumer "latest value" buffer.
+//
+// The producer always writes into its private back slot and publishes it by
+// swapping it with the shared middle slot. The consumer swaps the middle slot
+// into its private front slot when a new value is available. Neither side ever
+// blocks or sees a partially written value, and the consumer always gets the
+// most recent complete snapshot (intermediate ones are dropped).
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : front_(0), middle_(1), back_(2) {}
+
+    // Producer side
+    T& writeBuffer() { return slots_[back_]; }
+
+    void publish() {
+        uint8_t previous = middle_.exchange(back_ | FRESH_BIT, std::memory_order_acq_rel);
+        back_ = previous & INDEX_MASK;
+    }
+
+    // Consumer side: returns true if a newer snapshot was swapped in
+    bool update() {
+        if (!(middle_.load(std::memory_order_relaxed) & FRESH_BIT)) {
+            return false;
+        }
+        uint8_t previous = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& readBuffer() const { return slots_[front_]; }
+
+private:
+    static const uint8_t INDEX_MASK = 0x03;
+    static const uint8_t FRESH_BIT = 0x04;
+
+    T slots_[3];
+    uint8_t front_;                 // Owned by the consumer
+    std::atomic<uint8_t> middle_;   // Shared hand-off slot (+ fresh flag)
+    uint8_t back_;                  // Owned by the producer
+};
+
+#endif // BM_TRIPLE_BUFFER_H
@@ -0,0 +1,60 @@
+#include "CampWifiLink.h"
+#include <BMLog.h>
+
+CampWifiLink::CampWifiLink(const char *wifi_ssid, const char *wifi_password) : wifi_ssid_(wifi_ssid),
+                                                                               wifi_password_(wifi_password),
+                                                                               wifi_status_(WL_IDLE_STATUS),
+                                                                               last_wifi_begin_time_(0)
+{
+}
+
+bool CampWifiLink::connect(unsigned long timeout_ms)
+{
+    WiFi.mode(WIFI_STA);
+    WiFi.begin(wifi_ssid_, wifi_password_);
+    last_wifi_begin_time_ = millis();
+    while (WiFi.status() != WL_CONNECTED && millis() - last_wifi_begin_time_ < timeout_ms)
+    {
+        delay(100);
+    }
+    update_connectivity();
+    if (!is_connected())
+    {
+        // Stop trying, so the radio stays on its channel for ESP-NOW
+        WiFi.disconnect();
+    }
+    return is_connected();
+}
+
+void CampWifiLink::update_connectivity()
+{
+    unsigned long now = millis();
+    uint8_t new_wifi_status = WiFi.status();
+
+    if (wifi_status_ != new_wifi_status)
+    {
+        if (new_wifi_status == WL_CONNECTED)
+        {
+            BMLOG_INFO("CampWifiLink", "Connected to wifi network: SSID = %s, IP = %s / %s, gateway = %s", wifi_ssid_,
+                       WiFi.localIP().toString().c_str(), WiFi.subnetMask().toString().c_str(),
+                       WiFi.gatewayIP().toString().c_str());
+        }
+        else if (wifi_status_ == WL_CONNECTED)
+        {
+            BMLOG_INFO("CampWifiLink", "Disconnected from wifi network: SSID = %s", wifi_ssid_);
+        }
+
+        wifi_status_ = new_wifi_status;
+    }
+
+    if (wifi_status_ != WL_CONNECTED && now - last_wifi_begin_time_ >= min_wifi_begin_interval_)
+    {
+        WiFi.begin(wifi_ssid_, wifi_password_);
+        last_wifi_begin_time_ = now;
+    }
+}
+
+bool CampWifiLink::is_connected()
+{
+    return wifi_status_ == WL_CONNECTED;
+}
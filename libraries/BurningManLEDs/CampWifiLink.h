@@ -0,0 +1,29 @@
+#ifndef CAMPWIFILINK_H
+#define CAMPWIFILINK_H
+
+#include <WiFi.h>
+
+// Keeps a prop joined to a camp Wi-Fi network (station mode), for
+// SyncController over UdpMulticastTransport. The transport owns the socket
+// and rejoins the multicast group itself once the network is back.
+class CampWifiLink
+{
+public:
+    CampWifiLink(const char *wifi_ssid, const char *wifi_password);
+    // Blocks until joined or timeout_ms passes; for setup(), to decide
+    // between UDP and ESP-NOW. Gives up on the network if it times out.
+    bool connect(unsigned long timeout_ms);
+    // Call from loop(): retries the network every min_wifi_begin_interval_
+    void update_connectivity();
+    bool is_connected();
+
+private:
+    static constexpr unsigned long min_wifi_begin_interval_ = 30000;
+
+    const char *wifi_ssid_;
+    const char *wifi_password_;
+    uint8_t wifi_status_;
+    unsigned long last_wifi_begin_time_;
+};
+
+#endif // CAMPWIFILINK_H
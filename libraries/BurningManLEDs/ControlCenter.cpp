@@ -8,6 +8,7 @@
 #include "LightShow.h"
 #include <algorithm>
 #include "Helpers.h"
+#include <BMLog.h>
 
 constexpr ControlCenter::MapEntry<ControlCenter::Command> ControlCenter::command_map_[];
 constexpr ControlCenter::MapEntry<ControlCenter::LightShowMode> ControlCenter::light_show_mode_map_[];
@@ -47,7 +48,7 @@ char *paletteEnumToString(AvailablePalettes palette)
 }
 AvailablePalettes stringToPaletteEnum(const char *str)
 {
-    Serial.println("Running to enum");
+    BMLOG_DEBUG("ControlCenter", "Running to enum");
     if (strcmp(str, "cool") == 0)
     {
         return AvailablePalettes::cool;
@@ -199,13 +200,7 @@ bool ControlCenter::execute_command(char *request_params[], size_t num_params)
         return false;
     }
 
-    Serial.print("Received command:");
-    for (size_t i = 0; i < num_params; i++)
-    {
-        Serial.print(" ");
-        Serial.print(request_params[i]);
-    }
-    Serial.println();
+    BMLOG_DEBUG("ControlCenter", "Received command: %s (%u params)", request_params[0], (unsigned)(num_params - 1));
 
     const char *requested_command_str = request_params[0];
     Command requested_command;
@@ -253,7 +248,7 @@ bool ControlCenter::button_press_cycle_lightshow()
         if (current_palette_ <= AvailablePalettes::vga)
         {
             char *params[] = {paletteEnumToString(current_palette_)};
-            Serial.println(params[0]);
+            BMLOG_DEBUG("ControlCenter", "Cycling to palette %s", params[0]);
             return change_palette_(params, 1);
         }
         // If we've cycled through all palettes, reset and increment the mode
@@ -291,13 +286,12 @@ void ControlCenter::change_light_show_mode(const char *requested_mode_str)
 
     if (mode_found)
     {
-        Serial.println('Changing light show mode to: ');
-        Serial.println(requested_mode_str);
+        BMLOG_DEBUG("ControlCenter", "Changing light show mode to: %s", requested_mode_str);
         light_show_mode_ = requested_mode;
     }
     else
     {
-        Serial.println("Mode not found");
+        BMLOG_WARN("ControlCenter", "Mode not found");
     }
 }
 
@@ -371,15 +365,13 @@ bool ControlCenter::change_light_show_mode_(char *request_params[], size_t num_p
 
     if (!mode_found)
     {
-        Serial.println("mode not found");
-        Serial.println(requested_mode_str);
+        BMLOG_WARN("ControlCenter", "Mode not found: %s", requested_mode_str);
         return false;
     }
 
     light_show_mode_ = requested_mode;
 
-    Serial.print("Requested Mode: ");
-    Serial.println(requested_mode_str);
+    BMLOG_DEBUG("ControlCenter", "Requested Mode: %s", requested_mode_str);
 
     return true;
 }
@@ -468,10 +460,10 @@ bool ControlCenter::change_color_(char *request_params[], size_t num_params)
 
 bool ControlCenter::change_palette_(char *request_params[], size_t num_params)
 {
-    Serial.println("Change Palette_");
+    BMLOG_DEBUG("ControlCenter", "Change Palette_");
     if (num_params < 1)
     {
-        Serial.println("returning false");
+        BMLOG_WARN("ControlCenter", "Missing palette name");
         return false;
     }
     const char *paletteName = request_params[0];
@@ -481,10 +473,10 @@ bool ControlCenter::change_palette_(char *request_params[], size_t num_params)
 
 bool ControlCenter::change_primary_palette_(char *request_params[], size_t num_params)
 {
-    Serial.println("Change Primary Palette_");
+    BMLOG_DEBUG("ControlCenter", "Change Primary Palette_");
     if (num_params < 1)
     {
-        Serial.println("returning false");
+        BMLOG_WARN("ControlCenter", "Missing palette name");
         return false;
     }
     const char *paletteName = request_params[0];
@@ -494,10 +486,10 @@ bool ControlCenter::change_primary_palette_(char *request_params[], size_t num_p
 
 bool ControlCenter::change_secondary_palette_(char *request_params[], size_t num_params)
 {
-    Serial.println("Change Secondary Palette_");
+    BMLOG_DEBUG("ControlCenter", "Change Secondary Palette_");
     if (num_params < 1)
     {
-        Serial.println("returning false");
+        BMLOG_WARN("ControlCenter", "Missing palette name");
         return false;
     }
     const char *paletteName = request_params[0];
@@ -651,7 +643,7 @@ void ControlCenter::update_state()
             }
             else
             {
-                Serial.println("Failed to obtain time");
+                BMLOG_WARN("ControlCenter", "Failed to obtain time");
                 light_show_->spectrum_cycle(30);
             }
         }
@@ -756,7 +748,7 @@ void ControlCenter::write_status(WiFiClient &client)
         }
         else
         {
-            Serial.println("Failed to obtain time");
+            BMLOG_WARN("ControlCenter", "Failed to obtain time");
         }
     }
 
@@ -1,15 +0,0 @@
-#include "GlobalDefaults.h"
-
-std::map<std::pair<std::string, std::string>, DeviceInfo> deviceMap = {
-    {{"CL", "Bike"}, {"CL", "Bike", {0xCC, 0xDB, 0xA7, 0x5A, 0x23, 0xF4}}},
-    {{"CL", "Fannypack"}, {"CL", "Fannypack", {0x0C, 0xB8, 0x15, 0x77, 0x89, 0xE8}}},
-    {{"CL", "Fannypack2"}, {"CL", "Fannypack2", {0x08, 0xB6, 0x1F, 0xB9, 0xF8, 0x24}}},
-    {{"CL", "Backpack"}, {"CL", "Backpack", {0x08, 0xB6, 0x1F, 0xB9, 0xE5, 0x30}}},
-    {{"CL", "Umbrella"}, {"CL", "Umbrella", {0xB0, 0xA7, 0x32, 0xDB, 0xAC, 0xD4}}},
-    {{"CL", "CowboyHat"}, {"CL", "CowboyHat", {0xEC, 0xDA, 0x3B, 0xBB, 0xCA, 0x00}}},
-    {{"AY", "Backpack"}, {"AY", "Backpack", {0x08, 0xB6, 0x1F, 0xB8, 0xA7, 0xE8}}},
-    {{"AY", "CowboyHat"}, {"AY", "CowboyHat", {0xEC, 0xDA, 0x3B, 0xBB, 0x34, 0x0C}}},
-    {{"AY", "Fannypack"}, {"AY", "Fannypack", {0x08, 0xB6, 0x1F, 0xB9, 0x91, 0xF8}}},
-    {{"VM", "Bike"}, {"VM", "Bike", {0xC8, 0x2E, 0x18, 0xF1, 0x57, 0x20}}},
-    {{"VM", "Backpack"}, {"VM", "Backpack", {0xC8, 0xF0, 0x9E, 0x4D, 0x19, 0x28}}},
-    {{"XX", "Camp"}, {"XX", "Camp", {0x24, 0xDC, 0xC3, 0x44, 0x22, 0xC8}}}};
\ No newline at end of file
@@ -1,9 +1,10 @@
 // Helpers.cpp
 #include "Helpers.h"
+#include <BMLog.h>
 
 AvailablePalettes stringToPalette(const char *str)
 {
-    Serial.println("Running to enum");
+    BMLOG_DEBUG("Helpers", "Running to enum");
     if (strcmp(str, "candypalette") == 0)
     {
         return AvailablePalettes::candy;
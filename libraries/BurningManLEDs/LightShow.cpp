@@ -1,4 +1,5 @@
 #include "LightShow.h"
+#include <BMLog.h>
 #include <FastLED.h>
 #include "Palettes.h"
 
@@ -372,14 +373,14 @@ void LightShow::apply_sync_updates(LightScene &new_scene)
 
     if (active_scene_.color != new_scene.color)
     {
-        Serial.println("Color has changed");
+        BMLOG_DEBUG("LightShow", "Color has changed");
         active_scene_.color = new_scene.color;
         color_ = new_scene.color;
         scene_changed_ = true;
     }
     if (active_scene_.primary_palette != new_scene.primary_palette)
     {
-        Serial.println("Primary Palette has changed");
+        BMLOG_DEBUG("LightShow", "Primary Palette has changed");
         active_scene_.primary_palette = new_scene.primary_palette;
         scene_changed_ = true;
     }
@@ -387,26 +388,26 @@ void LightShow::apply_sync_updates(LightScene &new_scene)
     // ||
     // memcmp(&active_scene_.scenes, &new_scene.scenes, sizeof(active_scene_.scenes)) != 0)
     {
-        Serial.println("Scene ID has changed");
+        BMLOG_DEBUG("LightShow", "Scene ID has changed");
         active_scene_.scene_id = new_scene.scene_id;
         scene_changed_ = true;
     }
     if (active_scene_.speed != new_scene.speed)
     {
-        Serial.println("Speed has changed");
+        BMLOG_DEBUG("LightShow", "Speed has changed");
         active_scene_.speed = new_scene.speed;
         scene_changed_ = true;
         speed_ = new_scene.speed;
     }
     if (active_scene_.brightness != new_scene.brightness)
     {
-        Serial.println("Brightness has changed");
+        BMLOG_DEBUG("LightShow", "Brightness has changed");
         active_scene_.brightness = new_scene.brightness;
         scene_changed_ = true;
     }
     if (active_scene_.direction != new_scene.direction)
     {
-        Serial.println("Direction has changed");
+        BMLOG_DEBUG("LightShow", "Direction has changed");
         active_scene_.direction = new_scene.direction;
         scene_changed_ = true;
         direction_ = new_scene.direction;
@@ -1300,7 +1301,7 @@ void LightShow::setup_palette_stream_(bool direction)
 // Set the primary palette to a predefined palette
 void LightShow::setPrimaryPalette(AvailablePalettes palette)
 {
-    Serial.println("Setting primary palette");
+    BMLOG_DEBUG("LightShow", "Setting primary palette");
     primary_palette_ = getPalette(palette);
     current_palette_ = palette;
 }
@@ -1,4 +1,5 @@
 #include "NetworkManagerCore.h"
+#include <BMLog.h>
 
 NetworkManagerCore::NetworkManagerCore(const char *wifi_ssid, const char *wifi_password,
                                        const IPAddress &unicast_local_address, const IPAddress &multicast_local_address,
@@ -24,7 +25,7 @@ void NetworkManagerCore::create_access_point()
     bool result = WiFi.softAP(wifi_ssid_, wifi_password_);
     if (!result)
     {
-        Serial.println("Creating wifi AP failed");
+        BMLOG_ERROR("NetworkManagerCore", "Creating wifi AP failed");
         return;
     }
 
@@ -56,24 +57,24 @@ void NetworkManagerCore::send_message(const NetworkMessage *message)
     int result = udp_.beginPacket(multicast_remote_address_, multicast_port_);
     if (!result)
     {
-        Serial.println("Initializing UDP packet failed");
+        BMLOG_ERROR("NetworkManagerCore", "Initializing UDP packet failed");
         return;
     }
 
     size_t message_length = udp_.write(buffer, buffer_size);
     if (message_length != buffer_size)
     {
-        Serial.println("UDP packet data truncated");
+        BMLOG_WARN("NetworkManagerCore", "UDP packet data truncated");
     }
 
     result = udp_.endPacket();
     if (!result)
     {
-        Serial.println("Sending UDP packet failed");
+        BMLOG_ERROR("NetworkManagerCore", "Sending UDP packet failed");
         return;
     }
 
-    Serial.println("Sending UDP packet successful");
+    BMLOG_VERBOSE("NetworkManagerCore", "Sending UDP packet successful");
 
     // Serial.print("Sent packet: size = ");
     // Serial.print(message_length);
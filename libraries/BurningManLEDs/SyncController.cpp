@@ -2,14 +2,13 @@
 
 #include "SyncController.h"
 #include "LightShow.h"
+#include <BMLog.h>
 #include <DeviceRoles.h>
 #include <map>
 #include <string>
 
 void (*SyncController::userCallback)(const uint8_t *mac, const uint8_t *data, int len) = nullptr;
-SyncController *SyncController::instance_ = nullptr;
 bool initialized = false;
-#define ESPNOW_WIFI_CHANNEL 6
 
 SyncController::SyncController(LightShow &light_show, const std::string &userIdentifier, Device &deviceType) : light_show_(light_show),
                                                                                                                brightness_(DEFAULT_BRIGHTNESS),
@@ -17,22 +16,20 @@ SyncController::SyncController(LightShow &light_show, const std::string &userIde
                                                                                                                currentSetting_(PALETTE),
                                                                                                                origin_(Position(DEFAULT_ORIGIN_LATITUDE, DEFAULT_ORIGIN_LONGITUDE)),
                                                                                                                radius_inner_(DEFAULT_PLAYA_INNER_RADIUS),
-                                                                                                               radius_outer_(DEFAULT_PLAYA_OUTER_RADIUS)
+                                                                                                               radius_outer_(DEFAULT_PLAYA_OUTER_RADIUS),
+                                                                                                               transport_(&espnow_),
+                                                                                                               clock_sync_(nullptr),
+                                                                                                               clock_(nullptr),
+                                                                                                               channel_(SyncProtocol::groupId(userIdentifier.c_str())),
+                                                                                                               fanout_(SYNC_FANOUT_BROADCAST),
+                                                                                                               relay_enabled_(false),
+                                                                                                               schedule_enabled_(false),
+                                                                                                               clock_via_relays_(0),
+                                                                                                               clock_via_seen_ms_(0),
+                                                                                                               has_clock_via_(false),
+                                                                                                               peer_group_(0)
 {
-    instance_ = this;
-    std::string deviceName = getDeviceName(deviceType);
-    auto key = std::make_pair(userIdentifier, deviceName);
-    // Set the MAC address based on the provided user identifier and device type
-    if (deviceMap.find(key) != deviceMap.end())
-    {
-        Serial.println("Device found. Using MAC address.");
-        memcpy(broadcastAddress, deviceMap[key].mac, 6);
-    }
-    else
-    {
-        Serial.println("Device not found. Using broadcast address.");
-        memset(broadcastAddress, 0xFF, 6); // Broadcasting to all devices as a fallback
-    }
+    device_type_ = static_cast<uint8_t>(deviceType);
 }
 
 void SyncController::readMacAddress()
@@ -41,113 +38,285 @@ void SyncController::readMacAddress()
     esp_err_t ret = esp_wifi_get_mac(WIFI_IF_STA, baseMac);
     if (ret == ESP_OK)
     {
-        Serial.printf("%02x:%02x:%02x:%02x:%02x:%02x\n",
-                      baseMac[0], baseMac[1], baseMac[2],
-                      baseMac[3], baseMac[4], baseMac[5]);
+        BMLOG_INFO("SyncController", "ESP32 Board MAC Address: %02x:%02x:%02x:%02x:%02x:%02x",
+                   baseMac[0], baseMac[1], baseMac[2],
+                   baseMac[3], baseMac[4], baseMac[5]);
     }
     else
     {
-        Serial.println("Failed to read MAC address");
+        BMLOG_ERROR("SyncController", "Failed to read MAC address");
     }
 }
 
 void SyncController::begin(const std::string &userIdentifier = "")
 {
-    WiFi.mode(WIFI_STA);
-    WiFi.setChannel(ESPNOW_WIFI_CHANNEL);
-    if (esp_now_init() != ESP_OK)
+    BMLog::begin();
+    transport_->onReceive([this](const uint8_t *mac, const uint8_t *data, size_t len)
+                          { onDataReceived(mac, data, len); });
+    transport_->onSent([this](const uint8_t *mac, bool delivered)
+                       { onDataSent(mac, delivered); });
+    if (!transport_->begin())
     {
-        Serial.println("Error initializing ESP-NOW");
         return;
     }
-    esp_now_register_recv_cb(SyncController::onDataReceivedStatic);
+
+    uint8_t ownMac[6] = {};
+    transport_->getMac(ownMac);
+    channel_.setSendFunction([this](const uint8_t *mac, const uint8_t *data, size_t len)
+                             { return sendScene(mac, data, len); });
+    channel_.onScene([this](const LightScene &shared, uint16_t fields)
+                     {
+                         LightScene scene = light_show_.getCurrentScene();
+                         SyncProtocol::copyFields(fields, shared, scene);
+                         BMLOG_DEBUG("SyncController", "Received Brightness: %u", scene.brightness);
+                         setCurrentDeviceScene(scene); });
+    channel_.begin(ownMac, light_show_.getCurrentScene());
+
+    // Everyone in range announces itself; matching peers are registered as they appear
+    discovery_.setSendFunction([this](const uint8_t *mac, const uint8_t *data, size_t len)
+                               { return sendRaw(mac, data, len); });
+    discovery_.onPeerAdded([this](const PeerInfo &peer)
+                           { onPeerAdded(peer); });
+    discovery_.onPeerRemoved([this](const PeerInfo &peer)
+                             { onPeerRemoved(peer); });
+    discovery_.begin(channel_.getGroupId(), device_type_, PEER_CAP_LEDS);
+
+    // The leader is the time master; until one is elected nobody is
+    election_.setSendFunction([this](const uint8_t *mac, const uint8_t *data, size_t len)
+                              { return sendGroup(mac, data, len); });
+    election_.onLeaderChanged([this](const uint8_t *leader)
+                              { onLeaderChanged(leader); });
+    election_.begin(ownMac, channel_.getGroupId());
+
+    // Only used once enableRelay() is called
+    relay_.setSendFunction([this](const uint8_t *mac, const uint8_t *data, size_t len)
+                           { return sendRaw(mac, data, len); });
+    relay_.onDeliver([this](const uint8_t *origin, const uint8_t *data, size_t len, const uint8_t *via, uint8_t relays)
+                     { onRelayed(origin, data, len, via, relays); });
+    relay_.begin(ownMac, channel_.getGroupId());
     addPeers(userIdentifier);
-    Serial.print("[DEFAULT] ESP32 Board MAC Address: ");
     readMacAddress();
 }
 
 void SyncController::addPeers(const std::string &userIdentifier)
 {
-    for (const auto &pair : deviceMap)
+    peer_group_ = SyncProtocol::groupId(userIdentifier.c_str());
+    // Peers already discovered; later ones are added from onPeerAdded()
+    for (uint8_t i = 0; i < discovery_.getPeerCount(); i++)
+    {
+        onPeerAdded(discovery_.getPeer(i));
+    }
+}
+
+bool SyncController::matchesPeerFilter(const PeerInfo &peer) const
+{
+    return peer_group_ == 0 || peer.group_id == peer_group_;
+}
+
+void SyncController::onPeerAdded(const PeerInfo &peer)
+{
+    if (peer.group_id == channel_.getGroupId())
+    {
+        channel_.addReceiver(peer.mac);
+        election_.addCandidate(peer.mac);
+    }
+
+    if (!matchesPeerFilter(peer) || transport_->hasPeer(peer.mac))
+    {
+        return;
+    }
+    if (transport_->addPeer(peer.mac))
+    {
+        BMLOG_INFO("SyncController", "Discovered peer %02x:%02x:%02x:%02x:%02x:%02x (%c%c, %s)",
+                   peer.mac[0], peer.mac[1], peer.mac[2], peer.mac[3], peer.mac[4], peer.mac[5],
+                   (char)(peer.group_id >> 8), (char)(peer.group_id & 0xFF),
+                   getDeviceName(static_cast<Device>(peer.device_type)).c_str());
+    }
+    else
+    {
+        BMLOG_ERROR("SyncController", "Failed to add peer");
+    }
+}
+
+void SyncController::onPeerRemoved(const PeerInfo &peer)
+{
+    channel_.removeReceiver(peer.mac);
+    election_.removeCandidate(peer.mac);
+    // ESP-NOW only holds 20 peers; free the slot for someone still in range
+    transport_->removePeer(peer.mac);
+}
+
+void SyncController::onLeaderChanged(const uint8_t *leader)
+{
+    // Found again from the new leader's heartbeats
+    has_clock_via_ = false;
+    channel_.setLeader(leader);
+    updateClockRole();
+
+    uint16_t capabilities = discovery_.getCapabilities();
+    discovery_.setCapabilities(election_.isLeader() ? (capabilities | PEER_CAP_TIME_MASTER)
+                                                    : (capabilities & ~PEER_CAP_TIME_MASTER));
+    if (leader)
     {
-        // Check if the user identifier matches the given filter
-        if (userIdentifier.empty() || pair.second.userIdentifier == userIdentifier)
+        BMLOG_INFO("SyncController", "Group leader %02x:%02x:%02x:%02x:%02x:%02x%s",
+                   leader[0], leader[1], leader[2], leader[3], leader[4], leader[5],
+                   election_.isLeader() ? " (this device)" : "");
+    }
+    else
+    {
+        BMLOG_INFO("SyncController", "Group leader lost, electing a new one");
+    }
+}
+
+void SyncController::updateClockRole()
+{
+    if (!clock_sync_)
+    {
+        return;
+    }
+    clock_sync_->setMaster(election_.isLeader());
+    clock_sync_->setServing(relay_enabled_);
+    // Without a leader the clock keeps its discipline until the next one answers
+    if (election_.hasLeader() && !election_.isLeader())
+    {
+        clock_sync_->setMasterAddress(has_clock_via_ ? clock_via_ : election_.getLeader());
+    }
+}
+
+void SyncController::onRelayed(const uint8_t *origin, const uint8_t *data, size_t len, const uint8_t *via, uint8_t relays)
+{
+    // Delivered from relay_.update() in loop(), so applied at once: the
+    // election and channel queues only take the receive callback's messages
+    if (!election_.processMessage(origin, data, len) && shouldSync_)
+    {
+        channel_.processMessage(origin, data, len);
+    }
+    if (!LeaderElection::isHeartbeat(data, len) || !election_.hasLeader() || election_.isLeader() ||
+        memcmp(origin, election_.getLeader(), 6) != 0)
+    {
+        return;
+    }
+
+    // Stick with the current neighbour unless a shorter path shows up or it
+    // stops passing heartbeats on; every switch restarts the clock filter
+    uint32_t now = millis();
+    bool same = has_clock_via_ && memcmp(via, clock_via_, 6) == 0;
+    if (same || (has_clock_via_ && relays >= clock_via_relays_ && now - clock_via_seen_ms_ < SYNC_CLOCK_VIA_TIMEOUT))
+    {
+        if (same)
         {
-            esp_now_peer_info_t peerInfo = {};
-            memcpy(peerInfo.peer_addr, pair.second.mac, 6);
-            peerInfo.channel = ESPNOW_WIFI_CHANNEL;
-            peerInfo.encrypt = false;
-
-            if (!esp_now_is_peer_exist(pair.second.mac))
-            {
-                if (esp_now_add_peer(&peerInfo) == ESP_OK)
-                {
-                    Serial.print("Added peer: ");
-                    Serial.print(pair.second.userIdentifier.c_str());
-                    Serial.print(" - ");
-                    Serial.println(pair.second.deviceType.c_str());
-                }
-                else
-                {
-                    Serial.println("Failed to add peer");
-                }
-            }
+            clock_via_relays_ = relays;
+            clock_via_seen_ms_ = now;
         }
+        return;
     }
+    memcpy(clock_via_, via, 6);
+    clock_via_relays_ = relays;
+    clock_via_seen_ms_ = now;
+    has_clock_via_ = true;
+    updateClockRole();
 }
 
-void SyncController::sendUpdate(const SyncData *data)
+void SyncController::sendUpdate(const LightScene &scene)
 {
     if (shouldSync_)
     {
-        for (const auto &pair : deviceMap)
+        channel_.submit(scene);
+    }
+}
+
+bool SyncController::sendScene(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+    static const uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    if (fanout_ == SYNC_FANOUT_BROADCAST || memcmp(mac, broadcast, 6) != 0)
+    {
+        // One frame, no ACK waits; other groups drop it on the group id
+        return sendGroup(mac, data, len);
+    }
+
+    for (uint8_t i = 0; i < discovery_.getPeerCount(); i++)
+    {
+        const PeerInfo &peer = discovery_.getPeer(i);
+        // Only our own group decodes the update
+        if (peer.group_id == channel_.getGroupId())
         {
-            esp_err_t result = esp_now_send(pair.second.mac, (uint8_t *)data, sizeof(SyncData));
-            if (result == ESP_OK)
-            {
-                // Serial.println("Data sent successfully to peer");
-            }
-            else
-            {
-                // Serial.println("Error sending data to peer");
-            }
+            sendRaw(peer.mac, data, len);
         }
     }
+    return true;
+}
+
+bool SyncController::sendGroup(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+    static const uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    // A peer we hear ourselves gets a plain unicast and its MAC ACK
+    if (!relay_enabled_ || (memcmp(mac, broadcast, 6) != 0 && discovery_.findPeer(mac)))
+    {
+        return sendRaw(mac, data, len);
+    }
+    return relay_.send(mac, data, len);
 }
 
 void SyncController::onReceive(void (*callback)(const uint8_t *mac, const uint8_t *data, int len))
 {
     userCallback = callback;
 }
-void SyncController::onDataReceivedStatic(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+void SyncController::onDataSent(const uint8_t *mac, bool delivered)
 {
-    if (instance_)
+    static const uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    // Unicast status is the peer's MAC-level ACK; broadcasts always report success
+    if (schedule_enabled_ && memcmp(mac, broadcast, 6) != 0)
     {
-        instance_->onDataReceived(info, data, len);
+        schedule_.recordResult(delivered);
     }
 }
 
-void SyncController::onDataReceived(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+void SyncController::onDataReceived(const uint8_t *mac, const uint8_t *data, size_t len)
 {
+    // Timestamp first: every microsecond spent before this ends up as offset error
+    if (clock_sync_ && ClockSync::isClockSyncMessage(data, len))
+    {
+        uint64_t receivedUs = clock_->localMicros();
+        // Only registered peers (our group): answering every owner's followers
+        // fills ESP-NOW's 20-entry peer table, and their own master's replies
+        // are the only ones they should lock to
+        if (transport_->hasPeer(mac))
+        {
+            clock_sync_->handleMessage(mac, data, len, receivedUs);
+        }
+        return;
+    }
+
+    if (discovery_.handleMessage(mac, data, len))
+    {
+        return;
+    }
 
-    if (len == sizeof(SyncData) && shouldSync_)
+    if (relay_enabled_ && relay_.handleMessage(mac, data, len))
     {
-        // LightScene currentScene = light_show_.getCurrentScene();
-        SyncData receivedData;
-        memcpy(&receivedData, data, len);
-        if (strncmp(receivedData.identifier, CURRENT_USER, 2) == 0)
+        return;
+    }
+
+    handleGroupMessage(mac, data, len);
+}
+
+bool SyncController::handleGroupMessage(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+    if (election_.handleMessage(mac, data, len))
+    {
+        return true;
+    }
+
+    // Queued; applied and acknowledged from update()
+    if (SyncProtocol::isSyncMessage(data, len))
+    {
+        if (shouldSync_)
         {
-            switch (receivedData.messageType)
-            {
-            case SET_LIGHT_SCENE:
-                Serial.print("Received Brightness: ");
-                Serial.println(receivedData.scene.brightness);
-
-                setCurrentDeviceScene(receivedData.scene);
-                break;
-            }
+            channel_.handleMessage(mac, data, len);
         }
+        return true;
     }
+    return false;
 }
 
 void SyncController::setCurrentDeviceScene(LightScene scene)
@@ -157,84 +326,59 @@ void SyncController::setCurrentDeviceScene(LightScene scene)
 
 void SyncController::setBrightness(uint8_t brightness)
 {
-    SyncData syncData;
-    syncData.scene = light_show_.getCurrentScene();
-    if (sync)
-        strncpy(syncData.identifier, CURRENT_USER, 2);
-    syncData.messageType = SET_LIGHT_SCENE;
-    syncData.scene.brightness = brightness;
-    Serial.print("Local Command - Set Brightness: ");
-    Serial.println(syncData.scene.brightness);
-    this->sendUpdate(&syncData);
-    setCurrentDeviceScene(syncData.scene);
+    LightScene scene = light_show_.getCurrentScene();
+    scene.brightness = brightness;
+    BMLOG_DEBUG("SyncController", "Local Command - Set Brightness: %u", scene.brightness);
+    this->sendUpdate(scene);
+    setCurrentDeviceScene(scene);
 }
 
 void SyncController::setSpeed(uint16_t speed)
 {
-    SyncData syncData;
-    syncData.scene = light_show_.getCurrentScene();
-    syncData.scene.speed = speed;
-    Serial.print("Local Command - Set Speed: ");
-    Serial.print(speed);
-    Serial.println(syncData.scene.speed);
+    LightScene scene = light_show_.getCurrentScene();
+    scene.speed = speed;
+    BMLOG_DEBUG("SyncController", "Local Command - Set Speed: %u", scene.speed);
 
-    setCurrentDeviceScene(syncData.scene);
+    setCurrentDeviceScene(scene);
 
     // Send the update to other devices
-    strncpy(syncData.identifier, CURRENT_USER, 2);
-    syncData.messageType = SET_LIGHT_SCENE;
-    this->sendUpdate(&syncData);
+    this->sendUpdate(scene);
 }
 
 void SyncController::setPalette(AvailablePalettes palette)
 {
-    SyncData syncData;
-    syncData.scene = light_show_.getCurrentScene();
-    syncData.scene.primary_palette = palette;
-    Serial.print('setting current device palette to: ');
-    Serial.println(palette);
+    LightScene scene = light_show_.getCurrentScene();
+    scene.primary_palette = palette;
 
     // Send the update to other devices
-    strncpy(syncData.identifier, CURRENT_USER, 2);
-    syncData.messageType = SET_LIGHT_SCENE;
-    Serial.print("Local Command - Set Palette: ");
-    Serial.println(syncData.scene.primary_palette);
+    BMLOG_DEBUG("SyncController", "Local Command - Set Palette: %d", (int)scene.primary_palette);
 
-    this->sendUpdate(&syncData);
-    setCurrentDeviceScene(syncData.scene);
+    this->sendUpdate(scene);
+    setCurrentDeviceScene(scene);
 }
 
 void SyncController::positionStatus(LocationService &location_service)
 {
-    Serial.println("Position Status in SyncController");
-    Serial.print("Position Available?: ");
-    Serial.println(location_service.is_current_position_available());
 
-    SyncData syncData;
-    syncData.scene = light_show_.getCurrentScene();
-    syncData.scene.scene_id = solid;
-    syncData.scene.color = location_service.is_current_position_available() ? CRGB::Green : CRGB::Red;
+    LightScene scene = light_show_.getCurrentScene();
+    scene.scene_id = solid;
+    scene.color = location_service.is_current_position_available() ? CRGB::Green : CRGB::Red;
 
     // Send Update
-    strncpy(syncData.identifier, CURRENT_USER, 2);
-    syncData.messageType = SET_LIGHT_SCENE;
-    Serial.print("Set Position Status: ");
-    Serial.println(location_service.is_current_position_available() ? "Green" : "Red");
-    light_show_.solid(syncData.scene.color);
-    this->sendUpdate(&syncData);
+    BMLOG_DEBUG("SyncController", "Set Position Status: %s",
+                location_service.is_current_position_available() ? "Green" : "Red");
+    light_show_.solid(scene.color);
+    this->sendUpdate(scene);
 }
 
 void SyncController::speedometer(LocationService &location_service, CRGB color1, CRGB color2)
 {
-    Serial.println("Starting Speedometer Show");
-    Serial.print("Speed: ");
     float currentSpeed = location_service.current_speed();
-    Serial.println(currentSpeed);
+    BMLOG_DEBUG("SyncController", "Speedometer speed: %.2f", currentSpeed);
 
-    SyncData syncData;
-    syncData.scene = light_show_.getCurrentScene();
-    syncData.scene.scene_id = solid;
-    syncData.scene.color = CRGB::Red;
+    LightScene scene = light_show_.getCurrentScene();
+    scene.scene_id = solid;
+    scene.color = CRGB::Red;
 
     if (location_service.is_current_position_available())
     {
@@ -242,79 +386,63 @@ void SyncController::speedometer(LocationService &location_service, CRGB color1,
         float normalizedSpeed = std::min(currentSpeed, static_cast<float>(MAX_SPEED)) / MAX_SPEED;
         // Interpolate between color1 and color2 based on the normalized speed
         CRGB new_color = blend(color1, color2, static_cast<uint8_t>(normalizedSpeed * 255));
-        syncData.scene.color = new_color;
+        scene.color = new_color;
     }
 
-    strncpy(syncData.identifier, CURRENT_USER, 2);
-    syncData.messageType = SET_LIGHT_SCENE;
-    light_show_.solid(syncData.scene.color);
-    this->sendUpdate(&syncData);
+    light_show_.solid(scene.color);
+    this->sendUpdate(scene);
 }
 
 void SyncController::colorWheel(LocationService &location_service)
 {
-    Serial.println("Color Wheel in SyncController");
-    SyncData syncData;
-    syncData.scene = light_show_.getCurrentScene();
-    syncData.scene.scene_id = solid;
-    syncData.scene.color = this->getColorWheelColor(location_service);
+    LightScene scene = light_show_.getCurrentScene();
+    scene.scene_id = solid;
+    scene.color = this->getColorWheelColor(location_service);
 
     // Send Update
-    strncpy(syncData.identifier, CURRENT_USER, 2);
-    syncData.messageType = SET_LIGHT_SCENE;
-    Serial.print("Local Command - Set Color Wheel: ");
-    this->sendUpdate(&syncData);
-    light_show_.solid(syncData.scene.color);
+    BMLOG_DEBUG("SyncController", "Local Command - Set Color Wheel: %02x%02x%02x", scene.color.r, scene.color.g,
+                scene.color.b);
+    this->sendUpdate(scene);
+    light_show_.solid(scene.color);
 }
 
 void SyncController::colorRadial(LocationService &location_service, CRGB color1, CRGB color2)
 {
-    Serial.println("Color Radial in SyncController");
-    SyncData syncData;
-    syncData.scene = light_show_.getCurrentScene();
-    syncData.scene.scene_id = solid;
-    syncData.scene.color = this->getRadialColor(location_service, color1, color2);
+    LightScene scene = light_show_.getCurrentScene();
+    scene.scene_id = solid;
+    scene.color = this->getRadialColor(location_service, color1, color2);
 
     // Send Update
-    strncpy(syncData.identifier, CURRENT_USER, 2);
-    syncData.messageType = SET_LIGHT_SCENE;
-    Serial.print("Local Command - Set Color Wheel: ");
-    this->sendUpdate(&syncData);
-    light_show_.solid(syncData.scene.color);
+    BMLOG_DEBUG("SyncController", "Local Command - Set Color Radial: %02x%02x%02x", scene.color.r, scene.color.g,
+                scene.color.b);
+    this->sendUpdate(scene);
+    light_show_.solid(scene.color);
 }
 
 void SyncController::jacketDance(CRGB color)
 {
-    SyncData syncData;
-    syncData.scene = light_show_.getCurrentScene();
-    syncData.scene.scene_id = solid;
-    syncData.scene.color = color;
+    LightScene scene = light_show_.getCurrentScene();
+    scene.scene_id = solid;
+    scene.color = color;
 
     // Send Update
-    strncpy(syncData.identifier, CURRENT_USER, 2);
-    syncData.messageType = SET_LIGHT_SCENE;
-    Serial.print("Local Command - Set Jacket Dance: ");
-    this->sendUpdate(&syncData);
-    light_show_.solid(syncData.scene.color);
+    BMLOG_DEBUG("SyncController", "Local Command - Set Jacket Dance: %02x%02x%02x", color.r, color.g, color.b);
+    this->sendUpdate(scene);
+    light_show_.solid(scene.color);
 }
 
 void SyncController::handleButtonShortPress()
 {
-    LightScene currentScene = light_show_.getCurrentScene();
-    SyncData syncData;
+    LightScene scene = light_show_.getCurrentScene();
     AvailablePalettes newPalette;
 
     palette_index_ = (palette_index_ + 1) % light_show_.getPaletteCount();
     newPalette = static_cast<AvailablePalettes>(palette_index_);
-    syncData.scene = currentScene;
-    syncData.scene.primary_palette = newPalette;
+    scene.primary_palette = newPalette;
 
-    setCurrentDeviceScene(syncData.scene);
+    setCurrentDeviceScene(scene);
     // Send the update to other devices
-    strncpy(syncData.identifier, CURRENT_USER, 2);
-    syncData.currentSetting = currentSetting_;
-    syncData.messageType = SET_LIGHT_SCENE;
-    this->sendUpdate(&syncData);
+    this->sendUpdate(scene);
 }
 
 void SyncController::handleButtonLongPress()
@@ -326,69 +454,51 @@ void SyncController::handleButtonLongPress()
         currentSetting_ = PALETTE;
         break;
     }
-
-    SyncData syncData;
-    strncpy(syncData.identifier, CURRENT_USER, 2);
-    syncData.messageType = SET_LIGHT_SCENE;
-    syncData.currentSetting = currentSetting_;
-    this->sendUpdate(&syncData);
+    // The selected setting is local to this device; nothing to sync
 }
 
 void SyncController::handleDialChange(int8_t dialDirection)
 {
-    LightScene currentScene = light_show_.getCurrentScene();
-    SyncData syncData;
-    strncpy(syncData.identifier, CURRENT_USER, 2);
-    syncData.scene = currentScene;
+    LightScene scene = light_show_.getCurrentScene();
 
-    uint8_t currentBrightness = currentScene.brightness;
+    uint8_t currentBrightness = scene.brightness;
     currentBrightness = constrain(currentBrightness + (dialDirection * 5), 0, 150); // Scale from 1 to 255
 
-    Serial.print("Setting current brightness to: ");
-    Serial.println(currentBrightness);
+    BMLOG_DEBUG("SyncController", "Setting current brightness to: %u", currentBrightness);
 
-    syncData.scene.brightness = currentBrightness;
-    syncData.messageType = SET_LIGHT_SCENE;
-    setCurrentDeviceScene(syncData.scene);
-    this->sendUpdate(&syncData);
+    scene.brightness = currentBrightness;
+    setCurrentDeviceScene(scene);
+    this->sendUpdate(scene);
 }
 
 void SyncController::changeMode(LightSceneID mode)
 {
-    LightScene currentScene = light_show_.getCurrentScene();
-    SyncData syncData;
-    syncData.scene = currentScene;
-    syncData.scene.scene_id = mode;
-    strncpy(syncData.identifier, CURRENT_USER, 2);
-    syncData.messageType = SET_LIGHT_SCENE;
+    LightScene scene = light_show_.getCurrentScene();
+    scene.scene_id = mode;
     if (mode == color_wheel || mode == position_status)
     {
-        Serial.println("Changing to solid because detected either color wheel or position status");
-        syncData.scene.scene_id = solid;
+        BMLOG_DEBUG("SyncController", "Changing to solid because detected either color wheel or position status");
+        scene.scene_id = solid;
     }
     else
     {
-        setCurrentDeviceScene(syncData.scene);
+        setCurrentDeviceScene(scene);
     }
 
-    this->sendUpdate(&syncData);
+    this->sendUpdate(scene);
 }
 
 void SyncController::setDirection(bool direction)
 {
     direction_ = direction;
-    SyncData syncData;
-    syncData.scene = light_show_.getCurrentScene();
-    syncData.scene.direction = direction;
-    Serial.print('setting current device direction to: ');
-    Serial.println(direction);
+    LightScene scene = light_show_.getCurrentScene();
+    scene.direction = direction;
+    BMLOG_DEBUG("SyncController", "Setting current device direction to: %d", direction);
 
     // Send the update to other devices
-    strncpy(syncData.identifier, CURRENT_USER, 2);
-    syncData.messageType = SET_LIGHT_SCENE;
 
-    this->sendUpdate(&syncData);
-    setCurrentDeviceScene(syncData.scene);
+    this->sendUpdate(scene);
+    setCurrentDeviceScene(scene);
 }
 
 void SyncController::shouldDeviceSync(bool shouldSync)
@@ -396,6 +506,95 @@ void SyncController::shouldDeviceSync(bool shouldSync)
     shouldSync_ = shouldSync;
 }
 
+void SyncController::enableRelay(uint8_t ttl)
+{
+    relay_.setTtl(ttl);
+    relay_enabled_ = true;
+    updateClockRole();
+    BMLOG_INFO("SyncController", "Mesh relay enabled, up to %u hops", ttl + 1);
+}
+
+void SyncController::enableRadioSchedule(RadioSchedule::BleSlotFunction ble_slot)
+{
+    schedule_.setSendFunction([this](const uint8_t *mac, const uint8_t *data, size_t len)
+                              { return transport_->send(mac, data, len); });
+    schedule_.onBleSlot(ble_slot);
+    schedule_enabled_ = true;
+    BMLOG_INFO("SyncController", "Radio schedule enabled, ESP-NOW gets %u%% of every %u ms", schedule_.getShare(),
+               RADIO_SCHEDULE_PERIOD_MS);
+}
+
+void SyncController::enableClockSync(Clock &clock, bool isTimeMaster)
+{
+    if (!clock_sync_)
+    {
+        clock_ = &clock;
+        clock_sync_ = new ClockSync(clock);
+        // Never queued by the radio schedule: a timestamp that waits is wrong
+        clock_sync_->setSendFunction([this](const uint8_t *mac, const uint8_t *data, size_t len)
+                                     { return transport_->send(mac, data, len); });
+    }
+    setTimeMaster(isTimeMaster);
+    updateClockRole();
+}
+
+void SyncController::setTimeMaster(bool isTimeMaster)
+{
+    // A preferred prop takes over leadership, and with it the clock, from any other
+    election_.setPriority(isTimeMaster ? 1 : 0);
+    BMLOG_INFO("SyncController", "Clock sync: %s", isTimeMaster ? "preferred time master" : "following the group leader");
+}
+
+bool SyncController::isClockSynced() const
+{
+    return clock_sync_ && (clock_sync_->isMaster() || clock_sync_->isLocked());
+}
+
+const ClockSyncStats *SyncController::getClockSyncStats() const
+{
+    return clock_sync_ ? &clock_sync_->getStats() : nullptr;
+}
+
+void SyncController::update()
+{
+    // Polled transports hand up what arrived since the last loop first
+    transport_->update();
+    if (schedule_enabled_)
+    {
+        schedule_.update(clock_ ? clock_->nowMicros() : (uint64_t)micros());
+    }
+    discovery_.update();
+    if (relay_enabled_)
+    {
+        relay_.update();
+    }
+    election_.update();
+    channel_.update();
+    // Requests go out in the ESP-NOW slot, so the answers come back in it too
+    if (clock_sync_ && (!schedule_enabled_ || schedule_.isEspNowSlot()))
+    {
+        bool wasLocked = clock_sync_->isLocked();
+        clock_sync_->update();
+        if (!wasLocked && clock_sync_->isLocked())
+        {
+            const ClockSyncStats &stats = clock_sync_->getStats();
+            BMLOG_INFO("SyncController", "Clock sync locked: offset %lld us, delay %lu us",
+                       (long long)stats.offset_us, (unsigned long)stats.delay_us);
+        }
+    }
+    // Everything sent above shares as few datagrams as the transport allows
+    transport_->flush();
+}
+
+bool SyncController::sendRaw(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+    if (schedule_enabled_)
+    {
+        return schedule_.send(mac, data, len);
+    }
+    return transport_->send(mac, data, len);
+}
+
 CRGB SyncController::getColorWheelColor(LocationService &location_service)
 {
     if (location_service.is_current_position_available())
@@ -421,7 +620,7 @@ CRGB SyncController::getColorWheelColor(LocationService &location_service)
     else
     {
         // If the position is not available, return red
-        Serial.println("Position not available");
+        BMLOG_DEBUG("SyncController", "Position not available");
         return CRGB::Red;
     }
 }
@@ -13,6 +13,16 @@
 #include <map>
 #include <LocationService.h>
 #include <Position.h>
+#include <Clock.h>
+#include <ClockSync.h>
+#include <SyncProtocol.h>
+#include <SyncChannel.h>
+#include <PeerDiscovery.h>
+#include <LeaderElection.h>
+#include <MeshRelay.h>
+#include <SyncTransport.h>
+#include <EspNowTransport.h>
+#include <RadioSchedule.h>
 
 #define DEFAULT_ORIGIN_LATITUDE 40.786331
 #define DEFAULT_ORIGIN_LONGITUDE -119.206489
@@ -24,14 +34,7 @@
 #define DEFAULT_POSITION_STATUS_POLL_INTERVAL 5000
 #define MAX_SPEED 25.0
 #define LINEAR_SPECTRUM_MAX_HUE 191
-
-enum MessageType : uint8_t
-{
-    MODE_CHANGE,
-    PALETTE_CHANGE,
-    BRIGHTNESS_CHANGE,
-    SET_LIGHT_SCENE
-};
+#define SYNC_CLOCK_VIA_TIMEOUT 4000 // ms the leader's heartbeats may come through others before clock sync moves
 
 enum SettingType
 {
@@ -39,21 +42,59 @@ enum SettingType
     MODE,
 };
 
-struct SyncData
+// How scene updates reach the group. Broadcast is one frame for everyone
+// (receivers filter on the group id); unicast sends one acknowledged frame
+// per discovered group peer and is only worth it for a handful of devices.
+enum SyncFanout : uint8_t
 {
-    char identifier[2]; // Identifier for the devices, e.g., "CL"
-    LightScene scene;   // The scene to be synchronized
-    MessageType messageType;
-    SettingType currentSetting;
+    SYNC_FANOUT_BROADCAST,
+    SYNC_FANOUT_UNICAST
 };
+
 class SyncController
 {
 public:
     SyncController(LightShow &light_show, const std::string &userIdentifier, Device &deviceType);
+    // Peers are found by beacon (see PeerDiscovery); an empty identifier
+    // registers every discovered device, otherwise only that user's props
     void begin(const std::string &userIdentifier);
+    // ESP-NOW unless another transport (e.g. UdpMulticastTransport on a camp
+    // network) is set before begin(). Every prop in a group must use the same.
+    void setTransport(SyncTransport &transport) { transport_ = &transport; }
+    SyncTransport &getTransport() { return *transport_; }
     void addPeers(const std::string &userIdentifier);
-    void sendUpdate(const SyncData *data);
+    const PeerDiscovery &getPeerDiscovery() const { return discovery_; }
+    const SyncChannel &getSyncChannel() const { return channel_; }
+    // One prop per group leads (see LeaderElection): it is the time master,
+    // and the other props' scene changes go through it
+    const LeaderElection &getLeaderElection() const { return election_; }
+    bool isLeader() const { return election_.isLeader(); }
+    // Off by default. Scene updates, acks and leader heartbeats are flooded
+    // through the group (see MeshRelay), so props out of radio range of the
+    // sender still get them as long as a chain of group members connects
+    // them. Every prop that should relay must enable it. Discovery stays one
+    // hop, and so does each clock sync exchange: a prop out of the leader's
+    // range syncs to the neighbour the leader's heartbeats reach it through,
+    // which answers with the time it is locked to.
+    void enableRelay(uint8_t ttl = MESH_RELAY_DEFAULT_TTL);
+    bool isRelayEnabled() const { return relay_enabled_; }
+    const MeshRelay &getMeshRelay() const { return relay_; }
+    // Off by default. For props that also run BLE: sync frames only go out in
+    // the ESP-NOW slot of every period (see RadioSchedule), lined up with the
+    // group's clock once it is synced, and ble_slot is called as the BLE slot
+    // opens and closes, to advertise and notify only then.
+    void enableRadioSchedule(RadioSchedule::BleSlotFunction ble_slot);
+    bool isRadioScheduleEnabled() const { return schedule_enabled_; }
+    const RadioSchedule &getRadioSchedule() const { return schedule_; }
+    // Shares the scene with the group. Only changed fields are sent, at most
+    // every SYNC_COALESCE_MS, and resent from update() until every group peer
+    // has acknowledged them (see SyncChannel).
+    void sendUpdate(const LightScene &scene);
+    void setFanout(SyncFanout fanout) { fanout_ = fanout; }
     void onReceive(void (*callback)(const uint8_t *mac, const uint8_t *data, int len));
+    // ESP-NOW callbacks carry no context, so they go to the controller
+    // constructed last. Host simulations running several switch it per device.
+    void makeCallbackTarget() { espnow_.makeCallbackTarget(); }
     void readMacAddress();
     void handleButtonShortPress();
     void handleButtonLongPress();
@@ -65,6 +106,17 @@ public:
     void changeMode(LightSceneID mode);
     void handleDialTurn(int8_t direction);
     void shouldDeviceSync(bool shouldSync);
+    // Clock sync: the group's leader answers time requests, everyone else
+    // follows it. isTimeMaster makes this prop the preferred leader (e.g. a
+    // fixed installation); otherwise the election picks one.
+    // update() must be called from loop(); it also applies and acknowledges
+    // received scenes, sends discovery beacons and heartbeats and resends
+    // unacknowledged scene updates.
+    void enableClockSync(Clock &clock, bool isTimeMaster);
+    void setTimeMaster(bool isTimeMaster);
+    bool isClockSynced() const;
+    const ClockSyncStats *getClockSyncStats() const;
+    void update();
     // Backpack specific function
     void positionStatus(LocationService &location_service);
     void colorWheel(LocationService &location_service);
@@ -76,13 +128,22 @@ public:
     void setRadiusOuter(unsigned int radius_outer);
 
 private:
-    static SyncController *instance_;
-    static void onDataReceivedStatic(const esp_now_recv_info_t *info, const uint8_t *data, int len);
-    void onDataReceived(const esp_now_recv_info_t *info, const uint8_t *data, int len);
+    void onDataSent(const uint8_t *mac, bool delivered);
+    void onDataReceived(const uint8_t *mac, const uint8_t *data, size_t len);
+    bool handleGroupMessage(const uint8_t *mac, const uint8_t *data, size_t len);
+    void onRelayed(const uint8_t *origin, const uint8_t *data, size_t len, const uint8_t *via, uint8_t relays);
+    void onPeerAdded(const PeerInfo &peer);
+    void onPeerRemoved(const PeerInfo &peer);
+    void onLeaderChanged(const uint8_t *leader);
+    void updateClockRole();
+    bool matchesPeerFilter(const PeerInfo &peer) const;
     static void (*userCallback)(const uint8_t *mac, const uint8_t *data, int len);
     void setCurrentDeviceScene(LightScene scene);
+    bool sendRaw(const uint8_t *mac, const uint8_t *data, size_t len);
+    bool sendScene(const uint8_t *mac, const uint8_t *data, size_t len);
+    bool sendGroup(const uint8_t *mac, const uint8_t *data, size_t len);
     SettingType currentSetting_;
-    uint8_t broadcastAddress[6];
+    uint8_t device_type_;
     LightShow &light_show_;
     uint8_t brightness_;
     uint16_t speed_;
@@ -94,6 +155,25 @@ private:
     Position origin_;
     unsigned int radius_inner_;
     unsigned int radius_outer_;
+    EspNowTransport espnow_;
+    SyncTransport *transport_;
+    ClockSync *clock_sync_;
+    Clock *clock_;
+    SyncChannel channel_;
+    SyncFanout fanout_;
+    PeerDiscovery discovery_;
+    LeaderElection election_;
+    MeshRelay relay_;
+    bool relay_enabled_;
+    RadioSchedule schedule_;
+    bool schedule_enabled_;
+    // Neighbour on the shortest path the leader's heartbeats take to us;
+    // clock sync goes through it
+    uint8_t clock_via_[6];
+    uint8_t clock_via_relays_;
+    uint32_t clock_via_seen_ms_;
+    bool has_clock_via_;
+    uint16_t peer_group_; // 0 accepts every group
 };
 
 #endif // SYNC_CONTROLLER_H
@@ -1,5 +1,6 @@
 #include "WebServer.h"
 #include "StringUtils.h"
+#include <BMLog.h>
 
 WebServer::WebServer(uint16_t port, ControlCenter& control_center) :
     http_server_(WiFiServer(port)),
@@ -105,7 +106,7 @@ void WebServer::write_command_center_html_(WiFiClient& client)
     while (bytes_remaining > 0) {
         size_t chunk_size = std::min(bytes_remaining, max_chunk_size);
         size_t bytes = client.write(position, chunk_size);
-        Serial.println(bytes);
+        BMLOG_VERBOSE("WebServer", "Wrote %u bytes", (unsigned)bytes);
         position += chunk_size;
         bytes_remaining -= chunk_size;
     }
@@ -0,0 +1,405 @@
+#include "BMLog.h"
+#include <Arduino.h>
+#include <stdio.h>
+
+static_assert((BMLOG_SLOTS & (BMLOG_SLOTS - 1)) == 0, "BMLOG_SLOTS must be a power of two");
+
+// Static, so zero-initialized before any constructor can log
+BMLog::Slot BMLog::slots_[BMLOG_SLOTS];
+static std::atomic<uint32_t> enqueue_pos_;
+static std::atomic<uint32_t> dequeue_pos_;
+static std::atomic<uint32_t> dropped_;
+static std::atomic<uint32_t> dropped_reported_;
+static std::atomic<uint32_t> truncated_;
+static std::atomic<uint32_t> printed_;
+static std::atomic<uint32_t> written_base_;
+static BMLog::Sink sink_ = nullptr;
+
+namespace
+{
+
+struct Arg
+{
+    uint8_t type;
+    union
+    {
+        int64_t i;
+        uint64_t u;
+        double d;
+    };
+    const char *str;
+};
+
+bool nextArg(const uint8_t *args, size_t length, size_t &offset, Arg &arg)
+{
+    if (offset >= length)
+    {
+        return false;
+    }
+    arg.type = args[offset++];
+    arg.str = nullptr;
+    switch (arg.type)
+    {
+    case BMLog::ARG_INT32:
+    {
+        int32_t value;
+        memcpy(&value, args + offset, sizeof(value));
+        arg.i = value;
+        offset += sizeof(value);
+        return true;
+    }
+    case BMLog::ARG_UINT32:
+    {
+        uint32_t value;
+        memcpy(&value, args + offset, sizeof(value));
+        arg.u = value;
+        offset += sizeof(value);
+        return true;
+    }
+    case BMLog::ARG_INT64:
+    case BMLog::ARG_UINT64:
+    case BMLog::ARG_POINTER:
+        memcpy(&arg.u, args + offset, sizeof(arg.u));
+        offset += sizeof(arg.u);
+        return true;
+    case BMLog::ARG_DOUBLE:
+        memcpy(&arg.d, args + offset, sizeof(arg.d));
+        offset += sizeof(arg.d);
+        return true;
+    case BMLog::ARG_STRING:
+        arg.str = (const char *)args + offset;
+        offset += strlen(arg.str) + 1;
+        return true;
+    default:
+        offset = length;
+        return false;
+    }
+}
+
+bool isSigned(const Arg &arg) { return arg.type == BMLog::ARG_INT32 || arg.type == BMLog::ARG_INT64; }
+
+long long asSigned(const Arg &arg)
+{
+    return arg.type == BMLog::ARG_DOUBLE ? (long long)arg.d : (long long)arg.i;
+}
+
+unsigned long long asUnsigned(const Arg &arg)
+{
+    return arg.type == BMLog::ARG_DOUBLE ? (unsigned long long)arg.d : (unsigned long long)arg.u;
+}
+
+double asDouble(const Arg &arg)
+{
+    if (arg.type == BMLog::ARG_DOUBLE)
+    {
+        return arg.d;
+    }
+    return isSigned(arg) ? (double)arg.i : (double)arg.u;
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+void printTask(void *)
+{
+    for (;;)
+    {
+        if (BMLog::drain(BMLOG_SLOTS) == 0)
+        {
+            delay(BMLOG_DRAIN_MS);
+        }
+    }
+}
+#endif
+
+} // namespace
+
+void BMLog::Writer::addString(const char *value)
+{
+    if (!value)
+    {
+        value = "(null)";
+    }
+    if (length + 2 > capacity)
+    {
+        truncated = true;
+        return;
+    }
+    size_t len = strlen(value);
+    size_t room = capacity - length - 2;
+    if (len > room)
+    {
+        len = room;
+        truncated = true;
+    }
+    out[length++] = ARG_STRING;
+    memcpy(out + length, value, len);
+    length += len;
+    out[length++] = '\0';
+}
+
+BMLog::Slot *BMLog::reserve()
+{
+    uint32_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        uint32_t index = pos & (BMLOG_SLOTS - 1);
+        Slot *slot = &slots_[index];
+        int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire) + index - pos);
+        if (diff == 0)
+        {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                return slot;
+            }
+        }
+        else if (diff < 0)
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        else
+        {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void BMLog::publish(Slot *slot)
+{
+    slot->sequence.store(slot->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void BMLog::begin()
+{
+#if defined(ARDUINO_ARCH_ESP32)
+    static std::atomic<bool> started_;
+    if (started_.exchange(true))
+    {
+        return;
+    }
+    if (xTaskCreate(printTask, "bmlog", BMLOG_TASK_STACK, nullptr, BMLOG_TASK_PRIORITY, nullptr) != pdPASS)
+    {
+        started_ = false;
+        Serial.println("[BMLog] Failed to create print task, logs stay queued");
+    }
+#endif
+}
+
+void BMLog::setSink(Sink sink)
+{
+    sink_ = sink;
+}
+
+size_t BMLog::drain(size_t max_messages)
+{
+    char line[BMLOG_LINE];
+    size_t drained = 0;
+    uint32_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    while (drained < max_messages)
+    {
+        uint32_t index = pos & (BMLOG_SLOTS - 1);
+        Slot *slot = &slots_[index];
+        int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire) + index - (pos + 1));
+        if (diff < 0)
+        {
+            break;                  // Empty, or the next message is still being written
+        }
+        if (diff > 0 || !dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+            pos = dequeue_pos_.load(std::memory_order_relaxed);
+            continue;
+        }
+
+        size_t len = 0;
+        if (slot->tag[0])
+        {
+            len = snprintf(line, sizeof(line), "[%s] ", slot->tag);
+        }
+        len += format(line + len, sizeof(line) - len - 1, slot->format, slot->args, slot->length);
+        bool truncated = slot->truncated;
+        // Free the slot before the slow part
+        slot->sequence.store(pos + BMLOG_SLOTS - index, std::memory_order_release);
+        pos++;
+
+        if (truncated)
+        {
+            truncated_.fetch_add(1, std::memory_order_relaxed);
+        }
+        line[len++] = '\n';
+        line[len] = '\0';
+        print(line, len);
+        printed_.fetch_add(1, std::memory_order_relaxed);
+        drained++;
+    }
+
+    uint32_t dropped = dropped_.load(std::memory_order_relaxed);
+    uint32_t reported = dropped_reported_.exchange(dropped, std::memory_order_relaxed);
+    if (dropped != reported)
+    {
+        int len = snprintf(line, sizeof(line), "[BMLog] %u messages dropped\n", (unsigned)(dropped - reported));
+        print(line, len);
+    }
+    return drained;
+}
+
+BMLogStats BMLog::getStats()
+{
+    BMLogStats stats;
+    stats.written = enqueue_pos_.load(std::memory_order_relaxed) - written_base_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.truncated = truncated_.load(std::memory_order_relaxed);
+    stats.printed = printed_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void BMLog::resetStats()
+{
+    written_base_ = enqueue_pos_.load();
+    dropped_ = 0;
+    dropped_reported_ = 0;
+    truncated_ = 0;
+    printed_ = 0;
+}
+
+void BMLog::print(const char *line, size_t len)
+{
+    if (sink_)
+    {
+        sink_(line, len);
+    }
+    else
+    {
+        Serial.print(line);
+    }
+}
+
+// Walks the format, printing each conversion with the argument stored for it.
+// Length modifiers are replaced to fit how the argument was stored, so %d
+// with an int64 or %lu with a 32-bit unsigned long both print the value.
+size_t BMLog::format(char *out, size_t capacity, const char *format, const uint8_t *args, size_t length)
+{
+    size_t len = 0;
+    size_t offset = 0;
+    if (capacity == 0)
+    {
+        return 0;
+    }
+    out[0] = '\0';
+
+    for (const char *p = format; *p && len + 1 < capacity; p++)
+    {
+        if (*p != '%')
+        {
+            out[len++] = *p;
+            continue;
+        }
+        if (p[1] == '%')
+        {
+            out[len++] = '%';
+            p++;
+            continue;
+        }
+
+        // %[flags][width][.precision][length]conversion
+        char spec[48];
+        size_t spec_len = 0;
+        spec[spec_len++] = '%';
+        p++;
+        while (*p && strchr("-+ #0", *p) && spec_len < 8)
+        {
+            spec[spec_len++] = *p++;
+        }
+        Arg arg;
+        if (*p == '*')
+        {
+            int width = nextArg(args, length, offset, arg) ? (int)asSigned(arg) : 0;
+            spec_len += snprintf(spec + spec_len, 12, "%d", width);
+            p++;
+        }
+        while (*p >= '0' && *p <= '9' && spec_len < 24)
+        {
+            spec[spec_len++] = *p++;
+        }
+        if (*p == '.')
+        {
+            spec[spec_len++] = *p++;
+            if (*p == '*')
+            {
+                int precision = nextArg(args, length, offset, arg) ? (int)asSigned(arg) : 0;
+                spec_len += snprintf(spec + spec_len, 12, "%d", precision);
+                p++;
+            }
+            while (*p >= '0' && *p <= '9' && spec_len < 40)
+            {
+                spec[spec_len++] = *p++;
+            }
+        }
+        while (*p && strchr("hlzjtLq", *p))
+        {
+            p++;
+        }
+        char conversion = *p;
+        if (!conversion)
+        {
+            break;
+        }
+
+        size_t room = capacity - len;
+        int written = 0;
+        if (!nextArg(args, length, offset, arg))
+        {
+            written = snprintf(out + len, room, "?");
+        }
+        else if (strchr("diouxX", conversion))
+        {
+            spec[spec_len++] = 'l';
+            spec[spec_len++] = 'l';
+            spec[spec_len++] = conversion;
+            spec[spec_len] = '\0';
+            if (arg.type == ARG_STRING)
+            {
+                written = snprintf(out + len, room, "?");
+            }
+            else if (conversion == 'd' || conversion == 'i')
+            {
+                written = snprintf(out + len, room, spec, asSigned(arg));
+            }
+            else
+            {
+                written = snprintf(out + len, room, spec, asUnsigned(arg));
+            }
+        }
+        else if (strchr("fFeEgGaA", conversion))
+        {
+            spec[spec_len++] = conversion;
+            spec[spec_len] = '\0';
+            written = arg.type == ARG_STRING ? snprintf(out + len, room, "?")
+                                             : snprintf(out + len, room, spec, asDouble(arg));
+        }
+        else if (conversion == 'c')
+        {
+            spec[spec_len++] = 'c';
+            spec[spec_len] = '\0';
+            written = snprintf(out + len, room, spec, arg.type == ARG_STRING ? '?' : (int)asSigned(arg));
+        }
+        else if (conversion == 's')
+        {
+            spec[spec_len++] = 's';
+            spec[spec_len] = '\0';
+            written = snprintf(out + len, room, spec, arg.type == ARG_STRING ? arg.str : "?");
+        }
+        else if (conversion == 'p')
+        {
+            written = snprintf(out + len, room, "%p", (void *)(uintptr_t)arg.u);
+        }
+        else
+        {
+            written = snprintf(out + len, room, "?");
+        }
+        if (written > 0)
+        {
+            len += (size_t)written < room ? (size_t)written : room - 1;
+        }
+    }
+    out[len] = '\0';
+    return len;
+}
@@ -0,0 +1,211 @@
+#ifndef BMLOG_H
+#define BMLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+#define BMLOG_LEVEL_NONE 0
+#define BMLOG_LEVEL_ERROR 1
+#define BMLOG_LEVEL_WARN 2
+#define BMLOG_LEVEL_INFO 3
+#define BMLOG_LEVEL_DEBUG 4
+#define BMLOG_LEVEL_VERBOSE 5
+
+// Messages above this level are compiled out; set it with a build flag
+// (-DBMLOG_LEVEL=BMLOG_LEVEL_DEBUG) to see per-message and per-frame logs
+#ifndef BMLOG_LEVEL
+#define BMLOG_LEVEL BMLOG_LEVEL_INFO
+#endif
+
+#ifndef BMLOG_SLOTS
+#define BMLOG_SLOTS 32              // Messages waiting to be printed; a power of two
+#endif
+#ifndef BMLOG_SLOT_SIZE
+#define BMLOG_SLOT_SIZE 128         // Bytes per message, arguments included
+#endif
+#define BMLOG_LINE 256              // Longest line printed, the rest is cut
+#define BMLOG_DRAIN_MS 10           // Drain task's sleep when there is nothing to print
+#define BMLOG_TASK_PRIORITY 1       // Just above idle
+#define BMLOG_TASK_STACK 3072
+
+// Asynchronous logging.
+//
+//   BMLOG_INFO("BMDevice", "Brightness set to %d", brightness);
+//
+// prints "[BMDevice] Brightness set to 42" and a newline. The call only
+// copies the format pointer and the arguments into a slot of a lock-free
+// ring; a low-priority task started by begin() formats and prints them, so
+// a slow serial port stalls that task instead of the caller. Strings are
+// copied, so passing String::c_str() of a temporary is fine; the tag and
+// format must be literals. When the ring is full the message is dropped and
+// counted, and the drain task reports how many were lost.
+//
+// Levels above BMLOG_LEVEL expand to nothing: neither the arguments nor the
+// call are compiled in. The format is still checked against the arguments.
+#define BMLOG_WRITE(level, tag, format, ...)                                    \
+    do {                                                                        \
+        if (0) BMLog::check("" format, ##__VA_ARGS__);                          \
+        BMLog::write(level, "" tag, "" format, ##__VA_ARGS__);                  \
+    } while (0)
+#define BMLOG_STRIPPED(format, ...)                                             \
+    do {                                                                        \
+        if (0) BMLog::check("" format, ##__VA_ARGS__);                          \
+    } while (0)
+
+#if BMLOG_LEVEL >= BMLOG_LEVEL_ERROR
+#define BMLOG_ERROR(tag, format, ...) BMLOG_WRITE(BMLOG_LEVEL_ERROR, tag, format, ##__VA_ARGS__)
+#else
+#define BMLOG_ERROR(tag, format, ...) BMLOG_STRIPPED(format, ##__VA_ARGS__)
+#endif
+#if BMLOG_LEVEL >= BMLOG_LEVEL_WARN
+#define BMLOG_WARN(tag, format, ...) BMLOG_WRITE(BMLOG_LEVEL_WARN, tag, format, ##__VA_ARGS__)
+#else
+#define BMLOG_WARN(tag, format, ...) BMLOG_STRIPPED(format, ##__VA_ARGS__)
+#endif
+#if BMLOG_LEVEL >= BMLOG_LEVEL_INFO
+#define BMLOG_INFO(tag, format, ...) BMLOG_WRITE(BMLOG_LEVEL_INFO, tag, format, ##__VA_ARGS__)
+#else
+#define BMLOG_INFO(tag, format, ...) BMLOG_STRIPPED(format, ##__VA_ARGS__)
+#endif
+#if BMLOG_LEVEL >= BMLOG_LEVEL_DEBUG
+#define BMLOG_DEBUG(tag, format, ...) BMLOG_WRITE(BMLOG_LEVEL_DEBUG, tag, format, ##__VA_ARGS__)
+#else
+#define BMLOG_DEBUG(tag, format, ...) BMLOG_STRIPPED(format, ##__VA_ARGS__)
+#endif
+#if BMLOG_LEVEL >= BMLOG_LEVEL_VERBOSE
+#define BMLOG_VERBOSE(tag, format, ...) BMLOG_WRITE(BMLOG_LEVEL_VERBOSE, tag, format, ##__VA_ARGS__)
+#else
+#define BMLOG_VERBOSE(tag, format, ...) BMLOG_STRIPPED(format, ##__VA_ARGS__)
+#endif
+
+struct BMLogStats
+{
+    uint32_t written;           // Messages queued
+    uint32_t dropped;           // Messages lost to a full ring
+    uint32_t truncated;         // Messages whose arguments didn't fit their slot
+    uint32_t printed;
+};
+
+class BMLog
+{
+public:
+    // Where drained lines go: NUL-terminated, newline included. Serial by default.
+    typedef void (*Sink)(const char *line, size_t len);
+
+    // Starts the drain task (ESP32); safe to call more than once. Elsewhere
+    // nothing drains until drain() or flush() is called.
+    static void begin();
+    static void setSink(Sink sink);
+
+    // Prints up to max_messages queued messages on the calling task
+    static size_t drain(size_t max_messages = (size_t)-1);
+    // Prints everything queued, e.g. before a restart
+    static void flush() { drain(); }
+
+    static BMLogStats getStats();
+    static void resetStats();
+
+    // Use the BMLOG_* macros rather than these
+    template <typename... Args>
+    static void write(uint8_t level, const char *tag, const char *format, const Args &...args)
+    {
+        Slot *slot = reserve();
+        if (!slot)
+        {
+            return;
+        }
+        slot->level = level;
+        slot->tag = tag;
+        slot->format = format;
+        Writer writer(slot->args, sizeof(slot->args));
+        int expand[] = {0, (writer.add(args), 0)...};
+        (void)expand;
+        slot->length = (uint8_t)writer.length;
+        slot->truncated = writer.truncated;
+        publish(slot);
+    }
+
+    __attribute__((format(printf, 1, 2))) static void check(const char *, ...) {}
+
+    // Formats a slot's arguments against its format; public for the host benchmark
+    static size_t format(char *out, size_t capacity, const char *format, const uint8_t *args, size_t length);
+
+    enum ArgType : uint8_t
+    {
+        ARG_INT32,
+        ARG_UINT32,
+        ARG_INT64,
+        ARG_UINT64,
+        ARG_DOUBLE,
+        ARG_POINTER,
+        ARG_STRING              // Followed by the characters and a NUL
+    };
+
+    // Packs arguments by type; what doesn't fit is left out and the slot marked
+    struct Writer
+    {
+        Writer(uint8_t *out, size_t capacity) : out(out), capacity(capacity), length(0), truncated(false) {}
+
+        template <typename T>
+        typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type add(const T &value)
+        {
+            if (sizeof(T) > 4)
+            {
+                std::is_signed<T>::value ? put(ARG_INT64, (int64_t)value) : put(ARG_UINT64, (uint64_t)value);
+            }
+            else
+            {
+                std::is_signed<T>::value ? put(ARG_INT32, (int32_t)value) : put(ARG_UINT32, (uint32_t)value);
+            }
+        }
+        void add(float value) { put(ARG_DOUBLE, (double)value); }
+        void add(double value) { put(ARG_DOUBLE, value); }
+        void add(const char *value) { addString(value); }
+        void add(char *value) { addString(value); }
+        void add(const void *value) { put(ARG_POINTER, (uint64_t)(uintptr_t)value); }
+
+        template <typename T>
+        void put(ArgType type, T value)
+        {
+            if (length + 1 + sizeof(T) > capacity)
+            {
+                truncated = true;
+                return;
+            }
+            out[length++] = type;
+            memcpy(out + length, &value, sizeof(T));
+            length += sizeof(T);
+        }
+        void addString(const char *value);
+
+        uint8_t *out;
+        size_t capacity;
+        size_t length;
+        bool truncated;
+    };
+
+private:
+    // A bounded MPMC queue (Vyukov's): a slot's sequence says whether it is
+    // free for the producer at that position or filled for the consumer
+    struct Slot
+    {
+        std::atomic<uint32_t> sequence;     // Less the slot's index, so zero-initialized is empty
+        const char *tag;
+        const char *format;
+        uint8_t level;
+        uint8_t length;
+        bool truncated;
+        uint8_t args[BMLOG_SLOT_SIZE - 3 - 2 * sizeof(const char *) - sizeof(std::atomic<uint32_t>)];
+    };
+
+    static Slot slots_[BMLOG_SLOTS];
+
+    static Slot *reserve();
+    static void publish(Slot *slot);
+    static void print(const char *line, size_t len);
+};
+
+#endif // BMLOG_H
@@ -1,15 +1,78 @@
 #include <Arduino.h>
 #include "Clock.h"
 
-Clock::Clock() : offset_(0),
-                 initial_reference_time_(0),
-                 initial_local_time_(0)
+#if defined(ARDUINO_ARCH_ESP32)
+#include <esp_timer.h>
+#endif
+
+Clock::Clock() : initial_reference_time_(0),
+                 initial_local_time_(0),
+                 anchor_local_us_(0),
+                 offset_us_(0),
+                 drift_(0),
+                 slew_us_(0),
+                 last_micros_(0),
+                 micros_high_(0)
 {
 }
 
 unsigned long Clock::now() const
 {
-    return millis() + offset_;
+    return (unsigned long)(nowMicros() / 1000);
+}
+
+uint64_t Clock::localMicros() const
+{
+#if defined(ARDUINO_ARCH_ESP32)
+    // Same 64-bit timer millis()/micros() are derived from, safe from any task
+    return (uint64_t)esp_timer_get_time();
+#else
+    uint32_t current = micros();
+    if (current < last_micros_)
+    {
+        micros_high_ += 1ULL << 32;
+    }
+    last_micros_ = current;
+    return micros_high_ | current;
+#endif
+}
+
+uint64_t Clock::toSynced(uint64_t localUs) const
+{
+    int64_t elapsed = (int64_t)(localUs - anchor_local_us_);
+    int64_t synced = (int64_t)localUs + offset_us_ + (int64_t)(drift_ * elapsed);
+
+    if (slew_us_ != 0 && elapsed > 0)
+    {
+        int64_t slewed = (int64_t)(elapsed * CLOCK_SLEW_RATE);
+        if (slew_us_ > 0)
+        {
+            synced += slewed < slew_us_ ? slewed : slew_us_;
+        }
+        else
+        {
+            synced -= slewed < -slew_us_ ? slewed : -slew_us_;
+        }
+    }
+    return (uint64_t)synced;
+}
+
+uint64_t Clock::nowMicros() const
+{
+    return toSynced(localMicros());
+}
+
+void Clock::discipline(uint64_t anchorLocalUs, int64_t offsetUs, double drift, int64_t slewUs)
+{
+    anchor_local_us_ = anchorLocalUs;
+    offset_us_ = offsetUs;
+    drift_ = drift;
+    slew_us_ = slewUs;
+}
+
+void Clock::resetDiscipline()
+{
+    discipline(0, 0, 0);
 }
 
 void Clock::synchronize(const TimeReference &time_reference)
@@ -23,7 +86,7 @@ void Clock::synchronize(const TimeReference &time_reference)
         return;
     }
 
-    unsigned long reference_diff = time_reference.timestamp - initial_reference_time_;
-    unsigned long local_diff = now - initial_local_time_;
-    offset_ = reference_diff - local_diff;
+    long reference_diff = time_reference.timestamp - initial_reference_time_;
+    long local_diff = now - initial_local_time_;
+    discipline(localMicros(), (int64_t)(reference_diff - local_diff) * 1000, 0);
 }
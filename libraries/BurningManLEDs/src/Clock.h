@@ -1,20 +1,56 @@
 #ifndef CLOCK_H
 #define CLOCK_H
 
+#include <stdint.h>
+
 struct TimeReference {
     uint32_t timestamp;
 };
 
+#define CLOCK_SLEW_RATE 0.001  // Slewed corrections run the clock at most 0.1% fast/slow
+
+// Shared show clock.
+//
+// Local time is the free-running microsecond counter. Synced time is
+//   local + offset + drift * (local - anchor) + slew progress
+// where offset/drift come from ClockSync (or the legacy one-shot
+// synchronize()), so now() keeps tracking the time master between exchanges
+// instead of wandering off at the crystal's tolerance (~20-40ppm). A slew is
+// applied gradually at CLOCK_SLEW_RATE and then stops, so small corrections
+// never make show time jump (or run backward).
 class Clock {
 public:
     Clock();
     unsigned long now() const;
     void synchronize(const TimeReference& time_reference);
 
+    // Synced time in microseconds
+    uint64_t nowMicros() const;
+    // Free-running local time in microseconds (never adjusted)
+    uint64_t localMicros() const;
+    // Convert a local timestamp to synced time
+    uint64_t toSynced(uint64_t localUs) const;
+
+    // Set the correction model, optionally with slewUs still to be worked in
+    void discipline(uint64_t anchorLocalUs, int64_t offsetUs, double drift, int64_t slewUs = 0);
+    void resetDiscipline();
+
+    int64_t getOffsetMicros() const { return offset_us_; }
+    double getDrift() const { return drift_; }
+
 private:
-    long offset_;
     unsigned long initial_reference_time_;
     unsigned long initial_local_time_;
+
+    // Correction model
+    uint64_t anchor_local_us_;
+    int64_t offset_us_;
+    double drift_;
+    int64_t slew_us_;
+
+    // Off ESP32, micros() wraps every ~71 minutes; extend it to 64 bits
+    mutable uint32_t last_micros_;
+    mutable uint64_t micros_high_;
 };
 
 #endif // CLOCK_H
@@ -0,0 +1,382 @@
+#include "ClockSync.h"
+#include <string.h>
+
+static const uint8_t BROADCAST_ADDRESS[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+// Insertion sort; the arrays here hold at most CLOCK_SYNC_SAMPLE_COUNT values
+template <typename T>
+static void sortSmall(T *values, size_t count)
+{
+    for (size_t i = 1; i < count; i++)
+    {
+        T value = values[i];
+        size_t j = i;
+        while (j > 0 && values[j - 1] > value)
+        {
+            values[j] = values[j - 1];
+            j--;
+        }
+        values[j] = value;
+    }
+}
+
+// Median of a small array (sorts it in place)
+template <typename T>
+static T median(T *values, size_t count)
+{
+    sortSmall(values, count);
+    return values[count / 2];
+}
+
+ClockSync::ClockSync(Clock &clock) : clock_(clock),
+                                     master_(false),
+                                     serving_(false),
+                                     sequence_(0),
+                                     awaiting_(false),
+                                     awaiting_sequence_(0),
+                                     pending_ready_(false),
+                                     request_head_(0),
+                                     request_tail_(0)
+{
+    memcpy(master_address_, BROADCAST_ADDRESS, sizeof(master_address_));
+    reset();
+}
+
+void ClockSync::reset()
+{
+    awaiting_ = false;
+    pending_ready_ = false;
+    awaiting_originate_us_ = 0;
+    request_sent_us_ = 0;
+    next_request_us_ = 0;
+    sample_head_ = 0;
+    sample_count_ = 0;
+    drift_ = clock_.getDrift();
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void ClockSync::setMaster(bool master)
+{
+    if (master == master_)
+    {
+        return;
+    }
+    master_ = master;
+    bool locked = stats_.locked;
+    reset();
+    // A demoted master already holds good time; slew onto the new master
+    stats_.locked = locked || master;
+}
+
+void ClockSync::setMasterAddress(const uint8_t *mac)
+{
+    const uint8_t *address = mac ? mac : BROADCAST_ADDRESS;
+    if (memcmp(master_address_, address, sizeof(master_address_)) == 0)
+    {
+        return;
+    }
+    memcpy(master_address_, address, sizeof(master_address_));
+
+    // Samples against the old master say nothing about the new one, but the
+    // clock keeps its current discipline and slews onto the new time base
+    bool locked = stats_.locked;
+    reset();
+    stats_.locked = locked;
+}
+
+bool ClockSync::isClockSyncMessage(const uint8_t *data, size_t len)
+{
+    return len == sizeof(ClockSyncPacket) && data[0] == CLOCK_SYNC_MAGIC;
+}
+
+void ClockSync::update()
+{
+    answerRequests();
+
+    if (pending_ready_.load(std::memory_order_acquire))
+    {
+        processResponse();
+        pending_ready_.store(false, std::memory_order_release);
+    }
+
+    if (master_ || !send_)
+    {
+        return;
+    }
+
+    uint64_t now = clock_.localMicros();
+    if (awaiting_.load(std::memory_order_acquire) &&
+        now - request_sent_us_ > (uint64_t)CLOCK_SYNC_REQUEST_TIMEOUT * 1000)
+    {
+        awaiting_ = false;
+        stats_.timeouts++;
+    }
+
+    if (!awaiting_.load(std::memory_order_acquire) && now >= next_request_us_)
+    {
+        sendRequest(now);
+    }
+}
+
+void ClockSync::answerRequests()
+{
+    uint8_t head = request_head_.load(std::memory_order_relaxed);
+    while (head != request_tail_.load(std::memory_order_acquire))
+    {
+        const Request &request = requests_[head];
+        // A serving follower passes on the time it is locked to
+        if ((master_ || (serving_ && stats_.locked)) && send_)
+        {
+            ClockSyncPacket response;
+            memset(&response, 0, sizeof(response));
+            response.magic = CLOCK_SYNC_MAGIC;
+            response.kind = CLOCK_SYNC_RESPONSE;
+            response.sequence = request.sequence;
+            response.originate_us = request.originate_us;
+            response.receive_us = clock_.toSynced(request.receive_local_us);
+            response.transmit_us = clock_.nowMicros();
+            sendPacket(request.mac, response);
+        }
+        head = (head + 1) % CLOCK_SYNC_REQUEST_QUEUE_SIZE;
+        request_head_.store(head, std::memory_order_release);
+    }
+}
+
+void ClockSync::sendRequest(uint64_t now_us)
+{
+    bool filling = sample_count_ < CLOCK_SYNC_SAMPLE_COUNT;
+    next_request_us_ = now_us + (uint64_t)(filling ? CLOCK_SYNC_BURST_INTERVAL : CLOCK_SYNC_POLL_INTERVAL) * 1000;
+
+    ClockSyncPacket packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.magic = CLOCK_SYNC_MAGIC;
+    packet.kind = CLOCK_SYNC_REQUEST;
+    packet.sequence = ++sequence_;
+
+    // Armed before sending: the response can arrive before send returns
+    awaiting_sequence_ = packet.sequence;
+    request_sent_us_ = clock_.localMicros();
+    awaiting_originate_us_ = request_sent_us_;
+    packet.originate_us = request_sent_us_;
+    awaiting_.store(true, std::memory_order_release);
+
+    stats_.requests++;
+    sendPacket(master_address_, packet);
+}
+
+bool ClockSync::handleMessage(const uint8_t *mac, const uint8_t *data, size_t len, uint64_t receive_local_us)
+{
+    if (!isClockSyncMessage(data, len))
+    {
+        return false;
+    }
+
+    ClockSyncPacket packet;
+    memcpy(&packet, data, sizeof(packet));
+
+    if (packet.kind == CLOCK_SYNC_REQUEST)
+    {
+        // Answered from update(): reading the clock here could catch
+        // applyModel() halfway through rewriting it
+        uint8_t tail = request_tail_.load(std::memory_order_relaxed);
+        uint8_t next = (tail + 1) % CLOCK_SYNC_REQUEST_QUEUE_SIZE;
+        if (next == request_head_.load(std::memory_order_acquire))
+        {
+            // The follower times out and asks again
+            stats_.queue_overflows++;
+            return true;
+        }
+        Request &request = requests_[tail];
+        memcpy(request.mac, mac, 6);
+        request.sequence = packet.sequence;
+        request.originate_us = packet.originate_us;
+        request.receive_local_us = receive_local_us;
+        request_tail_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    if (packet.kind == CLOCK_SYNC_RESPONSE && !master_)
+    {
+        if (!awaiting_.load(std::memory_order_acquire) ||
+            packet.sequence != awaiting_sequence_.load(std::memory_order_relaxed) ||
+            pending_ready_.load(std::memory_order_acquire))
+        {
+            stats_.rejected++;
+            return true;
+        }
+        pending_ = packet;
+        pending_receive_us_ = receive_local_us;
+        pending_ready_.store(true, std::memory_order_release);
+    }
+    return true;
+}
+
+void ClockSync::processResponse()
+{
+    awaiting_ = false;
+    if (pending_.originate_us != awaiting_originate_us_)
+    {
+        stats_.rejected++;
+        return;
+    }
+    stats_.responses++;
+
+    // t1/t4 on the local clock, t2/t3 on the master's
+    uint64_t t1 = pending_.originate_us;
+    uint64_t t2 = pending_.receive_us;
+    uint64_t t3 = pending_.transmit_us;
+    uint64_t t4 = pending_receive_us_;
+
+    int64_t delay = (int64_t)(t4 - t1) - (int64_t)(t3 - t2);
+    if (delay < 0 || delay > CLOCK_SYNC_MAX_DELAY_US)
+    {
+        stats_.rejected++;
+        return;
+    }
+
+    Sample sample;
+    sample.local_us = t1 + (t4 - t1) / 2;
+    sample.offset_us = ((int64_t)(t2 - t1) + (int64_t)(t3 - t4)) / 2;
+    sample.delay_us = (uint32_t)delay;
+    stats_.delay_us = sample.delay_us;
+
+    addSample(sample);
+    applyModel(t4);
+}
+
+void ClockSync::addSample(const Sample &sample)
+{
+    samples_[sample_head_] = sample;
+    sample_head_ = (sample_head_ + 1) % CLOCK_SYNC_SAMPLE_COUNT;
+    if (sample_count_ < CLOCK_SYNC_SAMPLE_COUNT)
+    {
+        sample_count_++;
+    }
+    stats_.samples = sample_count_;
+}
+
+void ClockSync::applyModel(uint64_t now_us)
+{
+    if (sample_count_ < CLOCK_SYNC_MIN_SAMPLES)
+    {
+        return;
+    }
+
+    uint32_t min_delay = UINT32_MAX;
+    uint64_t oldest = UINT64_MAX;
+    uint64_t newest = 0;
+    for (uint8_t i = 0; i < sample_count_; i++)
+    {
+        if (samples_[i].delay_us < min_delay)
+        {
+            min_delay = samples_[i].delay_us;
+        }
+        if (samples_[i].local_us < oldest)
+        {
+            oldest = samples_[i].local_us;
+        }
+        if (samples_[i].local_us > newest)
+        {
+            newest = samples_[i].local_us;
+        }
+    }
+
+    int64_t offset;
+    if (newest - oldest >= CLOCK_SYNC_MIN_DRIFT_SPAN_US)
+    {
+        // Weighted least-squares line through offset over local time. A
+        // sample's offset error is bounded by half its excess round trip
+        // (queueing and retries only ever add delay), so each one is weighted
+        // by how close it came to the window minimum.
+        double weight_sum = 0;
+        double mean_t = 0;
+        double mean_offset = 0;
+        double weights[CLOCK_SYNC_SAMPLE_COUNT];
+        for (uint8_t i = 0; i < sample_count_; i++)
+        {
+            double excess = (double)(samples_[i].delay_us - min_delay) + CLOCK_SYNC_WEIGHT_FLOOR_US;
+            weights[i] = 1.0 / (excess * excess);
+            weight_sum += weights[i];
+            mean_t += weights[i] * (double)(int64_t)(samples_[i].local_us - now_us);
+            mean_offset += weights[i] * (double)samples_[i].offset_us;
+        }
+        mean_t /= weight_sum;
+        mean_offset /= weight_sum;
+
+        double covariance = 0;
+        double variance = 0;
+        for (uint8_t i = 0; i < sample_count_; i++)
+        {
+            double dt = (double)(int64_t)(samples_[i].local_us - now_us) - mean_t;
+            covariance += weights[i] * dt * ((double)samples_[i].offset_us - mean_offset);
+            variance += weights[i] * dt * dt;
+        }
+        if (variance > 0)
+        {
+            drift_ = covariance / variance;
+            if (drift_ > CLOCK_SYNC_MAX_DRIFT)
+            {
+                drift_ = CLOCK_SYNC_MAX_DRIFT;
+            }
+            else if (drift_ < -CLOCK_SYNC_MAX_DRIFT)
+            {
+                drift_ = -CLOCK_SYNC_MAX_DRIFT;
+            }
+        }
+        offset = (int64_t)(mean_offset - drift_ * mean_t);
+    }
+    else
+    {
+        // Too short to fit drift: median offset of the cleanest exchanges
+        // (within slack of the minimum delay, at least MIN_SAMPLES of them)
+        uint32_t delays[CLOCK_SYNC_SAMPLE_COUNT];
+        for (uint8_t i = 0; i < sample_count_; i++)
+        {
+            delays[i] = samples_[i].delay_us;
+        }
+        sortSmall(delays, sample_count_);
+        uint32_t threshold = min_delay + CLOCK_SYNC_DELAY_SLACK_US;
+        if (threshold < delays[CLOCK_SYNC_MIN_SAMPLES - 1])
+        {
+            threshold = delays[CLOCK_SYNC_MIN_SAMPLES - 1];
+        }
+
+        int64_t projected[CLOCK_SYNC_SAMPLE_COUNT];
+        uint8_t accepted = 0;
+        for (uint8_t i = 0; i < sample_count_; i++)
+        {
+            if (samples_[i].delay_us <= threshold)
+            {
+                int64_t elapsed = (int64_t)(now_us - samples_[i].local_us);
+                projected[accepted++] = samples_[i].offset_us + (int64_t)(drift_ * elapsed);
+            }
+        }
+        offset = median(projected, accepted);
+    }
+
+    stats_.offset_us = offset;
+    stats_.drift_ppm = (float)(drift_ * 1e6);
+
+    uint64_t local_now = clock_.localMicros();
+    int64_t desired = offset + (int64_t)(drift_ * (int64_t)(local_now - now_us));
+    int64_t current = (int64_t)(clock_.toSynced(local_now) - local_now);
+    int64_t error = desired - current;
+
+    if (!stats_.locked || error > CLOCK_SYNC_STEP_THRESHOLD_US || error < -CLOCK_SYNC_STEP_THRESHOLD_US)
+    {
+        clock_.discipline(now_us, offset, drift_);
+        stats_.locked = true;
+        return;
+    }
+
+    // Slew from the current reading onto the fitted model
+    clock_.discipline(local_now, current, drift_, error);
+}
+
+void ClockSync::sendPacket(const uint8_t *mac, const ClockSyncPacket &packet)
+{
+    if (send_)
+    {
+        send_(mac, reinterpret_cast<const uint8_t *>(&packet), sizeof(packet));
+    }
+}
@@ -0,0 +1,160 @@
+#ifndef CLOCKSYNC_H
+#define CLOCKSYNC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <functional>
+#include "Clock.h"
+
+#define CLOCK_SYNC_MAGIC 0xC5
+#define CLOCK_SYNC_SAMPLE_COUNT 32          // Exchanges kept for filtering / drift fit
+#define CLOCK_SYNC_MIN_SAMPLES 4            // Exchanges before the first correction
+#define CLOCK_SYNC_BURST_INTERVAL 100       // ms between requests until the window is full
+#define CLOCK_SYNC_POLL_INTERVAL 1000       // ms between requests once locked
+#define CLOCK_SYNC_REQUEST_TIMEOUT 500      // ms before an unanswered request is dropped
+#define CLOCK_SYNC_MAX_DELAY_US 50000       // Round trips above this are discarded outright
+#define CLOCK_SYNC_DELAY_SLACK_US 1000      // Samples within min delay + slack are always kept
+#define CLOCK_SYNC_MIN_DRIFT_SPAN_US 16000000 // Sample span needed before fitting drift
+#define CLOCK_SYNC_WEIGHT_FLOOR_US 200      // Drift fit weight is 1 / (excess delay + floor)^2
+#define CLOCK_SYNC_MAX_DRIFT 0.0002         // 200ppm, far outside any real crystal
+#define CLOCK_SYNC_STEP_THRESHOLD_US 10000  // Larger errors are stepped, smaller ones slewed
+#define CLOCK_SYNC_REQUEST_QUEUE_SIZE 16    // Requests buffered between receive callback and update()
+
+enum ClockSyncKind : uint8_t
+{
+    CLOCK_SYNC_REQUEST = 1,
+    CLOCK_SYNC_RESPONSE = 2
+};
+
+// NTP-style exchange. The follower stamps originate (its local time) and the
+// master echoes it with its receive/transmit times on the shared clock.
+struct __attribute__((packed)) ClockSyncPacket
+{
+    uint8_t magic;
+    uint8_t kind;
+    uint16_t sequence;
+    uint64_t originate_us;
+    uint64_t receive_us;
+    uint64_t transmit_us;
+};
+
+struct ClockSyncStats
+{
+    uint32_t requests;
+    uint32_t responses;
+    uint32_t timeouts;
+    uint32_t rejected;          // Stale, mismatched or implausible responses
+    uint32_t queue_overflows;   // Requests dropped before update() could answer them
+    int64_t offset_us;          // Last fitted offset (master - local)
+    uint32_t delay_us;          // Last round-trip delay
+    float drift_ppm;            // Fitted local crystal error
+    uint8_t samples;            // Exchanges in the filter window
+    bool locked;
+};
+
+// Round-trip clock synchronization on top of any datagram transport.
+//
+// Followers send timestamped requests to the time master and keep a window of
+// (offset, delay) samples. Each update:
+//   - once the window spans CLOCK_SYNC_MIN_DRIFT_SPAN_US, fits offset and
+//     crystal drift by least squares, weighting each sample by how close its
+//     round trip is to the window's minimum (queueing/retry delay is what
+//     breaks the symmetric-path assumption),
+//   - before that, takes the median of the low-delay samples as the offset,
+// and disciplines the Clock with both, so now() keeps tracking the master
+// between exchanges. After the first lock, small corrections are slewed at
+// CLOCK_SLEW_RATE so show time never jumps backward.
+//
+// The master (and serving followers) only answer requests. Receive
+// timestamps must be taken as early as possible (in the radio receive
+// callback) and passed to handleMessage(), which only queues; requests are
+// answered from update(), where the clock's model is never half rewritten.
+// The time spent queued is between the receive and transmit stamps, so it
+// does not count toward the follower's round trip.
+class ClockSync
+{
+public:
+    typedef std::function<bool(const uint8_t *mac, const uint8_t *data, size_t len)> SendFunction;
+
+    explicit ClockSync(Clock &clock);
+
+    void setSendFunction(SendFunction send_function) { send_ = send_function; }
+    void setMaster(bool master);
+    bool isMaster() const { return master_; }
+    // Once locked, a follower answers requests too, so props out of the
+    // master's range can sync through it (each hop adds its own error)
+    void setServing(bool serving) { serving_ = serving; }
+    // Where requests go; nullptr (the default) broadcasts them
+    void setMasterAddress(const uint8_t *mac);
+
+    // Call from loop(): answers queued requests, sends our own and folds in
+    // new samples
+    void update();
+
+    // Returns true if the message was a clock sync packet (handled or not).
+    // Safe to call from the radio receive callback.
+    bool handleMessage(const uint8_t *mac, const uint8_t *data, size_t len, uint64_t receive_local_us);
+    static bool isClockSyncMessage(const uint8_t *data, size_t len);
+
+    bool isLocked() const { return stats_.locked; }
+    const ClockSyncStats &getStats() const { return stats_; }
+    void reset();
+
+private:
+    struct Request
+    {
+        uint8_t mac[6];
+        uint16_t sequence;
+        uint64_t originate_us;
+        uint64_t receive_local_us;
+    };
+
+    struct Sample
+    {
+        uint64_t local_us;  // Midpoint of the exchange on the local clock
+        int64_t offset_us;
+        uint32_t delay_us;
+    };
+
+    void answerRequests();
+    void sendRequest(uint64_t now_us);
+    void processResponse();
+    void addSample(const Sample &sample);
+    void applyModel(uint64_t now_us);
+    void sendPacket(const uint8_t *mac, const ClockSyncPacket &packet);
+
+    Clock &clock_;
+    SendFunction send_;
+    bool master_;
+    bool serving_;
+    uint8_t master_address_[6];
+
+    // Request state
+    uint16_t sequence_;
+    uint64_t request_sent_us_;
+    uint64_t next_request_us_;
+    std::atomic<bool> awaiting_;
+    std::atomic<uint16_t> awaiting_sequence_;
+    uint64_t awaiting_originate_us_;
+
+    // Response handed from the receive callback to update()
+    ClockSyncPacket pending_;
+    uint64_t pending_receive_us_;
+    std::atomic<bool> pending_ready_;
+
+    // Requests handed from the receive callback to update() (SPSC ring)
+    Request requests_[CLOCK_SYNC_REQUEST_QUEUE_SIZE];
+    std::atomic<uint8_t> request_head_;
+    std::atomic<uint8_t> request_tail_;
+
+    // Filter window (ring)
+    Sample samples_[CLOCK_SYNC_SAMPLE_COUNT];
+    uint8_t sample_head_;
+    uint8_t sample_count_;
+    double drift_;
+
+    ClockSyncStats stats_;
+};
+
+#endif // CLOCKSYNC_H
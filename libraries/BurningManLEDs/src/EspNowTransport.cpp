@@ -0,0 +1,80 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_wifi.h>
+#include "EspNowTransport.h"
+#include "BMLog.h"
+#include <string.h>
+
+EspNowTransport *EspNowTransport::instance_ = nullptr;
+
+EspNowTransport::EspNowTransport(uint8_t channel) : channel_(channel)
+{
+    instance_ = this;
+}
+
+bool EspNowTransport::begin()
+{
+    WiFi.mode(WIFI_STA);
+    WiFi.setChannel(channel_);
+    if (esp_now_init() != ESP_OK)
+    {
+        BMLOG_ERROR("EspNowTransport", "Error initializing ESP-NOW");
+        return false;
+    }
+    esp_now_register_recv_cb(EspNowTransport::onDataReceivedStatic);
+    esp_now_register_send_cb(EspNowTransport::onDataSentStatic);
+    return true;
+}
+
+void EspNowTransport::getMac(uint8_t *mac) const
+{
+    esp_wifi_get_mac(WIFI_IF_STA, mac);
+}
+
+bool EspNowTransport::send(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+    // Unicast replies go to whoever asked; register them on first contact
+    if (!esp_now_is_peer_exist(mac) && !addPeer(mac))
+    {
+        return false;
+    }
+    return esp_now_send(mac, data, len) == ESP_OK;
+}
+
+bool EspNowTransport::addPeer(const uint8_t *mac)
+{
+    esp_now_peer_info_t peerInfo = {};
+    memcpy(peerInfo.peer_addr, mac, 6);
+    peerInfo.channel = channel_;
+    peerInfo.encrypt = false;
+    return esp_now_add_peer(&peerInfo) == ESP_OK;
+}
+
+void EspNowTransport::removePeer(const uint8_t *mac)
+{
+    if (esp_now_is_peer_exist(mac))
+    {
+        esp_now_del_peer(mac);
+    }
+}
+
+bool EspNowTransport::hasPeer(const uint8_t *mac) const
+{
+    return esp_now_is_peer_exist(mac);
+}
+
+void EspNowTransport::onDataReceivedStatic(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+{
+    if (instance_ && instance_->on_receive_)
+    {
+        instance_->on_receive_(info->src_addr, data, len);
+    }
+}
+
+void EspNowTransport::onDataSentStatic(const uint8_t *mac, esp_now_send_status_t status)
+{
+    if (instance_ && instance_->on_sent_)
+    {
+        instance_->on_sent_(mac, status == ESP_NOW_SEND_SUCCESS);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef ESPNOWTRANSPORT_H
+#define ESPNOWTRANSPORT_H
+
+#include <esp_now.h>
+#include "SyncTransport.h"
+
+#define ESP_NOW_TRANSPORT_CHANNEL 6
+
+// ESP-NOW between props, the default transport. Unicasts need the addressee
+// in the driver's peer table; send() registers whoever it is asked to reach
+// on first contact (clock sync replies, acks), and the send callback reports
+// each unicast's MAC ACK.
+class EspNowTransport : public SyncTransport
+{
+public:
+    explicit EspNowTransport(uint8_t channel = ESP_NOW_TRANSPORT_CHANNEL);
+
+    bool begin() override;
+    void getMac(uint8_t *mac) const override;
+    bool send(const uint8_t *mac, const uint8_t *data, size_t len) override;
+    bool addPeer(const uint8_t *mac) override;
+    void removePeer(const uint8_t *mac) override;
+    bool hasPeer(const uint8_t *mac) const override;
+
+    // ESP-NOW callbacks carry no context, so they go to the transport
+    // constructed last. Host simulations running several switch it per device.
+    void makeCallbackTarget() { instance_ = this; }
+
+private:
+    static EspNowTransport *instance_;
+    static void onDataReceivedStatic(const esp_now_recv_info_t *info, const uint8_t *data, int len);
+    static void onDataSentStatic(const uint8_t *mac, esp_now_send_status_t status);
+
+    uint8_t channel_;
+};
+
+#endif // ESPNOWTRANSPORT_H
@@ -0,0 +1,297 @@
+#include <Arduino.h>
+#include "LeaderElection.h"
+#include <string.h>
+
+static const uint8_t LEADER_BROADCAST_ADDRESS[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+LeaderElection::LeaderElection() : started_(false),
+                                   group_id_(0),
+                                   priority_(0),
+                                   has_leader_(false),
+                                   leading_(false),
+                                   leader_priority_(0),
+                                   lease_until_ms_(0),
+                                   next_heartbeat_ms_(0),
+                                   claim_base_ms_(0),
+                                   has_lost_(false),
+                                   candidate_count_(0),
+                                   queue_head_(0),
+                                   queue_tail_(0)
+{
+    memset(own_mac_, 0, sizeof(own_mac_));
+    memset(leader_mac_, 0, sizeof(leader_mac_));
+    memset(lost_mac_, 0, sizeof(lost_mac_));
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void LeaderElection::begin(const uint8_t *own_mac, uint16_t group_id)
+{
+    memcpy(own_mac_, own_mac, 6);
+    group_id_ = group_id;
+    // Listen for a whole lease first: the group may already have a leader
+    claim_base_ms_ = millis() + LEADER_LEASE;
+    started_ = true;
+}
+
+void LeaderElection::setPriority(uint8_t priority)
+{
+    priority_ = priority;
+    if (isLeader())
+    {
+        // Announce the new priority right away
+        next_heartbeat_ms_ = millis();
+    }
+}
+
+void LeaderElection::addCandidate(const uint8_t *mac)
+{
+    if (findCandidate(mac) >= 0 || candidate_count_ == LEADER_MAX_CANDIDATES)
+    {
+        return;
+    }
+    memcpy(candidates_[candidate_count_++], mac, 6);
+}
+
+void LeaderElection::removeCandidate(const uint8_t *mac)
+{
+    int index = findCandidate(mac);
+    if (index >= 0)
+    {
+        memcpy(candidates_[index], candidates_[--candidate_count_], 6);
+    }
+}
+
+void LeaderElection::update()
+{
+    if (!started_)
+    {
+        return;
+    }
+    uint32_t now = millis();
+
+    uint8_t head = queue_head_.load(std::memory_order_relaxed);
+    while (head != queue_tail_.load(std::memory_order_acquire))
+    {
+        applyHeartbeat(queue_[head], now);
+        head = (head + 1) % LEADER_QUEUE_SIZE;
+        queue_head_.store(head, std::memory_order_release);
+    }
+
+    if (isLeader())
+    {
+        if ((int32_t)(now - next_heartbeat_ms_) >= 0)
+        {
+            sendHeartbeat(now);
+        }
+        return;
+    }
+
+    if (has_leader_ && (int32_t)(now - lease_until_ms_) >= 0)
+    {
+        loseLeader(now);
+    }
+
+    if (has_leader_)
+    {
+        // A preferred device doesn't wait for a lower-priority leader to fail
+        if (priority_ > leader_priority_)
+        {
+            claim(now);
+        }
+    }
+    // Even the best candidate gives a late heartbeat one rank delay; the
+    // others give everyone better than them that long each
+    else if ((int32_t)(now - claim_base_ms_) >= (int32_t)((rank() + 1) * LEADER_RANK_DELAY))
+    {
+        claim(now);
+    }
+}
+
+bool LeaderElection::isHeartbeat(const uint8_t *data, size_t len)
+{
+    return len >= LEADER_HEARTBEAT_SIZE && data[0] == LEADER_ELECTION_MAGIC;
+}
+
+bool LeaderElection::handleMessage(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+    if (!isHeartbeat(data, len))
+    {
+        return false;
+    }
+    if (data[1] != LEADER_ELECTION_VERSION)
+    {
+        return true;
+    }
+
+    uint8_t tail = queue_tail_.load(std::memory_order_relaxed);
+    uint8_t next = (tail + 1) % LEADER_QUEUE_SIZE;
+    if (next == queue_head_.load(std::memory_order_acquire))
+    {
+        // The next heartbeat renews the lease just as well
+        stats_.queue_overflows++;
+        return true;
+    }
+
+    decodeHeartbeat(mac, data, queue_[tail]);
+    queue_tail_.store(next, std::memory_order_release);
+    return true;
+}
+
+bool LeaderElection::processMessage(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+    if (!isHeartbeat(data, len))
+    {
+        return false;
+    }
+    if (!started_ || data[1] != LEADER_ELECTION_VERSION)
+    {
+        return true;
+    }
+
+    Heartbeat heartbeat;
+    decodeHeartbeat(mac, data, heartbeat);
+    applyHeartbeat(heartbeat, millis());
+    return true;
+}
+
+void LeaderElection::decodeHeartbeat(const uint8_t *mac, const uint8_t *data, Heartbeat &heartbeat)
+{
+    memcpy(heartbeat.mac, mac, 6);
+    heartbeat.group_id = data[2] | (uint16_t)(data[3] << 8);
+    heartbeat.priority = data[4];
+}
+
+void LeaderElection::applyHeartbeat(const Heartbeat &heartbeat, uint32_t now)
+{
+    if (heartbeat.group_id != group_id_)
+    {
+        return;
+    }
+    stats_.heartbeats_received++;
+
+    if (isLeader())
+    {
+        if (beats(heartbeat.priority, heartbeat.mac, priority_, own_mac_))
+        {
+            stats_.step_downs++;
+            follow(heartbeat.mac, heartbeat.priority, now);
+        }
+        else
+        {
+            // Tell the other claimant to step down now rather than at our next beat
+            next_heartbeat_ms_ = now;
+        }
+        return;
+    }
+
+    if (has_leader_ && memcmp(heartbeat.mac, leader_mac_, 6) == 0)
+    {
+        leader_priority_ = heartbeat.priority;
+        lease_until_ms_ = now + LEADER_LEASE;
+        return;
+    }
+    // Anyone will do while we have no leader; otherwise only a better one
+    if (!has_leader_ || beats(heartbeat.priority, heartbeat.mac, leader_priority_, leader_mac_))
+    {
+        follow(heartbeat.mac, heartbeat.priority, now);
+    }
+}
+
+void LeaderElection::follow(const uint8_t *mac, uint8_t priority, uint32_t now)
+{
+    has_leader_ = true;
+    leading_ = false;
+    memcpy(leader_mac_, mac, 6);
+    leader_priority_ = priority;
+    lease_until_ms_ = now + LEADER_LEASE;
+    has_lost_ = false;
+    notify();
+}
+
+void LeaderElection::claim(uint32_t now)
+{
+    stats_.claims++;
+    has_leader_ = true;
+    leading_ = true;
+    memcpy(leader_mac_, own_mac_, 6);
+    leader_priority_ = priority_;
+    sendHeartbeat(now);
+    notify();
+}
+
+void LeaderElection::loseLeader(uint32_t now)
+{
+    stats_.leases_expired++;
+    memcpy(lost_mac_, leader_mac_, 6);
+    has_lost_ = true;
+    has_leader_ = false;
+    // The lease already waited long enough; only the rank delay is left
+    claim_base_ms_ = now;
+    notify();
+}
+
+void LeaderElection::sendHeartbeat(uint32_t now)
+{
+    uint8_t heartbeat[LEADER_HEARTBEAT_SIZE] = {
+        LEADER_ELECTION_MAGIC,
+        LEADER_ELECTION_VERSION,
+        (uint8_t)(group_id_ & 0xFF),
+        (uint8_t)(group_id_ >> 8),
+        priority_};
+    if (send_)
+    {
+        send_(LEADER_BROADCAST_ADDRESS, heartbeat, sizeof(heartbeat));
+    }
+    stats_.heartbeats_sent++;
+    next_heartbeat_ms_ = now + LEADER_HEARTBEAT_INTERVAL;
+}
+
+uint8_t LeaderElection::rank() const
+{
+    // Candidates' priorities are only known from their heartbeats, so a
+    // preferred device ranks first and the rest by MAC
+    if (priority_ > 0)
+    {
+        return 0;
+    }
+    uint8_t better = 0;
+    for (uint8_t i = 0; i < candidate_count_; i++)
+    {
+        if (has_lost_ && memcmp(candidates_[i], lost_mac_, 6) == 0)
+        {
+            continue;
+        }
+        better += memcmp(candidates_[i], own_mac_, 6) < 0;
+    }
+    return better;
+}
+
+int LeaderElection::findCandidate(const uint8_t *mac) const
+{
+    for (uint8_t i = 0; i < candidate_count_; i++)
+    {
+        if (memcmp(candidates_[i], mac, 6) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void LeaderElection::notify()
+{
+    stats_.leader_changes++;
+    if (on_changed_)
+    {
+        on_changed_(has_leader_ ? leader_mac_ : nullptr);
+    }
+}
+
+bool LeaderElection::beats(uint8_t priority_a, const uint8_t *mac_a, uint8_t priority_b, const uint8_t *mac_b)
+{
+    if (priority_a != priority_b)
+    {
+        return priority_a > priority_b;
+    }
+    return memcmp(mac_a, mac_b, 6) < 0;
+}
@@ -0,0 +1,135 @@
+#ifndef LEADERELECTION_H
+#define LEADERELECTION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <functional>
+
+#define LEADER_ELECTION_MAGIC 0xE5
+#define LEADER_ELECTION_VERSION 1
+#define LEADER_HEARTBEAT_SIZE 5
+#define LEADER_HEARTBEAT_INTERVAL 250   // ms between the leader's heartbeats
+#define LEADER_LEASE 1000               // ms a heartbeat keeps its sender leader
+#define LEADER_RANK_DELAY 100           // ms each better candidate gets to claim first
+#define LEADER_MAX_CANDIDATES 32
+#define LEADER_QUEUE_SIZE 8             // Heartbeats buffered between receive callback and update()
+
+struct LeaderElectionStats
+{
+    uint32_t heartbeats_sent;
+    uint32_t heartbeats_received;
+    uint32_t claims;            // Times this device made itself leader
+    uint32_t step_downs;        // ...and gave way to a better one
+    uint32_t leases_expired;    // Leaders that went silent on us
+    uint32_t leader_changes;
+    uint32_t queue_overflows;
+};
+
+// Picks one device per group to be time master and scene authority.
+//
+// The leader broadcasts a 5-byte heartbeat every LEADER_HEARTBEAT_INTERVAL;
+// each one renews its lease at every group member for LEADER_LEASE. A device
+// that has no leader with a valid lease (just booted, or the leader went
+// silent) claims leadership itself after LEADER_RANK_DELAY, plus that again
+// for every candidate that beats it, so the best one normally claims first
+// and everyone else hears it before their turn comes. Candidates are ordered
+// by priority (a preferred device, e.g. a fixed installation, always wins),
+// then by lowest MAC. When two leaders hear each other (simultaneous claims,
+// a healed partition) the worse one steps down.
+//
+// An established leader is never replaced by an equal-priority device just
+// because its MAC is lower, so props joining the group don't move the time
+// master around. Failover takes about LEADER_LEASE plus one rank delay.
+//
+// Candidates come from peer discovery; only group members are added.
+// handleMessage() only queues heartbeats, so it is safe in the radio receive
+// callback; the leader callback is only invoked from update() and from
+// processMessage(), which takes heartbeats that arrive in loop() (e.g. from
+// the mesh relay).
+class LeaderElection
+{
+public:
+    typedef std::function<bool(const uint8_t *mac, const uint8_t *data, size_t len)> SendFunction;
+    // leader: the new leader's MAC (our own when we lead), nullptr while there is none
+    typedef std::function<void(const uint8_t *leader)> LeaderFunction;
+
+    LeaderElection();
+
+    void begin(const uint8_t *own_mac, uint16_t group_id);
+    void setSendFunction(SendFunction send_function) { send_ = send_function; }
+    void onLeaderChanged(LeaderFunction callback) { on_changed_ = callback; }
+    // Preferred devices take over from any leader with a lower priority
+    void setPriority(uint8_t priority);
+
+    void addCandidate(const uint8_t *mac);
+    void removeCandidate(const uint8_t *mac);
+
+    // Call from loop(): applies heartbeats, expires the lease, claims, beats
+    void update();
+
+    // Returns true if the message was a heartbeat. Safe to call from the radio
+    // receive callback.
+    bool handleMessage(const uint8_t *mac, const uint8_t *data, size_t len);
+    // Same, but applied at once; only from loop(), the queue's consumer side
+    bool processMessage(const uint8_t *mac, const uint8_t *data, size_t len);
+    static bool isHeartbeat(const uint8_t *data, size_t len);
+
+    bool hasLeader() const { return has_leader_; }
+    bool isLeader() const { return has_leader_ && leading_; }
+    // Only valid while hasLeader()
+    const uint8_t *getLeader() const { return leader_mac_; }
+    const LeaderElectionStats &getStats() const { return stats_; }
+
+private:
+    struct Heartbeat
+    {
+        uint8_t mac[6];
+        uint16_t group_id;
+        uint8_t priority;
+    };
+
+    static void decodeHeartbeat(const uint8_t *mac, const uint8_t *data, Heartbeat &heartbeat);
+    void applyHeartbeat(const Heartbeat &heartbeat, uint32_t now);
+    void follow(const uint8_t *mac, uint8_t priority, uint32_t now);
+    void claim(uint32_t now);
+    void loseLeader(uint32_t now);
+    void sendHeartbeat(uint32_t now);
+    uint8_t rank() const;
+    int findCandidate(const uint8_t *mac) const;
+    void notify();
+
+    // Priority first, then the lower MAC
+    static bool beats(uint8_t priority_a, const uint8_t *mac_a, uint8_t priority_b, const uint8_t *mac_b);
+
+    SendFunction send_;
+    LeaderFunction on_changed_;
+    bool started_;
+    uint8_t own_mac_[6];
+    uint16_t group_id_;
+    uint8_t priority_;
+
+    bool has_leader_;
+    bool leading_;
+    uint8_t leader_mac_[6];
+    uint8_t leader_priority_;
+    uint32_t lease_until_ms_;
+    uint32_t next_heartbeat_ms_;
+    uint32_t claim_base_ms_;    // Without a leader we claim at this plus our rank delay
+    // The leader whose lease just ran out stays a candidate in discovery for
+    // a while; it is skipped when ranking
+    uint8_t lost_mac_[6];
+    bool has_lost_;
+
+    uint8_t candidates_[LEADER_MAX_CANDIDATES][6];
+    uint8_t candidate_count_;
+
+    // Single producer (receive callback), single consumer (update())
+    Heartbeat queue_[LEADER_QUEUE_SIZE];
+    std::atomic<uint8_t> queue_head_;
+    std::atomic<uint8_t> queue_tail_;
+
+    LeaderElectionStats stats_;
+};
+
+#endif // LEADERELECTION_H
@@ -1,10 +1,12 @@
 #include "LightShow.h"
+#include "BMLog.h"
 #include <FastLED.h>
 #include "Palettes.h"
 #include <algorithm>
+#include <climits>
 
 LightShow::LightShow(const std::vector<CLEDController *> &led_controllers, const Clock &clock)
-    : led_controllers_(led_controllers), clock_(clock), scene_changed_(false), hue_(0), frame_number_(0), scale_(0), palette_index_(0), palette_size_(0),
+    : led_controllers_(led_controllers), show_count_(0), clock_(clock), scene_changed_(false), hue_(0), frame_number_(0), scale_(0), palette_index_(0), palette_size_(0),
       current_palette_(AvailablePalettes::cool), primary_palette_(getPalette(AvailablePalettes::cool)), secondary_palette_(getPalette(AvailablePalettes::earth)), speed_(175), color_(CRGB::Red), direction_(true),
       heat_array_(nullptr), heat_array_size_(0), meteor_positions_(nullptr), meteor_trails_(nullptr), pulse_center_(0), plasma_offset_(0), 
       noise_x_(0), noise_y_(0), explosion_center_(0), spiral_angle_(0)
@@ -16,6 +18,11 @@ LightShow::LightShow(const std::vector<CLEDController *> &led_controllers, const
     // Initialize matrix drops
     memset(matrix_drops_, 0, sizeof(matrix_drops_));
 
+    for (auto &controller : led_controllers_)
+    {
+        shown_.push_back(ShownStrip{controller->leds(), (uint16_t)controller->size(), CRGB::Black, 0});
+    }
+
     // Initialize the available palettes
     available_palettes_ = {
         &candyPalette,
@@ -158,6 +165,41 @@ CRGBPalette16 LightShow::getPalette(AvailablePalettes palette)
 void LightShow::add_led_controller(CLEDController *led_controller)
 {
     led_controllers_.push_back(led_controller);
+    shown_.push_back(ShownStrip{led_controller->leds(), (uint16_t)led_controller->size(), CRGB::Black, 0});
+}
+
+LightShow::ShownStrip LightShow::getShownStrip(size_t index) const
+{
+    if (index >= shown_.size())
+    {
+        return ShownStrip{nullptr, 0, CRGB::Black, 0};
+    }
+    return shown_[index];
+}
+
+void LightShow::show_leds_(CLEDController *controller, uint8_t brightness)
+{
+    controller->showLeds(brightness);
+    record_show_(controller, controller->leds(), CRGB::Black, brightness);
+}
+
+void LightShow::show_color_(CLEDController *controller, const CRGB &color, uint8_t brightness)
+{
+    controller->showColor(color, controller->size(), brightness);
+    record_show_(controller, nullptr, color, brightness);
+}
+
+void LightShow::record_show_(CLEDController *controller, const CRGB *leds, const CRGB &color, uint8_t brightness)
+{
+    for (size_t i = 0; i < led_controllers_.size(); i++)
+    {
+        if (led_controllers_[i] == controller)
+        {
+            shown_[i] = ShownStrip{leds, (uint16_t)controller->size(), color, brightness};
+            break;
+        }
+    }
+    show_count_++;
 }
 
 void LightShow::brightness(uint8_t brightness)
@@ -373,41 +415,46 @@ void LightShow::apply_sync_updates(LightScene &new_scene)
 
     if (active_scene_.color != new_scene.color)
     {
-        Serial.println("Color has changed");
+        BMLOG_DEBUG("LightShow", "Color has changed");
         active_scene_.color = new_scene.color;
         color_ = new_scene.color;
         scene_changed_ = true;
     }
     if (active_scene_.primary_palette != new_scene.primary_palette)
     {
-        Serial.println("Primary Palette has changed");
+        BMLOG_DEBUG("LightShow", "Primary Palette has changed");
         active_scene_.primary_palette = new_scene.primary_palette;
         scene_changed_ = true;
     }
     if (active_scene_.scene_id != new_scene.scene_id)
-    // ||
-    // memcmp(&active_scene_.scenes, &new_scene.scenes, sizeof(active_scene_.scenes)) != 0)
     {
-        Serial.println("Scene ID has changed");
+        BMLOG_DEBUG("LightShow", "Scene ID has changed");
         active_scene_.scene_id = new_scene.scene_id;
         scene_changed_ = true;
     }
+    // SyncProtocol only replaces the parameters when they actually changed
+    if (memcmp(&active_scene_.scenes, &new_scene.scenes, sizeof(active_scene_.scenes)) != 0)
+    {
+        BMLOG_DEBUG("LightShow", "Scene parameters have changed");
+        active_scene_.scenes = new_scene.scenes;
+        scene_changed_ = true;
+    }
     if (active_scene_.speed != new_scene.speed)
     {
-        Serial.println("Speed has changed");
+        BMLOG_DEBUG("LightShow", "Speed has changed");
         active_scene_.speed = new_scene.speed;
         scene_changed_ = true;
         speed_ = new_scene.speed;
     }
     if (active_scene_.brightness != new_scene.brightness)
     {
-        Serial.println("Brightness has changed");
+        BMLOG_DEBUG("LightShow", "Brightness has changed");
         active_scene_.brightness = new_scene.brightness;
         scene_changed_ = true;
     }
     if (active_scene_.direction != new_scene.direction)
     {
-        Serial.println("Direction has changed");
+        BMLOG_DEBUG("LightShow", "Direction has changed");
         active_scene_.direction = new_scene.direction;
         scene_changed_ = true;
         direction_ = new_scene.direction;
@@ -418,6 +465,13 @@ void LightShow::render()
 {
     unsigned long now = clock_.now();
 
+    // A last render time of 0 restarts the animation. Make it render on this
+    // call, even right after boot while now is still short of a frame time.
+    if (last_render_time_ == 0)
+    {
+        last_render_time_ = now - (ULONG_MAX >> 1);
+    }
+
     for (auto &controller : led_controllers_)
     {
         controller->setDither(0);
@@ -435,7 +489,7 @@ void LightShow::render()
             last_render_time_ = now;
             for (auto &controller : led_controllers_)
             {
-                controller->showColor(CRGB::Black, controller->size(), brightness_);
+                show_color_(controller, CRGB::Black, brightness_);
             }
         }
         break;
@@ -446,7 +500,7 @@ void LightShow::render()
             last_render_time_ = now;
             for (auto &controller : led_controllers_)
             {
-                controller->showColor(active_scene_.color, controller->size(), active_scene_.brightness);
+                show_color_(controller, active_scene_.color, active_scene_.brightness);
             }
         }
         break;
@@ -469,7 +523,7 @@ void LightShow::render()
                     controller->leds()[i] = ColorFromPalette(current_palette, ledHue);
                 }
 
-                controller->showLeds(active_scene_.brightness);
+                show_leds_(controller, active_scene_.brightness);
             }
 
             hue_ += 5; // Increment the starting hue for the next iteration. You can adjust the value 5 as needed.
@@ -507,7 +561,7 @@ void LightShow::render()
                 }
 
                 hue_ = (hue_ + 1) % 255;
-                controller->showLeds(brightness_);
+                show_leds_(controller, brightness_);
             }
         }
         break;
@@ -520,7 +574,7 @@ void LightShow::render()
         {
             for (auto &controller : led_controllers_)
             {
-                controller->showColor(CHSV(new_hue, 255, 255), controller->size(), active_scene_.brightness);
+                show_color_(controller, CHSV(new_hue, 255, 255), active_scene_.brightness);
             }
 
             hue_ = new_hue;
@@ -544,7 +598,7 @@ void LightShow::render()
 
                 controller->leds()[last] = CHSV(hue_, 255, 255);
                 hue_ += 3;
-                controller->showLeds(active_scene_.brightness);
+                show_leds_(controller, active_scene_.brightness);
             }
         }
         break;
@@ -571,7 +625,7 @@ void LightShow::render()
                     leds[position] = CHSV(hue, 255, 255);
                 }
 
-                controller->showLeds(active_scene_.brightness);
+                show_leds_(controller, active_scene_.brightness);
             }
         }
         break;
@@ -587,7 +641,7 @@ void LightShow::render()
                 {
                     for (auto &controller : led_controllers_)
                     {
-                        controller->showColor(CRGB::Black, controller->size(), brightness_);
+                        show_color_(controller, CRGB::Black, brightness_);
                     }
 
                     current_frame_duration_ = active_scene_.scenes.strobe.duration_off;
@@ -596,7 +650,7 @@ void LightShow::render()
                 {
                     for (auto &controller : led_controllers_)
                     {
-                        controller->showColor(CRGB(active_scene_.scenes.strobe.color.r, active_scene_.scenes.strobe.color.g, active_scene_.scenes.strobe.color.b), controller->size(), active_scene_.brightness);
+                        show_color_(controller, CRGB(active_scene_.scenes.strobe.color.r, active_scene_.scenes.strobe.color.g, active_scene_.scenes.strobe.color.b), active_scene_.brightness);
                     }
 
                     current_frame_duration_ = active_scene_.scenes.strobe.duration_off;
@@ -607,7 +661,7 @@ void LightShow::render()
             {
                 for (auto &controller : led_controllers_)
                 {
-                    controller->showColor(CRGB::Black, controller->size(), brightness_);
+                    show_color_(controller, CRGB::Black, brightness_);
                 }
 
                 current_frame_duration_ = active_scene_.scenes.strobe.duration_between_sets;
@@ -636,7 +690,7 @@ void LightShow::render()
                     leds[position] = CRGB(active_scene_.scenes.sparkle.color.r, active_scene_.scenes.sparkle.color.g, active_scene_.scenes.sparkle.color.b);
                 }
 
-                controller->showLeds(active_scene_.brightness);
+                show_leds_(controller, active_scene_.brightness);
             }
         }
         break;
@@ -654,7 +708,7 @@ void LightShow::render()
             CRGB new_color = from_color.lerp8(to_color, new_scale);
             for (auto &controller : led_controllers_)
             {
-                controller->showColor(new_color, controller->size(), active_scene_.brightness);
+                show_color_(controller, new_color, active_scene_.brightness);
             }
 
             scale_ = new_scale;
@@ -674,7 +728,7 @@ void LightShow::render()
                 leds[i] = CHSV(active_scene_.scenes.setCHSV.color, active_scene_.scenes.setCHSV.saturation, active_scene_.scenes.setCHSV.luminosity);
             }
 
-            controller->showLeds(active_scene_.brightness);
+            show_leds_(controller, active_scene_.brightness);
         }
     }
     break;
@@ -700,7 +754,7 @@ void LightShow::render()
                     leds[i] = ColorFromPalette(current_palette, wave_val);
                 }
                 
-                controller->showLeds(active_scene_.brightness);
+                show_leds_(controller, active_scene_.brightness);
             }
             
             pulse_center_ = (pulse_center_ + 1) % (led_controllers_.empty() ? 1 : led_controllers_[0]->size());
@@ -739,7 +793,7 @@ void LightShow::render()
                     }
                 }
                 
-                controller->showLeds(active_scene_.brightness);
+                show_leds_(controller, active_scene_.brightness);
             }
             hue_ += 1;
         }
@@ -777,7 +831,7 @@ void LightShow::render()
                     leds[i] = ColorFromPalette(current_palette, heat_array_[led_idx]);
                 }
                 
-                controller->showLeds(active_scene_.brightness);
+                show_leds_(controller, active_scene_.brightness);
             }
         }
         break;
@@ -802,7 +856,7 @@ void LightShow::render()
                     leds[i] = ColorFromPalette(current_palette, pattern);
                 }
                 
-                controller->showLeds(active_scene_.brightness);
+                show_leds_(controller, active_scene_.brightness);
             }
             hue_ += 3;
         }
@@ -842,7 +896,7 @@ void LightShow::render()
                     }
                 }
                 
-                controller->showLeds(active_scene_.brightness);
+                show_leds_(controller, active_scene_.brightness);
             }
             hue_ += 4;
         }
@@ -892,7 +946,7 @@ void LightShow::render()
                     }
                 }
                 
-                controller->showLeds(active_scene_.brightness);
+                show_leds_(controller, active_scene_.brightness);
             }
         }
         break;
@@ -917,7 +971,7 @@ void LightShow::render()
                     leds[i] = ColorFromPalette(current_palette, plasma_combined);
                 }
                 
-                controller->showLeds(active_scene_.brightness);
+                show_leds_(controller, active_scene_.brightness);
             }
             plasma_offset_ += 2;
         }
@@ -955,7 +1009,7 @@ void LightShow::render()
                     leds[i] = ColorFromPalette(current_palette, blob_influence);
                 }
                 
-                controller->showLeds(active_scene_.brightness);
+                show_leds_(controller, active_scene_.brightness);
             }
         }
         break;
@@ -982,7 +1036,7 @@ void LightShow::render()
                     leds[i] = ColorFromPalette(current_palette, aurora_intensity);
                 }
                 
-                controller->showLeds(active_scene_.brightness);
+                show_leds_(controller, active_scene_.brightness);
             }
             
             noise_x_ += 0.1;
@@ -1001,7 +1055,7 @@ void LightShow::render()
                 // Lightning flash
                 for (auto &controller : led_controllers_)
                 {
-                    controller->showColor(CRGB::White, controller->size(), active_scene_.scenes.lightning_storm.flash_intensity);
+                    show_color_(controller, CRGB::White, active_scene_.scenes.lightning_storm.flash_intensity);
                 }
                 frame_number_ = 3; // Flash duration
             }
@@ -1011,7 +1065,7 @@ void LightShow::render()
                 for (auto &controller : led_controllers_)
                 {
                     uint8_t fade_intensity = (active_scene_.scenes.lightning_storm.flash_intensity * frame_number_) / 3;
-                    controller->showColor(CRGB::White, controller->size(), fade_intensity);
+                    show_color_(controller, CRGB::White, fade_intensity);
                 }
                 frame_number_--;
             }
@@ -1035,7 +1089,7 @@ void LightShow::render()
                         }
                     }
                     
-                    controller->showLeds(active_scene_.brightness);
+                    show_leds_(controller, active_scene_.brightness);
                 }
             }
         }
@@ -1070,7 +1124,7 @@ void LightShow::render()
                     leds[i] = ColorFromPalette(current_palette, explosion_intensity + hue_);
                 }
                 
-                controller->showLeds(active_scene_.brightness);
+                show_leds_(controller, active_scene_.brightness);
             }
             
             // Create new explosion occasionally
@@ -1108,7 +1162,7 @@ void LightShow::render()
                     leds[i] = ColorFromPalette(current_palette, final_intensity + hue_);
                 }
                 
-                controller->showLeds(active_scene_.brightness);
+                show_leds_(controller, active_scene_.brightness);
             }
             
             spiral_angle_ += 2;
@@ -1302,7 +1356,7 @@ void LightShow::setup_palette_stream_(bool direction)
 // Set the primary palette to a predefined palette
 void LightShow::setPrimaryPalette(AvailablePalettes palette)
 {
-    Serial.println("Setting primary palette");
+    BMLOG_DEBUG("LightShow", "Setting primary palette");
     primary_palette_ = getPalette(palette);
     current_palette_ = palette;
 }
@@ -295,6 +295,22 @@ public:
     void setPrimaryPalette(size_t index);
     LightScene getCurrentScene() const;
 
+    // What each strip last showed, for previews. Scenes that show one color
+    // (solid, strobe, lightning flashes...) never write the strip's pixels,
+    // so that color is kept here instead: leds is nullptr and color holds it.
+    // Either way the strip is shown at brightness.
+    struct ShownStrip
+    {
+        const CRGB *leds;
+        uint16_t count;
+        CRGB color;
+        uint8_t brightness;
+    };
+    size_t getStripCount() const { return led_controllers_.size(); }
+    ShownStrip getShownStrip(size_t index) const;
+    // Counts every strip shown, so a reader can tell a new frame went out
+    uint32_t getShowCount() const { return show_count_; }
+
     // --- Static mapping functions for effect/palette names <-> enums ---
     static LightSceneID effectNameToId(const char* name);
     static const char* effectIdToName(LightSceneID id);
@@ -306,7 +322,12 @@ private:
     void setup_breathe_palette_(uint8_t dimness, CRGB color);
     void setup_spectrum_stream_();
     void setup_palette_stream_(bool direction);
+    void show_leds_(CLEDController *controller, uint8_t brightness);
+    void show_color_(CLEDController *controller, const CRGB &color, uint8_t brightness);
+    void record_show_(CLEDController *controller, const CRGB *leds, const CRGB &color, uint8_t brightness);
     std::vector<CLEDController *> led_controllers_;
+    std::vector<ShownStrip> shown_;     // Parallel to led_controllers_
+    uint32_t show_count_;
     LightScene active_scene_;
     bool scene_changed_;
     unsigned long last_render_time_;
@@ -1,4 +1,5 @@
 #include "LocationService.h"
+#include "BMLog.h"
 
 #if LOCATION_SERVICE_ENABLED
 #include <time.h>
@@ -9,7 +10,9 @@ LocationService::LocationService() : initial_gps_sample_acquired_(false),
                                      speed_history_index_(0),
                                      gpsSerial(2),
                                      last_logged_speed_(0),
-                                     last_gps_log_time_(0)
+                                     last_gps_log_time_(0),
+                                     probe_due_time_(0),
+                                     probed_(true)
 {
     for (size_t i = 0; i < SPEED_HISTORY_SIZE; i++)
     {
@@ -19,43 +22,31 @@ LocationService::LocationService() : initial_gps_sample_acquired_(false),
 
 void LocationService::start_tracking_position()
 {
-    Serial.printf("[LocationService] Starting GPS tracking on pins RX:%d TX:%d @ 9600 baud\n", GPS_RX_PIN, GPS_TX_PIN);
+    BMLOG_INFO("LocationService", "Starting GPS tracking on pins RX:%d TX:%d @ 9600 baud", GPS_RX_PIN, GPS_TX_PIN);
     gpsSerial.begin(9600, SERIAL_8N1, GPS_RX_PIN, GPS_TX_PIN);
     
-    // Give GPS module more time to initialize
-    Serial.println("[LocationService] Waiting for GPS module to initialize...");
-    delay(2000); // Increased from 1000ms to 2000ms
+    // The module takes a while to start talking; update_position() checks
+    // what it said once it has had GPS_PROBE_DELAY, instead of waiting here
+    probe_due_time_ = millis() + GPS_PROBE_DELAY;
+    probed_ = false;
     
-    int available = gpsSerial.available();
-    Serial.printf("[LocationService] GPS initialized. %d bytes available after 2 seconds\n", available);
+    BMLOG_INFO("LocationService", "GPS tracking started. Waiting for satellite fix...");
+    BMLOG_INFO("LocationService", "Note: First fix can take 30-60 seconds outdoors with clear sky view");
+}
+
+void LocationService::probe()
+{
+    unsigned long chars = gps.charsProcessed();
+    BMLOG_INFO("LocationService", "GPS initialized. %lu chars received in the first %d ms", chars, GPS_PROBE_DELAY);
     
-    if (available > 0) {
-        Serial.println("[LocationService] GPS is receiving data!");
-        
-        // Read and display first few bytes to verify data format
-        String initialData = "";
-        int charCount = 0;
-        while (gpsSerial.available() > 0 && charCount < 100) {
-            char c = gpsSerial.read();
-            initialData += c;
-            charCount++;
-        }
-        
-        Serial.printf("[LocationService] Initial GPS data (%d chars): %s\n", charCount, initialData.c_str());
-        
-        // Check if data looks like valid NMEA
-        if (initialData.indexOf("$GP") >= 0 || initialData.indexOf("$GN") >= 0 || initialData.indexOf("$GL") >= 0) {
-            Serial.println("[LocationService] *** VALID NMEA DATA DETECTED! ***");
-        } else {
-            Serial.println("[LocationService] WARNING: Data doesn't look like valid NMEA sentences");
-        }
+    if (chars == 0) {
+        BMLOG_WARN("LocationService", "No GPS data detected on initialization");
+        BMLOG_WARN("LocationService", "Check wiring: RX->TX, TX->RX, VCC->3.3V, GND->GND");
+    } else if (gps.passedChecksum() == 0 && gps.failedChecksum() > 0) {
+        BMLOG_WARN("LocationService", "Data doesn't look like valid NMEA sentences");
     } else {
-        Serial.println("[LocationService] WARNING: No GPS data detected on initialization");
-        Serial.println("[LocationService] Check wiring: RX->TX, TX->RX, VCC->3.3V, GND->GND");
+        BMLOG_DEBUG("LocationService", "GPS is receiving data (%u good sentences)", (unsigned)gps.passedChecksum());
     }
-    
-    Serial.println("[LocationService] GPS tracking started. Waiting for satellite fix...");
-    Serial.println("[LocationService] Note: First fix can take 30-60 seconds outdoors with clear sky view");
 }
 
 void LocationService::update_position()
@@ -87,7 +78,7 @@ void LocationService::update_position()
 
                 if (!initial_gps_sample_acquired_)
                 {
-                    Serial.println("[LocationService] Initial GPS position acquired");
+                    BMLOG_INFO("LocationService", "Initial GPS position acquired");
                     initial_position_ = current_position_;
                     initial_gps_sample_acquired_ = true;
                 }
@@ -110,8 +101,8 @@ void LocationService::update_position()
                 bool time_to_log = (now - last_gps_log_time_) > 30000; // Every 30 seconds
                 
                 if (position_changed || speed_changed || time_to_log || last_gps_log_time_ == 0) {
-                    Serial.printf("[LocationService] GPS fix: %.6f, %.6f, speed: %.2f km/h\n", 
-                                 current_position_.latitude(), current_position_.longitude(), current_speed_);
+                    BMLOG_DEBUG("LocationService", "GPS fix: %.6f, %.6f, speed: %.2f km/h",
+                                current_position_.latitude(), current_position_.longitude(), current_speed_);
                     
                     // Update last logged values
                     last_logged_position_ = current_position_;
@@ -122,36 +113,39 @@ void LocationService::update_position()
         }
     }
     
+    if (!probed_ && (long)(now - probe_due_time_) >= 0) {
+        probed_ = true;
+        probe();
+    }
+    
     // Enhanced debug output every 60 seconds
     if (now - lastDebug > 60000) {
-        Serial.printf("[LocationService] Debug - Bytes read: %d, Total chars: %lu, Satellites: %d, Sentences: %lu, Failed: %lu\n",
-                     bytesRead, totalChars, gps.satellites.value(), gps.sentencesWithFix(), gps.failedChecksum());
+        BMLOG_DEBUG("LocationService", "Debug - Bytes read: %d, Total chars: %lu, Satellites: %u, Sentences: %u, Failed: %u",
+                    bytesRead, totalChars, (unsigned)gps.satellites.value(), (unsigned)gps.sentencesWithFix(),
+                    (unsigned)gps.failedChecksum());
         
         // Additional GPS status information
-        Serial.printf("[LocationService] GPS Status - Location valid: %s, Date valid: %s, Time valid: %s\n",
-                     gps.location.isValid() ? "YES" : "NO",
-                     gps.date.isValid() ? "YES" : "NO", 
-                     gps.time.isValid() ? "YES" : "NO");
+        BMLOG_DEBUG("LocationService", "GPS Status - Location valid: %s, Date valid: %s, Time valid: %s",
+                    gps.location.isValid() ? "YES" : "NO",
+                    gps.date.isValid() ? "YES" : "NO", 
+                    gps.time.isValid() ? "YES" : "NO");
         
         if (gps.satellites.isValid()) {
-            Serial.printf("[LocationService] Satellites in view: %d\n", gps.satellites.value());
+            BMLOG_DEBUG("LocationService", "Satellites in view: %d", gps.satellites.value());
         }
         
         if (gps.hdop.isValid()) {
-            Serial.printf("[LocationService] HDOP (Horizontal Dilution of Precision): %.1f\n", gps.hdop.hdop());
+            BMLOG_DEBUG("LocationService", "HDOP (Horizontal Dilution of Precision): %.1f", gps.hdop.hdop());
         }
         
         if (gps.altitude.isValid()) {
-            Serial.printf("[LocationService] Altitude: %.1f meters\n", gps.altitude.meters());
+            BMLOG_DEBUG("LocationService", "Altitude: %.1f meters", gps.altitude.meters());
         }
         
         // Provide helpful guidance
         if (!gps.location.isValid()) {
-            Serial.println("[LocationService] No GPS fix yet. This is normal if:");
-            Serial.println("  - Device is indoors or has limited sky view");
-            Serial.println("  - GPS module is still acquiring satellites (can take 30-60 seconds)");
-            Serial.println("  - This is the first time using the GPS module");
-            Serial.println("  - Move device outdoors with clear sky view for best results");
+            BMLOG_DEBUG("LocationService", "No GPS fix yet. Normal indoors or while acquiring satellites "
+                                           "(30-60 seconds, longer the first time); move outdoors with a clear sky view");
         }
         
         lastDebug = now;
@@ -165,9 +159,9 @@ void LocationService::update_position()
             // Only log if satellite count changed significantly or is 0
             if (satCount != lastSatCount && (abs(satCount - lastSatCount) > 2 || satCount == 0 || lastSatCount == -1)) {
                 if (satCount > 0) {
-                    Serial.printf("[LocationService] Satellites in view: %d\n", satCount);
+                    BMLOG_DEBUG("LocationService", "Satellites in view: %d", satCount);
                 } else {
-                    Serial.println("[LocationService] No satellites detected - check antenna and sky view");
+                    BMLOG_WARN("LocationService", "No satellites detected - check antenna and sky view");
                 }
                 lastSatCount = satCount;
             }
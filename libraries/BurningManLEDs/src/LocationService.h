@@ -12,6 +12,7 @@
 
 #define SPEED_HISTORY_SIZE 10
 #define GPS_SAMPLE_INTERVAL 1000
+#define GPS_PROBE_DELAY 2000 // Before checking that the module sends NMEA
 #define TIMEZONE_OFFSET (7 * 60 * 60) // GMT-7
 
 
@@ -23,6 +24,8 @@ class LocationService
 {
 public:
     LocationService();
+    // Starts the GPS UART and returns; update_position() reports whether the
+    // module is talking once it has had GPS_PROBE_DELAY
     void start_tracking_position();
     void update_position();
     bool is_initial_position_available() { return initial_gps_sample_acquired_; }
@@ -35,6 +38,8 @@ public:
     void update_time(int year, int month, int day, int hour, int minute, int second);
 
 private:
+    void probe();
+
     bool initial_gps_sample_acquired_;
     unsigned long latest_gps_sample_time_;
     Position initial_position_;
@@ -49,6 +54,9 @@ private:
     Position last_logged_position_;
     float last_logged_speed_;
     unsigned long last_gps_log_time_;
+    
+    unsigned long probe_due_time_;
+    bool probed_;
 };
 #endif // LOCATION_SERVICE_ENABLED
 
@@ -0,0 +1,262 @@
+#include <Arduino.h>
+#include "MeshRelay.h"
+#include <string.h>
+
+static const uint8_t RELAY_BROADCAST_ADDRESS[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+MeshRelay::MeshRelay() : started_(false),
+                         group_id_(0),
+                         ttl_(MESH_RELAY_DEFAULT_TTL),
+                         sequence_(0),
+                         rng_state_(1),
+                         seen_count_(0),
+                         seen_next_(0),
+                         queue_head_(0),
+                         queue_tail_(0)
+{
+    memset(own_mac_, 0, sizeof(own_mac_));
+    memset(seen_, 0, sizeof(seen_));
+    memset(pending_, 0, sizeof(pending_));
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void MeshRelay::begin(const uint8_t *own_mac, uint16_t group_id)
+{
+    memcpy(own_mac_, own_mac, 6);
+    group_id_ = group_id;
+    // Props next to each other must not draw the same backoffs
+    rng_state_ = micros() ^ ((uint32_t)own_mac[3] << 24 | (uint32_t)own_mac[4] << 16 | own_mac[5] << 8) ^ 0x9E3779B9;
+    if (rng_state_ == 0)
+    {
+        rng_state_ = 1;
+    }
+    started_ = true;
+}
+
+bool MeshRelay::send(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+    if (!started_ || len > MESH_RELAY_MAX_PAYLOAD)
+    {
+        return false;
+    }
+    uint8_t frame[MESH_RELAY_HEADER_SIZE + MESH_RELAY_MAX_PAYLOAD];
+    sequence_++;
+    frame[0] = MESH_RELAY_MAGIC;
+    frame[1] = MESH_RELAY_VERSION;
+    frame[2] = ttl_;
+    frame[3] = 0;
+    frame[4] = group_id_ & 0xFF;
+    frame[5] = group_id_ >> 8;
+    frame[6] = sequence_ & 0xFF;
+    frame[7] = sequence_ >> 8;
+    memcpy(frame + 8, own_mac_, 6);
+    memcpy(frame + 14, mac, 6);
+    memcpy(frame + MESH_RELAY_HEADER_SIZE, data, len);
+
+    // Our own message coming back from a relay is not news
+    remember(own_mac_, sequence_, 0xFF);
+    stats_.sent++;
+    return send_ && send_(RELAY_BROADCAST_ADDRESS, frame, MESH_RELAY_HEADER_SIZE + len);
+}
+
+void MeshRelay::update()
+{
+    if (!started_)
+    {
+        return;
+    }
+    uint32_t now = millis();
+
+    uint8_t head = queue_head_.load(std::memory_order_relaxed);
+    while (head != queue_tail_.load(std::memory_order_acquire))
+    {
+        process(queue_[head], now);
+        head = (head + 1) % MESH_RELAY_QUEUE_SIZE;
+        queue_head_.store(head, std::memory_order_release);
+    }
+
+    for (uint8_t i = 0; i < MESH_RELAY_MAX_PENDING; i++)
+    {
+        Pending &pending = pending_[i];
+        if (pending.active && (int32_t)(now - pending.due_ms) >= 0)
+        {
+            pending.active = false;
+            if (send_)
+            {
+                send_(RELAY_BROADCAST_ADDRESS, pending.frame.data, pending.frame.len);
+            }
+            stats_.relayed++;
+        }
+    }
+}
+
+bool MeshRelay::isRelayMessage(const uint8_t *data, size_t len)
+{
+    return len >= MESH_RELAY_HEADER_SIZE && data[0] == MESH_RELAY_MAGIC;
+}
+
+bool MeshRelay::handleMessage(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+    if (!isRelayMessage(data, len))
+    {
+        return false;
+    }
+    if (data[1] != MESH_RELAY_VERSION || len > sizeof(Frame::data))
+    {
+        stats_.rejected++;
+        return true;
+    }
+
+    uint8_t tail = queue_tail_.load(std::memory_order_relaxed);
+    uint8_t next = (tail + 1) % MESH_RELAY_QUEUE_SIZE;
+    if (next == queue_head_.load(std::memory_order_acquire))
+    {
+        // Another relay of the same message may still get through
+        stats_.queue_overflows++;
+        return true;
+    }
+
+    Frame &frame = queue_[tail];
+    memcpy(frame.from, mac, 6);
+    frame.len = len;
+    memcpy(frame.data, data, len);
+    queue_tail_.store(next, std::memory_order_release);
+    return true;
+}
+
+void MeshRelay::process(const Frame &frame, uint32_t now)
+{
+    const uint8_t *data = frame.data;
+    uint16_t group_id = data[4] | (uint16_t)(data[5] << 8);
+    if (group_id != group_id_)
+    {
+        stats_.rejected++;
+        return;
+    }
+    const uint8_t *origin = data + 8;
+    const uint8_t *destination = data + 14;
+    uint16_t sequence = sequenceOf(data);
+
+    int index = findPending(origin, sequence);
+    if (index >= 0)
+    {
+        stats_.duplicates++;
+        Pending &pending = pending_[index];
+        if (data[2] > pending.frame.data[2] + 1)
+        {
+            // A shorter path caught up; relay with its hops left
+            pending.frame.data[2] = data[2] - 1;
+            pending.frame.data[3] = data[3] + 1;
+        }
+        // Only a neighbour as far from the origin as us covered who we would
+        // reach; copies from closer in (even the origin repeating) don't count
+        if (data[3] >= pending.frame.data[3] && ++pending.copies >= MESH_RELAY_SUPPRESS_COPIES)
+        {
+            pending.active = false;
+            stats_.suppressed++;
+        }
+        return;
+    }
+    index = findSeen(origin, sequence);
+    if (index >= 0)
+    {
+        stats_.duplicates++;
+        // We first heard it the long way round, with fewer hops left than
+        // this copy has: our relay (or lack of one) stopped short
+        if (data[2] > seen_[index].ttl && memcmp(destination, own_mac_, 6) != 0)
+        {
+            seen_[index].ttl = data[2];
+            schedule(frame, now);
+        }
+        return;
+    }
+    remember(origin, sequence, data[2]);
+
+    bool for_us = memcmp(destination, own_mac_, 6) == 0;
+    if (for_us || memcmp(destination, RELAY_BROADCAST_ADDRESS, 6) == 0)
+    {
+        stats_.delivered++;
+        if (on_deliver_)
+        {
+            on_deliver_(origin, data + MESH_RELAY_HEADER_SIZE, frame.len - MESH_RELAY_HEADER_SIZE, frame.from, data[3]);
+        }
+    }
+    if (for_us)
+    {
+        return;
+    }
+    if (data[2] == 0)
+    {
+        stats_.expired++;
+        return;
+    }
+    schedule(frame, now);
+}
+
+void MeshRelay::schedule(const Frame &frame, uint32_t now)
+{
+    for (uint8_t i = 0; i < MESH_RELAY_MAX_PENDING; i++)
+    {
+        Pending &pending = pending_[i];
+        if (pending.active)
+        {
+            continue;
+        }
+        pending.frame = frame;
+        pending.frame.data[2]--;
+        pending.frame.data[3]++;
+        pending.due_ms = now + MESH_RELAY_MIN_DELAY + nextRandom(MESH_RELAY_JITTER + 1);
+        pending.copies = 0;
+        pending.active = true;
+        return;
+    }
+    stats_.dropped++;
+}
+
+int MeshRelay::findSeen(const uint8_t *origin, uint16_t sequence) const
+{
+    for (uint8_t i = 0; i < seen_count_; i++)
+    {
+        if (seen_[i].sequence == sequence && memcmp(seen_[i].origin, origin, 6) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void MeshRelay::remember(const uint8_t *origin, uint16_t sequence, uint8_t ttl)
+{
+    Seen &seen = seen_[seen_next_];
+    memcpy(seen.origin, origin, 6);
+    seen.sequence = sequence;
+    seen.ttl = ttl;
+    seen_next_ = (seen_next_ + 1) % MESH_RELAY_SEEN_SIZE;
+    if (seen_count_ < MESH_RELAY_SEEN_SIZE)
+    {
+        seen_count_++;
+    }
+}
+
+int MeshRelay::findPending(const uint8_t *origin, uint16_t sequence) const
+{
+    for (uint8_t i = 0; i < MESH_RELAY_MAX_PENDING; i++)
+    {
+        const Pending &pending = pending_[i];
+        if (pending.active && sequenceOf(pending.frame.data) == sequence &&
+            memcmp(pending.frame.data + 8, origin, 6) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint32_t MeshRelay::nextRandom(uint32_t range)
+{
+    // xorshift32; only used to spread relays, so quality doesn't matter
+    rng_state_ ^= rng_state_ << 13;
+    rng_state_ ^= rng_state_ >> 17;
+    rng_state_ ^= rng_state_ << 5;
+    return range ? rng_state_ % range : 0;
+}
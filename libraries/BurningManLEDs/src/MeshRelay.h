@@ -0,0 +1,153 @@
+#ifndef MESHRELAY_H
+#define MESHRELAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <functional>
+
+// Envelope around a group message that other group members rebroadcast.
+//
+//   0  magic            MESH_RELAY_MAGIC
+//   1  version          MESH_RELAY_VERSION
+//   2  ttl              relays still allowed after this copy
+//   3  hops             relays so far (0 from the origin)
+//   4  group id         u16, only this group's members relay or deliver it
+//   6  sequence         u16, per origin
+//   8  origin           MAC of the device that wrote the payload
+//  14  destination      MAC it is for; broadcast for the whole group
+//  20  payload          the message itself (scene, ack, heartbeat)
+#define MESH_RELAY_MAGIC 0xF5
+#define MESH_RELAY_VERSION 1
+#define MESH_RELAY_HEADER_SIZE 20
+#define MESH_RELAY_MAX_PAYLOAD 64       // SYNC_MAX_MESSAGE_SIZE; heartbeats are smaller
+#define MESH_RELAY_DEFAULT_TTL 5        // Relays after the origin's copy: 5 hops with one to spare for detours
+#define MESH_RELAY_SEEN_SIZE 32         // (origin, sequence) pairs remembered
+#define MESH_RELAY_MIN_DELAY 2          // ms before relaying...
+#define MESH_RELAY_JITTER 20            // ...plus up to this, so neighbours don't relay at once
+#define MESH_RELAY_SUPPRESS_COPIES 3    // Copies heard while waiting that make our relay redundant
+#define MESH_RELAY_MAX_PENDING 8        // Relays waiting out their backoff
+#define MESH_RELAY_QUEUE_SIZE 8         // Frames buffered between receive callback and update()
+
+struct MeshRelayStats
+{
+    uint32_t sent;              // Messages this device originated
+    uint32_t delivered;         // Received messages handed to the stack
+    uint32_t relayed;
+    uint32_t suppressed;        // Relays cancelled because neighbours already covered them
+    uint32_t duplicates;        // Copies of messages already seen
+    uint32_t expired;           // New messages whose ttl was used up
+    uint32_t dropped;           // Relays that found the pending list full
+    uint32_t rejected;          // Malformed or from another group
+    uint32_t queue_overflows;
+};
+
+// Optional multi-hop flooding for a group's messages.
+//
+// ESP-NOW only reaches props in radio range. A message sent through the relay
+// is wrapped in an envelope carrying its origin, a per-origin sequence number
+// and a hop budget (ttl); every group member that hears it for the first time
+// hands the payload to the stack as if the origin had sent it directly, and
+// rebroadcasts it with one hop less. A ring of recently seen (origin,
+// sequence) pairs stops copies from being delivered or relayed twice.
+//
+// Relays wait MESH_RELAY_MIN_DELAY plus a random share of MESH_RELAY_JITTER,
+// so props that heard the same frame don't all answer in the same slot. One
+// that hears MESH_RELAY_SUPPRESS_COPIES copies before its turn cancels: its
+// neighbours were covered already. In a dense group this keeps the cost to a
+// couple of extra frames per message; along a thin line of props everyone
+// still relays.
+//
+// A message for one device is flooded the same way and only delivered there.
+// Callers send to a peer they can hear directly without the relay (it gets a
+// MAC ACK that way).
+//
+// handleMessage() only queues, so it is safe in the radio receive callback;
+// delivery and relaying happen in update().
+class MeshRelay
+{
+public:
+    typedef std::function<bool(const uint8_t *mac, const uint8_t *data, size_t len)> SendFunction;
+    // origin: the device that wrote the payload; via: the neighbour we heard
+    // it from (the origin itself when relays is 0)
+    typedef std::function<void(const uint8_t *origin, const uint8_t *data, size_t len, const uint8_t *via, uint8_t relays)> DeliverFunction;
+
+    MeshRelay();
+
+    void begin(const uint8_t *own_mac, uint16_t group_id);
+    void setSendFunction(SendFunction send_function) { send_ = send_function; }
+    // Called from update(), in loop(): hand payloads on through the
+    // consumer's loop() side, not the queues the receive callback fills
+    void onDeliver(DeliverFunction callback) { on_deliver_ = callback; }
+    // Relays our messages get after our own copy
+    void setTtl(uint8_t ttl) { ttl_ = ttl; }
+    uint8_t getTtl() const { return ttl_; }
+
+    // Floods payload to mac (the broadcast address for the whole group)
+    bool send(const uint8_t *mac, const uint8_t *data, size_t len);
+
+    // Call from loop(): delivers received messages and sends due relays
+    void update();
+
+    // Returns true if the frame was a relay envelope. Safe to call from the
+    // radio receive callback.
+    bool handleMessage(const uint8_t *mac, const uint8_t *data, size_t len);
+    static bool isRelayMessage(const uint8_t *data, size_t len);
+
+    const MeshRelayStats &getStats() const { return stats_; }
+
+private:
+    struct Frame
+    {
+        uint8_t from[6];
+        uint8_t len;
+        uint8_t data[MESH_RELAY_HEADER_SIZE + MESH_RELAY_MAX_PAYLOAD];
+    };
+
+    struct Seen
+    {
+        uint8_t origin[6];
+        uint16_t sequence;
+        uint8_t ttl;            // Most hops left of any copy we heard
+    };
+
+    struct Pending
+    {
+        Frame frame;            // Already rewritten with ttl - 1, hops + 1
+        uint32_t due_ms;
+        uint8_t copies;
+        bool active;
+    };
+
+    void process(const Frame &frame, uint32_t now);
+    int findSeen(const uint8_t *origin, uint16_t sequence) const;
+    void remember(const uint8_t *origin, uint16_t sequence, uint8_t ttl);
+    int findPending(const uint8_t *origin, uint16_t sequence) const;
+    void schedule(const Frame &frame, uint32_t now);
+    uint32_t nextRandom(uint32_t range);
+
+    static uint16_t sequenceOf(const uint8_t *data) { return data[6] | (uint16_t)(data[7] << 8); }
+
+    SendFunction send_;
+    DeliverFunction on_deliver_;
+    bool started_;
+    uint8_t own_mac_[6];
+    uint16_t group_id_;
+    uint8_t ttl_;
+    uint16_t sequence_;
+    uint32_t rng_state_;
+
+    Seen seen_[MESH_RELAY_SEEN_SIZE];
+    uint8_t seen_count_;
+    uint8_t seen_next_;         // Oldest entry, overwritten next
+    Pending pending_[MESH_RELAY_MAX_PENDING];
+
+    // Single producer (receive callback), single consumer (update())
+    Frame queue_[MESH_RELAY_QUEUE_SIZE];
+    std::atomic<uint8_t> queue_head_;
+    std::atomic<uint8_t> queue_tail_;
+
+    MeshRelayStats stats_;
+};
+
+#endif // MESHRELAY_H
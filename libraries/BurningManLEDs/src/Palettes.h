@@ -500,7 +500,7 @@ DEFINE_GRADIENT_PALETTE(candy_palette){
     63, 50, 26, 255,   // Blue-Violet
     127, 255, 26, 221, // Pink
     191, 26, 52, 255,  // Blue
-    252, 255, 166, 26  // Orange
+    255, 255, 166, 26  // Orange
 };
 CRGBPalette16 candyPalette = candy_palette;
 
@@ -583,7 +583,7 @@ DEFINE_GRADIENT_PALETTE(emerald_palette){
     63, 3, 210, 44,   // Bright Green
     127, 6, 87, 0,    // Deep Green
     191, 41, 102, 35, // Olive Green
-    252, 0, 236, 170  // Aqua Green
+    255, 0, 236, 170  // Aqua Green
 };
 
 CRGBPalette16 emeraldPalette = emerald_palette;
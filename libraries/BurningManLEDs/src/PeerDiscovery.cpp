@@ -0,0 +1,272 @@
+#include <Arduino.h>
+#include "PeerDiscovery.h"
+#include <string.h>
+
+static const uint8_t BROADCAST_ADDRESS[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+// Beacons are never sent closer together than this, however many new
+// peers show up at once
+#define PEER_DISCOVERY_MIN_SPACING 100
+
+PeerDiscovery::PeerDiscovery() : started_(false),
+                                 group_id_(0),
+                                 device_type_(0),
+                                 capabilities_(0),
+                                 next_beacon_ms_(0),
+                                 last_beacon_ms_(0),
+                                 fast_beacons_left_(0),
+                                 rng_state_(1),
+                                 peer_count_(0),
+                                 queue_head_(0),
+                                 queue_tail_(0)
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void PeerDiscovery::begin(uint16_t group_id, uint8_t device_type, uint16_t capabilities)
+{
+    group_id_ = group_id;
+    device_type_ = device_type;
+    capabilities_ = capabilities;
+    rng_state_ = micros() ^ ((uint32_t)group_id << 16) ^ device_type ^ 0x9E3779B9;
+    if (rng_state_ == 0)
+    {
+        rng_state_ = 1;
+    }
+
+    // Spread the first beacon so props powered on together don't collide
+    uint32_t now = millis();
+    last_beacon_ms_ = now - PEER_DISCOVERY_MIN_SPACING;
+    next_beacon_ms_ = now + nextRandom(PEER_DISCOVERY_FAST_INTERVAL);
+    fast_beacons_left_ = PEER_DISCOVERY_FAST_BEACONS;
+    started_ = true;
+}
+
+void PeerDiscovery::setCapabilities(uint16_t capabilities)
+{
+    if (capabilities == capabilities_)
+    {
+        return;
+    }
+    capabilities_ = capabilities;
+    if (started_)
+    {
+        scheduleBeacon(millis());
+    }
+}
+
+void PeerDiscovery::update()
+{
+    if (!started_)
+    {
+        return;
+    }
+    uint32_t now = millis();
+
+    uint8_t head = queue_head_.load(std::memory_order_relaxed);
+    while (head != queue_tail_.load(std::memory_order_acquire))
+    {
+        applyBeacon(queue_[head], now);
+        head = (head + 1) % PEER_DISCOVERY_QUEUE_SIZE;
+        queue_head_.store(head, std::memory_order_release);
+    }
+
+    expirePeers(now);
+
+    if ((int32_t)(now - next_beacon_ms_) >= 0)
+    {
+        sendBeacon(now);
+    }
+}
+
+bool PeerDiscovery::isBeacon(const uint8_t *data, size_t len)
+{
+    return len >= PEER_DISCOVERY_BEACON_SIZE && data[0] == PEER_DISCOVERY_MAGIC;
+}
+
+bool PeerDiscovery::handleMessage(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+    if (!isBeacon(data, len))
+    {
+        return false;
+    }
+    if (data[1] != PEER_DISCOVERY_VERSION)
+    {
+        return true;
+    }
+
+    uint8_t tail = queue_tail_.load(std::memory_order_relaxed);
+    uint8_t next = (tail + 1) % PEER_DISCOVERY_QUEUE_SIZE;
+    if (next == queue_head_.load(std::memory_order_acquire))
+    {
+        // The peer beacons again in a second
+        stats_.queue_overflows++;
+        return true;
+    }
+
+    Beacon &beacon = queue_[tail];
+    memcpy(beacon.mac, mac, 6);
+    beacon.group_id = data[2] | (uint16_t)(data[3] << 8);
+    beacon.device_type = data[4];
+    beacon.capabilities = data[5] | (uint16_t)(data[6] << 8);
+    queue_tail_.store(next, std::memory_order_release);
+    return true;
+}
+
+const PeerInfo *PeerDiscovery::findPeer(const uint8_t *mac) const
+{
+    int index = findIndex(mac);
+    return index < 0 ? nullptr : &peers_[index];
+}
+
+uint8_t PeerDiscovery::countGroupPeers(uint16_t group_id) const
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < peer_count_; i++)
+    {
+        count += peers_[i].group_id == group_id;
+    }
+    return count;
+}
+
+void PeerDiscovery::sendBeacon(uint32_t now)
+{
+    uint8_t beacon[PEER_DISCOVERY_BEACON_SIZE] = {
+        PEER_DISCOVERY_MAGIC,
+        PEER_DISCOVERY_VERSION,
+        (uint8_t)(group_id_ & 0xFF),
+        (uint8_t)(group_id_ >> 8),
+        device_type_,
+        (uint8_t)(capabilities_ & 0xFF),
+        (uint8_t)(capabilities_ >> 8)};
+    if (send_)
+    {
+        send_(BROADCAST_ADDRESS, beacon, sizeof(beacon));
+    }
+    stats_.beacons_sent++;
+    last_beacon_ms_ = now;
+
+    if (fast_beacons_left_ > 0)
+    {
+        fast_beacons_left_--;
+        next_beacon_ms_ = now + PEER_DISCOVERY_FAST_INTERVAL;
+    }
+    else
+    {
+        next_beacon_ms_ = now + PEER_DISCOVERY_INTERVAL * 4 / 5 + nextRandom(PEER_DISCOVERY_INTERVAL * 2 / 5);
+    }
+}
+
+void PeerDiscovery::applyBeacon(const Beacon &beacon, uint32_t now)
+{
+    stats_.beacons_received++;
+
+    int index = findIndex(beacon.mac);
+    if (index >= 0)
+    {
+        PeerInfo &peer = peers_[index];
+        peer.last_seen_ms = now;
+        if (peer.group_id != beacon.group_id || peer.device_type != beacon.device_type ||
+            peer.capabilities != beacon.capabilities)
+        {
+            peer.group_id = beacon.group_id;
+            peer.device_type = beacon.device_type;
+            peer.capabilities = beacon.capabilities;
+            if (on_added_)
+            {
+                on_added_(peer);
+            }
+        }
+        return;
+    }
+
+    if (peer_count_ == PEER_DISCOVERY_MAX_PEERS)
+    {
+        // Only our own group may push out the stalest peer of another group
+        int oldest = -1;
+        for (uint8_t i = 0; beacon.group_id == group_id_ && i < peer_count_; i++)
+        {
+            if (peers_[i].group_id != group_id_ &&
+                (oldest < 0 || (int32_t)(peers_[oldest].last_seen_ms - peers_[i].last_seen_ms) > 0))
+            {
+                oldest = i;
+            }
+        }
+        if (oldest < 0)
+        {
+            stats_.table_full++;
+            return;
+        }
+        stats_.evictions++;
+        removePeer(oldest);
+    }
+
+    PeerInfo &peer = peers_[peer_count_++];
+    memcpy(peer.mac, beacon.mac, 6);
+    peer.group_id = beacon.group_id;
+    peer.device_type = beacon.device_type;
+    peer.capabilities = beacon.capabilities;
+    peer.last_seen_ms = now;
+    if (on_added_)
+    {
+        on_added_(peer);
+    }
+
+    // The newcomer doesn't know us yet; answer before our next regular beacon
+    scheduleBeacon(now + 10 + nextRandom(PEER_DISCOVERY_REPLY_DELAY));
+}
+
+void PeerDiscovery::expirePeers(uint32_t now)
+{
+    for (int i = peer_count_ - 1; i >= 0; i--)
+    {
+        if ((int32_t)(now - peers_[i].last_seen_ms) > PEER_DISCOVERY_TIMEOUT)
+        {
+            removePeer(i);
+        }
+    }
+}
+
+void PeerDiscovery::removePeer(uint8_t index)
+{
+    PeerInfo removed = peers_[index];
+    peers_[index] = peers_[--peer_count_];
+    if (on_removed_)
+    {
+        on_removed_(removed);
+    }
+}
+
+int PeerDiscovery::findIndex(const uint8_t *mac) const
+{
+    for (uint8_t i = 0; i < peer_count_; i++)
+    {
+        if (memcmp(peers_[i].mac, mac, 6) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void PeerDiscovery::scheduleBeacon(uint32_t at)
+{
+    uint32_t earliest = last_beacon_ms_ + PEER_DISCOVERY_MIN_SPACING;
+    if ((int32_t)(at - earliest) < 0)
+    {
+        at = earliest;
+    }
+    if ((int32_t)(at - next_beacon_ms_) < 0)
+    {
+        next_beacon_ms_ = at;
+    }
+}
+
+uint32_t PeerDiscovery::nextRandom(uint32_t range)
+{
+    // xorshift32; only used to spread beacons, so quality doesn't matter
+    rng_state_ ^= rng_state_ << 13;
+    rng_state_ ^= rng_state_ >> 17;
+    rng_state_ ^= rng_state_ << 5;
+    return range ? rng_state_ % range : 0;
+}
@@ -0,0 +1,132 @@
+#ifndef PEERDISCOVERY_H
+#define PEERDISCOVERY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <functional>
+
+#define PEER_DISCOVERY_MAGIC 0xD5
+#define PEER_DISCOVERY_VERSION 1
+#define PEER_DISCOVERY_BEACON_SIZE 7
+#define PEER_DISCOVERY_MAX_PEERS 32
+#define PEER_DISCOVERY_INTERVAL 1000        // ms between beacons (+/- 20% jitter)
+#define PEER_DISCOVERY_FAST_INTERVAL 250    // ms between the first beacons after boot
+#define PEER_DISCOVERY_FAST_BEACONS 4
+#define PEER_DISCOVERY_REPLY_DELAY 150      // Max ms before answering a new peer with a beacon
+#define PEER_DISCOVERY_TIMEOUT 4500         // ms without a beacon before a peer is dropped
+#define PEER_DISCOVERY_QUEUE_SIZE 16        // Beacons buffered between receive callback and update()
+
+// What a device can do; sent in every beacon
+#define PEER_CAP_LEDS 0x0001
+#define PEER_CAP_SOUND 0x0002
+#define PEER_CAP_GPS 0x0004
+#define PEER_CAP_BLE_CONTROL 0x0008
+#define PEER_CAP_TIME_MASTER 0x0010
+
+struct PeerInfo
+{
+    uint8_t mac[6];
+    uint8_t device_type;
+    uint16_t group_id;
+    uint16_t capabilities;
+    uint32_t last_seen_ms;
+};
+
+struct PeerDiscoveryStats
+{
+    uint32_t beacons_sent;
+    uint32_t beacons_received;
+    uint32_t queue_overflows;
+    uint32_t evictions;         // Other groups' peers dropped to make room
+    uint32_t table_full;        // Beacons ignored because the table was full
+};
+
+// Soft-state membership over broadcast beacons.
+//
+// Every device broadcasts a 7-byte beacon (owner group, device type,
+// capability bits) about once a second, faster right after boot and shortly
+// after hearing a peer it didn't know, so a newcomer fills its table within a
+// couple of beacon intervals. Peers that stay silent for
+// PEER_DISCOVERY_TIMEOUT are dropped.
+//
+// The table is a flat array scanned linearly; at this size that beats any
+// tree or hash and never allocates. When it is full, peers from other groups
+// make room for peers from our own group.
+//
+// handleMessage() only queues beacons, so it is safe in the radio receive
+// callback; the table and the added/removed callbacks are only touched from
+// update().
+class PeerDiscovery
+{
+public:
+    typedef std::function<bool(const uint8_t *mac, const uint8_t *data, size_t len)> SendFunction;
+    typedef std::function<void(const PeerInfo &peer)> PeerFunction;
+
+    PeerDiscovery();
+
+    void begin(uint16_t group_id, uint8_t device_type, uint16_t capabilities);
+    void setSendFunction(SendFunction send_function) { send_ = send_function; }
+    // Called when a peer appears or its beacon contents change
+    void onPeerAdded(PeerFunction callback) { on_added_ = callback; }
+    void onPeerRemoved(PeerFunction callback) { on_removed_ = callback; }
+    // Announced right away so peers see the change without waiting
+    void setCapabilities(uint16_t capabilities);
+    uint16_t getCapabilities() const { return capabilities_; }
+
+    // Call from loop(): sends beacons, applies received ones, expires peers
+    void update();
+
+    // Returns true if the message was a beacon. Safe to call from the radio
+    // receive callback.
+    bool handleMessage(const uint8_t *mac, const uint8_t *data, size_t len);
+    static bool isBeacon(const uint8_t *data, size_t len);
+
+    uint8_t getPeerCount() const { return peer_count_; }
+    const PeerInfo &getPeer(uint8_t index) const { return peers_[index]; }
+    const PeerInfo *findPeer(const uint8_t *mac) const;
+    uint8_t countGroupPeers(uint16_t group_id) const;
+    const PeerDiscoveryStats &getStats() const { return stats_; }
+
+private:
+    struct Beacon
+    {
+        uint8_t mac[6];
+        uint8_t device_type;
+        uint16_t group_id;
+        uint16_t capabilities;
+    };
+
+    void sendBeacon(uint32_t now);
+    void applyBeacon(const Beacon &beacon, uint32_t now);
+    void expirePeers(uint32_t now);
+    void removePeer(uint8_t index);
+    int findIndex(const uint8_t *mac) const;
+    void scheduleBeacon(uint32_t at);
+    uint32_t nextRandom(uint32_t range);
+
+    SendFunction send_;
+    PeerFunction on_added_;
+    PeerFunction on_removed_;
+    bool started_;
+    uint16_t group_id_;
+    uint8_t device_type_;
+    uint16_t capabilities_;
+
+    uint32_t next_beacon_ms_;
+    uint32_t last_beacon_ms_;
+    uint8_t fast_beacons_left_;
+    uint32_t rng_state_;
+
+    PeerInfo peers_[PEER_DISCOVERY_MAX_PEERS];
+    uint8_t peer_count_;
+
+    // Single producer (receive callback), single consumer (update())
+    Beacon queue_[PEER_DISCOVERY_QUEUE_SIZE];
+    std::atomic<uint8_t> queue_head_;
+    std::atomic<uint8_t> queue_tail_;
+
+    PeerDiscoveryStats stats_;
+};
+
+#endif // PEERDISCOVERY_H
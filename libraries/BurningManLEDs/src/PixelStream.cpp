@@ -0,0 +1,553 @@
+#include <Arduino.h>
+#include "PixelStream.h"
+#include <string.h>
+
+static const uint8_t STREAM_BROADCAST_ADDRESS[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+static uint8_t slicesFor(uint16_t pixels)
+{
+    return (pixels + PIXEL_STREAM_SLICE_PIXELS - 1) / PIXEL_STREAM_SLICE_PIXELS;
+}
+
+static uint8_t sliceLength(uint16_t pixels, uint8_t slice)
+{
+    uint16_t start = slice * PIXEL_STREAM_SLICE_PIXELS;
+    uint16_t left = pixels - start;
+    return left < PIXEL_STREAM_SLICE_PIXELS ? left : PIXEL_STREAM_SLICE_PIXELS;
+}
+
+// Each encoder returns the body length, or 0 if the slice doesn't fit the
+// encoding (or PIXEL_STREAM_MAX_BODY)
+
+static size_t encodePalette(const CRGB *pixels, uint8_t count, uint8_t *body)
+{
+    CRGB colors[PIXEL_STREAM_PALETTE_SIZE];
+    uint8_t indexes[PIXEL_STREAM_SLICE_PIXELS];
+    uint8_t used = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint8_t index = 0;
+        while (index < used && colors[index] != pixels[i])
+        {
+            index++;
+        }
+        if (index == used)
+        {
+            if (used == PIXEL_STREAM_PALETTE_SIZE)
+            {
+                return 0;
+            }
+            colors[used++] = pixels[i];
+        }
+        indexes[i] = index;
+    }
+
+    body[0] = used;
+    for (uint8_t i = 0; i < used; i++)
+    {
+        body[1 + 3 * i] = colors[i].r;
+        body[2 + 3 * i] = colors[i].g;
+        body[3 + 3 * i] = colors[i].b;
+    }
+    uint8_t *packed = body + 1 + 3 * used;
+    for (uint8_t i = 0; i < count; i += 2)
+    {
+        packed[i / 2] = indexes[i] | (i + 1 < count ? indexes[i + 1] << 4 : 0);
+    }
+    return 1 + 3 * used + (count + 1) / 2;
+}
+
+static size_t encodeRle(const CRGB *pixels, uint8_t count, uint8_t *body)
+{
+    size_t len = 0;
+    for (uint8_t i = 0; i < count;)
+    {
+        uint8_t run = 1;
+        while (i + run < count && pixels[i + run] == pixels[i])
+        {
+            run++;
+        }
+        if (len + 4 > PIXEL_STREAM_MAX_BODY)
+        {
+            return 0;
+        }
+        body[len++] = run;
+        body[len++] = pixels[i].r;
+        body[len++] = pixels[i].g;
+        body[len++] = pixels[i].b;
+        i += run;
+    }
+    return len;
+}
+
+static size_t encodeSparse(const CRGB *pixels, const CRGB *key, uint8_t count, uint8_t *body)
+{
+    size_t len = 0;
+    uint8_t i = 0;
+    while (true)
+    {
+        uint8_t skip = 0;
+        while (i + skip < count && pixels[i + skip] == key[i + skip])
+        {
+            skip++;
+        }
+        i += skip;
+        if (i == count)
+        {
+            return len;
+        }
+        uint8_t run = 0;
+        while (i + run < count && pixels[i + run] != key[i + run])
+        {
+            run++;
+        }
+        if (len + 2 + 3 * run > PIXEL_STREAM_MAX_BODY)
+        {
+            return 0;
+        }
+        body[len++] = skip;
+        body[len++] = run;
+        for (uint8_t j = 0; j < run; j++, i++)
+        {
+            body[len++] = pixels[i].r;
+            body[len++] = pixels[i].g;
+            body[len++] = pixels[i].b;
+        }
+    }
+}
+
+static size_t encodeNibble(const CRGB *pixels, const CRGB *key, uint8_t count, uint8_t *body)
+{
+    size_t values = 3 * count;
+    memset(body, 0, (values + 1) / 2);
+    for (size_t v = 0; v < values; v++)
+    {
+        int diff = (int)pixels[v / 3].raw[v % 3] - key[v / 3].raw[v % 3];
+        if (diff < -8 || diff > 7)
+        {
+            return 0;
+        }
+        body[v / 2] |= (diff & 0x0F) << (v % 2 ? 4 : 0);
+    }
+    return (values + 1) / 2;
+}
+
+PixelStreamSender::PixelStreamSender() : group_id_(0),
+                                         keyframe_interval_(PIXEL_STREAM_KEYFRAME_INTERVAL),
+                                         key_all_(true),
+                                         frame_(0),
+                                         pixels_(0)
+{
+    memset(key_frame_, 0, sizeof(key_frame_));
+    memset(next_key_, 0, sizeof(next_key_));
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void PixelStreamSender::begin(uint16_t group_id)
+{
+    group_id_ = group_id;
+    key_all_ = true;
+}
+
+bool PixelStreamSender::sendFrame(const CRGB *leds, uint16_t count)
+{
+    if (count == 0 || count > PIXEL_STREAM_MAX_PIXELS)
+    {
+        return false;
+    }
+    if (count != pixels_)
+    {
+        // Receivers drop what they hold for the old size; start them over
+        pixels_ = count;
+        key_all_ = true;
+    }
+    frame_++;
+
+    uint8_t slices = slicesFor(count);
+    uint8_t message[PIXEL_STREAM_MAX_MESSAGE];
+    bool sent = true;
+    for (uint8_t slice = 0; slice < slices; slice++)
+    {
+        uint16_t start = slice * PIXEL_STREAM_SLICE_PIXELS;
+        uint8_t length = sliceLength(count, slice);
+        bool key_due = key_all_ || (int16_t)(frame_ - next_key_[slice]) >= 0;
+
+        PixelEncoding encoding;
+        size_t body = encodeSlice(leds + start, key_due ? nullptr : key_ + start, length,
+                                  message + PIXEL_STREAM_HEADER_SIZE, encoding);
+        if (encoding < PIXEL_ENCODING_SPARSE)
+        {
+            memcpy(key_ + start, leds + start, 3 * length);
+            key_frame_[slice] = frame_;
+            // After a full keyframe, spread the slices' next ones over the interval
+            next_key_[slice] = frame_ + keyframe_interval_ + (key_all_ ? slice * keyframe_interval_ / slices : 0);
+        }
+
+        message[0] = PIXEL_STREAM_MAGIC;
+        message[1] = PIXEL_STREAM_VERSION;
+        message[2] = group_id_ & 0xFF;
+        message[3] = group_id_ >> 8;
+        message[4] = frame_ & 0xFF;
+        message[5] = frame_ >> 8;
+        message[6] = key_frame_[slice] & 0xFF;
+        message[7] = key_frame_[slice] >> 8;
+        message[8] = count & 0xFF;
+        message[9] = count >> 8;
+        message[10] = slice;
+        message[11] = encoding;
+
+        stats_.slices++;
+        stats_.bytes += PIXEL_STREAM_HEADER_SIZE + body;
+        stats_.encodings[encoding]++;
+        if (!send_ || !send_(STREAM_BROADCAST_ADDRESS, message, PIXEL_STREAM_HEADER_SIZE + body))
+        {
+            stats_.send_failures++;
+            sent = false;
+        }
+    }
+    key_all_ = false;
+    stats_.frames++;
+    return sent;
+}
+
+size_t PixelStreamSender::encodeSlice(const CRGB *pixels, const CRGB *key, uint8_t count, uint8_t *body, PixelEncoding &encoding)
+{
+    uint8_t candidate[PIXEL_STREAM_MAX_BODY];
+    size_t len;
+
+    // Keyframe: raw, unless a palette or runs come out smaller
+    for (uint8_t i = 0; i < count; i++)
+    {
+        body[3 * i] = pixels[i].r;
+        body[3 * i + 1] = pixels[i].g;
+        body[3 * i + 2] = pixels[i].b;
+    }
+    size_t best = 3 * count;
+    encoding = PIXEL_ENCODING_RAW;
+    len = encodePalette(pixels, count, candidate);
+    if (len > 0 && len < best)
+    {
+        memcpy(body, candidate, len);
+        best = len;
+        encoding = PIXEL_ENCODING_PALETTE;
+    }
+    len = encodeRle(pixels, count, candidate);
+    if (len > 0 && len < best)
+    {
+        memcpy(body, candidate, len);
+        best = len;
+        encoding = PIXEL_ENCODING_RLE;
+    }
+    if (!key)
+    {
+        return best;
+    }
+
+    // A delta only wins if it is smaller: a keyframe of the same size also
+    // refreshes what later deltas are against
+    if (memcmp(pixels, key, 3 * count) == 0)
+    {
+        encoding = PIXEL_ENCODING_SPARSE;
+        return 0;
+    }
+    len = encodeSparse(pixels, key, count, candidate);
+    if (len > 0 && len < best)
+    {
+        memcpy(body, candidate, len);
+        best = len;
+        encoding = PIXEL_ENCODING_SPARSE;
+    }
+    len = encodeNibble(pixels, key, count, candidate);
+    if (len > 0 && len < best)
+    {
+        memcpy(body, candidate, len);
+        best = len;
+        encoding = PIXEL_ENCODING_NIBBLE;
+    }
+    return best;
+}
+
+PixelStreamReceiver::PixelStreamReceiver() : leds_(nullptr),
+                                             count_(0),
+                                             first_(0),
+                                             group_id_(0),
+                                             pixels_(0),
+                                             first_slice_(0),
+                                             last_slice_(0),
+                                             queue_head_(0),
+                                             queue_tail_(0)
+{
+    memset(has_key_, 0, sizeof(has_key_));
+    memset(has_shown_, 0, sizeof(has_shown_));
+    memset(key_frame_, 0, sizeof(key_frame_));
+    memset(shown_frame_, 0, sizeof(shown_frame_));
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void PixelStreamReceiver::begin(CRGB *leds, uint16_t count, uint16_t group_id, uint16_t first)
+{
+    leds_ = leds;
+    count_ = count;
+    first_ = first;
+    group_id_ = group_id;
+    first_slice_ = first / PIXEL_STREAM_SLICE_PIXELS;
+    last_slice_ = count ? (first + count - 1) / PIXEL_STREAM_SLICE_PIXELS : first_slice_;
+    pixels_ = 0;
+    memset(has_key_, 0, sizeof(has_key_));
+    memset(has_shown_, 0, sizeof(has_shown_));
+}
+
+bool PixelStreamReceiver::update()
+{
+    bool changed = false;
+    uint8_t head = queue_head_.load(std::memory_order_relaxed);
+    while (head != queue_tail_.load(std::memory_order_acquire))
+    {
+        if (apply(queue_[head]))
+        {
+            changed = true;
+        }
+        head = (head + 1) % PIXEL_STREAM_QUEUE_SIZE;
+        queue_head_.store(head, std::memory_order_release);
+    }
+    return changed;
+}
+
+bool PixelStreamReceiver::isPixelStreamMessage(const uint8_t *data, size_t len)
+{
+    return len >= PIXEL_STREAM_HEADER_SIZE && data[0] == PIXEL_STREAM_MAGIC;
+}
+
+bool PixelStreamReceiver::handleMessage(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+    (void)mac;
+    if (!isPixelStreamMessage(data, len))
+    {
+        return false;
+    }
+    if (data[1] != PIXEL_STREAM_VERSION || len > PIXEL_STREAM_MAX_MESSAGE)
+    {
+        stats_.rejected++;
+        return true;
+    }
+
+    uint8_t tail = queue_tail_.load(std::memory_order_relaxed);
+    uint8_t next = (tail + 1) % PIXEL_STREAM_QUEUE_SIZE;
+    if (next == queue_head_.load(std::memory_order_acquire))
+    {
+        // Like a lost slice: the next keyframe or delta repairs it
+        stats_.queue_overflows++;
+        return true;
+    }
+    queue_[tail].len = len;
+    memcpy(queue_[tail].data, data, len);
+    queue_tail_.store(next, std::memory_order_release);
+    return true;
+}
+
+bool PixelStreamReceiver::isComplete() const
+{
+    if (pixels_ == 0)
+    {
+        return false;
+    }
+    uint8_t last = slicesFor(pixels_) - 1;
+    if (last > last_slice_)
+    {
+        last = last_slice_;
+    }
+    for (uint8_t slice = first_slice_; slice <= last; slice++)
+    {
+        if (!has_key_[slice])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PixelStreamReceiver::apply(const Slice &message)
+{
+    const uint8_t *data = message.data;
+    uint16_t group_id = data[2] | (uint16_t)(data[3] << 8);
+    uint16_t frame = data[4] | (uint16_t)(data[5] << 8);
+    uint16_t key = data[6] | (uint16_t)(data[7] << 8);
+    uint16_t pixels = data[8] | (uint16_t)(data[9] << 8);
+    uint8_t slice = data[10];
+    PixelEncoding encoding = (PixelEncoding)data[11];
+    if (group_id != group_id_ || pixels == 0 || pixels > PIXEL_STREAM_MAX_PIXELS || slice >= slicesFor(pixels))
+    {
+        stats_.rejected++;
+        return false;
+    }
+    if (pixels != pixels_)
+    {
+        // The master restarted with another frame size; nothing we hold fits
+        pixels_ = pixels;
+        memset(has_key_, 0, sizeof(has_key_));
+        memset(has_shown_, 0, sizeof(has_shown_));
+    }
+    if (slice < first_slice_ || slice > last_slice_)
+    {
+        return false;
+    }
+
+    // Much older than what we show means the master restarted, not a late slice
+    int16_t age = frame - shown_frame_[slice];
+    if (has_shown_[slice] && age <= 0 && age > -PIXEL_STREAM_REORDER_WINDOW)
+    {
+        stats_.stale++;
+        return false;
+    }
+    bool keyframe = encoding < PIXEL_ENCODING_SPARSE;
+    if (!keyframe && (!has_key_[slice] || key_frame_[slice] != key))
+    {
+        stats_.missing_key++;
+        return false;
+    }
+
+    uint8_t count = sliceLength(pixels, slice);
+    CRGB decoded[PIXEL_STREAM_SLICE_PIXELS];
+    if (!decodeSlice(encoding, data + PIXEL_STREAM_HEADER_SIZE, message.len - PIXEL_STREAM_HEADER_SIZE,
+                     key_[slice], count, decoded))
+    {
+        stats_.rejected++;
+        return false;
+    }
+    if (keyframe)
+    {
+        memcpy(key_[slice], decoded, 3 * count);
+        key_frame_[slice] = frame;
+        has_key_[slice] = true;
+        stats_.keyframes++;
+    }
+    shown_frame_[slice] = frame;
+    has_shown_[slice] = true;
+    stats_.slices++;
+
+    // Only the part of the slice that falls on our pixels
+    uint16_t start = slice * PIXEL_STREAM_SLICE_PIXELS;
+    uint16_t from = start > first_ ? start : first_;
+    uint16_t to = start + count < first_ + count_ ? start + count : first_ + count_;
+    for (uint16_t p = from; p < to; p++)
+    {
+        leds_[p - first_] = decoded[p - start];
+    }
+    return to > from;
+}
+
+bool PixelStreamReceiver::decodeSlice(PixelEncoding encoding, const uint8_t *body, size_t len, const CRGB *key, uint8_t count, CRGB *pixels)
+{
+    switch (encoding)
+    {
+    case PIXEL_ENCODING_RAW:
+        if (len != 3 * (size_t)count)
+        {
+            return false;
+        }
+        for (uint8_t i = 0; i < count; i++)
+        {
+            pixels[i] = CRGB(body[3 * i], body[3 * i + 1], body[3 * i + 2]);
+        }
+        return true;
+
+    case PIXEL_ENCODING_PALETTE:
+    {
+        if (len < 1)
+        {
+            return false;
+        }
+        uint8_t used = body[0];
+        if (used == 0 || used > PIXEL_STREAM_PALETTE_SIZE || len != 1 + 3 * (size_t)used + (count + 1) / 2)
+        {
+            return false;
+        }
+        const uint8_t *packed = body + 1 + 3 * used;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            uint8_t index = (packed[i / 2] >> (i % 2 ? 4 : 0)) & 0x0F;
+            if (index >= used)
+            {
+                return false;
+            }
+            pixels[i] = CRGB(body[1 + 3 * index], body[2 + 3 * index], body[3 + 3 * index]);
+        }
+        return true;
+    }
+
+    case PIXEL_ENCODING_RLE:
+    {
+        size_t pos = 0;
+        uint8_t i = 0;
+        while (i < count)
+        {
+            if (pos + 4 > len)
+            {
+                return false;
+            }
+            uint8_t run = body[pos];
+            if (run == 0 || run > count - i)
+            {
+                return false;
+            }
+            CRGB color(body[pos + 1], body[pos + 2], body[pos + 3]);
+            for (uint8_t j = 0; j < run; j++)
+            {
+                pixels[i++] = color;
+            }
+            pos += 4;
+        }
+        return pos == len;
+    }
+
+    case PIXEL_ENCODING_SPARSE:
+    {
+        memcpy(pixels, key, 3 * count);
+        size_t pos = 0;
+        uint8_t i = 0;
+        while (pos < len)
+        {
+            if (pos + 2 > len)
+            {
+                return false;
+            }
+            uint8_t skip = body[pos];
+            uint8_t run = body[pos + 1];
+            pos += 2;
+            if (run == 0 || skip + run > count - i || pos + 3 * (size_t)run > len)
+            {
+                return false;
+            }
+            i += skip;
+            for (uint8_t j = 0; j < run; j++, pos += 3)
+            {
+                pixels[i++] = CRGB(body[pos], body[pos + 1], body[pos + 2]);
+            }
+        }
+        return true;
+    }
+
+    case PIXEL_ENCODING_NIBBLE:
+    {
+        size_t values = 3 * (size_t)count;
+        if (len != (values + 1) / 2)
+        {
+            return false;
+        }
+        for (size_t v = 0; v < values; v++)
+        {
+            int nibble = (body[v / 2] >> (v % 2 ? 4 : 0)) & 0x0F;
+            int value = key[v / 3].raw[v % 3] + (nibble >= 8 ? nibble - 16 : nibble);
+            if (value < 0 || value > 255)
+            {
+                return false;
+            }
+            pixels[v / 3].raw[v % 3] = value;
+        }
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
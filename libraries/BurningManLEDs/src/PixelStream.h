@@ -0,0 +1,167 @@
+#ifndef PIXELSTREAM_H
+#define PIXELSTREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <functional>
+#include <FastLED.h>
+
+// Rendered pixels streamed from one master to fixtures that only display
+// them. A frame is cut into slices of up to PIXEL_STREAM_SLICE_PIXELS pixels,
+// one datagram each, so every slice decodes on its own:
+//
+//   0  magic            PIXEL_STREAM_MAGIC
+//   1  version          PIXEL_STREAM_VERSION
+//   2  group id         u16, receivers only show their own group's stream
+//   4  frame            u16, counts up by one per frame
+//   6  key              u16, frame whose copy of this slice a delta is against
+//                       (the frame itself for a keyframe slice)
+//   8  pixels           u16, pixels in the whole frame
+//  10  slice            first pixel is slice * PIXEL_STREAM_SLICE_PIXELS
+//  11  encoding         PixelEncoding
+//  12  body
+//
+// Keyframe slices stand alone; delta slices are only applied on top of the
+// keyframe slice they name, never on whatever a receiver happens to show, so
+// a lost slice is repaired by the next one.
+#define PIXEL_STREAM_MAGIC 0xA5
+#define PIXEL_STREAM_VERSION 1
+#define PIXEL_STREAM_HEADER_SIZE 12
+#define PIXEL_STREAM_MAX_MESSAGE 250        // ESP_NOW_MAX_DATA_LEN
+#define PIXEL_STREAM_MAX_BODY (PIXEL_STREAM_MAX_MESSAGE - PIXEL_STREAM_HEADER_SIZE)
+#define PIXEL_STREAM_SLICE_PIXELS (PIXEL_STREAM_MAX_BODY / 3) // Raw always fits
+#define PIXEL_STREAM_MAX_SLICES 8
+#define PIXEL_STREAM_MAX_PIXELS (PIXEL_STREAM_MAX_SLICES * PIXEL_STREAM_SLICE_PIXELS)
+#define PIXEL_STREAM_PALETTE_SIZE 16        // Colors a palette slice can index (4 bits each)
+#define PIXEL_STREAM_KEYFRAME_INTERVAL 25   // Frames between keyframes of each slice
+#define PIXEL_STREAM_REORDER_WINDOW 64      // Frames a late slice can trail by; older means the master restarted
+#define PIXEL_STREAM_QUEUE_SIZE 8           // Slices buffered between receive callback and update()
+
+enum PixelEncoding : uint8_t
+{
+    // Keyframes
+    PIXEL_ENCODING_RAW = 1,         // r, g, b per pixel
+    PIXEL_ENCODING_PALETTE = 2,     // color count, colors, then a 4-bit index per pixel (low nibble first)
+    PIXEL_ENCODING_RLE = 3,         // (run length, r, g, b) until the slice is full
+    // Deltas against the keyframe slice
+    PIXEL_ENCODING_SPARSE = 4,      // (unchanged pixels to skip, changed pixels, their r, g, b...); the rest match
+    PIXEL_ENCODING_NIBBLE = 5,      // r, g, b differences in -8..7 per pixel, two per byte (low nibble first)
+    PIXEL_ENCODING_COUNT
+};
+
+struct PixelStreamSenderStats
+{
+    uint32_t frames;
+    uint32_t slices;
+    uint32_t bytes;                 // Including headers
+    uint32_t encodings[PIXEL_ENCODING_COUNT]; // Slices sent with each encoding
+    uint32_t send_failures;
+};
+
+struct PixelStreamReceiverStats
+{
+    uint32_t slices;                // Slices decoded into the pixels
+    uint32_t keyframes;
+    uint32_t stale;                 // Slices older than what is shown
+    uint32_t missing_key;           // Deltas against a keyframe we never got
+    uint32_t rejected;              // Malformed, other group or a different frame size
+    uint32_t queue_overflows;
+};
+
+// Master side: encodes each frame it is given, slice by slice, with whichever
+// encoding comes out smallest. Every slice is a keyframe once per
+// PIXEL_STREAM_KEYFRAME_INTERVAL (staggered, so slices don't all key in the
+// same frame) and whenever a delta would not be smaller than a keyframe; in
+// between it is sent as a delta against its last keyframe.
+class PixelStreamSender
+{
+public:
+    typedef std::function<bool(const uint8_t *mac, const uint8_t *data, size_t len)> SendFunction;
+
+    PixelStreamSender();
+
+    void begin(uint16_t group_id);
+    void setSendFunction(SendFunction send_function) { send_ = send_function; }
+    void setKeyframeInterval(uint8_t frames) { keyframe_interval_ = frames ? frames : 1; }
+    // The next frame is sent as keyframes only (a receiver just switched on)
+    void requestKeyframe() { key_all_ = true; }
+
+    // Broadcasts leds[0, count); false if count is out of range or a send failed
+    bool sendFrame(const CRGB *leds, uint16_t count);
+
+    const PixelStreamSenderStats &getStats() const { return stats_; }
+
+    // Encodes one slice into body; returns the body length and sets encoding.
+    // key is the slice's last keyframe, or nullptr for a keyframe.
+    static size_t encodeSlice(const CRGB *pixels, const CRGB *key, uint8_t count, uint8_t *body, PixelEncoding &encoding);
+
+private:
+    SendFunction send_;
+    uint16_t group_id_;
+    uint8_t keyframe_interval_;
+    bool key_all_;
+    uint16_t frame_;
+    uint16_t pixels_;               // Frame size the keyframes below are for
+    uint16_t key_frame_[PIXEL_STREAM_MAX_SLICES];
+    uint16_t next_key_[PIXEL_STREAM_MAX_SLICES];
+    CRGB key_[PIXEL_STREAM_MAX_PIXELS];
+    PixelStreamSenderStats stats_;
+};
+
+// Fixture side: decodes pixels [first, first + count) of the stream straight
+// into the fixture's own array. handleMessage() only queues, so it is safe in
+// the radio receive callback; update() decodes.
+class PixelStreamReceiver
+{
+public:
+    PixelStreamReceiver();
+
+    void begin(CRGB *leds, uint16_t count, uint16_t group_id, uint16_t first = 0);
+
+    // Call from loop(): returns true if the pixels changed (time to show them)
+    bool update();
+
+    // Returns true if the message was a pixel stream slice (handled or not)
+    bool handleMessage(const uint8_t *mac, const uint8_t *data, size_t len);
+    static bool isPixelStreamMessage(const uint8_t *data, size_t len);
+
+    // Whether every slice we show has had a keyframe yet
+    bool isComplete() const;
+    const PixelStreamReceiverStats &getStats() const { return stats_; }
+
+    // Decodes one slice; key is its keyframe (only read for deltas). Returns
+    // false, leaving pixels undefined, if the body is malformed.
+    static bool decodeSlice(PixelEncoding encoding, const uint8_t *body, size_t len, const CRGB *key, uint8_t count, CRGB *pixels);
+
+private:
+    struct Slice
+    {
+        uint8_t len;
+        uint8_t data[PIXEL_STREAM_MAX_MESSAGE];
+    };
+
+    bool apply(const Slice &slice);
+
+    CRGB *leds_;
+    uint16_t count_;
+    uint16_t first_;
+    uint16_t group_id_;
+    uint16_t pixels_;               // Frame size of the stream; 0 until the first slice
+    uint8_t first_slice_;
+    uint8_t last_slice_;
+    bool has_key_[PIXEL_STREAM_MAX_SLICES];
+    bool has_shown_[PIXEL_STREAM_MAX_SLICES];
+    uint16_t key_frame_[PIXEL_STREAM_MAX_SLICES];
+    uint16_t shown_frame_[PIXEL_STREAM_MAX_SLICES];
+    CRGB key_[PIXEL_STREAM_MAX_SLICES][PIXEL_STREAM_SLICE_PIXELS];
+
+    // Single producer (receive callback), single consumer (update())
+    Slice queue_[PIXEL_STREAM_QUEUE_SIZE];
+    std::atomic<uint8_t> queue_head_;
+    std::atomic<uint8_t> queue_tail_;
+
+    PixelStreamReceiverStats stats_;
+};
+
+#endif // PIXELSTREAM_H
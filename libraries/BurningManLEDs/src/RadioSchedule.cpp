@@ -0,0 +1,151 @@
+#include "RadioSchedule.h"
+#include <string.h>
+
+RadioSchedule::RadioSchedule() : share_(RADIO_SCHEDULE_DEFAULT_SHARE),
+                                 loss_(0),
+                                 started_(false),
+                                 espnow_slot_(true),
+                                 sendable_(true),
+                                 period_(0),
+                                 results_(0),
+                                 failures_(0),
+                                 queue_head_(0),
+                                 queue_count_(0)
+{
+    memset(queue_, 0, sizeof(queue_));
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void RadioSchedule::setShare(uint8_t percent)
+{
+    share_ = percent < RADIO_SCHEDULE_MIN_SHARE ? RADIO_SCHEDULE_MIN_SHARE
+           : percent > RADIO_SCHEDULE_MAX_SHARE ? RADIO_SCHEDULE_MAX_SHARE
+                                                : percent;
+}
+
+bool RadioSchedule::send(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+    // Frames queued earlier go first
+    if (sendable_)
+    {
+        drain();
+    }
+    if (sendable_ && queue_count_ == 0)
+    {
+        stats_.sent++;
+        if (!send_ || !send_(mac, data, len))
+        {
+            stats_.send_failures++;
+            return false;
+        }
+        return true;
+    }
+    if (len > RADIO_SCHEDULE_MAX_MESSAGE)
+    {
+        return false;
+    }
+
+    if (queue_count_ == RADIO_SCHEDULE_QUEUE_SIZE)
+    {
+        queue_head_ = (queue_head_ + 1) % RADIO_SCHEDULE_QUEUE_SIZE;
+        queue_count_--;
+        stats_.dropped++;
+    }
+    Frame &frame = queue_[(queue_head_ + queue_count_) % RADIO_SCHEDULE_QUEUE_SIZE];
+    memcpy(frame.mac, mac, 6);
+    frame.len = len;
+    memcpy(frame.data, data, len);
+    queue_count_++;
+    stats_.deferred++;
+    return true;
+}
+
+void RadioSchedule::recordResult(bool delivered)
+{
+    results_++;
+    if (!delivered)
+    {
+        failures_++;
+    }
+}
+
+void RadioSchedule::update(uint64_t now_us)
+{
+    uint64_t period_us = RADIO_SCHEDULE_PERIOD_MS * 1000ULL;
+    uint64_t period = now_us / period_us;
+    uint64_t phase_us = now_us % period_us;
+    uint64_t ble_us = period_us * (100 - share_) / 100;
+
+    if (!started_ || period != period_)
+    {
+        if (started_)
+        {
+            stats_.periods++;
+            if (stats_.periods % RADIO_SCHEDULE_ADAPT_PERIODS == 0)
+            {
+                adapt();
+                ble_us = period_us * (100 - share_) / 100;
+            }
+        }
+        period_ = period;
+    }
+
+    bool espnow_slot = phase_us >= ble_us;
+    // A BLE event started late in its slot may still be on the air
+    uint64_t guard_us = RADIO_SCHEDULE_GUARD_MS * 1000ULL;
+    sendable_ = phase_us >= ble_us + guard_us && phase_us + guard_us < period_us;
+    if (!started_ || espnow_slot != espnow_slot_)
+    {
+        espnow_slot_ = espnow_slot;
+        started_ = true;
+        if (on_ble_slot_)
+        {
+            on_ble_slot_(!espnow_slot_);
+        }
+    }
+
+    if (sendable_)
+    {
+        drain();
+    }
+}
+
+void RadioSchedule::drain()
+{
+    for (uint8_t i = 0; i < RADIO_SCHEDULE_DRAIN_BUDGET && queue_count_ > 0; i++)
+    {
+        const Frame &frame = queue_[queue_head_];
+        queue_head_ = (queue_head_ + 1) % RADIO_SCHEDULE_QUEUE_SIZE;
+        queue_count_--;
+        stats_.drained++;
+        if (!send_ || !send_(frame.mac, frame.data, frame.len))
+        {
+            stats_.send_failures++;
+        }
+    }
+}
+
+void RadioSchedule::adapt()
+{
+    if (results_ < RADIO_SCHEDULE_MIN_RESULTS)
+    {
+        return;
+    }
+    uint16_t results = results_.exchange(0);
+    uint16_t failures = failures_.exchange(0);
+    loss_ = failures >= results ? 100 : failures * 100 / results;
+
+    // Losses mean ESP-NOW is running into BLE (this prop's, or a neighbour's
+    // whose slot is laid out differently): back off. A clean link takes the
+    // time back.
+    if (loss_ > RADIO_SCHEDULE_LOSS_HIGH && share_ > RADIO_SCHEDULE_MIN_SHARE)
+    {
+        setShare(share_ - RADIO_SCHEDULE_SHARE_STEP);
+        stats_.narrowed++;
+    }
+    else if (loss_ < RADIO_SCHEDULE_LOSS_LOW && share_ < RADIO_SCHEDULE_MAX_SHARE)
+    {
+        setShare(share_ + RADIO_SCHEDULE_SHARE_STEP);
+        stats_.widened++;
+    }
+}
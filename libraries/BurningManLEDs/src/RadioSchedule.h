@@ -0,0 +1,117 @@
+#ifndef RADIOSCHEDULE_H
+#define RADIOSCHEDULE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <functional>
+
+// Time-slicing of the one 2.4 GHz radio between ESP-NOW and BLE.
+//
+// Every RADIO_SCHEDULE_PERIOD_MS starts with a BLE slot and ends with an
+// ESP-NOW slot, a share of the period long:
+//
+//   |<-------------------- period -------------------->|
+//   |  BLE: advertising, app  |  ESP-NOW: sync frames   |
+//
+// Periods are counted on the time update() is given. Passing the group's
+// synced clock lines the slots up across props, so everyone listens while
+// the others send. The BLE slot comes first so that props whose shares have
+// drifted apart still open it, and start advertising, at the same moment.
+//
+// Frames sent outside the ESP-NOW slot wait in a queue for the next one (the
+// oldest is dropped when it is full; the sync layers resend what matters).
+// The BLE callback opens and closes the BLE slot, where the sketch advertises
+// and sends its notifications. The share adapts to the unicast results
+// reported back (their MAC ACKs): above RADIO_SCHEDULE_LOSS_HIGH percent lost
+// ESP-NOW gets a bigger slot, below RADIO_SCHEDULE_LOSS_LOW BLE gets time back.
+//
+// No radio calls here: the caller passes the time in and supplies the send
+// and BLE functions, so the policy runs unchanged on the host.
+#define RADIO_SCHEDULE_PERIOD_MS 100
+#define RADIO_SCHEDULE_DEFAULT_SHARE 50     // % of a period ESP-NOW starts with
+#define RADIO_SCHEDULE_MIN_SHARE 20
+#define RADIO_SCHEDULE_MAX_SHARE 80
+#define RADIO_SCHEDULE_SHARE_STEP 10
+#define RADIO_SCHEDULE_ADAPT_PERIODS 10     // Periods of results per adjustment
+#define RADIO_SCHEDULE_MIN_RESULTS 5        // Fewer results keep the share
+#define RADIO_SCHEDULE_LOSS_HIGH 10         // % of unicasts lost
+#define RADIO_SCHEDULE_LOSS_LOW 2
+#define RADIO_SCHEDULE_GUARD_MS 3           // No frames sent this close to either end of the slot
+#define RADIO_SCHEDULE_QUEUE_SIZE 16
+#define RADIO_SCHEDULE_DRAIN_BUDGET 8       // Queued frames sent per update()
+#define RADIO_SCHEDULE_MAX_MESSAGE 250      // ESP_NOW_MAX_DATA_LEN
+
+struct RadioScheduleStats
+{
+    uint32_t sent;                  // Frames sent straight away, in the ESP-NOW slot
+    uint32_t deferred;              // Frames queued for the next slot
+    uint32_t drained;               // Queued frames sent
+    uint32_t dropped;               // Queued frames pushed out by newer ones
+    uint32_t send_failures;
+    uint32_t periods;
+    uint32_t widened;               // Share adjustments towards ESP-NOW
+    uint32_t narrowed;              // ...and towards BLE
+};
+
+class RadioSchedule
+{
+public:
+    typedef std::function<bool(const uint8_t *mac, const uint8_t *data, size_t len)> SendFunction;
+    typedef std::function<void(bool open)> BleSlotFunction;
+
+    RadioSchedule();
+
+    void setSendFunction(SendFunction send_function) { send_ = send_function; }
+    // Called when the BLE slot opens and closes
+    void onBleSlot(BleSlotFunction callback) { on_ble_slot_ = callback; }
+    void setShare(uint8_t percent);
+
+    // Sends now in the ESP-NOW slot, queues otherwise. Returns false only if
+    // an immediate send failed.
+    bool send(const uint8_t *mac, const uint8_t *data, size_t len);
+    // A unicast's MAC ACK, for the loss the share adapts to; safe from the
+    // radio's send callback
+    void recordResult(bool delivered);
+
+    // Call often from loop() with the current time (synced, if there is one)
+    void update(uint64_t now_us);
+
+    bool isEspNowSlot() const { return espnow_slot_; }
+    bool isBleSlot() const { return !espnow_slot_; }
+    uint8_t getShare() const { return share_; }
+    uint8_t getQueued() const { return queue_count_; }
+    // Loss over the last adjustment, in percent
+    uint8_t getLoss() const { return loss_; }
+    const RadioScheduleStats &getStats() const { return stats_; }
+
+private:
+    struct Frame
+    {
+        uint8_t mac[6];
+        uint8_t len;
+        uint8_t data[RADIO_SCHEDULE_MAX_MESSAGE];
+    };
+
+    void adapt();
+    void drain();
+
+    SendFunction send_;
+    BleSlotFunction on_ble_slot_;
+    uint8_t share_;
+    uint8_t loss_;
+    bool started_;
+    bool espnow_slot_;
+    bool sendable_;                 // In the ESP-NOW slot and clear of its guards
+    uint64_t period_;
+    std::atomic<uint16_t> results_;
+    std::atomic<uint16_t> failures_;
+
+    Frame queue_[RADIO_SCHEDULE_QUEUE_SIZE];
+    uint8_t queue_head_;
+    uint8_t queue_count_;
+
+    RadioScheduleStats stats_;
+};
+
+#endif // RADIOSCHEDULE_H
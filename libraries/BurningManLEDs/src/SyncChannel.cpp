@@ -0,0 +1,507 @@
+#include <Arduino.h>
+#include "SyncChannel.h"
+#include <string.h>
+
+static const uint8_t SYNC_BROADCAST_ADDRESS[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+SyncChannel::SyncChannel(uint16_t group_id) : group_id_(group_id),
+                                              has_leader_(false),
+                                              clock_(0),
+                                              dirty_(0),
+                                              last_send_ms_(0),
+                                              retry_at_ms_(0),
+                                              retries_(0),
+                                              retrying_(false),
+                                              receiver_count_(0),
+                                              queue_head_(0),
+                                              queue_tail_(0)
+{
+    memset(own_mac_, 0, sizeof(own_mac_));
+    memset(leader_mac_, 0, sizeof(leader_mac_));
+    memset(&scene_, 0, sizeof(scene_));
+    memset(stamps_, 0, sizeof(stamps_));
+    memset(acks_, 0, sizeof(acks_));
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void SyncChannel::begin(const uint8_t *own_mac, const LightScene &scene)
+{
+    memcpy(own_mac_, own_mac, 6);
+    scene_ = scene;
+    last_send_ms_ = millis() - SYNC_COALESCE_MS;
+}
+
+void SyncChannel::addReceiver(const uint8_t *mac)
+{
+    if (findReceiver(mac) >= 0 || receiver_count_ == SYNC_MAX_RECEIVERS)
+    {
+        return;
+    }
+    Receiver &receiver = receivers_[receiver_count_++];
+    memcpy(receiver.mac, mac, 6);
+    receiver.acked = 0;
+    receiver.has_acked = false;
+
+    // Whatever we changed before it showed up
+    if (laggingFields())
+    {
+        retrying_ = true;
+        retries_ = 0;
+        retry_at_ms_ = millis();
+    }
+}
+
+void SyncChannel::removeReceiver(const uint8_t *mac)
+{
+    int index = findReceiver(mac);
+    if (index >= 0)
+    {
+        receivers_[index] = receivers_[--receiver_count_];
+    }
+}
+
+void SyncChannel::setLeader(const uint8_t *mac)
+{
+    bool was_leading = isLeading();
+    has_leader_ = mac != nullptr;
+    if (mac)
+    {
+        memcpy(leader_mac_, mac, 6);
+    }
+    if (isLeading() && !was_leading)
+    {
+        // What we took in while following was never relayed by anyone; send
+        // everything as ours so the group starts from the new leader's state
+        for (uint8_t bit = 0; bit < 16; bit++)
+        {
+            if (stamps_[bit].sequence != 0)
+            {
+                dirty_ |= 1 << bit;
+            }
+        }
+    }
+    if (isFollowing())
+    {
+        // Discovery may not have reported it yet; its ack is the one we need
+        addReceiver(leader_mac_);
+    }
+
+    // Whatever the old leader (or the group) never acked goes to the new one
+    if (laggingFields())
+    {
+        retrying_ = true;
+        retries_ = 0;
+        retry_at_ms_ = millis();
+    }
+}
+
+void SyncChannel::submit(const LightScene &scene)
+{
+    uint16_t changed = normalize(SyncProtocol::diffScene(scene_, scene));
+    if (changed == 0)
+    {
+        return;
+    }
+    SyncProtocol::copyFields(changed, scene, scene_);
+    dirty_ |= changed;
+
+    // The first change after a quiet spell goes out right away
+    uint32_t now = millis();
+    if (now - last_send_ms_ >= SYNC_COALESCE_MS)
+    {
+        flush(now, false);
+    }
+}
+
+void SyncChannel::update()
+{
+    uint32_t now = millis();
+
+    uint8_t head = queue_head_.load(std::memory_order_relaxed);
+    while (head != queue_tail_.load(std::memory_order_acquire))
+    {
+        process(queue_[head], now);
+        head = (head + 1) % SYNC_QUEUE_SIZE;
+        queue_head_.store(head, std::memory_order_release);
+    }
+
+    sendAcks(now);
+
+    if (dirty_)
+    {
+        if (now - last_send_ms_ >= SYNC_COALESCE_MS)
+        {
+            flush(now, false);
+        }
+    }
+    else if (retrying_ && (int32_t)(now - retry_at_ms_) >= 0)
+    {
+        if (laggingFields() == 0)
+        {
+            retrying_ = false;
+        }
+        else
+        {
+            bool was_slow = retries_ == SYNC_MAX_RETRIES;
+            flush(now, true);
+            if (retries_ == SYNC_MAX_RETRIES)
+            {
+                if (!was_slow)
+                {
+                    stats_.gave_up++;
+                }
+                // Discovery drops a peer that is really gone, which ends this
+                retry_at_ms_ = now + SYNC_SLOW_RETRY_MS;
+            }
+        }
+    }
+}
+
+bool SyncChannel::handleMessage(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+    if (!SyncProtocol::isSyncMessage(data, len))
+    {
+        return false;
+    }
+    if (len > SYNC_MAX_MESSAGE_SIZE)
+    {
+        stats_.rejected++;
+        return true;
+    }
+
+    uint8_t tail = queue_tail_.load(std::memory_order_relaxed);
+    uint8_t next = (tail + 1) % SYNC_QUEUE_SIZE;
+    if (next == queue_head_.load(std::memory_order_acquire))
+    {
+        // Unacked, so the sender resends it
+        stats_.queue_overflows++;
+        return true;
+    }
+
+    Message &message = queue_[tail];
+    memcpy(message.mac, mac, 6);
+    memcpy(message.data, data, len);
+    message.len = len;
+    queue_tail_.store(next, std::memory_order_release);
+    return true;
+}
+
+bool SyncChannel::processMessage(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+    if (!SyncProtocol::isSyncMessage(data, len))
+    {
+        return false;
+    }
+    if (len > SYNC_MAX_MESSAGE_SIZE)
+    {
+        stats_.rejected++;
+        return true;
+    }
+
+    Message message;
+    memcpy(message.mac, mac, 6);
+    memcpy(message.data, data, len);
+    message.len = len;
+    process(message, millis());
+    return true;
+}
+
+void SyncChannel::process(const Message &message, uint32_t now)
+{
+    SyncHeader header;
+    if (!SyncProtocol::decodeHeader(message.data, message.len, header) || header.group_id != group_id_)
+    {
+        stats_.rejected++;
+        return;
+    }
+
+    if (header.type == SYNC_MESSAGE_ACK)
+    {
+        stats_.acks_received++;
+        int index = findReceiver(message.mac);
+        if (index >= 0)
+        {
+            Receiver &receiver = receivers_[index];
+            if (!receiver.has_acked || isAfter(header.sequence, receiver.acked))
+            {
+                receiver.acked = header.sequence;
+                receiver.has_acked = true;
+            }
+        }
+        return;
+    }
+
+    LightScene decoded = scene_;
+    if (!SyncProtocol::decodeScene(message.data, message.len, header, decoded) || header.sequence == 0)
+    {
+        stats_.rejected++;
+        return;
+    }
+    stats_.scenes_received++;
+    if (isAfter(header.sequence, clock_))
+    {
+        clock_ = header.sequence;
+    }
+    applyScene(message.mac, header, decoded);
+    // Acked even when stale: our previous ack may have been the one lost
+    queueAck(message.mac, header.sequence, now);
+}
+
+void SyncChannel::applyScene(const uint8_t *mac, const SyncHeader &header, const LightScene &decoded)
+{
+    Stamp stamp;
+    stamp.sequence = header.sequence;
+    memcpy(stamp.mac, mac, 6);
+
+    uint16_t fields = normalize(header.fields);
+    uint16_t accepted = 0;
+    for (uint8_t bit = 0; bit < 16; bit++)
+    {
+        if ((fields & (1 << bit)) && isNewer(stamp, stamps_[bit]))
+        {
+            stamps_[bit] = stamp;
+            accepted |= 1 << bit;
+        }
+    }
+    if (accepted == 0)
+    {
+        stats_.stale++;
+        return;
+    }
+
+    SyncProtocol::copyFields(accepted, decoded, scene_);
+    if (isLeading())
+    {
+        // Restamped as ours by the next flush, which orders it after
+        // everything we accepted before and sends it to the whole group.
+        // That includes another leader's writes while two overlap (after a
+        // split heals), until the election makes one step down.
+        dirty_ |= accepted;
+        stats_.relayed++;
+    }
+    else
+    {
+        // A newer write from someone else replaces our unsent one
+        dirty_ &= ~accepted;
+    }
+    if (on_scene_)
+    {
+        on_scene_(scene_, accepted);
+    }
+}
+
+void SyncChannel::queueAck(const uint8_t *mac, uint16_t sequence, uint32_t now)
+{
+    PendingAck *slot = nullptr;
+    for (uint8_t i = 0; i < SYNC_MAX_SENDERS; i++)
+    {
+        if (acks_[i].pending && memcmp(acks_[i].mac, mac, 6) == 0)
+        {
+            slot = &acks_[i];
+            break;
+        }
+        if (!slot && !acks_[i].pending)
+        {
+            slot = &acks_[i];
+        }
+    }
+    if (!slot)
+    {
+        // More senders at once than slots; free one by acking it early
+        slot = &acks_[0];
+        sendAck(*slot);
+    }
+
+    if (slot->pending && memcmp(slot->mac, mac, 6) == 0)
+    {
+        if (isAfter(sequence, slot->sequence))
+        {
+            slot->sequence = sequence;
+        }
+        // Still talking; its next message would make this ack stale
+        slot->due_ms = now + SYNC_ACK_DELAY_MS;
+        return;
+    }
+    memcpy(slot->mac, mac, 6);
+    slot->sequence = sequence;
+    slot->due_ms = now + SYNC_ACK_DELAY_MS;
+    slot->deadline_ms = now + SYNC_ACK_MAX_DELAY_MS;
+    slot->pending = true;
+}
+
+void SyncChannel::sendAcks(uint32_t now)
+{
+    for (uint8_t i = 0; i < SYNC_MAX_SENDERS; i++)
+    {
+        PendingAck &ack = acks_[i];
+        if (ack.pending && ((int32_t)(now - ack.due_ms) >= 0 || (int32_t)(now - ack.deadline_ms) >= 0))
+        {
+            sendAck(ack);
+        }
+    }
+}
+
+void SyncChannel::sendAck(PendingAck &ack)
+{
+    size_t len = SyncProtocol::encodeAck(group_id_, ack.sequence, buffer_, sizeof(buffer_));
+    if (send_ && len)
+    {
+        send_(ack.mac, buffer_, len);
+    }
+    stats_.acks_sent++;
+    ack.pending = false;
+}
+
+void SyncChannel::flush(uint32_t now, bool retransmit)
+{
+    uint16_t fields = dirty_ | laggingFields();
+    if (fields == 0)
+    {
+        return;
+    }
+
+    // A plain resend keeps its stamp, so receivers that acked it stay done
+    uint16_t sequence = 0;
+    for (uint8_t bit = 0; dirty_ == 0 && bit < 16; bit++)
+    {
+        if (fields & (1 << bit))
+        {
+            if (sequence != 0 && stamps_[bit].sequence != sequence)
+            {
+                sequence = 0;
+                break;
+            }
+            sequence = stamps_[bit].sequence;
+        }
+    }
+
+    // Otherwise everything in the message gets a new stamp, so an ack covers all of it
+    if (sequence == 0)
+    {
+        clock_++;
+        if (clock_ == 0)
+        {
+            clock_ = 1;
+        }
+        sequence = clock_;
+        for (uint8_t bit = 0; bit < 16; bit++)
+        {
+            if (fields & (1 << bit))
+            {
+                stamps_[bit].sequence = sequence;
+                memcpy(stamps_[bit].mac, own_mac_, 6);
+            }
+        }
+    }
+    dirty_ = 0;
+
+    SyncHeader header = {};
+    header.version = SYNC_PROTOCOL_VERSION;
+    header.type = SYNC_MESSAGE_SCENE;
+    header.group_id = group_id_;
+    header.sequence = sequence;
+    header.fields = fields;
+    size_t len = SyncProtocol::encodeScene(header, scene_, buffer_, sizeof(buffer_));
+    if (send_ && len)
+    {
+        send_(isFollowing() ? leader_mac_ : SYNC_BROADCAST_ADDRESS, buffer_, len);
+    }
+    last_send_ms_ = now;
+
+    if (retransmit)
+    {
+        // No backoff: these are a few tiny frames, and at 20% loss several
+        // rounds in a row are lost often enough to matter
+        stats_.retransmits++;
+        if (retries_ < SYNC_MAX_RETRIES)
+        {
+            retries_++;
+        }
+    }
+    else
+    {
+        stats_.scenes_sent++;
+        retries_ = 0;
+    }
+    retrying_ = receiver_count_ > 0;
+    retry_at_ms_ = now + SYNC_RETRY_MS;
+}
+
+uint16_t SyncChannel::laggingFields() const
+{
+    uint16_t fields = 0;
+    for (uint8_t bit = 0; bit < 16; bit++)
+    {
+        const Stamp &stamp = stamps_[bit];
+        if (!isOwn(stamp))
+        {
+            continue;
+        }
+        for (uint8_t i = 0; i < receiver_count_; i++)
+        {
+            const Receiver &receiver = receivers_[i];
+            // Followers only hear from the leader
+            if (isFollowing() && memcmp(receiver.mac, leader_mac_, 6) != 0)
+            {
+                continue;
+            }
+            if (!receiver.has_acked || isAfter(stamp.sequence, receiver.acked))
+            {
+                fields |= 1 << bit;
+                break;
+            }
+        }
+    }
+    return fields;
+}
+
+bool SyncChannel::isOwn(const Stamp &stamp) const
+{
+    return stamp.sequence != 0 && memcmp(stamp.mac, own_mac_, 6) == 0;
+}
+
+bool SyncChannel::isFollowing() const
+{
+    return has_leader_ && memcmp(leader_mac_, own_mac_, 6) != 0;
+}
+
+bool SyncChannel::isLeading() const
+{
+    return has_leader_ && memcmp(leader_mac_, own_mac_, 6) == 0;
+}
+
+int SyncChannel::findReceiver(const uint8_t *mac) const
+{
+    for (uint8_t i = 0; i < receiver_count_; i++)
+    {
+        if (memcmp(receivers_[i].mac, mac, 6) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint16_t SyncChannel::normalize(uint16_t fields)
+{
+    // The scene id and its parameters only make sense together; they share a stamp
+    fields &= SYNC_FIELD_ALL;
+    if (fields & (SYNC_FIELD_SCENE_ID | SYNC_FIELD_PARAMS))
+    {
+        fields |= SYNC_FIELD_SCENE_ID | SYNC_FIELD_PARAMS;
+    }
+    return fields;
+}
+
+bool SyncChannel::isNewer(const Stamp &a, const Stamp &b)
+{
+    if (b.sequence == 0)
+    {
+        return a.sequence != 0;
+    }
+    if (a.sequence != b.sequence)
+    {
+        return isAfter(a.sequence, b.sequence);
+    }
+    return memcmp(a.mac, b.mac, 6) > 0;
+}
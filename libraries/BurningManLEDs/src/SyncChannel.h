@@ -0,0 +1,180 @@
+#ifndef SYNCCHANNEL_H
+#define SYNCCHANNEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <functional>
+#include "SyncProtocol.h"
+
+#define SYNC_COALESCE_MS 20         // Local changes go out at most this often
+#define SYNC_ACK_DELAY_MS 50        // Receivers ack once a sender pauses this long...
+#define SYNC_ACK_MAX_DELAY_MS 500   // ...or its oldest unacked message is this old
+#define SYNC_RETRY_MS 80            // Between retransmits while a receiver hasn't acked
+#define SYNC_MAX_RETRIES 12         // Retransmits of unchanged state before slowing down...
+#define SYNC_SLOW_RETRY_MS 1000     // ...to this, until discovery drops the silent peer
+#define SYNC_MAX_RECEIVERS 32       // Group peers whose acks are tracked
+#define SYNC_MAX_SENDERS 8          // Group peers with an ack pending
+#define SYNC_QUEUE_SIZE 8           // Messages buffered between receive callback and update()
+
+struct SyncChannelStats
+{
+    uint32_t scenes_sent;
+    uint32_t retransmits;
+    uint32_t acks_sent;
+    uint32_t acks_received;
+    uint32_t scenes_received;
+    uint32_t stale;             // Received scenes with nothing newer than what we had
+    uint32_t rejected;          // Malformed or from another group
+    uint32_t queue_overflows;
+    uint32_t gave_up;           // Times a receiver stayed silent through every fast retry
+    uint32_t relayed;           // Followers' changes restamped and rebroadcast as leader
+};
+
+// Reliable, coalescing scene sync for one group.
+//
+// Each scene field is a last-writer-wins register stamped with (sequence,
+// writer MAC). Sequence numbers are a Lamport clock: every device advances
+// its own past any sequence it receives, so a later change always carries a
+// higher stamp, whoever makes it. Receivers take a field only if its stamp
+// beats the one they hold, which drops duplicates and reordered messages and
+// leaves every device with the same value after concurrent changes.
+//
+// submit() records local changes; they are broadcast at most every
+// SYNC_COALESCE_MS, so a dial turned quickly sends its latest value rather
+// than every detent. Receivers ack the newest message they have from each
+// sender once it pauses (at least every SYNC_ACK_MAX_DELAY_MS while it
+// keeps talking), so a spinning dial costs a handful of acks. A message
+// carries every field this device wrote that some receiver has not acked
+// yet, restamped together when they were written at different times, so an
+// ack always covers everything the sender wrote so far. Until every receiver
+// has acked, the state is resent every SYNC_RETRY_MS under its original stamp,
+// then every SYNC_SLOW_RETRY_MS, so a peer that was briefly out of range
+// catches up without waiting for the next change.
+//
+// With a leader (see LeaderElection), changes are serialized through it:
+// followers send theirs to the leader only and wait for its ack, and the
+// leader restamps whatever it accepts as its own write and broadcasts it, so
+// concurrent edits are ordered by when they reached the leader. Without one,
+// every device broadcasts its own changes as above.
+//
+// handleMessage() only queues, so it is safe in the radio receive callback;
+// the scene callback and all sends happen in update(). Messages that arrive
+// in loop() (e.g. from the mesh relay) go to processMessage() instead.
+class SyncChannel
+{
+public:
+    typedef std::function<bool(const uint8_t *mac, const uint8_t *data, size_t len)> SendFunction;
+    // fields: the SYNC_FIELD_* that just changed in scene
+    typedef std::function<void(const LightScene &scene, uint16_t fields)> SceneFunction;
+
+    explicit SyncChannel(uint16_t group_id = 0);
+
+    // own_mac breaks ties between devices that change a field at once
+    void begin(const uint8_t *own_mac, const LightScene &scene);
+    void setSendFunction(SendFunction send_function) { send_ = send_function; }
+    void onScene(SceneFunction callback) { on_scene_ = callback; }
+    uint16_t getGroupId() const { return group_id_; }
+
+    // Peers expected to ack; a new one is sent our current state
+    void addReceiver(const uint8_t *mac);
+    void removeReceiver(const uint8_t *mac);
+
+    // nullptr when the group has no leader; our own MAC when we lead
+    void setLeader(const uint8_t *mac);
+
+    // Local change; fields that differ from the shared state are sent
+    void submit(const LightScene &scene);
+
+    // Call from loop(): applies received messages, sends acks, coalesced
+    // changes and retransmits
+    void update();
+
+    // Returns true if the message belongs to the sync protocol. Safe to call
+    // from the radio receive callback.
+    bool handleMessage(const uint8_t *mac, const uint8_t *data, size_t len);
+    // Same, but applied at once; only from loop(), the queue's consumer side
+    bool processMessage(const uint8_t *mac, const uint8_t *data, size_t len);
+
+    // Nothing waiting to be sent and every receiver has acked
+    bool isSettled() const { return dirty_ == 0 && laggingFields() == 0; }
+    const LightScene &getScene() const { return scene_; }
+    const SyncChannelStats &getStats() const { return stats_; }
+
+private:
+    struct Stamp
+    {
+        uint16_t sequence; // 0: never written
+        uint8_t mac[6];
+    };
+
+    struct Receiver
+    {
+        uint8_t mac[6];
+        uint16_t acked;
+        bool has_acked;
+    };
+
+    struct PendingAck
+    {
+        uint8_t mac[6];
+        uint16_t sequence;
+        uint32_t due_ms;
+        uint32_t deadline_ms;
+        bool pending;
+    };
+
+    struct Message
+    {
+        uint8_t mac[6];
+        uint8_t len;
+        uint8_t data[SYNC_MAX_MESSAGE_SIZE];
+    };
+
+    void process(const Message &message, uint32_t now);
+    void applyScene(const uint8_t *mac, const SyncHeader &header, const LightScene &decoded);
+    void queueAck(const uint8_t *mac, uint16_t sequence, uint32_t now);
+    void sendAcks(uint32_t now);
+    void sendAck(PendingAck &ack);
+    void flush(uint32_t now, bool retransmit);
+    uint16_t laggingFields() const;
+    bool isOwn(const Stamp &stamp) const;
+    bool isFollowing() const;
+    bool isLeading() const;
+    int findReceiver(const uint8_t *mac) const;
+
+    static uint16_t normalize(uint16_t fields);
+    static bool isNewer(const Stamp &a, const Stamp &b);
+    static bool isAfter(uint16_t a, uint16_t b) { return (int16_t)(a - b) > 0; }
+
+    SendFunction send_;
+    SceneFunction on_scene_;
+    uint16_t group_id_;
+    uint8_t own_mac_[6];
+    uint8_t leader_mac_[6];
+    bool has_leader_;
+
+    LightScene scene_;
+    Stamp stamps_[16];          // One per SYNC_FIELD_* bit
+    uint16_t clock_;
+    uint16_t dirty_;            // Changed locally, not stamped or sent yet
+
+    uint32_t last_send_ms_;
+    uint32_t retry_at_ms_;
+    uint8_t retries_;
+    bool retrying_;
+
+    Receiver receivers_[SYNC_MAX_RECEIVERS];
+    uint8_t receiver_count_;
+    PendingAck acks_[SYNC_MAX_SENDERS];
+
+    // Single producer (receive callback), single consumer (update())
+    Message queue_[SYNC_QUEUE_SIZE];
+    std::atomic<uint8_t> queue_head_;
+    std::atomic<uint8_t> queue_tail_;
+
+    uint8_t buffer_[SYNC_MAX_MESSAGE_SIZE];
+    SyncChannelStats stats_;
+};
+
+#endif // SYNCCHANNEL_H
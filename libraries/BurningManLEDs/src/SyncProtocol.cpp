@@ -0,0 +1,611 @@
+#include "SyncProtocol.h"
+#include <string.h>
+
+typedef decltype(LightScene::scenes) SceneParams;
+
+enum ParamKind : uint8_t
+{
+    PARAM_U8,
+    PARAM_BOOL,
+    PARAM_PALETTE,
+    PARAM_U16,
+    PARAM_I32,
+    PARAM_RGB
+};
+
+struct ParamField
+{
+    uint8_t offset; // Within LightScene::scenes
+    ParamKind kind;
+};
+
+struct SceneParamTable
+{
+    const ParamField *fields;
+    uint8_t count;
+};
+
+#define PARAM(scene, field, kind) {(uint8_t)offsetof(SceneParams, scene.field), kind}
+#define PARAM_TABLE(fields) {fields, sizeof(fields) / sizeof(fields[0])}
+
+static const uint8_t PARAM_SIZES[] = {1, 1, 1, 2, 4, 3};
+
+static const ParamField SOLID_PARAMS[] = {PARAM(solid, color, PARAM_RGB)};
+static const ParamField PALETTE_CYCLE_PARAMS[] = {PARAM(palette_cycle, duration, PARAM_U16),
+                                                  PARAM(palette_cycle, palette, PARAM_PALETTE)};
+static const ParamField PALETTE_STREAM_PARAMS[] = {PARAM(palette_stream, duration, PARAM_U16),
+                                                   PARAM(palette_stream, palette, PARAM_PALETTE),
+                                                   PARAM(palette_stream, direction, PARAM_BOOL)};
+static const ParamField SPECTRUM_CYCLE_PARAMS[] = {PARAM(spectrum_cycle, duration, PARAM_U16)};
+static const ParamField SPECTRUM_STREAM_PARAMS[] = {PARAM(spectrum_stream, duration, PARAM_U16)};
+static const ParamField SPECTRUM_SPARKLE_PARAMS[] = {PARAM(spectrum_sparkle, density, PARAM_U8)};
+static const ParamField STROBE_PARAMS[] = {PARAM(strobe, num_flashes, PARAM_U16),
+                                           PARAM(strobe, duration_on, PARAM_U16),
+                                           PARAM(strobe, duration_off, PARAM_U16),
+                                           PARAM(strobe, duration_between_sets, PARAM_U16),
+                                           PARAM(strobe, color, PARAM_RGB)};
+static const ParamField SPARKLE_PARAMS[] = {PARAM(sparkle, duration, PARAM_U16),
+                                            PARAM(sparkle, density, PARAM_U8),
+                                            PARAM(sparkle, color, PARAM_RGB)};
+static const ParamField BREATHE_PARAMS[] = {PARAM(breathe, duration, PARAM_U16),
+                                            PARAM(breathe, dimness, PARAM_U8),
+                                            PARAM(breathe, color, PARAM_RGB)};
+static const ParamField SET_CHSV_PARAMS[] = {PARAM(setCHSV, color, PARAM_I32),
+                                             PARAM(setCHSV, saturation, PARAM_I32),
+                                             PARAM(setCHSV, luminosity, PARAM_I32)};
+static const ParamField PULSE_WAVE_PARAMS[] = {PARAM(pulse_wave, duration, PARAM_U16),
+                                               PARAM(pulse_wave, wave_width, PARAM_U8),
+                                               PARAM(pulse_wave, palette, PARAM_PALETTE)};
+static const ParamField METEOR_SHOWER_PARAMS[] = {PARAM(meteor_shower, duration, PARAM_U16),
+                                                  PARAM(meteor_shower, meteor_count, PARAM_U8),
+                                                  PARAM(meteor_shower, trail_length, PARAM_U8),
+                                                  PARAM(meteor_shower, palette, PARAM_PALETTE)};
+static const ParamField FIRE_PLASMA_PARAMS[] = {PARAM(fire_plasma, duration, PARAM_U16),
+                                                PARAM(fire_plasma, heat_variance, PARAM_U8),
+                                                PARAM(fire_plasma, palette, PARAM_PALETTE)};
+static const ParamField KALEIDOSCOPE_PARAMS[] = {PARAM(kaleidoscope, duration, PARAM_U16),
+                                                 PARAM(kaleidoscope, mirror_count, PARAM_U8),
+                                                 PARAM(kaleidoscope, palette, PARAM_PALETTE)};
+static const ParamField RAINBOW_COMET_PARAMS[] = {PARAM(rainbow_comet, duration, PARAM_U16),
+                                                  PARAM(rainbow_comet, comet_count, PARAM_U8),
+                                                  PARAM(rainbow_comet, trail_length, PARAM_U8)};
+static const ParamField MATRIX_RAIN_PARAMS[] = {PARAM(matrix_rain, duration, PARAM_U16),
+                                                PARAM(matrix_rain, drop_rate, PARAM_U8),
+                                                PARAM(matrix_rain, color, PARAM_RGB)};
+static const ParamField PLASMA_CLOUDS_PARAMS[] = {PARAM(plasma_clouds, duration, PARAM_U16),
+                                                  PARAM(plasma_clouds, cloud_scale, PARAM_U8),
+                                                  PARAM(plasma_clouds, palette, PARAM_PALETTE)};
+static const ParamField LAVA_LAMP_PARAMS[] = {PARAM(lava_lamp, duration, PARAM_U16),
+                                              PARAM(lava_lamp, blob_count, PARAM_U8),
+                                              PARAM(lava_lamp, palette, PARAM_PALETTE)};
+static const ParamField AURORA_BOREALIS_PARAMS[] = {PARAM(aurora_borealis, duration, PARAM_U16),
+                                                    PARAM(aurora_borealis, wave_count, PARAM_U8),
+                                                    PARAM(aurora_borealis, palette, PARAM_PALETTE)};
+static const ParamField LIGHTNING_STORM_PARAMS[] = {PARAM(lightning_storm, duration, PARAM_U16),
+                                                    PARAM(lightning_storm, flash_intensity, PARAM_U8),
+                                                    PARAM(lightning_storm, flash_frequency, PARAM_U16)};
+static const ParamField COLOR_EXPLOSION_PARAMS[] = {PARAM(color_explosion, duration, PARAM_U16),
+                                                    PARAM(color_explosion, explosion_size, PARAM_U8),
+                                                    PARAM(color_explosion, palette, PARAM_PALETTE)};
+static const ParamField SPIRAL_GALAXY_PARAMS[] = {PARAM(spiral_galaxy, duration, PARAM_U16),
+                                                  PARAM(spiral_galaxy, spiral_arms, PARAM_U8),
+                                                  PARAM(spiral_galaxy, palette, PARAM_PALETTE)};
+
+// Indexed by LightSceneID; scenes without parameters have an empty entry
+static const SceneParamTable SCENE_PARAMS[SYNC_LAST_SCENE_ID + 1] = {
+    {nullptr, 0},                          // off
+    PARAM_TABLE(SOLID_PARAMS),             // solid
+    PARAM_TABLE(PALETTE_CYCLE_PARAMS),     // palette_cycle
+    PARAM_TABLE(PALETTE_STREAM_PARAMS),    // palette_stream
+    PARAM_TABLE(SPECTRUM_CYCLE_PARAMS),    // spectrum_cycle
+    PARAM_TABLE(SPECTRUM_STREAM_PARAMS),   // spectrum_stream
+    PARAM_TABLE(SPECTRUM_SPARKLE_PARAMS),  // spectrum_sparkle
+    PARAM_TABLE(STROBE_PARAMS),            // strobe
+    PARAM_TABLE(SPARKLE_PARAMS),           // sparkle
+    PARAM_TABLE(BREATHE_PARAMS),           // breathe
+    PARAM_TABLE(SET_CHSV_PARAMS),          // setCHSV
+    {nullptr, 0},                          // position_status
+    {nullptr, 0},                          // color_wheel
+    {nullptr, 0},                          // speedometer
+    {nullptr, 0},                          // jacketDance
+    {nullptr, 0},                          // color_radial
+    PARAM_TABLE(PULSE_WAVE_PARAMS),        // pulse_wave
+    PARAM_TABLE(METEOR_SHOWER_PARAMS),     // meteor_shower
+    PARAM_TABLE(FIRE_PLASMA_PARAMS),       // fire_plasma
+    PARAM_TABLE(KALEIDOSCOPE_PARAMS),      // kaleidoscope
+    PARAM_TABLE(RAINBOW_COMET_PARAMS),     // rainbow_comet
+    PARAM_TABLE(MATRIX_RAIN_PARAMS),       // matrix_rain
+    PARAM_TABLE(PLASMA_CLOUDS_PARAMS),     // plasma_clouds
+    PARAM_TABLE(LAVA_LAMP_PARAMS),         // lava_lamp
+    PARAM_TABLE(AURORA_BOREALIS_PARAMS),   // aurora_borealis
+    PARAM_TABLE(LIGHTNING_STORM_PARAMS),   // lightning_storm
+    PARAM_TABLE(COLOR_EXPLOSION_PARAMS),   // color_explosion
+    PARAM_TABLE(SPIRAL_GALAXY_PARAMS)      // spiral_galaxy
+};
+
+static uint8_t paramsSize(const SceneParamTable &table)
+{
+    uint8_t size = 0;
+    for (uint8_t i = 0; i < table.count; i++)
+    {
+        size += PARAM_SIZES[table.fields[i].kind];
+    }
+    return size;
+}
+
+// Bounds-checked little-endian cursor over a caller-owned buffer
+class ByteWriter
+{
+public:
+    ByteWriter(uint8_t *buffer, size_t capacity) : buffer_(buffer), capacity_(capacity), pos_(0), ok_(true) {}
+
+    void u8(uint8_t value)
+    {
+        if (pos_ + 1 > capacity_)
+        {
+            ok_ = false;
+            return;
+        }
+        buffer_[pos_++] = value;
+    }
+    void u16(uint16_t value)
+    {
+        u8(value & 0xFF);
+        u8(value >> 8);
+    }
+    void u32(uint32_t value)
+    {
+        u16(value & 0xFFFF);
+        u16(value >> 16);
+    }
+
+    size_t size() const { return pos_; }
+    bool ok() const { return ok_; }
+
+private:
+    uint8_t *buffer_;
+    size_t capacity_;
+    size_t pos_;
+    bool ok_;
+};
+
+class ByteReader
+{
+public:
+    ByteReader(const uint8_t *data, size_t len) : data_(data), len_(len), pos_(0), ok_(true) {}
+
+    uint8_t u8()
+    {
+        if (pos_ + 1 > len_)
+        {
+            ok_ = false;
+            return 0;
+        }
+        return data_[pos_++];
+    }
+    uint16_t u16()
+    {
+        uint16_t low = u8();
+        return low | (uint16_t)(u8() << 8);
+    }
+    uint32_t u32()
+    {
+        uint32_t low = u16();
+        return low | ((uint32_t)u16() << 16);
+    }
+
+    bool ok() const { return ok_; }
+
+private:
+    const uint8_t *data_;
+    size_t len_;
+    size_t pos_;
+    bool ok_;
+};
+
+static void writeParam(ByteWriter &writer, const SceneParams &params, const ParamField &field)
+{
+    const uint8_t *source = reinterpret_cast<const uint8_t *>(&params) + field.offset;
+    switch (field.kind)
+    {
+    case PARAM_U16:
+    {
+        uint16_t value;
+        memcpy(&value, source, sizeof(value));
+        writer.u16(value);
+        break;
+    }
+    case PARAM_I32:
+    {
+        int32_t value;
+        memcpy(&value, source, sizeof(value));
+        writer.u32((uint32_t)value);
+        break;
+    }
+    case PARAM_RGB:
+        writer.u8(source[0]);
+        writer.u8(source[1]);
+        writer.u8(source[2]);
+        break;
+    case PARAM_BOOL:
+        writer.u8(*source ? 1 : 0);
+        break;
+    default:
+        writer.u8(*source);
+        break;
+    }
+}
+
+static bool readParam(ByteReader &reader, SceneParams &params, const ParamField &field)
+{
+    uint8_t *target = reinterpret_cast<uint8_t *>(&params) + field.offset;
+    switch (field.kind)
+    {
+    case PARAM_U16:
+    {
+        uint16_t value = reader.u16();
+        memcpy(target, &value, sizeof(value));
+        return true;
+    }
+    case PARAM_I32:
+    {
+        int32_t value = (int32_t)reader.u32();
+        memcpy(target, &value, sizeof(value));
+        return true;
+    }
+    case PARAM_RGB:
+        target[0] = reader.u8();
+        target[1] = reader.u8();
+        target[2] = reader.u8();
+        return true;
+    case PARAM_BOOL:
+    {
+        // Written through bool*, so only 0/1 may land here
+        bool value = reader.u8() != 0;
+        memcpy(target, &value, sizeof(value));
+        return true;
+    }
+    case PARAM_PALETTE:
+    {
+        uint8_t value = reader.u8();
+        *target = value;
+        return value <= SYNC_LAST_PALETTE;
+    }
+    default:
+        *target = reader.u8();
+        return true;
+    }
+}
+
+static bool paramsEqual(const LightScene &a, const LightScene &b)
+{
+    const SceneParamTable &table = SCENE_PARAMS[b.scene_id <= SYNC_LAST_SCENE_ID ? b.scene_id : 0];
+    const uint8_t *params_a = reinterpret_cast<const uint8_t *>(&a.scenes);
+    const uint8_t *params_b = reinterpret_cast<const uint8_t *>(&b.scenes);
+    for (uint8_t i = 0; i < table.count; i++)
+    {
+        const ParamField &field = table.fields[i];
+        if (memcmp(params_a + field.offset, params_b + field.offset, PARAM_SIZES[field.kind]) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint16_t SyncProtocol::groupId(const char *identifier)
+{
+    if (!identifier || !identifier[0])
+    {
+        return 0;
+    }
+    return (uint16_t)((uint8_t)identifier[0] << 8 | (uint8_t)identifier[1]);
+}
+
+bool SyncProtocol::isSyncMessage(const uint8_t *data, size_t len)
+{
+    return len >= SYNC_HEADER_SIZE && data[0] == SYNC_PROTOCOL_MAGIC;
+}
+
+uint16_t SyncProtocol::diffScene(const LightScene &a, const LightScene &b)
+{
+    uint16_t fields = 0;
+    if (a.scene_id != b.scene_id)
+    {
+        fields |= SYNC_FIELD_SCENE_ID | SYNC_FIELD_PARAMS;
+    }
+    if (a.brightness != b.brightness)
+    {
+        fields |= SYNC_FIELD_BRIGHTNESS;
+    }
+    if (a.speed != b.speed)
+    {
+        fields |= SYNC_FIELD_SPEED;
+    }
+    if (a.primary_palette != b.primary_palette)
+    {
+        fields |= SYNC_FIELD_PRIMARY_PALETTE;
+    }
+    if (a.color != b.color)
+    {
+        fields |= SYNC_FIELD_COLOR;
+    }
+    if (a.direction != b.direction)
+    {
+        fields |= SYNC_FIELD_DIRECTION;
+    }
+    if (a.selected_devices != b.selected_devices)
+    {
+        fields |= SYNC_FIELD_SELECTED_DEVICES;
+    }
+    if (a.reference_time != b.reference_time)
+    {
+        fields |= SYNC_FIELD_REFERENCE_TIME;
+    }
+    if (!(fields & SYNC_FIELD_PARAMS) && !paramsEqual(a, b))
+    {
+        fields |= SYNC_FIELD_PARAMS;
+    }
+    return fields;
+}
+
+size_t SyncProtocol::encodeScene(const SyncHeader &header, const LightScene &scene, uint8_t *buffer, size_t capacity)
+{
+    uint16_t fields = header.fields & SYNC_FIELD_ALL;
+    if (fields & SYNC_FIELD_PARAMS)
+    {
+        fields |= SYNC_FIELD_SCENE_ID;
+    }
+
+    ByteWriter writer(buffer, capacity);
+    writer.u8(SYNC_PROTOCOL_MAGIC);
+    writer.u8(SYNC_PROTOCOL_VERSION);
+    writer.u8(SYNC_MESSAGE_SCENE);
+    writer.u8(header.flags);
+    writer.u16(header.group_id);
+    writer.u16(header.sequence);
+    writer.u16(fields);
+
+    if (fields & SYNC_FIELD_SCENE_ID)
+    {
+        writer.u8(scene.scene_id);
+    }
+    if (fields & SYNC_FIELD_BRIGHTNESS)
+    {
+        writer.u8(scene.brightness);
+    }
+    if (fields & SYNC_FIELD_SPEED)
+    {
+        writer.u16(scene.speed);
+    }
+    if (fields & SYNC_FIELD_PRIMARY_PALETTE)
+    {
+        writer.u8(scene.primary_palette);
+    }
+    if (fields & SYNC_FIELD_COLOR)
+    {
+        writer.u8(scene.color.r);
+        writer.u8(scene.color.g);
+        writer.u8(scene.color.b);
+    }
+    if (fields & SYNC_FIELD_DIRECTION)
+    {
+        writer.u8(scene.direction ? 1 : 0);
+    }
+    if (fields & SYNC_FIELD_SELECTED_DEVICES)
+    {
+        writer.u8(scene.selected_devices);
+    }
+    if (fields & SYNC_FIELD_REFERENCE_TIME)
+    {
+        writer.u32(scene.reference_time);
+    }
+    if (fields & SYNC_FIELD_PARAMS)
+    {
+        const SceneParamTable &table = SCENE_PARAMS[scene.scene_id <= SYNC_LAST_SCENE_ID ? scene.scene_id : 0];
+        writer.u8(paramsSize(table));
+        for (uint8_t i = 0; i < table.count; i++)
+        {
+            writeParam(writer, scene.scenes, table.fields[i]);
+        }
+    }
+
+    return writer.ok() ? writer.size() : 0;
+}
+
+size_t SyncProtocol::encodeAck(uint16_t group_id, uint16_t sequence, uint8_t *buffer, size_t capacity)
+{
+    ByteWriter writer(buffer, capacity);
+    writer.u8(SYNC_PROTOCOL_MAGIC);
+    writer.u8(SYNC_PROTOCOL_VERSION);
+    writer.u8(SYNC_MESSAGE_ACK);
+    writer.u8(0);
+    writer.u16(group_id);
+    writer.u16(sequence);
+    writer.u16(0);
+    return writer.ok() ? writer.size() : 0;
+}
+
+void SyncProtocol::copyFields(uint16_t fields, const LightScene &from, LightScene &to)
+{
+    if (fields & SYNC_FIELD_SCENE_ID)
+    {
+        to.scene_id = from.scene_id;
+    }
+    if (fields & SYNC_FIELD_BRIGHTNESS)
+    {
+        to.brightness = from.brightness;
+    }
+    if (fields & SYNC_FIELD_SPEED)
+    {
+        to.speed = from.speed;
+    }
+    if (fields & SYNC_FIELD_PRIMARY_PALETTE)
+    {
+        to.primary_palette = from.primary_palette;
+    }
+    if (fields & SYNC_FIELD_COLOR)
+    {
+        to.color = from.color;
+    }
+    if (fields & SYNC_FIELD_DIRECTION)
+    {
+        to.direction = from.direction;
+    }
+    if (fields & SYNC_FIELD_SELECTED_DEVICES)
+    {
+        to.selected_devices = from.selected_devices;
+    }
+    if (fields & SYNC_FIELD_REFERENCE_TIME)
+    {
+        to.reference_time = from.reference_time;
+    }
+    if (fields & SYNC_FIELD_PARAMS)
+    {
+        to.scenes = from.scenes;
+    }
+}
+
+bool SyncProtocol::decodeHeader(const uint8_t *data, size_t len, SyncHeader &header)
+{
+    if (!data || !isSyncMessage(data, len) || data[1] != SYNC_PROTOCOL_VERSION)
+    {
+        return false;
+    }
+    ByteReader reader(data + 2, len - 2);
+    header.version = data[1];
+    header.type = reader.u8();
+    header.flags = reader.u8();
+    header.group_id = reader.u16();
+    header.sequence = reader.u16();
+    header.fields = reader.u16();
+    return reader.ok();
+}
+
+bool SyncProtocol::decodeScene(const uint8_t *data, size_t len, SyncHeader &header, LightScene &scene)
+{
+    if (!decodeHeader(data, len, header) || header.type != SYNC_MESSAGE_SCENE)
+    {
+        return false;
+    }
+    uint16_t fields = header.fields;
+    if ((fields & SYNC_FIELD_PARAMS) && !(fields & SYNC_FIELD_SCENE_ID))
+    {
+        return false;
+    }
+
+    LightScene decoded = scene;
+    ByteReader reader(data + SYNC_HEADER_SIZE, len - SYNC_HEADER_SIZE);
+    if (fields & SYNC_FIELD_SCENE_ID)
+    {
+        uint8_t scene_id = reader.u8();
+        if (scene_id > SYNC_LAST_SCENE_ID)
+        {
+            return false;
+        }
+        decoded.scene_id = (LightSceneID)scene_id;
+    }
+    if (fields & SYNC_FIELD_BRIGHTNESS)
+    {
+        decoded.brightness = reader.u8();
+    }
+    if (fields & SYNC_FIELD_SPEED)
+    {
+        decoded.speed = reader.u16();
+    }
+    if (fields & SYNC_FIELD_PRIMARY_PALETTE)
+    {
+        uint8_t palette = reader.u8();
+        if (palette > SYNC_LAST_PALETTE)
+        {
+            return false;
+        }
+        decoded.primary_palette = (AvailablePalettes)palette;
+    }
+    if (fields & SYNC_FIELD_COLOR)
+    {
+        decoded.color.r = reader.u8();
+        decoded.color.g = reader.u8();
+        decoded.color.b = reader.u8();
+    }
+    if (fields & SYNC_FIELD_DIRECTION)
+    {
+        decoded.direction = reader.u8() != 0;
+    }
+    if (fields & SYNC_FIELD_SELECTED_DEVICES)
+    {
+        decoded.selected_devices = reader.u8();
+    }
+    if (fields & SYNC_FIELD_REFERENCE_TIME)
+    {
+        decoded.reference_time = reader.u32();
+    }
+    if (fields & SYNC_FIELD_PARAMS)
+    {
+        const SceneParamTable &table = SCENE_PARAMS[decoded.scene_id];
+        if (reader.u8() != paramsSize(table))
+        {
+            return false;
+        }
+        // Scenes are built from zeroed structs; do the same so unused bytes compare equal
+        memset(&decoded.scenes, 0, sizeof(decoded.scenes));
+        for (uint8_t i = 0; i < table.count; i++)
+        {
+            if (!readParam(reader, decoded.scenes, table.fields[i]))
+            {
+                return false;
+            }
+        }
+    }
+
+    // Bytes past the known fields come from a newer sender and are ignored;
+    // running out before them is an error
+    if (!reader.ok())
+    {
+        return false;
+    }
+    // Keep the receiver's own bytes when the parameters match, so callers can
+    // memcmp scenes without unused union bytes showing up as changes
+    if ((fields & SYNC_FIELD_PARAMS) && decoded.scene_id == scene.scene_id && paramsEqual(scene, decoded))
+    {
+        decoded.scenes = scene.scenes;
+    }
+    scene = decoded;
+    return true;
+}
+
+SyncEncoder::SyncEncoder(uint16_t group_id) : has_last_(false),
+                                              group_id_(group_id),
+                                              sequence_(0),
+                                              since_keyframe_(0)
+{
+}
+
+size_t SyncEncoder::encode(const LightScene &scene, uint8_t *buffer, size_t capacity, bool keyframe)
+{
+    keyframe = keyframe || !has_last_ || since_keyframe_ + 1 >= SYNC_KEYFRAME_INTERVAL;
+
+    SyncHeader header = {};
+    header.version = SYNC_PROTOCOL_VERSION;
+    header.type = SYNC_MESSAGE_SCENE;
+    header.flags = keyframe ? (uint8_t)SYNC_FLAG_KEYFRAME : 0;
+    header.group_id = group_id_;
+    header.sequence = sequence_;
+    header.fields = keyframe ? (uint16_t)SYNC_FIELD_ALL : SyncProtocol::diffScene(last_, scene);
+    if (header.fields == 0)
+    {
+        return 0;
+    }
+
+    size_t len = SyncProtocol::encodeScene(header, scene, buffer, capacity);
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    sequence_++;
+    since_keyframe_ = keyframe ? 0 : since_keyframe_ + 1;
+    last_ = scene;
+    has_last_ = true;
+    return len;
+}
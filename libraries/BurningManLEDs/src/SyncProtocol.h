@@ -0,0 +1,123 @@
+#ifndef SYNCPROTOCOL_H
+#define SYNCPROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "LightShow.h"
+
+// Wire format for scene sync between props. Everything is little-endian and
+// written field by field, so it does not depend on LightScene's layout,
+// padding or the compiler that built the sender.
+//
+//   0  magic            SYNC_PROTOCOL_MAGIC
+//   1  version          SYNC_PROTOCOL_VERSION
+//   2  type             SyncMessageType
+//   3  flags            SYNC_FLAG_*
+//   4  group id         u16, props only apply messages from their own group
+//   6  sequence         u16, per sender (SyncChannel uses a Lamport clock)
+//   8  field mask       u16, SYNC_FIELD_* present in the body
+//  10  body             the masked fields in bit order
+//
+// Field values are absolute, so applying a delta twice is harmless and a
+// lost delta is repaired by the next keyframe. New fields must only ever be
+// added at higher bits: older receivers apply the fields they know and ignore
+// the rest of the body.
+#define SYNC_PROTOCOL_MAGIC 0xB5
+#define SYNC_PROTOCOL_VERSION 1
+#define SYNC_HEADER_SIZE 10
+#define SYNC_MAX_PARAMS_SIZE 16
+#define SYNC_MAX_MESSAGE_SIZE 64        // Largest scene message is well under this
+#define SYNC_KEYFRAME_INTERVAL 16       // Every Nth message carries every field
+
+// Highest values a receiver accepts; keep in step with LightShow.h
+#define SYNC_LAST_SCENE_ID spiral_galaxy
+#define SYNC_LAST_PALETTE moltenmetal
+
+enum SyncMessageType : uint8_t
+{
+    SYNC_MESSAGE_SCENE = 1,
+    SYNC_MESSAGE_ACK = 2 // Header only; sequence is the newest scene received from the addressee
+};
+
+enum SyncFlags : uint8_t
+{
+    SYNC_FLAG_KEYFRAME = 0x01
+};
+
+enum SyncField : uint16_t
+{
+    SYNC_FIELD_SCENE_ID = 1 << 0,         // u8
+    SYNC_FIELD_BRIGHTNESS = 1 << 1,       // u8
+    SYNC_FIELD_SPEED = 1 << 2,            // u16
+    SYNC_FIELD_PRIMARY_PALETTE = 1 << 3,  // u8
+    SYNC_FIELD_COLOR = 1 << 4,            // r, g, b
+    SYNC_FIELD_DIRECTION = 1 << 5,        // u8 (0/1)
+    SYNC_FIELD_SELECTED_DEVICES = 1 << 6, // u8
+    SYNC_FIELD_REFERENCE_TIME = 1 << 7,   // u32
+    SYNC_FIELD_PARAMS = 1 << 8,           // u8 length + the current scene's parameters
+    SYNC_FIELD_ALL = 0x01FF
+};
+
+struct SyncHeader
+{
+    uint8_t version;
+    uint8_t type;
+    uint8_t flags;
+    uint16_t group_id;
+    uint16_t sequence;
+    uint16_t fields;
+};
+
+class SyncProtocol
+{
+public:
+    // Packs a two character user identifier (e.g. "CL") into a group id
+    static uint16_t groupId(const char *identifier);
+
+    static bool isSyncMessage(const uint8_t *data, size_t len);
+
+    // Fields of b that differ from a. Scene parameters are only compared
+    // for the fields the scene actually uses.
+    static uint16_t diffScene(const LightScene &a, const LightScene &b);
+
+    // Writes the header and the given fields of scene into buffer. Returns
+    // the message length, or 0 if it does not fit. PARAMS always brings
+    // SCENE_ID along, since parameters mean nothing without it.
+    static size_t encodeScene(const SyncHeader &header, const LightScene &scene, uint8_t *buffer, size_t capacity);
+    static size_t encodeAck(uint16_t group_id, uint16_t sequence, uint8_t *buffer, size_t capacity);
+
+    // Copies the given fields of from into to (PARAMS copies every parameter)
+    static void copyFields(uint16_t fields, const LightScene &from, LightScene &to);
+
+    // Validates a message and applies its fields on top of scene (which
+    // should hold the receiver's current scene). scene is left untouched
+    // unless the whole message is valid.
+    static bool decodeHeader(const uint8_t *data, size_t len, SyncHeader &header);
+    static bool decodeScene(const uint8_t *data, size_t len, SyncHeader &header, LightScene &scene);
+};
+
+// Sender side: remembers what was last sent and only encodes the changes.
+class SyncEncoder
+{
+public:
+    explicit SyncEncoder(uint16_t group_id = 0);
+
+    void setGroupId(uint16_t group_id) { group_id_ = group_id; }
+    uint16_t getGroupId() const { return group_id_; }
+
+    // Encodes the fields that changed since the last call (every field on a
+    // keyframe). Returns the message length, or 0 if nothing changed.
+    size_t encode(const LightScene &scene, uint8_t *buffer, size_t capacity, bool keyframe = false);
+
+    // The next message will be a keyframe
+    void reset() { has_last_ = false; }
+
+private:
+    LightScene last_;
+    bool has_last_;
+    uint16_t group_id_;
+    uint16_t sequence_;
+    uint8_t since_keyframe_;
+};
+
+#endif // SYNCPROTOCOL_H
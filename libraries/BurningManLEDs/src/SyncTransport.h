@@ -0,0 +1,47 @@
+#ifndef SYNCTRANSPORT_H
+#define SYNCTRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+
+// The link SyncController's messages travel over: ESP-NOW between props
+// (EspNowTransport), or UDP multicast on a camp Wi-Fi network
+// (UdpMulticastTransport). Devices are addressed by MAC either way, and
+// FF:FF:FF:FF:FF:FF reaches everyone listening.
+//
+// Receive and send callbacks may run on the radio's task (ESP-NOW) or from
+// update() (UDP), so they must only queue, like every handleMessage() in this
+// library already does.
+class SyncTransport
+{
+public:
+    typedef std::function<void(const uint8_t *mac, const uint8_t *data, size_t len)> ReceiveFunction;
+    // delivered: the peer's MAC ACK for ESP-NOW unicasts; for broadcasts, and
+    // everything on UDP, only that the frame went out
+    typedef std::function<void(const uint8_t *mac, bool delivered)> SentFunction;
+
+    virtual ~SyncTransport() {}
+
+    virtual bool begin() = 0;
+    virtual void getMac(uint8_t *mac) const = 0;
+    virtual bool send(const uint8_t *mac, const uint8_t *data, size_t len) = 0;
+    // Call from loop(): polls transports that have no receive task
+    virtual void update() {}
+    // Sends whatever send() has batched up so far
+    virtual void flush() {}
+
+    // Devices unicasts go to; ESP-NOW only holds ESP_NOW_MAX_TOTAL_PEER_NUM
+    virtual bool addPeer(const uint8_t *mac) = 0;
+    virtual void removePeer(const uint8_t *mac) = 0;
+    virtual bool hasPeer(const uint8_t *mac) const = 0;
+
+    void onReceive(ReceiveFunction callback) { on_receive_ = callback; }
+    void onSent(SentFunction callback) { on_sent_ = callback; }
+
+protected:
+    ReceiveFunction on_receive_;
+    SentFunction on_sent_;
+};
+
+#endif // SYNCTRANSPORT_H
@@ -0,0 +1,317 @@
+#include <Arduino.h>
+#include <esp_wifi.h>
+#include "UdpMulticastTransport.h"
+#include "BMLog.h"
+#include <string.h>
+#include <errno.h>
+#if defined(ESP_PLATFORM)
+#include <lwip/sockets.h>
+#include <lwip/inet.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const uint8_t UDP_BROADCAST_ADDRESS[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+UdpMulticastTransport::UdpMulticastTransport(const char *group, uint16_t port) : group_(group),
+                                                                                 port_(port),
+                                                                                 interface_(nullptr),
+                                                                                 batching_(true),
+                                                                                 loopback_(false),
+                                                                                 started_(false),
+                                                                                 has_mac_(false),
+                                                                                 socket_(-1),
+                                                                                 last_open_ms_(0),
+                                                                                 peer_count_(0),
+                                                                                 tx_len_(UDP_SYNC_HEADER_SIZE),
+                                                                                 tx_count_(0)
+{
+    memset(own_mac_, 0, sizeof(own_mac_));
+    memset(peers_, 0, sizeof(peers_));
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+UdpMulticastTransport::~UdpMulticastTransport()
+{
+    closeSocket();
+}
+
+void UdpMulticastTransport::setMac(const uint8_t *mac)
+{
+    memcpy(own_mac_, mac, 6);
+    has_mac_ = true;
+}
+
+bool UdpMulticastTransport::begin()
+{
+    if (inet_addr(group_) == INADDR_NONE)
+    {
+        BMLOG_ERROR("UdpMulticastTransport", "Invalid multicast group %s", group_);
+        return false;
+    }
+    if (!has_mac_)
+    {
+        esp_wifi_get_mac(WIFI_IF_STA, own_mac_);
+        has_mac_ = true;
+    }
+    started_ = true;
+    // Without a network yet, update() tries again
+    openSocket();
+    return true;
+}
+
+void UdpMulticastTransport::getMac(uint8_t *mac) const
+{
+    memcpy(mac, own_mac_, 6);
+}
+
+bool UdpMulticastTransport::openSocket()
+{
+    last_open_ms_ = millis();
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+#ifdef SO_REUSEPORT
+    // Several transports on one host (the harness) share the group's port
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+#endif
+
+    struct sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port_);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    struct ip_mreq membership = {};
+    membership.imr_multiaddr.s_addr = inet_addr(group_);
+    membership.imr_interface.s_addr = interface_ ? inet_addr(interface_) : htonl(INADDR_ANY);
+
+    uint8_t ttl = 1; // The camp network, not beyond its router
+    uint8_t loop = loopback_ ? 1 : 0;
+    if (bind(fd, (struct sockaddr *)&local, sizeof(local)) != 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) != 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) != 0 ||
+        (interface_ && setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &membership.imr_interface, sizeof(membership.imr_interface)) != 0) ||
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    socket_ = fd;
+    stats_.opens++;
+    BMLOG_INFO("UdpMulticastTransport", "UDP sync joined %s:%u", group_, port_);
+    return true;
+}
+
+void UdpMulticastTransport::closeSocket()
+{
+    if (socket_ >= 0)
+    {
+        ::close(socket_);
+        socket_ = -1;
+    }
+}
+
+bool UdpMulticastTransport::send(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+    if (socket_ < 0 || len > UDP_SYNC_MAX_MESSAGE)
+    {
+        return false;
+    }
+    if (tx_len_ + UDP_SYNC_ENTRY_HEADER_SIZE + len > sizeof(tx_) || tx_count_ == 0xFF)
+    {
+        flush();
+    }
+
+    uint8_t *entry = tx_ + tx_len_;
+    memcpy(entry, mac, 6);
+    entry[6] = len & 0xFF;
+    entry[7] = len >> 8;
+    memcpy(entry + UDP_SYNC_ENTRY_HEADER_SIZE, data, len);
+    tx_len_ += UDP_SYNC_ENTRY_HEADER_SIZE + len;
+    tx_count_++;
+    stats_.messages_sent++;
+
+    if (!batching_)
+    {
+        flush();
+    }
+    return true;
+}
+
+void UdpMulticastTransport::flush()
+{
+    if (tx_count_ == 0)
+    {
+        return;
+    }
+    tx_[0] = UDP_SYNC_MAGIC;
+    tx_[1] = UDP_SYNC_VERSION;
+    memcpy(tx_ + 2, own_mac_, 6);
+    tx_[8] = tx_count_;
+
+    struct sockaddr_in group = {};
+    group.sin_family = AF_INET;
+    group.sin_port = htons(port_);
+    group.sin_addr.s_addr = inet_addr(group_);
+    bool sent = socket_ >= 0 &&
+                sendto(socket_, tx_, tx_len_, MSG_DONTWAIT, (struct sockaddr *)&group, sizeof(group)) == (ssize_t)tx_len_;
+    if (sent)
+    {
+        stats_.datagrams_sent++;
+        stats_.bytes_sent += tx_len_;
+    }
+    else
+    {
+        // A full socket buffer drops the datagram rather than stalling loop()
+        stats_.send_errors++;
+    }
+
+    if (on_sent_)
+    {
+        size_t offset = UDP_SYNC_HEADER_SIZE;
+        while (offset < tx_len_)
+        {
+            size_t len = tx_[offset + 6] | tx_[offset + 7] << 8;
+            on_sent_(tx_ + offset, sent);
+            offset += UDP_SYNC_ENTRY_HEADER_SIZE + len;
+        }
+    }
+    tx_len_ = UDP_SYNC_HEADER_SIZE;
+    tx_count_ = 0;
+}
+
+void UdpMulticastTransport::update()
+{
+    if (!started_)
+    {
+        return;
+    }
+    if (socket_ < 0)
+    {
+        if (millis() - last_open_ms_ >= UDP_SYNC_REOPEN_MS)
+        {
+            openSocket();
+        }
+        return;
+    }
+
+    for (uint8_t i = 0; i < UDP_SYNC_RECEIVE_BUDGET; i++)
+    {
+        ssize_t len = recvfrom(socket_, rx_, sizeof(rx_), MSG_DONTWAIT, nullptr, nullptr);
+        if (len < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                // The interface went away; join again once it is back
+                closeSocket();
+            }
+            return;
+        }
+        receive(rx_, len);
+    }
+}
+
+void UdpMulticastTransport::receive(const uint8_t *datagram, size_t len)
+{
+    if (len < UDP_SYNC_HEADER_SIZE || datagram[0] != UDP_SYNC_MAGIC || datagram[1] != UDP_SYNC_VERSION)
+    {
+        stats_.rejected++;
+        return;
+    }
+    const uint8_t *sender = datagram + 2;
+    if (memcmp(sender, own_mac_, 6) == 0)
+    {
+        return;
+    }
+    stats_.datagrams_received++;
+
+    // Walk the whole datagram before handing anything up, so a truncated one
+    // is dropped as a unit
+    size_t offset = UDP_SYNC_HEADER_SIZE;
+    for (uint8_t i = 0; i < datagram[8]; i++)
+    {
+        if (offset + UDP_SYNC_ENTRY_HEADER_SIZE > len)
+        {
+            stats_.rejected++;
+            return;
+        }
+        size_t message_len = datagram[offset + 6] | datagram[offset + 7] << 8;
+        offset += UDP_SYNC_ENTRY_HEADER_SIZE + message_len;
+        if (message_len > UDP_SYNC_MAX_MESSAGE || offset > len)
+        {
+            stats_.rejected++;
+            return;
+        }
+    }
+
+    offset = UDP_SYNC_HEADER_SIZE;
+    for (uint8_t i = 0; i < datagram[8]; i++)
+    {
+        const uint8_t *destination = datagram + offset;
+        size_t message_len = datagram[offset + 6] | datagram[offset + 7] << 8;
+        const uint8_t *message = datagram + offset + UDP_SYNC_ENTRY_HEADER_SIZE;
+        offset += UDP_SYNC_ENTRY_HEADER_SIZE + message_len;
+        if (memcmp(destination, own_mac_, 6) != 0 && memcmp(destination, UDP_BROADCAST_ADDRESS, 6) != 0)
+        {
+            stats_.filtered++;
+            continue;
+        }
+        stats_.messages_received++;
+        if (on_receive_)
+        {
+            on_receive_(sender, message, message_len);
+        }
+    }
+}
+
+int UdpMulticastTransport::findPeer(const uint8_t *mac) const
+{
+    for (uint8_t i = 0; i < peer_count_; i++)
+    {
+        if (memcmp(peers_[i], mac, 6) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool UdpMulticastTransport::addPeer(const uint8_t *mac)
+{
+    // Nothing to register on UDP; the list only answers hasPeer()
+    if (findPeer(mac) >= 0)
+    {
+        return true;
+    }
+    if (peer_count_ >= UDP_SYNC_MAX_PEERS)
+    {
+        return false;
+    }
+    memcpy(peers_[peer_count_++], mac, 6);
+    return true;
+}
+
+void UdpMulticastTransport::removePeer(const uint8_t *mac)
+{
+    int i = findPeer(mac);
+    if (i >= 0)
+    {
+        memcpy(peers_[i], peers_[--peer_count_], 6);
+    }
+}
+
+bool UdpMulticastTransport::hasPeer(const uint8_t *mac) const
+{
+    return findPeer(mac) >= 0;
+}
@@ -0,0 +1,107 @@
+#ifndef UDPMULTICASTTRANSPORT_H
+#define UDPMULTICASTTRANSPORT_H
+
+#include "SyncTransport.h"
+
+// SyncController's messages over UDP multicast, for installations on a camp
+// Wi-Fi network: no 250-byte frames, no 20-peer table, and the access point
+// does the relaying. Messages sent between two flush() calls share datagrams:
+//
+//   0  magic            UDP_SYNC_MAGIC
+//   1  version          UDP_SYNC_VERSION
+//   2  sender           MAC of the device that sent the datagram
+//   8  count            messages that follow
+//   9  messages         per message: destination MAC (broadcast for
+//                       everyone), length u16, then the message
+//
+// Everything goes to the multicast group; a device hands up the messages for
+// its own MAC and broadcasts, and drops the rest. There is no link-level ACK
+// on UDP, so a send is reported delivered once the socket takes it; the sync
+// layers' own acks and resends are what make delivery reliable here.
+//
+// The socket is non-blocking and only touched from begin(), update() and
+// flush(), so received messages are timestamped when update() polls them:
+// clock sync over UDP is as good as loop() is fast. If the network is not up
+// yet (no address to join the group on), update() retries every
+// UDP_SYNC_REOPEN_MS.
+#define UDP_SYNC_MAGIC 0x95
+#define UDP_SYNC_VERSION 1
+#define UDP_SYNC_HEADER_SIZE 9
+#define UDP_SYNC_ENTRY_HEADER_SIZE 8
+#define UDP_SYNC_DEFAULT_GROUP "239.66.77.1"
+#define UDP_SYNC_DEFAULT_PORT 4210
+#define UDP_SYNC_MAX_DATAGRAM 1400      // Stays under a 1500-byte Wi-Fi MTU
+#define UDP_SYNC_MAX_MESSAGE 250        // ESP_NOW_MAX_DATA_LEN, so messages work on either transport
+#define UDP_SYNC_MAX_PEERS 64
+#define UDP_SYNC_RECEIVE_BUDGET 16      // Datagrams read per update(), so a flood can't stall loop()
+#define UDP_SYNC_REOPEN_MS 1000
+
+struct UdpMulticastStats
+{
+    uint32_t messages_sent;
+    uint32_t datagrams_sent;
+    uint32_t bytes_sent;            // Datagram payloads, headers included
+    uint32_t messages_received;     // Handed up: for us or broadcast
+    uint32_t datagrams_received;
+    uint32_t filtered;              // Messages for other devices
+    uint32_t rejected;              // Malformed datagrams
+    uint32_t send_errors;           // Datagrams the socket refused; their messages are lost
+    uint32_t opens;                 // Times the socket joined the group
+};
+
+class UdpMulticastTransport : public SyncTransport
+{
+public:
+    explicit UdpMulticastTransport(const char *group = UDP_SYNC_DEFAULT_GROUP, uint16_t port = UDP_SYNC_DEFAULT_PORT);
+    ~UdpMulticastTransport();
+
+    // Before begin(). The MAC defaults to the Wi-Fi station's; the interface
+    // (a local IPv4 address) to whichever one the stack picks for multicast.
+    void setMac(const uint8_t *mac);
+    void setInterface(const char *address) { interface_ = address; }
+    // Off: every message goes out in its own datagram at once
+    void setBatching(bool batching) { batching_ = batching; }
+    // Other sockets on this machine hear our datagrams (host tests)
+    void setLoopback(bool loopback) { loopback_ = loopback; }
+
+    bool begin() override;
+    void getMac(uint8_t *mac) const override;
+    bool send(const uint8_t *mac, const uint8_t *data, size_t len) override;
+    void update() override;
+    void flush() override;
+    bool addPeer(const uint8_t *mac) override;
+    void removePeer(const uint8_t *mac) override;
+    bool hasPeer(const uint8_t *mac) const override;
+
+    bool isOpen() const { return socket_ >= 0; }
+    const UdpMulticastStats &getStats() const { return stats_; }
+
+private:
+    bool openSocket();
+    void closeSocket();
+    void receive(const uint8_t *datagram, size_t len);
+    int findPeer(const uint8_t *mac) const;
+
+    const char *group_;
+    uint16_t port_;
+    const char *interface_;
+    bool batching_;
+    bool loopback_;
+    bool started_;
+    bool has_mac_;
+    int socket_;
+    uint32_t last_open_ms_;
+    uint8_t own_mac_[6];
+
+    uint8_t peers_[UDP_SYNC_MAX_PEERS][6];
+    uint8_t peer_count_;
+
+    uint8_t tx_[UDP_SYNC_MAX_DATAGRAM];
+    size_t tx_len_;
+    uint8_t tx_count_;
+    uint8_t rx_[UDP_SYNC_MAX_DATAGRAM];
+
+    UdpMulticastStats stats_;
+};
+
+#endif // UDPMULTICASTTRANSPORT_H